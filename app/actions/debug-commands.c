@@ -27,6 +27,7 @@
 
 #include "actions-types.h"
 
+#include "base/tile-compress.h"
 #include "base/tile-manager.h"
 #include "base/tile.h"
 
@@ -84,6 +85,8 @@ debug_mem_profile_cmd_callback (GtkAction *action,
 {
   extern gboolean  gimp_debug_memsize;
   Gimp            *gimp;
+  gdouble          hit_rate;
+  gdouble          ratio;
   return_if_no_gimp (gimp, data);
 
   gimp_debug_memsize = TRUE;
@@ -91,6 +94,12 @@ debug_mem_profile_cmd_callback (GtkAction *action,
   gimp_object_get_memsize (GIMP_OBJECT (gimp), NULL);
 
   gimp_debug_memsize = FALSE;
+
+  tile_compress_get_stats (&hit_rate, &ratio);
+
+  g_print ("Compressed tile cache: %" G_GINT64_FORMAT " bytes, "
+           "hit rate %.1f%%, compression ratio %.1f:1\n",
+           tile_compress_get_memsize (), hit_rate * 100.0, ratio);
 }
 
 void
@@ -48,6 +48,7 @@
 /* types */
 
 typedef struct _BoundSeg            BoundSeg;
+typedef struct _BoundaryCache       BoundaryCache;
 
 typedef struct _GimpHistogram       GimpHistogram;
 typedef struct _GimpLut             GimpLut;
@@ -40,6 +40,7 @@
 #include "base.h"
 #include "pixel-processor.h"
 #include "tile-cache.h"
+#include "tile-compress.h"
 #include "tile-manager.h"
 #include "tile-swap.h"
 
@@ -49,6 +50,10 @@ static void   base_toast_old_swap_files   (const gchar *swap_path);
 static void   base_tile_cache_size_notify (GObject     *config,
                                            GParamSpec  *param_spec,
                                            gpointer     data);
+static void   base_tile_compress_size_notify
+                                          (GObject     *config,
+                                           GParamSpec  *param_spec,
+                                           gpointer     data);
 static void   base_num_processors_notify  (GObject     *config,
                                            GParamSpec  *param_spec,
                                            gpointer     data);
@@ -77,12 +82,17 @@ base_init (GimpBaseConfig *config,
                     G_CALLBACK (base_tile_cache_size_notify),
                     NULL);
 
+  tile_compress_init (config->tile_cache_compressed_size);
+  g_signal_connect (config, "notify::tile-cache-compressed-size",
+                    G_CALLBACK (base_tile_compress_size_notify),
+                    NULL);
+
   if (! config->swap_path || ! *config->swap_path)
     gimp_config_reset_property (G_OBJECT (config), "swap-path");
 
   base_toast_old_swap_files (config->swap_path);
 
-  tile_swap_init (config->swap_path);
+  tile_swap_init (config->swap_path, config->swap_mmap);
 
   swap_is_ok = tile_swap_test ();
 
@@ -124,11 +134,15 @@ base_exit (void)
   pixel_processor_exit ();
   paint_funcs_free ();
   tile_cache_exit ();
+  tile_compress_exit ();
   tile_swap_exit ();
 
   g_signal_handlers_disconnect_by_func (base_config,
                                         base_tile_cache_size_notify,
                                         NULL);
+  g_signal_handlers_disconnect_by_func (base_config,
+                                        base_tile_compress_size_notify,
+                                        NULL);
 
   g_object_unref (base_config);
   base_config = NULL;
@@ -199,6 +213,14 @@ base_tile_cache_size_notify (GObject    *config,
   tile_cache_set_size (GIMP_BASE_CONFIG (config)->tile_cache_size);
 }
 
+static void
+base_tile_compress_size_notify (GObject    *config,
+                                GParamSpec *param_spec,
+                                gpointer    data)
+{
+  tile_compress_set_size (GIMP_BASE_CONFIG (config)->tile_cache_compressed_size);
+}
+
 static void
 base_num_processors_notify (GObject    *config,
                             GParamSpec *param_spec,
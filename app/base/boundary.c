@@ -53,6 +53,31 @@ struct _Boundary
   gint     *empty_segs_c;
   gint     *empty_segs_l;
   gint      max_empty_segs;
+
+  /*  Only collect the horizontal segments  */
+  gboolean  horiz_only;
+};
+
+typedef struct
+{
+  BoundSeg *segs;
+  gint      num_segs;
+  gboolean  valid;
+} BoundaryBand;
+
+struct _BoundaryCache
+{
+  /*  The parameters the bands were generated with  */
+  TileManager  *tiles;
+  gint          x, y, w, h;
+  BoundaryType  type;
+  gint          x1, y1, x2, y2;
+  guchar        threshold;
+
+  /*  The horizontal segments of each row of tiles  */
+  BoundaryBand *bands;
+  gint          first_band;
+  gint          n_bands;
 };
 
 
@@ -93,6 +118,16 @@ static void       make_horiz_segs     (Boundary        *boundary,
                                        gint             empty[],
                                        gint             num_empty,
                                        gint             top);
+static void       generate_scanlines  (Boundary        *boundary,
+                                       PixelRegion     *PR,
+                                       BoundaryType     type,
+                                       gint             x1,
+                                       gint             y1,
+                                       gint             x2,
+                                       gint             y2,
+                                       guchar           threshold,
+                                       gint             start,
+                                       gint             end);
 static Boundary * generate_boundary   (PixelRegion     *PR,
                                        BoundaryType     type,
                                        gint             x1,
@@ -101,6 +136,8 @@ static Boundary * generate_boundary   (PixelRegion     *PR,
                                        gint             y2,
                                        guchar           threshold);
 
+static void       boundary_cache_clear (BoundaryCache  *cache);
+
 static gint       cmp_segptr_xy1_addr (const BoundSeg **seg_ptr_a,
                                        const BoundSeg **seg_ptr_b);
 static gint       cmp_segptr_xy2_addr (const BoundSeg **seg_ptr_a,
@@ -386,6 +423,197 @@ boundary_offset (BoundSeg *segs,
 }
 
 
+/**
+ * boundary_cache_new:
+ *
+ * Creates a cache for boundary_cache_find(), which keeps the
+ * boundary of each row of tiles of a mask around, so that only the
+ * rows that changed need to be scanned again.
+ *
+ * Return value: a new #BoundaryCache
+ **/
+BoundaryCache *
+boundary_cache_new (void)
+{
+  return g_slice_new0 (BoundaryCache);
+}
+
+void
+boundary_cache_free (BoundaryCache *cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  boundary_cache_clear (cache);
+
+  g_slice_free (BoundaryCache, cache);
+}
+
+/**
+ * boundary_cache_invalidate:
+ * @cache:  a #BoundaryCache
+ * @y:      the first row of the mask that changed
+ * @height: the number of rows that changed
+ *
+ * Marks the rows of tiles whose boundary depends on the changed rows
+ * of the mask for scanning them again.  This includes the rows just
+ * above and below, which decide if there is an edge at their border.
+ **/
+void
+boundary_cache_invalidate (BoundaryCache *cache,
+                           gint           y,
+                           gint           height)
+{
+  gint band;
+  gint last;
+
+  g_return_if_fail (cache != NULL);
+
+  if (height < 1 || cache->n_bands == 0)
+    return;
+
+  band = MAX ((y - 1) / TILE_HEIGHT - cache->first_band, 0);
+  last = MIN ((y + height) / TILE_HEIGHT - cache->first_band,
+              cache->n_bands - 1);
+
+  for (; band <= last; band++)
+    {
+      g_free (cache->bands[band].segs);
+
+      cache->bands[band].segs     = NULL;
+      cache->bands[band].num_segs = 0;
+      cache->bands[band].valid    = FALSE;
+    }
+}
+
+/**
+ * boundary_cache_find:
+ * @cache:     a #BoundaryCache
+ * @maskPR:    a PixelRegion on tiles
+ * @type:      type of bounds
+ * @x1:        left side of bounds
+ * @y1:        top side of bounds
+ * @x2:        right side of bounds
+ * @y2:        botton side of bounds
+ * @threshold: pixel value of boundary line
+ * @num_segs:  number of returned #BoundSeg's
+ *
+ * Returns the same segments as boundary_find(), but only scans the
+ * rows of tiles that have been invalidated since the last call with
+ * the same parameters.  The segments of all rows are then joined
+ * with their vertical segments again.
+ *
+ * Return value: the boundary array.
+ **/
+BoundSeg *
+boundary_cache_find (BoundaryCache *cache,
+                     PixelRegion   *maskPR,
+                     BoundaryType   type,
+                     gint           x1,
+                     gint           y1,
+                     gint           x2,
+                     gint           y2,
+                     guchar         threshold,
+                     gint          *num_segs)
+{
+  Boundary *boundary;
+  gint      start = 0;
+  gint      end   = 0;
+  gint      band;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (maskPR != NULL && maskPR->tiles != NULL, NULL);
+  g_return_val_if_fail (num_segs != NULL, NULL);
+
+  if (type == BOUNDARY_WITHIN_BOUNDS)
+    {
+      start = y1;
+      end   = y2;
+    }
+  else if (type == BOUNDARY_IGNORE_BOUNDS)
+    {
+      start = maskPR->y;
+      end   = maskPR->y + maskPR->h;
+    }
+
+  if (cache->tiles     != maskPR->tiles ||
+      cache->x         != maskPR->x     ||
+      cache->y         != maskPR->y     ||
+      cache->w         != maskPR->w     ||
+      cache->h         != maskPR->h     ||
+      cache->type      != type          ||
+      cache->x1        != x1            ||
+      cache->y1        != y1            ||
+      cache->x2        != x2            ||
+      cache->y2        != y2            ||
+      cache->threshold != threshold)
+    {
+      boundary_cache_clear (cache);
+
+      cache->tiles     = maskPR->tiles;
+      cache->x         = maskPR->x;
+      cache->y         = maskPR->y;
+      cache->w         = maskPR->w;
+      cache->h         = maskPR->h;
+      cache->type      = type;
+      cache->x1        = x1;
+      cache->y1        = y1;
+      cache->x2        = x2;
+      cache->y2        = y2;
+      cache->threshold = threshold;
+
+      if (end > start)
+        {
+          cache->first_band = start / TILE_HEIGHT;
+          cache->n_bands    = (end - 1) / TILE_HEIGHT - cache->first_band + 1;
+          cache->bands      = g_new0 (BoundaryBand, cache->n_bands);
+        }
+    }
+
+  for (band = 0; band < cache->n_bands; band++)
+    {
+      BoundaryBand *b = &cache->bands[band];
+
+      if (! b->valid)
+        {
+          gint band_y = (cache->first_band + band) * TILE_HEIGHT;
+
+          boundary = boundary_new (maskPR);
+          boundary->horiz_only = TRUE;
+
+          generate_scanlines (boundary, maskPR, type, x1, y1, x2, y2,
+                              threshold,
+                              MAX (band_y, start),
+                              MIN (band_y + TILE_HEIGHT, end));
+
+          b->num_segs = boundary->num_segs;
+          b->segs     = boundary_free (boundary, FALSE);
+          b->valid    = TRUE;
+        }
+    }
+
+  /*  join the horizontal segments with vertical ones, in the same order
+   *  as generate_boundary() does
+   */
+  boundary = boundary_new (maskPR);
+
+  for (band = 0; band < cache->n_bands; band++)
+    {
+      const BoundaryBand *b = &cache->bands[band];
+      gint                i;
+
+      for (i = 0; i < b->num_segs; i++)
+        process_horiz_seg (boundary,
+                           b->segs[i].x1, b->segs[i].y1,
+                           b->segs[i].x2, b->segs[i].y2,
+                           b->segs[i].open);
+    }
+
+  *num_segs = boundary->num_segs;
+
+  return boundary_free (boundary, FALSE);
+}
+
+
 /*  private functions  */
 
 static Boundary *
@@ -619,6 +847,12 @@ process_horiz_seg (Boundary *boundary,
   /*  This procedure accounts for any vertical segments that must be
       drawn to close in the horizontal segments.                     */
 
+  if (boundary->horiz_only)
+    {
+      boundary_add_seg (boundary, x1, y1, x2, y2, open);
+      return;
+    }
+
   if (boundary->vert_segs[x1] >= 0)
     {
       boundary_add_seg (boundary, x1, boundary->vert_segs[x1], x1, y1, !open);
@@ -670,41 +904,26 @@ make_horiz_segs (Boundary *boundary,
     }
 }
 
-static Boundary *
-generate_boundary (PixelRegion  *PR,
-                   BoundaryType  type,
-                   gint          x1,
-                   gint          y1,
-                   gint          x2,
-                   gint          y2,
-                   guchar        threshold)
+static void
+generate_scanlines (Boundary     *boundary,
+                    PixelRegion  *PR,
+                    BoundaryType  type,
+                    gint          x1,
+                    gint          y1,
+                    gint          x2,
+                    gint          y2,
+                    guchar        threshold,
+                    gint          start,
+                    gint          end)
 {
-  Boundary *boundary;
   gint      scanline;
   gint      i;
-  gint      start, end;
   gint     *tmp_segs;
 
   gint      num_empty_n = 0;
   gint      num_empty_c = 0;
   gint      num_empty_l = 0;
 
-  boundary = boundary_new (PR);
-
-  start = 0;
-  end   = 0;
-
-  if (type == BOUNDARY_WITHIN_BOUNDS)
-    {
-      start = y1;
-      end   = y2;
-    }
-  else if (type == BOUNDARY_IGNORE_BOUNDS)
-    {
-      start = PR->y;
-      end   = PR->y + PR->h;
-    }
-
   /*  Find the empty segments for the previous and current scanlines  */
   find_empty_segs (PR, start - 1, boundary->empty_segs_l,
                    boundary->max_empty_segs, &num_empty_l,
@@ -746,10 +965,57 @@ generate_boundary (PixelRegion  *PR,
       num_empty_c            = num_empty_n;
       boundary->empty_segs_n = tmp_segs;
     }
+}
+
+static Boundary *
+generate_boundary (PixelRegion  *PR,
+                   BoundaryType  type,
+                   gint          x1,
+                   gint          y1,
+                   gint          x2,
+                   gint          y2,
+                   guchar        threshold)
+{
+  Boundary *boundary;
+  gint      start, end;
+
+  boundary = boundary_new (PR);
+
+  start = 0;
+  end   = 0;
+
+  if (type == BOUNDARY_WITHIN_BOUNDS)
+    {
+      start = y1;
+      end   = y2;
+    }
+  else if (type == BOUNDARY_IGNORE_BOUNDS)
+    {
+      start = PR->y;
+      end   = PR->y + PR->h;
+    }
+
+  generate_scanlines (boundary, PR, type, x1, y1, x2, y2, threshold,
+                      start, end);
 
   return boundary;
 }
 
+static void
+boundary_cache_clear (BoundaryCache *cache)
+{
+  gint band;
+
+  for (band = 0; band < cache->n_bands; band++)
+    g_free (cache->bands[band].segs);
+
+  g_free (cache->bands);
+
+  cache->bands   = NULL;
+  cache->n_bands = 0;
+  cache->tiles   = NULL;
+}
+
 /*  sorting utility functions  */
 
 static inline gint
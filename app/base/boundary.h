@@ -62,5 +62,20 @@ void       boundary_offset    (BoundSeg       *segs,
                                gint            off_x,
                                gint            off_y);
 
+BoundaryCache * boundary_cache_new        (void);
+void            boundary_cache_free       (BoundaryCache  *cache);
+void            boundary_cache_invalidate (BoundaryCache  *cache,
+                                           gint            y,
+                                           gint            height);
+BoundSeg      * boundary_cache_find       (BoundaryCache  *cache,
+                                           PixelRegion    *maskPR,
+                                           BoundaryType    type,
+                                           gint            x1,
+                                           gint            y1,
+                                           gint            x2,
+                                           gint            y2,
+                                           guchar          threshold,
+                                           gint           *num_segs);
+
 
 #endif  /*  __BOUNDARY_H__  */
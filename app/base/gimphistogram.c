@@ -31,6 +31,7 @@
 #include "gimphistogram.h"
 #include "pixel-processor.h"
 #include "pixel-region.h"
+#include "tile.h"
 
 
 #ifdef ENABLE_MP
@@ -49,6 +50,14 @@ struct _GimpHistogram
   gchar          slots[NUM_SLOTS];
 #endif
   gdouble       *values[NUM_SLOTS];
+
+  /*  the values of each row of tiles, see gimp_histogram_calculate_cached()  */
+  gdouble       *band_values;
+  gboolean      *band_dirty;
+  gint           n_bands;
+  PixelRegion    band_region;
+  PixelRegion    band_mask;
+  gboolean       band_has_mask;
 };
 
 
@@ -57,6 +66,10 @@ struct _GimpHistogram
 static void  gimp_histogram_alloc_values         (GimpHistogram *histogram,
                                                   gint           bytes);
 static void  gimp_histogram_free_values          (GimpHistogram *histogram);
+static void  gimp_histogram_free_bands           (GimpHistogram *histogram);
+static void  gimp_histogram_calculate_slots      (GimpHistogram *histogram,
+                                                  PixelRegion   *region,
+                                                  PixelRegion   *mask);
 static void  gimp_histogram_calculate_sub_region (GimpHistogram *histogram,
                                                   PixelRegion   *region,
                                                   PixelRegion   *mask);
@@ -140,10 +153,10 @@ gimp_histogram_calculate (GimpHistogram *histogram,
                           PixelRegion   *region,
                           PixelRegion   *mask)
 {
-  gint i;
-
   g_return_if_fail (histogram != NULL);
 
+  gimp_histogram_free_bands (histogram);
+
   if (! region)
     {
       gimp_histogram_free_values (histogram);
@@ -152,26 +165,179 @@ gimp_histogram_calculate (GimpHistogram *histogram,
 
   gimp_histogram_alloc_values (histogram, region->bytes);
 
-  for (i = 0; i < NUM_SLOTS; i++)
-    if (histogram->values[i])
-      memset (histogram->values[i],
-              0, histogram->n_channels * 256 * sizeof (gdouble));
+  gimp_histogram_calculate_slots (histogram, region, mask);
+}
 
-  pixel_regions_process_parallel ((PixelProcessorFunc)
-                                  gimp_histogram_calculate_sub_region,
-                                  histogram, 2, region, mask);
+/**
+ * gimp_histogram_calculate_cached:
+ * @histogram: a %GimpHistogram
+ * @region:    the tiles to calculate the histogram of
+ * @mask:      a mask region of the same size, or %NULL
+ *
+ * Works like gimp_histogram_calculate(), but keeps the values of each
+ * row of tiles around.  When called again with the same regions, only
+ * the rows that have been passed to gimp_histogram_invalidate() in the
+ * meantime are calculated again.
+ **/
+void
+gimp_histogram_calculate_cached (GimpHistogram *histogram,
+                                 PixelRegion   *region,
+                                 PixelRegion   *mask)
+{
+  gint n_values;
+  gint first_band;
+  gint band;
+  gint i;
 
-#ifdef ENABLE_MP
-  /* add up all slots */
-  for (i = 1; i < NUM_SLOTS; i++)
-    if (histogram->values[i])
-      {
-        gint j;
+  g_return_if_fail (histogram != NULL);
+  g_return_if_fail (region != NULL && region->tiles != NULL);
 
-        for (j = 0; j < histogram->n_channels * 256; j++)
-          histogram->values[0][j] += histogram->values[i][j];
-      }
-#endif
+  if (region->w < 1 || region->h < 1)
+    {
+      gimp_histogram_calculate (histogram, region, mask);
+      return;
+    }
+
+  gimp_histogram_alloc_values (histogram, region->bytes);
+
+  if (histogram->band_values                                   &&
+      (region->tiles != histogram->band_region.tiles           ||
+       region->x     != histogram->band_region.x               ||
+       region->y     != histogram->band_region.y               ||
+       region->w     != histogram->band_region.w               ||
+       region->h     != histogram->band_region.h               ||
+       (mask != NULL) != histogram->band_has_mask              ||
+       (mask && (mask->tiles != histogram->band_mask.tiles     ||
+                 mask->x     != histogram->band_mask.x         ||
+                 mask->y     != histogram->band_mask.y))))
+    {
+      gimp_histogram_free_bands (histogram);
+    }
+
+  n_values   = histogram->n_channels * 256;
+  first_band = region->y / TILE_HEIGHT;
+
+  if (! histogram->band_values)
+    {
+      histogram->n_bands = ((region->y + region->h - 1) / TILE_HEIGHT -
+                            first_band + 1);
+
+      histogram->band_values = g_new (gdouble, histogram->n_bands * n_values);
+      histogram->band_dirty  = g_new (gboolean, histogram->n_bands);
+
+      for (band = 0; band < histogram->n_bands; band++)
+        histogram->band_dirty[band] = TRUE;
+
+      histogram->band_region   = *region;
+      histogram->band_has_mask = (mask != NULL);
+
+      if (mask)
+        histogram->band_mask = *mask;
+    }
+
+  for (band = 0; band < histogram->n_bands; band++)
+    {
+      PixelRegion bandPR;
+      PixelRegion maskPR;
+      gint        y1, y2;
+
+      if (! histogram->band_dirty[band])
+        continue;
+
+      y1 = MAX ((first_band + band) * TILE_HEIGHT, region->y);
+      y2 = MIN ((first_band + band + 1) * TILE_HEIGHT, region->y + region->h);
+
+      bandPR = *region;
+      pixel_region_resize (&bandPR, region->x, y1, region->w, y2 - y1);
+
+      if (mask)
+        {
+          maskPR = *mask;
+          pixel_region_resize (&maskPR,
+                               mask->x, mask->y + y1 - region->y,
+                               mask->w, y2 - y1);
+        }
+
+      gimp_histogram_calculate_slots (histogram, &bandPR,
+                                      mask ? &maskPR : NULL);
+
+      memcpy (histogram->band_values + band * n_values,
+              histogram->values[0], n_values * sizeof (gdouble));
+
+      histogram->band_dirty[band] = FALSE;
+    }
+
+  /* add up all bands */
+  memset (histogram->values[0], 0, n_values * sizeof (gdouble));
+
+  for (band = 0; band < histogram->n_bands; band++)
+    {
+      const gdouble *values = histogram->band_values + band * n_values;
+
+      for (i = 0; i < n_values; i++)
+        histogram->values[0][i] += values[i];
+    }
+}
+
+/**
+ * gimp_histogram_invalidate:
+ * @histogram: a %GimpHistogram
+ * @x:         the x coordinate of the changed area
+ * @y:         the y coordinate of the changed area
+ * @width:     the width of the changed area
+ * @height:    the height of the changed area
+ *
+ * Tells @histogram that the pixels in the given area, in the
+ * coordinates of the region it was calculated from, have changed.
+ * The next call to gimp_histogram_calculate_cached() will calculate
+ * the rows of tiles that touch this area again.
+ **/
+void
+gimp_histogram_invalidate (GimpHistogram *histogram,
+                           gint           x,
+                           gint           y,
+                           gint           width,
+                           gint           height)
+{
+  const PixelRegion *region;
+  gint               first_band;
+  gint               band;
+  gint               y1, y2;
+
+  g_return_if_fail (histogram != NULL);
+
+  if (! histogram->band_values)
+    return;
+
+  region = &histogram->band_region;
+
+  if (x + width  <= region->x || x >= region->x + region->w ||
+      y + height <= region->y || y >= region->y + region->h)
+    return;
+
+  y1 = MAX (y, region->y);
+  y2 = MIN (y + height, region->y + region->h);
+
+  first_band = region->y / TILE_HEIGHT;
+
+  for (band = y1 / TILE_HEIGHT; band <= (y2 - 1) / TILE_HEIGHT; band++)
+    histogram->band_dirty[band - first_band] = TRUE;
+}
+
+/**
+ * gimp_histogram_invalidate_all:
+ * @histogram: a %GimpHistogram
+ *
+ * Makes the next call to gimp_histogram_calculate_cached() calculate
+ * all of the histogram again, for when more than the pixels have
+ * changed, like the selection that is used as mask.
+ **/
+void
+gimp_histogram_invalidate_all (GimpHistogram *histogram)
+{
+  g_return_if_fail (histogram != NULL);
+
+  gimp_histogram_free_bands (histogram);
 }
 
 
@@ -570,6 +736,52 @@ gimp_histogram_free_values (GimpHistogram *histogram)
       }
 
   histogram->n_channels = 0;
+
+  gimp_histogram_free_bands (histogram);
+}
+
+static void
+gimp_histogram_free_bands (GimpHistogram *histogram)
+{
+  if (histogram->band_values)
+    {
+      g_free (histogram->band_values);
+      g_free (histogram->band_dirty);
+
+      histogram->band_values = NULL;
+      histogram->band_dirty  = NULL;
+      histogram->n_bands     = 0;
+    }
+}
+
+/*  Calculates the histogram of the region into the first slot.  */
+static void
+gimp_histogram_calculate_slots (GimpHistogram *histogram,
+                                PixelRegion   *region,
+                                PixelRegion   *mask)
+{
+  gint i;
+
+  for (i = 0; i < NUM_SLOTS; i++)
+    if (histogram->values[i])
+      memset (histogram->values[i],
+              0, histogram->n_channels * 256 * sizeof (gdouble));
+
+  pixel_regions_process_parallel ((PixelProcessorFunc)
+                                  gimp_histogram_calculate_sub_region,
+                                  histogram, 2, region, mask);
+
+#ifdef ENABLE_MP
+  /* add up all slots */
+  for (i = 1; i < NUM_SLOTS; i++)
+    if (histogram->values[i])
+      {
+        gint j;
+
+        for (j = 0; j < histogram->n_channels * 256; j++)
+          histogram->values[0][j] += histogram->values[i][j];
+      }
+#endif
 }
 
 static void
@@ -38,6 +38,12 @@
 #define TILES_PER_THREAD  8
 #define PROGRESS_TIMEOUT  64
 
+/*  the most portions a thread takes from the iterator at once, and
+ *  how long (in microseconds) processing them should roughly take
+ */
+#define MAX_CHUNK         16
+#define CHUNK_TARGET_TIME 2000
+
 
 static GThreadPool *pool       = NULL;
 static GMutex      *pool_mutex = NULL;
@@ -60,6 +66,40 @@ typedef void  (* p4_func) (gpointer      data,
                            PixelRegion  *region4);
 
 
+#ifdef ENABLE_MP
+
+/*  One portion of the regions, with its tiles locked  */
+typedef struct _PixelWork PixelWork;
+
+struct _PixelWork
+{
+  PixelRegion  regions[4];
+  guint        pixels;
+};
+
+/*  Every thread has its own queue of consecutive portions, so that
+ *  neighbouring tiles are processed by the same thread.  The owner
+ *  takes work from the head, other threads that ran out of work
+ *  steal from the tail.
+ */
+typedef struct _PixelQueue PixelQueue;
+
+struct _PixelQueue
+{
+  GMutex      *mutex;
+  PixelWork    work[MAX_CHUNK];
+  gint         head;
+  gint         tail;
+
+  /*  finished work, the tiles are released in batches  */
+  PixelWork    done[MAX_CHUNK];
+  gint         n_done;
+  gint64       done_time;
+};
+
+#endif
+
+
 typedef struct _PixelProcessor PixelProcessor;
 
 struct _PixelProcessor
@@ -70,7 +110,20 @@ struct _PixelProcessor
 #ifdef ENABLE_MP
   GMutex              *mutex;
   gint                 threads;
-  gboolean             first;
+  gint                 started;
+
+  PixelQueue          *queues;
+  gint                 n_queues;
+
+  gulong               tiles_left;
+  gint64               work_time;
+  gulong               work_pixels;
+
+  /*  pixel_processor_run_ranges() hands out [range_next, range_size)  */
+  PixelProcessorRangeFunc  range_func;
+  gint                 range_next;
+  gint                 range_size;
+  gint                 range_chunk;
 #endif
 
   PixelRegionIterator *PRI;
@@ -81,90 +134,197 @@ struct _PixelProcessor
 };
 
 
-#ifdef ENABLE_MP
-static void
-do_parallel_regions (PixelProcessor *processor)
+static inline void
+pixel_processor_call (PixelProcessor *processor,
+                      PixelRegion    *r0,
+                      PixelRegion    *r1,
+                      PixelRegion    *r2,
+                      PixelRegion    *r3)
 {
-  PixelRegion tr[4];
-  gint        i;
+  switch (processor->num_regions)
+    {
+    case 1:
+      ((p1_func) processor->func) (processor->data, r0);
+      break;
 
-  g_mutex_lock (processor->mutex);
+    case 2:
+      ((p2_func) processor->func) (processor->data, r0, r1);
+      break;
 
-  /*  the first thread getting here must not call pixel_regions_process()  */
-  if (! processor->first && processor->PRI)
-    processor->PRI = pixel_regions_process (processor->PRI);
-  else
-    processor->first = FALSE;
+    case 3:
+      ((p3_func) processor->func) (processor->data, r0, r1, r2);
+      break;
+
+    case 4:
+      ((p4_func) processor->func) (processor->data, r0, r1, r2, r3);
+      break;
 
-  while (processor->PRI)
+    default:
+      g_warning ("pixel_processor_call: Bad number of regions %d\n",
+                 processor->num_regions);
+      break;
+    }
+}
+
+#ifdef ENABLE_MP
+
+/*  The number of portions to take from the iterator next.  Start with
+ *  an even share of what is left (guided scheduling), and make chunks
+ *  smaller once we know that the tiles are expensive to process.
+ *  Called with the processor mutex held.
+ */
+static gint
+pixel_processor_chunk_size (PixelProcessor *processor)
+{
+  gulong chunk = processor->tiles_left / (processor->n_queues * 2);
+
+  if (processor->work_pixels)
     {
-      const guint pixels = (processor->PRI->portion_width *
-                            processor->PRI->portion_height);
+      gdouble tile_time = ((gdouble) processor->work_time *
+                           (TILE_WIDTH * TILE_HEIGHT) /
+                           processor->work_pixels);
 
-      for (i = 0; i < processor->num_regions; i++)
-        {
-          if (processor->regions[i])
-            {
-              memcpy (&tr[i], processor->regions[i], sizeof (PixelRegion));
+      if (tile_time * chunk > CHUNK_TARGET_TIME)
+        chunk = CHUNK_TARGET_TIME / MAX (tile_time, 1.0);
+    }
 
-              if (tr[i].tiles)
-                tile_lock (tr[i].curtile);
-            }
-        }
+  return CLAMP (chunk, 1, MAX_CHUNK);
+}
 
-      g_mutex_unlock (processor->mutex);
+/*  Releases the tiles of finished work.
+ *  Called with the processor mutex held.
+ */
+static void
+pixel_processor_release_done (PixelProcessor *processor,
+                              PixelQueue     *queue)
+{
+  gint i, j;
 
-      switch (processor->num_regions)
+  for (i = 0; i < queue->n_done; i++)
+    {
+      PixelWork *work = &queue->done[i];
+
+      for (j = 0; j < processor->num_regions; j++)
         {
-        case 1:
-          ((p1_func) processor->func) (processor->data,
-                                       processor->regions[0] ? &tr[0] : NULL);
-          break;
-
-        case 2:
-          ((p2_func) processor->func) (processor->data,
-                                       processor->regions[0] ? &tr[0] : NULL,
-                                       processor->regions[1] ? &tr[1] : NULL);
-          break;
-
-        case 3:
-          ((p3_func) processor->func) (processor->data,
-                                       processor->regions[0] ? &tr[0] : NULL,
-                                       processor->regions[1] ? &tr[1] : NULL,
-                                       processor->regions[2] ? &tr[2] : NULL);
-          break;
-
-        case 4:
-          ((p4_func) processor->func) (processor->data,
-                                       processor->regions[0] ? &tr[0] : NULL,
-                                       processor->regions[1] ? &tr[1] : NULL,
-                                       processor->regions[2] ? &tr[2] : NULL,
-                                       processor->regions[3] ? &tr[3] : NULL);
-          break;
-
-        default:
-          g_warning ("do_parallel_regions: Bad number of regions %d\n",
-                     processor->num_regions);
-          break;
+          if (processor->regions[j] && work->regions[j].tiles)
+            tile_release (work->regions[j].curtile, work->regions[j].dirty);
         }
 
-      g_mutex_lock (processor->mutex);
+      processor->progress    += work->pixels;
+      processor->work_pixels += work->pixels;
+    }
+
+  processor->work_time += queue->done_time;
+
+  queue->n_done    = 0;
+  queue->done_time = 0;
+}
+
+/*  Moves the next chunk of portions from the iterator into the queue.
+ *  Called with the processor mutex held, the queue must be empty.
+ */
+static void
+pixel_processor_fill (PixelProcessor *processor,
+                      PixelQueue     *queue)
+{
+  gint n = pixel_processor_chunk_size (processor);
+  gint i;
+
+  g_mutex_lock (queue->mutex);
+
+  queue->head = queue->tail = 0;
+
+  while (processor->PRI && queue->tail < n)
+    {
+      PixelWork *work = &queue->work[queue->tail++];
+
+      work->pixels = (processor->PRI->portion_width *
+                      processor->PRI->portion_height);
 
       for (i = 0; i < processor->num_regions; i++)
         {
           if (processor->regions[i])
             {
-              if (tr[i].tiles)
-                tile_release (tr[i].curtile, tr[i].dirty);
+              memcpy (&work->regions[i], processor->regions[i],
+                      sizeof (PixelRegion));
+
+              if (work->regions[i].tiles)
+                tile_lock (work->regions[i].curtile);
             }
         }
 
-      processor->progress += pixels;
+      if (processor->tiles_left > 0)
+        processor->tiles_left--;
+
+      processor->PRI = pixel_regions_process (processor->PRI);
+    }
+
+  g_mutex_unlock (queue->mutex);
+}
+
+static gboolean
+pixel_processor_take (PixelQueue *queue,
+                      PixelWork  *work,
+                      gboolean    steal)
+{
+  gboolean success = FALSE;
+
+  g_mutex_lock (queue->mutex);
+
+  if (queue->head < queue->tail)
+    {
+      if (steal)
+        memcpy (work, &queue->work[--queue->tail], sizeof (PixelWork));
+      else
+        memcpy (work, &queue->work[queue->head++], sizeof (PixelWork));
+
+      success = TRUE;
+    }
+
+  g_mutex_unlock (queue->mutex);
+
+  return success;
+}
+
+static gboolean
+pixel_processor_next (PixelProcessor *processor,
+                      PixelQueue     *queue,
+                      PixelWork      *work)
+{
+  gint i;
+
+  if (pixel_processor_take (queue, work, FALSE))
+    return TRUE;
+
+  g_mutex_lock (processor->mutex);
+
+  pixel_processor_release_done (processor, queue);
+
+  if (processor->PRI)
+    pixel_processor_fill (processor, queue);
+
+  g_mutex_unlock (processor->mutex);
+
+  if (pixel_processor_take (queue, work, FALSE))
+    return TRUE;
+
+  /*  the iterator is done, help the others with what they have left  */
+  for (i = 1; i < processor->n_queues; i++)
+    {
+      PixelQueue *victim = &processor->queues[((queue - processor->queues) + i) %
+                                              processor->n_queues];
 
-      if (processor->PRI)
-        processor->PRI = pixel_regions_process (processor->PRI);
+      if (pixel_processor_take (victim, work, TRUE))
+        return TRUE;
     }
 
+  return FALSE;
+}
+
+/*  Called with the processor mutex held, which it releases.  */
+static void
+pixel_processor_thread_done (PixelProcessor *processor)
+{
   processor->threads--;
 
   if (processor->threads == 0)
@@ -180,6 +340,75 @@ do_parallel_regions (PixelProcessor *processor)
       g_mutex_unlock (processor->mutex);
     }
 }
+
+static void
+do_parallel_ranges (PixelProcessor *processor)
+{
+  g_mutex_lock (processor->mutex);
+
+  while (processor->range_next < processor->range_size)
+    {
+      gint first = processor->range_next;
+      gint last  = MIN (first + processor->range_chunk,
+                        processor->range_size);
+
+      processor->range_next = last;
+
+      g_mutex_unlock (processor->mutex);
+
+      processor->range_func (processor->data, first, last);
+
+      g_mutex_lock (processor->mutex);
+    }
+
+  pixel_processor_thread_done (processor);
+}
+
+static void
+do_parallel_regions (PixelProcessor *processor)
+{
+  PixelQueue *queue;
+  PixelWork   work;
+
+  if (processor->range_func)
+    {
+      do_parallel_ranges (processor);
+      return;
+    }
+
+  g_mutex_lock (processor->mutex);
+  queue = &processor->queues[processor->started++];
+  g_mutex_unlock (processor->mutex);
+
+  while (pixel_processor_next (processor, queue, &work))
+    {
+      gint64 start = g_get_monotonic_time ();
+
+#define REGION(i) (processor->regions[i] ? &work.regions[i] : NULL)
+
+      pixel_processor_call (processor,
+                            REGION (0), REGION (1), REGION (2), REGION (3));
+
+#undef REGION
+
+      queue->done_time += g_get_monotonic_time () - start;
+
+      memcpy (&queue->done[queue->n_done++], &work, sizeof (PixelWork));
+
+      if (queue->n_done == MAX_CHUNK)
+        {
+          g_mutex_lock (processor->mutex);
+          pixel_processor_release_done (processor, queue);
+          g_mutex_unlock (processor->mutex);
+        }
+    }
+
+  g_mutex_lock (processor->mutex);
+
+  pixel_processor_release_done (processor, queue);
+
+  pixel_processor_thread_done (processor);
+}
 #endif
 
 /*  do_parallel_regions_single is just like do_parallel_regions
@@ -203,39 +432,9 @@ do_parallel_regions_single (PixelProcessor             *processor,
 
   do
     {
-      switch (processor->num_regions)
-        {
-        case 1:
-          ((p1_func) processor->func) (processor->data,
-                                       processor->regions[0]);
-          break;
-
-        case 2:
-          ((p2_func) processor->func) (processor->data,
-                                       processor->regions[0],
-                                       processor->regions[1]);
-          break;
-
-        case 3:
-          ((p3_func) processor->func) (processor->data,
-                                       processor->regions[0],
-                                       processor->regions[1],
-                                       processor->regions[2]);
-          break;
-
-        case 4:
-          ((p4_func) processor->func) (processor->data,
-                                       processor->regions[0],
-                                       processor->regions[1],
-                                       processor->regions[2],
-                                       processor->regions[3]);
-          break;
-
-        default:
-          g_warning ("do_parallel_regions_single: Bad number of regions %d\n",
-                     processor->num_regions);
-          break;
-        }
+      pixel_processor_call (processor,
+                            processor->regions[0], processor->regions[1],
+                            processor->regions[2], processor->regions[3]);
 
       if (progress_func)
         {
@@ -277,15 +476,22 @@ pixel_regions_do_parallel (PixelProcessor             *processor,
       GError *error = NULL;
       gint    tasks = MIN (tiles / TILES_PER_THREAD,
                            g_thread_pool_get_max_threads (pool));
+      gint    i;
 
       /*
        * g_printerr ("pushing %d tasks into the thread pool (for %lu tiles)\n",
        *             tasks, tiles);
        */
 
-      processor->first   = TRUE;
-      processor->threads = tasks;
-      processor->mutex   = g_mutex_new();
+      processor->threads    = tasks;
+      processor->started    = 0;
+      processor->mutex      = g_mutex_new ();
+      processor->queues     = g_new0 (PixelQueue, tasks);
+      processor->n_queues   = tasks;
+      processor->tiles_left = MAX (tiles, 1);
+
+      for (i = 0; i < tasks; i++)
+        processor->queues[i].mutex = g_mutex_new ();
 
       g_mutex_lock (pool_mutex);
 
@@ -329,6 +535,10 @@ pixel_regions_do_parallel (PixelProcessor             *processor,
 
       g_mutex_unlock (pool_mutex);
 
+      for (i = 0; i < processor->n_queues; i++)
+        g_mutex_free (processor->queues[i].mutex);
+
+      g_free (processor->queues);
       g_mutex_free (processor->mutex);
     }
   else
@@ -460,6 +670,17 @@ pixel_processor_set_num_threads (gint num_threads)
 #endif
 }
 
+gint
+pixel_processor_get_num_threads (void)
+{
+#ifdef ENABLE_MP
+  if (pool)
+    return g_thread_pool_get_max_threads (pool);
+#endif
+
+  return 1;
+}
+
 void
 pixel_processor_exit (void)
 {
@@ -501,3 +722,72 @@ pixel_regions_process_parallel_progress (PixelProcessorFunc          func,
 
   va_end (va);
 }
+
+/*  Splits [0, size) into ranges of at least min_size items and calls
+ *  func for each of them on the threads of the pixel processor, for
+ *  work that doesn't map to the tiles of a region.  Returns when all
+ *  ranges are done.
+ */
+void
+pixel_processor_run_ranges (PixelProcessorRangeFunc  func,
+                            gpointer                 data,
+                            gint                     size,
+                            gint                     min_size)
+{
+  g_return_if_fail (func != NULL);
+
+  if (size <= 0)
+    return;
+
+  min_size = MAX (min_size, 1);
+
+#ifdef ENABLE_MP
+  if (pool && size >= 2 * min_size)
+    {
+      PixelProcessor  processor = { NULL, };
+      GError         *error     = NULL;
+      gint            tasks     = MIN (size / min_size,
+                                       g_thread_pool_get_max_threads (pool));
+
+      processor.data        = data;
+      processor.mutex       = g_mutex_new ();
+      processor.threads     = tasks;
+      processor.range_func  = func;
+      processor.range_next  = 0;
+      processor.range_size  = size;
+      processor.range_chunk = MAX (min_size, size / (4 * tasks));
+
+      g_mutex_lock (pool_mutex);
+
+      while (tasks--)
+        {
+          g_thread_pool_push (pool, &processor, &error);
+
+          if (G_UNLIKELY (error))
+            {
+              g_warning ("thread creation failed: %s", error->message);
+              g_clear_error (&error);
+
+              g_mutex_lock (processor.mutex);
+              processor.threads--;
+              g_mutex_unlock (processor.mutex);
+            }
+        }
+
+      while (processor.threads != 0)
+        g_cond_wait (pool_cond, pool_mutex);
+
+      g_mutex_unlock (pool_mutex);
+
+      g_mutex_free (processor.mutex);
+
+      /*  whatever no thread took, if none could be started  */
+      if (processor.range_next < size)
+        func (data, processor.range_next, size);
+
+      return;
+    }
+#endif
+
+  func (data, 0, size);
+}
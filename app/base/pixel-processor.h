@@ -26,10 +26,14 @@
 
 typedef void (* PixelProcessorProgressFunc) (gpointer  progress_data,
                                              gdouble   fraction);
+typedef void (* PixelProcessorRangeFunc)    (gpointer  data,
+                                             gint      first,
+                                             gint      last);
 
 
 void  pixel_processor_init            (gint num_threads);
 void  pixel_processor_set_num_threads (gint num_threads);
+gint  pixel_processor_get_num_threads (void);
 void  pixel_processor_exit            (void);
 
 void  pixel_regions_process_parallel  (PixelProcessorFunc  func,
@@ -45,5 +49,10 @@ void  pixel_regions_process_parallel_progress
                                        gint                        num_regions,
                                        ...);
 
+void  pixel_processor_run_ranges      (PixelProcessorRangeFunc  func,
+                                       gpointer                 data,
+                                       gint                     size,
+                                       gint                     min_size);
+
 
 #endif /* __PIXEL_PROCESSOR_H__ */
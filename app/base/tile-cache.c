@@ -23,6 +23,7 @@
 
 #include "tile.h"
 #include "tile-cache.h"
+#include "tile-compress.h"
 #include "tile-swap.h"
 #include "tile-rowhints.h"
 #include "tile-private.h"
@@ -33,88 +34,229 @@
 #define IDLE_SWAPPER_TILES_PER_INTERVAL 10
 
 
+/*  The cache is split into a number of shards, each with its own LRU
+ *  list and its own lock, so that threads releasing tiles from the
+ *  pixel processor don't all queue on a single mutex.  A tile always
+ *  lives in the same shard, which is picked from its address.
+ *
+ *  The total cache size is shared between all shards and only kept
+ *  approximately in sync using atomic operations; a shard that needs
+ *  room evicts its own least recently used tiles first and only
+ *  falls back to the other shards if it is empty.
+ */
+#ifdef ENABLE_MP
+#define TILE_CACHE_N_SHARDS  16
+#else
+#define TILE_CACHE_N_SHARDS  1
+#endif
+
+#define TILE_CACHE_SHARD(t) \
+  (&tile_cache_shards[(((gsize) (t) >> 4) * 2654435761u) % TILE_CACHE_N_SHARDS])
+
+
 typedef struct _TileList
 {
   Tile *first;
   Tile *last;
 } TileList;
 
+typedef struct _TileCacheShard TileCacheShard;
+
+struct _TileCacheShard
+{
+#ifdef ENABLE_MP
+  GMutex   *mutex;
+#endif
+  TileList  tile_list;
+  guint64   cur_dirty;
+  Tile     *idle_scan_last;
+};
 
-static guint64       cur_cache_size   = 0;
-static guint64       max_cache_size   = 0;
-static guint64       cur_cache_dirty  = 0;
-static TileList      tile_list        = { NULL, NULL };
-static guint         idle_swapper     = 0;
-static guint         idle_delay       = 0;
-static Tile         *idle_scan_last   = NULL;
+
+static guint64         cur_cache_size   = 0;
+static guint64         max_cache_size   = 0;
+static TileCacheShard  tile_cache_shards[TILE_CACHE_N_SHARDS];
+static guint           idle_swapper     = 0;
+static guint           idle_delay       = 0;
+static gint            idle_scan_shard  = 0;
 
 #ifdef TILE_PROFILING
-extern gulong        tile_idle_swapout;
-extern gulong        tile_total_zorched;
-extern gulong        tile_total_zorched_swapout;
-extern glong         tile_total_interactive_sec;
-extern glong         tile_total_interactive_usec;
-extern gint          tile_exist_count;
+extern gulong          tile_idle_swapout;
+extern gulong          tile_total_zorched;
+extern gulong          tile_total_zorched_swapout;
+extern glong           tile_total_interactive_sec;
+extern glong           tile_total_interactive_usec;
+
+/* how many times a thread had to wait for a shard lock held by
+   another thread */
+volatile gint          tile_cache_contention = 0;
 #endif
 
 #ifdef ENABLE_MP
 
-static GMutex       *tile_cache_mutex = NULL;
+static GMutex         *idle_mutex       = NULL;
+
+#define TILE_CACHE_LOCK(s)    tile_cache_shard_lock (s)
+#define TILE_CACHE_UNLOCK(s)  g_mutex_unlock ((s)->mutex)
 
-#define TILE_CACHE_LOCK    g_mutex_lock (tile_cache_mutex)
-#define TILE_CACHE_UNLOCK  g_mutex_unlock (tile_cache_mutex)
+#define IDLE_SWAPPER_LOCK     g_mutex_lock (idle_mutex)
+#define IDLE_SWAPPER_UNLOCK   g_mutex_unlock (idle_mutex)
 
 #else
 
-#define TILE_CACHE_LOCK   /* nothing */
-#define TILE_CACHE_UNLOCK /* nothing */
+#define TILE_CACHE_LOCK(s)    /* nothing */
+#define TILE_CACHE_UNLOCK(s)  /* nothing */
+
+#define IDLE_SWAPPER_LOCK     /* nothing */
+#define IDLE_SWAPPER_UNLOCK   /* nothing */
 
 #endif
 
 #define PENDING_WRITE(t) ((t)->dirty || (t)->swap_offset == -1)
 
+/*  The cache size is shared by all shards.  It is updated with atomic
+ *  operations where they are 64 bits wide, and under a lock of its own
+ *  elsewhere, so that caches above 4 GB work on 32-bit systems too.
+ */
+#if ! defined (ENABLE_MP)
+
+#define CACHE_SIZE()     (cur_cache_size)
+#define CACHE_GROW(n)    (cur_cache_size += (n))
+#define CACHE_SHRINK(n)  (cur_cache_size -= (n))
+
+#elif GLIB_SIZEOF_VOID_P >= 8
+
+#define CACHE_SIZE()     ((guint64) g_atomic_pointer_get ((volatile gsize *) &cur_cache_size))
+#define CACHE_GROW(n)    g_atomic_pointer_add ((volatile gsize *) &cur_cache_size, (gssize) (n))
+#define CACHE_SHRINK(n)  g_atomic_pointer_add ((volatile gsize *) &cur_cache_size, - (gssize) (n))
+
+#else
+
+#define TILE_CACHE_SIZE_LOCKED 1
+
+static GMutex         *size_mutex       = NULL;
+
+#define CACHE_SIZE()     tile_cache_size_get ()
+#define CACHE_GROW(n)    tile_cache_size_add ((n))
+#define CACHE_SHRINK(n)  tile_cache_size_add (- (gint64) (n))
+
+static inline guint64
+tile_cache_size_get (void)
+{
+  guint64 size;
+
+  g_mutex_lock (size_mutex);
+  size = cur_cache_size;
+  g_mutex_unlock (size_mutex);
+
+  return size;
+}
+
+static inline void
+tile_cache_size_add (gint64 n)
+{
+  g_mutex_lock (size_mutex);
+  cur_cache_size += n;
+  g_mutex_unlock (size_mutex);
+}
+
+#endif
+
 
-static gboolean  tile_cache_zorch_next     (void);
-static void      tile_cache_flush_internal (Tile     *tile);
-static gboolean  tile_idle_preswap         (gpointer  data);
+static gboolean  tile_cache_zorch_next     (TileCacheShard *shard);
+static gboolean  tile_cache_zorch_other    (TileCacheShard *except);
+static void      tile_cache_flush_internal (TileCacheShard *shard,
+                                            Tile           *tile);
+static void      tile_idle_preswap_start   (void);
+static gboolean  tile_idle_preswap         (gpointer        data);
 #ifdef TILE_PROFILING
 static void      tile_verify               (void);
 #endif
 
 
+#ifdef ENABLE_MP
+static inline void
+tile_cache_shard_lock (TileCacheShard *shard)
+{
+#ifdef TILE_PROFILING
+  if (g_mutex_trylock (shard->mutex))
+    return;
+
+  g_atomic_int_inc (&tile_cache_contention);
+#endif
+
+  g_mutex_lock (shard->mutex);
+}
+#endif
+
 void
 tile_cache_init (guint64 tile_cache_size)
 {
+  gint i;
+
+#ifdef ENABLE_MP
+  g_return_if_fail (tile_cache_shards[0].mutex == NULL);
+#endif
+
+  for (i = 0; i < TILE_CACHE_N_SHARDS; i++)
+    {
+      TileCacheShard *shard = &tile_cache_shards[i];
+
 #ifdef ENABLE_MP
-  g_return_if_fail (tile_cache_mutex == NULL);
+      shard->mutex = g_mutex_new ();
+#endif
+
+      shard->tile_list.first = shard->tile_list.last = NULL;
+      shard->cur_dirty       = 0;
+      shard->idle_scan_last  = NULL;
+    }
 
-  tile_cache_mutex = g_mutex_new ();
+#ifdef ENABLE_MP
+  idle_mutex = g_mutex_new ();
 #endif
 
-  tile_list.first = tile_list.last = NULL;
-  idle_scan_last = NULL;
+#ifdef TILE_CACHE_SIZE_LOCKED
+  size_mutex = g_mutex_new ();
+#endif
 
-  max_cache_size = tile_cache_size;
+  idle_scan_shard = 0;
+  cur_cache_size  = 0;
+  max_cache_size  = tile_cache_size;
 }
 
 void
 tile_cache_exit (void)
 {
+#ifdef ENABLE_MP
+  gint i;
+#endif
+
   if (idle_swapper)
     {
       g_source_remove (idle_swapper);
       idle_swapper = 0;
     }
 
-  if (cur_cache_size > 0)
+  if (CACHE_SIZE () > 0)
     g_warning ("tile cache not empty (%"G_GUINT64_FORMAT" bytes left)",
-               cur_cache_size);
+               CACHE_SIZE ());
 
   tile_cache_set_size (0);
 
 #ifdef ENABLE_MP
-  g_mutex_free (tile_cache_mutex);
-  tile_cache_mutex = NULL;
+  for (i = 0; i < TILE_CACHE_N_SHARDS; i++)
+    {
+      g_mutex_free (tile_cache_shards[i].mutex);
+      tile_cache_shards[i].mutex = NULL;
+    }
+
+  g_mutex_free (idle_mutex);
+  idle_mutex = NULL;
+#endif
+
+#ifdef TILE_CACHE_SIZE_LOCKED
+  g_mutex_free (size_mutex);
+  size_mutex = NULL;
 #endif
 }
 
@@ -127,8 +269,9 @@ tile_cache_suspend_idle_swapper(void)
 void
 tile_cache_insert (Tile *tile)
 {
+  TileCacheShard *shard = TILE_CACHE_SHARD (tile);
 
-  TILE_CACHE_LOCK;
+  TILE_CACHE_LOCK (shard);
 
   if (! tile->data)
     goto out;
@@ -146,19 +289,19 @@ tile_cache_insert (Tile *tile)
       if (tile->next)
         tile->next->prev = tile->prev;
       else
-        tile_list.last = tile->prev;
+        shard->tile_list.last = tile->prev;
 
       if(tile->prev){
 	tile->prev->next = tile->next;
       }else{
-	tile_list.first = tile->next;
+	shard->tile_list.first = tile->next;
       }
 
       if (PENDING_WRITE(tile))
-	cur_cache_dirty -= tile->size;
+	shard->cur_dirty -= tile->size;
 
-      if(tile == idle_scan_last)
-	idle_scan_last = tile->next;
+      if(tile == shard->idle_scan_last)
+	shard->idle_scan_last = tile->next;
 
     }
   else
@@ -171,16 +314,31 @@ tile_cache_insert (Tile *tile)
        */
 
 #ifdef TILE_PROFILING
-      if ((cur_cache_size + tile->size) > max_cache_size)
+      if ((CACHE_SIZE () + tile->size) > max_cache_size)
         {
           GTimeVal now;
           GTimeVal later;
 
           g_get_current_time(&now);
 #endif
-          while ((cur_cache_size + tile->size) > max_cache_size)
+          while ((CACHE_SIZE () + tile->size) > max_cache_size)
             {
-              if (! tile_cache_zorch_next ())
+              gboolean zorched;
+
+              if (tile_cache_zorch_next (shard))
+                continue;
+
+              /* this shard is empty, make room in one of the others;
+               * never hold two shard locks at the same time
+               */
+              TILE_CACHE_UNLOCK (shard);
+              zorched = tile_cache_zorch_other (shard);
+              TILE_CACHE_LOCK (shard);
+
+              if (tile->cached || ! tile->data)
+                goto out;
+
+              if (! zorched)
                 {
                   g_warning ("cache: unable to find room for a tile");
                   goto out;
@@ -206,108 +364,109 @@ tile_cache_insert (Tile *tile)
         }
 #endif
 
-      cur_cache_size += tile->size;
+      CACHE_GROW (tile->size);
     }
 
   /* Put the tile at the end of the proper list */
 
   tile->next = NULL;
-  tile->prev = tile_list.last;
+  tile->prev = shard->tile_list.last;
 
-  if (tile_list.last)
-    tile_list.last->next = tile;
+  if (shard->tile_list.last)
+    shard->tile_list.last->next = tile;
   else
-    tile_list.first = tile;
+    shard->tile_list.first = tile;
 
-  tile_list.last = tile;
+  shard->tile_list.last = tile;
   tile->cached = TRUE;
   idle_delay = 1;
 
   if (PENDING_WRITE(tile))
     {
-      cur_cache_dirty += tile->size;
+      shard->cur_dirty += tile->size;
 
-      if (! idle_scan_last)
-	idle_scan_last=tile;
+      if (! shard->idle_scan_last)
+	shard->idle_scan_last=tile;
 
       if (! idle_swapper)
-        {
-#ifdef TILE_PROFILING
-	  g_printerr("idle swapper -> started\n");
-	  g_printerr("idle swapper -> waiting");
-#endif
-	  idle_delay = 0;
-          idle_swapper = g_timeout_add_full (G_PRIORITY_LOW,
-                                             IDLE_SWAPPER_START,
-                                             tile_idle_preswap,
-                                             NULL, NULL);
-        }
+        tile_idle_preswap_start ();
     }
 
 out:
-  TILE_CACHE_UNLOCK;
+  TILE_CACHE_UNLOCK (shard);
 }
 
 void
 tile_cache_flush (Tile *tile)
 {
-  TILE_CACHE_LOCK;
+  TileCacheShard *shard = TILE_CACHE_SHARD (tile);
+
+  TILE_CACHE_LOCK (shard);
 
   if (tile->cached)
-    tile_cache_flush_internal (tile);
+    tile_cache_flush_internal (shard, tile);
 
-  TILE_CACHE_UNLOCK;
+  TILE_CACHE_UNLOCK (shard);
 }
 
 void
 tile_cache_set_size (guint64 cache_size)
 {
-  TILE_CACHE_LOCK;
+  gint i;
 
   idle_delay = 1;
   max_cache_size = cache_size;
 
-  while (cur_cache_size > max_cache_size)
+  for (i = 0; i < TILE_CACHE_N_SHARDS; i++)
     {
-      if (! tile_cache_zorch_next ())
-        break;
-    }
+      TileCacheShard *shard = &tile_cache_shards[i];
+
+      TILE_CACHE_LOCK (shard);
 
-  TILE_CACHE_UNLOCK;
+      while (CACHE_SIZE () > max_cache_size)
+        {
+          if (! tile_cache_zorch_next (shard))
+            break;
+        }
+
+      TILE_CACHE_UNLOCK (shard);
+    }
 }
 
 static void
-tile_cache_flush_internal (Tile *tile)
+tile_cache_flush_internal (TileCacheShard *shard,
+                           Tile           *tile)
 {
 
   tile->cached = FALSE;
 
   if (PENDING_WRITE(tile))
-    cur_cache_dirty -= tile->size;
+    shard->cur_dirty -= tile->size;
 
-  cur_cache_size -= tile->size;
+  CACHE_SHRINK (tile->size);
 
   if (tile->next)
     tile->next->prev = tile->prev;
   else
-    tile_list.last = tile->prev;
+    shard->tile_list.last = tile->prev;
 
   if (tile->prev)
     tile->prev->next = tile->next;
   else
-    tile_list.first = tile->next;
+    shard->tile_list.first = tile->next;
 
-  if (tile == idle_scan_last)
-    idle_scan_last = tile->next;
+  if (tile == shard->idle_scan_last)
+    shard->idle_scan_last = tile->next;
 
   tile->next = tile->prev = NULL;
 }
 
+/*  called with the shard lock held  */
 static gboolean
-tile_cache_zorch_next (void)
+tile_cache_zorch_next (TileCacheShard *shard)
 {
 
-  Tile *tile = tile_list.first;
+  Tile *tile = shard->tile_list.first;
 
   if (! tile)
     return FALSE;
@@ -323,22 +482,22 @@ tile_cache_zorch_next (void)
     }
 #endif
 
-  tile_cache_flush_internal (tile);
+  tile_cache_flush_internal (shard, tile);
 
+  /*  try to keep the tile in memory in compressed form first  */
+  if (tile_compress_store (tile))
+    return TRUE;
+
+  /*  this may hand the data over to the swap writer thread  */
   if (PENDING_WRITE (tile))
     {
       idle_delay = 1;
-      tile_swap_out (tile);
+      tile_swap_evict (tile);
     }
 
   if (! tile->dirty)
     {
-      g_free (tile->data);
-      tile->data = NULL;
-
-#ifdef TILE_PROFILING
-      tile_exist_count--;
-#endif
+      tile_free_data (tile);
       return TRUE;
     }
 
@@ -346,10 +505,58 @@ tile_cache_zorch_next (void)
   return FALSE;
 }
 
+/*  called without any shard lock held  */
+static gboolean
+tile_cache_zorch_other (TileCacheShard *except)
+{
+  gint i;
+
+  for (i = 0; i < TILE_CACHE_N_SHARDS; i++)
+    {
+      TileCacheShard *shard = &tile_cache_shards[i];
+      gboolean        zorched;
+
+      if (shard == except)
+        continue;
+
+      TILE_CACHE_LOCK (shard);
+      zorched = tile_cache_zorch_next (shard);
+      TILE_CACHE_UNLOCK (shard);
+
+      if (zorched)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/*  shards are locked independently, so make sure that only one
+ *  thread ever installs the idle swapper
+ */
+static void
+tile_idle_preswap_start (void)
+{
+  IDLE_SWAPPER_LOCK;
+
+  if (! idle_swapper)
+    {
+#ifdef TILE_PROFILING
+      g_printerr("idle swapper -> started\n");
+      g_printerr("idle swapper -> waiting");
+#endif
+      idle_delay = 0;
+      idle_swapper = g_timeout_add_full (G_PRIORITY_LOW,
+                                         IDLE_SWAPPER_START,
+                                         tile_idle_preswap,
+                                         NULL, NULL);
+    }
+
+  IDLE_SWAPPER_UNLOCK;
+}
+
 static gboolean
 tile_idle_preswap_run (gpointer data)
 {
-  Tile *tile;
   int count = 0;
 
   if (idle_delay)
@@ -366,52 +573,60 @@ tile_idle_preswap_run (gpointer data)
       return FALSE;
     }
 
-  TILE_CACHE_LOCK;
-
 #ifdef TILE_PROFILING
   g_printerr(".");
 #endif
 
-  tile = idle_scan_last;
-
-  while (tile)
+  for (; idle_scan_shard < TILE_CACHE_N_SHARDS; idle_scan_shard++)
     {
-      if (PENDING_WRITE (tile))
+      TileCacheShard *shard = &tile_cache_shards[idle_scan_shard];
+      Tile           *tile;
+
+      TILE_CACHE_LOCK (shard);
+
+      tile = shard->idle_scan_last;
+
+      while (tile)
         {
-          idle_scan_last = tile->next;
+          if (PENDING_WRITE (tile))
+            {
+              shard->idle_scan_last = tile->next;
 
 #ifdef TILE_PROFILING
-          tile_idle_swapout++;
+              tile_idle_swapout++;
 #endif
-          tile_swap_out (tile);
+              tile_swap_out (tile);
 
-          if (! PENDING_WRITE(tile))
-            cur_cache_dirty -= tile->size;
+              if (! PENDING_WRITE(tile))
+                shard->cur_dirty -= tile->size;
 
-          count++;
-          if (count >= IDLE_SWAPPER_TILES_PER_INTERVAL)
-            {
-              TILE_CACHE_UNLOCK;
-              return TRUE;
+              count++;
+              if (count >= IDLE_SWAPPER_TILES_PER_INTERVAL)
+                {
+                  TILE_CACHE_UNLOCK (shard);
+                  return TRUE;
+                }
             }
+
+          tile = tile->next;
         }
 
-      tile = tile->next;
+      shard->idle_scan_last = NULL;
+
+      TILE_CACHE_UNLOCK (shard);
     }
 
 #ifdef TILE_PROFILING
   g_printerr ("\nidle swapper -> stopped\n");
 #endif
 
-  idle_scan_last = NULL;
+  idle_scan_shard = 0;
   idle_swapper = 0;
 
 #ifdef TILE_PROFILING
   tile_verify ();
 #endif
 
-  TILE_CACHE_UNLOCK;
-
   return FALSE;
 }
 
@@ -432,6 +647,7 @@ tile_idle_preswap (gpointer data)
   g_printerr("\nidle swapper -> running");
 #endif
 
+  idle_scan_shard = 0;
   idle_swapper = g_timeout_add_full (G_PRIORITY_LOW,
 				     IDLE_SWAPPER_INTERVAL_MS,
 				     tile_idle_preswap_run,
@@ -443,40 +659,55 @@ tile_idle_preswap (gpointer data)
 static void
 tile_verify (void)
 {
-  /* scan list linearly, count metrics, compare to running totals */
-  const Tile *t;
-  guint64     local_size  = 0;
-  guint64     local_dirty = 0;
-  guint64     acc         = 0;
+  /* scan lists linearly, count metrics, compare to running totals */
+  guint64 total_size = 0;
+  gint    i;
 
-  for (t = tile_list.first; t; t = t->next)
+  for (i = 0; i < TILE_CACHE_N_SHARDS; i++)
     {
-      local_size += t->size;
+      TileCacheShard *shard       = &tile_cache_shards[i];
+      const Tile     *t;
+      guint64         local_dirty = 0;
+      guint64         acc         = 0;
 
-      if (PENDING_WRITE (t))
-        local_dirty += t->size;
-    }
+      TILE_CACHE_LOCK (shard);
 
-  if (local_size != cur_cache_size)
-    g_printerr ("\nCache size mismatch: running=%"G_GUINT64_FORMAT
-                ", tested=%"G_GUINT64_FORMAT"\n",
-                cur_cache_size,local_size);
+      for (t = shard->tile_list.first; t; t = t->next)
+        {
+          total_size += t->size;
 
-  if (local_dirty != cur_cache_dirty)
-    g_printerr ("\nCache dirty mismatch: running=%"G_GUINT64_FORMAT
-                ", tested=%"G_GUINT64_FORMAT"\n",
-                cur_cache_dirty,local_dirty);
+          if (PENDING_WRITE (t))
+            local_dirty += t->size;
+        }
 
-  /* scan forward from scan list */
-  for (t = idle_scan_last; t; t = t->next)
-    {
-      if (PENDING_WRITE (t))
-        acc += t->size;
+      if (local_dirty != shard->cur_dirty)
+        g_printerr ("\nCache dirty mismatch in shard %d: "
+                    "running=%"G_GUINT64_FORMAT
+                    ", tested=%"G_GUINT64_FORMAT"\n",
+                    i, shard->cur_dirty, local_dirty);
+
+      /* scan forward from scan list */
+      for (t = shard->idle_scan_last; t; t = t->next)
+        {
+          if (PENDING_WRITE (t))
+            acc += t->size;
+        }
+
+      if (acc != local_dirty)
+        g_printerr ("\nDirty scan follower mismatch in shard %d: "
+                    "running=%"G_GUINT64_FORMAT
+                    ", tested=%"G_GUINT64_FORMAT"\n",
+                    i, acc, local_dirty);
+
+      TILE_CACHE_UNLOCK (shard);
     }
 
-  if (acc != local_dirty)
-    g_printerr ("\nDirty scan follower mismatch: running=%"G_GUINT64_FORMAT
+  /* the total is only kept approximately, so this may legitimately
+   * differ while other threads are inserting or flushing tiles
+   */
+  if (total_size != CACHE_SIZE ())
+    g_printerr ("\nCache size mismatch: running=%"G_GUINT64_FORMAT
                 ", tested=%"G_GUINT64_FORMAT"\n",
-                acc,local_dirty);
+                CACHE_SIZE (), total_size);
 }
 #endif
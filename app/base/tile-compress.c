@@ -0,0 +1,477 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The compressed tile tier sits between the tile cache and the swap
+ *  file.  Tiles evicted from the tile cache are run-length encoded
+ *  pixel by pixel and kept in memory as long as the tier has room,
+ *  which works very well for flat or mostly transparent layers.
+ *  Tiles only move on to the swap file when they don't compress well
+ *  or when they are pushed out of the tier.
+ *
+ * The tier is exclusive: a tile's data is either in the tile cache
+ *  (or locked), in the tier, or on disk, so a tile that is fetched
+ *  from the tier is removed from it.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "base-types.h"
+
+#include "tile.h"
+#include "tile-compress.h"
+#include "tile-swap.h"
+#include "tile-rowhints.h"
+#include "tile-private.h"
+
+
+/*  don't keep tiles that compress to more than this fraction  */
+#define MAX_RATIO_NUM  3
+#define MAX_RATIO_DEN  4
+
+/*  the longest run/literal a single RLE header byte can describe  */
+#define MAX_LITERAL    128
+#define MAX_REPEAT     129
+
+
+struct _TileCompressed
+{
+  Tile           *tile;
+  TileCompressed *next;      /* LRU list, most recently stored last */
+  TileCompressed *prev;
+  guchar         *data;
+  gint            size;
+  gboolean        dirty;     /* the swap file doesn't have this data */
+};
+
+
+static TileCompressed *tier_first      = NULL;
+static TileCompressed *tier_last       = NULL;
+static guint64         tier_max_size   = 0;
+static guint64         tier_cur_size   = 0;
+static guint64         tier_raw_size   = 0;
+
+static guint64         tier_lookups    = 0;
+static guint64         tier_hits       = 0;
+
+#ifdef ENABLE_MP
+
+static GMutex         *tier_mutex      = NULL;
+
+#define TILE_COMPRESS_LOCK    g_mutex_lock (tier_mutex)
+#define TILE_COMPRESS_UNLOCK  g_mutex_unlock (tier_mutex)
+
+#else
+
+#define TILE_COMPRESS_LOCK    /* nothing */
+#define TILE_COMPRESS_UNLOCK  /* nothing */
+
+#endif
+
+#define BLOCK_MEMSIZE(b) ((b)->size + sizeof (TileCompressed))
+
+
+static void      tile_compress_unlink (TileCompressed *block);
+static void      tile_compress_free   (TileCompressed *block);
+static gboolean  tile_compress_evict  (void);
+
+
+void
+tile_compress_init (guint64 size)
+{
+#ifdef ENABLE_MP
+  g_return_if_fail (tier_mutex == NULL);
+
+  tier_mutex = g_mutex_new ();
+#endif
+
+  tier_first    = tier_last = NULL;
+  tier_max_size = size;
+  tier_cur_size = 0;
+  tier_raw_size = 0;
+  tier_lookups  = 0;
+  tier_hits     = 0;
+}
+
+void
+tile_compress_exit (void)
+{
+  tile_compress_set_size (0);
+
+#ifdef ENABLE_MP
+  g_mutex_free (tier_mutex);
+  tier_mutex = NULL;
+#endif
+}
+
+void
+tile_compress_set_size (guint64 size)
+{
+  TILE_COMPRESS_LOCK;
+
+  tier_max_size = size;
+
+  while (tier_cur_size > tier_max_size)
+    {
+      if (! tile_compress_evict ())
+        break;
+    }
+
+  TILE_COMPRESS_UNLOCK;
+}
+
+gboolean
+tile_compress_store (Tile *tile)
+{
+  guchar          buf[TILE_WIDTH * TILE_HEIGHT * MAX_CHANNELS];
+  TileCompressed *block;
+  gint            size;
+
+  /*  mapped tiles are paged out by the kernel, leave them alone  */
+  if (! tier_max_size || ! tile->data || tile->mapped)
+    return FALSE;
+
+  size = tile_compress_rle (tile->data,
+                            tile->ewidth * tile->eheight, tile->bpp,
+                            buf,
+                            tile->size * MAX_RATIO_NUM / MAX_RATIO_DEN);
+
+  if (! size)
+    return FALSE;
+
+  TILE_COMPRESS_LOCK;
+
+  if (size + sizeof (TileCompressed) > tier_max_size)
+    {
+      TILE_COMPRESS_UNLOCK;
+      return FALSE;
+    }
+
+  while (tier_cur_size + size + sizeof (TileCompressed) > tier_max_size)
+    {
+      if (! tile_compress_evict ())
+        {
+          TILE_COMPRESS_UNLOCK;
+          return FALSE;
+        }
+    }
+
+  block = g_slice_new (TileCompressed);
+
+  block->tile  = tile;
+  block->data  = g_memdup (buf, size);
+  block->size  = size;
+  block->dirty = tile->dirty || tile->swap_offset == -1;
+  block->next  = NULL;
+  block->prev  = tier_last;
+
+  if (tier_last)
+    tier_last->next = block;
+  else
+    tier_first = block;
+
+  tier_last = block;
+
+  tier_cur_size += BLOCK_MEMSIZE (block);
+  tier_raw_size += tile->size;
+
+  tile->compressed = block;
+
+  tile_free_data (tile);
+  tile->dirty = FALSE;
+
+  TILE_COMPRESS_UNLOCK;
+
+  return TRUE;
+}
+
+gboolean
+tile_compress_fetch (Tile *tile)
+{
+  TileCompressed *block;
+  gboolean        success;
+
+  if (! tile->compressed && tile->swap_offset == -1)
+    return FALSE;
+
+  TILE_COMPRESS_LOCK;
+
+  tier_lookups++;
+
+  block = tile->compressed;
+
+  if (! block)
+    {
+      TILE_COMPRESS_UNLOCK;
+      return FALSE;
+    }
+
+  tier_hits++;
+
+  tile_compress_unlink (block);
+
+  tile_alloc (tile);
+
+  success = tile_decompress_rle (block->data, block->size, tile->bpp,
+                                 tile->data, tile->size);
+
+  if (G_UNLIKELY (! success))
+    g_warning ("%s: corrupt compressed tile data", G_STRFUNC);
+
+  tile->dirty = block->dirty;
+
+  tile_compress_free (block);
+
+  TILE_COMPRESS_UNLOCK;
+
+  return TRUE;
+}
+
+void
+tile_compress_drop (Tile *tile)
+{
+  TILE_COMPRESS_LOCK;
+
+  if (tile->compressed)
+    {
+      TileCompressed *block = tile->compressed;
+
+      tile_compress_unlink (block);
+      tile_compress_free (block);
+    }
+
+  TILE_COMPRESS_UNLOCK;
+}
+
+gint64
+tile_compress_get_memsize (void)
+{
+  return tier_cur_size;
+}
+
+void
+tile_compress_get_stats (gdouble *hit_rate,
+                         gdouble *ratio)
+{
+  TILE_COMPRESS_LOCK;
+
+  if (hit_rate)
+    *hit_rate = tier_lookups ? (gdouble) tier_hits / tier_lookups : 0.0;
+
+  if (ratio)
+    *ratio = tier_cur_size ? (gdouble) tier_raw_size / tier_cur_size : 0.0;
+
+  TILE_COMPRESS_UNLOCK;
+}
+
+
+static inline gboolean
+pixel_equal (const guchar *a,
+             const guchar *b,
+             gint          bpp)
+{
+  switch (bpp)
+    {
+    case 4: if (a[3] != b[3]) return FALSE;
+    case 3: if (a[2] != b[2]) return FALSE;
+    case 2: if (a[1] != b[1]) return FALSE;
+    case 1: return a[0] == b[0];
+    }
+
+  return memcmp (a, b, bpp) == 0;
+}
+
+/*  A header byte below 128 is followed by (header + 1) literal pixels,
+ *  any other header byte by a single pixel that is repeated
+ *  (header - 126) times.  Returns the compressed size, or 0 if the
+ *  result would be larger than max_size.
+ */
+gint
+tile_compress_rle (const guchar *src,
+                   gint          n_pixels,
+                   gint          bpp,
+                   guchar       *dest,
+                   gint          max_size)
+{
+  gint i    = 0;
+  gint size = 0;
+
+  while (i < n_pixels)
+    {
+      const guchar *p   = src + i * bpp;
+      gint          run = 1;
+
+      while (i + run < n_pixels &&
+             run < MAX_REPEAT   &&
+             pixel_equal (p, p + run * bpp, bpp))
+        run++;
+
+      if (run > 1)
+        {
+          if (size + 1 + bpp > max_size)
+            return 0;
+
+          dest[size++] = run + 126;
+          memcpy (dest + size, p, bpp);
+
+          size += bpp;
+          i    += run;
+        }
+      else
+        {
+          gint len = 1;
+
+          /*  stop the literal where the next repeat starts  */
+          while (i + len < n_pixels  &&
+                 len < MAX_LITERAL   &&
+                 ! (i + len + 1 < n_pixels &&
+                    pixel_equal (src + (i + len) * bpp,
+                                 src + (i + len + 1) * bpp, bpp)))
+            len++;
+
+          if (size + 1 + len * bpp > max_size)
+            return 0;
+
+          dest[size++] = len - 1;
+          memcpy (dest + size, p, len * bpp);
+
+          size += len * bpp;
+          i    += len;
+        }
+    }
+
+  return size;
+}
+
+gboolean
+tile_decompress_rle (const guchar *src,
+                     gint          src_size,
+                     gint          bpp,
+                     guchar       *dest,
+                     gint          dest_size)
+{
+  const guchar *end = src + src_size;
+  gint          size = 0;
+
+  while (src < end)
+    {
+      gint header = *src++;
+
+      if (header < 128)
+        {
+          gint len = (header + 1) * bpp;
+
+          if (src + len > end || size + len > dest_size)
+            return FALSE;
+
+          memcpy (dest + size, src, len);
+
+          src  += len;
+          size += len;
+        }
+      else
+        {
+          gint run = header - 126;
+
+          if (src + bpp > end || size + run * bpp > dest_size)
+            return FALSE;
+
+          while (run--)
+            {
+              memcpy (dest + size, src, bpp);
+              size += bpp;
+            }
+
+          src += bpp;
+        }
+    }
+
+  return size == dest_size;
+}
+
+/*  private functions  */
+
+/*  called with the tier lock held  */
+static void
+tile_compress_unlink (TileCompressed *block)
+{
+  if (block->next)
+    block->next->prev = block->prev;
+  else
+    tier_last = block->prev;
+
+  if (block->prev)
+    block->prev->next = block->next;
+  else
+    tier_first = block->next;
+
+  block->next = block->prev = NULL;
+
+  tier_cur_size -= BLOCK_MEMSIZE (block);
+  tier_raw_size -= block->tile->size;
+
+  block->tile->compressed = NULL;
+}
+
+static void
+tile_compress_free (TileCompressed *block)
+{
+  g_free (block->data);
+  g_slice_free (TileCompressed, block);
+}
+
+/*  Pushes the least recently stored tile out of the tier, writing it
+ *  to the swap file if the swap file doesn't have its data yet.
+ *  Called with the tier lock held.
+ */
+static gboolean
+tile_compress_evict (void)
+{
+  TileCompressed *block = tier_first;
+  Tile           *tile;
+
+  if (! block)
+    return FALSE;
+
+  tile = block->tile;
+
+  tile_compress_unlink (block);
+
+  if (block->dirty || tile->swap_offset == -1)
+    {
+      tile_alloc (tile);
+
+      if (G_UNLIKELY (! tile_decompress_rle (block->data, block->size,
+                                             tile->bpp,
+                                             tile->data, tile->size)))
+        g_warning ("%s: corrupt compressed tile data", G_STRFUNC);
+
+      tile->dirty = TRUE;
+
+      tile_swap_evict (tile);
+
+      if (! tile->dirty)
+        tile_free_data (tile);
+    }
+
+  tile_compress_free (block);
+
+  return TRUE;
+}
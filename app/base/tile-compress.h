@@ -0,0 +1,59 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TILE_COMPRESS_H__
+#define __TILE_COMPRESS_H__
+
+
+void      tile_compress_init        (guint64   size);
+void      tile_compress_exit        (void);
+
+void      tile_compress_set_size    (guint64   size);
+
+/* tile_compress_store() tries to move the data of a tile that is
+ * evicted from the tile cache into the compressed tier.  On success
+ * the tile's data is freed and TRUE is returned, otherwise the tile
+ * is left untouched and has to go to the swap file.
+ */
+gboolean  tile_compress_store       (Tile     *tile);
+
+/* tile_compress_fetch() restores the data of a tile from the
+ * compressed tier, returns FALSE if the tile isn't in it.
+ */
+gboolean  tile_compress_fetch       (Tile     *tile);
+void      tile_compress_drop        (Tile     *tile);
+
+gint64    tile_compress_get_memsize (void);
+void      tile_compress_get_stats   (gdouble  *hit_rate,
+                                     gdouble  *ratio);
+
+/* The run-length codec of the compressed tier, only public for the
+ * tests.
+ */
+gint      tile_compress_rle         (const guchar *src,
+                                     gint          n_pixels,
+                                     gint          bpp,
+                                     guchar       *dest,
+                                     gint          max_size);
+gboolean  tile_decompress_rle       (const guchar *src,
+                                     gint          src_size,
+                                     gint          bpp,
+                                     guchar       *dest,
+                                     gint          dest_size);
+
+
+#endif /* __TILE_COMPRESS_H__ */
@@ -37,6 +37,9 @@ struct _TileManager
 
   gint               cached_num;    /*  number of cached tile                */
   Tile              *cached_tile;   /*  the actual cached tile               */
+
+  guint              serial;        /*  identifies the contents, 0 if they   *
+                                     *  changed since it was last asked for  */
 };
 
 
@@ -25,6 +25,7 @@
 
 #include "tile.h"
 #include "tile-cache.h"
+#include "tile-compress.h"
 #include "tile-manager.h"
 #include "tile-manager-private.h"
 #include "tile-rowhints.h"
@@ -34,6 +35,9 @@
 
 static void  tile_manager_allocate_tiles (TileManager *tm);
 
+/*  the last serial handed out by tile_manager_get_serial()  */
+static guint tile_manager_serial = 0;
+
 #ifdef TILE_PROFILING
 extern gint tile_exist_peak;
 extern gint tile_exist_count;
@@ -169,17 +173,33 @@ tile_manager_duplicate (TileManager *tm)
 
   copy = tile_manager_new (tm->width, tm->height, tm->bpp);
 
-  tile_manager_allocate_tiles (copy);
+  /*  the copy has the same contents  */
+  copy->serial = tile_manager_get_serial (tm);
+
+  if (! tm->tiles)
+    tile_manager_allocate_tiles (tm);
 
   n_tiles = tm->ntile_rows * tm->ntile_cols;
 
+  copy->tiles = g_new (Tile *, n_tiles);
+
+  /*  Share all tiles with the copy, they are copied on write by
+   *  tile_manager_get().  Valid tiles don't need to be swapped in for
+   *  this, only invalid ones have to be validated first because the
+   *  copy doesn't have the validate proc.
+   */
   for (i = 0; i < n_tiles; i++)
     {
-      Tile *tile;
+      Tile *tile = tm->tiles[i];
 
-      tile = tile_manager_get (tm, i, TRUE, FALSE);
-      tile_manager_map (copy, i, tile);
-      tile_release (tile, FALSE);
+      if (! tile->valid)
+        {
+          tile = tile_manager_get (tm, i, TRUE, FALSE);
+          tile_release (tile, FALSE);
+        }
+
+      tile_attach (tile, copy, i);
+      copy->tiles[i] = tile;
     }
 
   return copy;
@@ -299,6 +319,8 @@ tile_manager_get (TileManager *tm,
 	  tile_lock (tile);
           tile->write_count++;
           tile->dirty = TRUE;
+
+          tm->serial = 0;
         }
       else
         {
@@ -401,6 +423,8 @@ tile_manager_invalidate_tile (TileManager  *tm,
   if (! tile->valid)
     return;
 
+  tm->serial = 0;
+
   if (tile_num == tm->cached_num)
     {
       tile_release (tm->cached_tile, FALSE);
@@ -430,14 +454,10 @@ tile_manager_invalidate_tile (TileManager  *tm,
 
   tile->valid = FALSE;
 
-  if (tile->data)
-    {
-      g_free (tile->data);
-      tile->data = NULL;
-#ifdef TILE_PROFILING
-      tile_exist_count--;
-#endif
-    }
+  /*  see tile_destroy()  */
+  tile_compress_drop (tile);
+
+  tile_free_data (tile);
 
   if (tile->swap_offset != -1)
     {
@@ -524,6 +544,7 @@ tile_manager_map (TileManager *tm,
   tile_attach (srctile, tm, tile_num);
 
   tm->tiles[tile_num] = srctile;
+  tm->serial          = 0;
 
 #ifdef DEBUG_TILE_MANAGER
   g_printerr ("}\n");
@@ -551,6 +572,17 @@ tile_manager_invalidate_area (TileManager *tm,
       }
 }
 
+guint
+tile_manager_get_serial (TileManager *tm)
+{
+  g_return_val_if_fail (tm != NULL, 0);
+
+  if (! tm->serial)
+    tm->serial = ++tile_manager_serial;
+
+  return tm->serial;
+}
+
 gint
 tile_manager_width (const TileManager *tm)
 {
@@ -99,6 +99,14 @@ gint          tile_manager_bpp               (const TileManager *tm);
 gint64        tile_manager_get_memsize       (const TileManager *tm,
                                               gboolean           sparse);
 
+/* Returns a number that identifies the current contents of the tile
+ *  manager.  It stays the same until a tile is written to, mapped or
+ *  invalidated; after that a new serial is handed out.  Serials are
+ *  never reused, so two tile managers with the same serial have the
+ *  same contents.
+ */
+guint         tile_manager_get_serial        (TileManager       *tm);
+
 void          tile_manager_get_tile_coordinates (TileManager *tm,
                                                  Tile        *tile,
                                                  gint        *x,
@@ -23,7 +23,8 @@
 /*  #define TILE_PROFILING */
 
 
-typedef struct _TileLink TileLink;
+typedef struct _TileLink       TileLink;
+typedef struct _TileCompressed TileCompressed;
 
 struct _TileLink
 {
@@ -52,6 +53,7 @@ struct _Tile
   guint   dirty : 1;    /* is the tile dirty? has it been modified? */
   guint   valid : 1;    /* is the tile valid? */
   guint  cached : 1;    /* is the tile cached */
+  guint  mapped : 1;    /* does "data" point into the swap file mapping? */
 
 #ifdef TILE_PROFILING
 
@@ -84,6 +86,10 @@ struct _Tile
                          * to -1.
                          */
 
+  TileCompressed *compressed; /* the tile's data in the compressed tier,
+                               * or NULL
+                               */
+
   TileLink *tlink;
 
   Tile     *next;       /* List pointers for the tile cache lists */
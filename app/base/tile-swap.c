@@ -19,12 +19,22 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
 
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
 #include <glib-object.h>
 #include <glib/gstdio.h>
 
@@ -51,6 +61,7 @@
 #include "tile-swap.h"
 #include "tile-private.h"
 #include "tile-cache.h"
+#include "tile-compress.h"
 
 #include "gimp-intl.h"
 
@@ -58,6 +69,7 @@ typedef enum
 {
   SWAP_IN = 1,
   SWAP_OUT,
+  SWAP_EVICT,
   SWAP_DELETE
 } SwapCommand;
 
@@ -69,17 +81,57 @@ typedef gint (* SwapFunc) (gint         fd,
 
 #define MAX_OPEN_SWAP_FILES  16
 
+/*  With threads and pwrite() available, tiles evicted from the tile
+ *  cache are handed to a writer thread instead of being written by
+ *  the thread that needs the memory.
+ */
+#if defined (ENABLE_MP) && defined (HAVE_PWRITE)
+#define TILE_SWAP_ASYNC  1
+#endif
+
+#define SWAP_QUEUE_MAX_BYTES  (1024 * TILE_WIDTH * TILE_HEIGHT * 4)
+#define SWAP_WRITE_BATCH      256
+
+#if defined (IOV_MAX) && IOV_MAX < SWAP_WRITE_BATCH
+#define SWAP_WRITE_IOV_MAX    IOV_MAX
+#else
+#define SWAP_WRITE_IOV_MAX    SWAP_WRITE_BATCH
+#endif
+
+/*  Where the address space is large enough, the swap file can be
+ *  mapped into memory in large chunks instead, if the "swap-mmap"
+ *  gimprc option is set.  Free space is then tracked
+ *  with a bitmap of page sized units, and swapped in tiles point
+ *  directly into the mapping.
+ */
+#if defined (HAVE_MMAP) && GLIB_SIZEOF_VOID_P >= 8
+#define TILE_SWAP_MMAP  1
+#endif
+
+#define SWAP_UNIT_SIZE        (TILE_WIDTH * TILE_HEIGHT)
+#define SWAP_CHUNK_UNITS      16384
+#define SWAP_CHUNK_SIZE       ((gint64) SWAP_UNIT_SIZE * SWAP_CHUNK_UNITS)
+
 
 typedef struct _SwapFile     SwapFile;
 typedef struct _SwapFileGap  SwapFileGap;
 
 struct _SwapFile
 {
-  gchar   *filename;
-  gint     fd;
-  GList   *gaps;
-  gint64   swap_file_end;
-  gint64   cur_position;
+  gchar     *filename;
+  gint       fd;
+  GList     *gaps;
+  gint64     swap_file_end;
+  gint64     cur_position;
+
+#ifdef TILE_SWAP_MMAP
+  gboolean   mapped;       /* use the mmap() backend                 */
+  GPtrArray *chunks;       /* the mapped chunks of the file          */
+  gint      *chunk_used;   /* number of used units per chunk         */
+  guint32   *units;        /* bitmap of used units                   */
+  gint       n_units;
+  gint       first_free;   /* there is no free unit below this one   */
+#endif
 };
 
 struct _SwapFileGap
@@ -88,6 +140,23 @@ struct _SwapFileGap
   gint64 end;
 };
 
+#ifdef TILE_SWAP_ASYNC
+
+typedef struct _SwapRequest  SwapRequest;
+
+struct _SwapRequest
+{
+  Tile     *tile;      /* NULL if the tile was deleted while writing   */
+  guchar   *data;      /* the evicted tile data, owned by the request  */
+  gint      size;
+  gint64    offset;
+  gint64    end;       /* end of the swap slot                         */
+  gboolean  writing;   /* picked up by the writer thread               */
+  gboolean  failed;    /* writing failed, the data waits to be reclaimed */
+};
+
+#endif
+
 
 static void          tile_swap_command        (Tile        *tile,
                                                gint         command);
@@ -103,10 +172,33 @@ static gint64        tile_swap_find_offset    (SwapFile    *swap_file,
 static void          tile_swap_open           (SwapFile    *swap_file);
 static void          tile_swap_resize         (SwapFile    *swap_file,
                                                gint64       new_size);
+static void          tile_swap_release_range  (SwapFile    *swap_file,
+                                               gint64       start,
+                                               gint64       end);
 static SwapFileGap * tile_swap_gap_new        (gint64       start,
                                                gint64       end);
 static void          tile_swap_gap_destroy    (SwapFileGap *gap);
 
+#ifdef TILE_SWAP_MMAP
+static void          tile_swap_mmap_in        (SwapFile    *swap_file,
+                                               Tile        *tile);
+static void          tile_swap_mmap_out       (SwapFile    *swap_file,
+                                               Tile        *tile);
+static void          tile_swap_mmap_delete    (SwapFile    *swap_file,
+                                               Tile        *tile);
+static void          tile_swap_mmap_close     (SwapFile    *swap_file);
+#endif
+
+#ifdef TILE_SWAP_ASYNC
+static void          tile_swap_queue_out      (SwapFile    *swap_file,
+                                               Tile        *tile);
+static gboolean      tile_swap_reclaim        (Tile        *tile);
+static gboolean      tile_swap_cancel         (SwapFile    *swap_file,
+                                               Tile        *tile);
+static void          tile_swap_wait_written   (Tile        *tile);
+static gpointer      tile_swap_writer         (gpointer     data);
+#endif
+
 
 static SwapFile     * gimp_swap_file   = NULL;
 
@@ -115,8 +207,43 @@ static const guint64  swap_file_grow   = 1024 * TILE_WIDTH * TILE_HEIGHT * 4;
 static gboolean       seek_err_msg     = TRUE;
 static gboolean       read_err_msg     = TRUE;
 static gboolean       write_err_msg    = TRUE;
+#ifdef TILE_SWAP_MMAP
+static gboolean       map_err_msg      = TRUE;
+#endif
+
+#ifdef ENABLE_MP
+
+/*  the tile cache shards evict tiles concurrently, serialize the
+ *  actual accesses to the swap file
+ */
+static GMutex       * swap_mutex       = NULL;
+
+#define TILE_SWAP_LOCK    g_mutex_lock (swap_mutex)
+#define TILE_SWAP_UNLOCK  g_mutex_unlock (swap_mutex)
+
+#else
+
+#define TILE_SWAP_LOCK    /* nothing */
+#define TILE_SWAP_UNLOCK  /* nothing */
+
+#endif
+
+#ifdef TILE_SWAP_ASYNC
+
+static GThread      * swap_writer        = NULL;
+static gboolean       swap_writer_quit   = FALSE;
+static GQueue         swap_queue         = G_QUEUE_INIT;
+static gint64         swap_queue_bytes   = 0;
+static GHashTable   * swap_pending       = NULL;  /* Tile -> SwapRequest */
+static GCond        * swap_queue_cond    = NULL;  /* wakes up the writer */
+static GCond        * swap_done_cond     = NULL;  /* a batch was written */
+static gint           swap_write_errno   = 0;
+
+#endif
 
 #ifdef TILE_PROFILING
+extern gint           tile_exist_count;
+
 static gulong         tile_total_seek = 0;
 
 /* how many tiles were swapped out under cache pressure but never
@@ -191,7 +318,8 @@ tile_swap_print_gaps (SwapFile *swap_file)
 #endif
 
 void
-tile_swap_init (const gchar *path)
+tile_swap_init (const gchar *path,
+                gboolean     mapped)
 {
   gchar *basename;
   gchar *dirname;
@@ -217,6 +345,25 @@ tile_swap_init (const gchar *path)
   gimp_swap_file->cur_position  = 0;
   gimp_swap_file->fd            = -1;
 
+#ifdef TILE_SWAP_MMAP
+  gimp_swap_file->mapped        = mapped;
+  gimp_swap_file->chunks        = g_ptr_array_new ();
+  gimp_swap_file->chunk_used    = NULL;
+  gimp_swap_file->units         = NULL;
+  gimp_swap_file->n_units       = 0;
+  gimp_swap_file->first_free    = 0;
+#endif
+
+#ifdef ENABLE_MP
+  swap_mutex = g_mutex_new ();
+#endif
+
+#ifdef TILE_SWAP_ASYNC
+  swap_pending    = g_hash_table_new (g_direct_hash, g_direct_equal);
+  swap_queue_cond = g_cond_new ();
+  swap_done_cond  = g_cond_new ();
+#endif
+
   g_free (basename);
   g_free (dirname);
 }
@@ -251,6 +398,13 @@ tile_swap_exit (void)
               tile_total_interactive_sec +
               0.000001 * tile_total_interactive_usec);
 
+  {
+    extern volatile gint tile_cache_contention;
+
+    g_printerr ("Total contended tile cache locks: %d\n\n",
+                g_atomic_int_get (&tile_cache_contention));
+  }
+
 #endif
 
   if (tile_global_refcount () != 0)
@@ -258,6 +412,32 @@ tile_swap_exit (void)
 
   g_return_if_fail (gimp_swap_file != NULL);
 
+#ifdef TILE_SWAP_ASYNC
+  if (swap_writer)
+    {
+      TILE_SWAP_LOCK;
+      swap_writer_quit = TRUE;
+      g_cond_signal (swap_queue_cond);
+      TILE_SWAP_UNLOCK;
+
+      g_thread_join (swap_writer);
+      swap_writer = NULL;
+    }
+
+  g_hash_table_destroy (swap_pending);
+  swap_pending = NULL;
+
+  g_cond_free (swap_queue_cond);
+  swap_queue_cond = NULL;
+
+  g_cond_free (swap_done_cond);
+  swap_done_cond = NULL;
+#endif
+
+#ifdef TILE_SWAP_MMAP
+  tile_swap_mmap_close (gimp_swap_file);
+#endif
+
 #ifdef GIMP_UNSTABLE
   if (gimp_swap_file->swap_file_end != 0)
     {
@@ -282,6 +462,11 @@ tile_swap_exit (void)
   g_slice_free (SwapFile, gimp_swap_file);
 
   gimp_swap_file = NULL;
+
+#ifdef ENABLE_MP
+  g_mutex_free (swap_mutex);
+  swap_mutex = NULL;
+#endif
 }
 
 /* check if we can open a swap file */
@@ -310,6 +495,9 @@ tile_swap_test (void)
 void
 tile_swap_in (Tile *tile)
 {
+  if (tile_compress_fetch (tile))
+    return;
+
   if (tile->swap_offset == -1)
     {
       tile_alloc (tile);
@@ -325,6 +513,12 @@ tile_swap_out (Tile *tile)
   tile_swap_command (tile, SWAP_OUT);
 }
 
+void
+tile_swap_evict (Tile *tile)
+{
+  tile_swap_command (tile, SWAP_EVICT);
+}
+
 void
 tile_swap_delete (Tile *tile)
 {
@@ -335,26 +529,84 @@ static void
 tile_swap_command (Tile *tile,
                    gint  command)
 {
+  TILE_SWAP_LOCK;
+
   if (gimp_swap_file->fd == -1)
     {
       tile_swap_open (gimp_swap_file);
 
       if (G_UNLIKELY (gimp_swap_file->fd == -1))
-        return;
+        {
+          TILE_SWAP_UNLOCK;
+          return;
+        }
+    }
+
+#ifdef TILE_SWAP_MMAP
+  if (gimp_swap_file->mapped)
+    {
+      switch (command)
+        {
+        case SWAP_IN:
+          tile_swap_mmap_in (gimp_swap_file, tile);
+          break;
+        case SWAP_OUT:
+        case SWAP_EVICT:
+          tile_swap_mmap_out (gimp_swap_file, tile);
+          break;
+        case SWAP_DELETE:
+          tile_swap_mmap_delete (gimp_swap_file, tile);
+          break;
+        }
+
+      TILE_SWAP_UNLOCK;
+      return;
+    }
+#endif
+
+#ifdef TILE_SWAP_ASYNC
+  if (G_UNLIKELY (swap_write_errno))
+    {
+      if (write_err_msg)
+        g_message ("unable to write tile data to disk: %s",
+                   g_strerror (swap_write_errno));
+      write_err_msg = FALSE;
+      swap_write_errno = 0;
     }
+#endif
 
   switch (command)
     {
     case SWAP_IN:
+#ifdef TILE_SWAP_ASYNC
+      if (tile_swap_reclaim (tile))
+        break;
+#endif
       tile_swap_default_in (gimp_swap_file, tile);
       break;
     case SWAP_OUT:
+#ifdef TILE_SWAP_ASYNC
+      tile_swap_wait_written (tile);
+#endif
       tile_swap_default_out (gimp_swap_file, tile);
       break;
+    case SWAP_EVICT:
+#ifdef TILE_SWAP_ASYNC
+      tile_swap_queue_out (gimp_swap_file, tile);
+#else
+      tile_swap_default_out (gimp_swap_file, tile);
+#endif
+      break;
     case SWAP_DELETE:
+#ifdef TILE_SWAP_ASYNC
+      if (tile_swap_cancel (gimp_swap_file, tile))
+        break;
+#endif
       tile_swap_default_delete (gimp_swap_file, tile);
       break;
     }
+
+  TILE_SWAP_UNLOCK;
 }
 
 /* The actual swap file code. The swap file consists of tiles
@@ -585,12 +837,8 @@ static void
 tile_swap_default_delete (SwapFile *swap_file,
                           Tile     *tile)
 {
-  SwapFileGap *gap;
-  SwapFileGap *gap2;
-  GList       *tmp;
-  GList       *tmp2;
-  gint64       start;
-  gint64       end;
+  gint64 start;
+  gint64 end;
 
   if (tile->swap_offset == -1)
     return;
@@ -607,6 +855,19 @@ tile_swap_default_delete (SwapFile *swap_file,
   end = start + TILE_WIDTH * TILE_HEIGHT * tile->bpp;
   tile->swap_offset = -1;
 
+  tile_swap_release_range (swap_file, start, end);
+}
+
+static void
+tile_swap_release_range (SwapFile *swap_file,
+                         gint64    start,
+                         gint64    end)
+{
+  SwapFileGap *gap;
+  SwapFileGap *gap2;
+  GList       *tmp;
+  GList       *tmp2;
+
   tmp = swap_file->gaps;
   while (tmp)
     {
@@ -791,3 +1052,692 @@ tile_swap_gap_destroy (SwapFileGap *gap)
 {
   g_slice_free (SwapFileGap, gap);
 }
+
+#ifdef TILE_SWAP_MMAP
+
+/* The mmap() backend.  The swap file is mapped in chunks of
+ *  SWAP_CHUNK_SIZE bytes and divided into units of SWAP_UNIT_SIZE
+ *  bytes, a tile occupies bpp consecutive units which never straddle
+ *  two chunks.  Swapping a tile in only points its data into the
+ *  mapping, the kernel does the actual paging.
+ */
+
+#define UNIT_IS_USED(s,u)  ((s)->units[(u) >> 5] &   (1u << ((u) & 31)))
+#define UNIT_SET_USED(s,u) ((s)->units[(u) >> 5] |=  (1u << ((u) & 31)))
+#define UNIT_SET_FREE(s,u) ((s)->units[(u) >> 5] &= ~(1u << ((u) & 31)))
+
+#define UNIT_OFFSET(u)     ((gint64) (u) * SWAP_UNIT_SIZE)
+#define UNIT_CHUNK(u)      ((u) / SWAP_CHUNK_UNITS)
+
+static gboolean
+tile_swap_mmap_grow (SwapFile *swap_file)
+{
+  gint64   new_end = swap_file->swap_file_end + SWAP_CHUNK_SIZE;
+  gpointer base;
+  gint     n_chunks;
+
+  if (LARGE_TRUNCATE (swap_file->fd, new_end) != 0)
+    {
+      if (map_err_msg)
+        g_message ("unable to grow swap file: %s", g_strerror (errno));
+      map_err_msg = FALSE;
+      return FALSE;
+    }
+
+  base = mmap (NULL, SWAP_CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+               swap_file->fd, swap_file->swap_file_end);
+
+  if (base == MAP_FAILED)
+    {
+      LARGE_TRUNCATE (swap_file->fd, swap_file->swap_file_end);
+
+      /*  the first chunk failing makes us fall back to plain I/O  */
+      if (swap_file->chunks->len > 0)
+        {
+          if (map_err_msg)
+            g_message ("unable to map swap file: %s", g_strerror (errno));
+          map_err_msg = FALSE;
+        }
+
+      return FALSE;
+    }
+
+  g_ptr_array_add (swap_file->chunks, base);
+  n_chunks = swap_file->chunks->len;
+
+  swap_file->chunk_used = g_renew (gint, swap_file->chunk_used, n_chunks);
+  swap_file->chunk_used[n_chunks - 1] = 0;
+
+  swap_file->units = g_renew (guint32, swap_file->units,
+                              n_chunks * SWAP_CHUNK_UNITS / 32);
+  memset (swap_file->units + swap_file->n_units / 32, 0,
+          SWAP_CHUNK_UNITS / 8);
+
+  swap_file->n_units       += SWAP_CHUNK_UNITS;
+  swap_file->swap_file_end  = new_end;
+
+  map_err_msg = TRUE;
+
+  return TRUE;
+}
+
+/*  releases the last chunk, but only if the one before it is free
+ *  too, so we don't map and unmap a chunk over and over again
+ */
+static void
+tile_swap_mmap_shrink (SwapFile *swap_file)
+{
+  gint n_chunks = swap_file->chunks->len;
+
+  while (n_chunks > 1                            &&
+         swap_file->chunk_used[n_chunks - 1] == 0 &&
+         swap_file->chunk_used[n_chunks - 2] == 0)
+    {
+      munmap (g_ptr_array_index (swap_file->chunks, n_chunks - 1),
+              SWAP_CHUNK_SIZE);
+      g_ptr_array_set_size (swap_file->chunks, --n_chunks);
+
+      swap_file->n_units -= SWAP_CHUNK_UNITS;
+      swap_file->first_free = MIN (swap_file->first_free, swap_file->n_units);
+
+      tile_swap_resize (swap_file, UNIT_OFFSET (swap_file->n_units));
+    }
+}
+
+/*  returns the first of n_units free consecutive units within one
+ *  chunk, or -1 if the swap file can't be grown
+ */
+static gint
+tile_swap_mmap_alloc (SwapFile *swap_file,
+                      gint      n_units)
+{
+  gint unit = swap_file->first_free;
+  gint i;
+
+  while (unit + n_units <= swap_file->n_units)
+    {
+      /*  skip completely used words of the bitmap  */
+      if ((unit & 31) == 0 && swap_file->units[unit >> 5] == 0xffffffff)
+        {
+          unit += 32;
+          continue;
+        }
+
+      if (UNIT_CHUNK (unit) != UNIT_CHUNK (unit + n_units - 1))
+        {
+          unit = (UNIT_CHUNK (unit) + 1) * SWAP_CHUNK_UNITS;
+          continue;
+        }
+
+      for (i = 0; i < n_units; i++)
+        if (UNIT_IS_USED (swap_file, unit + i))
+          break;
+
+      if (i == n_units)
+        break;
+
+      unit += i + 1;
+    }
+
+  if (unit + n_units > swap_file->n_units)
+    {
+      unit = swap_file->n_units;
+
+      if (! tile_swap_mmap_grow (swap_file))
+        return -1;
+    }
+
+  for (i = 0; i < n_units; i++)
+    UNIT_SET_USED (swap_file, unit + i);
+
+  swap_file->chunk_used[UNIT_CHUNK (unit)] += n_units;
+
+  if (unit == swap_file->first_free)
+    swap_file->first_free = unit + n_units;
+
+  return unit;
+}
+
+static inline guchar *
+tile_swap_mmap_address (SwapFile *swap_file,
+                        gint64    offset)
+{
+  guchar *base = g_ptr_array_index (swap_file->chunks,
+                                    offset / SWAP_CHUNK_SIZE);
+
+  return base + offset % SWAP_CHUNK_SIZE;
+}
+
+static void
+tile_swap_mmap_in (SwapFile *swap_file,
+                   Tile     *tile)
+{
+  if (tile->data)
+    return;
+
+#ifdef TILE_PROFILING
+  tile_total_swapin++;
+
+  if (tile->zorched)
+    tile_total_zorched_swapin++;
+
+  if (!tile->inonce)
+    tile_unique_swapin++;
+
+  tile->inonce   = TRUE;
+  tile->zorched  = FALSE;
+  tile->zorchout = FALSE;
+#endif
+
+  tile->data   = tile_swap_mmap_address (swap_file, tile->swap_offset);
+  tile->mapped = TRUE;
+}
+
+static void
+tile_swap_mmap_out (SwapFile *swap_file,
+                    Tile     *tile)
+{
+  guchar *dest;
+
+#ifdef TILE_PROFILING
+  tile_total_swapout++;
+
+  if (!tile->outonce)
+    tile_unique_swapout++;
+
+  tile->outonce = TRUE;
+#endif
+
+  if (tile->swap_offset == -1)
+    {
+      gint unit = tile_swap_mmap_alloc (swap_file, tile->bpp);
+
+      if (unit == -1)
+        {
+          if (swap_file->chunks->len == 0)
+            {
+              swap_file->mapped = FALSE;
+              tile_swap_default_out (swap_file, tile);
+            }
+
+          return;
+        }
+
+      tile->swap_offset = UNIT_OFFSET (unit);
+    }
+
+  dest = tile_swap_mmap_address (swap_file, tile->swap_offset);
+
+  /*  a tile that was swapped in before is modified in place  */
+  if (tile->data != dest)
+    {
+      memcpy (dest, tile->data, tile->size);
+
+      tile_free_data (tile);
+
+      tile->data   = dest;
+      tile->mapped = TRUE;
+    }
+
+  tile->dirty = FALSE;
+}
+
+static void
+tile_swap_mmap_delete (SwapFile *swap_file,
+                       Tile     *tile)
+{
+  gint unit;
+  gint i;
+
+  if (tile->swap_offset == -1)
+    return;
+
+#ifdef TILE_PROFILING
+  if (tile->zorchout)
+    tile_total_wasted_swapout++;
+
+  tile->zorched  = FALSE;
+  tile->zorchout = FALSE;
+#endif
+
+  /*  the slot is about to be reused, don't keep pointing into it  */
+  if (tile->mapped)
+    {
+      tile->data   = NULL;
+      tile->mapped = FALSE;
+    }
+
+  unit = tile->swap_offset / SWAP_UNIT_SIZE;
+  tile->swap_offset = -1;
+
+  for (i = 0; i < tile->bpp; i++)
+    UNIT_SET_FREE (swap_file, unit + i);
+
+  swap_file->chunk_used[UNIT_CHUNK (unit)] -= tile->bpp;
+  swap_file->first_free = MIN (swap_file->first_free, unit);
+
+  tile_swap_mmap_shrink (swap_file);
+}
+
+static void
+tile_swap_mmap_close (SwapFile *swap_file)
+{
+  gboolean empty = TRUE;
+  gint     i;
+
+  for (i = 0; i < swap_file->chunks->len; i++)
+    {
+      if (swap_file->chunk_used[i])
+        empty = FALSE;
+
+      munmap (g_ptr_array_index (swap_file->chunks, i), SWAP_CHUNK_SIZE);
+    }
+
+  /*  keep swap_file_end if there are tiles left, so that it's reported  */
+  if (swap_file->mapped && empty && swap_file->fd != -1)
+    tile_swap_resize (swap_file, 0);
+
+  g_ptr_array_free (swap_file->chunks, TRUE);
+  g_free (swap_file->chunk_used);
+  g_free (swap_file->units);
+
+  swap_file->chunks     = NULL;
+  swap_file->chunk_used = NULL;
+  swap_file->units      = NULL;
+  swap_file->n_units    = 0;
+}
+
+#endif /* TILE_SWAP_MMAP */
+
+#ifdef TILE_SWAP_ASYNC
+
+/* Asynchronous swap-out.  Tiles evicted from the tile cache are
+ *  queued for the writer thread together with their data, so the
+ *  evicting thread only pays for finding a swap slot.  The writer
+ *  sorts each batch by swap offset and writes runs of adjacent tiles
+ *  with a single vectored write.
+ *
+ * A tile whose data is still queued is recognized by its entry in
+ *  the swap_pending table.  Swapping it back in takes the data back
+ *  from the queue (or copies it while it is being written), and
+ *  deleting it drops the request or, if it is already being written,
+ *  leaves freeing the swap slot to the writer.
+ *
+ * If writing a tile fails, its request stays in swap_pending with the
+ *  data, and the tile gets it back as dirty data when it is swapped in
+ *  again, like the data of a failed synchronous write stays in memory.
+ *  If the tile already took a copy while the data was being written,
+ *  the failed request is stale and is dropped the next time the tile
+ *  is written.
+ *
+ * All of these are called with the swap lock held.
+ */
+
+static void
+tile_swap_queue_out (SwapFile *swap_file,
+                     Tile     *tile)
+{
+  SwapRequest *request;
+  gint64       offset;
+  gint         bytes;
+
+  if (! tile->data)
+    return;
+
+  /*  never have more than one write of the same tile in flight  */
+  tile_swap_wait_written (tile);
+
+  if (G_UNLIKELY (! swap_writer))
+    {
+      GError *error = NULL;
+
+      swap_writer_quit = FALSE;
+      swap_writer = g_thread_create (tile_swap_writer, swap_file,
+                                     TRUE, &error);
+
+      if (G_UNLIKELY (! swap_writer))
+        {
+          g_warning ("swap writer thread creation failed: %s",
+                     error->message);
+          g_clear_error (&error);
+
+          tile_swap_default_out (swap_file, tile);
+          return;
+        }
+    }
+
+  /*  keep the amount of memory held by the queue bounded  */
+  while (swap_queue_bytes >= SWAP_QUEUE_MAX_BYTES)
+    g_cond_wait (swap_done_cond, swap_mutex);
+
+#ifdef TILE_PROFILING
+  tile_total_swapout++;
+
+  if (!tile->outonce)
+    tile_unique_swapout++;
+
+  tile->outonce = TRUE;
+#endif
+
+  bytes = TILE_WIDTH * TILE_HEIGHT * tile->bpp;
+
+  /*  If there is already a valid swap_offset, use it  */
+  if (tile->swap_offset == -1)
+    offset = tile_swap_find_offset (swap_file, bytes);
+  else
+    offset = tile->swap_offset;
+
+  request = g_slice_new (SwapRequest);
+
+  request->tile    = tile;
+  request->data    = tile->data;
+  request->size    = tile->size;
+  request->offset  = offset;
+  request->end     = offset + bytes;
+  request->writing = FALSE;
+  request->failed  = FALSE;
+
+  /* the data now belongs to the request, tile_cache_zorch_next()
+   * must not free it
+   */
+  tile->data        = NULL;
+  tile->dirty       = FALSE;
+  tile->swap_offset = offset;
+
+#ifdef TILE_PROFILING
+  tile_exist_count--;
+#endif
+
+  g_hash_table_insert (swap_pending, tile, request);
+
+  g_queue_push_tail (&swap_queue, request);
+  swap_queue_bytes += request->size;
+
+  g_cond_signal (swap_queue_cond);
+}
+
+static void
+tile_swap_request_free (SwapRequest *request)
+{
+  g_free (request->data);
+  g_slice_free (SwapRequest, request);
+}
+
+static gboolean
+tile_swap_reclaim (Tile *tile)
+{
+  SwapRequest *request = g_hash_table_lookup (swap_pending, tile);
+
+  if (! request)
+    return FALSE;
+
+  if (request->writing)
+    {
+      /*  the writer only reads the data, we can copy it meanwhile;
+       *  the write may still fail, so the copy has to be written again
+       */
+      tile_alloc (tile);
+      memcpy (tile->data, request->data, request->size);
+
+      tile->dirty = TRUE;
+    }
+  else
+    {
+      if (! request->failed)
+        {
+          g_queue_remove (&swap_queue, request);
+          swap_queue_bytes -= request->size;
+          g_cond_broadcast (swap_done_cond);
+        }
+
+      g_hash_table_remove (swap_pending, tile);
+
+      tile->data  = request->data;
+      request->data = NULL;
+
+      /*  nothing was written to the swap slot yet  */
+      tile->dirty = TRUE;
+
+#ifdef TILE_PROFILING
+      tile_exist_count++;
+#endif
+
+      tile_swap_request_free (request);
+    }
+
+  return TRUE;
+}
+
+/*  returns TRUE if freeing the tile's swap slot was taken care of  */
+static gboolean
+tile_swap_cancel (SwapFile *swap_file,
+                  Tile     *tile)
+{
+  SwapRequest *request = g_hash_table_lookup (swap_pending, tile);
+
+  if (! request)
+    return FALSE;
+
+  g_hash_table_remove (swap_pending, tile);
+
+  if (request->writing)
+    {
+      /*  the writer frees the swap slot when it is done with it  */
+      request->tile     = NULL;
+      tile->swap_offset = -1;
+
+      return TRUE;
+    }
+
+  if (! request->failed)
+    {
+      g_queue_remove (&swap_queue, request);
+      swap_queue_bytes -= request->size;
+      g_cond_broadcast (swap_done_cond);
+    }
+
+  tile_swap_request_free (request);
+
+  return FALSE;
+}
+
+/*  waits for the tile's write in flight, and drops a failed request
+ *  whose data the tile has already taken a copy of
+ */
+static void
+tile_swap_wait_written (Tile *tile)
+{
+  SwapRequest *request;
+
+  while ((request = g_hash_table_lookup (swap_pending, tile)) &&
+         ! request->failed)
+    g_cond_wait (swap_done_cond, swap_mutex);
+
+  if (request && tile->data)
+    {
+      g_hash_table_remove (swap_pending, tile);
+      tile_swap_request_free (request);
+    }
+}
+
+static gint
+tile_swap_request_compare (gconstpointer a,
+                           gconstpointer b)
+{
+  const SwapRequest *r1 = *(const SwapRequest **) a;
+  const SwapRequest *r2 = *(const SwapRequest **) b;
+
+  return (r1->offset > r2->offset) - (r1->offset < r2->offset);
+}
+
+/*  writes a run of tiles that are adjacent in the swap file,
+ *  returns 0 or the errno of the failed write
+ */
+static gint
+tile_swap_write_run (gint          fd,
+                     SwapRequest **run,
+                     gint          n_requests)
+{
+  gint64 offset = run[0]->offset;
+  gint   i;
+
+#ifdef HAVE_PWRITEV
+  struct iovec iov[SWAP_WRITE_IOV_MAX];
+  gint         n_iov = n_requests;
+
+  for (i = 0; i < n_requests; i++)
+    {
+      iov[i].iov_base = run[i]->data;
+      iov[i].iov_len  = run[i]->size;
+    }
+
+  i = 0;
+
+  while (i < n_iov)
+    {
+      gssize err = pwritev (fd, iov + i, n_iov - i, offset);
+
+      if (err == -1 && (errno == EAGAIN || errno == EINTR))
+        continue;
+
+      if (err <= 0)
+        return err ? errno : EIO;
+
+      offset += err;
+
+      /*  skip what was written, a short write may end mid-tile  */
+      while (i < n_iov && err >= (gssize) iov[i].iov_len)
+        err -= iov[i++].iov_len;
+
+      if (i < n_iov)
+        {
+          iov[i].iov_base  = (guchar *) iov[i].iov_base + err;
+          iov[i].iov_len  -= err;
+        }
+    }
+#else
+  for (i = 0; i < n_requests; i++)
+    {
+      gint nleft = run[i]->size;
+
+      while (nleft > 0)
+        {
+          gssize err = pwrite (fd, run[i]->data + run[i]->size - nleft,
+                               nleft, offset);
+
+          if (err == -1 && (errno == EAGAIN || errno == EINTR))
+            continue;
+
+          if (err <= 0)
+            return err ? errno : EIO;
+
+          nleft  -= err;
+          offset += err;
+        }
+    }
+#endif
+
+  return 0;
+}
+
+static gpointer
+tile_swap_writer (gpointer data)
+{
+  SwapFile    *swap_file = data;
+  SwapRequest *batch[SWAP_WRITE_BATCH];
+
+  TILE_SWAP_LOCK;
+
+  while (TRUE)
+    {
+      gint n_requests = 0;
+      gint i;
+
+      while (g_queue_is_empty (&swap_queue) && ! swap_writer_quit)
+        g_cond_wait (swap_queue_cond, swap_mutex);
+
+      if (g_queue_is_empty (&swap_queue))
+        break;
+
+      while (n_requests < SWAP_WRITE_BATCH &&
+             ! g_queue_is_empty (&swap_queue))
+        {
+          SwapRequest *request = g_queue_pop_head (&swap_queue);
+
+          request->writing = TRUE;
+          batch[n_requests++] = request;
+        }
+
+      TILE_SWAP_UNLOCK;
+
+      qsort (batch, n_requests, sizeof (SwapRequest *),
+             tile_swap_request_compare);
+
+      for (i = 0; i < n_requests; )
+        {
+          gint64 end = batch[i]->offset + batch[i]->size;
+          gint   n   = 1;
+          gint   err;
+
+          while (i + n < n_requests            &&
+                 n     < SWAP_WRITE_IOV_MAX    &&
+                 batch[i + n]->offset == end)
+            {
+              end += batch[i + n]->size;
+              n++;
+            }
+
+          err = tile_swap_write_run (swap_file->fd, batch + i, n);
+
+          if (G_UNLIKELY (err))
+            {
+              gint j;
+
+              g_atomic_int_set (&swap_write_errno, err);
+
+              for (j = i; j < i + n; j++)
+                batch[j]->failed = TRUE;
+            }
+
+          i += n;
+        }
+
+      TILE_SWAP_LOCK;
+
+      for (i = 0; i < n_requests; i++)
+        {
+          SwapRequest *request = batch[i];
+
+          swap_queue_bytes -= request->size;
+
+          if (request->failed && request->tile)
+            {
+              /*  keep the only copy of the data for tile_swap_reclaim()  */
+              request->writing = FALSE;
+              continue;
+            }
+
+          if (request->tile)
+            {
+              if (g_hash_table_lookup (swap_pending, request->tile) == request)
+                g_hash_table_remove (swap_pending, request->tile);
+            }
+          else
+            {
+              /*  the tile was deleted while we were writing it  */
+              tile_swap_release_range (swap_file,
+                                       request->offset, request->end);
+            }
+
+          tile_swap_request_free (request);
+        }
+
+      g_cond_broadcast (swap_done_cond);
+    }
+
+  TILE_SWAP_UNLOCK;
+
+  return NULL;
+}
+
+#endif /* TILE_SWAP_ASYNC */
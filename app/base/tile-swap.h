@@ -19,13 +19,15 @@
 #define __TILE_SWAP_H__
 
 
-void     tile_swap_init     (const gchar *path);
+void     tile_swap_init     (const gchar *path,
+                             gboolean     mapped);
 void     tile_swap_exit     (void);
 
 gboolean tile_swap_test     (void);
 
 void     tile_swap_in       (Tile        *tile);
 void     tile_swap_out      (Tile        *tile);
+void     tile_swap_evict    (Tile        *tile);
 void     tile_swap_delete   (Tile        *tile);
 
 
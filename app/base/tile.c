@@ -23,6 +23,7 @@
 
 #include "tile.h"
 #include "tile-cache.h"
+#include "tile-compress.h"
 #include "tile-manager.h"
 #include "tile-rowhints.h"
 #include "tile-swap.h"
@@ -170,6 +171,27 @@ tile_alloc (Tile *tile)
 #endif
 }
 
+void
+tile_free_data (Tile *tile)
+{
+  if (! tile->data)
+    return;
+
+  /* Data that points into the swap file mapping isn't ours to free.
+   */
+  if (! tile->mapped)
+    {
+      g_free (tile->data);
+
+#ifdef TILE_PROFILING
+      tile_exist_count--;
+#endif
+    }
+
+  tile->data   = NULL;
+  tile->mapped = FALSE;
+}
+
 static void
 tile_destroy (Tile *tile)
 {
@@ -184,16 +206,6 @@ tile_destroy (Tile *tile)
       return;
     }
 
-  if (tile->data)
-    {
-      g_free (tile->data);
-      tile->data = NULL;
-
-#ifdef TILE_PROFILING
-      tile_exist_count--;
-#endif
-    }
-
   if (tile->rowhint)
     {
       g_slice_free1 (sizeof (TileRowHint) * TILE_HEIGHT, tile->rowhint);
@@ -203,6 +215,14 @@ tile_destroy (Tile *tile)
   /* must flush before deleting swap */
   tile_cache_flush (tile);
 
+  /* Another thread may be pushing the tile out of the compressed tier,
+   *  which gives it data and a swap_offset.  The drop waits for that
+   *  under the tier lock, so only look at them afterwards.
+   */
+  tile_compress_drop (tile);
+
+  tile_free_data (tile);
+
   if (tile->swap_offset != -1)
     {
       /* If the tile is on disk, then delete its
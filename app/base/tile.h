@@ -45,6 +45,10 @@ void        tile_release         (Tile     *tile,
  */
 void        tile_alloc           (Tile     *tile);
 
+/* Free the data for the tile.
+ */
+void        tile_free_data       (Tile     *tile);
+
 /* Return the size in bytes of the tiles data.
  */
 gint        tile_size            (Tile     *tile);
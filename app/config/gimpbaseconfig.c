@@ -52,6 +52,8 @@ enum
   PROP_SWAP_PATH,
   PROP_NUM_PROCESSORS,
   PROP_TILE_CACHE_SIZE,
+  PROP_TILE_CACHE_COMPRESSED_SIZE,
+  PROP_SWAP_MMAP,
 
   /* ignored, only for backward compatibility: */
   PROP_STINGY_MEMORY_USE
@@ -159,6 +161,20 @@ gimp_base_config_class_init (GimpBaseConfigClass *klass)
                                     GIMP_PARAM_STATIC_STRINGS |
                                     GIMP_CONFIG_PARAM_CONFIRM);
 
+  GIMP_CONFIG_INSTALL_PROP_MEMSIZE (object_class,
+                                    PROP_TILE_CACHE_COMPRESSED_SIZE,
+                                    "tile-cache-compressed-size",
+                                    TILE_CACHE_COMPRESSED_SIZE_BLURB,
+                                    0, GIMP_MAX_MEM_PROCESS,
+                                    0,
+                                    GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_SWAP_MMAP,
+                                    "swap-mmap", SWAP_MMAP_BLURB,
+                                    FALSE,
+                                    GIMP_PARAM_STATIC_STRINGS |
+                                    GIMP_CONFIG_PARAM_RESTART);
+
   /*  only for backward compatibility:  */
   GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_STINGY_MEMORY_USE,
                                     "stingy-memory-use", NULL,
@@ -210,6 +226,12 @@ gimp_base_config_set_property (GObject      *object,
     case PROP_TILE_CACHE_SIZE:
       base_config->tile_cache_size = g_value_get_uint64 (value);
       break;
+    case PROP_TILE_CACHE_COMPRESSED_SIZE:
+      base_config->tile_cache_compressed_size = g_value_get_uint64 (value);
+      break;
+    case PROP_SWAP_MMAP:
+      base_config->swap_mmap = g_value_get_boolean (value);
+      break;
 
     case PROP_STINGY_MEMORY_USE:
       /* ignored */
@@ -243,6 +265,12 @@ gimp_base_config_get_property (GObject    *object,
     case PROP_TILE_CACHE_SIZE:
       g_value_set_uint64 (value, base_config->tile_cache_size);
       break;
+    case PROP_TILE_CACHE_COMPRESSED_SIZE:
+      g_value_set_uint64 (value, base_config->tile_cache_compressed_size);
+      break;
+    case PROP_SWAP_MMAP:
+      g_value_set_boolean (value, base_config->swap_mmap);
+      break;
 
     case PROP_STINGY_MEMORY_USE:
       /* ignored */
@@ -41,6 +41,8 @@ struct _GimpBaseConfig
   gchar    *swap_path;
   guint     num_processors;
   guint64   tile_cache_size;
+  guint64   tile_cache_compressed_size;
+  gboolean  swap_mmap;
 };
 
 struct _GimpBaseConfigClass
@@ -100,6 +100,7 @@ enum
   PROP_COLOR_MANAGEMENT,
   PROP_COLOR_PROFILE_POLICY,
   PROP_SAVE_DOCUMENT_HISTORY,
+  PROP_XCF_ZLIB_COMPRESSION,
   PROP_QUICK_MASK_COLOR,
   PROP_USE_GEGL,
 
@@ -434,6 +435,11 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                                     SAVE_DOCUMENT_HISTORY_BLURB,
                                     TRUE,
                                     GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_XCF_ZLIB_COMPRESSION,
+                                    "xcf-zlib-compression",
+                                    XCF_ZLIB_COMPRESSION_BLURB,
+                                    FALSE,
+                                    GIMP_PARAM_STATIC_STRINGS);
   GIMP_CONFIG_INSTALL_PROP_RGB (object_class, PROP_QUICK_MASK_COLOR,
                                 "quick-mask-color", QUICK_MASK_COLOR_BLURB,
                                 TRUE, &red,
@@ -716,6 +722,9 @@ gimp_core_config_set_property (GObject      *object,
     case PROP_SAVE_DOCUMENT_HISTORY:
       core_config->save_document_history = g_value_get_boolean (value);
       break;
+    case PROP_XCF_ZLIB_COMPRESSION:
+      core_config->xcf_zlib_compression = g_value_get_boolean (value);
+      break;
     case PROP_QUICK_MASK_COLOR:
       gimp_value_get_rgb (value, &core_config->quick_mask_color);
       break;
@@ -888,6 +897,9 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_SAVE_DOCUMENT_HISTORY:
       g_value_set_boolean (value, core_config->save_document_history);
       break;
+    case PROP_XCF_ZLIB_COMPRESSION:
+      g_value_set_boolean (value, core_config->xcf_zlib_compression);
+      break;
     case PROP_QUICK_MASK_COLOR:
       gimp_value_set_rgb (value, &core_config->quick_mask_color);
       break;
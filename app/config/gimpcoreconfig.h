@@ -87,6 +87,7 @@ struct _GimpCoreConfig
   GimpColorConfig        *color_management;
   GimpColorProfilePolicy  color_profile_policy;
   gboolean                save_document_history;
+  gboolean                xcf_zlib_compression;
   GimpRGB                 quick_mask_color;
   gboolean                use_gegl;
 };
@@ -375,6 +375,11 @@ N_("Hide docks and other windows, leaving only image windows.")
 #define SPACE_BAR_ACTION_BLURB \
 N_("What to do when the space bar is pressed in the image window.")
 
+#define SWAP_MMAP_BLURB \
+N_("Map the swap file into memory instead of reading and writing tiles " \
+   "with file I/O.  This is only available on 64-bit systems, and takes " \
+   "effect after restarting GIMP.")
+
 #define SWAP_PATH_BLURB \
 N_("Sets the swap file location. GIMP uses a tile based memory allocation " \
    "scheme. The swap file is used to quickly and easily swap tiles out to " \
@@ -422,6 +427,12 @@ N_("When the amount of pixel data exceeds this limit, GIMP will start to " \
    "work on images that wouldn't fit into memory otherwise.  If you have a " \
    "lot of RAM, you may want to set this to a higher value.")
 
+#define TILE_CACHE_COMPRESSED_SIZE_BLURB \
+N_("Tiles that would otherwise be swapped to disk are kept in memory in " \
+   "compressed form, up to this amount of memory.  Flat or mostly " \
+   "transparent layers compress very well, so this can avoid a lot of " \
+   "swapping.  Set it to zero to disable the compressed tile cache.")
+
 #define TOOLBOX_COLOR_AREA_BLURB \
 N_("Show the current foreground and background colors in the toolbox.")
 
@@ -467,6 +478,11 @@ N_("When enabled, pressing F1 will open the help browser.")
 "The location of the online user manual. This is used if " \
 "'user-manual-online' is enabled."
 
+#define XCF_ZLIB_COMPRESSION_BLURB \
+N_("Compress the tiles of XCF files with zlib instead of run-length " \
+   "encoding.  Such files are a lot smaller, but can't be opened by older " \
+   "versions of GIMP.")
+
 #define ZOOM_QUALITY_BLURB \
 "There's a tradeoff between speed and quality of the zoomed-out display."
 
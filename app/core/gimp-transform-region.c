@@ -26,6 +26,7 @@
 
 #include "core-types.h"
 
+#include "base/pixel-processor.h"
 #include "base/pixel-region.h"
 #include "base/pixel-surround.h"
 #include "base/tile-manager.h"
@@ -41,67 +42,94 @@
 #include "gimpprogress.h"
 
 
+/*  how many bytes of source pixels are read ahead for one batch of
+ *  destination tiles; a tile whose source area alone doesn't fit is
+ *  transformed on the main thread, straight from the tiles
+ */
+#define SOURCE_BUFFER_SIZE  (32 * 1024 * 1024)
+
+/*  the source pixels around a sample position the samplers look at  */
+#define SOURCE_MARGIN       (LANCZOS_WIDTH + 1)
+
+/*  fixed point source coordinates for stepping through affine scanlines  */
+#define STEP_SHIFT          32
+#define STEP_UNIT           ((gint64) 1 << STEP_SHIFT)
+#define DOUBLE2STEP(val)    ((gint64) floor ((val) * STEP_UNIT))
+
+
+/*  The source pixels one destination tile is computed from.  When
+ *  buffered, the pixels in data are all the tile needs, anything
+ *  outside of data is outside of the source and takes the background
+ *  color.  Otherwise the tiles are accessed directly, which can only
+ *  be done from the main thread.
+ */
+typedef struct
+{
+  gboolean       buffered;
+  guchar        *data;
+  gint           x, y;
+  gint           width, height;
+  gint           rowstride;
+
+  TileManager   *tiles;
+  PixelSurround *surround;
+  gint           bytes;
+  const guchar  *bg_color;
+} TransformSource;
+
+typedef struct
+{
+  TileManager           *orig_tiles;
+  PixelSurround         *surround;
+  const GimpMatrix3     *m;
+  GimpInterpolationType  interpolation;
+  gboolean               affine;
+  gboolean               supersample;   /* constant for affine transforms */
+  gint64                 uinc, vinc;    /* fixed point affine steps       */
+  gint                   dest_x1, dest_y1;
+  gint                   u1, v1;
+  gint                   alpha;
+  gint                   recursion_level;
+  const guchar          *bg_color;
+  gfloat                *lanczos;
+
+  gboolean               parallel;
+  gint                   first_col;     /* tile column of sources[0]     */
+  TransformSource       *sources;
+} TransformData;
+
+
 /*  forward function prototypes  */
 
-static void  gimp_transform_region_nearest (TileManager       *orig_tiles,
-                                            PixelRegion       *destPR,
-                                            gint               dest_x1,
-                                            gint               dest_y1,
-                                            gint               dest_x2,
-                                            gint               dest_y2,
-                                            gint               u1,
-                                            gint               v1,
-                                            gint               u2,
-                                            gint               v2,
-                                            const GimpMatrix3 *m,
-                                            gint               alpha,
-                                            const guchar      *bg_color,
-                                            GimpProgress      *progress);
-static void  gimp_transform_region_linear  (TileManager       *orig_tiles,
-                                            PixelRegion       *destPR,
-                                            gint               dest_x1,
-                                            gint               dest_y1,
-                                            gint               dest_x2,
-                                            gint               dest_y2,
-                                            gint               u1,
-                                            gint               v1,
-                                            gint               u2,
-                                            gint               v2,
-                                            const GimpMatrix3 *m,
-                                            gint               alpha,
-                                            gint               recursion_level,
-                                            const guchar      *bg_color,
-                                            GimpProgress      *progress);
-static void  gimp_transform_region_cubic   (TileManager       *orig_tiles,
-                                            PixelRegion       *destPR,
-                                            gint               dest_x1,
-                                            gint               dest_y1,
-                                            gint               dest_x2,
-                                            gint               dest_y2,
-                                            gint               u1,
-                                            gint               v1,
-                                            gint               u2,
-                                            gint               v2,
-                                            const GimpMatrix3 *m,
-                                            gint               alpha,
-                                            gint               recursion_level,
-                                            const guchar      *bg_color,
-                                            GimpProgress      *progress);
-static void  gimp_transform_region_lanczos (TileManager       *orig_tiles,
-                                            PixelRegion       *destPR,
-                                            gint               dest_x1,
-                                            gint               dest_y1,
-                                            gint               dest_x2,
-                                            gint               dest_y2,
-                                            gint               u1,
-                                            gint               v1,
-                                            gint               u2,
-                                            gint               v2,
-                                            const GimpMatrix3 *m,
-                                            gint               alpha,
-                                            gint               recursion_level,
-                                            const guchar      *bg_color,
-                                            GimpProgress      *progress);
+static void  gimp_transform_region_tiles  (TransformData     *data,
+                                           PixelRegion       *destPR,
+                                           GimpProgress      *progress);
+static void  gimp_transform_region_batch  (TransformData     *data,
+                                           TileManager       *dest_tiles,
+                                           gint               x,
+                                           gint               y,
+                                           gint               width,
+                                           gint               height,
+                                           gint               n_sources);
+static void  gimp_transform_region_tile   (TransformData     *data,
+                                           PixelRegion       *destPR);
+
+static gsize          transform_source_init       (TransformData   *data,
+                                                   TransformSource *source,
+                                                   gint             x,
+                                                   gint             y,
+                                                   gint             width,
+                                                   gint             height);
+static inline void    transform_source_read_pixel (const TransformSource *source,
+                                                   gint             x,
+                                                   gint             y,
+                                                   guchar          *pixel);
+static const guchar * transform_source_lock       (const TransformSource *source,
+                                                   gint             x,
+                                                   gint             y,
+                                                   gint             size,
+                                                   guchar          *scratch,
+                                                   gint            *rowstride);
 
 static inline void  untransform_coords     (const GimpMatrix3 *m,
                                             const gint         x,
@@ -125,7 +153,7 @@ static inline gboolean supersample_dtest   (const gdouble u0,
                                             const gdouble u3,
                                             const gdouble v3);
 
-static void     sample_adapt      (TileManager   *tm,
+static void     sample_adapt      (const TransformSource *source,
                                    const gdouble  xc,
                                    const gdouble  yc,
                                    const gdouble  x0,
@@ -142,19 +170,19 @@ static void     sample_adapt      (TileManager   *tm,
                                    gint           bpp,
                                    gint           alpha);
 
-static void     sample_linear     (PixelSurround *surround,
+static void     sample_linear     (const TransformSource *source,
                                    const gdouble  u,
                                    const gdouble  v,
                                    guchar        *color,
                                    const gint     bytes,
                                    const gint     alpha);
-static void     sample_cubic      (PixelSurround *surround,
+static void     sample_cubic      (const TransformSource *source,
                                    const gdouble  u,
                                    const gdouble  v,
                                    guchar        *color,
                                    const gint     bytes,
                                    const gint     alpha);
-static void     sample_lanczos    (PixelSurround *surround,
+static void     sample_lanczos    (const TransformSource *source,
                                    const gfloat  *lanczos,
                                    const gdouble  u,
                                    const gdouble  v,
@@ -181,19 +209,14 @@ gimp_transform_region (GimpPickable          *pickable,
                        gint                   recursion_level,
                        GimpProgress          *progress)
 {
+  TransformData  data  = { 0, };
   GimpImageType  pickable_type;
   GimpMatrix3    m;
-  gint           u1, v1, u2, v2;       /* source bounding box */
   gint           alpha;
   guchar         bg_color[MAX_CHANNELS];
 
   g_return_if_fail (GIMP_IS_PICKABLE (pickable));
 
-  u1 = orig_offset_x;
-  v1 = orig_offset_y;
-  u2 = u1 + tile_manager_width (orig_tiles);
-  v2 = v1 + tile_manager_height (orig_tiles);
-
   m = *matrix;
   gimp_matrix3_invert (&m);
 
@@ -241,315 +264,353 @@ gimp_transform_region (GimpPickable          *pickable,
   if (tile_manager_bpp (orig_tiles) == 1)
     alpha = 0;
 
+  data.orig_tiles      = orig_tiles;
+  data.m               = &m;
+  data.interpolation   = interpolation_type;
+  data.affine          = gimp_matrix3_is_affine (matrix);
+  data.dest_x1         = dest_x1;
+  data.dest_y1         = dest_y1;
+  data.u1              = orig_offset_x;
+  data.v1              = orig_offset_y;
+  data.alpha           = alpha;
+  data.recursion_level = recursion_level;
+  data.bg_color        = bg_color;
+
   switch (interpolation_type)
     {
     case GIMP_INTERPOLATION_NONE:
-      gimp_transform_region_nearest (orig_tiles, destPR,
-                                     dest_x1, dest_y1, dest_x2, dest_y2,
-                                     u1, v1, u2, v2,
-                                     &m, alpha, bg_color, progress);
       break;
 
     case GIMP_INTERPOLATION_LINEAR:
-      gimp_transform_region_linear (orig_tiles, destPR,
-                                    dest_x1, dest_y1, dest_x2, dest_y2,
-                                    u1, v1, u2, v2,
-                                    &m, alpha, recursion_level,
-                                    bg_color, progress);
+      data.surround = pixel_surround_new (orig_tiles, 2, 2,
+                                          PIXEL_SURROUND_BACKGROUND);
       break;
 
     case GIMP_INTERPOLATION_CUBIC:
-      gimp_transform_region_cubic (orig_tiles, destPR,
-                                   dest_x1, dest_y1, dest_x2, dest_y2,
-                                   u1, v1, u2, v2,
-                                   &m, alpha, recursion_level,
-                                   bg_color, progress);
+      data.surround = pixel_surround_new (orig_tiles, 4, 4,
+                                          PIXEL_SURROUND_BACKGROUND);
       break;
 
     case GIMP_INTERPOLATION_LANCZOS:
-      gimp_transform_region_lanczos (orig_tiles, destPR,
-                                     dest_x1, dest_y1, dest_x2, dest_y2,
-                                     u1, v1, u2, v2,
-                                     &m, alpha, recursion_level,
-                                     bg_color, progress);
+      data.surround = pixel_surround_new (orig_tiles,
+                                          LANCZOS_WIDTH2, LANCZOS_WIDTH2,
+                                          PIXEL_SURROUND_BACKGROUND);
+      data.lanczos  = create_lanczos_lookup ();
       break;
     }
+
+  if (data.surround)
+    pixel_surround_set_bg (data.surround, bg_color);
+
+  if (data.affine)
+    {
+      gdouble tu[5], tv[5], tw[5];
+      gdouble u[5], v[5];
+
+      /*  the footprint of a destination pixel is the same everywhere  */
+      untransform_coords (&m, 0, 0, tu, tv, tw);
+      normalize_coords (5, tu, tv, tw, u, v);
+
+      data.supersample = supersample_dtest (u[1], v[1], u[2], v[2],
+                                            u[3], v[3], u[4], v[4]);
+
+      data.uinc = DOUBLE2STEP (m.coeff[0][0]);
+      data.vinc = DOUBLE2STEP (m.coeff[1][0]);
+    }
+
+  gimp_transform_region_tiles (&data, destPR, progress);
+
+  if (data.lanczos)
+    g_free (data.lanczos);
+
+  if (data.surround)
+    pixel_surround_destroy (data.surround);
 }
 
+
+/*  private functions  */
+
+/*  Walks the destination one row of tiles at a time.  Each row is cut
+ *  into batches of tiles whose source pixels fit SOURCE_BUFFER_SIZE.
+ */
 static void
-gimp_transform_region_nearest (TileManager        *orig_tiles,
-                               PixelRegion        *destPR,
-                               gint                dest_x1,
-                               gint                dest_y1,
-                               gint                dest_x2,
-                               gint                dest_y2,
-                               gint                u1,
-                               gint                v1,
-                               gint                u2,
-                               gint                v2,
-                               const GimpMatrix3  *m,
-                               gint                alpha,
-                               const guchar       *bg_color,
-                               GimpProgress       *progress)
+gimp_transform_region_tiles (TransformData *data,
+                             PixelRegion   *destPR,
+                             GimpProgress  *progress)
 {
-  gdouble   uinc, vinc, winc;  /* increments in source coordinates  */
-  gint      pixels;
-  gint      total;
-  gint      n;
-  gpointer  pr;
-
-  uinc = m->coeff[0][0];
-  vinc = m->coeff[1][0];
-  winc = m->coeff[2][0];
+  const gint  x2     = destPR->x + destPR->w;
+  const gint  y2     = destPR->y + destPR->h;
+  const gint  n_cols = ((x2 - 1) / TILE_WIDTH -
+                        destPR->x / TILE_WIDTH + 1);
+  const gint  total  = destPR->w * destPR->h;
+  gint        pixels = 0;
+  gint        y;
 
-  total = destPR->w * destPR->h;
+  data->sources = g_new0 (TransformSource, n_cols);
 
-  for (pr = pixel_regions_register (1, destPR), pixels = 0, n = 0;
-       pr != NULL;
-       pr = pixel_regions_process (pr), n++)
+  for (y = destPR->y; y < y2; )
     {
-      guchar *dest = destPR->data;
-      gint    y;
+      const gint height = MIN (y2, (y / TILE_HEIGHT + 1) * TILE_HEIGHT) - y;
+      gint       x      = destPR->x;
 
-      for (y = destPR->y; y < destPR->y + destPR->h; y++)
+      while (x < x2)
         {
-          gint     x     = dest_x1 + destPR->x;
-          gint     width = destPR->w;
-          guchar  *d     = dest;
-          gdouble  tu, tv, tw;   /* undivided source coordinates and divisor */
+          const gint batch_x = x;
+          gsize      size    = 0;
+          gint       n       = 0;
 
-          /* set up inverse transform steps */
-          tu = uinc * (x + .5) + m->coeff[0][1] * (dest_y1 + y + .5) + m->coeff[0][2];
-          tv = vinc * (x + .5) + m->coeff[1][1] * (dest_y1 + y + .5) + m->coeff[1][2];
-          tw = winc * (x + .5) + m->coeff[2][1] * (dest_y1 + y + .5) + m->coeff[2][2];
+          data->first_col = x / TILE_WIDTH;
 
-          while (width--)
+          while (x < x2)
             {
-              gdouble u, v; /* source coordinates */
-              gint    iu, iv;
+              const gint width = (MIN (x2, (x / TILE_WIDTH + 1) * TILE_WIDTH) -
+                                  x);
+              gsize      tile_size;
 
-              /*  normalize homogeneous coords  */
-              normalize_coords (1, &tu, &tv, &tw, &u, &v);
+              tile_size = transform_source_init (data, &data->sources[n],
+                                                 x, y, width, height);
 
-              iu = RINT (u);
-              iv = RINT (v);
+              if (n > 0 && size + tile_size > SOURCE_BUFFER_SIZE)
+                break;
 
-              /*  Set the destination pixels  */
-              if (iu >= u1 && iu < u2 &&
-                  iv >= v1 && iv < v2)
-                {
-                  tile_manager_read_pixel_data_1 (orig_tiles, iu - u1, iv - v1,
-                                                  d);
+              size += tile_size;
+              x    += width;
+              n++;
+            }
 
-                  d += destPR->bytes;
-                }
-              else /* not in source range */
-                {
-                  gint b;
+          gimp_transform_region_batch (data, destPR->tiles,
+                                       batch_x, y, x - batch_x, height, n);
 
-                  for (b = 0; b < destPR->bytes; b++)
-                    *d++ = bg_color[b];
-                }
+          if (progress)
+            {
+              pixels += (x - batch_x) * height;
 
-              tu += uinc;
-              tv += vinc;
-              tw += winc;
+              gimp_progress_set_value (progress,
+                                       (gdouble) pixels / (gdouble) total);
             }
-
-          dest += destPR->rowstride;
         }
 
-      if (progress)
-        {
-          pixels += destPR->w * destPR->h;
-
-          if (n % 16 == 0)
-            gimp_progress_set_value (progress,
-                                     (gdouble) pixels / (gdouble) total);
-        }
+      y += height;
     }
+
+  g_free (data->sources);
+  data->sources = NULL;
 }
 
+/*  Reads the source pixels of a batch of destination tiles, transforms
+ *  the tiles with buffered sources in parallel and the others on this
+ *  thread.
+ */
 static void
-gimp_transform_region_linear (TileManager        *orig_tiles,
-                              PixelRegion        *destPR,
-                              gint                dest_x1,
-                              gint                dest_y1,
-                              gint                dest_x2,
-                              gint                dest_y2,
-                              gint                u1,
-                              gint                v1,
-                              gint                u2,
-                              gint                v2,
-                              const GimpMatrix3  *m,
-                              gint                alpha,
-                              gint                recursion_level,
-                              const guchar       *bg_color,
-                              GimpProgress       *progress)
+gimp_transform_region_batch (TransformData *data,
+                             TileManager   *dest_tiles,
+                             gint           x,
+                             gint           y,
+                             gint           width,
+                             gint           height,
+                             gint           n_sources)
 {
-  PixelSurround *surround;
-  gdouble        uinc, vinc, winc;  /* increments in source coordinates  */
-  gint           pixels;
-  gint           total;
-  gint           n;
-  gpointer       pr;
-
-  surround = pixel_surround_new (orig_tiles, 2, 2, PIXEL_SURROUND_BACKGROUND);
-  pixel_surround_set_bg (surround, bg_color);
+  PixelRegion region;
+  gint        i;
 
-  uinc = m->coeff[0][0];
-  vinc = m->coeff[1][0];
-  winc = m->coeff[2][0];
-
-  total = destPR->w * destPR->h;
-
-  for (pr = pixel_regions_register (1, destPR), pixels = 0, n = 0;
-       pr != NULL;
-       pr = pixel_regions_process (pr), n++)
+  for (i = 0; i < n_sources; i++)
     {
-      guchar *dest = destPR->data;
-      gint    y;
+      TransformSource *source = &data->sources[i];
 
-      for (y = destPR->y; y < destPR->y + destPR->h; y++)
+      if (source->buffered && source->width > 0 && source->height > 0)
         {
-          guchar  *d     = dest;
-          gint     width = destPR->w;
-          gdouble  tu[5], tv[5];   /* undivided source coordinates */
-          gdouble  tw[5];          /* divisor                      */
+          source->data = g_malloc (source->rowstride * source->height);
+
+          tile_manager_read_pixel_data (data->orig_tiles,
+                                        source->x,
+                                        source->y,
+                                        source->x + source->width  - 1,
+                                        source->y + source->height - 1,
+                                        source->data, source->rowstride);
+        }
+    }
 
-          /* set up inverse transform steps */
-          untransform_coords (m, dest_x1 + destPR->x, dest_y1 + y, tu, tv, tw);
+  pixel_region_init (&region, dest_tiles, x, y, width, height, TRUE);
 
-          while (width--)
-            {
-              gdouble u[5], v[5]; /* source coordinates */
-              gint    i;
+  data->parallel = TRUE;
 
-              /*  normalize homogeneous coords  */
-              normalize_coords (5, tu, tv, tw, u, v);
+  pixel_regions_process_parallel ((PixelProcessorFunc)
+                                  gimp_transform_region_tile,
+                                  data, 1, &region);
 
-              /*  Set the destination pixels  */
-              if (supersample_dtest (u[1], v[1], u[2], v[2],
-                                     u[3], v[3], u[4], v[4]))
-                {
-                  sample_adapt (orig_tiles,
-                                u[0] - u1, v[0] - v1,
-                                u[1] - u1, v[1] - v1,
-                                u[2] - u1, v[2] - v1,
-                                u[3] - u1, v[3] - v1,
-                                u[4] - u1, v[4] - v1,
-                                recursion_level,
-                                d, bg_color, destPR->bytes, alpha);
-                }
-              else
-                {
-                  sample_linear (surround, u[0] - u1, v[0] - v1,
-                                 d, destPR->bytes, alpha);
-                }
+  data->parallel = FALSE;
 
-              d += destPR->bytes;
+  for (i = 0; i < n_sources; i++)
+    {
+      TransformSource *source = &data->sources[i];
 
-              for (i = 0; i < 5; i++)
-                {
-                  tu[i] += uinc;
-                  tv[i] += vinc;
-                  tw[i] += winc;
-                }
-            }
+      if (! source->buffered)
+        {
+          const gint tile_x = MAX (x, (data->first_col + i) * TILE_WIDTH);
+          const gint tile_w = MIN (x + width,
+                                   (data->first_col + i + 1) * TILE_WIDTH);
+          gpointer   pr;
+
+          pixel_region_init (&region, dest_tiles,
+                             tile_x, y, tile_w - tile_x, height, TRUE);
 
-          dest += destPR->rowstride;
+          for (pr = pixel_regions_register (1, &region);
+               pr != NULL;
+               pr = pixel_regions_process (pr))
+            {
+              gimp_transform_region_tile (data, &region);
+            }
         }
 
-      if (progress)
+      if (source->data)
         {
-          pixels += destPR->w * destPR->h;
-
-          if (n % 16 == 0)
-            gimp_progress_set_value (progress,
-                                     (gdouble) pixels / (gdouble) total);
+          g_free (source->data);
+          source->data = NULL;
         }
     }
-
-  pixel_surround_destroy (surround);
 }
 
+/*  Transforms one destination tile, called from the pixel processor.
+ *  The source coordinates are stepped incrementally along each row;
+ *  affine transforms need no divisions, and nearest neighbor sampling
+ *  of affine transforms steps in fixed point.
+ */
 static void
-gimp_transform_region_cubic (TileManager        *orig_tiles,
-                             PixelRegion        *destPR,
-                             gint                dest_x1,
-                             gint                dest_y1,
-                             gint                dest_x2,
-                             gint                dest_y2,
-                             gint                u1,
-                             gint                v1,
-                             gint                u2,
-                             gint                v2,
-                             const GimpMatrix3  *m,
-                             gint                alpha,
-                             gint                recursion_level,
-                             const guchar       *bg_color,
-                             GimpProgress       *progress)
+gimp_transform_region_tile (TransformData *data,
+                            PixelRegion   *destPR)
 {
-  PixelSurround *surround;
-  gdouble        uinc, vinc, winc;  /* increments in source coordinates  */
-  gint           pixels;
-  gint           total;
-  gint           n;
-  gpointer       pr;
+  const GimpMatrix3     *m      = data->m;
+  const TransformSource *source = (data->sources +
+                                   destPR->x / TILE_WIDTH - data->first_col);
+  const gint             bytes  = destPR->bytes;
+  const gint             u1     = data->u1;
+  const gint             v1     = data->v1;
+  const gdouble          uinc   = m->coeff[0][0];
+  const gdouble          vinc   = m->coeff[1][0];
+  const gdouble          winc   = m->coeff[2][0];
+  guchar                *dest   = destPR->data;
+  gint                   y;
+
+  /*  leave the tiles that need the tile manager to the main thread  */
+  if (data->parallel && ! source->buffered)
+    return;
+
+  for (y = destPR->y; y < destPR->y + destPR->h; y++)
+    {
+      guchar  *d     = dest;
+      gint     width = destPR->w;
+      gdouble  tu[5], tv[5];   /* undivided source coordinates */
+      gdouble  tw[5];          /* divisor                      */
 
-  surround = pixel_surround_new (orig_tiles, 4, 4, PIXEL_SURROUND_BACKGROUND);
-  pixel_surround_set_bg (surround, bg_color);
+      /* set up inverse transform steps */
+      untransform_coords (m,
+                          data->dest_x1 + destPR->x, data->dest_y1 + y,
+                          tu, tv, tw);
 
-  uinc = m->coeff[0][0];
-  vinc = m->coeff[1][0];
-  winc = m->coeff[2][0];
+      if (data->interpolation == GIMP_INTERPOLATION_NONE)
+        {
+          if (data->affine)
+            {
+              /*  RINT (tu - .5) is floor (tu)  */
+              gint64 fu = DOUBLE2STEP (tu[0]);
+              gint64 fv = DOUBLE2STEP (tv[0]);
 
-  total = destPR->w * destPR->h;
+              while (width--)
+                {
+                  transform_source_read_pixel (source,
+                                               (gint) (fu >> STEP_SHIFT) - u1,
+                                               (gint) (fv >> STEP_SHIFT) - v1,
+                                               d);
+
+                  d  += bytes;
+                  fu += data->uinc;
+                  fv += data->vinc;
+                }
+            }
+          else
+            {
+              while (width--)
+                {
+                  gdouble u, v;
 
-  for (pr = pixel_regions_register (1, destPR), pixels = 0, n = 0;
-       pr != NULL;
-       pr = pixel_regions_process (pr), n++)
-    {
-      guchar *dest = destPR->data;
-      gint    y;
+                  normalize_coords (1, tu, tv, tw, &u, &v);
 
-      for (y = destPR->y; y < destPR->y + destPR->h; y++)
-        {
-          guchar  *d     = dest;
-          gint     width = destPR->w;
-          gdouble  tu[5], tv[5];   /* undivided source coordinates */
-          gdouble  tw[5];          /* divisor                      */
+                  transform_source_read_pixel (source,
+                                               RINT (u) - u1, RINT (v) - v1,
+                                               d);
 
-          /* set up inverse transform steps */
-          untransform_coords (m, dest_x1 + destPR->x, dest_y1 + y, tu, tv, tw);
+                  d += bytes;
 
+                  tu[0] += uinc;
+                  tv[0] += vinc;
+                  tw[0] += winc;
+                }
+            }
+        }
+      else
+        {
           while (width--)
             {
-              gdouble u[5], v[5]; /* source coordinates */
-              gint    i;
+              gdouble  u[5], v[5]; /* source coordinates */
+              gboolean supersample;
+              gint     i;
 
-              /*  normalize homogeneous coords  */
-              normalize_coords (5, tu, tv, tw, u, v);
+              if (data->affine)
+                {
+                  supersample = data->supersample;
 
-              if (supersample_dtest (u[1], v[1], u[2], v[2],
-                                     u[3], v[3], u[4], v[4]))
+                  for (i = 0; i < (supersample ? 5 : 1); i++)
+                    {
+                      u[i] = tu[i] - .5;
+                      v[i] = tv[i] - .5;
+                    }
+                }
+              else
                 {
-                  sample_adapt (orig_tiles,
+                  /*  normalize homogeneous coords  */
+                  normalize_coords (5, tu, tv, tw, u, v);
+
+                  supersample = supersample_dtest (u[1], v[1], u[2], v[2],
+                                                   u[3], v[3], u[4], v[4]);
+                }
+
+              if (supersample)
+                {
+                  sample_adapt (source,
                                 u[0] - u1, v[0] - v1,
                                 u[1] - u1, v[1] - v1,
                                 u[2] - u1, v[2] - v1,
                                 u[3] - u1, v[3] - v1,
                                 u[4] - u1, v[4] - v1,
-                                recursion_level,
-                                d, bg_color, destPR->bytes, alpha);
+                                data->recursion_level,
+                                d, data->bg_color, bytes, data->alpha);
                 }
               else
                 {
-                  sample_cubic (surround, u[0] - u1, v[0] - v1,
-                                d, destPR->bytes, alpha);
+                  switch (data->interpolation)
+                    {
+                    case GIMP_INTERPOLATION_LINEAR:
+                      sample_linear (source, u[0] - u1, v[0] - v1,
+                                     d, bytes, data->alpha);
+                      break;
+
+                    case GIMP_INTERPOLATION_CUBIC:
+                      sample_cubic (source, u[0] - u1, v[0] - v1,
+                                    d, bytes, data->alpha);
+                      break;
+
+                    case GIMP_INTERPOLATION_LANCZOS:
+                      sample_lanczos (source, data->lanczos,
+                                      u[0] - u1, v[0] - v1,
+                                      d, bytes, data->alpha);
+                      break;
+
+                    default:
+                      break;
+                    }
                 }
 
-              d += destPR->bytes;
+              d += bytes;
 
               for (i = 0; i < 5; i++)
                 {
@@ -558,134 +619,193 @@ gimp_transform_region_cubic (TileManager        *orig_tiles,
                   tw[i] += winc;
                 }
             }
-
-          dest += destPR->rowstride;
         }
 
-      if (progress)
+      dest += destPR->rowstride;
+    }
+}
+
+/*  Finds the source pixels the destination tile at x, y needs and
+ *  returns the number of bytes it takes to buffer them, or 0 if they
+ *  are not going to be buffered.  A perspective transform that maps
+ *  the tile across the horizon can't be bounded, and neither can a
+ *  tile whose source area doesn't fit SOURCE_BUFFER_SIZE.
+ */
+static gsize
+transform_source_init (TransformData   *data,
+                       TransformSource *source,
+                       gint             x,
+                       gint             y,
+                       gint             width,
+                       gint             height)
+{
+  const gint src_width  = tile_manager_width  (data->orig_tiles);
+  const gint src_height = tile_manager_height (data->orig_tiles);
+  gdouble    min_u      = G_MAXDOUBLE, max_u = -G_MAXDOUBLE;
+  gdouble    min_v      = G_MAXDOUBLE, max_v = -G_MAXDOUBLE;
+  gint       n_positive = 0;
+  gint       x1, y1, x2, y2;
+  gsize      size;
+  gint       i;
+
+  source->buffered  = FALSE;
+  source->data      = NULL;
+  source->x         = 0;
+  source->y         = 0;
+  source->width     = 0;
+  source->height    = 0;
+  source->tiles     = data->orig_tiles;
+  source->surround  = data->surround;
+  source->bytes     = tile_manager_bpp (data->orig_tiles);
+  source->bg_color  = data->bg_color;
+  source->rowstride = 0;
+
+  x += data->dest_x1;
+  y += data->dest_y1;
+
+  /*  the corners of the tile, grown by the supersampling footprint  */
+  for (i = 0; i < 4; i++)
+    {
+      const gdouble cx = (i & 1) ? x + width  + 1 : x - 1;
+      const gdouble cy = (i & 2) ? y + height + 1 : y - 1;
+      const gdouble tu = (data->m->coeff[0][0] * cx +
+                          data->m->coeff[0][1] * cy + data->m->coeff[0][2]);
+      const gdouble tv = (data->m->coeff[1][0] * cx +
+                          data->m->coeff[1][1] * cy + data->m->coeff[1][2]);
+      const gdouble tw = (data->m->coeff[2][0] * cx +
+                          data->m->coeff[2][1] * cy + data->m->coeff[2][2]);
+      gdouble       u, v;
+
+      if (data->affine)
         {
-          pixels += destPR->w * destPR->h;
+          u = tu;
+          v = tv;
+          n_positive++;
+        }
+      else
+        {
+          if (tw > 0.0)
+            n_positive++;
+          else if (tw == 0.0)
+            return 0;
 
-          if (n % 16 == 0)
-            gimp_progress_set_value (progress,
-                                     (gdouble) pixels / (gdouble) total);
+          u = tu / tw;
+          v = tv / tw;
         }
+
+      min_u = MIN (min_u, u - .5);
+      max_u = MAX (max_u, u - .5);
+      min_v = MIN (min_v, v - .5);
+      max_v = MAX (max_v, v - .5);
     }
 
-  pixel_surround_destroy (surround);
-}
+  /*  the divisor changes its sign somewhere inside the tile  */
+  if (n_positive != 0 && n_positive != 4)
+    return 0;
 
-static void
-gimp_transform_region_lanczos (TileManager       *orig_tiles,
-                               PixelRegion       *destPR,
-                               gint               dest_x1,
-                               gint               dest_y1,
-                               gint               dest_x2,
-                               gint               dest_y2,
-                               gint               u1,
-                               gint               v1,
-                               gint               u2,
-                               gint               v2,
-                               const GimpMatrix3 *m,
-                               gint               alpha,
-                               gint               recursion_level,
-                               const guchar      *bg_color,
-                               GimpProgress      *progress)
-{
-  PixelSurround *surround;
-  gfloat        *lanczos;           /* Lanczos lookup table              */
-  gdouble        uinc, vinc, winc;  /* increments in source coordinates  */
-  gint           pixels;
-  gint           total;
-  gint           n;
-  gpointer       pr;
-
-  surround = pixel_surround_new (orig_tiles,
-                                 LANCZOS_WIDTH2, LANCZOS_WIDTH2,
-                                 PIXEL_SURROUND_BACKGROUND);
-  pixel_surround_set_bg (surround, bg_color);
-
-  /* allocate and fill lanczos lookup table */
-  lanczos = create_lanczos_lookup ();
-
-  uinc = m->coeff[0][0];
-  vinc = m->coeff[1][0];
-  winc = m->coeff[2][0];
-
-  total = destPR->w * destPR->h;
-
-  for (pr = pixel_regions_register (1, destPR), pixels = 0, n = 0;
-       pr != NULL;
-       pr = pixel_regions_process (pr), n++)
-    {
-      guchar *dest = destPR->data;
-      gint    y;
+  x1 = MAX (floor (min_u) - SOURCE_MARGIN - data->u1, 0);
+  y1 = MAX (floor (min_v) - SOURCE_MARGIN - data->v1, 0);
+  x2 = MIN (ceil  (max_u) + SOURCE_MARGIN - data->u1 + 1, src_width);
+  y2 = MIN (ceil  (max_v) + SOURCE_MARGIN - data->v1 + 1, src_height);
 
-      for (y = destPR->y; y < destPR->y + destPR->h; y++)
-        {
-          guchar  *d     = dest;
-          gint     width = destPR->w;
-          gdouble  tu[5], tv[5];   /* undivided source coordinates */
-          gdouble  tw[5];          /* divisor                      */
+  source->buffered = TRUE;
 
-          /* set up inverse transform steps */
-          untransform_coords (m, dest_x1 + destPR->x, dest_y1 + y, tu, tv, tw);
+  /*  the tile is entirely outside of the source  */
+  if (x1 >= x2 || y1 >= y2)
+    return 0;
 
-          while (width--)
-            {
-              gdouble u[5], v[5]; /* source coordinates */
-              gint    i;
+  size = (gsize) (x2 - x1) * (y2 - y1) * source->bytes;
 
-              /*  normalize homogeneous coords  */
-              normalize_coords (5, tu, tv, tw, u, v);
+  if (size > SOURCE_BUFFER_SIZE)
+    {
+      source->buffered = FALSE;
+      return 0;
+    }
 
-              if (supersample_dtest (u[1], v[1], u[2], v[2],
-                                     u[3], v[3], u[4], v[4]))
-                {
-                  sample_adapt (orig_tiles,
-                                u[0] - u1, v[0] - v1,
-                                u[1] - u1, v[1] - v1,
-                                u[2] - u1, v[2] - v1,
-                                u[3] - u1, v[3] - v1,
-                                u[4] - u1, v[4] - v1,
-                                recursion_level,
-                                d, bg_color, destPR->bytes, alpha);
-                }
-              else
-                {
-                  sample_lanczos (surround, lanczos, u[0] - u1, v[0] - v1,
-                                  d, destPR->bytes, alpha);
-                }
+  source->x         = x1;
+  source->y         = y1;
+  source->width     = x2 - x1;
+  source->height    = y2 - y1;
+  source->rowstride = source->width * source->bytes;
 
-              d += destPR->bytes;
+  return size;
+}
 
-              for (i = 0; i < 5; i++)
-                {
-                  tu[i] += uinc;
-                  tv[i] += vinc;
-                  tw[i] += winc;
-                }
-            }
+/*  Reads the source pixel at x, y, or the background color if x, y is
+ *  outside of the source.
+ */
+static inline void
+transform_source_read_pixel (const TransformSource *source,
+                             gint                   x,
+                             gint                   y,
+                             guchar                *pixel)
+{
+  gint b;
 
-          dest += destPR->rowstride;
-        }
+  if (source->buffered)
+    {
+      x -= source->x;
+      y -= source->y;
 
-      if (progress)
+      if (x >= 0 && x < source->width && y >= 0 && y < source->height)
         {
-          pixels += destPR->w * destPR->h;
+          const guchar *s = (source->data +
+                             y * source->rowstride + x * source->bytes);
+
+          for (b = 0; b < source->bytes; b++)
+            pixel[b] = s[b];
 
-          if (n % 16 == 0)
-            gimp_progress_set_value (progress,
-                                     (gdouble) pixels / (gdouble) total);
+          return;
         }
-   }
+    }
+  else if (x >= 0 && x < tile_manager_width  (source->tiles) &&
+           y >= 0 && y < tile_manager_height (source->tiles))
+    {
+      tile_manager_read_pixel_data_1 (source->tiles, x, y, pixel);
+
+      return;
+    }
 
-  g_free (lanczos);
-  pixel_surround_destroy (surround);
+  for (b = 0; b < source->bytes; b++)
+    pixel[b] = source->bg_color[b];
 }
 
+/*  Returns the size x size source pixels at x, y, like
+ *  pixel_surround_lock().  At the edges of a buffered source the
+ *  pixels are assembled in scratch.
+ */
+static const guchar *
+transform_source_lock (const TransformSource *source,
+                       gint                   x,
+                       gint                   y,
+                       gint                   size,
+                       guchar                *scratch,
+                       gint                  *rowstride)
+{
+  gint i, j;
 
-/*  private functions  */
+  if (! source->buffered)
+    return pixel_surround_lock (source->surround, x, y, rowstride);
+
+  if (x >= source->x && x + size <= source->x + source->width &&
+      y >= source->y && y + size <= source->y + source->height)
+    {
+      *rowstride = source->rowstride;
+
+      return (source->data +
+              (y - source->y) * source->rowstride +
+              (x - source->x) * source->bytes);
+    }
+
+  for (j = 0; j < size; j++)
+    for (i = 0; i < size; i++)
+      transform_source_read_pixel (source, x + i, y + j,
+                                   scratch + (j * size + i) * source->bytes);
+
+  *rowstride = size * source->bytes;
+
+  return scratch;
+}
 
 static inline void
 untransform_coords (const GimpMatrix3 *m,
@@ -756,13 +876,14 @@ normalize_coords (const gint     coords,
    *  iu to iu + 1, iv to iv + 1
    */
 static void
-sample_linear (PixelSurround *surround,
-               const gdouble  u,
-               const gdouble  v,
-               guchar        *color,
-               const gint     bytes,
-               const gint     alpha)
+sample_linear (const TransformSource *source,
+               const gdouble          u,
+               const gdouble          v,
+               guchar                *color,
+               const gint             bytes,
+               const gint             alpha)
 {
+  guchar        scratch[2 * 2 * MAX_CHANNELS];
   gdouble       a_val, a_recip;
   gint          i;
   const gint    iu = floor (u);
@@ -773,7 +894,7 @@ sample_linear (PixelSurround *surround,
   const guchar *data;
 
   /* lock the pixel surround */
-  data = pixel_surround_lock (surround, iu, iv, &rowstride);
+  data = transform_source_lock (source, iu, iv, 2, scratch, &rowstride);
 
   /* the fractional error */
   du = u - iu;
@@ -841,13 +962,13 @@ sample_linear (PixelSurround *surround,
     bilinear interpolation of a fixed point pixel
 */
 static void
-sample_bi (TileManager  *tm,
-           const gint    x,
-           const gint    y,
-           guchar       *color,
-           const guchar *bg_color,
-           const gint    bpp,
-           const gint    alpha)
+sample_bi (const TransformSource *source,
+           const gint             x,
+           const gint             y,
+           guchar                *color,
+           const guchar          *bg_color,
+           const gint             bpp,
+           const gint             alpha)
 {
   const gint xscale = (x & (FIXED_UNIT-1));
   const gint yscale = (y & (FIXED_UNIT-1));
@@ -858,22 +979,11 @@ sample_bi (TileManager  *tm,
   guchar     C[4][4];
   gint       i;
 
-  /*  fill the color with default values, since
-   *  tile_manager_read_pixel_data_1 does nothing, when accesses are
-   *  out of bounds.
-   */
-  for (i = 0; i < 4; i++)
-    {
-      guint *src = (guint *) bg_color;
-      guint *dst = (guint *) &C[i];
-
-      *dst = *src;
-    }
-
-  tile_manager_read_pixel_data_1 (tm, x0, y0, C[0]);
-  tile_manager_read_pixel_data_1 (tm, x1, y0, C[2]);
-  tile_manager_read_pixel_data_1 (tm, x0, y1, C[1]);
-  tile_manager_read_pixel_data_1 (tm, x1, y1, C[3]);
+  /*  pixels outside of the source take the background color  */
+  transform_source_read_pixel (source, x0, y0, C[0]);
+  transform_source_read_pixel (source, x1, y0, C[2]);
+  transform_source_read_pixel (source, x0, y1, C[1]);
+  transform_source_read_pixel (source, x1, y1, C[3]);
 
 #define lerp(v1, v2, r) \
         (((guint)(v1) * (FIXED_UNIT - (guint)(r)) + \
@@ -952,30 +1062,30 @@ supersample_dtest (const gdouble x0, const gdouble y0,
     0..3 is a cycle around the quad
 */
 static void
-get_sample (TileManager  *tm,
-            const gint    xc,
-            const gint    yc,
-            const gint    x0,
-            const gint    y0,
-            const gint    x1,
-            const gint    y1,
-            const gint    x2,
-            const gint    y2,
-            const gint    x3,
-            const gint    y3,
-            gint         *cc,
-            const gint    level,
-            guint        *color,
-            const guchar *bg_color,
-            const gint    bpp,
-            const gint    alpha)
+get_sample (const TransformSource *source,
+            const gint             xc,
+            const gint             yc,
+            const gint             x0,
+            const gint             y0,
+            const gint             x1,
+            const gint             y1,
+            const gint             x2,
+            const gint             y2,
+            const gint             x3,
+            const gint             y3,
+            gint                  *cc,
+            const gint             level,
+            guint                 *color,
+            const guchar          *bg_color,
+            const gint             bpp,
+            const gint             alpha)
 {
   if (!level || !supersample_test (x0, y0, x1, y1, x2, y2, x3, y3))
     {
       gint   i;
       guchar C[4];
 
-      sample_bi (tm, xc, yc, C, bg_color, bpp, alpha);
+      sample_bi (source, xc, yc, C, bg_color, bpp, alpha);
 
       for (i = 0; i < bpp; i++)
         color[i]+= C[i];
@@ -1009,22 +1119,22 @@ get_sample (TileManager  *tm,
       bry = (y2 + yc) / 2;
       by  = (y3 + y2) / 2;
 
-      get_sample (tm,
+      get_sample (source,
                   tlx,tly,
                   x0,y0, tx,ty, xc,yc, lx,ly,
                   cc, level-1, color, bg_color, bpp, alpha);
 
-      get_sample (tm,
+      get_sample (source,
                   trx,try,
                   tx,ty, x1,y1, rx,ry, xc,yc,
                   cc, level-1, color, bg_color, bpp, alpha);
 
-      get_sample (tm,
+      get_sample (source,
                   brx,bry,
                   xc,yc, rx,ry, x2,y2, bx,by,
                   cc, level-1, color, bg_color, bpp, alpha);
 
-      get_sample (tm,
+      get_sample (source,
                   blx,bly,
                   lx,ly, xc,yc, bx,by, x3,y3,
                   cc, level-1, color, bg_color, bpp, alpha);
@@ -1032,22 +1142,22 @@ get_sample (TileManager  *tm,
 }
 
 static void
-sample_adapt (TileManager   *tm,
-              const gdouble  xc,
-              const gdouble  yc,
-              const gdouble  x0,
-              const gdouble  y0,
-              const gdouble  x1,
-              const gdouble  y1,
-              const gdouble  x2,
-              const gdouble  y2,
-              const gdouble  x3,
-              const gdouble  y3,
-              const gint     level,
-              guchar        *color,
-              const guchar  *bg_color,
-              const gint     bpp,
-              const gint     alpha)
+sample_adapt (const TransformSource *source,
+              const gdouble          xc,
+              const gdouble          yc,
+              const gdouble          x0,
+              const gdouble          y0,
+              const gdouble          x1,
+              const gdouble          y1,
+              const gdouble          x2,
+              const gdouble          y2,
+              const gdouble          x3,
+              const gdouble          y3,
+              const gint             level,
+              guchar                *color,
+              const guchar          *bg_color,
+              const gint             bpp,
+              const gint             alpha)
 {
     gint  cc = 0;
     gint  i;
@@ -1055,7 +1165,7 @@ sample_adapt (TileManager   *tm,
 
     C[0] = C[1] = C[2] = C[3] = 0;
 
-    get_sample (tm,
+    get_sample (source,
                 DOUBLE2FIXED (xc), DOUBLE2FIXED (yc),
                 DOUBLE2FIXED (x0), DOUBLE2FIXED (y0),
                 DOUBLE2FIXED (x1), DOUBLE2FIXED (y1),
@@ -1131,13 +1241,14 @@ gimp_drawable_transform_cubic (const gdouble dx,
    *  iu to iu + 3, iv to iv + 3
    */
 static void
-sample_cubic (PixelSurround *surround,
-              const gdouble  u,
-              const gdouble  v,
-              guchar        *color,
-              const gint     bytes,
-              const gint     alpha)
+sample_cubic (const TransformSource *source,
+              const gdouble          u,
+              const gdouble          v,
+              guchar                *color,
+              const gint             bytes,
+              const gint             alpha)
 {
+  guchar        scratch[4 * 4 * MAX_CHANNELS];
   gdouble       a_val, a_recip;
   gint          i;
   const gint    iu = floor(u);
@@ -1147,7 +1258,8 @@ sample_cubic (PixelSurround *surround,
   const guchar *data;
 
   /* lock the pixel surround */
-  data = pixel_surround_lock (surround, iu - 1 , iv - 1, &rowstride);
+  data = transform_source_lock (source, iu - 1 , iv - 1, 4,
+                                scratch, &rowstride);
 
   /* the fractional error */
   du = u - iu;
@@ -1210,14 +1322,15 @@ sample_cubic (PixelSurround *surround,
 }
 
 static void
-sample_lanczos (PixelSurround *surround,
-                const gfloat  *lanczos,
-                const gdouble  u,
-                const gdouble  v,
-                guchar        *color,
-                const gint     bytes,
-                const gint     alpha)
+sample_lanczos (const TransformSource *source,
+                const gfloat          *lanczos,
+                const gdouble          u,
+                const gdouble          v,
+                guchar                *color,
+                const gint             bytes,
+                const gint             alpha)
 {
+  guchar        scratch[LANCZOS_WIDTH2 * LANCZOS_WIDTH2 * MAX_CHANNELS];
   gdouble       x_kernel[LANCZOS_WIDTH2]; /* 1-D kernels of window coeffs */
   gdouble       y_kernel[LANCZOS_WIDTH2];
   gdouble       x_sum, y_sum;             /* sum of Lanczos weights       */
@@ -1255,9 +1368,9 @@ sample_lanczos (PixelSurround *surround,
     }
 
   /* lock the pixel surround */
-  data = pixel_surround_lock (surround,
-                              iu - LANCZOS_WIDTH, iv - LANCZOS_WIDTH,
-                              &rowstride);
+  data = transform_source_lock (source,
+                                iu - LANCZOS_WIDTH, iv - LANCZOS_WIDTH,
+                                LANCZOS_WIDTH2, scratch, &rowstride);
 
   src = data + alpha;
   aval = 0.0;
@@ -132,6 +132,11 @@ static void       gimp_channel_to_selection  (GimpItem          *item,
                                               gdouble            feather_radius_x,
                                               gdouble            feather_radius_y);
 
+static void gimp_channel_update                (GimpDrawable       *drawable,
+                                                gint                x,
+                                                gint                y,
+                                                gint                width,
+                                                gint                height);
 static void gimp_channel_invalidate_boundary   (GimpDrawable       *drawable);
 static void gimp_channel_get_active_components (const GimpDrawable *drawable,
                                                 gboolean           *active);
@@ -287,6 +292,7 @@ gimp_channel_class_init (GimpChannelClass *klass)
   item_class->raise_failed         = _("Channel cannot be raised higher.");
   item_class->lower_failed         = _("Channel cannot be lowered more.");
 
+  drawable_class->update                = gimp_channel_update;
   drawable_class->invalidate_boundary   = gimp_channel_invalidate_boundary;
   drawable_class->get_active_components = gimp_channel_get_active_components;
   drawable_class->apply_region          = gimp_channel_apply_region;
@@ -330,6 +336,8 @@ gimp_channel_init (GimpChannel *channel)
   channel->segs_out       = NULL;
   channel->num_segs_in    = 0;
   channel->num_segs_out   = 0;
+  channel->cache_in       = NULL;
+  channel->cache_out      = NULL;
   channel->empty          = FALSE;
   channel->bounds_known   = FALSE;
   channel->x1             = 0;
@@ -361,6 +369,18 @@ gimp_channel_finalize (GObject *object)
       channel->segs_out = NULL;
     }
 
+  if (channel->cache_in)
+    {
+      boundary_cache_free (channel->cache_in);
+      channel->cache_in = NULL;
+    }
+
+  if (channel->cache_out)
+    {
+      boundary_cache_free (channel->cache_out);
+      channel->cache_out = NULL;
+    }
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -798,6 +818,30 @@ gimp_channel_to_selection (GimpItem       *item,
                                feather, feather_radius_x, feather_radius_x);
 }
 
+/*  Every change of the pixels is followed by an update of its area,
+ *  so this is where the rows of tiles of the boundary caches are
+ *  invalidated.  The boundary itself is still found again as a whole
+ *  after gimp_channel_invalidate_boundary(), but only the rows that
+ *  changed are scanned.
+ */
+static void
+gimp_channel_update (GimpDrawable *drawable,
+                     gint          x,
+                     gint          y,
+                     gint          width,
+                     gint          height)
+{
+  GimpChannel *channel = GIMP_CHANNEL (drawable);
+
+  if (channel->cache_in)
+    boundary_cache_invalidate (channel->cache_in, y, height);
+
+  if (channel->cache_out)
+    boundary_cache_invalidate (channel->cache_out, y, height);
+
+  GIMP_DRAWABLE_CLASS (parent_class)->update (drawable, x, y, width, height);
+}
+
 static void
 gimp_channel_invalidate_boundary (GimpDrawable *drawable)
 {
@@ -866,12 +910,26 @@ gimp_channel_set_tiles (GimpDrawable *drawable,
                         gint          offset_x,
                         gint          offset_y)
 {
+  GimpChannel *channel = GIMP_CHANNEL (drawable);
+
   GIMP_DRAWABLE_CLASS (parent_class)->set_tiles (drawable,
                                                  push_undo, undo_desc,
                                                  tiles, type,
                                                  offset_x, offset_y);
 
-  GIMP_CHANNEL (drawable)->bounds_known = FALSE;
+  channel->bounds_known = FALSE;
+
+  if (channel->cache_in)
+    {
+      boundary_cache_free (channel->cache_in);
+      channel->cache_in = NULL;
+    }
+
+  if (channel->cache_out)
+    {
+      boundary_cache_free (channel->cache_out);
+      channel->cache_out = NULL;
+    }
 }
 
 static GeglNode *
@@ -1017,10 +1075,14 @@ gimp_channel_real_boundary (GimpChannel     *channel,
                              gimp_drawable_get_tiles (GIMP_DRAWABLE (channel)),
                              x3, y3, x4 - x3, y4 - y3, FALSE);
 
-          channel->segs_out = boundary_find (&bPR, BOUNDARY_IGNORE_BOUNDS,
-                                             x1, y1, x2, y2,
-                                             BOUNDARY_HALF_WAY,
-                                             &channel->num_segs_out);
+          if (! channel->cache_out)
+            channel->cache_out = boundary_cache_new ();
+
+          channel->segs_out = boundary_cache_find (channel->cache_out,
+                                                   &bPR, BOUNDARY_IGNORE_BOUNDS,
+                                                   x1, y1, x2, y2,
+                                                   BOUNDARY_HALF_WAY,
+                                                   &channel->num_segs_out);
           x1 = MAX (x1, x3);
           y1 = MAX (y1, y3);
           x2 = MIN (x2, x4);
@@ -1034,10 +1096,15 @@ gimp_channel_real_boundary (GimpChannel     *channel,
                                  gimp_item_get_width  (GIMP_ITEM (channel)),
                                  gimp_item_get_height (GIMP_ITEM (channel)), FALSE);
 
-              channel->segs_in = boundary_find (&bPR, BOUNDARY_WITHIN_BOUNDS,
-                                                x1, y1, x2, y2,
-                                                BOUNDARY_HALF_WAY,
-                                                &channel->num_segs_in);
+              if (! channel->cache_in)
+                channel->cache_in = boundary_cache_new ();
+
+              channel->segs_in = boundary_cache_find (channel->cache_in,
+                                                      &bPR,
+                                                      BOUNDARY_WITHIN_BOUNDS,
+                                                      x1, y1, x2, y2,
+                                                      BOUNDARY_HALF_WAY,
+                                                      &channel->num_segs_in);
             }
           else
             {
@@ -49,6 +49,8 @@ struct _GimpChannel
   BoundSeg     *segs_out;          /*  outline of selected region     */
   gint          num_segs_in;       /*  number of lines in boundary    */
   gint          num_segs_out;      /*  number of lines in boundary    */
+  BoundaryCache *cache_in;         /*  per tile row cache of segs_in  */
+  BoundaryCache *cache_out;        /*  per tile row cache of segs_out */
   gboolean      empty;             /*  is the region empty?           */
   gboolean      bounds_known;      /*  recalculate the bounds?        */
   gint          x1, y1;            /*  coordinates for bounding box   */
@@ -47,6 +47,13 @@
 #include "gimp-intl.h"
 
 
+/*  the number of steps in the color lookup table, and the number of
+ *  pixels whose blend factors are computed in one go
+ */
+#define GRADIENT_LUT_SIZE  4096
+#define GRADIENT_SPAN      TILE_WIDTH
+
+
 typedef struct
 {
   GimpGradient     *gradient;
@@ -60,15 +67,15 @@ typedef struct
   gdouble           dist;
   gdouble           vec[2];
   GimpRepeatMode    repeat;
+  GimpRGB          *lut;
+  gint              max_depth;
+  gdouble           threshold;
   GRand            *seed;
 } RenderBlendData;
 
 typedef struct
 {
   PixelRegion *PR;
-  guchar      *row_data;
-  gint         bytes;
-  gint         width;
   GRand       *dither_rand;
 } PutPixelData;
 
@@ -110,12 +117,14 @@ static gdouble  gradient_calc_spiral_factor       (gdouble   dist,
                                                    gdouble   y,
                                                    gboolean  clockwise);
 
-static gdouble  gradient_calc_shapeburst_angular_factor   (gdouble x,
-                                                           gdouble y);
-static gdouble  gradient_calc_shapeburst_spherical_factor (gdouble x,
-                                                           gdouble y);
-static gdouble  gradient_calc_shapeburst_dimpled_factor   (gdouble x,
-                                                           gdouble y);
+static gdouble  gradient_calc_shapeburst_angular_factor   (gdouble value);
+static gdouble  gradient_calc_shapeburst_spherical_factor (gdouble value);
+static gdouble  gradient_calc_shapeburst_dimpled_factor   (gdouble value);
+
+static void     gradient_get_shapeburst_row (gdouble           x,
+                                             gdouble           y,
+                                             gint              n_pixels,
+                                             gdouble          *values);
 
 static void     gradient_precalc_shapeburst (GimpImage        *image,
                                              GimpDrawable     *drawable,
@@ -123,6 +132,13 @@ static void     gradient_precalc_shapeburst (GimpImage        *image,
                                              gdouble           dist,
                                              GimpProgress     *progress);
 
+static GimpRGB * gradient_lut_new           (RenderBlendData  *rbd);
+static void     gradient_calc_factors       (RenderBlendData  *rbd,
+                                             gdouble           x,
+                                             gdouble           y,
+                                             gint              n_pixels,
+                                             gdouble          *factors);
+
 static void     gradient_render_pixel       (gdouble           x,
                                              gdouble           y,
                                              GimpRGB          *color,
@@ -161,6 +177,8 @@ static void     gradient_fill_single_region_gray        (RenderBlendData *rbd,
                                                          PixelRegion     *PR);
 static void     gradient_fill_single_region_gray_dither (RenderBlendData *rbd,
                                                          PixelRegion     *PR);
+static void     gradient_fill_single_region_supersample (RenderBlendData *rbd,
+                                                         PixelRegion     *PR);
 
 
 /*  variables for the shapeburst algorithms  */
@@ -503,61 +521,41 @@ gradient_calc_spiral_factor (gdouble   dist,
 }
 
 static gdouble
-gradient_calc_shapeburst_angular_factor (gdouble x,
-                                         gdouble y)
+gradient_calc_shapeburst_angular_factor (gdouble value)
 {
-  Tile   *tile;
-  gfloat  value;
-  gint    ix = CLAMP (x, 0.0, distR.w - 0.7);
-  gint    iy = CLAMP (y, 0.0, distR.h - 0.7);
-
-  tile = tile_manager_get_tile (distR.tiles, ix, iy, TRUE, FALSE);
-
-  value = 1.0 - *((gfloat *) tile_data_pointer (tile, ix, iy));
-
-  tile_release (tile, FALSE);
-
-  return value;
+  return 1.0 - value;
 }
 
-
 static gdouble
-gradient_calc_shapeburst_spherical_factor (gdouble x,
-                                           gdouble y)
+gradient_calc_shapeburst_spherical_factor (gdouble value)
 {
-  Tile   *tile;
-  gfloat  value;
-  gint    ix = CLAMP (x, 0.0, distR.w - 0.7);
-  gint    iy = CLAMP (y, 0.0, distR.h - 0.7);
-
-  tile = tile_manager_get_tile (distR.tiles, ix, iy, TRUE, FALSE);
-
-  value = *((gfloat *) tile_data_pointer (tile, ix, iy));
-  value = 1.0 - sin (0.5 * G_PI * value);
-
-  tile_release (tile, FALSE);
-
-  return value;
+  return 1.0 - sin (0.5 * G_PI * value);
 }
 
-
 static gdouble
-gradient_calc_shapeburst_dimpled_factor (gdouble x,
-                                         gdouble y)
+gradient_calc_shapeburst_dimpled_factor (gdouble value)
 {
-  Tile   *tile;
-  gfloat  value;
-  gint    ix = CLAMP (x, 0.0, distR.w - 0.7);
-  gint    iy = CLAMP (y, 0.0, distR.h - 0.7);
+  return cos (0.5 * G_PI * value);
+}
 
-  tile = tile_manager_get_tile (distR.tiles, ix, iy, TRUE, FALSE);
+/*  reads up to GRADIENT_SPAN normalized distances starting at x, y  */
+static void
+gradient_get_shapeburst_row (gdouble  x,
+                             gdouble  y,
+                             gint     n_pixels,
+                             gdouble *values)
+{
+  gfloat row[GRADIENT_SPAN];
+  gint   ix = CLAMP (x, 0.0, distR.w - 0.7);
+  gint   iy = CLAMP (y, 0.0, distR.h - 0.7);
+  gint   i;
 
-  value = *((gfloat *) tile_data_pointer (tile, ix, iy));
-  value = cos (0.5 * G_PI * value);
+  n_pixels = MIN (n_pixels, distR.w - ix);
 
-  tile_release (tile, FALSE);
+  pixel_region_get_row (&distR, ix, iy, n_pixels, (guchar *) row, 1);
 
-  return value;
+  for (i = 0; i < n_pixels; i++)
+    values[i] = row[i];
 }
 
 static void
@@ -649,76 +647,157 @@ gradient_precalc_shapeburst (GimpImage    *image,
 }
 
 
+/*  Samples the blend colors at GRADIENT_LUT_SIZE + 1 evenly spaced
+ *  factors, so rendering doesn't have to search the gradient's segments
+ *  or convert from HSV for every pixel.
+ */
+static GimpRGB *
+gradient_lut_new (RenderBlendData *rbd)
+{
+  GimpRGB             *lut = g_new (GimpRGB, GRADIENT_LUT_SIZE + 1);
+  GimpGradientSegment *seg = NULL;
+  gint                 i;
+
+  for (i = 0; i <= GRADIENT_LUT_SIZE; i++)
+    {
+      gdouble  factor = (gdouble) i / GRADIENT_LUT_SIZE;
+      GimpRGB *color  = lut + i;
+
+      if (rbd->blend_mode == GIMP_CUSTOM_MODE)
+        {
+          seg = gimp_gradient_get_color_at (rbd->gradient, rbd->context, seg,
+                                            factor, rbd->reverse, color);
+        }
+      else
+        {
+          /* Blend values */
+
+          if (rbd->reverse)
+            factor = 1.0 - factor;
+
+          color->r = rbd->fg.r + (rbd->bg.r - rbd->fg.r) * factor;
+          color->g = rbd->fg.g + (rbd->bg.g - rbd->fg.g) * factor;
+          color->b = rbd->fg.b + (rbd->bg.b - rbd->fg.b) * factor;
+          color->a = rbd->fg.a + (rbd->bg.a - rbd->fg.a) * factor;
+
+          if (rbd->blend_mode == GIMP_FG_BG_HSV_MODE)
+            {
+              GimpHSV hsv = *((GimpHSV *) color);
+
+              gimp_hsv_to_rgb (&hsv, color);
+            }
+        }
+    }
+
+  return lut;
+}
+
+static inline void
+gradient_get_color (const RenderBlendData *rbd,
+                    gdouble                factor,
+                    GimpRGB               *color)
+{
+  const GimpRGB *lut = rbd->lut;
+  gdouble        pos = CLAMP (factor, 0.0, 1.0) * GRADIENT_LUT_SIZE;
+  gint           i   = MIN ((gint) pos, GRADIENT_LUT_SIZE - 1);
+  gdouble        t   = pos - i;
+
+  color->r = lut[i].r + (lut[i + 1].r - lut[i].r) * t;
+  color->g = lut[i].g + (lut[i + 1].g - lut[i].g) * t;
+  color->b = lut[i].b + (lut[i + 1].b - lut[i].b) * t;
+  color->a = lut[i].a + (lut[i + 1].a - lut[i].a) * t;
+}
+
+/*  Computes the blend factors of n_pixels (at most GRADIENT_SPAN)
+ *  consecutive pixels starting at x, y.  The gradient type and repeat
+ *  mode are dispatched once per span, so the loops below are simple
+ *  enough for the compiler to unroll and vectorize.
+ */
 static void
-gradient_render_pixel (gdouble   x,
-                       gdouble   y,
-                       GimpRGB  *color,
-                       gpointer  render_data)
+gradient_calc_factors (RenderBlendData *rbd,
+                       gdouble          x,
+                       gdouble          y,
+                       gint             n_pixels,
+                       gdouble         *factors)
 {
-  RenderBlendData *rbd = render_data;
-  gdouble          factor;
+  gdouble dist   = rbd->dist;
+  gdouble offset = rbd->offset;
+  gdouble vec[2] = { rbd->vec[0], rbd->vec[1] };
+  gdouble dx     = x - rbd->sx;
+  gdouble dy     = y - rbd->sy;
+  gint    i;
 
-  /* Calculate blending factor */
+  /* Calculate blending factors */
 
   switch (rbd->gradient_type)
     {
     case GIMP_GRADIENT_LINEAR:
-      factor = gradient_calc_linear_factor (rbd->dist,
-                                            rbd->vec, rbd->offset,
-                                            x - rbd->sx, y - rbd->sy);
+      for (i = 0; i < n_pixels; i++)
+        factors[i] = gradient_calc_linear_factor (dist, vec, offset,
+                                                  dx + i, dy);
       break;
 
     case GIMP_GRADIENT_BILINEAR:
-      factor = gradient_calc_bilinear_factor (rbd->dist,
-                                              rbd->vec, rbd->offset,
-                                              x - rbd->sx, y - rbd->sy);
+      for (i = 0; i < n_pixels; i++)
+        factors[i] = gradient_calc_bilinear_factor (dist, vec, offset,
+                                                    dx + i, dy);
       break;
 
     case GIMP_GRADIENT_RADIAL:
-      factor = gradient_calc_radial_factor (rbd->dist,
-                                            rbd->offset,
-                                            x - rbd->sx, y - rbd->sy);
+      for (i = 0; i < n_pixels; i++)
+        factors[i] = gradient_calc_radial_factor (dist, offset,
+                                                  dx + i, dy);
       break;
 
     case GIMP_GRADIENT_SQUARE:
-      factor = gradient_calc_square_factor (rbd->dist, rbd->offset,
-                                            x - rbd->sx, y - rbd->sy);
+      for (i = 0; i < n_pixels; i++)
+        factors[i] = gradient_calc_square_factor (dist, offset,
+                                                  dx + i, dy);
       break;
 
     case GIMP_GRADIENT_CONICAL_SYMMETRIC:
-      factor = gradient_calc_conical_sym_factor (rbd->dist,
-                                                 rbd->vec, rbd->offset,
-                                                 x - rbd->sx, y - rbd->sy);
+      for (i = 0; i < n_pixels; i++)
+        factors[i] = gradient_calc_conical_sym_factor (dist, vec, offset,
+                                                       dx + i, dy);
       break;
 
     case GIMP_GRADIENT_CONICAL_ASYMMETRIC:
-      factor = gradient_calc_conical_asym_factor (rbd->dist,
-                                                  rbd->vec, rbd->offset,
-                                                  x - rbd->sx, y - rbd->sy);
+      for (i = 0; i < n_pixels; i++)
+        factors[i] = gradient_calc_conical_asym_factor (dist, vec, offset,
+                                                        dx + i, dy);
       break;
 
     case GIMP_GRADIENT_SHAPEBURST_ANGULAR:
-      factor = gradient_calc_shapeburst_angular_factor (x, y);
+      gradient_get_shapeburst_row (x, y, n_pixels, factors);
+
+      for (i = 0; i < n_pixels; i++)
+        factors[i] = gradient_calc_shapeburst_angular_factor (factors[i]);
       break;
 
     case GIMP_GRADIENT_SHAPEBURST_SPHERICAL:
-      factor = gradient_calc_shapeburst_spherical_factor (x, y);
+      gradient_get_shapeburst_row (x, y, n_pixels, factors);
+
+      for (i = 0; i < n_pixels; i++)
+        factors[i] = gradient_calc_shapeburst_spherical_factor (factors[i]);
       break;
 
     case GIMP_GRADIENT_SHAPEBURST_DIMPLED:
-      factor = gradient_calc_shapeburst_dimpled_factor (x, y);
+      gradient_get_shapeburst_row (x, y, n_pixels, factors);
+
+      for (i = 0; i < n_pixels; i++)
+        factors[i] = gradient_calc_shapeburst_dimpled_factor (factors[i]);
       break;
 
     case GIMP_GRADIENT_SPIRAL_CLOCKWISE:
-      factor = gradient_calc_spiral_factor (rbd->dist,
-                                            rbd->vec, rbd->offset,
-                                            x - rbd->sx, y - rbd->sy, TRUE);
+      for (i = 0; i < n_pixels; i++)
+        factors[i] = gradient_calc_spiral_factor (dist, vec, offset,
+                                                  dx + i, dy, TRUE);
       break;
 
     case GIMP_GRADIENT_SPIRAL_ANTICLOCKWISE:
-      factor = gradient_calc_spiral_factor (rbd->dist,
-                                            rbd->vec, rbd->offset,
-                                            x - rbd->sx, y - rbd->sy, FALSE);
+      for (i = 0; i < n_pixels; i++)
+        factors[i] = gradient_calc_spiral_factor (dist, vec, offset,
+                                                  dx + i, dy, FALSE);
       break;
 
     default:
@@ -731,55 +810,42 @@ gradient_render_pixel (gdouble   x,
   switch (rbd->repeat)
     {
     case GIMP_REPEAT_NONE:
-      factor = CLAMP (factor, 0.0, 1.0);
+      for (i = 0; i < n_pixels; i++)
+        factors[i] = CLAMP (factors[i], 0.0, 1.0);
       break;
 
     case GIMP_REPEAT_SAWTOOTH:
-      factor = factor - floor (factor);
+      for (i = 0; i < n_pixels; i++)
+        factors[i] = factors[i] - floor (factors[i]);
       break;
 
     case GIMP_REPEAT_TRIANGULAR:
-      {
-        guint ifactor;
-
-        if (factor < 0.0)
-          factor = -factor;
+      for (i = 0; i < n_pixels; i++)
+        {
+          gdouble factor = fabs (factors[i]);
+          guint   ifactor;
 
-        ifactor = (guint) factor;
-        factor = factor - floor (factor);
+          ifactor = (guint) factor;
+          factor  = factor - floor (factor);
 
-        if (ifactor & 1)
-          factor = 1.0 - factor;
-      }
+          factors[i] = (ifactor & 1) ? 1.0 - factor : factor;
+        }
       break;
     }
+}
 
-  /* Blend the colors */
-
-  if (rbd->blend_mode == GIMP_CUSTOM_MODE)
-    {
-      gimp_gradient_get_color_at (rbd->gradient, rbd->context, NULL,
-                                  factor, rbd->reverse, color);
-    }
-  else
-    {
-      /* Blend values */
-
-      if (rbd->reverse)
-        factor = 1.0 - factor;
-
-      color->r = rbd->fg.r + (rbd->bg.r - rbd->fg.r) * factor;
-      color->g = rbd->fg.g + (rbd->bg.g - rbd->fg.g) * factor;
-      color->b = rbd->fg.b + (rbd->bg.b - rbd->fg.b) * factor;
-      color->a = rbd->fg.a + (rbd->bg.a - rbd->fg.a) * factor;
+static void
+gradient_render_pixel (gdouble   x,
+                       gdouble   y,
+                       GimpRGB  *color,
+                       gpointer  render_data)
+{
+  RenderBlendData *rbd = render_data;
+  gdouble          factor;
 
-      if (rbd->blend_mode == GIMP_FG_BG_HSV_MODE)
-        {
-          GimpHSV hsv = *((GimpHSV *) color);
+  gradient_calc_factors (rbd, x, y, 1, &factor);
 
-          gimp_hsv_to_rgb (&hsv, color);
-        }
-    }
+  gradient_get_color (rbd, factor, color);
 }
 
 static void
@@ -788,51 +854,28 @@ gradient_put_pixel (gint      x,
                     GimpRGB  *color,
                     gpointer  put_pixel_data)
 {
-  PutPixelData  *ppd  = put_pixel_data;
-  guchar        *dest = ppd->row_data + ppd->bytes * x;
-
-  if (ppd->bytes >= 3)
+  PutPixelData *ppd  = put_pixel_data;
+  PixelRegion  *PR   = ppd->PR;
+  guchar       *dest = (PR->data +
+                        (y - PR->y) * PR->rowstride +
+                        (x - PR->x) * PR->bytes);
+  gint          i    = g_rand_int (ppd->dither_rand);
+
+  if (PR->bytes >= 3)
     {
-      if (ppd->dither_rand)
-        {
-          gint i = g_rand_int (ppd->dither_rand);
-
-          *dest++ = color->r * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-          *dest++ = color->g * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-          *dest++ = color->b * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-          *dest++ = color->a * 255.0 + (gdouble) (i & 0xff) / 256.0;
-        }
-      else
-        {
-          *dest++ = ROUND (color->r * 255.0);
-          *dest++ = ROUND (color->g * 255.0);
-          *dest++ = ROUND (color->b * 255.0);
-          *dest++ = ROUND (color->a * 255.0);
-        }
+      *dest++ = color->r * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
+      *dest++ = color->g * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
+      *dest++ = color->b * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
+      *dest++ = color->a * 255.0 + (gdouble) (i & 0xff) / 256.0;
     }
   else
     {
       /* Convert to grayscale */
       gdouble gray = gimp_rgb_luminance (color);
 
-      if (ppd->dither_rand)
-        {
-          gint i = g_rand_int (ppd->dither_rand);
-
-          *dest++ = gray     * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-          *dest++ = color->a * 255.0 + (gdouble) (i & 0xff) / 256.0;
-        }
-      else
-        {
-          *dest++ = ROUND (gray     * 255.0);
-          *dest++ = ROUND (color->a * 255.0);
-        }
+      *dest++ = gray     * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
+      *dest++ = color->a * 255.0 + (gdouble) (i & 0xff) / 256.0;
     }
-
-  /* Paint whole row if we are on the rightmost pixel */
-
-  if (x == (ppd->width - 1))
-    pixel_region_set_row (ppd->PR, 0, y, ppd->width, ppd->row_data);
 }
 
 static void
@@ -907,6 +950,8 @@ gradient_fill_region (GimpImage        *image,
 
   /* Calculate type-specific parameters */
 
+  rbd.vec[0] = rbd.vec[1] = 0.0;
+
   switch (gradient_type)
     {
     case GIMP_GRADIENT_RADIAL:
@@ -954,62 +999,50 @@ gradient_fill_region (GimpImage        *image,
   rbd.gradient_type = gradient_type;
   rbd.repeat        = repeat;
 
+  rbd.lut           = gradient_lut_new (&rbd);
+  rbd.max_depth     = max_depth;
+  rbd.threshold     = threshold;
+
   /* Render the gradient! */
 
-  if (supersample)
-    {
-      PutPixelData  ppd;
-
-      ppd.PR          = PR;
-      ppd.row_data    = g_malloc (width * PR->bytes);
-      ppd.bytes       = PR->bytes;
-      ppd.width       = width;
-      ppd.dither_rand = g_rand_new ();
-
-      gimp_adaptive_supersample_area (0, 0, (width - 1), (height - 1),
-                                      max_depth, threshold,
-                                      gradient_render_pixel, &rbd,
-                                      gradient_put_pixel, &ppd,
-                                      progress ?
-                                      gimp_progress_update_and_flush : NULL,
-                                      progress);
-
-      g_rand_free (ppd.dither_rand);
-      g_free (ppd.row_data);
-    }
-  else
-    {
-      PixelProcessorFunc          func;
-      PixelProcessorProgressFunc  progress_func = NULL;
+  {
+    PixelProcessorFunc          func;
+    PixelProcessorProgressFunc  progress_func = NULL;
 
-      if (dither)
-        {
-          rbd.seed = g_rand_new ();
+    if (supersample || dither)
+      rbd.seed = g_rand_new ();
 
-          if (PR->bytes >= 3)
-            func = (PixelProcessorFunc) gradient_fill_single_region_rgb_dither;
-          else
-            func = (PixelProcessorFunc) gradient_fill_single_region_gray_dither;
-        }
-      else
-        {
-          if (PR->bytes >= 3)
-            func = (PixelProcessorFunc) gradient_fill_single_region_rgb;
-          else
-            func = (PixelProcessorFunc) gradient_fill_single_region_gray;
-        }
+    if (supersample)
+      {
+        func = (PixelProcessorFunc) gradient_fill_single_region_supersample;
+      }
+    else if (dither)
+      {
+        if (PR->bytes >= 3)
+          func = (PixelProcessorFunc) gradient_fill_single_region_rgb_dither;
+        else
+          func = (PixelProcessorFunc) gradient_fill_single_region_gray_dither;
+      }
+    else
+      {
+        if (PR->bytes >= 3)
+          func = (PixelProcessorFunc) gradient_fill_single_region_rgb;
+        else
+          func = (PixelProcessorFunc) gradient_fill_single_region_gray;
+      }
 
-      if (progress)
-        progress_func = (PixelProcessorProgressFunc) gimp_progress_set_value;
+    if (progress)
+      progress_func = (PixelProcessorProgressFunc) gimp_progress_set_value;
 
-      pixel_regions_process_parallel_progress (func, &rbd,
-                                               progress_func, progress,
-                                               1, PR);
+    pixel_regions_process_parallel_progress (func, &rbd,
+                                             progress_func, progress,
+                                             1, PR);
 
-      if (dither)
-        g_rand_free (rbd.seed);
-    }
+    if (supersample || dither)
+      g_rand_free (rbd.seed);
+  }
 
+  g_free (rbd.lut);
   g_object_unref (rbd.gradient);
 }
 
@@ -1017,48 +1050,66 @@ static void
 gradient_fill_single_region_rgb (RenderBlendData *rbd,
                                  PixelRegion     *PR)
 {
-  guchar *dest = PR->data;
-  gint    endx = PR->x + PR->w;
-  gint    endy = PR->y + PR->h;
-  gint    x, y;
+  gdouble factors[GRADIENT_SPAN];
+  gint    x, y, i;
 
-  for (y = PR->y; y < endy; y++)
-    for (x = PR->x; x < endx; x++)
-      {
-        GimpRGB  color;
+  for (y = 0; y < PR->h; y++)
+    {
+      guchar *dest = PR->data + y * PR->rowstride;
 
-        gradient_render_pixel (x, y, &color, rbd);
+      for (x = 0; x < PR->w; x += GRADIENT_SPAN)
+        {
+          gint n_pixels = MIN (PR->w - x, GRADIENT_SPAN);
 
-        *dest++ = ROUND (color.r * 255.0);
-        *dest++ = ROUND (color.g * 255.0);
-        *dest++ = ROUND (color.b * 255.0);
-        *dest++ = ROUND (color.a * 255.0);
-      }
+          gradient_calc_factors (rbd, PR->x + x, PR->y + y, n_pixels, factors);
+
+          for (i = 0; i < n_pixels; i++)
+            {
+              GimpRGB color;
+
+              gradient_get_color (rbd, factors[i], &color);
+
+              *dest++ = ROUND (color.r * 255.0);
+              *dest++ = ROUND (color.g * 255.0);
+              *dest++ = ROUND (color.b * 255.0);
+              *dest++ = ROUND (color.a * 255.0);
+            }
+        }
+    }
 }
 
 static void
 gradient_fill_single_region_rgb_dither (RenderBlendData *rbd,
                                         PixelRegion     *PR)
 {
-  GRand  *dither_rand = g_rand_new_with_seed (g_rand_int (rbd->seed));
-  guchar *dest        = PR->data;
-  gint    endx        = PR->x + PR->w;
-  gint    endy        = PR->y + PR->h;
-  gint    x, y;
-
-  for (y = PR->y; y < endy; y++)
-    for (x = PR->x; x < endx; x++)
-      {
-        GimpRGB  color;
-        gint     i = g_rand_int (dither_rand);
+  GRand   *dither_rand = g_rand_new_with_seed (g_rand_int (rbd->seed));
+  gdouble  factors[GRADIENT_SPAN];
+  gint     x, y, i;
 
-        gradient_render_pixel (x, y, &color, rbd);
+  for (y = 0; y < PR->h; y++)
+    {
+      guchar *dest = PR->data + y * PR->rowstride;
 
-        *dest++ = color.r * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-        *dest++ = color.g * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-        *dest++ = color.b * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-        *dest++ = color.a * 255.0 + (gdouble) (i & 0xff) / 256.0;
-      }
+      for (x = 0; x < PR->w; x += GRADIENT_SPAN)
+        {
+          gint n_pixels = MIN (PR->w - x, GRADIENT_SPAN);
+
+          gradient_calc_factors (rbd, PR->x + x, PR->y + y, n_pixels, factors);
+
+          for (i = 0; i < n_pixels; i++)
+            {
+              GimpRGB color;
+              gint    r = g_rand_int (dither_rand);
+
+              gradient_get_color (rbd, factors[i], &color);
+
+              *dest++ = color.r * 255.0 + (gdouble) (r & 0xff) / 256.0; r >>= 8;
+              *dest++ = color.g * 255.0 + (gdouble) (r & 0xff) / 256.0; r >>= 8;
+              *dest++ = color.b * 255.0 + (gdouble) (r & 0xff) / 256.0; r >>= 8;
+              *dest++ = color.a * 255.0 + (gdouble) (r & 0xff) / 256.0;
+            }
+        }
+    }
 
   g_rand_free (dither_rand);
 }
@@ -1067,47 +1118,88 @@ static void
 gradient_fill_single_region_gray (RenderBlendData *rbd,
                                   PixelRegion     *PR)
 {
-  guchar *dest = PR->data;
-  gint    endx = PR->x + PR->w;
-  gint    endy = PR->y + PR->h;
-  gint    x, y;
+  gdouble factors[GRADIENT_SPAN];
+  gint    x, y, i;
 
-  for (y = PR->y; y < endy; y++)
-    for (x = PR->x; x < endx; x++)
-      {
-        GimpRGB  color;
+  for (y = 0; y < PR->h; y++)
+    {
+      guchar *dest = PR->data + y * PR->rowstride;
 
-        gradient_render_pixel (x, y, &color, rbd);
+      for (x = 0; x < PR->w; x += GRADIENT_SPAN)
+        {
+          gint n_pixels = MIN (PR->w - x, GRADIENT_SPAN);
 
-        *dest++ = gimp_rgb_luminance_uchar (&color);
-        *dest++ = ROUND (color.a * 255.0);
-      }
+          gradient_calc_factors (rbd, PR->x + x, PR->y + y, n_pixels, factors);
+
+          for (i = 0; i < n_pixels; i++)
+            {
+              GimpRGB color;
+
+              gradient_get_color (rbd, factors[i], &color);
+
+              *dest++ = gimp_rgb_luminance_uchar (&color);
+              *dest++ = ROUND (color.a * 255.0);
+            }
+        }
+    }
 }
 
 static void
 gradient_fill_single_region_gray_dither (RenderBlendData *rbd,
                                          PixelRegion     *PR)
 {
-  GRand  *dither_rand = g_rand_new_with_seed (g_rand_int (rbd->seed));
-  guchar *dest        = PR->data;
-  gint    endx        = PR->x + PR->w;
-  gint    endy        = PR->y + PR->h;
-  gint    x, y;
-
-  for (y = PR->y; y < endy; y++)
-    for (x = PR->x; x < endx; x++)
-      {
-        GimpRGB  color;
-        gdouble  gray;
-        gint     i = g_rand_int (dither_rand);
+  GRand   *dither_rand = g_rand_new_with_seed (g_rand_int (rbd->seed));
+  gdouble  factors[GRADIENT_SPAN];
+  gint     x, y, i;
 
-        gradient_render_pixel (x, y, &color, rbd);
+  for (y = 0; y < PR->h; y++)
+    {
+      guchar *dest = PR->data + y * PR->rowstride;
 
-        gray = gimp_rgb_luminance (&color);
+      for (x = 0; x < PR->w; x += GRADIENT_SPAN)
+        {
+          gint n_pixels = MIN (PR->w - x, GRADIENT_SPAN);
 
-        *dest++ = gray    * 255.0 + (gdouble) (i & 0xff) / 256.0; i >>= 8;
-        *dest++ = color.a * 255.0 + (gdouble) (i & 0xff) / 256.0;
-      }
+          gradient_calc_factors (rbd, PR->x + x, PR->y + y, n_pixels, factors);
+
+          for (i = 0; i < n_pixels; i++)
+            {
+              GimpRGB color;
+              gdouble gray;
+              gint    r = g_rand_int (dither_rand);
+
+              gradient_get_color (rbd, factors[i], &color);
+
+              gray = gimp_rgb_luminance (&color);
+
+              *dest++ = gray    * 255.0 + (gdouble) (r & 0xff) / 256.0; r >>= 8;
+              *dest++ = color.a * 255.0 + (gdouble) (r & 0xff) / 256.0;
+            }
+        }
+    }
 
   g_rand_free (dither_rand);
 }
+
+/*  Supersamples one tile of the region.  Pixels sample the same points
+ *  no matter how the region is split up, so tiles can be rendered
+ *  independently.
+ */
+static void
+gradient_fill_single_region_supersample (RenderBlendData *rbd,
+                                         PixelRegion     *PR)
+{
+  PutPixelData ppd;
+
+  ppd.PR          = PR;
+  ppd.dither_rand = g_rand_new_with_seed (g_rand_int (rbd->seed));
+
+  gimp_adaptive_supersample_area (PR->x, PR->y,
+                                  PR->x + PR->w - 1, PR->y + PR->h - 1,
+                                  rbd->max_depth, rbd->threshold,
+                                  gradient_render_pixel, rbd,
+                                  gradient_put_pixel, &ppd,
+                                  NULL, NULL);
+
+  g_rand_free (ppd.dither_rand);
+}
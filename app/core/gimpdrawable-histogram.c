@@ -31,13 +31,43 @@
 #include "gimpimage.h"
 
 
+static void   gimp_drawable_calculate_histogram_internal (GimpDrawable  *drawable,
+                                                          GimpHistogram *histogram,
+                                                          gboolean       cached);
+
+
+/*  public functions  */
+
 void
 gimp_drawable_calculate_histogram (GimpDrawable  *drawable,
                                    GimpHistogram *histogram)
+{
+  gimp_drawable_calculate_histogram_internal (drawable, histogram, FALSE);
+}
+
+/*  Like gimp_drawable_calculate_histogram(), but only the parts of the
+ *  drawable that have been passed to gimp_histogram_invalidate() since
+ *  the last call are calculated again.
+ */
+void
+gimp_drawable_calculate_histogram_cached (GimpDrawable  *drawable,
+                                          GimpHistogram *histogram)
+{
+  gimp_drawable_calculate_histogram_internal (drawable, histogram, TRUE);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_drawable_calculate_histogram_internal (GimpDrawable  *drawable,
+                                            GimpHistogram *histogram,
+                                            gboolean       cached)
 {
   GimpImage   *image;
   PixelRegion  region;
   PixelRegion  mask;
+  PixelRegion *maskPR = NULL;
   gint         x, y, width, height;
 
   g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
@@ -65,10 +95,11 @@ gimp_drawable_calculate_histogram (GimpDrawable  *drawable,
       pixel_region_init (&mask,
                          gimp_drawable_get_tiles (GIMP_DRAWABLE (sel_mask)),
                          x + off_x, y + off_y, width, height, FALSE);
-      gimp_histogram_calculate (histogram, &region, &mask);
+      maskPR = &mask;
     }
+
+  if (cached)
+    gimp_histogram_calculate_cached (histogram, &region, maskPR);
   else
-    {
-      gimp_histogram_calculate (histogram, &region, NULL);
-    }
+    gimp_histogram_calculate (histogram, &region, maskPR);
 }
@@ -21,8 +21,10 @@
 #define __GIMP_DRAWABLE_HISTOGRAM_H__
 
 
-void   gimp_drawable_calculate_histogram (GimpDrawable  *drawable,
-                                          GimpHistogram *histogram);
+void   gimp_drawable_calculate_histogram        (GimpDrawable  *drawable,
+                                                 GimpHistogram *histogram);
+void   gimp_drawable_calculate_histogram_cached (GimpDrawable  *drawable,
+                                                 GimpHistogram *histogram);
 
 
 #endif /* __GIMP_HISTOGRAM_H__ */
@@ -421,31 +421,15 @@ gimp_drawable_duplicate (GimpItem *item,
       GimpDrawable  *drawable     = GIMP_DRAWABLE (item);
       GimpDrawable  *new_drawable = GIMP_DRAWABLE (new_item);
       GimpImageType  image_type   = gimp_drawable_type (drawable);
-      PixelRegion    srcPR;
-      PixelRegion    destPR;
 
       new_drawable->private->type = image_type;
 
       if (new_drawable->private->tiles)
         tile_manager_unref (new_drawable->private->tiles);
 
+      /*  the tiles are shared and only copied when either one is written  */
       new_drawable->private->tiles =
-        tile_manager_new (gimp_item_get_width  (new_item),
-                          gimp_item_get_height (new_item),
-                          gimp_drawable_bytes (new_drawable));
-
-      pixel_region_init (&srcPR, gimp_drawable_get_tiles (drawable),
-                         0, 0,
-                         gimp_item_get_width  (item),
-                         gimp_item_get_height (item),
-                         FALSE);
-      pixel_region_init (&destPR, gimp_drawable_get_tiles (new_drawable),
-                         0, 0,
-                         gimp_item_get_width  (new_item),
-                         gimp_item_get_height (new_item),
-                         TRUE);
-
-      copy_region (&srcPR, &destPR);
+        tile_manager_duplicate (gimp_drawable_get_tiles (drawable));
     }
 
   return new_item;
@@ -891,7 +875,16 @@ gimp_drawable_real_push_undo (GimpDrawable *drawable,
 {
   gboolean new_tiles = FALSE;
 
-  if (! tiles)
+  if (! tiles &&
+      x == 0 && width  == gimp_item_get_width  (GIMP_ITEM (drawable)) &&
+      y == 0 && height == gimp_item_get_height (GIMP_ITEM (drawable)))
+    {
+      /*  no need to copy anything, the tiles are copied on write  */
+      tiles = tile_manager_duplicate (gimp_drawable_get_tiles (drawable));
+
+      new_tiles = TRUE;
+    }
+  else if (! tiles)
     {
       PixelRegion srcPR, destPR;
 
@@ -18,6 +18,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <cairo.h>
 #include <gegl.h>
@@ -48,8 +49,38 @@ typedef struct
   GimpSelectCriterion  select_criterion;
   gboolean             has_alpha;
   guchar               color[MAX_CHANNELS];
+  gint                 bytes;       /* of color, including alpha      */
+  gint                 hsv[3];      /* of color                       */
+  guchar               lut[256];    /* from difference to mask value  */
 } ContinuousRegionData;
 
+/*  The seed fill computes the differences of whole tiles at once
+ *  and keeps them, together with the locked mask tiles, for as long
+ *  as spans of their row of tiles are on the stack.  A pixel is
+ *  filled when its difference is non-zero and its mask is still zero.
+ */
+typedef struct
+{
+  ContinuousRegionData  *cont;
+  TileManager           *src;
+  TileManager           *mask;
+  gint                   width;
+  gint                   height;
+  gint                   n_cols;    /* of tiles */
+  gint                   n_rows;    /* of tiles */
+  guchar               **diffs;
+  Tile                 **masks;
+  GArray                *stack;     /* of ContiguousSpan */
+  gint                  *n_spans;   /* on the stack, per row of tiles */
+} ContiguousFill;
+
+typedef struct
+{
+  gint y;
+  gint x1;
+  gint x2;
+} ContiguousSpan;
+
 
 /*  local function prototypes  */
 
@@ -57,49 +88,18 @@ static void contiguous_region_by_color    (ContinuousRegionData *cont,
                                            PixelRegion          *imagePR,
                                            PixelRegion          *maskPR);
 
-static gint pixel_difference              (const guchar        *col1,
-                                           const guchar        *col2,
-                                           gboolean             antialias,
-                                           gint                 threshold,
-                                           gint                 bytes,
-                                           gboolean             has_alpha,
-                                           gboolean             select_transparent,
-                                           GimpSelectCriterion  select_criterion);
-static void ref_tiles                     (TileManager         *src,
-                                           TileManager         *mask,
-                                           Tile               **s_tile,
-                                           Tile               **m_tile,
-                                           gint                 x,
-                                           gint                 y,
-                                           guchar             **s,
-                                           guchar             **m);
-static gboolean find_contiguous_segment   (GimpImage           *image,
-                                           const guchar        *col,
-                                           PixelRegion         *src,
-                                           PixelRegion         *mask,
-                                           gint                 width,
-                                           gint                 bytes,
-                                           GimpImageType        src_type,
-                                           gboolean             has_alpha,
-                                           gboolean             select_transparent,
-                                           GimpSelectCriterion  select_criterion,
-                                           gboolean             antialias,
-                                           gint                 threshold,
-                                           gint                 initial,
-                                           gint                *start,
-                                           gint                *end);
-static void find_contiguous_region_helper (GimpImage           *image,
-                                           PixelRegion         *mask,
-                                           PixelRegion         *src,
-                                           GimpImageType        src_type,
-                                           gboolean             has_alpha,
-                                           gboolean             select_transparent,
-                                           GimpSelectCriterion  select_criterion,
-                                           gboolean             antialias,
-                                           gint                 threshold,
-                                           gint                 x,
-                                           gint                 y,
-                                           const guchar        *col);
+static void contiguous_region_init        (ContinuousRegionData *cont);
+static void contiguous_region_difference  (ContinuousRegionData *cont,
+                                           const guchar         *src,
+                                           gint                  stride,
+                                           gint                  n,
+                                           guchar               *dest);
+
+static void contiguous_region_fill        (ContinuousRegionData *cont,
+                                           TileManager          *src,
+                                           TileManager          *mask,
+                                           gint                  x,
+                                           gint                  y);
 
 
 /*  public functions  */
@@ -115,14 +115,14 @@ gimp_image_contiguous_region_by_seed (GimpImage           *image,
                                       gint                 x,
                                       gint                 y)
 {
-  PixelRegion    srcPR, maskPR;
-  GimpPickable  *pickable;
-  TileManager   *tiles;
-  GimpChannel   *mask;
-  GimpImageType  src_type;
-  gboolean       has_alpha;
-  gint           bytes;
-  Tile          *tile;
+  ContinuousRegionData  cont;
+  GimpPickable         *pickable;
+  TileManager          *tiles;
+  GimpChannel          *mask;
+  GimpImageType         src_type;
+  gboolean              has_alpha;
+  gint                  bytes;
+  Tile                 *tile;
 
   g_return_val_if_fail (GIMP_IS_IMAGE (image), NULL);
   g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
@@ -139,24 +139,15 @@ gimp_image_contiguous_region_by_seed (GimpImage           *image,
   bytes     = GIMP_IMAGE_TYPE_BYTES (src_type);
 
   tiles = gimp_pickable_get_tiles (pickable);
-  pixel_region_init (&srcPR, tiles,
-                     0, 0,
-                     tile_manager_width (tiles),
-                     tile_manager_height (tiles),
-                     FALSE);
 
-  mask = gimp_channel_new_mask (image, srcPR.w, srcPR.h);
-  pixel_region_init (&maskPR, gimp_drawable_get_tiles (GIMP_DRAWABLE (mask)),
-                     0, 0,
-                     gimp_item_get_width  (GIMP_ITEM (mask)),
-                     gimp_item_get_height (GIMP_ITEM (mask)),
-                     TRUE);
+  mask = gimp_channel_new_mask (image,
+                                tile_manager_width (tiles),
+                                tile_manager_height (tiles));
 
-  tile = tile_manager_get_tile (srcPR.tiles, x, y, TRUE, FALSE);
+  tile = tile_manager_get_tile (tiles, x, y, TRUE, FALSE);
   if (tile)
     {
       const guchar *start;
-      guchar        start_col[MAX_CHANNELS];
 
       start = tile_data_pointer (tile, x, y);
 
@@ -176,25 +167,37 @@ gimp_image_contiguous_region_by_seed (GimpImage           *image,
           select_transparent = FALSE;
         }
 
+      cont.image              = image;
+      cont.type               = src_type;
+      cont.antialias          = antialias;
+      cont.threshold          = threshold;
+      cont.select_transparent = select_transparent;
+      cont.select_criterion   = select_criterion;
+      cont.has_alpha          = has_alpha;
+
       if (GIMP_IMAGE_TYPE_IS_INDEXED (src_type))
         {
-          gimp_image_get_color (image, src_type, start, start_col);
+          gimp_image_get_color (image, src_type, start, cont.color);
+
+          cont.bytes = has_alpha ? 4 : 3;
         }
       else
         {
           gint i;
 
           for (i = 0; i < bytes; i++)
-            start_col[i] = start[i];
-        }
+            cont.color[i] = start[i];
 
-      find_contiguous_region_helper (image, &maskPR, &srcPR,
-                                     src_type, has_alpha,
-                                     select_transparent, select_criterion,
-                                     antialias, threshold,
-                                     x, y, start_col);
+          cont.bytes = bytes;
+        }
 
       tile_release (tile, FALSE);
+
+      contiguous_region_init (&cont);
+      contiguous_region_fill (&cont,
+                              tiles,
+                              gimp_drawable_get_tiles (GIMP_DRAWABLE (mask)),
+                              x, y);
     }
 
   return mask;
@@ -270,6 +273,9 @@ gimp_image_contiguous_region_by_color (GimpImage            *image,
   cont.threshold          = threshold;
   cont.select_transparent = select_transparent;
   cont.select_criterion   = select_criterion;
+  cont.bytes              = cont.has_alpha ? 4 : 3;
+
+  contiguous_region_init (&cont);
 
   mask = gimp_channel_new_mask (image, width, height);
 
@@ -294,375 +300,447 @@ contiguous_region_by_color (ContinuousRegionData *cont,
 {
   const guchar *image = imagePR->data;
   guchar       *mask  = maskPR->data;
+  guchar        rgba[TILE_WIDTH * 4];
   gint          x, y;
 
   for (y = 0; y < imagePR->h; y++)
     {
       const guchar *i = image;
-      guchar       *m = mask;
 
+      /*  Get the rgb values for the colors  */
       for (x = 0; x < imagePR->w; x++)
         {
-          guchar  rgb[MAX_CHANNELS];
-
-          /*  Get the rgb values for the color  */
-          gimp_image_get_color (cont->image, cont->type, i, rgb);
-
-          /*  Find how closely the colors match  */
-          *m++ = pixel_difference (cont->color, rgb,
-                                   cont->antialias,
-                                   cont->threshold,
-                                   cont->has_alpha ? 4 : 3,
-                                   cont->has_alpha,
-                                   cont->select_transparent,
-                                   cont->select_criterion);
+          gimp_image_get_color (cont->image, cont->type, i, rgba + x * 4);
 
           i += imagePR->bytes;
         }
 
+      /*  Find how closely the colors match  */
+      contiguous_region_difference (cont, rgba, 4, imagePR->w, mask);
+
       image += imagePR->rowstride;
-      mask += maskPR->rowstride;
+      mask  += maskPR->rowstride;
     }
 }
 
-static gint
-pixel_difference (const guchar        *col1,
-                  const guchar        *col2,
-                  gboolean             antialias,
-                  gint                 threshold,
-                  gint                 bytes,
-                  gboolean             has_alpha,
-                  gboolean             select_transparent,
-                  GimpSelectCriterion  select_criterion)
+static void
+contiguous_region_init (ContinuousRegionData *cont)
 {
-  gint max = 0;
+  const gint channels = cont->has_alpha ? cont->bytes - 1 : cont->bytes;
+  gint       i;
 
-  /*  if there is an alpha channel, never select transparent regions  */
-  if (! select_transparent && has_alpha && col2[bytes - 1] == 0)
-    return 0;
+  for (i = 0; i < G_N_ELEMENTS (cont->lut); i++)
+    {
+      if (cont->antialias && cont->threshold > 0)
+        {
+          gfloat aa = 1.5 - ((gfloat) i / cont->threshold);
+
+          if (aa <= 0.0)
+            cont->lut[i] = 0;
+          else if (aa < 0.5)
+            cont->lut[i] = (guchar) (aa * 512);
+          else
+            cont->lut[i] = 255;
+        }
+      else
+        {
+          cont->lut[i] = (i > cont->threshold) ? 0 : 255;
+        }
+    }
+
+  cont->hsv[0] = cont->color[0];
+  cont->hsv[1] = cont->color[MIN (1, channels - 1)];
+  cont->hsv[2] = cont->color[MIN (2, channels - 1)];
+
+  gimp_rgb_to_hsv_int (&cont->hsv[0], &cont->hsv[1], &cont->hsv[2]);
+}
+
+static inline void
+pixel_to_hsv (const guchar *p,
+              gint          channels,
+              gint         *h,
+              gint         *s,
+              gint         *v)
+{
+  *h = p[0];
+  *s = p[MIN (1, channels - 1)];
+  *v = p[MIN (2, channels - 1)];
+
+  gimp_rgb_to_hsv_int (h, s, v);
+}
+
+/*  Finds how closely n pixels of src, stride bytes apart, match
+ *  cont->color.  The criterion is looked at once, so the inner loops
+ *  only run along the pixels.
+ */
+static void
+contiguous_region_difference (ContinuousRegionData *cont,
+                              const guchar         *src,
+                              gint                  stride,
+                              gint                  n,
+                              guchar               *dest)
+{
+  const guchar *col      = cont->color;
+  const gint    alpha    = cont->bytes - 1;
+  const gint    channels = cont->has_alpha ? cont->bytes - 1 : cont->bytes;
+  gint          h, s, v;
+  gint          i, b;
 
-  if (select_transparent && has_alpha)
+  if (cont->select_transparent && cont->has_alpha)
     {
-      max = abs (col1[bytes - 1] - col2[bytes - 1]);
+      for (i = 0; i < n; i++)
+        dest[i] = abs (col[alpha] - src[i * stride + alpha]);
     }
   else
     {
-      gint diff;
-      gint b;
-      gint av0, av1, av2;
-      gint bv0, bv1, bv2;
-
-      if (has_alpha)
-        bytes--;
-
-      switch (select_criterion)
+      switch (cont->select_criterion)
         {
         case GIMP_SELECT_CRITERION_COMPOSITE:
-          for (b = 0; b < bytes; b++)
-            {
-              diff = abs (col1[b] - col2[b]);
-              if (diff > max)
-                max = diff;
-            }
-          break;
+          memset (dest, 0, n);
 
-        case GIMP_SELECT_CRITERION_R:
-          max = abs (col1[0] - col2[0]);
-          break;
+          for (b = 0; b < channels; b++)
+            for (i = 0; i < n; i++)
+              {
+                const gint diff = abs (col[b] - src[i * stride + b]);
 
-        case GIMP_SELECT_CRITERION_G:
-          max = abs (col1[1] - col2[1]);
+                if (diff > dest[i])
+                  dest[i] = diff;
+              }
           break;
 
+        case GIMP_SELECT_CRITERION_R:
+        case GIMP_SELECT_CRITERION_G:
         case GIMP_SELECT_CRITERION_B:
-          max = abs (col1[2] - col2[2]);
+          b = MIN (cont->select_criterion - GIMP_SELECT_CRITERION_R,
+                   channels - 1);
+
+          for (i = 0; i < n; i++)
+            dest[i] = abs (col[b] - src[i * stride + b]);
           break;
 
         case GIMP_SELECT_CRITERION_H:
-          av0 = (gint) col1[0];
-          av1 = (gint) col1[1];
-          av2 = (gint) col1[2];
-          bv0 = (gint) col2[0];
-          bv1 = (gint) col2[1];
-          bv2 = (gint) col2[2];
-          gimp_rgb_to_hsv_int (&av0, &av1, &av2);
-          gimp_rgb_to_hsv_int (&bv0, &bv1, &bv2);
-          /* wrap around candidates for the actual distance */
-          {
-            gint dist1 = abs (av0 - bv0);
-            gint dist2 = abs (av0 - 360 - bv0);
-            gint dist3 = abs (av0 - bv0 + 360);
-            max = MIN (dist1, dist2);
-            if (max > dist3)
-              max = dist3;
-          }
+          for (i = 0; i < n; i++)
+            {
+              gint diff;
+
+              pixel_to_hsv (src + i * stride, channels, &h, &s, &v);
+
+              /* wrap around for the actual distance */
+              diff = abs (cont->hsv[0] - h);
+              dest[i] = MIN (diff, 360 - diff);
+            }
           break;
 
         case GIMP_SELECT_CRITERION_S:
-          av0 = (gint) col1[0];
-          av1 = (gint) col1[1];
-          av2 = (gint) col1[2];
-          bv0 = (gint) col2[0];
-          bv1 = (gint) col2[1];
-          bv2 = (gint) col2[2];
-          gimp_rgb_to_hsv_int (&av0, &av1, &av2);
-          gimp_rgb_to_hsv_int (&bv0, &bv1, &bv2);
-          max = abs (av1 - bv1);
+          for (i = 0; i < n; i++)
+            {
+              pixel_to_hsv (src + i * stride, channels, &h, &s, &v);
+              dest[i] = abs (cont->hsv[1] - s);
+            }
           break;
 
         case GIMP_SELECT_CRITERION_V:
-          av0 = (gint) col1[0];
-          av1 = (gint) col1[1];
-          av2 = (gint) col1[2];
-          bv0 = (gint) col2[0];
-          bv1 = (gint) col2[1];
-          bv2 = (gint) col2[2];
-          gimp_rgb_to_hsv_int (&av0, &av1, &av2);
-          gimp_rgb_to_hsv_int (&bv0, &bv1, &bv2);
-          max = abs (av2 - bv2);
+          for (i = 0; i < n; i++)
+            {
+              pixel_to_hsv (src + i * stride, channels, &h, &s, &v);
+              dest[i] = abs (cont->hsv[2] - v);
+            }
           break;
         }
     }
 
-  if (antialias && threshold > 0)
+  /*  if there is an alpha channel, never select transparent regions  */
+  if (! cont->select_transparent && cont->has_alpha)
     {
-      gfloat aa = 1.5 - ((gfloat) max / threshold);
-
-      if (aa <= 0.0)
-        return 0;
-      else if (aa < 0.5)
-        return (guchar) (aa * 512);
-      else
-        return 255;
+      for (i = 0; i < n; i++)
+        dest[i] = src[i * stride + alpha] ? cont->lut[dest[i]] : 0;
     }
   else
     {
-      if (max > threshold)
-        return 0;
+      for (i = 0; i < n; i++)
+        dest[i] = cont->lut[dest[i]];
+    }
+}
+
+/*  Returns the differences of a tile, computing them the first time
+ *  the tile is looked at.
+ */
+static const guchar *
+contiguous_fill_get_diffs (ContiguousFill *fill,
+                           gint            tile_x,
+                           gint            tile_y)
+{
+  const gint index = tile_y * fill->n_cols + tile_x;
+
+  if (! fill->diffs[index])
+    {
+      ContinuousRegionData *cont = fill->cont;
+      Tile                 *tile;
+      const guchar         *src;
+      guchar               *diffs;
+      gint                  n_pixels;
+      gint                  bpp;
+
+      tile = tile_manager_get_tile (fill->src,
+                                    tile_x * TILE_WIDTH, tile_y * TILE_HEIGHT,
+                                    TRUE, FALSE);
+
+      src      = tile_data_pointer (tile, 0, 0);
+      bpp      = tile_bpp (tile);
+      n_pixels = tile_ewidth (tile) * tile_eheight (tile);
+
+      diffs = g_new (guchar, n_pixels);
+
+      if (GIMP_IMAGE_TYPE_IS_INDEXED (cont->type))
+        {
+          guchar rgba[TILE_WIDTH * 4];
+          gint   i, j;
+
+          for (i = 0; i < n_pixels; i += TILE_WIDTH)
+            {
+              const gint n = MIN (TILE_WIDTH, n_pixels - i);
+
+              for (j = 0; j < n; j++)
+                gimp_image_get_color (cont->image, cont->type,
+                                      src + (i + j) * bpp, rgba + j * 4);
+
+              contiguous_region_difference (cont, rgba, 4, n, diffs + i);
+            }
+        }
       else
-        return 255;
+        {
+          contiguous_region_difference (cont, src, bpp, n_pixels, diffs);
+        }
+
+      tile_release (tile, FALSE);
+
+      fill->diffs[index] = diffs;
     }
+
+  return fill->diffs[index];
 }
 
-static void
-ref_tiles (TileManager  *src,
-           TileManager  *mask,
-           Tile        **s_tile,
-           Tile        **m_tile,
-           gint          x,
-           gint          y,
-           guchar      **s,
-           guchar      **m)
+/*  Looks up the differences and the mask of row y at x, and returns
+ *  how many pixels of the row, starting at x, are in the same tile.
+ */
+static inline gint
+contiguous_fill_get_row (ContiguousFill  *fill,
+                         gint             x,
+                         gint             y,
+                         const guchar   **diff,
+                         guchar         **mask)
 {
-  if (*s_tile != NULL)
-    tile_release (*s_tile, FALSE);
-  if (*m_tile != NULL)
-    tile_release (*m_tile, TRUE);
+  const gint tile_x = x / TILE_WIDTH;
+  const gint tile_y = y / TILE_HEIGHT;
+  const gint index  = tile_y * fill->n_cols + tile_x;
+  const gint ewidth = MIN (TILE_WIDTH, fill->width - tile_x * TILE_WIDTH);
+  const gint offset = (y % TILE_HEIGHT) * ewidth + x % TILE_WIDTH;
+
+  if (! fill->masks[index])
+    fill->masks[index] = tile_manager_get_tile (fill->mask,
+                                                x, y, TRUE, TRUE);
 
-  *s_tile = tile_manager_get_tile (src, x, y, TRUE, FALSE);
-  *m_tile = tile_manager_get_tile (mask, x, y, TRUE, TRUE);
+  *diff = contiguous_fill_get_diffs (fill, tile_x, tile_y) + offset;
+  *mask = (guchar *) tile_data_pointer (fill->masks[index], 0, 0) + offset;
 
-  *s = tile_data_pointer (*s_tile, x, y);
-  *m = tile_data_pointer (*m_tile, x, y);
+  return ewidth - x % TILE_WIDTH;
 }
 
-static gboolean
-find_contiguous_segment (GimpImage           *image,
-                         const guchar        *col,
-                         PixelRegion         *src,
-                         PixelRegion         *mask,
-                         gint                 width,
-                         gint                 bytes,
-                         GimpImageType        src_type,
-                         gboolean             has_alpha,
-                         gboolean             select_transparent,
-                         GimpSelectCriterion  select_criterion,
-                         gboolean             antialias,
-                         gint                 threshold,
-                         gint                 initial,
-                         gint                *start,
-                         gint                *end)
+/*  Returns the first pixel of row y from x to x2 that can be filled,
+ *  or x2 + 1.
+ */
+static gint
+contiguous_fill_skip (ContiguousFill *fill,
+                      gint            x,
+                      gint            x2,
+                      gint            y)
 {
-  guchar *s;
-  guchar *m;
-  guchar  s_color[MAX_CHANNELS];
-  guchar  diff;
-  gint    col_bytes = bytes;
-  Tile   *s_tile    = NULL;
-  Tile   *m_tile    = NULL;
-
-  ref_tiles (src->tiles, mask->tiles,
-             &s_tile, &m_tile, src->x, src->y, &s, &m);
-
-  if (GIMP_IMAGE_TYPE_IS_INDEXED (src_type))
+  while (x <= x2)
     {
-      col_bytes = has_alpha ? 4 : 3;
+      const guchar *diff;
+      guchar       *mask;
+      gint          n;
+      gint          i;
 
-      gimp_image_get_color (image, src_type, s, s_color);
+      n = contiguous_fill_get_row (fill, x, y, &diff, &mask);
+      n = MIN (n, x2 - x + 1);
 
-      diff = pixel_difference (col, s_color, antialias, threshold,
-                               col_bytes, has_alpha, select_transparent,
-                               select_criterion);
-     }
-  else
-    {
-      diff = pixel_difference (col, s, antialias, threshold,
-                               col_bytes, has_alpha, select_transparent,
-                               select_criterion);
+      for (i = 0; i < n && (! diff[i] || mask[i]); i++)
+        ;
+
+      x += i;
+
+      if (i < n)
+        break;
     }
 
-  /* check the starting pixel */
-  if (! diff)
+  return x;
+}
+
+/*  Fills row y from x on for as long as it can be filled, returns the
+ *  first pixel that isn't filled.
+ */
+static gint
+contiguous_fill_right (ContiguousFill *fill,
+                       gint            x,
+                       gint            y)
+{
+  while (x < fill->width)
     {
-      tile_release (s_tile, FALSE);
-      tile_release (m_tile, TRUE);
-      return FALSE;
+      const guchar *diff;
+      guchar       *mask;
+      gint          n;
+      gint          i;
+
+      n = contiguous_fill_get_row (fill, x, y, &diff, &mask);
+
+      for (i = 0; i < n && diff[i] && ! mask[i]; i++)
+        mask[i] = diff[i];
+
+      x += i;
+
+      if (i < n)
+        break;
     }
 
-  *m-- = diff;
-  s -= bytes;
-  *start = initial - 1;
+  return x;
+}
 
-  while (*start >= 0 && diff)
+/*  Fills row y to the left of x for as long as it can be filled,
+ *  returns the last pixel that is filled, or x.
+ */
+static gint
+contiguous_fill_left (ContiguousFill *fill,
+                      gint            x,
+                      gint            y)
+{
+  while (x > 0)
     {
-      if (! ((*start + 1) % TILE_WIDTH))
-        ref_tiles (src->tiles, mask->tiles,
-                   &s_tile, &m_tile, *start, src->y, &s, &m);
+      const guchar *diff;
+      guchar       *mask;
+      gint          n;
+      gint          i;
 
-      if (GIMP_IMAGE_TYPE_IS_INDEXED (src_type))
-        {
-          gimp_image_get_color (image, src_type, s, s_color);
+      contiguous_fill_get_row (fill, x - 1, y, &diff, &mask);
+      n = (x - 1) % TILE_WIDTH + 1;
 
-          diff = pixel_difference (col, s_color, antialias, threshold,
-                                   col_bytes, has_alpha, select_transparent,
-                                   select_criterion);
-        }
-      else
-        {
-          diff = pixel_difference (col, s, antialias, threshold,
-                                   col_bytes, has_alpha, select_transparent,
-                                   select_criterion);
-        }
+      for (i = 0; i < n && diff[-i] && ! mask[-i]; i++)
+        mask[-i] = diff[-i];
 
-      if ((*m-- = diff))
-        {
-          s -= bytes;
-          (*start)--;
-        }
+      x -= i;
+
+      if (i < n)
+        break;
     }
 
-  diff = 1;
-  *end = initial + 1;
+  return x;
+}
 
-  if (*end % TILE_WIDTH && *end < width)
-    ref_tiles (src->tiles, mask->tiles,
-               &s_tile, &m_tile, *end, src->y, &s, &m);
+static inline void
+contiguous_fill_push (ContiguousFill *fill,
+                      gint            y,
+                      gint            x1,
+                      gint            x2)
+{
+  ContiguousSpan span;
 
-  while (*end < width && diff)
-    {
-      if (! (*end % TILE_WIDTH))
-        ref_tiles (src->tiles, mask->tiles,
-                   &s_tile, &m_tile, *end, src->y, &s, &m);
+  span.y  = y;
+  span.x1 = x1;
+  span.x2 = x2;
 
-      if (GIMP_IMAGE_TYPE_IS_INDEXED (src_type))
-        {
-          gimp_image_get_color (image, src_type, s, s_color);
+  g_array_append_val (fill->stack, span);
 
-          diff = pixel_difference (col, s_color, antialias, threshold,
-                                   col_bytes, has_alpha, select_transparent,
-                                   select_criterion);
-        }
-      else
-        {
-          diff = pixel_difference (col, s, antialias, threshold,
-                                   col_bytes, has_alpha, select_transparent,
-                                   select_criterion);
-        }
+  fill->n_spans[y / TILE_HEIGHT]++;
+}
+
+/*  Unlocks the mask tiles and frees the differences of a row of
+ *  tiles.  They are looked up again if the row is filled later on.
+ */
+static void
+contiguous_fill_release_row (ContiguousFill *fill,
+                             gint            tile_y)
+{
+  gint i;
 
-      if ((*m++ = diff))
+  for (i = tile_y * fill->n_cols; i < (tile_y + 1) * fill->n_cols; i++)
+    {
+      if (fill->masks[i])
         {
-          s += bytes;
-          (*end)++;
+          tile_release (fill->masks[i], TRUE);
+          fill->masks[i] = NULL;
         }
-    }
-
-  tile_release (s_tile, FALSE);
-  tile_release (m_tile, TRUE);
 
-  return TRUE;
+      g_free (fill->diffs[i]);
+      fill->diffs[i] = NULL;
+    }
 }
 
+/*  A scanline fill with an explicit stack of spans: each span of a row
+ *  is searched for pixels that can be filled, the runs found are
+ *  extended as far as they go and filled, and the spans above and
+ *  below the runs are pushed.  A span only touches the tiles of its
+ *  own row of tiles, so once no span of a row of tiles is left on the
+ *  stack, its tiles are released.
+ */
 static void
-find_contiguous_region_helper (GimpImage           *image,
-                               PixelRegion         *mask,
-                               PixelRegion         *src,
-                               GimpImageType        src_type,
-                               gboolean             has_alpha,
-                               gboolean             select_transparent,
-                               GimpSelectCriterion  select_criterion,
-                               gboolean             antialias,
-                               gint                 threshold,
-                               gint                 x,
-                               gint                 y,
-                               const guchar        *col)
+contiguous_region_fill (ContinuousRegionData *cont,
+                        TileManager          *src,
+                        TileManager          *mask,
+                        gint                  x,
+                        gint                  y)
 {
-  gint    start, end;
-  gint    new_start, new_end;
-  gint    val;
-  Tile   *tile;
-  GQueue *coord_stack;
-
-  coord_stack = g_queue_new ();
-
-  /* To avoid excessive memory allocation (y, start, end) tuples are
-   * stored in interleaved format:
-   *
-   * [y1] [start1] [end1] [y2] [start2] [end2]
-   */
-  g_queue_push_tail (coord_stack, GINT_TO_POINTER (y));
-  g_queue_push_tail (coord_stack, GINT_TO_POINTER (x - 1));
-  g_queue_push_tail (coord_stack, GINT_TO_POINTER (x + 1));
-
-  do
+  ContiguousFill fill;
+
+  fill.cont    = cont;
+  fill.src     = src;
+  fill.mask    = mask;
+  fill.width   = tile_manager_width (src);
+  fill.height  = tile_manager_height (src);
+  fill.n_cols  = (fill.width  + TILE_WIDTH  - 1) / TILE_WIDTH;
+  fill.n_rows  = (fill.height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+  fill.diffs   = g_new0 (guchar *, fill.n_cols * fill.n_rows);
+  fill.masks   = g_new0 (Tile *, fill.n_cols * fill.n_rows);
+  fill.stack   = g_array_new (FALSE, FALSE, sizeof (ContiguousSpan));
+  fill.n_spans = g_new0 (gint, fill.n_rows);
+
+  contiguous_fill_push (&fill, y, x, x);
+
+  while (fill.stack->len > 0)
     {
-      y     = GPOINTER_TO_INT (g_queue_pop_head (coord_stack));
-      start = GPOINTER_TO_INT (g_queue_pop_head (coord_stack));
-      end   = GPOINTER_TO_INT (g_queue_pop_head (coord_stack));
+      ContiguousSpan span = g_array_index (fill.stack, ContiguousSpan,
+                                           fill.stack->len - 1);
+      const gint     tile_y = span.y / TILE_HEIGHT;
+
+      g_array_set_size (fill.stack, fill.stack->len - 1);
 
-      for (x = start + 1; x < end; x++)
+      x = span.x1;
+
+      while ((x = contiguous_fill_skip (&fill, x, span.x2, span.y)) <= span.x2)
         {
-          tile = tile_manager_get_tile (mask->tiles, x, y, TRUE, FALSE);
-          val = *(const guchar *) tile_data_pointer (tile, x, y);
-          tile_release (tile, FALSE);
-          if (val != 0)
-            continue;
-
-          src->x = x;
-          src->y = y;
-
-          if (! find_contiguous_segment (image, col, src, mask, src->w,
-                                         src->bytes, src_type, has_alpha,
-                                         select_transparent, select_criterion,
-                                         antialias, threshold, x,
-                                         &new_start, &new_end))
-            continue;
-
-          if (y + 1 < src->h)
-            {
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (y + 1));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_start));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_end));
-            }
+          gint start = x;
+          gint end;
 
-          if (y - 1 >= 0)
-            {
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (y - 1));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_start));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_end));
-            }
+          if (x == span.x1)
+            start = contiguous_fill_left (&fill, x, span.y);
+
+          end = contiguous_fill_right (&fill, x, span.y);
+
+          if (span.y > 0)
+            contiguous_fill_push (&fill, span.y - 1, start, end - 1);
+
+          if (span.y + 1 < fill.height)
+            contiguous_fill_push (&fill, span.y + 1, start, end - 1);
+
+          x = end + 1;
         }
+
+      if (--fill.n_spans[tile_y] == 0)
+        contiguous_fill_release_row (&fill, tile_y);
     }
-  while (! g_queue_is_empty (coord_stack));
 
-  g_queue_free (coord_stack);
+  g_array_free (fill.stack, TRUE);
+
+  g_free (fill.diffs);
+  g_free (fill.masks);
+  g_free (fill.n_spans);
 }
@@ -141,6 +141,7 @@
 #include "core-types.h"
 
 #include "base/cpercep.h"
+#include "base/pixel-processor.h"
 #include "base/pixel-region.h"
 #include "base/tile-manager.h"
 
@@ -516,6 +517,34 @@ typedef struct
 } box, *boxptr;
 
 
+/*  The histogram pass and the remapping passes that don't diffuse
+ *  errors run on the pixel processor.  Like in GimpHistogram, every
+ *  thread takes a free slot for the data it accumulates, and the slots
+ *  are merged when the pass is done.
+ */
+
+typedef struct
+{
+  QuantizeObj  *quantobj;
+  CFHistogram   histogram;
+
+  GStaticMutex  mutex;
+  gchar         slots[GIMP_MAX_NUM_THREADS];
+  CFHistogram   histograms[GIMP_MAX_NUM_THREADS];
+  gulong        index_used_count[GIMP_MAX_NUM_THREADS][256];
+
+  gboolean      has_alpha;
+  gboolean      alpha_dither;
+  gint          offsetx, offsety;
+  gint          red_pix, green_pix, blue_pix, alpha_pix;
+
+  GimpProgress *progress;
+  gdouble       progress_start;
+  gdouble       progress_scale;
+} QuantizePass;
+
+
+
 static void zero_histogram_gray     (CFHistogram   histogram);
 static void zero_histogram_rgb      (CFHistogram   histogram);
 static void generate_histogram_gray (CFHistogram   hostogram,
@@ -541,6 +570,15 @@ static void          compute_color_lin8    (QuantizeObj           *quantobj,
                                             boxptr                 boxp,
                                             const int              icolor);
 
+static void          fill_inverse_cmap_gray (QuantizeObj          *quantobj,
+                                             CFHistogram           histogram,
+                                             int                   pixel);
+static void          fill_inverse_cmap_rgb  (QuantizeObj          *quantobj,
+                                             CFHistogram           histogram,
+                                             int                   R,
+                                             int                   G,
+                                             int                   B);
+
 
 static guchar    found_cols[MAXNUMCOLORS][3];
 static gint      num_found_cols;
@@ -1120,6 +1158,203 @@ zero_histogram_rgb (CFHistogram histogram)
 }
 
 
+static void
+quantize_pass_init (QuantizePass *pass,
+                    QuantizeObj  *quantobj,
+                    CFHistogram   histogram,
+                    GimpLayer    *layer)
+{
+  GimpDrawable *drawable = GIMP_DRAWABLE (layer);
+
+  memset (pass->slots, 0, sizeof (pass->slots));
+  memset (pass->histograms, 0, sizeof (pass->histograms));
+  memset (pass->index_used_count, 0, sizeof (pass->index_used_count));
+
+  g_static_mutex_init (&pass->mutex);
+
+  pass->quantobj      = quantobj;
+  pass->histogram     = histogram;
+  pass->histograms[0] = histogram;
+  pass->has_alpha     = gimp_drawable_has_alpha (drawable);
+  pass->alpha_dither  = quantobj ? quantobj->want_alpha_dither : FALSE;
+
+  gimp_item_get_offset (GIMP_ITEM (layer), &pass->offsetx, &pass->offsety);
+
+  /*  In the case of web/mono palettes, we actually force
+   *   grayscale drawables through the rgb pass2 functions
+   */
+  if (gimp_drawable_is_gray (drawable))
+    {
+      pass->red_pix = pass->green_pix = pass->blue_pix = GRAY;
+      pass->alpha_pix = ALPHA_G;
+    }
+  else
+    {
+      pass->red_pix   = RED;
+      pass->green_pix = GREEN;
+      pass->blue_pix  = BLUE;
+      pass->alpha_pix = ALPHA;
+    }
+
+  pass->progress       = quantobj ? quantobj->progress : NULL;
+  pass->progress_start = 0.0;
+  pass->progress_scale = 1.0;
+
+  if (quantobj && quantobj->n_layers > 0)
+    {
+      pass->progress_start = ((gdouble) quantobj->nth_layer /
+                              (gdouble) quantobj->n_layers);
+      pass->progress_scale = 1.0 / (gdouble) quantobj->n_layers;
+    }
+}
+
+/*  Adds up what the threads have accumulated in their slots, and
+ *  frees the extra histograms.
+ */
+static void
+quantize_pass_finish (QuantizePass *pass)
+{
+  gint slot, i;
+
+  for (slot = 1; slot < GIMP_MAX_NUM_THREADS; slot++)
+    {
+      if (pass->histograms[slot])
+        {
+          const ColorFreq *src  = pass->histograms[slot];
+          ColorFreq       *dest = pass->histogram;
+
+          for (i = 0; i < HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS; i++)
+            dest[i] += src[i];
+
+          g_free (pass->histograms[slot]);
+          pass->histograms[slot] = NULL;
+        }
+    }
+
+  if (pass->quantobj)
+    {
+      for (slot = 0; slot < GIMP_MAX_NUM_THREADS; slot++)
+        for (i = 0; i < 256; i++)
+          pass->quantobj->index_used_count[i] +=
+            pass->index_used_count[slot][i];
+    }
+
+  g_static_mutex_free (&pass->mutex);
+}
+
+static gint
+quantize_pass_lock_slot (QuantizePass *pass)
+{
+  gint slot = 0;
+
+  g_static_mutex_lock (&pass->mutex);
+
+  while (pass->slots[slot])
+    slot++;
+
+  pass->slots[slot] = 1;
+
+  g_static_mutex_unlock (&pass->mutex);
+
+  return slot;
+}
+
+static void
+quantize_pass_unlock_slot (QuantizePass *pass,
+                           gint          slot)
+{
+  g_static_mutex_lock (&pass->mutex);
+
+  pass->slots[slot] = 0;
+
+  g_static_mutex_unlock (&pass->mutex);
+}
+
+static void
+quantize_pass_progress (QuantizePass *pass,
+                        gdouble       fraction)
+{
+  gimp_progress_set_value (pass->progress,
+                           pass->progress_start +
+                           fraction * pass->progress_scale);
+}
+
+/*  The inverse colormap is filled lazily.  A cache entry only ever
+ *  changes from 0 to its final value, so it can be looked at without
+ *  the lock, and filled with the lock held.
+ */
+static inline gint
+quantize_pass_lookup_gray (QuantizePass *pass,
+                           gint          pixel)
+{
+  ColorFreq *cachep = &pass->histogram[pixel];
+
+  if (G_UNLIKELY (*cachep == 0))
+    {
+      g_static_mutex_lock (&pass->mutex);
+
+      if (*cachep == 0)
+        fill_inverse_cmap_gray (pass->quantobj, pass->histogram, pixel);
+
+      g_static_mutex_unlock (&pass->mutex);
+    }
+
+  return *cachep - 1;
+}
+
+static inline gint
+quantize_pass_lookup_rgb (QuantizePass *pass,
+                          gint          R,
+                          gint          G,
+                          gint          B)
+{
+  ColorFreq *cachep = HIST_LIN (pass->histogram, R, G, B);
+
+  if (G_UNLIKELY (*cachep == 0))
+    {
+      g_static_mutex_lock (&pass->mutex);
+
+      if (*cachep == 0)
+        fill_inverse_cmap_rgb (pass->quantobj, pass->histogram, R, G, B);
+
+      g_static_mutex_unlock (&pass->mutex);
+    }
+
+  return *cachep - 1;
+}
+
+/*  Runs func on the layer and new_tiles, which have the same size.  */
+static void
+quantize_pass_run_pass2 (QuantizePass       *pass,
+                         PixelProcessorFunc  func,
+                         GimpLayer          *layer,
+                         TileManager        *new_tiles)
+{
+  PixelRegion srcPR, destPR;
+
+  pixel_region_init (&srcPR, gimp_drawable_get_tiles (GIMP_DRAWABLE (layer)),
+                     0, 0,
+                     gimp_item_get_width  (GIMP_ITEM (layer)),
+                     gimp_item_get_height (GIMP_ITEM (layer)),
+                     FALSE);
+  pixel_region_init (&destPR, new_tiles,
+                     0, 0,
+                     gimp_item_get_width  (GIMP_ITEM (layer)),
+                     gimp_item_get_height (GIMP_ITEM (layer)),
+                     TRUE);
+
+  pixel_regions_process_parallel_progress (func, pass,
+                                           pass->progress ?
+                                           (PixelProcessorProgressFunc)
+                                           quantize_pass_progress : NULL,
+                                           pass,
+                                           2, &srcPR, &destPR);
+
+  quantize_pass_finish (pass);
+}
+
+
+
 static void
 generate_histogram_gray (CFHistogram  histogram,
                          GimpLayer   *layer,
@@ -1164,6 +1399,127 @@ generate_histogram_gray (CFHistogram  histogram,
 }
 
 
+static void
+generate_histogram_rgb_region (QuantizePass *pass,
+                               PixelRegion  *srcPR)
+{
+  const guchar *data = srcPR->data;
+  gint          size = srcPR->w * srcPR->h;
+  gint          slot = quantize_pass_lock_slot (pass);
+  CFHistogram   histogram;
+  ColorFreq    *colfreq;
+  gint          row, col, coledge;
+
+  if (! pass->histograms[slot])
+    pass->histograms[slot] = g_new0 (ColorFreq,
+                                     HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS);
+
+  histogram = pass->histograms[slot];
+
+  if (pass->alpha_dither)
+    {
+      /* if alpha-dithering,
+         we need to be deterministic w.r.t. offsets */
+
+      col = srcPR->x + pass->offsetx;
+      coledge = col + srcPR->w;
+      row = srcPR->y + pass->offsety;
+
+      while (size--)
+        {
+          gboolean transparent = FALSE;
+
+          if (pass->has_alpha &&
+              data[ALPHA] <
+              DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK])
+            transparent = TRUE;
+
+          if (! transparent)
+            {
+              colfreq = HIST_RGB (histogram,
+                                  data[RED],
+                                  data[GREEN],
+                                  data[BLUE]);
+              (*colfreq)++;
+            }
+
+          col++;
+          if (col == coledge)
+            {
+              col = srcPR->x + pass->offsetx;
+              row++;
+            }
+
+          data += srcPR->bytes;
+        }
+    }
+  else
+    {
+      while (size--)
+        {
+          if ((pass->has_alpha && ((data[ALPHA] > 127)))
+              || (!pass->has_alpha))
+            {
+              colfreq = HIST_RGB (histogram,
+                                  data[RED],
+                                  data[GREEN],
+                                  data[BLUE]);
+              (*colfreq)++;
+            }
+          data += srcPR->bytes;
+        }
+    }
+
+  quantize_pass_unlock_slot (pass, slot);
+}
+
+/*  Adds the rows from y on to the histogram, on all threads.  This is
+ *  only done once the layer is known to need quantizing, until then the
+ *  colors found are counted one by one.
+ */
+static void
+generate_histogram_rgb_rows (CFHistogram   histogram,
+                             GimpLayer    *layer,
+                             gint          y,
+                             gboolean      alpha_dither,
+                             GimpProgress *progress,
+                             gint          nth_layer,
+                             gint          n_layers)
+{
+  QuantizePass pass;
+  PixelRegion  srcPR;
+  gint         width  = gimp_item_get_width  (GIMP_ITEM (layer));
+  gint         height = gimp_item_get_height (GIMP_ITEM (layer));
+
+  if (y >= height)
+    return;
+
+  quantize_pass_init (&pass, NULL, histogram, layer);
+
+  pass.alpha_dither   = alpha_dither;
+  pass.progress       = progress;
+  pass.progress_start = ((nth_layer + (gdouble) y / height) /
+                         (gdouble) n_layers);
+  pass.progress_scale = ((gdouble) (height - y) / height /
+                         (gdouble) n_layers);
+
+  pixel_region_init (&srcPR, gimp_drawable_get_tiles (GIMP_DRAWABLE (layer)),
+                     0, y, width, height - y,
+                     FALSE);
+
+  pixel_regions_process_parallel_progress ((PixelProcessorFunc)
+                                           generate_histogram_rgb_region,
+                                           &pass,
+                                           progress ?
+                                           (PixelProcessorProgressFunc)
+                                           quantize_pass_progress : NULL,
+                                           &pass,
+                                           1, &srcPR);
+
+  quantize_pass_finish (&pass);
+}
+
+
 static void
 generate_histogram_rgb (CFHistogram   histogram,
                         GimpLayer    *layer,
@@ -1200,6 +1556,13 @@ generate_histogram_rgb (CFHistogram   histogram,
   if (progress)
     gimp_progress_set_value (progress, 0.0);
 
+  if (needs_quantize)
+    {
+      generate_histogram_rgb_rows (histogram, layer, 0, alpha_dither,
+                                   progress, nth_layer, n_layers);
+      return;
+    }
+
   for (pr = pixel_regions_register (1, &srcPR);
        pr != NULL;
        pr = pixel_regions_process (pr), count++)
@@ -1360,6 +1723,21 @@ generate_histogram_rgb (CFHistogram   histogram,
         gimp_progress_set_value (progress,
                                  (nth_layer + ((gdouble) total_size)/
                                   layer_size) / (gdouble) n_layers);
+
+      /*  once the colors don't need to be counted any longer, the
+       *  remaining rows of tiles can be done on all threads
+       */
+      if (needs_quantize &&
+          srcPR.x + srcPR.w == gimp_item_get_width (GIMP_ITEM (layer)))
+        {
+          gint y = srcPR.y + srcPR.h;
+
+          pixel_regions_process_stop (pr);
+
+          generate_histogram_rgb_rows (histogram, layer, y, alpha_dither,
+                                       progress, nth_layer, n_layers);
+          break;
+        }
     }
 
 /*  g_print ("O: col_limit = %d, nfc = %d\n", col_limit, num_found_cols);*/
@@ -2760,574 +3138,450 @@ custompal_pass1 (QuantizeObj *quantobj)
  */
 
 static void
-median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
-                                 GimpLayer   *layer,
-                                 TileManager *new_tiles)
+median_cut_pass2_no_dither_gray_region (QuantizePass *pass,
+                                        PixelRegion  *srcPR,
+                                        PixelRegion  *destPR)
 {
-  PixelRegion   srcPR, destPR;
-  CFHistogram   histogram = quantobj->histogram;
-  ColorFreq    *cachep;
-  const guchar *src;
-  guchar       *dest;
+  const guchar *src              = srcPR->data;
+  guchar       *dest             = destPR->data;
+  gint          slot             = quantize_pass_lock_slot (pass);
+  gulong       *index_used_count = pass->index_used_count[slot];
   gint          row, col;
-  gint          pixel;
-  gint          has_alpha;
-  gulong       *index_used_count = quantobj->index_used_count;
-  gboolean      alpha_dither     = quantobj->want_alpha_dither;
-  gint          offsetx, offsety;
-  gpointer      pr;
-
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
+  gint          pixval;
 
-  has_alpha = gimp_drawable_has_alpha (GIMP_DRAWABLE (layer));
-
-  pixel_region_init (&srcPR, gimp_drawable_get_tiles (GIMP_DRAWABLE (layer)),
-                     0, 0,
-                     gimp_item_get_width  (GIMP_ITEM (layer)),
-                     gimp_item_get_height (GIMP_ITEM (layer)),
-                     FALSE);
-  pixel_region_init (&destPR, new_tiles,
-                     0, 0,
-                     gimp_item_get_width  (GIMP_ITEM (layer)),
-                     gimp_item_get_height (GIMP_ITEM (layer)),
-                     TRUE);
-
-  for (pr = pixel_regions_register (2, &srcPR, &destPR);
-       pr != NULL;
-       pr = pixel_regions_process (pr))
+  for (row = 0; row < srcPR->h; row++)
     {
-      src = srcPR.data;
-      dest = destPR.data;
-
-      for (row = 0; row < srcPR.h; row++)
+      for (col = 0; col < srcPR->w; col++)
         {
-          for (col = 0; col < srcPR.w; col++)
+          /* get pixel value and index into the cache, if we have not
+           * seen this color before, the nearest colormap entry is
+           * looked up and cached
+           */
+          pixval = quantize_pass_lookup_gray (pass, src[GRAY]);
+
+          if (pass->has_alpha)
             {
-              /* get pixel value and index into the cache */
-              pixel = src[GRAY];
-              cachep = &histogram[pixel];
-              /* If we have not seen this color before, find nearest colormap entry */
-              /* and update the cache */
-              if (*cachep == 0)
-                fill_inverse_cmap_gray (quantobj, histogram, pixel);
+              gboolean transparent = FALSE;
 
-              if (has_alpha)
+              if (pass->alpha_dither)
                 {
-                  gboolean transparent = FALSE;
-
-                  if (alpha_dither)
-                    {
-                      gint dither_x = (col + offsetx + srcPR.x) & DM_WIDTHMASK;
-                      gint dither_y = (row + offsety + srcPR.y) & DM_HEIGHTMASK;
-
-                      if ((src[ALPHA_G]) < DM[dither_x][dither_y])
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[ALPHA_G] <= 127)
-                        transparent = TRUE;
-                    }
+                  gint dither_x = ((col + pass->offsetx + srcPR->x) &
+                                   DM_WIDTHMASK);
+                  gint dither_y = ((row + pass->offsety + srcPR->y) &
+                                   DM_HEIGHTMASK);
 
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                    }
-                  else
-                    {
-                      dest[ALPHA_I] = 255;
-                      index_used_count[dest[INDEXED] = *cachep - 1]++;
-                    }
+                  if ((src[ALPHA_G]) < DM[dither_x][dither_y])
+                    transparent = TRUE;
                 }
               else
                 {
-                  /* Now emit the colormap index for this cell */
-                  index_used_count[dest[INDEXED] = *cachep - 1]++;
+                  if (src[ALPHA_G] <= 127)
+                    transparent = TRUE;
                 }
 
-              src += srcPR.bytes;
-              dest += destPR.bytes;
+              if (transparent)
+                {
+                  dest[ALPHA_I] = 0;
+                }
+              else
+                {
+                  dest[ALPHA_I] = 255;
+                  index_used_count[dest[INDEXED] = pixval]++;
+                }
             }
+          else
+            {
+              /* Now emit the colormap index for this cell */
+              index_used_count[dest[INDEXED] = pixval]++;
+            }
+
+          src += srcPR->bytes;
+          dest += destPR->bytes;
         }
     }
+
+  quantize_pass_unlock_slot (pass, slot);
 }
 
 static void
-median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
-                                    GimpLayer   *layer,
-                                    TileManager *new_tiles)
+median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
+                                 GimpLayer   *layer,
+                                 TileManager *new_tiles)
 {
-  PixelRegion   srcPR, destPR;
-  CFHistogram   histogram = quantobj->histogram;
-  ColorFreq    *cachep;
+  QuantizePass pass;
+
+  quantize_pass_init (&pass, quantobj, quantobj->histogram, layer);
+  quantize_pass_run_pass2 (&pass,
+                           (PixelProcessorFunc)
+                           median_cut_pass2_no_dither_gray_region,
+                           layer, new_tiles);
+}
+
+static void
+median_cut_pass2_fixed_dither_gray_region (QuantizePass *pass,
+                                           PixelRegion  *srcPR,
+                                           PixelRegion  *destPR)
+{
+  QuantizeObj  *quantobj         = pass->quantobj;
+  const guchar *src              = srcPR->data;
+  guchar       *dest             = destPR->data;
+  gint          slot             = quantize_pass_lock_slot (pass);
+  gulong       *index_used_count = pass->index_used_count[slot];
   gint          pixval1=0, pixval2=0;
   gint          err1,err2;
   Color        *color1;
   Color        *color2;
-  const guchar *src;
-  guchar       *dest;
   gint          row, col;
-  gint          pixel;
-  gulong       *index_used_count = quantobj->index_used_count;
-  gboolean      has_alpha;
-  gboolean      alpha_dither     = quantobj->want_alpha_dither;
-  gint          offsetx, offsety;
-  gpointer      pr;
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
+  for (row = 0; row < srcPR->h; row++)
+    {
+      for (col = 0; col < srcPR->w; col++)
+        {
+          const int dmval =
+            DM[(col + pass->offsetx + srcPR->x) & DM_WIDTHMASK]
+            [(row + pass->offsety + srcPR->y) & DM_HEIGHTMASK];
+
+          /* get pixel value and index into the cache */
+          pixval1 = quantize_pass_lookup_gray (pass, src[GRAY]);
+          color1 = &quantobj->cmap[pixval1];
+
+          if (quantobj->actual_number_of_colors > 2) {
+            const int re = src[GRAY] - (int)color1->red;
+            int RV = src[GRAY] + re;
+            do {
+              const gint R = CLAMP0255(RV);
+              pixval2 = quantize_pass_lookup_gray (pass, R);
+              RV += re;
+            } while((pixval1 == pixval2) &&
+                    (! (RV>255 || RV<0) ) &&
+                    re);
+          } else {
+            /* not enough colours to bother looking for an 'alternative'
+               colour (we may fail to do so anyway), so decide that
+               the alternative colour is simply the other cmap entry. */
+            pixval2 = (pixval1 + 1) %
+              (quantobj->actual_number_of_colors);
+          }
 
-  has_alpha = gimp_drawable_has_alpha (GIMP_DRAWABLE (layer));
+          /* always deterministically sort pixval1 and pixval2, to
+             avoid artifacts in the dither range due to inverting our
+             relative colour viewpoint -- most obvious in 1-bit dither. */
+          if (pixval1 > pixval2) {
+            gint tmpval = pixval1;
+            pixval1 = pixval2;
+            pixval2 = tmpval;
+            color1 = &quantobj->cmap[pixval1];
+          }
 
-  pixel_region_init (&srcPR, gimp_drawable_get_tiles (GIMP_DRAWABLE (layer)),
-                     0, 0,
-                     gimp_item_get_width  (GIMP_ITEM (layer)),
-                     gimp_item_get_height (GIMP_ITEM (layer)),
-                     FALSE);
-  pixel_region_init (&destPR, new_tiles,
-                     0, 0,
-                     gimp_item_get_width  (GIMP_ITEM (layer)),
-                     gimp_item_get_height (GIMP_ITEM (layer)),
-                     TRUE);
+          color2 = &quantobj->cmap[pixval2];
 
-  for (pr = pixel_regions_register (2, &srcPR, &destPR);
-       pr != NULL;
-       pr = pixel_regions_process (pr))
-    {
-      src = srcPR.data;
-      dest = destPR.data;
+          err1 = ABS(color1->red - src[GRAY]);
+          err2 = ABS(color2->red - src[GRAY]);
+          if (err1 || err2) {
+            const int proportion2 = (256 * 255 * err2) / (err1 + err2);
+            if ((dmval * 256) > proportion2) {
+              pixval1 = pixval2; /* use color2 instead of color1*/
+            }
+          }
 
-      for (row = 0; row < srcPR.h; row++)
-        {
-          for (col = 0; col < srcPR.w; col++)
+          if (pass->has_alpha)
             {
-              const int dmval =
-                DM[(col + offsetx + srcPR.x) & DM_WIDTHMASK]
-                [(row + offsety + srcPR.y) & DM_HEIGHTMASK];
-
-              /* get pixel value and index into the cache */
-              pixel = src[GRAY];
-              cachep = &histogram[pixel];
-              /* If we have not seen this color before, find nearest colormap entry */
-              /* and update the cache */
-              if (*cachep == 0)
-                fill_inverse_cmap_gray (quantobj, histogram, pixel);
-
-              pixval1 = *cachep - 1;
-              color1 = &quantobj->cmap[pixval1];
-
-              if (quantobj->actual_number_of_colors > 2) {
-                const int re = src[GRAY] - (int)color1->red;
-                int RV = src[GRAY] + re;
-                do {
-                  const gint R = CLAMP0255(RV);
-                  cachep = &histogram[R];
-                  /* If we have not seen this color before, find nearest
-                     colormap entry and update the cache */
-                  if (*cachep == 0) {
-                    fill_inverse_cmap_gray (quantobj, histogram, R);
-                  }
-                  pixval2 = *cachep - 1;
-                  RV += re;
-                } while((pixval1 == pixval2) &&
-                        (! (RV>255 || RV<0) ) &&
-                        re);
-              } else {
-                /* not enough colours to bother looking for an 'alternative'
-                   colour (we may fail to do so anyway), so decide that
-                   the alternative colour is simply the other cmap entry. */
-                pixval2 = (pixval1 + 1) %
-                  (quantobj->actual_number_of_colors);
-              }
-
-              /* always deterministically sort pixval1 and pixval2, to
-                 avoid artifacts in the dither range due to inverting our
-                 relative colour viewpoint -- most obvious in 1-bit dither. */
-              if (pixval1 > pixval2) {
-                gint tmpval = pixval1;
-                pixval1 = pixval2;
-                pixval2 = tmpval;
-                color1 = &quantobj->cmap[pixval1];
-              }
-
-              color2 = &quantobj->cmap[pixval2];
+              gboolean transparent = FALSE;
 
-              err1 = ABS(color1->red - src[GRAY]);
-              err2 = ABS(color2->red - src[GRAY]);
-              if (err1 || err2) {
-                const int proportion2 = (256 * 255 * err2) / (err1 + err2);
-                if ((dmval * 256) > proportion2) {
-                  pixval1 = pixval2; /* use color2 instead of color1*/
+              if (pass->alpha_dither)
+                {
+                  if (src[ALPHA_G] < dmval)
+                    transparent = TRUE;
                 }
-              }
-
-              if (has_alpha)
+              else
                 {
-                  gboolean transparent = FALSE;
-
-                  if (alpha_dither)
-                    {
-                      if (src[ALPHA_G] < dmval)
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[ALPHA_G] <= 127)
-                        transparent = TRUE;
-                    }
+                  if (src[ALPHA_G] <= 127)
+                    transparent = TRUE;
+                }
 
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                    }
-                  else
-                    {
-                      dest[ALPHA_I] = 255;
-                      index_used_count[dest[INDEXED] = pixval1]++;
-                    }
+              if (transparent)
+                {
+                  dest[ALPHA_I] = 0;
                 }
               else
                 {
-                  /* Now emit the colormap index for this cell, barfbarf */
+                  dest[ALPHA_I] = 255;
                   index_used_count[dest[INDEXED] = pixval1]++;
                 }
-
-              src += srcPR.bytes;
-              dest += destPR.bytes;
             }
+          else
+            {
+              /* Now emit the colormap index for this cell, barfbarf */
+              index_used_count[dest[INDEXED] = pixval1]++;
+            }
+
+          src += srcPR->bytes;
+          dest += destPR->bytes;
         }
     }
+
+  quantize_pass_unlock_slot (pass, slot);
 }
 
 static void
-median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
-                                GimpLayer   *layer,
-                                TileManager *new_tiles)
+median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
+                                    GimpLayer   *layer,
+                                    TileManager *new_tiles)
 {
-  PixelRegion   srcPR, destPR;
-  CFHistogram   histogram = quantobj->histogram;
-  ColorFreq    *cachep;
-  const guchar *src;
-  guchar       *dest;
-  gint          R, G, B;
-  gint          row, col;
-  gboolean      has_alpha;
-  gpointer      pr;
-  gint          red_pix          = RED;
-  gint          green_pix        = GREEN;
-  gint          blue_pix         = BLUE;
-  gint          alpha_pix        = ALPHA;
-  gboolean      alpha_dither     = quantobj->want_alpha_dither;
-  gint          offsetx, offsety;
-  gulong       *index_used_count = quantobj->index_used_count;
-  glong         total_size       = 0;
-  glong         layer_size;
-  gint          count            = 0;
-  gint          nth_layer        = quantobj->nth_layer;
-  gint          n_layers         = quantobj->n_layers;
+  QuantizePass pass;
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
-
-  /*  In the case of web/mono palettes, we actually force
-   *   grayscale drawables through the rgb pass2 functions
-   */
-  if (gimp_drawable_is_gray (GIMP_DRAWABLE (layer)))
-    {
-      red_pix = green_pix = blue_pix = GRAY;
-      alpha_pix = ALPHA_G;
-    }
-
-  has_alpha = gimp_drawable_has_alpha (GIMP_DRAWABLE (layer));
-
-  pixel_region_init (&srcPR, gimp_drawable_get_tiles (GIMP_DRAWABLE (layer)),
-                     0, 0,
-                     gimp_item_get_width  (GIMP_ITEM (layer)),
-                     gimp_item_get_height (GIMP_ITEM (layer)),
-                     FALSE);
-  pixel_region_init (&destPR, new_tiles,
-                     0, 0,
-                     gimp_item_get_width  (GIMP_ITEM (layer)),
-                     gimp_item_get_height (GIMP_ITEM (layer)),
-                     TRUE);
+  quantize_pass_init (&pass, quantobj, quantobj->histogram, layer);
+  quantize_pass_run_pass2 (&pass,
+                           (PixelProcessorFunc)
+                           median_cut_pass2_fixed_dither_gray_region,
+                           layer, new_tiles);
+}
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
+static void
+median_cut_pass2_no_dither_rgb_region (QuantizePass *pass,
+                                       PixelRegion  *srcPR,
+                                       PixelRegion  *destPR)
+{
+  const guchar *src              = srcPR->data;
+  guchar       *dest             = destPR->data;
+  gint          slot             = quantize_pass_lock_slot (pass);
+  gulong       *index_used_count = pass->index_used_count[slot];
+  gint          red_pix          = pass->red_pix;
+  gint          green_pix        = pass->green_pix;
+  gint          blue_pix         = pass->blue_pix;
+  gint          alpha_pix        = pass->alpha_pix;
+  gint          R, G, B;
+  gint          row, col;
 
-  for (pr = pixel_regions_register (2, &srcPR, &destPR);
-       pr != NULL;
-       pr = pixel_regions_process (pr), count++)
+  for (row = 0; row < srcPR->h; row++)
     {
-      src = srcPR.data;
-      dest = destPR.data;
-
-      total_size += srcPR.h * srcPR.w;
-
-      for (row = 0; row < srcPR.h; row++)
+      for (col = 0; col < srcPR->w; col++)
         {
-          for (col = 0; col < srcPR.w; col++)
+          if (pass->has_alpha)
             {
-              if (has_alpha)
+              gboolean transparent = FALSE;
+
+              if (pass->alpha_dither)
                 {
-                  gboolean transparent = FALSE;
+                  gint dither_x = ((col + pass->offsetx + srcPR->x) &
+                                   DM_WIDTHMASK);
+                  gint dither_y = ((row + pass->offsety + srcPR->y) &
+                                   DM_HEIGHTMASK);
 
-                  if (alpha_dither)
-                    {
-                      gint dither_x = (col + offsetx + srcPR.x) & DM_WIDTHMASK;
-                      gint dither_y = (row + offsety + srcPR.y) & DM_HEIGHTMASK;
-                      if ((src[alpha_pix]) < DM[dither_x][dither_y])
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[alpha_pix] <= 127)
-                        transparent = TRUE;
-                    }
+                  if ((src[alpha_pix]) < DM[dither_x][dither_y])
+                    transparent = TRUE;
+                }
+              else
+                {
+                  if (src[alpha_pix] <= 127)
+                    transparent = TRUE;
+                }
 
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                      goto next_pixel;
-                    }
-                  else
-                    {
-                      dest[ALPHA_I] = 255;
-                    }
+              if (transparent)
+                {
+                  dest[ALPHA_I] = 0;
+                  goto next_pixel;
                 }
+              else
+                {
+                  dest[ALPHA_I] = 255;
+                }
+            }
 
-              /* get pixel value and index into the cache */
-              rgb_to_lin(src[red_pix], src[green_pix], src[blue_pix],
-                         &R, &G, &B);
-              cachep = HIST_LIN(histogram,R,G,B);
-              /* If we have not seen this color before, find nearest
-                 colormap entry and update the cache */
-              if (*cachep == 0)
-                fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
+          /* get pixel value and index into the cache */
+          rgb_to_lin(src[red_pix], src[green_pix], src[blue_pix],
+                     &R, &G, &B);
 
-              /* Now emit the colormap index for this cell, barfbarf */
-              index_used_count[dest[INDEXED] = *cachep - 1]++;
+          /* Now emit the colormap index for this cell, barfbarf */
+          index_used_count[dest[INDEXED] =
+                           quantize_pass_lookup_rgb (pass, R, G, B)]++;
 
-            next_pixel:
+        next_pixel:
 
-              src += srcPR.bytes;
-              dest += destPR.bytes;
-            }
+          src += srcPR->bytes;
+          dest += destPR->bytes;
         }
-
-      if (quantobj->progress && (count % 16 == 0))
-         gimp_progress_set_value (quantobj->progress,
-                                  (nth_layer + ((gdouble) total_size)/
-                                   layer_size) / (gdouble) n_layers);
     }
+
+  quantize_pass_unlock_slot (pass, slot);
 }
 
 static void
-median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
-                                   GimpLayer   *layer,
-                                   TileManager *new_tiles)
+median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
+                                GimpLayer   *layer,
+                                TileManager *new_tiles)
 {
-  PixelRegion   srcPR, destPR;
-  CFHistogram   histogram = quantobj->histogram;
-  ColorFreq    *cachep;
+  QuantizePass pass;
+
+  quantize_pass_init (&pass, quantobj, quantobj->histogram, layer);
+  quantize_pass_run_pass2 (&pass,
+                           (PixelProcessorFunc)
+                           median_cut_pass2_no_dither_rgb_region,
+                           layer, new_tiles);
+}
+
+static void
+median_cut_pass2_fixed_dither_rgb_region (QuantizePass *pass,
+                                          PixelRegion  *srcPR,
+                                          PixelRegion  *destPR)
+{
+  QuantizeObj  *quantobj         = pass->quantobj;
+  const guchar *src              = srcPR->data;
+  guchar       *dest             = destPR->data;
+  gint          slot             = quantize_pass_lock_slot (pass);
+  gulong       *index_used_count = pass->index_used_count[slot];
+  gint          red_pix          = pass->red_pix;
+  gint          green_pix        = pass->green_pix;
+  gint          blue_pix         = pass->blue_pix;
+  gint          alpha_pix        = pass->alpha_pix;
   gint          pixval1=0, pixval2=0;
   Color*        color1;
   Color*        color2;
-  const guchar *src;
-  guchar       *dest;
   gint          R, G, B;
   gint          err1,err2;
   gint          row, col;
-  gboolean      has_alpha;
-  gpointer      pr;
-  gint          red_pix          = RED;
-  gint          green_pix        = GREEN;
-  gint          blue_pix         = BLUE;
-  gint          alpha_pix        = ALPHA;
-  gboolean      alpha_dither     = quantobj->want_alpha_dither;
-  gint          offsetx, offsety;
-  gulong       *index_used_count = quantobj->index_used_count;
-  glong         total_size       = 0;
-  glong         layer_size;
-  gint          count            = 0;
-  gint          nth_layer        = quantobj->nth_layer;
-  gint          n_layers         = quantobj->n_layers;
-
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
 
-  /*  In the case of web/mono palettes, we actually force
-   *   grayscale drawables through the rgb pass2 functions
-   */
-  if (gimp_drawable_is_gray (GIMP_DRAWABLE (layer)))
+  for (row = 0; row < srcPR->h; row++)
     {
-      red_pix = green_pix = blue_pix = GRAY;
-      alpha_pix = ALPHA_G;
-    }
-
-  has_alpha = gimp_drawable_has_alpha (GIMP_DRAWABLE (layer));
-
-  pixel_region_init (&srcPR, gimp_drawable_get_tiles (GIMP_DRAWABLE (layer)),
-                     0, 0,
-                     gimp_item_get_width  (GIMP_ITEM (layer)),
-                     gimp_item_get_height (GIMP_ITEM (layer)),
-                     FALSE);
-  pixel_region_init (&destPR, new_tiles,
-                     0, 0,
-                     gimp_item_get_width  (GIMP_ITEM (layer)),
-                     gimp_item_get_height (GIMP_ITEM (layer)),
-                     TRUE);
-
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
-
-  for (pr = pixel_regions_register (2, &srcPR, &destPR);
-       pr != NULL;
-       pr = pixel_regions_process (pr), count++)
-    {
-      src = srcPR.data;
-      dest = destPR.data;
-
-      total_size += srcPR.h * srcPR.w;
-
-      for (row = 0; row < srcPR.h; row++)
+      for (col = 0; col < srcPR->w; col++)
         {
-          for (col = 0; col < srcPR.w; col++)
+          const int dmval =
+            DM[(col + pass->offsetx + srcPR->x) & DM_WIDTHMASK]
+            [(row + pass->offsety + srcPR->y) & DM_HEIGHTMASK];
+
+          if (pass->has_alpha)
             {
-              const int dmval =
-                DM[(col + offsetx + srcPR.x) & DM_WIDTHMASK]
-                [(row + offsety + srcPR.y) & DM_HEIGHTMASK];
+              gboolean transparent = FALSE;
 
-              if (has_alpha)
+              if (pass->alpha_dither)
                 {
-                  gboolean transparent = FALSE;
-
-                  if (alpha_dither)
-                    {
-                      if (src[alpha_pix] < dmval)
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (src[alpha_pix] <= 127)
-                        transparent = TRUE;
-                    }
+                  if (src[alpha_pix] < dmval)
+                    transparent = TRUE;
+                }
+              else
+                {
+                  if (src[alpha_pix] <= 127)
+                    transparent = TRUE;
+                }
 
-                  if (transparent)
-                    {
-                      dest[ALPHA_I] = 0;
-                      goto next_pixel;
-                    }
-                  else
-                    {
-                      dest[ALPHA_I] = 255;
-                    }
+              if (transparent)
+                {
+                  dest[ALPHA_I] = 0;
+                  goto next_pixel;
                 }
+              else
+                {
+                  dest[ALPHA_I] = 255;
+                }
+            }
 
-              /* get pixel value and index into the cache */
-              rgb_to_lin(src[red_pix], src[green_pix], src[blue_pix],
+          /* get pixel value and index into the cache */
+          rgb_to_lin(src[red_pix], src[green_pix], src[blue_pix],
+                     &R, &G, &B);
+
+          /* We now try to find a colour which, when mixed in some fashion
+             with the closest match, yields something closer to the
+             desired colour.  We do this by repeatedly extrapolating the
+             colour vector from one to the other until we find another
+             colour cell.  Then we assess the distance of both mixer
+             colours from the intended colour to determine their relative
+             probabilities of being chosen. */
+          pixval1 = quantize_pass_lookup_rgb (pass, R, G, B);
+          color1 = &quantobj->cmap[pixval1];
+
+          if (quantobj->actual_number_of_colors > 2) {
+            const int re = src[red_pix] - (int)color1->red;
+            const int ge = src[green_pix] - (int)color1->green;
+            const int be = src[blue_pix] - (int)color1->blue;
+            int RV = src[red_pix] + re;
+            int GV = src[green_pix] + ge;
+            int BV = src[blue_pix] + be;
+            do {
+              rgb_to_lin((CLAMP0255(RV)),
+                         (CLAMP0255(GV)),
+                         (CLAMP0255(BV)),
                          &R, &G, &B);
-              cachep = HIST_LIN(histogram,R,G,B);
-              /* If we have not seen this color before, find nearest
-                 colormap entry and update the cache */
-              if (*cachep == 0)
-                fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
-
-              /* We now try to find a colour which, when mixed in some fashion
-                 with the closest match, yields something closer to the
-                 desired colour.  We do this by repeatedly extrapolating the
-                 colour vector from one to the other until we find another
-                 colour cell.  Then we assess the distance of both mixer
-                 colours from the intended colour to determine their relative
-                 probabilities of being chosen. */
-              pixval1 = *cachep - 1;
-              color1 = &quantobj->cmap[pixval1];
-
-              if (quantobj->actual_number_of_colors > 2) {
-                const int re = src[red_pix] - (int)color1->red;
-                const int ge = src[green_pix] - (int)color1->green;
-                const int be = src[blue_pix] - (int)color1->blue;
-                int RV = src[red_pix] + re;
-                int GV = src[green_pix] + ge;
-                int BV = src[blue_pix] + be;
-                do {
-                   rgb_to_lin((CLAMP0255(RV)),
-                              (CLAMP0255(GV)),
-                              (CLAMP0255(BV)),
-                              &R, &G, &B);
-                  cachep = HIST_LIN(histogram,R,G,B);
-                  /* If we have not seen this color before, find nearest
-                     colormap entry and update the cache */
-                  if (*cachep == 0) {
-                    fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
-                  }
-                  pixval2 = *cachep - 1;
-                  RV += re;  GV += ge;  BV += be;
-                } while((pixval1 == pixval2) &&
-                        (!( (RV>255 || RV<0) || (GV>255 || GV<0) || (BV>255 || BV<0) )) &&
-                        (re || ge || be));
-              }
-              if (quantobj->actual_number_of_colors <= 2
-                  /* || pixval1 == pixval2 */) {
-                /* not enough colours to bother looking for an 'alternative'
-                   colour (we may fail to do so anyway), so decide that
-                   the alternative colour is simply the other cmap entry. */
-                pixval2 = (pixval1 + 1) %
-                  (quantobj->actual_number_of_colors);
-              }
+              pixval2 = quantize_pass_lookup_rgb (pass, R, G, B);
+              RV += re;  GV += ge;  BV += be;
+            } while((pixval1 == pixval2) &&
+                    (!( (RV>255 || RV<0) || (GV>255 || GV<0) || (BV>255 || BV<0) )) &&
+                    (re || ge || be));
+          }
+          if (quantobj->actual_number_of_colors <= 2
+              /* || pixval1 == pixval2 */) {
+            /* not enough colours to bother looking for an 'alternative'
+               colour (we may fail to do so anyway), so decide that
+               the alternative colour is simply the other cmap entry. */
+            pixval2 = (pixval1 + 1) %
+              (quantobj->actual_number_of_colors);
+          }
 
-              /* always deterministically sort pixval1 and pixval2, to
-                 avoid artifacts in the dither range due to inverting our
-                 relative colour viewpoint -- most obvious in 1-bit dither. */
-              if (pixval1 > pixval2) {
-                gint tmpval = pixval1;
-                pixval1 = pixval2;
-                pixval2 = tmpval;
-                color1 = &quantobj->cmap[pixval1];
-              }
+          /* always deterministically sort pixval1 and pixval2, to
+             avoid artifacts in the dither range due to inverting our
+             relative colour viewpoint -- most obvious in 1-bit dither. */
+          if (pixval1 > pixval2) {
+            gint tmpval = pixval1;
+            pixval1 = pixval2;
+            pixval2 = tmpval;
+            color1 = &quantobj->cmap[pixval1];
+          }
 
-              color2 = &quantobj->cmap[pixval2];
+          color2 = &quantobj->cmap[pixval2];
 
-              /* now figure out the relative probabilites of choosing
-                 either of our candidates. */
+          /* now figure out the relative probabilites of choosing
+             either of our candidates. */
 #define DISTP(R1,G1,B1,R2,G2,B2,D) do {D = sqrt( 30*SQR((R1)-(R2)) + \
                                                  59*SQR((G1)-(G2)) + \
                                                  11*SQR((B1)-(B2)) ); }while(0)
 #define LIN_DISTP(R1,G1,B1,R2,G2,B2,D) do { \
-                int spacer1, spaceg1, spaceb1; \
-                int spacer2, spaceg2, spaceb2; \
-                rgb_to_unshifted_lin(R1,G1,B1, &spacer1, &spaceg1, &spaceb1); \
-                rgb_to_unshifted_lin(R2,G2,B2, &spacer2, &spaceg2, &spaceb2); \
-                D = sqrt(R_SCALE * SQR((spacer1)-(spacer2)) + \
-                         G_SCALE * SQR((spaceg1)-(spaceg2)) + \
-                         B_SCALE * SQR((spaceb1)-(spaceb2))); \
-              } while(0)
-              /* although LIN_DISTP is more correct, DISTP is much faster and
-                 barely distinguishable. */
-              DISTP(color1->red, color1->green, color1->blue,
-                    src[red_pix], src[green_pix], src[blue_pix],
-                    err1);
-              DISTP(color2->red, color2->green, color2->blue,
-                    src[red_pix], src[green_pix], src[blue_pix],
-                    err2);
-              if (err1 || err2) {
-                const int proportion2 = (255 * err2) / (err1 + err2);
-                if (dmval > proportion2) {
-                  pixval1 = pixval2; /* use color2 instead of color1*/
-                }
-              }
+            int spacer1, spaceg1, spaceb1; \
+            int spacer2, spaceg2, spaceb2; \
+            rgb_to_unshifted_lin(R1,G1,B1, &spacer1, &spaceg1, &spaceb1); \
+            rgb_to_unshifted_lin(R2,G2,B2, &spacer2, &spaceg2, &spaceb2); \
+            D = sqrt(R_SCALE * SQR((spacer1)-(spacer2)) + \
+                     G_SCALE * SQR((spaceg1)-(spaceg2)) + \
+                     B_SCALE * SQR((spaceb1)-(spaceb2))); \
+          } while(0)
+          /* although LIN_DISTP is more correct, DISTP is much faster and
+             barely distinguishable. */
+          DISTP(color1->red, color1->green, color1->blue,
+                src[red_pix], src[green_pix], src[blue_pix],
+                err1);
+          DISTP(color2->red, color2->green, color2->blue,
+                src[red_pix], src[green_pix], src[blue_pix],
+                err2);
+          if (err1 || err2) {
+            const int proportion2 = (255 * err2) / (err1 + err2);
+            if (dmval > proportion2) {
+              pixval1 = pixval2; /* use color2 instead of color1*/
+            }
+          }
 
-              /* Now emit the colormap index for this cell, barfbarf */
-              index_used_count[dest[INDEXED] = pixval1]++;
+          /* Now emit the colormap index for this cell, barfbarf */
+          index_used_count[dest[INDEXED] = pixval1]++;
 
-            next_pixel:
+        next_pixel:
 
-              src += srcPR.bytes;
-              dest += destPR.bytes;
-            }
+          src += srcPR->bytes;
+          dest += destPR->bytes;
         }
-
-      if (quantobj->progress && (count % 16 == 0))
-        gimp_progress_set_value (quantobj->progress,
-                                 (nth_layer + ((gdouble) total_size)/
-                                  layer_size) / (gdouble) n_layers);
     }
+
+  quantize_pass_unlock_slot (pass, slot);
+}
+
+static void
+median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
+                                   GimpLayer   *layer,
+                                   TileManager *new_tiles)
+{
+  QuantizePass pass;
+
+  quantize_pass_init (&pass, quantobj, quantobj->histogram, layer);
+  quantize_pass_run_pass2 (&pass,
+                           (PixelProcessorFunc)
+                           median_cut_pass2_fixed_dither_rgb_region,
+                           layer, new_tiles);
 }
 
 static void
@@ -27,6 +27,7 @@
 
 #include "core-types.h"
 
+#include "gimp-utils.h"
 #include "gimplist.h"
 
 
@@ -39,6 +40,7 @@ enum
 };
 
 
+static void         gimp_list_finalize           (GObject             *object);
 static void         gimp_list_set_property       (GObject             *object,
                                                   guint                property_id,
                                                   const GValue        *value,
@@ -73,6 +75,15 @@ static gint         gimp_list_get_child_index    (const GimpContainer *container
 
 static void         gimp_list_uniquefy_name      (GimpList            *gimp_list,
                                                   GimpObject          *object);
+static gboolean     gimp_list_name_taken         (GimpList            *list,
+                                                  GimpObject          *object,
+                                                  const gchar         *name);
+static void         gimp_list_name_add           (GimpList            *list,
+                                                  GimpObject          *object);
+static void         gimp_list_name_remove        (GimpList            *list,
+                                                  GimpObject          *object);
+static gboolean     gimp_list_index_ensure       (GimpList            *list);
+static void         gimp_list_index_invalidate   (GimpList            *list);
 static void         gimp_list_object_renamed     (GimpObject          *object,
                                                   GimpList            *list);
 
@@ -89,6 +100,7 @@ gimp_list_class_init (GimpListClass *klass)
   GimpObjectClass    *gimp_object_class = GIMP_OBJECT_CLASS (klass);
   GimpContainerClass *container_class   = GIMP_CONTAINER_CLASS (klass);
 
+  object_class->finalize              = gimp_list_finalize;
   object_class->set_property          = gimp_list_set_property;
   object_class->get_property          = gimp_list_get_property;
 
@@ -132,6 +144,37 @@ gimp_list_init (GimpList *list)
   list->unique_names = FALSE;
   list->sort_func    = NULL;
   list->append       = FALSE;
+
+  list->object_names  = g_hash_table_new_full (g_direct_hash,
+                                               g_direct_equal,
+                                               NULL,
+                                               (GDestroyNotify) g_free);
+  list->name_children = g_hash_table_new_full (g_str_hash,
+                                               g_str_equal,
+                                               (GDestroyNotify) g_free,
+                                               (GDestroyNotify) g_list_free);
+}
+
+static void
+gimp_list_finalize (GObject *object)
+{
+  GimpList *list = GIMP_LIST (object);
+
+  gimp_list_index_invalidate (list);
+
+  if (list->object_names)
+    {
+      g_hash_table_unref (list->object_names);
+      list->object_names = NULL;
+    }
+
+  if (list->name_children)
+    {
+      g_hash_table_unref (list->name_children);
+      list->name_children = NULL;
+    }
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void
@@ -196,6 +239,15 @@ gimp_list_get_memsize (GimpObject *object,
   memsize += (gimp_container_get_n_children (GIMP_CONTAINER (list)) *
               sizeof (GList));
 
+  memsize += gimp_g_hash_table_get_memsize (list->object_names, 0);
+  memsize += gimp_g_hash_table_get_memsize (list->name_children, 0);
+
+  if (list->index_children)
+    {
+      memsize += (list->index_children->len * sizeof (gpointer) +
+                  gimp_g_hash_table_get_memsize (list->index_positions, 0));
+    }
+
   if (gimp_container_get_policy (GIMP_CONTAINER (list)) ==
       GIMP_CONTAINER_POLICY_STRONG)
     {
@@ -218,10 +270,9 @@ gimp_list_add (GimpContainer *container,
   if (list->unique_names)
     gimp_list_uniquefy_name (list, object);
 
-  if (list->unique_names || list->sort_func)
-    g_signal_connect (object, "name-changed",
-                      G_CALLBACK (gimp_list_object_renamed),
-                      list);
+  g_signal_connect (object, "name-changed",
+                    G_CALLBACK (gimp_list_object_renamed),
+                    list);
 
   if (list->sort_func)
     list->list = g_list_insert_sorted (list->list, object, list->sort_func);
@@ -230,6 +281,9 @@ gimp_list_add (GimpContainer *container,
   else
     list->list = g_list_prepend (list->list, object);
 
+  gimp_list_name_add (list, object);
+  gimp_list_index_invalidate (list);
+
   GIMP_CONTAINER_CLASS (parent_class)->add (container, object);
 }
 
@@ -239,13 +293,15 @@ gimp_list_remove (GimpContainer *container,
 {
   GimpList *list = GIMP_LIST (container);
 
-  if (list->unique_names || list->sort_func)
-    g_signal_handlers_disconnect_by_func (object,
-                                          gimp_list_object_renamed,
-                                          list);
+  g_signal_handlers_disconnect_by_func (object,
+                                        gimp_list_object_renamed,
+                                        list);
 
   list->list = g_list_remove (list->list, object);
 
+  gimp_list_name_remove (list, object);
+  gimp_list_index_invalidate (list);
+
   GIMP_CONTAINER_CLASS (parent_class)->remove (container, object);
 }
 
@@ -263,6 +319,8 @@ gimp_list_reorder (GimpContainer *container,
     list->list = g_list_append (list->list, object);
   else
     list->list = g_list_insert (list->list, object, new_index);
+
+  gimp_list_index_invalidate (list);
 }
 
 static void
@@ -280,7 +338,8 @@ gimp_list_have (const GimpContainer *container,
 {
   GimpList *list = GIMP_LIST (container);
 
-  return g_list_find (list->list, object) ? TRUE : FALSE;
+  return g_hash_table_lookup_extended (list->object_names, object,
+                                       NULL, NULL);
 }
 
 static void
@@ -298,14 +357,22 @@ gimp_list_get_child_by_name (const GimpContainer *container,
                              const gchar         *name)
 {
   GimpList *list = GIMP_LIST (container);
+  GList    *children;
   GList    *glist;
 
+  children = g_hash_table_lookup (list->name_children, name);
+
+  if (! children)
+    return NULL;
+
+  if (! children->next)
+    return children->data;
+
+  /*  several children have this name, return the first one  */
   for (glist = list->list; glist; glist = g_list_next (glist))
     {
-      GimpObject *object = glist->data;
-
-      if (! strcmp (gimp_object_get_name (object), name))
-        return object;
+      if (g_list_find (children, glist->data))
+        return glist->data;
     }
 
   return NULL;
@@ -318,6 +385,14 @@ gimp_list_get_child_by_index (const GimpContainer *container,
   GimpList *list = GIMP_LIST (container);
   GList    *glist;
 
+  if (gimp_list_index_ensure (list))
+    {
+      if (index < (gint) list->index_children->len)
+        return g_ptr_array_index (list->index_children, index);
+
+      return NULL;
+    }
+
   glist = g_list_nth (list->list, index);
 
   if (glist)
@@ -332,6 +407,17 @@ gimp_list_get_child_index (const GimpContainer *container,
 {
   GimpList *list = GIMP_LIST (container);
 
+  if (gimp_list_index_ensure (list))
+    {
+      gpointer position;
+
+      if (g_hash_table_lookup_extended (list->index_positions, object,
+                                        NULL, &position))
+        return GPOINTER_TO_INT (position);
+
+      return -1;
+    }
+
   return g_list_index (list->list, (gpointer) object);
 }
 
@@ -418,6 +504,7 @@ gimp_list_reverse (GimpList *list)
     {
       gimp_container_freeze (GIMP_CONTAINER (list));
       list->list = g_list_reverse (list->list);
+      gimp_list_index_invalidate (list);
       gimp_container_thaw (GIMP_CONTAINER (list));
     }
 }
@@ -466,6 +553,7 @@ gimp_list_sort (GimpList     *list,
     {
       gimp_container_freeze (GIMP_CONTAINER (list));
       list->list = g_list_sort (list->list, sort_func);
+      gimp_list_index_invalidate (list);
       gimp_container_thaw (GIMP_CONTAINER (list));
     }
 }
@@ -492,23 +580,11 @@ gimp_list_uniquefy_name (GimpList   *gimp_list,
                          GimpObject *object)
 {
   gchar *name = (gchar *) gimp_object_get_name (object);
-  GList *list;
 
   if (! name)
     return;
 
-  for (list = gimp_list->list; list; list = g_list_next (list))
-    {
-      GimpObject  *object2 = list->data;
-      const gchar *name2   = gimp_object_get_name (object2);
-
-      if (object != object2 &&
-          name2             &&
-          ! strcmp (name, name2))
-        break;
-    }
-
-  if (list)
+  if (gimp_list_name_taken (gimp_list, object, name))
     {
       gchar *ext;
       gchar *new_name   = NULL;
@@ -547,30 +623,139 @@ gimp_list_uniquefy_name (GimpList   *gimp_list,
           g_free (new_name);
 
           new_name = g_strdup_printf ("%s #%d", name, unique_ext);
+        }
+      while (gimp_list_name_taken (gimp_list, object, new_name));
 
-          for (list = gimp_list->list; list; list = g_list_next (list))
-            {
-              GimpObject  *object2 = list->data;
-              const gchar *name2   = gimp_object_get_name (object2);
+      g_free (name);
+
+      gimp_object_take_name (object, new_name);
+    }
+}
+
+/*  Returns whether another child than @object is called @name  */
+static gboolean
+gimp_list_name_taken (GimpList    *list,
+                      GimpObject  *object,
+                      const gchar *name)
+{
+  GList *children = g_hash_table_lookup (list->name_children, name);
+
+  return children && (children->data != object || children->next);
+}
+
+static void
+gimp_list_name_add (GimpList   *list,
+                    GimpObject *object)
+{
+  const gchar *name = gimp_object_get_name (object);
 
-              if (object != object2 &&
-                  name2             &&
-                  ! strcmp (new_name, name2))
-                break;
+  /*  remember the name, it is freed before "name-changed" is emitted  */
+  g_hash_table_insert (list->object_names, object, g_strdup (name));
+
+  if (name)
+    {
+      GList *children = g_hash_table_lookup (list->name_children, name);
+
+      /*  appending keeps the head of the list stored in the table  */
+      if (children)
+        children = g_list_append (children, object);
+      else
+        g_hash_table_insert (list->name_children,
+                             g_strdup (name), g_list_prepend (NULL, object));
+    }
+}
+
+static void
+gimp_list_name_remove (GimpList   *list,
+                       GimpObject *object)
+{
+  gpointer name;
+
+  if (! g_hash_table_lookup_extended (list->object_names, object,
+                                      NULL, &name))
+    return;
+
+  if (name)
+    {
+      GList *children = g_hash_table_lookup (list->name_children, name);
+      GList *link     = g_list_find (children, object);
+
+      if (! children->next)
+        {
+          g_hash_table_remove (list->name_children, name);
+        }
+      else
+        {
+          /*  keep the head of the list stored in the table  */
+          if (link == children)
+            {
+              link = children->next;
+              children->data = link->data;
             }
+
+          children = g_list_delete_link (children, link);
         }
-      while (list);
+    }
 
-      g_free (name);
+  g_hash_table_remove (list->object_names, object);
+}
 
-      gimp_object_take_name (object, new_name);
+/*  Positions are looked up in an array which is built on the second
+ *  lookup after the list changed. This way, scripts walking a large
+ *  list by index don't get quadratic, while the single lookups views
+ *  do right after each added child keep using the list.
+ */
+static gboolean
+gimp_list_index_ensure (GimpList *list)
+{
+  GList *glist;
+  gint   i;
+
+  if (list->index_children)
+    return TRUE;
+
+  if (! list->index_wanted)
+    {
+      list->index_wanted = TRUE;
+
+      return FALSE;
     }
+
+  list->index_children =
+    g_ptr_array_sized_new (gimp_container_get_n_children (GIMP_CONTAINER (list)));
+  list->index_positions = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  for (glist = list->list, i = 0; glist; glist = g_list_next (glist), i++)
+    {
+      g_ptr_array_add (list->index_children, glist->data);
+      g_hash_table_insert (list->index_positions,
+                           glist->data, GINT_TO_POINTER (i));
+    }
+
+  return TRUE;
+}
+
+static void
+gimp_list_index_invalidate (GimpList *list)
+{
+  if (list->index_children)
+    {
+      g_ptr_array_free (list->index_children, TRUE);
+      list->index_children = NULL;
+
+      g_hash_table_unref (list->index_positions);
+      list->index_positions = NULL;
+    }
+
+  list->index_wanted = FALSE;
 }
 
 static void
 gimp_list_object_renamed (GimpObject *object,
                           GimpList   *list)
 {
+  gimp_list_name_remove (list, object);
+
   if (list->unique_names)
     {
       g_signal_handlers_block_by_func (object,
@@ -584,6 +769,8 @@ gimp_list_object_renamed (GimpObject *object,
                                          list);
     }
 
+  gimp_list_name_add (list, object);
+
   if (list->sort_func)
     {
       GList *glist;
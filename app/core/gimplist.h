@@ -43,6 +43,14 @@ struct _GimpList
   gboolean       unique_names;
   GCompareFunc   sort_func;
   gboolean       append;
+
+  /*  private  */
+  GHashTable    *object_names;  /* child -> its name when it was indexed  */
+  GHashTable    *name_children; /* name  -> GList of children             */
+
+  GPtrArray     *index_children;
+  GHashTable    *index_positions;
+  gboolean       index_wanted;
 };
 
 struct _GimpListClass
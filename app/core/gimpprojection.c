@@ -21,6 +21,7 @@
 
 #include "core-types.h"
 
+#include "base/pixel-processor.h"
 #include "base/tile.h"
 #include "base/tile-rowhints.h" /* EEK */
 #include "base/tile-private.h"  /* EEK */
@@ -40,6 +41,10 @@
 /*  halfway between G_PRIORITY_HIGH_IDLE and G_PRIORITY_DEFAULT_IDLE  */
 #define  GIMP_PROJECTION_IDLE_PRIORITY  150
 
+/*  the piece of the projection rendered per thread and idle iteration  */
+#define  CHUNK_WIDTH   256
+#define  CHUNK_HEIGHT  128
+
 
 enum
 {
@@ -91,6 +96,11 @@ static void        gimp_projection_invalidate            (GimpProjection  *proj,
                                                           guint            y,
                                                           guint            w,
                                                           guint            h);
+static void        gimp_projection_construct_area        (GimpProjection  *proj,
+                                                          gint             x,
+                                                          gint             y,
+                                                          gint             w,
+                                                          gint             h);
 static void        gimp_projection_validate_tile         (TileManager     *tm,
                                                           Tile            *tile,
                                                           GimpProjection  *proj);
@@ -640,11 +650,8 @@ gimp_projection_idle_render_callback (gpointer data)
   gint            workx, worky;
   gint            workw, workh;
 
-#define CHUNK_WIDTH  256
-#define CHUNK_HEIGHT 128
-
-  workw = CHUNK_WIDTH;
-  workh = CHUNK_HEIGHT;
+  workw = proj->idle_render.chunk_width;
+  workh = proj->idle_render.chunk_height;
   workx = proj->idle_render.x;
   worky = proj->idle_render.y;
 
@@ -661,13 +668,13 @@ gimp_projection_idle_render_callback (gpointer data)
   gimp_projection_paint_area (proj, TRUE /* sic! */,
                               workx, worky, workw, workh);
 
-  proj->idle_render.x += CHUNK_WIDTH;
+  proj->idle_render.x += proj->idle_render.chunk_width;
 
   if (proj->idle_render.x >=
       proj->idle_render.base_x + proj->idle_render.width)
     {
       proj->idle_render.x = proj->idle_render.base_x;
-      proj->idle_render.y += CHUNK_HEIGHT;
+      proj->idle_render.y += proj->idle_render.chunk_height;
 
       if (proj->idle_render.y >=
           proj->idle_render.base_y + proj->idle_render.height)
@@ -700,6 +707,8 @@ static gboolean
 gimp_projection_idle_render_next_area (GimpProjection *proj)
 {
   GimpArea *area;
+  gint      n_chunks;
+  gint      cols, rows;
 
   if (! proj->idle_render.update_areas)
     return FALSE;
@@ -716,6 +725,19 @@ gimp_projection_idle_render_next_area (GimpProjection *proj)
 
   gimp_area_free (area);
 
+  /*  render one chunk per thread in each idle iteration, they are
+   *  constructed together so the pixel processor can spread them
+   *  across its threads.  Narrow areas get taller pieces instead.
+   */
+  n_chunks = pixel_processor_get_num_threads ();
+
+  cols = (proj->idle_render.width + CHUNK_WIDTH - 1) / CHUNK_WIDTH;
+  cols = CLAMP (cols, 1, n_chunks);
+  rows = MAX (1, n_chunks / cols);
+
+  proj->idle_render.chunk_width  = cols * CHUNK_WIDTH;
+  proj->idle_render.chunk_height = rows * CHUNK_HEIGHT;
+
   return TRUE;
 }
 
@@ -742,6 +764,13 @@ gimp_projection_paint_area (GimpProjection *proj,
 
   gimp_projection_invalidate (proj, x1, y1, x2 - x1, y2 - y1);
 
+  /*  the display is going to draw the area right away, construct it
+   *  here in one go instead of letting the display validate it tile
+   *  row by tile row
+   */
+  if (now && proj->pyramid)
+    gimp_projection_construct_area (proj, x1, y1, x2 - x1, y2 - y1);
+
   /*  add the projectable's offsets because the list of update areas
    *  is in tile-pyramid coordinates, but our external API is always
    *  in terms of image coordinates.
@@ -765,6 +794,102 @@ gimp_projection_invalidate (GimpProjection *proj,
     tile_pyramid_invalidate_area (proj->pyramid, x, y, w, h);
 }
 
+static void
+gimp_projection_construct_area (GimpProjection *proj,
+                                gint            x,
+                                gint            y,
+                                gint            w,
+                                gint            h)
+{
+  TileManager *tm     = tile_pyramid_get_tiles (proj->pyramid, 0, NULL);
+  GSList      *locked = NULL;
+  GSList      *list;
+  gboolean    *invalid;
+  gint         col1, row1;
+  gint         n_cols, n_rows;
+  gint         col, row;
+
+  if (w <= 0 || h <= 0)
+    return;
+
+  col1   = x / TILE_WIDTH;
+  row1   = y / TILE_HEIGHT;
+  n_cols = (x + w - 1) / TILE_WIDTH  - col1 + 1;
+  n_rows = (y + h - 1) / TILE_HEIGHT - row1 + 1;
+
+  invalid = g_new0 (gboolean, n_cols * n_rows);
+
+  for (row = 0; row < n_rows; row++)
+    for (col = 0; col < n_cols; col++)
+      {
+        Tile *tile = tile_manager_get_at (tm, col1 + col, row1 + row,
+                                          FALSE, FALSE);
+
+        if (tile && ! tile_is_valid (tile))
+          {
+            /*  HACK: see gimp_projection_validate_tile()  */
+            tile->valid = TRUE;
+            tile = tile_manager_get_at (tm, col1 + col, row1 + row,
+                                        TRUE, TRUE);
+
+            locked = g_slist_prepend (locked, tile);
+
+            invalid[row * n_cols + col] = TRUE;
+          }
+      }
+
+  /*  construct the tiles that were invalid, they have been marked
+   *  valid, in rectangles that don't include any valid tiles
+   */
+  for (row = 0; row < n_rows; row++)
+    for (col = 0; col < n_cols; col++)
+      if (invalid[row * n_cols + col])
+        {
+          gint col2 = col;
+          gint row2;
+          gint c, r;
+          gint x1, y1;
+          gint x2, y2;
+
+          while (col2 + 1 < n_cols && invalid[row * n_cols + col2 + 1])
+            col2++;
+
+          for (row2 = row + 1; row2 < n_rows; row2++)
+            {
+              for (c = col; c <= col2; c++)
+                if (! invalid[row2 * n_cols + c])
+                  break;
+
+              if (c <= col2)
+                break;
+            }
+
+          for (r = row; r < row2; r++)
+            for (c = col; c <= col2; c++)
+              invalid[r * n_cols + c] = FALSE;
+
+          x1 = (col1 + col) * TILE_WIDTH;
+          y1 = (row1 + row) * TILE_HEIGHT;
+          x2 = MIN ((col1 + col2 + 1) * TILE_WIDTH, tile_manager_width (tm));
+          y2 = MIN ((row1 + row2) * TILE_HEIGHT,    tile_manager_height (tm));
+
+          gimp_projection_construct (proj, x1, y1, x2 - x1, y2 - y1);
+        }
+
+  g_free (invalid);
+
+  for (list = locked; list; list = g_slist_next (list))
+    {
+      Tile *tile = list->data;
+
+      /*  HACK: mark the tile as valid, because we know it is  */
+      tile->valid = TRUE;
+      tile_release (tile, TRUE);
+    }
+
+  g_slist_free (locked);
+}
+
 static void
 gimp_projection_validate_tile (TileManager    *tm,
                                Tile           *tile,
@@ -32,6 +32,8 @@ struct _GimpProjectionIdleRender
   gint    y;
   gint    base_x;
   gint    base_y;
+  gint    chunk_width;
+  gint    chunk_height;
   guint   idle_id;
   GSList *update_areas;   /*  flushed update areas */
 };
@@ -0,0 +1,392 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The healing equation is solved with a multigrid solver: red/black
+ * Gauss-Seidel smoothing removes the high frequencies of the error on
+ * each level, and the remaining residual is restricted to a grid of
+ * half the size, solved there in the same way and interpolated back
+ * as a correction.  A few such V-cycles converge on brushes of any
+ * size, where plain relaxation needs a number of sweeps that grows
+ * with the square of the brush size.
+ *
+ * Each channel is solved on its own, in float planes that have a one
+ * pixel border of zeros, so the inner loops need no bounds checks.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "libgimpmath/gimpmath.h"
+
+#include "paint-funcs-types.h"
+
+#include "base/pixel-region.h"
+
+#include "heal-region.h"
+
+
+#define HEAL_MIN_SIZE           4    /* don't coarsen levels below this */
+#define HEAL_PRE_SMOOTH         2
+#define HEAL_POST_SMOOTH        2
+#define HEAL_COARSE_ITERATIONS  32
+#define HEAL_MAX_CYCLES         20
+#define HEAL_EPSILON            0.01 /* in pixel values, on a 0..255 scale */
+
+
+typedef struct
+{
+  gint    width;
+  gint    height;
+  gint    stride;   /* width + 2 */
+  gfloat *unknown;  /* 1.0 where the solution is unknown, 0.0 if it's fixed */
+  gfloat *u;        /* the solution, or the correction on coarser levels */
+  gfloat *f;        /* the right hand side */
+  gfloat *r;        /* the residual */
+} HealLevel;
+
+
+static gint    heal_levels_new   (PixelRegion     *maskPR,
+                                  gint             width,
+                                  gint             height,
+                                  HealLevel      **levels);
+static void    heal_levels_free  (HealLevel       *levels,
+                                  gint             n_levels);
+
+static void    heal_smooth       (HealLevel       *level,
+                                  gint             n_iterations);
+static void    heal_residual     (HealLevel       *level);
+static void    heal_restrict     (const HealLevel *fine,
+                                  HealLevel       *coarse);
+static void    heal_prolong      (const HealLevel *coarse,
+                                  HealLevel       *fine);
+static void    heal_v_cycle      (HealLevel       *levels,
+                                  gint             n_levels);
+static void    heal_solve        (HealLevel       *levels,
+                                  gint             n_levels);
+
+
+/*  public functions  */
+
+void
+heal_region (PixelRegion *tempPR,
+             PixelRegion *srcPR,
+             PixelRegion *maskPR)
+{
+  HealLevel *levels;
+  gint       n_levels;
+  gint       width  = tempPR->w;
+  gint       height = tempPR->h;
+  gint       bytes  = tempPR->bytes;
+  gint       x, y, k;
+
+  g_return_if_fail (tempPR->bytes == srcPR->bytes);
+  g_return_if_fail (tempPR->data != NULL && srcPR->data != NULL);
+
+  n_levels = heal_levels_new (maskPR, width, height, &levels);
+
+  for (k = 0; k < bytes; k++)
+    {
+      HealLevel *level  = levels;
+      gint       stride = level->stride;
+
+      /*  start from the difference between the image and the pattern,
+       *  it is also the boundary condition
+       */
+      for (y = 0; y < height; y++)
+        {
+          const guchar *t = (tempPR->data +
+                             (tempPR->y + y) * tempPR->rowstride +
+                             tempPR->x * bytes + k);
+          const guchar *s = (srcPR->data +
+                             (srcPR->y + y) * srcPR->rowstride +
+                             srcPR->x * bytes + k);
+          gfloat       *u = level->u + (y + 1) * stride + 1;
+
+          for (x = 0; x < width; x++)
+            u[x] = (gfloat) t[x * bytes] - (gfloat) s[x * bytes];
+        }
+
+      heal_solve (levels, n_levels);
+
+      /*  add the solution to the pattern  */
+      for (y = 0; y < height; y++)
+        {
+          guchar       *t = (tempPR->data +
+                             (tempPR->y + y) * tempPR->rowstride +
+                             tempPR->x * bytes + k);
+          const guchar *s = (srcPR->data +
+                             (srcPR->y + y) * srcPR->rowstride +
+                             srcPR->x * bytes + k);
+          const gfloat *u = level->u + (y + 1) * stride + 1;
+
+          for (x = 0; x < width; x++)
+            t[x * bytes] = CLAMP0255 (ROUND (u[x] + (gfloat) s[x * bytes]));
+        }
+    }
+
+  heal_levels_free (levels, n_levels);
+}
+
+
+/*  private functions  */
+
+/*  Sets up the grid hierarchy.  On the finest level the pixels inside
+ *  the mask are unknown, except for the outermost ones of the region.
+ *  A coarser cell is only unknown if all of the finer cells it covers
+ *  are, letting a coarse cell reach past the boundary would make the
+ *  correction overshoot there.
+ */
+static gint
+heal_levels_new (PixelRegion  *maskPR,
+                 gint          width,
+                 gint          height,
+                 HealLevel   **levels)
+{
+  HealLevel *level;
+  gint       n_levels = 1;
+  gint       w, h;
+  gint       x, y, l;
+
+  for (w = width, h = height;
+       w > HEAL_MIN_SIZE && h > HEAL_MIN_SIZE;
+       w = (w + 1) / 2, h = (h + 1) / 2)
+    n_levels++;
+
+  *levels = g_new (HealLevel, n_levels);
+
+  for (l = 0, w = width, h = height;
+       l < n_levels;
+       l++, w = (w + 1) / 2, h = (h + 1) / 2)
+    {
+      gint size = (w + 2) * (h + 2);
+
+      level = *levels + l;
+
+      level->width   = w;
+      level->height  = h;
+      level->stride  = w + 2;
+      level->unknown = g_new0 (gfloat, size);
+      level->u       = g_new0 (gfloat, size);
+      level->f       = g_new0 (gfloat, size);
+      level->r       = g_new0 (gfloat, size);
+    }
+
+  level = *levels;
+
+  for (y = 1; y < height - 1; y++)
+    {
+      const guchar *m       = (maskPR->data +
+                               (maskPR->y + y) * maskPR->rowstride +
+                               maskPR->x);
+      gfloat       *unknown = level->unknown + (y + 1) * level->stride + 1;
+
+      for (x = 1; x < width - 1; x++)
+        unknown[x] = m[x] ? 1.0 : 0.0;
+    }
+
+  for (l = 1; l < n_levels; l++)
+    {
+      const HealLevel *fine   = *levels + l - 1;
+      HealLevel       *coarse = *levels + l;
+
+      for (y = 1; y <= coarse->height; y++)
+        {
+          const gfloat *f0      = fine->unknown + (2 * y - 1) * fine->stride;
+          const gfloat *f1      = f0 + fine->stride;
+          gfloat       *unknown = coarse->unknown + y * coarse->stride;
+
+          for (x = 1; x <= coarse->width; x++)
+            unknown[x] = MIN (MIN (f0[2 * x - 1], f0[2 * x]),
+                           MIN (f1[2 * x - 1], f1[2 * x]));
+        }
+    }
+
+  return n_levels;
+}
+
+static void
+heal_levels_free (HealLevel *levels,
+                  gint       n_levels)
+{
+  gint l;
+
+  for (l = 0; l < n_levels; l++)
+    {
+      g_free (levels[l].unknown);
+      g_free (levels[l].u);
+      g_free (levels[l].f);
+      g_free (levels[l].r);
+    }
+
+  g_free (levels);
+}
+
+/*  Red/black Gauss-Seidel, the fixed cells are left alone by
+ *  multiplying their update with zero instead of branching.
+ */
+static void
+heal_smooth (HealLevel *level,
+             gint       n_iterations)
+{
+  const gint stride = level->stride;
+  gint       i, color, x, y;
+
+  for (i = 0; i < n_iterations; i++)
+    for (color = 0; color < 2; color++)
+      for (y = 1; y <= level->height; y++)
+        {
+          gfloat       *u       = level->u       + y * stride;
+          const gfloat *f       = level->f       + y * stride;
+          const gfloat *unknown = level->unknown + y * stride;
+
+          for (x = 1 + ((y + color) & 1); x <= level->width; x += 2)
+            {
+              gfloat value = 0.25f * (f[x] +
+                                      u[x - 1] + u[x + 1] +
+                                      u[x - stride] + u[x + stride]);
+
+              u[x] += unknown[x] * (value - u[x]);
+            }
+        }
+}
+
+static void
+heal_residual (HealLevel *level)
+{
+  const gint stride = level->stride;
+  gint       x, y;
+
+  for (y = 1; y <= level->height; y++)
+    {
+      const gfloat *u       = level->u       + y * stride;
+      const gfloat *f       = level->f       + y * stride;
+      const gfloat *unknown = level->unknown + y * stride;
+      gfloat       *r       = level->r       + y * stride;
+
+      for (x = 1; x <= level->width; x++)
+        r[x] = unknown[x] * (f[x] - 4.0f * u[x] +
+                             u[x - 1] + u[x + 1] +
+                             u[x - stride] + u[x + stride]);
+    }
+}
+
+/*  The coarse grid has twice the spacing, which scales the Laplacian
+ *  by four, so the residuals of the four finer cells are summed up
+ *  rather than averaged.
+ */
+static void
+heal_restrict (const HealLevel *fine,
+               HealLevel       *coarse)
+{
+  gint x, y;
+
+  for (y = 1; y <= coarse->height; y++)
+    {
+      const gfloat *r0 = fine->r + (2 * y - 1) * fine->stride;
+      const gfloat *r1 = r0 + fine->stride;
+      gfloat       *f  = coarse->f + y * coarse->stride;
+      gfloat       *u  = coarse->u + y * coarse->stride;
+
+      for (x = 1; x <= coarse->width; x++)
+        {
+          f[x] = (r0[2 * x - 1] + r0[2 * x] +
+                  r1[2 * x - 1] + r1[2 * x]);
+          u[x] = 0.0f;
+        }
+    }
+}
+
+/*  Adds the bilinearly interpolated coarse correction to the unknown
+ *  cells of the finer level.
+ */
+static void
+heal_prolong (const HealLevel *coarse,
+              HealLevel       *fine)
+{
+  const gint stride = coarse->stride;
+  gint       x, y;
+
+  for (y = 1; y <= fine->height; y++)
+    {
+      const gfloat *c0      = coarse->u + ((y + 1) / 2) * stride;
+      const gfloat *c1      = c0 + ((y & 1) ? -stride : stride);
+      gfloat       *u       = fine->u       + y * fine->stride;
+      const gfloat *unknown = fine->unknown + y * fine->stride;
+
+      for (x = 1; x <= fine->width; x++)
+        {
+          gint   x0 = (x + 1) / 2;
+          gint   x1 = x0 + ((x & 1) ? -1 : 1);
+          gfloat e  = (0.5625f * c0[x0] + 0.1875f * (c0[x1] + c1[x0]) +
+                       0.0625f * c1[x1]);
+
+          u[x] += unknown[x] * e;
+        }
+    }
+}
+
+static void
+heal_v_cycle (HealLevel *levels,
+              gint       n_levels)
+{
+  if (n_levels == 1)
+    {
+      heal_smooth (levels, HEAL_COARSE_ITERATIONS);
+      return;
+    }
+
+  heal_smooth (levels, HEAL_PRE_SMOOTH);
+  heal_residual (levels);
+
+  heal_restrict (levels, levels + 1);
+  heal_v_cycle (levels + 1, n_levels - 1);
+  heal_prolong (levels + 1, levels);
+
+  heal_smooth (levels, HEAL_POST_SMOOTH);
+}
+
+/*  Runs V-cycles until the solution on the finest level settles.  */
+static void
+heal_solve (HealLevel *levels,
+            gint       n_levels)
+{
+  HealLevel *level = levels;
+  gint       size  = level->stride * (level->height + 2);
+  gfloat    *prev  = g_new (gfloat, size);
+  gint       cycle;
+
+  for (cycle = 0; cycle < HEAL_MAX_CYCLES; cycle++)
+    {
+      gfloat change = 0.0f;
+      gint   i;
+
+      memcpy (prev, level->u, size * sizeof (gfloat));
+
+      heal_v_cycle (levels, n_levels);
+
+      for (i = 0; i < size; i++)
+        change = MAX (change, fabsf (level->u[i] - prev[i]));
+
+      if (change < HEAL_EPSILON)
+        break;
+    }
+
+  g_free (prev);
+}
@@ -0,0 +1,34 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HEAL_REGION_H__
+#define __HEAL_REGION_H__
+
+
+/* heal_region() corrects the pixels of tempPR under maskPR so that
+ * they blend with their surroundings: the difference between tempPR
+ * and srcPR is kept on the border of the mask and interpolated
+ * smoothly (by solving the Laplace equation) inside of it, and then
+ * added back to srcPR.  All regions must be backed by plain data, not
+ * by tiles.
+ */
+void  heal_region (PixelRegion *tempPR,
+                   PixelRegion *srcPR,
+                   PixelRegion *maskPR);
+
+
+#endif  /*  __HEAL_REGION_H__  */
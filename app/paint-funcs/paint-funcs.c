@@ -2366,10 +2366,313 @@ separate_alpha_region (PixelRegion *srcR)
     }
 }
 
+/*  The recursive gaussian filter of Young and van Vliet, "Recursive
+ *  implementation of the Gaussian filter", Signal Processing 44 (1995),
+ *  with the pole placement of van Vliet, Young and Verbeek, "Recursive
+ *  Gaussian derivative filters", ICPR 1998, which gets sigma right.
+ *  A causal and an anti-causal third order filter are run over the
+ *  data, so the cost per pixel doesn't depend on the radius.  The
+ *  poles get close to 1 for large radii, so the state of the filters
+ *  is kept in doubles, only the values in between are stored as floats.
+ */
+
+/*  below this radius the direct convolution is about as fast  */
+#define GAUSSIAN_IIR_MIN_RADIUS  4.0
+
+/*  the number of columns the vertical pass filters together  */
+#define GAUSSIAN_IIR_STRIP       TILE_WIDTH
+
+#ifdef ENABLE_MP
+#define GAUSSIAN_IIR_LOCK(pass)   g_mutex_lock ((pass)->mutex)
+#define GAUSSIAN_IIR_UNLOCK(pass) g_mutex_unlock ((pass)->mutex)
+#else
+#define GAUSSIAN_IIR_LOCK(pass)
+#define GAUSSIAN_IIR_UNLOCK(pass)
+#endif
+
+typedef struct
+{
+  gdouble B;
+  gdouble b1, b2, b3;
+} GaussianIIR;
+
+typedef struct
+{
+  GaussianIIR  iir;
+  PixelRegion *srcR;
+  gboolean     vertical;
+#ifdef ENABLE_MP
+  GMutex      *mutex;    /*  the threads take turns accessing the tiles  */
+#endif
+} GaussianIIRPass;
+
+
+static void
+gaussian_iir_init (GaussianIIR *iir,
+                   gdouble      radius)
+{
+  /*  the same sigma as the curve of the direct convolution  */
+  const gdouble sigma = sqrt (- SQR (radius) / (2 * LOG_1_255));
+  const gdouble m0    = 1.16680;
+  const gdouble m1    = 1.10783;
+  const gdouble m2    = 1.40586;
+  const gdouble q     = 1.31564 * (sqrt (1.0 + 0.490811 * SQR (sigma)) - 1.0);
+  const gdouble scale = (m0 + q) * (SQR (m1) + SQR (m2) + 2 * m1 * q + SQR (q));
+
+  iir->b1 = (q * (2 * m0 * m1 + SQR (m1) + SQR (m2) +
+                  (2 * m0 + 4 * m1) * q + 3 * SQR (q)) / scale);
+  iir->b2 = - SQR (q) * (m0 + 2 * m1 + 3 * q) / scale;
+  iir->b3 = q * q * q / scale;
+  iir->B  = 1.0 - (iir->b1 + iir->b2 + iir->b3);
+}
+
+/*  Filters count (at most GAUSSIAN_IIR_STRIP) interleaved signals of
+ *  the given length in place.  The filters start out as if the signals
+ *  continued with their first and last values, like the direct
+ *  convolution does.  The inner loops run across the signals.
+ */
+static void
+gaussian_iir_filter (const GaussianIIR *iir,
+                     gfloat            *buf,
+                     gint               length,
+                     gint               count)
+{
+  const gdouble B  = iir->B;
+  const gdouble b1 = iir->b1;
+  const gdouble b2 = iir->b2;
+  const gdouble b3 = iir->b3;
+  gdouble       y1[GAUSSIAN_IIR_STRIP];
+  gdouble       y2[GAUSSIAN_IIR_STRIP];
+  gdouble       y3[GAUSSIAN_IIR_STRIP];
+  gint          i, k;
+
+  for (k = 0; k < count; k++)
+    y1[k] = y2[k] = y3[k] = buf[k];
+
+  for (i = 0; i < length; i++)
+    {
+      gfloat *p = buf + i * count;
+
+      for (k = 0; k < count; k++)
+        {
+          const gdouble y = B * p[k] + b1 * y1[k] + b2 * y2[k] + b3 * y3[k];
+
+          y3[k] = y2[k];
+          y2[k] = y1[k];
+          y1[k] = y;
+          p[k]  = y;
+        }
+    }
+
+  for (k = 0; k < count; k++)
+    y1[k] = y2[k] = y3[k] = buf[(length - 1) * count + k];
+
+  for (i = length - 1; i >= 0; i--)
+    {
+      gfloat *p = buf + i * count;
+
+      for (k = 0; k < count; k++)
+        {
+          const gdouble y = B * p[k] + b1 * y1[k] + b2 * y2[k] + b3 * y3[k];
+
+          y3[k] = y2[k];
+          y2[k] = y1[k];
+          y1[k] = y;
+          p[k]  = y;
+        }
+    }
+}
+
+static inline guchar
+gaussian_iir_value (gfloat value)
+{
+  gint v = RINT (value);
+
+  return CLAMP (v, 0, 255);
+}
+
+/*  Filters the strips of GAUSSIAN_IIR_STRIP columns, or the rows, from
+ *  first to last.  Only one strip or row is held in a float buffer at
+ *  a time.
+ */
+static void
+gaussian_iir_range (GaussianIIRPass *pass,
+                    gint             first,
+                    gint             last)
+{
+  PixelRegion *srcR  = pass->srcR;
+  const gint   bytes = srcR->bytes;
+  const gint   alpha = bytes - 1;
+  gfloat      *buf;
+  guchar      *row;
+  gint         i, k;
+
+  if (pass->vertical)
+    {
+      const gint height = srcR->h;
+
+      buf = g_new (gfloat, height * GAUSSIAN_IIR_STRIP);
+      row = g_new (guchar, GAUSSIAN_IIR_STRIP * bytes);
+
+      for (i = first; i < last; i++)
+        {
+          const gint x     = srcR->x + i * GAUSSIAN_IIR_STRIP;
+          const gint count = MIN (GAUSSIAN_IIR_STRIP, srcR->x + srcR->w - x);
+          gint       y;
+
+          GAUSSIAN_IIR_LOCK (pass);
+
+          for (y = 0; y < height; y++)
+            {
+              gfloat *p = buf + y * count;
+
+              pixel_region_get_row (srcR, x, srcR->y + y, count, row, 1);
+
+              for (k = 0; k < count; k++)
+                p[k] = row[k * bytes + alpha];
+            }
+
+          GAUSSIAN_IIR_UNLOCK (pass);
+
+          gaussian_iir_filter (&pass->iir, buf, height, count);
+
+          GAUSSIAN_IIR_LOCK (pass);
+
+          for (y = 0; y < height; y++)
+            {
+              const gfloat *p = buf + y * count;
+
+              if (bytes > 1)
+                pixel_region_get_row (srcR, x, srcR->y + y, count, row, 1);
+
+              for (k = 0; k < count; k++)
+                row[k * bytes + alpha] = gaussian_iir_value (p[k]);
+
+              pixel_region_set_row (srcR, x, srcR->y + y, count, row);
+            }
+
+          GAUSSIAN_IIR_UNLOCK (pass);
+        }
+    }
+  else
+    {
+      const gint width = srcR->w;
+
+      buf = g_new (gfloat, width);
+      row = g_new (guchar, width * bytes);
+
+      for (i = first; i < last; i++)
+        {
+          const gint y = srcR->y + i;
+
+          GAUSSIAN_IIR_LOCK (pass);
+          pixel_region_get_row (srcR, srcR->x, y, width, row, 1);
+          GAUSSIAN_IIR_UNLOCK (pass);
+
+          for (k = 0; k < width; k++)
+            buf[k] = row[k * bytes + alpha];
+
+          gaussian_iir_filter (&pass->iir, buf, width, 1);
+
+          for (k = 0; k < width; k++)
+            row[k * bytes + alpha] = gaussian_iir_value (buf[k]);
+
+          GAUSSIAN_IIR_LOCK (pass);
+          pixel_region_set_row (srcR, srcR->x, y, width, row);
+          GAUSSIAN_IIR_UNLOCK (pass);
+        }
+    }
+
+  g_free (row);
+  g_free (buf);
+}
+
+/*  Runs one pass of the filter over the columns or rows of srcR, on
+ *  the threads of the pixel processor.
+ */
+static void
+gaussian_iir_pass (PixelRegion *srcR,
+                   gdouble      radius,
+                   gboolean     vertical)
+{
+  GaussianIIRPass pass;
+
+  gaussian_iir_init (&pass.iir, radius);
+
+  pass.srcR     = srcR;
+  pass.vertical = vertical;
+
+#ifdef ENABLE_MP
+  pass.mutex    = g_mutex_new ();
+#endif
+
+  if (vertical)
+    pixel_processor_run_ranges ((PixelProcessorRangeFunc) gaussian_iir_range,
+                                &pass,
+                                (srcR->w + GAUSSIAN_IIR_STRIP - 1) /
+                                GAUSSIAN_IIR_STRIP,
+                                1);
+  else
+    pixel_processor_run_ranges ((PixelProcessorRangeFunc) gaussian_iir_range,
+                                &pass, srcR->h, TILE_HEIGHT);
+
+#ifdef ENABLE_MP
+  g_mutex_free (pass.mutex);
+#endif
+}
+
+/*  Blurs the last channel of srcR along the axes whose radius is at
+ *  least GAUSSIAN_IIR_MIN_RADIUS, vertically first.
+ */
+static void
+gaussian_blur_region_iir (PixelRegion *srcR,
+                          gdouble      radius_x,
+                          gdouble      radius_y)
+{
+  if (srcR->w < 1 || srcR->h < 1)
+    return;
+
+  if (radius_y >= GAUSSIAN_IIR_MIN_RADIUS)
+    gaussian_iir_pass (srcR, radius_y, TRUE);
+
+  if (radius_x >= GAUSSIAN_IIR_MIN_RADIUS)
+    gaussian_iir_pass (srcR, radius_x, FALSE);
+}
+
+/*  Blurs the last channel of srcR.  Large radii, which feathering big
+ *  selections uses, are done with the recursive filter, small ones
+ *  with the direct convolution of gaussian_blur_region_reference().
+ */
 void
 gaussian_blur_region (PixelRegion *srcR,
                       gdouble      radius_x,
                       gdouble      radius_y)
+{
+  const gboolean iir_x = radius_x >= GAUSSIAN_IIR_MIN_RADIUS;
+  const gboolean iir_y = radius_y >= GAUSSIAN_IIR_MIN_RADIUS;
+
+  if (! iir_x && ! iir_y)
+    {
+      gaussian_blur_region_reference (srcR, radius_x, radius_y);
+      return;
+    }
+
+  if (! iir_y && radius_y != 0.0)
+    gaussian_blur_region_reference (srcR, 0.0, radius_y);
+
+  gaussian_blur_region_iir (srcR, radius_x, radius_y);
+
+  if (! iir_x && radius_x != 0.0)
+    gaussian_blur_region_reference (srcR, radius_x, 0.0);
+}
+
+/*  Blurs the last channel of srcR by convolving it with a gaussian
+ *  curve, at a cost that grows with the radius.
+ */
+void
+gaussian_blur_region_reference (PixelRegion *srcR,
+                                gdouble      radius_x,
+                                gdouble      radius_y)
 {
   glong   width, height;
   guint   bytes;
@@ -2553,181 +2856,727 @@ rotate_pointers (guchar  **p,
 }
 
 
-gfloat
-shapeburst_region (PixelRegion      *srcPR,
-                   PixelRegion      *distPR,
-                   GimpProgressFunc  progress_callback,
-                   gpointer          progress_data)
+/*  Exact euclidean distance transforms, after Felzenszwalb and
+ *  Huttenlocher, "Distance Transforms of Sampled Functions" (2004).
+ *  A pass over the columns finds the nearest site of every pixel in
+ *  its column, a pass over the rows then takes the lower envelope of
+ *  the parabolas centered on these.  Both passes are linear in the
+ *  number of pixels whatever the distances are, and split the columns
+ *  and rows over all threads.
+ *
+ *  Distances are weighted, sx * dx² + sy * dy², which turns the
+ *  ellipses of the mask operations into unit circles.  Operations
+ *  that only look at distances up to some number of rows (the reach)
+ *  run the transform on bands of rows, each of which reads that many
+ *  rows above and below it.  The others sweep the columns up and then
+ *  down the bands, so no operation holds more than a band in memory.
+ */
+
+/*  the squared distance of pixels without a site in reach  */
+#define DISTANCE_FAR      1e20
+
+typedef struct _DistanceTransform DistanceTransform;
+
+typedef void (* DistanceRowFunc)   (DistanceTransform *dt,
+                                    gint               y,
+                                    const gdouble     *dist,
+                                    const gint        *site_x);
+typedef void (* DistanceBandFunc)  (DistanceTransform *dt,
+                                    PixelRegion       *region,
+                                    gint               y0,
+                                    gint               y1);
+
+struct _DistanceTransform
 {
-  Tile   *tile;
-  guchar *tile_data;
-  gfloat  max_iterations = 0.0;
-  gfloat *distp_cur;
-  gfloat *distp_prev;
-  gfloat *memory;
-  gfloat *tmp;
-  gfloat  min_prev;
-  gfloat  float_tmp;
-  gint    min;
-  gint    min_left;
-  gint    length;
-  gint    i, j, k;
-  gint    fraction;
-  gint    prev_frac;
-  gint    x, y;
-  gint    end;
-  gint    boundary;
-  gint    inc;
-  gint    src          = 0;
-  gint    max_progress = srcPR->w * srcPR->h;
-  gint    progress     = 0;
-
-  length = distPR->w + 1;
-  memory = g_new (gfloat, length * 2);
-
-  distp_prev = memory;
-  for (i = 0; i < length; i++)
-    distp_prev[i] = 0.0;
+  gint             width;
+  gint             height;
+  gdouble          sx;
+  gdouble          sy;
+  gboolean         edge_sites;  /* everything outside the region is a site */
+  gint             reach;       /* rows to look for sites in, 0 for all     */
+  gboolean         columns_only;/* row_func only needs site_dy              */
+  gint             dest_bytes;  /* per pixel of dest                        */
+
+  /*  the current band: sites and src hold rows s0 to s1, site_dy and
+   *  dest the rows y0 to y1 that are computed
+   */
+  gint             s0, s1;
+  gint             y0, y1;
+  guchar          *sites;
+  guchar          *src;
+  gint            *site_dy;     /* row offset of the nearest site in the column */
+  guchar          *dest;
+
+  /*  without a reach, the nearest site so far of every column  */
+  gint            *column_site;
+  gboolean         sweep_up;
+
+  DistanceRowFunc  row_func;    /* turns distances into dest, called from threads */
+
+  /*  used by the row functions  */
+  gint             value;       /* of the sites */
+  gint             other;       /* of the pixels that aren't sites */
+  gint             outside;     /* the value outside the region, -1 for edge pixels */
+  gint            *grow_width;  /* of the element, by row offset */
+  gboolean         feather;
+  gfloat          *row_max;
+  gfloat           max;
+
+  GimpProgressFunc progress_callback;
+  gpointer         progress_data;
+};
 
-  distp_prev += 1;
-  distp_cur = distp_prev + length;
 
-  for (i = 0; i < srcPR->h; i++)
+static void
+distance_transform_columns (DistanceTransform *dt,
+                            gint               first,
+                            gint               last)
+{
+  const gint width = dt->width;
+  gint       x, y;
+
+  for (x = first; x < last; x++)
     {
-      /*  set the current dist row to 0's  */
-      memset (distp_cur - 1, 0, sizeof (gfloat) * (length - 1));
+      const guchar *sites   = dt->sites   + x;
+      gint         *site_dy = dt->site_dy + x;
+      gint          above   = G_MININT / 4;
+      gint          below   = G_MAXINT / 4;
+
+      if (dt->edge_sites && dt->s0 == 0)
+        above = -1;
 
-      for (j = 0; j < srcPR->w; j++)
+      for (y = dt->s0; y < dt->y1; y++)
         {
-          min_prev = MIN (distp_cur[j-1], distp_prev[j]);
-          min_left = MIN ((srcPR->w - j - 1), (srcPR->h - i - 1));
-          min = (gint) MIN (min_left, min_prev);
-          fraction = 255;
+          if (sites[(y - dt->s0) * width])
+            above = y;
 
-          /*  This might need to be changed to 0
-              instead of k = (min) ? (min - 1) : 0  */
+          if (y >= dt->y0)
+            site_dy[(y - dt->y0) * width] = above - y;
+        }
 
-          for (k = (min) ? (min - 1) : 0; k <= min; k++)
+      if (dt->edge_sites && dt->s1 == dt->height)
+        below = dt->height;
+
+      for (y = dt->s1 - 1; y >= dt->y0; y--)
+        {
+          if (sites[(y - dt->s0) * width])
+            below = y;
+
+          if (y < dt->y1 && below - y < - site_dy[(y - dt->y0) * width])
+            site_dy[(y - dt->y0) * width] = below - y;
+        }
+    }
+}
+
+/*  Without a reach the columns are swept band by band, see
+ *  distance_transform_region().  Going up the bands site_dy gets the
+ *  offset of the nearest site below, going down the nearer one of
+ *  that and the nearest site above.
+ */
+static void
+distance_transform_columns_sweep (DistanceTransform *dt,
+                                  gint               first,
+                                  gint               last)
+{
+  const gint width = dt->width;
+  gint       x, y;
+
+  for (x = first; x < last; x++)
+    {
+      const guchar *sites   = dt->sites   + x;
+      gint         *site_dy = dt->site_dy + x;
+      gint          site    = dt->column_site[x];
+
+      if (dt->sweep_up)
+        {
+          for (y = dt->y1 - 1; y >= dt->y0; y--)
             {
-              x = j;
-              y = i + k;
-              end = y - k;
+              if (sites[(y - dt->s0) * width])
+                site = y;
+
+              site_dy[(y - dt->y0) * width] = site - y;
+            }
+        }
+      else
+        {
+          for (y = dt->y0; y < dt->y1; y++)
+            {
+              gint *dy = &site_dy[(y - dt->y0) * width];
+
+              if (sites[(y - dt->s0) * width])
+                site = y;
 
-              while (y >= end)
+              if (y - site <= *dy)
+                *dy = site - y;
+            }
+        }
+
+      dt->column_site[x] = site;
+    }
+}
+
+static void
+distance_transform_rows (DistanceTransform *dt,
+                         gint               first,
+                         gint               last)
+{
+  const gint     width  = dt->width;
+  const gint     limit  = dt->reach > 0 ? dt->reach : G_MAXINT / 8;
+  const gdouble  sx     = dt->sx;
+  gdouble       *f      = g_new (gdouble, width);
+  gdouble       *z      = g_new (gdouble, width + 1);
+  gint          *v      = g_new (gint, width);
+  gdouble       *dist   = g_new (gdouble, width);
+  gint          *site_x = g_new (gint, width);
+  gint           y;
+
+  for (y = dt->y0 + first; y < dt->y0 + last; y++)
+    {
+      const gint *site_dy = dt->site_dy + (y - dt->y0) * width;
+      gint        k       = 0;
+      gint        q;
+
+      if (dt->columns_only)
+        {
+          dt->row_func (dt, y, NULL, NULL);
+          continue;
+        }
+
+      for (q = 0; q < width; q++)
+        f[q] = (ABS (site_dy[q]) > limit ?
+                DISTANCE_FAR : dt->sy * SQR ((gdouble) site_dy[q]));
+
+      /*  the lower envelope of the parabolas sx * (x - q)² + f[q]  */
+      v[0] = 0;
+      z[0] = - G_MAXDOUBLE;
+      z[1] = G_MAXDOUBLE;
+
+      for (q = 1; q < width; q++)
+        {
+          gdouble s;
+
+          while (TRUE)
+            {
+              const gint p = v[k];
+
+              s = (((f[q] + sx * q * q) - (f[p] + sx * p * p)) /
+                   (2.0 * sx * (q - p)));
+
+              if (s > z[k])
+                break;
+
+              k--;
+            }
+
+          k++;
+          v[k]     = q;
+          z[k]     = s;
+          z[k + 1] = G_MAXDOUBLE;
+        }
+
+      for (q = 0, k = 0; q < width; q++)
+        {
+          while (z[k + 1] < q)
+            k++;
+
+          dist[q]   = sx * SQR ((gdouble) (q - v[k])) + f[v[k]];
+          site_x[q] = v[k];
+
+          if (dt->edge_sites)
+            {
+              const gdouble left  = sx * SQR ((gdouble) (q + 1));
+              const gdouble right = sx * SQR ((gdouble) (width - q));
+
+              if (left < dist[q])
                 {
-                  gint width;
+                  dist[q]   = left;
+                  site_x[q] = -1;
+                }
+
+              if (right < dist[q])
+                {
+                  dist[q]   = right;
+                  site_x[q] = width;
+                }
+            }
+        }
+
+      dt->row_func (dt, y, dist, site_x);
+    }
+
+  g_free (f);
+  g_free (z);
+  g_free (v);
+  g_free (dist);
+  g_free (site_x);
+}
+
+/*  The first sweep of a transform without a reach goes up the bands
+ *  and keeps the offsets of the nearest sites below in destPR, which
+ *  has to be another region with 4 bytes per pixel, until the second
+ *  sweep down the bands reads them back.
+ */
+static void
+distance_transform_sweep_up (DistanceTransform *dt,
+                             PixelRegion       *srcPR,
+                             PixelRegion       *destPR,
+                             DistanceBandFunc   load,
+                             gint               band_height)
+{
+  gint x, y, y1;
+
+  for (x = 0; x < dt->width; x++)
+    dt->column_site[x] = dt->edge_sites ? dt->height : G_MAXINT / 4;
+
+  dt->sweep_up = TRUE;
+
+  for (y1 = dt->height; y1 > 0; y1 -= band_height)
+    {
+      dt->y1 = dt->s1 = y1;
+      dt->y0 = dt->s0 = MAX (0, y1 - band_height);
+
+      load (dt, srcPR, dt->s0, dt->s1);
+
+      pixel_processor_run_ranges ((PixelProcessorRangeFunc)
+                                  distance_transform_columns_sweep,
+                                  dt, dt->width, TILE_WIDTH);
+
+      for (y = dt->y0; y < dt->y1; y++)
+        pixel_region_set_row (destPR, destPR->x, destPR->y + y, destPR->w,
+                              (guchar *) (dt->site_dy +
+                                          (y - dt->y0) * dt->width));
+    }
+
+  dt->sweep_up = FALSE;
+
+  for (x = 0; x < dt->width; x++)
+    dt->column_site[x] = dt->edge_sites ? -1 : G_MININT / 4;
+}
+
+/*  Runs the transform band by band.  load() fills in sites (and src)
+ *  for the rows s0 to s1 of a band from srcPR, store() writes the dest
+ *  rows of a band to destPR.  Both run on the main thread.  A band is
+ *  only stored after the next one is loaded, so srcPR and destPR may
+ *  be the same region; this needs bands of at least reach rows.
+ *  Without a reach, the columns are swept up and down the bands.
+ */
+static void
+distance_transform_region (DistanceTransform *dt,
+                           PixelRegion       *srcPR,
+                           PixelRegion       *destPR,
+                           DistanceBandFunc   load,
+                           DistanceBandFunc   store)
+{
+  const gint reach       = dt->reach;
+  const gint band_height = MIN (dt->height, MAX (4 * TILE_HEIGHT, reach));
+  gint       y0, y;
+
+  dt->sites   = g_new (guchar, (gsize) dt->width * (band_height + 2 * reach));
+  dt->src     = g_new (guchar, (gsize) dt->width * (band_height + 2 * reach));
+  dt->site_dy = g_new (gint, (gsize) dt->width * band_height);
+  dt->dest    = g_malloc ((gsize) dt->width * band_height * dt->dest_bytes);
+  dt->row_max = g_new0 (gfloat, band_height);
+
+  if (reach == 0)
+    {
+      dt->column_site = g_new (gint, dt->width);
+
+      distance_transform_sweep_up (dt, srcPR, destPR, load, band_height);
+    }
+
+  for (y0 = 0; y0 < dt->height; y0 += band_height)
+    {
+      const gint prev_y0 = dt->y0;
+      const gint prev_y1 = dt->y1;
+
+      dt->y0 = y0;
+      dt->y1 = MIN (dt->height, y0 + band_height);
+      dt->s0 = reach > 0 ? MAX (0, dt->y0 - reach) : dt->y0;
+      dt->s1 = reach > 0 ? MIN (dt->height, dt->y1 + reach) : dt->y1;
+
+      load (dt, srcPR, dt->s0, dt->s1);
+
+      if (y0 > 0)
+        store (dt, destPR, prev_y0, prev_y1);
+
+      if (reach == 0)
+        {
+          for (y = dt->y0; y < dt->y1; y++)
+            pixel_region_get_row (destPR, destPR->x, destPR->y + y, destPR->w,
+                                  (guchar *) (dt->site_dy +
+                                              (y - dt->y0) * dt->width), 1);
+
+          pixel_processor_run_ranges ((PixelProcessorRangeFunc)
+                                      distance_transform_columns_sweep,
+                                      dt, dt->width, TILE_WIDTH);
+        }
+      else
+        {
+          pixel_processor_run_ranges ((PixelProcessorRangeFunc)
+                                      distance_transform_columns,
+                                      dt, dt->width, TILE_WIDTH);
+        }
+
+      pixel_processor_run_ranges ((PixelProcessorRangeFunc)
+                                  distance_transform_rows,
+                                  dt, dt->y1 - dt->y0, TILE_HEIGHT / 4);
+    }
+
+  store (dt, destPR, dt->y0, dt->y1);
+
+  g_free (dt->sites);
+  g_free (dt->src);
+  g_free (dt->site_dy);
+  g_free (dt->dest);
+  g_free (dt->row_max);
+  g_free (dt->column_site);
+}
+
+static void
+compute_border (gint16  *circ,
+                guint16  xradius,
+                guint16  yradius)
+{
+  gint32  i;
+  gint32  diameter = xradius * 2 + 1;
+  gdouble tmp;
+
+  for (i = 0; i < diameter; i++)
+  {
+    if (i > xradius)
+      tmp = (i - xradius) - 0.5;
+    else if (i < xradius)
+      tmp = (xradius - i) - 0.5;
+    else
+      tmp = 0.0;
+
+    circ[i] = RINT (yradius /
+                    (gdouble) xradius * sqrt (SQR (xradius) - SQR (tmp)));
+  }
+}
+
+/*  loads the rows of a mask that the distances are taken from  */
+static void
+distance_load_mask (DistanceTransform *dt,
+                    PixelRegion       *region,
+                    gint               y0,
+                    gint               y1)
+{
+  const gsize n = (gsize) dt->width * (y1 - y0);
+  gint        y;
+  gsize       i;
+
+  for (y = y0; y < y1; y++)
+    pixel_region_get_row (region, region->x, region->y + y, region->w,
+                          dt->src + (y - y0) * dt->width, 1);
+
+  for (i = 0; i < n; i++)
+    dt->sites[i] = (dt->src[i] == dt->value);
+}
+
+static void
+distance_store_mask (DistanceTransform *dt,
+                     PixelRegion       *region,
+                     gint               y0,
+                     gint               y1)
+{
+  gint y;
+
+  for (y = y0; y < y1; y++)
+    pixel_region_set_row (region, region->x, region->y + y, region->w,
+                          dt->dest + (y - y0) * dt->width);
+}
+
+/*  A column whose nearest site is d rows away covers the pixels of
+ *  the row that are at most grow_width[d] columns away from it.  The
+ *  row is swept both ways to find the pixels any column covers.
+ */
+static void
+distance_row_grow (DistanceTransform *dt,
+                   gint               y,
+                   const gdouble     *dist,
+                   const gint        *site_x)
+{
+  const gint    width   = dt->width;
+  const gint   *site_dy = dt->site_dy + (y - dt->y0) * width;
+  guchar       *dest    = dt->dest    + (y - dt->y0) * width;
+  gint          covered;
+  gint          x;
+
+  /*  with edge sites, the columns outside of the region are all sites  */
+  covered = dt->edge_sites ? dt->grow_width[0] - 1 : -1;
+
+  for (x = 0; x < width; x++)
+    {
+      const gint d = ABS (site_dy[x]);
+
+      if (d <= dt->reach)
+        covered = MAX (covered, x + dt->grow_width[d]);
+
+      dest[x] = (covered >= x) ? dt->value : dt->other;
+    }
+
+  covered = dt->edge_sites ? width - dt->grow_width[0] : width;
+
+  for (x = width - 1; x >= 0; x--)
+    {
+      const gint d = ABS (site_dy[x]);
+
+      if (d <= dt->reach)
+        covered = MIN (covered, x - dt->grow_width[d]);
+
+      if (covered <= x)
+        dest[x] = dt->value;
+    }
+}
+
+/*  Returns whether the mask, and the value outside of it unless that
+ *  is -1, have at most two different values, the smaller one in low
+ *  and the larger one in high.
+ */
+static gboolean
+distance_mask_is_binary (PixelRegion *region,
+                         gint         outside,
+                         gint        *low,
+                         gint        *high)
+{
+  PixelRegion  maskPR = *region;
+  gint         values[2];
+  gint         n      = 0;
+  gpointer     pr;
+
+  if (outside >= 0)
+    values[n++] = outside;
+
+  maskPR.dirty = FALSE;
+
+  for (pr = pixel_regions_register (1, &maskPR);
+       pr != NULL;
+       pr = pixel_regions_process (pr))
+    {
+      const guchar *data = maskPR.data;
+      gint          x, y;
+
+      for (y = 0; y < maskPR.h; y++, data += maskPR.rowstride)
+        for (x = 0; x < maskPR.w; x++)
+          {
+            const gint value = data[x * maskPR.bytes];
+
+            if ((n > 0 && value == values[0]) ||
+                (n > 1 && value == values[1]))
+              continue;
+
+            if (n == 2)
+              {
+                pixel_regions_process_stop (pr);
+                return FALSE;
+              }
+
+            values[n++] = value;
+          }
+    }
+
+  if (n == 0)
+    values[n++] = 0;
+
+  *low  = MIN (values[0], values[n - 1]);
+  *high = MAX (values[0], values[n - 1]);
+
+  return TRUE;
+}
+
+/*  Grows the larger value of a mask with only two values by the
+ *  element of fatten_region_reference(), or the smaller one if shrink
+ *  is TRUE, which is exact.  The sites are the pixels of that value.
+ *  Returns FALSE without touching masks with more values.
+ */
+static gboolean
+distance_grow_region (PixelRegion *region,
+                      gint16       xradius,
+                      gint16       yradius,
+                      gboolean     shrink,
+                      gint         outside)
+{
+  DistanceTransform  dt = { 0, };
+  gint16            *circ;
+  gint               low, high;
+  gint               d, i;
+
+  if (! distance_mask_is_binary (region, outside, &low, &high))
+    return FALSE;
+
+  if (low == high)
+    return TRUE;
 
-                  tile = tile_manager_get_tile (srcPR->tiles,
-                                                x, y, TRUE, FALSE);
+  circ = g_new (gint16, 2 * xradius + 1);
+  compute_border (circ, xradius, yradius);
 
-                  tile_data = tile_data_pointer (tile, x, y);
-                  width = tile_ewidth (tile);
+  /*  the element gets narrower further away from its center row  */
+  dt.grow_width = g_new (gint, yradius + 1);
 
-                  boundary = MIN (y % TILE_HEIGHT,
-                                  width - (x % TILE_WIDTH) - 1);
-                  boundary = MIN (boundary, y - end) + 1;
+  for (d = 0; d <= yradius; d++)
+    for (i = 0; i <= xradius; i++)
+      if (circ[xradius + i] >= d)
+        dt.grow_width[d] = i;
 
-                  inc = 1 - width;
+  g_free (circ);
 
-                  while (boundary--)
-                    {
-                      src = *tile_data;
+  dt.width        = region->w;
+  dt.height       = region->h;
+  dt.value        = shrink ? low : high;
+  dt.other        = shrink ? high : low;
+  dt.outside      = outside;
+  dt.edge_sites   = (outside == dt.value);
+  dt.reach        = yradius;
+  dt.columns_only = TRUE;
+  dt.dest_bytes   = 1;
+  dt.row_func     = distance_row_grow;
 
-                      if (src == 0)
-                        {
-                          min = k;
-                          y = -1;
-                          break;
-                        }
+  distance_transform_region (&dt, region, region,
+                             distance_load_mask, distance_store_mask);
 
-                      if (src < fraction)
-                        fraction = src;
+  g_free (dt.grow_width);
 
-                      x++;
-                      y--;
-                      tile_data += inc;
-                    }
+  return TRUE;
+}
 
-                  tile_release (tile, FALSE);
-                }
-            }
+static void
+distance_load_shapeburst (DistanceTransform *dt,
+                          PixelRegion       *region,
+                          gint               y0,
+                          gint               y1)
+{
+  const gsize n = (gsize) dt->width * (y1 - y0);
+  gint        y;
+  gsize       i;
 
-          if (src != 0)
-            {
-              /*  If min_left != min_prev use the previous fraction
-               *   if it is less than the one found
-               */
-              if (min_left != min)
-                {
-                  prev_frac = (int) (255 * (min_prev - min));
+  for (y = y0; y < y1; y++)
+    pixel_region_get_row (region, region->x, region->y + y, region->w,
+                          dt->src + (y - y0) * dt->width, 1);
 
-                  if (prev_frac == 255)
-                    prev_frac = 0;
+  for (i = 0; i < n; i++)
+    dt->sites[i] = (dt->src[i] == 0);
+}
 
-                  fraction = MIN (fraction, prev_frac);
-                }
+/*  The distance to the nearest unselected pixel, less the part of
+ *  partially selected pixels that isn't selected.
+ */
+static void
+distance_row_shapeburst (DistanceTransform *dt,
+                         gint               y,
+                         const gdouble     *dist,
+                         const gint        *site_x)
+{
+  const gint    width = dt->width;
+  const guchar *src   = dt->src + (y - dt->s0) * width;
+  gfloat       *dest  = (gfloat *) dt->dest + (y - dt->y0) * width;
+  gfloat        max   = 0.0;
+  gint          x;
 
-              min++;
-            }
+  for (x = 0; x < width; x++)
+    {
+      if (src[x])
+        dest[x] = sqrt (dist[x]) - 1.0 + src[x] / 255.0;
+      else
+        dest[x] = 0.0;
 
-          float_tmp = distp_cur[j] = min + fraction / 256.0;
+      max = MAX (max, dest[x]);
+    }
 
-          if (float_tmp > max_iterations)
-            max_iterations = float_tmp;
-        }
+  dt->row_max[y - dt->y0] = max;
+}
 
-      /*  set the dist row  */
-      pixel_region_set_row (distPR,
-                            distPR->x, distPR->y + i, distPR->w,
-                            (guchar *) distp_cur);
+static void
+distance_store_shapeburst (DistanceTransform *dt,
+                           PixelRegion       *region,
+                           gint               y0,
+                           gint               y1)
+{
+  gint y;
 
-      /*  swap pointers around  */
-      tmp = distp_prev;
-      distp_prev = distp_cur;
-      distp_cur = tmp;
+  for (y = y0; y < y1; y++)
+    {
+      pixel_region_set_row (region, region->x, region->y + y, region->w,
+                            dt->dest + (gsize) (y - y0) * dt->width * 4);
 
-      if (progress_callback)
-        {
-          progress += srcPR->h;
-          (* progress_callback) (0, max_progress, progress, progress_data);
-        }
+      dt->max = MAX (dt->max, dt->row_max[y - y0]);
     }
 
-  g_free (memory);
-
-  return max_iterations;
+  if (dt->progress_callback)
+    (* dt->progress_callback) (0, dt->height, y1, dt->progress_data);
 }
 
-static void
-compute_border (gint16  *circ,
-                guint16  xradius,
-                guint16  yradius)
+gfloat
+shapeburst_region (PixelRegion      *srcPR,
+                   PixelRegion      *distPR,
+                   GimpProgressFunc  progress_callback,
+                   gpointer          progress_data)
 {
-  gint32  i;
-  gint32  diameter = xradius * 2 + 1;
-  gdouble tmp;
+  DistanceTransform dt = { 0, };
 
-  for (i = 0; i < diameter; i++)
-  {
-    if (i > xradius)
-      tmp = (i - xradius) - 0.5;
-    else if (i < xradius)
-      tmp = (xradius - i) - 0.5;
-    else
-      tmp = 0.0;
+  dt.width      = srcPR->w;
+  dt.height     = srcPR->h;
+  dt.sx         = 1.0;
+  dt.sy         = 1.0;
+  dt.edge_sites = TRUE;
+  dt.reach      = 0;
+  dt.dest_bytes = sizeof (gfloat);
+  dt.row_func   = distance_row_shapeburst;
 
-    circ[i] = RINT (yradius /
-                    (gdouble) xradius * sqrt (SQR (xradius) - SQR (tmp)));
-  }
+  dt.progress_callback = progress_callback;
+  dt.progress_data     = progress_data;
+
+  distance_transform_region (&dt, srcPR, distPR,
+                             distance_load_shapeburst,
+                             distance_store_shapeburst);
+
+  return dt.max;
 }
 
+/*  Masks with only two values, like selections without feathering or
+ *  antialiasing, are grown and shrunk with the distance transform, at
+ *  a cost that doesn't depend on the radius.  Other masks take the
+ *  max (or min) filter of the reference functions.
+ */
 void
 fatten_region (PixelRegion *region,
                gint16       xradius,
                gint16       yradius)
+{
+  if (xradius <= 0 || yradius <= 0)
+    return;
+
+  /*  pixels outside the region are 0, which never wins  */
+  if (! distance_grow_region (region, xradius, yradius, FALSE, -1))
+    fatten_region_reference (region, xradius, yradius);
+}
+
+void
+thin_region (PixelRegion *region,
+             gint16       xradius,
+             gint16       yradius,
+             gboolean     edge_lock)
+{
+  if (xradius <= 0 || yradius <= 0)
+    return;
+
+  /*  If edge_lock is true we assume that pixels outside the region
+   *  we are passed are identical to the edge pixels, which never
+   *  change the result.  If edge_lock is false, we assume that pixels
+   *  outside the region are 0.
+   */
+  if (! distance_grow_region (region, xradius, yradius, TRUE,
+                              edge_lock ? -1 : 0))
+    thin_region_reference (region, xradius, yradius, edge_lock);
+}
+
+void
+fatten_region_reference (PixelRegion *region,
+                         gint16       xradius,
+                         gint16       yradius)
 {
   /*
-     Any bugs in this fuction are probably also in thin_region
+     Any bugs in this fuction are probably also in thin_region_reference
      Blame all bugs in this function on jaycox@gimp.org
   */
   register gint32 i, j, x, y;
@@ -2747,9 +3596,9 @@ fatten_region (PixelRegion *region,
   buf = g_new (guchar *, yradius + 1);
 
   for (i = 0; i < yradius + 1; i++)
-    buf[i] = g_new (guchar, region->w);
+    buf[i] = g_new0 (guchar, region->w);
 
-  buffer = g_new (guchar, (region->w + 2 * xradius) * (yradius + 1));
+  buffer = g_new0 (guchar, (region->w + 2 * xradius) * (yradius + 1));
 
   for (i = 0; i < region->w + 2 * xradius; i++)
     {
@@ -2873,10 +3722,10 @@ fatten_region (PixelRegion *region,
 }
 
 void
-thin_region (PixelRegion *region,
-             gint16       xradius,
-             gint16       yradius,
-             gboolean     edge_lock)
+thin_region_reference (PixelRegion *region,
+                       gint16       xradius,
+                       gint16       yradius,
+                       gboolean     edge_lock)
 {
   /*
      pretty much the same as fatten_region only different
@@ -2955,6 +3804,13 @@ thin_region (PixelRegion *region,
   for (i = 0; i < yradius && i < region->h; i++) /* load top of image */
     pixel_region_get_row (region,
                           region->x, region->y + i, region->w, buf[i + 1], 1);
+
+  for (; i < yradius; i++) /* the region is less high than the radius */
+    if (edge_lock)
+      memcpy (buf[i + 1], buf[i], region->w);
+    else
+      memset (buf[i + 1], 0, region->w);
+
   if (edge_lock)
     memcpy (buf[0], buf[1], region->w);
   else
@@ -3333,40 +4189,80 @@ compute_transition (guchar    *transition,
     }
 }
 
-void
-border_region (PixelRegion *src,
-               gint16       xradius,
-               gint16       yradius,
-               gboolean     feather,
-               gboolean     edge_lock)
+/*  The sites of border_region() are the transitional pixels.  */
+static void
+distance_load_border (DistanceTransform *dt,
+                      PixelRegion       *region,
+                      gint               y0,
+                      gint               y1)
 {
-  /*
-     This function has no bugs, but if you imagine some you can
-     blame them on jaycox@gimp.org
-  */
+  const gint  width = dt->width;
+  guchar     *buf[3];
+  gint        edge  = dt->outside;
+  gint        i, y;
 
-  register gint32 i, j, x, y;
+  for (i = 0; i < 3; i++)
+    buf[i] = g_new (guchar, width);
+
+  if (y0 > 0)
+    pixel_region_get_row (region, region->x, region->y + y0 - 1, width,
+                          buf[1], 1);
+  else
+    memset (buf[1], edge, width);
+
+  pixel_region_get_row (region, region->x, region->y + y0, width, buf[2], 1);
+
+  for (y = y0; y < y1; y++)
+    {
+      guchar *sites = dt->sites + (y - y0) * width;
+
+      rotate_pointers (buf, 3);
+
+      if (y + 1 < dt->height)
+        pixel_region_get_row (region, region->x, region->y + y + 1, width,
+                              buf[2], 1);
+      else
+        memset (buf[2], edge, width);
 
-  /* A cache used in the algorithm as it works its way down. `buf[1]' is the
-     current row. Thus, at algorithm initialization, `buf[0]' represents the
-     row 'above' the first row of the region. */
-  guchar  *buf[3];
+      compute_transition (sites, buf, width, edge == 255);
 
-  /* The resulting selection is calculated row by row, and this buffer holds the
-     output for each individual row, on each iteration. */
-  guchar  *out;
+      for (i = 0; i < width; i++)
+        sites[i] = (sites[i] != 0);
+    }
 
-  /* Keeps track of transitional pixels (pixels that are selected and have
-     unselected neighbouring pixels). */
-  guchar **transition;
+  for (i = 0; i < 3; i++)
+    g_free (buf[i]);
+}
 
-  /* TODO: Figure out role clearly in algorithm. */
-  gint16  *max;
+static void
+distance_row_border (DistanceTransform *dt,
+                     gint               y,
+                     const gdouble     *dist,
+                     const gint        *site_x)
+{
+  guchar *dest = dt->dest + (y - dt->y0) * dt->width;
+  gint    x;
 
-  /* TODO: Figure out role clearly in algorithm. */
-  guchar **density;
+  for (x = 0; x < dt->width; x++)
+    {
+      if (dist[x] >= 1.0)
+        dest[x] = 0;
+      else if (dt->feather)
+        dest[x] = 255 * (1.0 - sqrt (dist[x]));
+      else
+        dest[x] = 255;
+    }
+}
 
-  gint16   last_index;
+void
+border_region (PixelRegion *src,
+               gint16       xradius,
+               gint16       yradius,
+               gboolean     feather,
+               gboolean     edge_lock)
+{
+  DistanceTransform dt = { 0, };
+  gint              i, y;
 
   if (xradius < 0 || yradius < 0)
     {
@@ -3437,260 +4333,18 @@ border_region (PixelRegion *src,
       return;
     }
 
-  max = g_new (gint16, src->w + 2 * xradius);
-
-  for (i = 0; i < (src->w + 2 * xradius); i++)
-    max[i] = yradius + 2;
-
-  max += xradius;
-
-  for (i = 0; i < 3; i++)
-    buf[i] = g_new (guchar, src->w);
-
-  transition = g_new (guchar *, yradius + 1);
-
-  for (i = 0; i < yradius + 1; i++)
-    {
-      transition[i] = g_new (guchar, src->w + 2 * xradius);
-      memset(transition[i], 0, src->w + 2 * xradius);
-      transition[i] += xradius;
-    }
-
-  out = g_new (guchar, src->w);
-
-  density = g_new (guchar *, 2 * xradius + 1);
-  density += xradius;
-
-   /* allocate density[][] */
-  for (x = 0; x < (xradius + 1); x++)
-    {
-      density[ x]  = g_new (guchar, 2 * yradius + 1);
-      density[ x] += yradius;
-      density[-x]  = density[x];
-    }
-
-  /* compute density[][] */
-  for (x = 0; x < (xradius + 1); x++)
-    {
-      register gdouble tmpx, tmpy, dist;
-      guchar a;
-
-      if (x > 0)
-        tmpx = x - 0.5;
-      else if (x < 0)
-        tmpx = x + 0.5;
-      else
-        tmpx = 0.0;
-
-      for (y = 0; y < (yradius + 1); y++)
-        {
-          if (y > 0)
-            tmpy = y - 0.5;
-          else if (y < 0)
-            tmpy = y + 0.5;
-          else
-            tmpy = 0.0;
-
-          dist = ((tmpy * tmpy) / (yradius * yradius) +
-                  (tmpx * tmpx) / (xradius * xradius));
-
-          if (dist < 1.0)
-            {
-              if (feather)
-                a = 255 * (1.0 - sqrt (dist));
-              else
-                a = 255;
-            }
-          else
-            {
-              a = 0;
-            }
-
-          density[ x][ y] = a;
-          density[ x][-y] = a;
-          density[-x][ y] = a;
-          density[-x][-y] = a;
-        }
-    }
-
-  /* Since the algorithm considerers `buf[0]' to be 'over' the row currently
-     calculated, we must start with `buf[0]' as non-selected if there is no
-     `edge_lock. If there is an 'edge_lock', initialize the first row to
-     'selected'. Refer to bug #350009. */
-  memset (buf[0], edge_lock ? 255 : 0, src->w);
-  pixel_region_get_row (src, src->x, src->y + 0, src->w, buf[1], 1);
-
-  if (src->h > 1)
-    pixel_region_get_row (src, src->x, src->y + 1, src->w, buf[2], 1);
-  else
-    memcpy (buf[2], buf[1], src->w);
-
-  compute_transition (transition[1], buf, src->w, edge_lock);
-
-   /* set up top of image */
-  for (y = 1; y < yradius && y + 1 < src->h; y++)
-    {
-      rotate_pointers (buf, 3);
-      pixel_region_get_row (src, src->x, src->y + y + 1, src->w, buf[2], 1);
-      compute_transition (transition[y + 1], buf, src->w, edge_lock);
-    }
-
-  /* set up max[] for top of image */
-  for (x = 0; x < src->w; x++)
-    {
-      max[x] = -(yradius + 7);
-
-      for (j = 1; j < yradius + 1; j++)
-        if (transition[j][x])
-          {
-            max[x] = j;
-            break;
-          }
-    }
-
-  /* main calculation loop */
-  for (y = 0; y < src->h; y++)
-    {
-      rotate_pointers (buf, 3);
-      rotate_pointers (transition, yradius + 1);
-
-      if (y < src->h - (yradius + 1))
-        {
-          pixel_region_get_row (src, src->x, src->y + y + yradius + 1, src->w,
-                                buf[2], 1);
-          compute_transition (transition[yradius], buf, src->w, edge_lock);
-        }
-      else
-        {
-          if (edge_lock)
-            {
-              memcpy (transition[yradius], transition[yradius - 1], src->w);
-            }
-          else
-            {
-              /* No edge lock, set everything 'below canvas' as seen from the
-                 algorithm as unselected. */
-              memset (buf[2], 0, src->w);
-              compute_transition (transition[yradius], buf, src->w, edge_lock);
-            }
-        }
-
-       /* update max array */
-      for (x = 0; x < src->w; x++)
-        {
-          if (max[x] < 1)
-            {
-              if (max[x] <= -yradius)
-                {
-                  if (transition[yradius][x])
-                    max[x] = yradius;
-                  else
-                    max[x]--;
-                }
-              else
-                {
-                  if (transition[-max[x]][x])
-                    max[x] = -max[x];
-                  else if (transition[-max[x] + 1][x])
-                    max[x] = -max[x] + 1;
-                  else
-                    max[x]--;
-                }
-            }
-          else
-            {
-              max[x]--;
-            }
-
-          if (max[x] < -yradius - 1)
-            max[x] = -yradius - 1;
-        }
-
-      last_index = 1;
-
-       /* render scan line */
-      for (x = 0 ; x < src->w; x++)
-        {
-          guchar last_max;
-
-          last_index--;
-
-          if (last_index >= 0)
-            {
-              last_max = 0;
-
-              for (i = xradius; i >= 0; i--)
-                if (max[x + i] <= yradius && max[x + i] >= -yradius &&
-                    density[i][max[x+i]] > last_max)
-                  {
-                    last_max = density[i][max[x + i]];
-                    last_index = i;
-                  }
-
-              out[x] = last_max;
-            }
-          else
-            {
-              last_max = 0;
-
-              for (i = xradius; i >= -xradius; i--)
-                if (max[x + i] <= yradius && max[x + i] >= -yradius &&
-                    density[i][max[x + i]] > last_max)
-                  {
-                    last_max = density[i][max[x + i]];
-                    last_index = i;
-                  }
-
-              out[x] = last_max;
-            }
-
-          if (last_max == 0)
-            {
-              for (i = x + 1; i < src->w; i++)
-                {
-                  if (max[i] >= -yradius)
-                    break;
-                }
-
-              if (i - x > xradius)
-                {
-                  for (; x < i - xradius; x++)
-                    out[x] = 0;
-
-                  x--;
-                }
-
-              last_index = xradius;
-            }
-        }
-
-      pixel_region_set_row (src, src->x, src->y + y, src->w, out);
-    }
-
-  g_free (out);
-
-  for (i = 0; i < 3; i++)
-    g_free (buf[i]);
-
-  max -= xradius;
-  g_free (max);
-
-  for (i = 0; i < yradius + 1; i++)
-    {
-      transition[i] -= xradius;
-      g_free (transition[i]);
-    }
-
-  g_free (transition);
-
-  for (i = 0; i < xradius + 1 ; i++)
-    {
-      density[i] -= yradius;
-      g_free (density[i]);
-    }
-
-  density -= xradius;
-  g_free (density);
+  dt.width      = src->w;
+  dt.height     = src->h;
+  dt.sx         = 1.0 / SQR (xradius + 0.5);
+  dt.sy         = 1.0 / SQR (yradius + 0.5);
+  dt.reach      = yradius + 1;
+  dt.dest_bytes = 1;
+  dt.row_func   = distance_row_border;
+  dt.outside    = edge_lock ? 255 : 0;
+  dt.feather    = feather;
+
+  distance_transform_region (&dt, src, src,
+                             distance_load_border, distance_store_mask);
 }
 
 void
@@ -408,6 +408,13 @@ void  gaussian_blur_region                (PixelRegion *srcR,
                                            gdouble      radius_x,
                                            gdouble      radius_y);
 
+/*  the direct convolution gaussian_blur_region() uses for small radii,
+ *  kept as the reference for the recursive filter
+ */
+void  gaussian_blur_region_reference      (PixelRegion *srcR,
+                                           gdouble      radius_x,
+                                           gdouble      radius_y);
+
 void  border_region                       (PixelRegion *src,
                                            gint16       xradius,
                                            gint16       yradius,
@@ -428,6 +435,18 @@ void  fatten_region                       (PixelRegion *region,
                                            gint16       xradius,
                                            gint16       yradius);
 
+/*  the max and min filters fatten_region() and thin_region() use for
+ *  masks with more than two values, kept as their reference
+ */
+void  thin_region_reference               (PixelRegion *region,
+                                           gint16       xradius,
+                                           gint16       yradius,
+                                           gboolean     edge_lock);
+
+void  fatten_region_reference             (PixelRegion *region,
+                                           gint16       xradius,
+                                           gint16       yradius);
+
 void  smooth_region                       (PixelRegion *region);
 void  erode_region                        (PixelRegion *region);
 void  dilate_region                       (PixelRegion *region);
@@ -27,18 +27,20 @@
 
 #include "base/tile.h"
 #include "base/tile-manager.h"
+#include "base/pixel-processor.h"
 #include "base/pixel-region.h"
-#include "base/pixel-surround.h"
 
 #include "paint-funcs.h"
 #include "scale-region.h"
 
 #include "gimp-log.h"
 
-
 #define NUM_TILES(w,h) ((((w) + (TILE_WIDTH - 1)) / TILE_WIDTH) *  \
                         (((h) + (TILE_HEIGHT - 1)) / TILE_HEIGHT))
 
+/*  the number of destination rows that are filtered in parallel  */
+#define SCALE_BAND_HEIGHT  (4 * TILE_HEIGHT)
+
 
 static void           scale_determine_levels   (PixelRegion           *srcPR,
                                                 PixelRegion           *dstPR,
@@ -57,79 +59,27 @@ static void           scale_region_tile        (PixelRegion           *srcPR,
                                                 GimpProgressFunc       progress_callback,
                                                 gpointer               progress_data);
 static void           scale                    (TileManager           *srcTM,
-                                                TileManager           *dstTM,
-                                                GimpInterpolationType  interpolation,
-                                                GimpProgressFunc       progress_callback,
-                                                gpointer               progress_data,
-                                                gint                  *progress,
-                                                gint                   max_progress,
-                                                const gdouble          scalex,
-                                                const gdouble          scaley);
-static void           decimate_xy              (TileManager           *srcTM,
                                                 TileManager           *dstTM,
                                                 GimpInterpolationType  interpolation,
                                                 GimpProgressFunc       progress_callback,
                                                 gpointer               progress_data,
                                                 gint                  *progress,
                                                 gint                   max_progress);
-static void           decimate_x               (TileManager           *srcTM,
+static void           decimate                 (TileManager           *srcTM,
                                                 TileManager           *dstTM,
-                                                GimpInterpolationType  interpolation,
                                                 GimpProgressFunc       progress_callback,
                                                 gpointer               progress_data,
                                                 gint                  *progress,
                                                 gint                   max_progress);
-static void           decimate_y               (TileManager           *srcTM,
+
+static void           scale_pass               (TileManager           *srcTM,
                                                 TileManager           *dstTM,
-                                                GimpInterpolationType  interpolation,
+                                                ScalePass             *pass,
                                                 GimpProgressFunc       progress_callback,
                                                 gpointer               progress_data,
                                                 gint                  *progress,
                                                 gint                   max_progress);
-static void           decimate_average_xy      (PixelSurround *surround,
-                                                const gint     x0,
-                                                const gint     y0,
-                                                const gint     bytes,
-                                                guchar        *pixel);
-static void           decimate_average_y       (PixelSurround *surround,
-                                                const gint     x0,
-                                                const gint     y0,
-                                                const gint     bytes,
-                                                guchar        *pixel);
-static void           decimate_average_x       (PixelSurround *surround,
-                                                const gint     x0,
-                                                const gint     y0,
-                                                const gint     bytes,
-                                                guchar        *pixel);
-static void           interpolate_nearest      (TileManager   *srcTM,
-                                                const gint     x0,
-                                                const gint     y0,
-                                                const gdouble  xfrac,
-                                                const gdouble  yfrac,
-                                                guchar        *pixel);
-static void           interpolate_bilinear     (PixelSurround *surround,
-                                                const gint     x0,
-                                                const gint     y0,
-                                                const gdouble  xfrac,
-                                                const gdouble  yfrac,
-                                                const gint     bytes,
-                                                guchar        *pixel);
-static void           interpolate_cubic        (PixelSurround *surround,
-                                                const gint     x0,
-                                                const gint     y0,
-                                                const gdouble  xfrac,
-                                                const gdouble  yfrac,
-                                                const gint     bytes,
-                                                guchar        *pixel);
-static gfloat *       create_lanczos3_lookup   (void);
-static void           interpolate_lanczos3     (PixelSurround *surround,
-                                                const gint     x0,
-                                                const gint     y0,
-                                                const gdouble  xfrac,
-                                                const gdouble  yfrac,
-                                                const gint     bytes,
-                                                guchar        *pixel,
-                                                const gfloat  *kernel_lookup);
+
 static void           interpolate_bilinear_pr  (PixelRegion   *srcPR,
                                                 const gint     x0,
                                                 const gint     y0,
@@ -139,10 +89,10 @@ static void           interpolate_bilinear_pr  (PixelRegion   *srcPR,
                                                 const gdouble  yfrac,
                                                 guchar        *pixel);
 static inline gdouble cubic_spline_fit         (const gdouble  dx,
-                                                const gdouble  x1,
-                                                const gdouble  y1,
-                                                const gdouble  x2,
-                                                const gdouble  y2);
+                                                const gdouble  pt0,
+                                                const gdouble  pt1,
+                                                const gdouble  pt2,
+                                                const gdouble  pt3);
 static inline gdouble weighted_sum             (const gdouble  dx,
                                                 const gdouble  dy,
                                                 const gint     s00,
@@ -150,19 +100,6 @@ static inline gdouble weighted_sum             (const gdouble  dx,
                                                 const gint     s01,
                                                 const gint     s11);
 static inline gdouble sinc                     (const gdouble  x);
-static inline gdouble lanczos3_mul_alpha       (const guchar  *pixels,
-                                                const gdouble *x_kernel,
-                                                const gdouble *y_kernel,
-                                                const gint     stride,
-                                                const gint     bytes,
-                                                const gint     byte);
-static inline gdouble lanczos3_mul             (const guchar  *pixels,
-                                                const gdouble *x_kernel,
-                                                const gdouble *y_kernel,
-                                                const gint     stride,
-                                                const gint     bytes,
-                                                const gint     byte);
-
 
 
 void
@@ -290,8 +227,6 @@ scale_region_tile (PixelRegion           *srcPR,
   gint         progress     = 0;
   gint         levelx       = 0;
   gint         levely       = 0;
-  gdouble      scalex       = (gdouble) width / dstPR->w;
-  gdouble      scaley       = (gdouble) height / dstPR->h;
 
   /* determine scaling levels */
   if (interpolation != GIMP_INTERPOLATION_NONE)
@@ -304,20 +239,17 @@ scale_region_tile (PixelRegion           *srcPR,
   if (levelx == 0 && levely == 0)
     {
       scale (srcTM, dstTM, interpolation,
-             progress_callback, progress_data, &progress, max_progress,
-             scalex, scaley);
+             progress_callback, progress_data, &progress, max_progress);
     }
 
   while (levelx > 0 && levely > 0)
     {
       width  = (width + 1) >> 1;
       height = (height + 1) >> 1;
-      scalex *= .5;
-      scaley *= .5;
 
       tmpTM = tile_manager_new (width, height, bytes);
-      decimate_xy (srcTM, tmpTM, interpolation,
-                   progress_callback, progress_data, &progress, max_progress);
+      decimate (srcTM, tmpTM,
+                progress_callback, progress_data, &progress, max_progress);
 
       if (srcTM != srcPR->tiles)
         tile_manager_unref (srcTM);
@@ -330,11 +262,10 @@ scale_region_tile (PixelRegion           *srcPR,
   while (levelx > 0)
     {
       width = (width + 1) >> 1;
-      scalex *= .5;
 
       tmpTM = tile_manager_new (width, height, bytes);
-      decimate_x (srcTM, tmpTM, interpolation,
-                  progress_callback, progress_data, &progress, max_progress);
+      decimate (srcTM, tmpTM,
+                progress_callback, progress_data, &progress, max_progress);
 
       if (srcTM != srcPR->tiles)
         tile_manager_unref (srcTM);
@@ -346,11 +277,10 @@ scale_region_tile (PixelRegion           *srcPR,
   while (levely > 0)
     {
       height = (height + 1) >> 1;
-      scaley *= .5;
 
       tmpTM = tile_manager_new (width, height, bytes);
-      decimate_y (srcTM, tmpTM, interpolation,
-                  progress_callback, progress_data, &progress, max_progress);
+      decimate (srcTM, tmpTM,
+                progress_callback, progress_data, &progress, max_progress);
 
       if (srcTM != srcPR->tiles)
         tile_manager_unref (srcTM);
@@ -362,8 +292,7 @@ scale_region_tile (PixelRegion           *srcPR,
   if (tmpTM != NULL)
     {
       scale (tmpTM, dstTM, interpolation,
-             progress_callback, progress_data, &progress, max_progress,
-             scalex, scaley);
+             progress_callback, progress_data, &progress, max_progress);
       tile_manager_unref (tmpTM);
     }
 
@@ -373,514 +302,422 @@ scale_region_tile (PixelRegion           *srcPR,
   return;
 }
 
-static void
-scale (TileManager           *srcTM,
-       TileManager           *dstTM,
-       GimpInterpolationType  interpolation,
-       GimpProgressFunc       progress_callback,
-       gpointer               progress_data,
-       gint                  *progress,
-       gint                   max_progress,
-       const gdouble          scalex,
-       const gdouble          scaley)
+/*  Builds the filter that resamples src_size pixels to dst_size pixels
+ *  along one axis, using the same pixel positions and kernels as the
+ *  old per-pixel interpolation code.
+ */
+void
+scale_filter_init (ScaleFilter           *filter,
+                   gint                   src_size,
+                   gint                   dst_size,
+                   GimpInterpolationType  interpolation,
+                   const gfloat          *kernel_lookup)
 {
-  PixelRegion     region;
-  PixelSurround  *surround   = NULL;
-  const guint     src_width  = tile_manager_width  (srcTM);
-  const guint     src_height = tile_manager_height (srcTM);
-  const guint     bytes      = tile_manager_bpp    (dstTM);
-  const guint     dst_width  = tile_manager_width  (dstTM);
-  const guint     dst_height = tile_manager_height (dstTM);
-  gpointer        pr;
-  gfloat         *kernel_lookup = NULL;
+  const gdouble scale = (gdouble) src_size / (gdouble) dst_size;
+  gint          n_taps;
+  gint          i, t;
 
-  GIMP_LOG (SCALE, "scale: %dx%d -> %dx%d",
-            src_width, src_height, dst_width, dst_height);
-
-  /* fall back if not enough pixels available */
-  if (interpolation != GIMP_INTERPOLATION_NONE)
-    {
-      if (src_width < 2 || src_height < 2 ||
-          dst_width < 2 || dst_height < 2)
-        {
-          interpolation = GIMP_INTERPOLATION_NONE;
-        }
-      else if (src_width < 3 || src_height < 3 ||
-               dst_width < 3 || dst_height < 3)
-        {
-          interpolation = GIMP_INTERPOLATION_LINEAR;
-        }
-    }
+  /*  nearest neighbor at scale 1.0 copies the pixels  */
+  if (src_size == dst_size)
+    interpolation = GIMP_INTERPOLATION_NONE;
 
   switch (interpolation)
     {
-    case GIMP_INTERPOLATION_NONE:
-      break;
-
     case GIMP_INTERPOLATION_LINEAR:
-      surround = pixel_surround_new (srcTM, 2, 2, PIXEL_SURROUND_SMEAR);
+      n_taps = 2;
       break;
 
     case GIMP_INTERPOLATION_CUBIC:
-      surround = pixel_surround_new (srcTM, 4, 4, PIXEL_SURROUND_SMEAR);
+      n_taps = 4;
       break;
 
     case GIMP_INTERPOLATION_LANCZOS:
-      surround = pixel_surround_new (srcTM, 6, 6, PIXEL_SURROUND_SMEAR);
-      kernel_lookup = create_lanczos3_lookup ();
+      n_taps = 2 * LANCZOS_WIDTH;
+      break;
+
+    default:
+      n_taps = 1;
       break;
     }
 
-  pixel_region_init (&region, dstTM, 0, 0, dst_width, dst_height, TRUE);
+  filter->n_taps = n_taps;
+  filter->index  = g_new (gint,   dst_size * n_taps);
+  filter->weight = g_new (gfloat, dst_size * n_taps);
 
-  for (pr = pixel_regions_register (1, &region);
-       pr != NULL;
-       pr = pixel_regions_process (pr))
+  for (i = 0; i < dst_size; i++)
     {
-      const gint  x1  = region.x + region.w;
-      const gint  y1  = region.y + region.h;
-      guchar     *row = region.data;
-      gint        y;
+      gint    *index  = filter->index  + i * n_taps;
+      gfloat  *weight = filter->weight + i * n_taps;
+      gdouble  frac   = (i + 0.5) * scale - 0.5;
+      gint     first  = floor (frac);
+
+      frac -= first;
 
-      for (y = region.y; y < y1; y++)
+      switch (interpolation)
         {
-          guchar  *pixel = row;
-          gdouble  yfrac = (y + 0.5) * scaley - 0.5;
-          gint     sy    = floor (yfrac);
-          gint     x;
+        case GIMP_INTERPOLATION_LINEAR:
+          weight[0] = 1.0 - frac;
+          weight[1] = frac;
+          break;
 
-          yfrac = yfrac - sy;
+        case GIMP_INTERPOLATION_CUBIC:
+          /*  the spline is linear in its points, so its weights are
+           *  the spline of the unit impulses
+           */
+          for (t = 0; t < 4; t++)
+            weight[t] = cubic_spline_fit (frac,
+                                          t == 0, t == 1, t == 2, t == 3);
+          first -= 1;
+          break;
 
-          for (x = region.x; x < x1; x++)
-            {
-              gdouble xfrac = (x + 0.5) * scalex - 0.5;
-              gint    sx    = floor (xfrac);
+        case GIMP_INTERPOLATION_LANCZOS:
+          {
+            const gint shift = (gint) (frac * LANCZOS_SPP + 0.5);
+            gdouble    sum   = 0.0;
 
-              xfrac = xfrac - sx;
+            for (t = 0; t < n_taps; t++)
+              {
+                gint pos = (t - (LANCZOS_WIDTH - 1)) * LANCZOS_SPP;
 
-              switch (interpolation)
-                {
-                case GIMP_INTERPOLATION_NONE:
-                  interpolate_nearest (srcTM, sx, sy, xfrac, yfrac, pixel);
-                  break;
-
-                case GIMP_INTERPOLATION_LINEAR:
-                  interpolate_bilinear (surround,
-                                        sx, sy, xfrac, yfrac, bytes, pixel);
-                  break;
-
-                case GIMP_INTERPOLATION_CUBIC:
-                  interpolate_cubic (surround,
-                                     sx, sy, xfrac, yfrac, bytes, pixel);
-                  break;
-
-                case GIMP_INTERPOLATION_LANCZOS:
-                  interpolate_lanczos3 (surround,
-                                        sx, sy, xfrac, yfrac, bytes, pixel,
-                                        kernel_lookup);
-                  break;
-                }
+                weight[t] = kernel_lookup[ABS (shift - pos)];
+                sum += weight[t];
+              }
 
-              pixel += region.bytes;
-            }
+            for (t = 0; t < n_taps; t++)
+              weight[t] /= sum;
 
-          row += region.rowstride;
-        }
+            first -= LANCZOS_WIDTH - 1;
+          }
+          break;
 
-      if (progress_callback)
-        {
-          (*progress)++;
+        default:
+          weight[0] = 1.0;
 
-          if (*progress % 8 == 0)
-            progress_callback (0, max_progress, *progress, progress_data);
+          if (frac > 0.5)
+            first += 1;
+          break;
         }
+
+      /*  smear the edge pixels  */
+      for (t = 0; t < n_taps; t++)
+        index[t] = CLAMP (first + t, 0, src_size - 1);
+    }
+}
+
+/*  Builds the filter of one decimation step, which averages pairs of
+ *  pixels, or copies them if this axis isn't decimated.
+ */
+void
+scale_filter_init_decimate (ScaleFilter *filter,
+                            gint         src_size,
+                            gint         dst_size)
+{
+  gint i;
+
+  if (src_size == dst_size)
+    {
+      scale_filter_init (filter, src_size, dst_size,
+                         GIMP_INTERPOLATION_NONE, NULL);
+      return;
     }
 
-  if (kernel_lookup)
-    g_free (kernel_lookup);
+  filter->n_taps = 2;
+  filter->index  = g_new (gint,   dst_size * 2);
+  filter->weight = g_new (gfloat, dst_size * 2);
 
-  if (surround)
-    pixel_surround_destroy (surround);
+  for (i = 0; i < dst_size; i++)
+    {
+      filter->index[2 * i]      = MIN (2 * i,     src_size - 1);
+      filter->index[2 * i + 1]  = MIN (2 * i + 1, src_size - 1);
+      filter->weight[2 * i]     = 0.5;
+      filter->weight[2 * i + 1] = 0.5;
+    }
 }
 
-static void
-decimate_xy (TileManager           *srcTM,
-             TileManager           *dstTM,
-             GimpInterpolationType  interpolation,
-             GimpProgressFunc       progress_callback,
-             gpointer               progress_data,
-             gint                  *progress,
-             gint                   max_progress)
+void
+scale_filter_free (ScaleFilter *filter)
 {
-  PixelRegion     region;
-  PixelSurround  *surround   = NULL;
-  const guint     bytes      = tile_manager_bpp    (dstTM);
-  const guint     dst_width  = tile_manager_width  (dstTM);
-  const guint     dst_height = tile_manager_height (dstTM);
-  gpointer        pr;
+  g_free (filter->index);
+  g_free (filter->weight);
+}
 
-  GIMP_LOG (SCALE, "decimate_xy: %dx%d -> %dx%d\n",
-            tile_manager_width (srcTM), tile_manager_height (srcTM),
-            dst_width, dst_height);
+/*  The taps of a filter are sorted, so the first and last tap are the
+ *  range of source pixels an output pixel depends on.
+ */
+static inline gint
+scale_filter_first (const ScaleFilter *filter,
+                    gint               i)
+{
+  return filter->index[i * filter->n_taps];
+}
 
-  surround = pixel_surround_new (srcTM, 2, 2, PIXEL_SURROUND_SMEAR);
+static inline gint
+scale_filter_last (const ScaleFilter *filter,
+                   gint               i)
+{
+  return filter->index[i * filter->n_taps + filter->n_taps - 1];
+}
 
-  pixel_region_init (&region, dstTM, 0, 0, dst_width, dst_height, TRUE);
+/*  Filters one destination region, called from the pixel processor.
+ *  The horizontal pass filters all source rows the region depends on
+ *  into a float buffer, the vertical pass combines these rows into the
+ *  destination.  Both inner loops run over contiguous memory with
+ *  fixed weights, so the compiler can vectorize them.
+ */
+void
+scale_pass_region (ScalePass   *pass,
+                   PixelRegion *destPR)
+{
+  const gint  bytes     = pass->bytes;
+  const gint  n_x       = pass->x.n_taps;
+  const gint  n_y       = pass->y.n_taps;
+  const gint  rowstride = destPR->w * bytes;
+  const gint  y1        = scale_filter_first (&pass->y, destPR->y);
+  const gint  y2        = scale_filter_last  (&pass->y,
+                                              destPR->y + destPR->h - 1);
+  gfloat     *rows      = g_new (gfloat, (y2 - y1 + 1) * rowstride);
+  gfloat     *sum       = g_new (gfloat, rowstride);
+  guchar     *dest      = destPR->data;
+  gint        x, y, t, b;
 
-  for (pr = pixel_regions_register (1, &region);
-       pr != NULL;
-       pr = pixel_regions_process (pr))
+  for (y = y1; y <= y2; y++)
     {
-      const gint  x1  = region.x + region.w;
-      const gint  y1  = region.y + region.h;
-      guchar     *row = region.data;
-      gint        y;
+      const guchar *src = (pass->src +
+                           (y - pass->src_y) * pass->src_width * bytes);
+      gfloat       *row = rows + (y - y1) * rowstride;
 
-      for (y = region.y; y < y1; y++)
+      for (x = destPR->x; x < destPR->x + destPR->w; x++)
         {
-          const gint  sy    = y * 2;
-          guchar     *pixel = row;
-          gint        x;
+          const gint   *index  = pass->x.index  + x * n_x;
+          const gfloat *weight = pass->x.weight + x * n_x;
+
+          for (b = 0; b < bytes; b++)
+            row[b] = 0.0;
 
-          for (x = region.x; x < x1; x++)
+          for (t = 0; t < n_x; t++)
             {
-              decimate_average_xy (surround, x * 2, sy, bytes, pixel);
+              const guchar *s = src + index[t] * bytes;
 
-              pixel += region.bytes;
-            }
+              if (pass->premultiply)
+                {
+                  const gfloat w = weight[t] * s[bytes - 1];
 
-          row += region.rowstride;
-        }
+                  for (b = 0; b < bytes - 1; b++)
+                    row[b] += w * s[b];
 
-      if (progress_callback)
-        {
-          (*progress)++;
+                  row[bytes - 1] += w;
+                }
+              else
+                {
+                  for (b = 0; b < bytes; b++)
+                    row[b] += weight[t] * s[b];
+                }
+            }
 
-          if (*progress % 16 == 0)
-            progress_callback (0, max_progress, *progress, progress_data);
+          row += bytes;
         }
     }
 
-  pixel_surround_destroy (surround);
-}
+  for (y = destPR->y; y < destPR->y + destPR->h; y++)
+    {
+      const gint   *index  = pass->y.index  + y * n_y;
+      const gfloat *weight = pass->y.weight + y * n_y;
+      const gfloat *s      = sum;
+      guchar       *d      = dest;
 
-static void
-decimate_x (TileManager           *srcTM,
-            TileManager           *dstTM,
-            GimpInterpolationType  interpolation,
-            GimpProgressFunc       progress_callback,
-            gpointer               progress_data,
-            gint                  *progress,
-            gint                   max_progress)
-{
-  PixelRegion     region;
-  PixelSurround  *surround   = NULL;
-  const guint     bytes      = tile_manager_bpp    (dstTM);
-  const guint     dst_width  = tile_manager_width  (dstTM);
-  const guint     dst_height = tile_manager_height (dstTM);
-  gpointer        pr;
+      for (x = 0; x < rowstride; x++)
+        sum[x] = 0.0;
 
-  GIMP_LOG (SCALE, "decimate_x: %dx%d -> %dx%d\n",
-            tile_manager_width (srcTM), tile_manager_height (srcTM),
-            dst_width, dst_height);
+      for (t = 0; t < n_y; t++)
+        {
+          const gfloat *row = rows + (index[t] - y1) * rowstride;
+          const gfloat  w   = weight[t];
 
-  surround = pixel_surround_new (srcTM, 2, 1, PIXEL_SURROUND_SMEAR);
+          for (x = 0; x < rowstride; x++)
+            sum[x] += w * row[x];
+        }
 
-  pixel_region_init (&region, dstTM, 0, 0, dst_width, dst_height, TRUE);
+      for (x = 0; x < destPR->w; x++)
+        {
+          if (pass->premultiply)
+            {
+              const gfloat alpha = s[bytes - 1];
 
-  for (pr = pixel_regions_register (1, &region);
-       pr != NULL;
-       pr = pixel_regions_process (pr))
-    {
-      const gint  x1  = region.x + region.w;
-      const gint  y1  = region.y + region.h;
-      guchar     *row = region.data;
-      gint        y;
+              if (alpha > 0)
+                {
+                  for (b = 0; b < bytes - 1; b++)
+                    {
+                      gint value = RINT (s[b] / alpha);
 
-      for (y = region.y; y < y1; y++)
-        {
-          guchar *pixel = row;
-          gint    x;
+                      d[b] = CLAMP (value, 0, 255);
+                    }
 
-          for (x = region.x; x < x1; x++)
+                  b = RINT (alpha);
+                  d[bytes - 1] = CLAMP (b, 0, 255);
+                }
+              else
+                {
+                  for (b = 0; b < bytes; b++)
+                    d[b] = 0;
+                }
+            }
+          else
             {
-              decimate_average_x (surround, x * 2, y, bytes, pixel);
+              for (b = 0; b < bytes; b++)
+                {
+                  gint value = RINT (s[b]);
 
-              pixel += region.bytes;
+                  d[b] = CLAMP (value, 0, 255);
+                }
             }
 
-          row += region.rowstride;
+          s += bytes;
+          d += bytes;
         }
 
-      if (progress_callback)
-        {
-          (*progress)++;
-
-          if (*progress % 32 == 0)
-            progress_callback (0, max_progress, *progress, progress_data);
-        }
+      dest += destPR->rowstride;
     }
 
-  pixel_surround_destroy (surround);
+  g_free (sum);
+  g_free (rows);
 }
 
+/*  Runs a separable pass from srcTM to dstTM.  The destination is
+ *  done in bands of tile rows; the source rows of a band are read on
+ *  the calling thread, the tiles of the band are filtered in parallel.
+ */
 static void
-decimate_y (TileManager           *srcTM,
-            TileManager           *dstTM,
-            GimpInterpolationType  interpolation,
-            GimpProgressFunc       progress_callback,
-            gpointer               progress_data,
-            gint                  *progress,
-            gint                   max_progress)
+scale_pass (TileManager      *srcTM,
+            TileManager      *dstTM,
+            ScalePass        *pass,
+            GimpProgressFunc  progress_callback,
+            gpointer          progress_data,
+            gint             *progress,
+            gint              max_progress)
 {
-  PixelRegion     region;
-  PixelSurround  *surround   = NULL;
-  const guint     bytes      = tile_manager_bpp    (dstTM);
-  const guint     dst_width  = tile_manager_width  (dstTM);
-  const guint     dst_height = tile_manager_height (dstTM);
-  gpointer        pr;
+  const gint  src_width  = tile_manager_width  (srcTM);
+  const gint  dst_width  = tile_manager_width  (dstTM);
+  const gint  dst_height = tile_manager_height (dstTM);
+  guchar     *src        = NULL;
+  gint        y;
 
-  GIMP_LOG (SCALE, "decimate_y: %dx%d -> %dx%d\n",
-            tile_manager_width (srcTM), tile_manager_height (srcTM),
-            dst_width, dst_height);
+  pass->bytes     = tile_manager_bpp (dstTM);
+  pass->src_width = src_width;
 
-  surround = pixel_surround_new (srcTM, 1, 2, PIXEL_SURROUND_SMEAR);
-
-  pixel_region_init (&region, dstTM, 0, 0, dst_width, dst_height, TRUE);
-
-  for (pr = pixel_regions_register (1, &region);
-       pr != NULL;
-       pr = pixel_regions_process (pr))
+  for (y = 0; y < dst_height; y += SCALE_BAND_HEIGHT)
     {
-      const gint  x1  = region.x + region.w;
-      const gint  y1  = region.y + region.h;
-      guchar     *row = region.data;
-      gint        y;
+      PixelRegion region;
+      const gint  h  = MIN (SCALE_BAND_HEIGHT, dst_height - y);
+      const gint  y1 = scale_filter_first (&pass->y, y);
+      const gint  y2 = scale_filter_last  (&pass->y, y + h - 1);
 
-      for (y = region.y; y < y1; y++)
-        {
-          const gint  sy    = y * 2;
-          guchar     *pixel = row;
-          gint        x;
+      src = g_realloc (src, (y2 - y1 + 1) * src_width * pass->bytes);
 
-          for (x = region.x; x < x1; x++)
-            {
-              decimate_average_y (surround, x, sy, bytes, pixel);
+      tile_manager_read_pixel_data (srcTM, 0, y1, src_width - 1, y2,
+                                    src, src_width * pass->bytes);
 
-              pixel += region.bytes;
-            }
+      pass->src   = src;
+      pass->src_y = y1;
 
-          row += region.rowstride;
-        }
+      pixel_region_init (&region, dstTM, 0, y, dst_width, h, TRUE);
+
+      pixel_regions_process_parallel ((PixelProcessorFunc) scale_pass_region,
+                                      pass, 1, &region);
 
       if (progress_callback)
         {
-          (*progress)++;
+          *progress += NUM_TILES (dst_width, h);
 
-          if (*progress % 32 == 0)
-            progress_callback (0, max_progress, *progress, progress_data);
+          progress_callback (0, max_progress, *progress, progress_data);
         }
     }
 
-  pixel_surround_destroy (surround);
+  g_free (src);
 }
 
-static void inline
-pixel_average4 (const guchar *p1,
-                const guchar *p2,
-                const guchar *p3,
-                const guchar *p4,
-                guchar       *p,
-                const gint    bytes)
+static void
+scale (TileManager           *srcTM,
+       TileManager           *dstTM,
+       GimpInterpolationType  interpolation,
+       GimpProgressFunc       progress_callback,
+       gpointer               progress_data,
+       gint                  *progress,
+       gint                   max_progress)
 {
-  switch (bytes)
-    {
-    case 1:
-      p[0] = (p1[0] + p2[0] + p3[0] + p4[0] + 2) >> 2;
-      break;
+  ScalePass   pass;
+  const gint  src_width     = tile_manager_width  (srcTM);
+  const gint  src_height    = tile_manager_height (srcTM);
+  const gint  bytes         = tile_manager_bpp    (dstTM);
+  const gint  dst_width     = tile_manager_width  (dstTM);
+  const gint  dst_height    = tile_manager_height (dstTM);
+  gfloat     *kernel_lookup = NULL;
 
-    case 2:
-      {
-        guint a = p1[1] + p2[1] + p3[1] + p4[1];
-
-        switch (a)
-          {
-          case 0:    /* all transparent */
-            p[0] = p[1] = 0;
-            break;
-
-          case 1020: /* all opaque */
-            p[0] = (p1[0]  + p2[0] + p3[0] + p4[0] + 2) >> 2;
-            p[1] = 255;
-            break;
-
-          default:
-            p[0] = ((p1[0] * p1[1] +
-                     p2[0] * p2[1] +
-                     p3[0] * p3[1] +
-                     p4[0] * p4[1] + (a >> 1)) / a);
-            p[1] = (a + 2) >> 2;
-            break;
-          }
-      }
-      break;
-
-    case 3:
-      p[0] = (p1[0] + p2[0] + p3[0] + p4[0] + 2) >> 2;
-      p[1] = (p1[1] + p2[1] + p3[1] + p4[1] + 2) >> 2;
-      p[2] = (p1[2] + p2[2] + p3[2] + p4[2] + 2) >> 2;
-      break;
-
-    case 4:
-      {
-        guint a = p1[3] + p2[3] + p3[3] + p4[3];
+  GIMP_LOG (SCALE, "scale: %dx%d -> %dx%d",
+            src_width, src_height, dst_width, dst_height);
 
-        switch (a)
-          {
-          case 0:    /* all transparent */
-            p[0] = p[1] = p[2] = p[3] = 0;
-            break;
-
-          case 1020: /* all opaque */
-            p[0] = (p1[0] + p2[0] + p3[0] + p4[0] + 2) >> 2;
-            p[1] = (p1[1] + p2[1] + p3[1] + p4[1] + 2) >> 2;
-            p[2] = (p1[2] + p2[2] + p3[2] + p4[2] + 2) >> 2;
-            p[3] = 255;
-            break;
-
-          default:
-            p[0] = ((p1[0] * p1[3] +
-                     p2[0] * p2[3] +
-                     p3[0] * p3[3] +
-                     p4[0] * p4[3] + (a >> 1)) / a);
-            p[1] = ((p1[1] * p1[3] +
-                     p2[1] * p2[3] +
-                     p3[1] * p3[3] +
-                     p4[1] * p4[3] + (a >> 1)) / a);
-            p[2] = ((p1[2] * p1[3] +
-                     p2[2] * p2[3] +
-                     p3[2] * p3[3] +
-                     p4[2] * p4[3] + (a >> 1)) / a);
-            p[3] = (a + 2) >> 2;
-            break;
-          }
-      }
-      break;
+  /* fall back if not enough pixels available */
+  if (interpolation != GIMP_INTERPOLATION_NONE)
+    {
+      if (src_width < 2 || src_height < 2 ||
+          dst_width < 2 || dst_height < 2)
+        {
+          interpolation = GIMP_INTERPOLATION_NONE;
+        }
+      else if (src_width < 3 || src_height < 3 ||
+               dst_width < 3 || dst_height < 3)
+        {
+          interpolation = GIMP_INTERPOLATION_LINEAR;
+        }
     }
-}
 
-static void inline
-pixel_average2 (const guchar *p1,
-                const guchar *p2,
-                guchar       *p,
-                const gint    bytes)
-{
-  switch (bytes)
-    {
-    case 1:
-      p[0] = (p1[0] + p2[0] + 1) >> 1;
-      break;
+  if (interpolation == GIMP_INTERPOLATION_LANCZOS)
+    kernel_lookup = create_lanczos_lookup ();
 
-    case 2:
-      {
-        guint a = p1[1] + p2[1];
+  scale_filter_init (&pass.x, src_width, dst_width,
+                     interpolation, kernel_lookup);
+  scale_filter_init (&pass.y, src_height, dst_height,
+                     interpolation, kernel_lookup);
 
-        switch (a)
-          {
-          case 0:    /* all transparent */
-            p[0] = p[1] = 0;
-            break;
-
-          case 510: /* all opaque */
-            p[0] = (p1[0]  + p2[0] + 1) >> 1;
-            p[1] = 255;
-            break;
-
-          default:
-            p[0] = ((p1[0] * p1[1] +
-                     p2[0] * p2[1] + (a >> 1)) / a);
-            p[1] = (a + 1) >> 1;
-            break;
-          }
-      }
-      break;
+  pass.premultiply = (interpolation != GIMP_INTERPOLATION_NONE &&
+                      (bytes == 2 || bytes == 4));
 
-    case 3:
-      p[0] = (p1[0] + p2[0] + 1) >> 1;
-      p[1] = (p1[1] + p2[1] + 1) >> 1;
-      p[2] = (p1[2] + p2[2] + 1) >> 1;
-      break;
+  scale_pass (srcTM, dstTM, &pass,
+              progress_callback, progress_data, progress, max_progress);
 
-    case 4:
-      {
-        guint a = p1[3] + p2[3];
+  scale_filter_free (&pass.x);
+  scale_filter_free (&pass.y);
 
-        switch (a)
-          {
-          case 0:    /* all transparent */
-            p[0] = p[1] = p[2] = p[3] = 0;
-            break;
-
-          case 510: /* all opaque */
-            p[0] = (p1[0] + p2[0] + 1) >> 1;
-            p[1] = (p1[1] + p2[1] + 1) >> 1;
-            p[2] = (p1[2] + p2[2] + 1) >> 1;
-            p[3] = 255;
-            break;
-
-          default:
-            p[0] = ((p1[0] * p1[3] +
-                     p2[0] * p2[3] + (a >> 1)) / a);
-            p[1] = ((p1[1] * p1[3] +
-                     p2[1] * p2[3] + (a >> 1)) / a);
-            p[2] = ((p1[2] * p1[3] +
-                     p2[2] * p2[3] + (a >> 1)) / a);
-            p[3] = (a + 1) >> 1;
-            break;
-          }
-      }
-      break;
-    }
+  g_free (kernel_lookup);
 }
 
+/*  Halves the width and/or height of srcTM, whichever dstTM has,
+ *  averaging the pixels weighted by their alpha.
+ */
 static void
-decimate_average_xy (PixelSurround *surround,
-                     const gint     x0,
-                     const gint     y0,
-                     const gint     bytes,
-                     guchar        *pixel)
+decimate (TileManager      *srcTM,
+          TileManager      *dstTM,
+          GimpProgressFunc  progress_callback,
+          gpointer          progress_data,
+          gint             *progress,
+          gint              max_progress)
 {
-  gint          stride;
-  const guchar *src = pixel_surround_lock (surround, x0, y0, &stride);
+  ScalePass  pass;
+  const gint bytes = tile_manager_bpp (dstTM);
 
-  pixel_average4 (src, src + bytes, src + stride, src + stride + bytes,
-                  pixel, bytes);
-}
-
-static void
-decimate_average_x (PixelSurround *surround,
-                    const gint     x0,
-                    const gint     y0,
-                    const gint     bytes,
-                    guchar        *pixel)
-{
-  gint          stride;
-  const guchar *src = pixel_surround_lock (surround, x0, y0, &stride);
+  scale_filter_init_decimate (&pass.x,
+                              tile_manager_width (srcTM),
+                              tile_manager_width (dstTM));
+  scale_filter_init_decimate (&pass.y,
+                              tile_manager_height (srcTM),
+                              tile_manager_height (dstTM));
 
-  pixel_average2 (src, src + bytes, pixel, bytes);
-}
+  pass.premultiply = (bytes == 2 || bytes == 4);
 
-static void
-decimate_average_y (PixelSurround *surround,
-                    const gint     x0,
-                    const gint     y0,
-                    const gint     bytes,
-                    guchar        *pixel)
-{
-  gint          stride;
-  const guchar *src = pixel_surround_lock (surround, x0, y0, &stride);
+  scale_pass (srcTM, dstTM, &pass,
+              progress_callback, progress_data, progress, max_progress);
 
-  pixel_average2 (src, src + stride, pixel, bytes);
+  scale_filter_free (&pass.x);
+  scale_filter_free (&pass.y);
 }
 
 static inline gdouble
@@ -918,42 +755,6 @@ create_lanczos_lookup (void)
   return lookup;
 }
 
-static gfloat *
-create_lanczos3_lookup (void)
-{
-  const gdouble dx = LANCZOS_MIN;
-
-  gfloat  *lookup = g_new (gfloat, LANCZOS_SAMPLES);
-  gdouble  x      = 0.0;
-  gint     i;
-
-  for (i = 0; i < LANCZOS_SAMPLES; i++)
-    {
-      lookup[i] = ((ABS (x) < 3.0) ?
-                   (sinc (x) * sinc (x / 3.0)) : 0.0);
-      x += dx;
-    }
-
-  return lookup;
-}
-
-static void
-interpolate_nearest (TileManager   *srcTM,
-                     const gint     x0,
-                     const gint     y0,
-                     const gdouble  xfrac,
-                     const gdouble  yfrac,
-                     guchar        *pixel)
-{
-  const gint w = tile_manager_width (srcTM) - 1;
-  const gint h = tile_manager_height (srcTM) - 1;
-  const gint x = (xfrac <= 0.5) ? x0 : x0 + 1;
-  const gint y = (yfrac <= 0.5) ? y0 : y0 + 1;
-
-  tile_manager_read_pixel_data_1 (srcTM, CLAMP (x, 0, w), CLAMP (y, 0, h),
-                                  pixel);
-}
-
 static inline gdouble
 weighted_sum (const gdouble dx,
               const gdouble dy,
@@ -966,86 +767,6 @@ weighted_sum (const gdouble dx,
           ((1 - dx) * s00 + dx * s10) + dy * ((1 - dx) * s01 + dx * s11));
 }
 
-static void
-interpolate_bilinear (PixelSurround *surround,
-                      const gint     x0,
-                      const gint     y0,
-                      const gdouble  xfrac,
-                      const gdouble  yfrac,
-                      const gint     bytes,
-                      guchar        *pixel)
-{
-  gint          stride;
-  const guchar *src = pixel_surround_lock (surround, x0, y0, &stride);
-  const guchar *p1  = src;
-  const guchar *p2  = p1 + bytes;
-  const guchar *p3  = src + stride;
-  const guchar *p4  = p3 + bytes;
-  gdouble       sum;
-  gdouble       alphasum;
-  gint          b;
-
-  switch (bytes)
-    {
-    case 1:
-      sum = RINT (weighted_sum (xfrac, yfrac, p1[0], p2[0], p3[0], p4[0]));
-
-      pixel[0] = CLAMP (sum, 0, 255);
-      break;
-
-    case 2:
-      alphasum = weighted_sum (xfrac, yfrac, p1[1], p2[1], p3[1], p4[1]);
-      if (alphasum > 0)
-        {
-          sum = weighted_sum (xfrac, yfrac,
-                              p1[0] * p1[1], p2[0] * p2[1],
-                              p3[0] * p3[1], p4[0] * p4[1]);
-          sum = RINT (sum / alphasum);
-          alphasum = RINT (alphasum);
-
-          pixel[0] = CLAMP (sum, 0, 255);
-          pixel[1] = CLAMP (alphasum, 0, 255);
-        }
-      else
-        {
-          pixel[0] = pixel[1] = 0;
-        }
-      break;
-
-    case 3:
-      for (b = 0; b < 3; b++)
-        {
-          sum = RINT (weighted_sum (xfrac, yfrac, p1[b], p2[b], p3[b], p4[b]));
-
-          pixel[b] = CLAMP (sum, 0, 255);
-        }
-      break;
-
-    case 4:
-      alphasum = weighted_sum (xfrac, yfrac, p1[3], p2[3], p3[3], p4[3]);
-      if (alphasum > 0)
-        {
-          for (b = 0; b < 3; b++)
-            {
-              sum = weighted_sum (xfrac, yfrac,
-                                  p1[b] * p1[3], p2[b] * p2[3],
-                                  p3[b] * p3[3], p4[b] * p4[3]);
-              sum = RINT (sum / alphasum);
-
-              pixel[b] = CLAMP (sum, 0, 255);
-            }
-
-          alphasum = RINT (alphasum);
-          pixel[3] = CLAMP (alphasum, 0, 255);
-        }
-      else
-        {
-          pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
-        }
-      break;
-    }
-}
-
 /* Catmull-Rom spline - not bad
   * basic intro http://www.mvps.org/directx/articles/catmull/
   * This formula will calculate an interpolated point between pt1 and pt2
@@ -1064,283 +785,6 @@ cubic_spline_fit (const gdouble  dx,
                      ( -pt0 + pt2 ) ) * dx + (pt1 + pt1) ) / 2.0;
 }
 
-static void
-interpolate_cubic (PixelSurround *surround,
-                   const gint     x0,
-                   const gint     y0,
-                   const gdouble  xfrac,
-                   const gdouble  yfrac,
-                   const gint     bytes,
-                   guchar        *pixel)
-{
-  gint          stride;
-  const guchar *src = pixel_surround_lock (surround, x0 - 1, y0 - 1, &stride);
-  const guchar *s0  = src;
-  const guchar *s1  = s0 + stride;
-  const guchar *s2  = s1 + stride;
-  const guchar *s3  = s2 + stride;
-  gint          b;
-  gdouble       p0, p1, p2, p3;
-  gdouble       sum, alphasum;
-
-  switch (bytes)
-    {
-    case 1:
-      p0 = cubic_spline_fit (xfrac, s0[0], s0[1], s0[2], s0[3]);
-      p1 = cubic_spline_fit (xfrac, s1[0], s1[1], s1[2], s1[3]);
-      p2 = cubic_spline_fit (xfrac, s2[0], s2[1], s2[2], s2[3]);
-      p3 = cubic_spline_fit (xfrac, s3[0], s3[1], s3[2], s3[3]);
-
-      sum = RINT (cubic_spline_fit (yfrac, p0, p1, p2, p3));
-
-      pixel[0]= CLAMP (sum, 0, 255);
-      break;
-
-    case 2:
-      p0 = cubic_spline_fit (xfrac, s0[1], s0[3], s0[5], s0[7]);
-      p1 = cubic_spline_fit (xfrac, s1[1], s1[3], s1[5], s1[7]);
-      p2 = cubic_spline_fit (xfrac, s2[1], s2[3], s2[5], s2[7]);
-      p3 = cubic_spline_fit (xfrac, s3[1], s3[3], s3[5], s3[7]);
-
-      alphasum = cubic_spline_fit (yfrac, p0, p1, p2, p3);
-
-      if (alphasum > 0)
-        {
-          p0 = cubic_spline_fit (xfrac,
-                                 s0[0] * s0[1], s0[2] * s0[3],
-                                 s0[4] * s0[5], s0[6] * s0[7]);
-          p1 = cubic_spline_fit (xfrac,
-                                 s1[0] * s1[1], s1[2] * s1[3],
-                                 s1[4] * s1[5], s1[6] * s1[7]);
-          p2 = cubic_spline_fit (xfrac,
-                                 s2[0] * s2[1], s2[2] * s2[3],
-                                 s2[4] * s2[5], s2[6] * s2[7]);
-          p3 = cubic_spline_fit (xfrac,
-                                 s3[0] * s3[1], s3[2] * s3[3],
-                                 s3[4] * s3[5], s3[6] * s3[7]);
-
-          sum = cubic_spline_fit (yfrac, p0, p1, p2, p3);
-          sum = RINT (sum / alphasum);
-          pixel[0] = CLAMP (sum, 0, 255);
-
-          alphasum = RINT (alphasum);
-          pixel[1] = CLAMP (alphasum, 0, 255);
-        }
-      else
-        {
-          pixel[0] = pixel[1] = 0;
-        }
-      break;
-
-    case 3:
-      for (b = 0; b < 3; b++)
-        {
-          p0 = cubic_spline_fit (xfrac, s0[b], s0[3 + b], s0[6 + b], s0[9 + b]);
-          p1 = cubic_spline_fit (xfrac, s1[b], s1[3 + b], s1[6 + b], s1[9 + b]);
-          p2 = cubic_spline_fit (xfrac, s2[b], s2[3 + b], s2[6 + b], s2[9 + b]);
-          p3 = cubic_spline_fit (xfrac, s3[b], s3[3 + b], s3[6 + b], s3[9 + b]);
-
-          sum = RINT (cubic_spline_fit (yfrac, p0, p1, p2, p3));
-
-          pixel[b] = CLAMP (sum, 0, 255);
-        }
-      break;
-
-    case 4:
-      p0 = cubic_spline_fit (xfrac, s0[3], s0[7], s0[11], s0[15]);
-      p1 = cubic_spline_fit (xfrac, s1[3], s1[7], s1[11], s1[15]);
-      p2 = cubic_spline_fit (xfrac, s2[3], s2[7], s2[11], s2[15]);
-      p3 = cubic_spline_fit (xfrac, s3[3], s3[7], s3[11], s3[15]);
-
-      alphasum = cubic_spline_fit (yfrac, p0, p1, p2, p3);
-
-      if (alphasum > 0)
-        {
-          for (b = 0; b < 3; b++)
-            {
-              p0 = cubic_spline_fit (xfrac,
-                                     s0[0 + b] * s0[ 3], s0[ 4 + b] * s0[7],
-                                     s0[8 + b] * s0[11], s0[12 + b] * s0[15]);
-              p1 = cubic_spline_fit (xfrac,
-                                     s1[0 + b] * s1[ 3], s1[ 4 + b] * s1[7],
-                                     s1[8 + b] * s1[11], s1[12 + b] * s1[15]);
-              p2 = cubic_spline_fit (xfrac,
-                                     s2[0 + b] * s2[ 3], s2[ 4 + b] * s2[7],
-                                     s2[8 + b] * s2[11], s2[12 + b] * s2[15]);
-              p3 = cubic_spline_fit (xfrac,
-                                     s3[0 + b] * s3[ 3], s3[ 4 + b] * s3[7],
-                                     s3[8 + b] * s3[11], s3[12 + b] * s3[15]);
-
-              sum = cubic_spline_fit (yfrac, p0, p1, p2, p3);
-              sum = RINT (sum / alphasum);
-
-              pixel[b] = CLAMP (sum, 0, 255);
-            }
-
-          alphasum = RINT (alphasum);
-          pixel[3] = CLAMP (alphasum, 0, 255);
-        }
-      else
-        {
-          pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
-        }
-      break;
-    }
-}
-
-static gdouble inline
-lanczos3_mul_alpha (const guchar  *pixels,
-                    const gdouble *x_kernel,
-                    const gdouble *y_kernel,
-                    const gint     stride,
-                    const gint     bytes,
-                    const gint     byte)
-{
-  const guchar *row   = pixels;
-  const guchar  alpha = bytes - 1;
-  gdouble       sum   = 0.0;
-  gint          x, y;
-
-  for (y = 0; y < 6; y++, row += stride)
-    {
-      const guchar *p      = row;
-      gdouble       tmpsum = 0.0;
-
-      for (x = 0; x < 6; x++, p += bytes)
-        {
-          tmpsum += x_kernel[x] * p[byte] * p[alpha];
-        }
-
-      tmpsum *= y_kernel[y];
-      sum    += tmpsum;
-    }
-
-  return sum;
-}
-
-static gdouble inline
-lanczos3_mul (const guchar  *pixels,
-              const gdouble *x_kernel,
-              const gdouble *y_kernel,
-              const gint     stride,
-              const gint     bytes,
-              const gint     byte)
-{
-  const guchar *row = pixels;
-  gdouble       sum = 0.0;
-  gint          x, y;
-
-  for (y = 0; y < 6; y++, row += stride)
-    {
-      const guchar *p = row;
-      gdouble       tmpsum = 0.0;
-
-      for (x = 0; x < 6; x++, p += bytes)
-        {
-          tmpsum += x_kernel[x] * p[byte];
-        }
-
-      tmpsum *= y_kernel[y];
-      sum    += tmpsum;
-    }
-
-  return sum;
-}
-
-static void
-interpolate_lanczos3 (PixelSurround *surround,
-                      const gint     x0,
-                      const gint     y0,
-                      const gdouble  xfrac,
-                      const gdouble  yfrac,
-                      const gint     bytes,
-                      guchar        *pixel,
-                      const gfloat  *kernel_lookup)
-{
-  gint          stride;
-  const guchar *src = pixel_surround_lock (surround, x0 - 2, y0 - 2, &stride);
-  const gint    x_shift    = (gint) (xfrac * LANCZOS_SPP + 0.5);
-  const gint    y_shift    = (gint) (yfrac * LANCZOS_SPP + 0.5);
-  gint          b, i;
-  gdouble       kx_sum, ky_sum;
-  gdouble       x_kernel[6];
-  gdouble       y_kernel[6];
-  gdouble       sum, alphasum;
-
-  kx_sum  = ky_sum = 0.0;
-
-  for (i = 3; i >= -2; i--)
-    {
-      gint pos = i * LANCZOS_SPP;
-
-      kx_sum += x_kernel[2 + i] = kernel_lookup[ABS (x_shift - pos)];
-      ky_sum += y_kernel[2 + i] = kernel_lookup[ABS (y_shift - pos)];
-    }
-
-  /* normalise the kernel arrays */
-  for (i = -2; i <= 3; i++)
-    {
-      x_kernel[2 + i] /= kx_sum;
-      y_kernel[2 + i] /= ky_sum;
-    }
-
-  switch (bytes)
-    {
-    case 1:
-      sum = RINT (lanczos3_mul (src, x_kernel, y_kernel, stride, 1, 0));
-
-      pixel[0] = CLAMP (sum, 0, 255);
-      break;
-
-    case 2:
-      alphasum  = lanczos3_mul (src, x_kernel, y_kernel, stride, 2, 1);
-      if (alphasum > 0)
-        {
-          sum = lanczos3_mul_alpha (src, x_kernel, y_kernel, stride, 2, 0);
-          sum = RINT (sum / alphasum);
-          pixel[0] = CLAMP (sum, 0, 255);
-
-          alphasum = RINT (alphasum);
-          pixel[1] = CLAMP (alphasum, 0, 255);
-        }
-      else
-        {
-          pixel[0] = pixel[1] = 0;
-        }
-      break;
-
-    case 3:
-      for (b = 0; b < 3; b++)
-        {
-          sum = RINT (lanczos3_mul (src, x_kernel, y_kernel, stride, 3, b));
-
-          pixel[b] = CLAMP (sum, 0, 255);
-        }
-      break;
-
-    case 4:
-      alphasum = lanczos3_mul (src, x_kernel, y_kernel, stride, 4, 3);
-      if (alphasum > 0)
-        {
-          for (b = 0; b < 3; b++)
-            {
-              sum = lanczos3_mul_alpha (src, x_kernel, y_kernel, stride, 4, b);
-              sum = RINT (sum / alphasum);
-
-              pixel[b] = CLAMP (sum, 0, 255);
-            }
-
-          alphasum = RINT (alphasum);
-          pixel[3] = CLAMP (alphasum, 0, 255);
-        }
-      else
-        {
-          pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
-        }
-      break;
-    }
-}
-
 static void
 scale_region_buffer (PixelRegion *srcPR,
                      PixelRegion *dstPR)
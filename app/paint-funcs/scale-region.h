@@ -26,6 +26,28 @@
 #define LANCZOS_SAMPLES  (LANCZOS_SPP * (LANCZOS_WIDTH + 1))
 
 
+/*  The filter along one axis: for each output pixel, the source
+ *  pixels it is computed from and their weights.
+ */
+typedef struct
+{
+  gint    n_taps;
+  gint   *index;
+  gfloat *weight;
+} ScaleFilter;
+
+typedef struct
+{
+  ScaleFilter   x;
+  ScaleFilter   y;
+  gint          bytes;
+  gboolean      premultiply;  /* weight the color channels by alpha     */
+  const guchar *src;          /* the source rows needed for this band   */
+  gint          src_width;
+  gint          src_y;        /* the row of the image src starts at     */
+} ScalePass;
+
+
 void     scale_region          (PixelRegion           *srcPR,
                                 PixelRegion           *destPR,
                                 GimpInterpolationType  interpolation,
@@ -34,6 +56,22 @@ void     scale_region          (PixelRegion           *srcPR,
 
 gfloat * create_lanczos_lookup (void);
 
+/*  The filters and the pass of the separable resampler, only public
+ *  for the tests.
+ */
+void     scale_filter_init          (ScaleFilter           *filter,
+                                     gint                   src_size,
+                                     gint                   dst_size,
+                                     GimpInterpolationType  interpolation,
+                                     const gfloat          *kernel_lookup);
+void     scale_filter_init_decimate (ScaleFilter           *filter,
+                                     gint                   src_size,
+                                     gint                   dst_size);
+void     scale_filter_free          (ScaleFilter           *filter);
+
+void     scale_pass_region          (ScalePass             *pass,
+                                     PixelRegion           *destPR);
+
 
 #endif  /*  __SCALE_REGION_H__  */
 
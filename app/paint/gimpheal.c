@@ -17,8 +17,6 @@
 
 #include "config.h"
 
-#include <string.h>
-
 #include <gegl.h>
 
 #include "libgimpbase/gimpbase.h"
@@ -27,6 +25,7 @@
 #include "paint-types.h"
 
 #include "paint-funcs/paint-funcs.h"
+#include "paint-funcs/heal-region.h"
 
 #include "base/pixel-region.h"
 #include "base/temp-buf.h"
@@ -53,13 +52,14 @@
  * but substract them I2 = I0 - I1, where I0 is the sample image to be
  * corrected, I1 is the reference pattern. Then we solve DeltaI=0
  * (Laplace) with I2 Dirichlet conditions at the borders of the
- * mask. The solver is a unoptimized red/black checker Gauss-Siedel
- * with an over-relaxation factor of 1.8. It can benefit from a
- * multi-grid evaluation of an initial solution before the main
- * iteration loop.
+ * mask. The solver lives in paint-funcs/heal-region.c, it is a
+ * multigrid solver built around red/black checker Gauss-Siedel
+ * relaxation.
  *
- * I reduced the convergence criteria to 0.1% (0.001) as we are
- * dealing here with RGB integer components, more is overkill.
+ * Original Algorithm Design:
+ *
+ * T. Georgiev, "Photoshop Healing Brush: a Tool for Seamless Cloning
+ * http://www.tgeorgiev.net/Photoshop_Healing.pdf
  *
  * Jean-Yves Couleaud cjyves@free.fr
  */
@@ -70,35 +70,6 @@ static gboolean     gimp_heal_start              (GimpPaintCore    *paint_core,
                                                   const GimpCoords *coords,
                                                   GError          **error);
 
-static void         gimp_heal_sub                (PixelRegion      *topPR,
-                                                  PixelRegion      *bottomPR,
-                                                  gdouble          *result);
-
-static void         gimp_heal_add                (gdouble          *first,
-                                                  PixelRegion      *secondPR,
-                                                  PixelRegion      *resultPR);
-
-static gdouble      gimp_heal_laplace_iteration  (gdouble          *matrix,
-                                                  gint              height,
-                                                  gint              depth,
-                                                  gint              width,
-                                                  gdouble          *solution,
-                                                  guchar           *mask,
-                                                  gint              mask_stride,
-                                                  gint              mask_offx,
-                                                  gint              mask_offy);
-
-static void         gimp_heal_laplace_loop       (gdouble          *matrix,
-                                                  gint              height,
-                                                  gint              depth,
-                                                  gint              width,
-                                                  gdouble          *solution,
-                                                  PixelRegion      *maskPR);
-
-static PixelRegion *gimp_heal_region             (PixelRegion      *tempPR,
-                                                  PixelRegion      *srcPR,
-                                                  PixelRegion      *maskPR);
-
 static void         gimp_heal_motion             (GimpSourceCore   *source_core,
                                                   GimpDrawable     *drawable,
                                                   GimpPaintOptions *paint_options,
@@ -174,271 +145,6 @@ gimp_heal_start (GimpPaintCore     *paint_core,
   return TRUE;
 }
 
-/* Subtract bottomPR from topPR and store the result as a double
- */
-static void
-gimp_heal_sub (PixelRegion *topPR,
-               PixelRegion *bottomPR,
-               gdouble     *result)
-{
-  gint     i, j, k;
-
-  gint     height = topPR->h;
-  gint     width  = topPR->w;
-  gint     depth  = topPR->bytes;
-
-  guchar  *t_data = topPR->data;
-  guchar  *b_data = bottomPR->data;
-
-  guchar  *t;
-  guchar  *b;
-  gdouble *r      = result;
-
-  g_assert (topPR->bytes == bottomPR->bytes);
-
-  for (i = 0; i < height; i++)
-    {
-      t = t_data;
-      b = b_data;
-
-      for (j = 0; j < width; j++)
-        {
-          for (k = 0; k < depth; k++)
-            {
-              r[k] = (gdouble) (t[k]) - (gdouble) (b[k]);
-            }
-          t += depth;
-          b += depth;
-          r += depth;
-        }
-
-      t_data += topPR->rowstride;
-      b_data += bottomPR->rowstride;
-    }
-}
-
-/* Add first to secondPR and store the result as a PixelRegion
- */
-static void
-gimp_heal_add (gdouble     *first,
-               PixelRegion *secondPR,
-               PixelRegion *resultPR)
-{
-  gint     i, j, k;
-
-  gint     height = secondPR->h;
-  gint     width  = secondPR->w;
-  gint     depth  = secondPR->bytes;
-
-  guchar  *s_data = secondPR->data;
-  guchar  *r_data = resultPR->data;
-
-  gdouble *f      = first;
-  guchar  *s;
-  guchar  *r;
-
-  g_assert (secondPR->bytes == resultPR->bytes);
-
-  for (i = 0; i < height; i++)
-    {
-      s = s_data;
-      r = r_data;
-
-      for (j = 0; j < width; j++)
-        {
-          for (k = 0; k < depth; k++)
-            {
-              r[k] = (guchar) CLAMP0255 (ROUND (((gdouble) (f[k])) +
-                                                ((gdouble) (s[k]))));
-            }
-
-          f += depth;
-          s += depth;
-          r += depth;
-        }
-
-      s_data += secondPR->rowstride;
-      r_data += resultPR->rowstride;
-    }
-}
-
-/* Perform one iteration of the laplace solver for matrix.  Store the
- * result in solution and return the square of the cummulative error
- * of the solution.
- */
-static gdouble
-gimp_heal_laplace_iteration (gdouble *matrix,
-                             gint     height,
-                             gint     depth,
-                             gint     width,
-                             gdouble *solution,
-                             guchar  *mask,
-                             gint     mask_stride,
-                             gint     mask_offx,
-                             gint     mask_offy)
-{
-  const gint    rowstride = width * depth;
-  gint          i, j, k, off, offm, offm0, off0;
-  gdouble       tmp, diff;
-  gdouble       err       = 0.0;
-  const gdouble w         = 1.80 * 0.25; /* Over-relaxation = 1.8 */
-
-  /* we use a red/black checker model of the discretization grid */
-
-  /* do reds */
-  for (i = 0; i < height; i++)
-    {
-      off0  = i * rowstride;
-      offm0 = (i + mask_offy) * mask_stride;
-
-      for (j = i % 2; j < width; j += 2)
-        {
-          off  = off0 + j * depth;
-          offm = offm0 + j + mask_offx;
-
-          if ((0 == mask[offm]) ||
-              (i == 0) || (i == (height - 1)) ||
-              (j == 0) || (j == (width - 1)))
-            {
-              /* do nothing at the boundary or outside mask */
-              for (k = 0; k < depth; k++)
-                solution[off + k] = matrix[off + k];
-            }
-          else
-            {
-              /* Use Gauss Siedel to get the correction factor then
-               * over-relax it
-               */
-              for (k = 0; k < depth; k++)
-                {
-                  tmp = solution[off + k];
-                  solution[off + k] = (matrix[off + k] +
-                                       w *
-                                       (matrix[off - depth + k] +     /* west */
-                                        matrix[off + depth + k] +     /* east */
-                                        matrix[off - rowstride + k] + /* north */
-                                        matrix[off + rowstride + k] - 4.0 *
-                                        matrix[off+k]));              /* south */
-
-                  diff = solution[off + k] - tmp;
-                  err += diff * diff;
-                }
-            }
-        }
-    }
-
-
-  /* Do blacks
-   *
-   * As we've done the reds earlier, we can use them right now to
-   * accelerate the convergence. So we have "solution" in the solver
-   * instead of "matrix" above
-   */
-  for (i = 0; i < height; i++)
-    {
-      off0  = i * rowstride;
-      offm0 = (i + mask_offy) * mask_stride;
-
-      for (j = (i % 2) ? 0 : 1; j < width; j += 2)
-        {
-          off = off0 + j * depth;
-          offm = offm0 + j + mask_offx;
-
-          if ((0 == mask[offm]) ||
-              (i == 0) || (i == (height - 1)) ||
-              (j == 0) || (j == (width - 1)))
-            {
-              /* do nothing at the boundary or outside mask */
-              for (k = 0; k < depth; k++)
-                solution[off + k] = matrix[off + k];
-            }
-          else
-            {
-              /* Use Gauss Siedel to get the correction factor then
-               * over-relax it
-               */
-              for (k = 0; k < depth; k++)
-                {
-                  tmp = solution[off + k];
-                  solution[off + k] = (matrix[off + k] +
-                                       w *
-                                       (solution[off - depth + k] +     /* west */
-                                        solution[off + depth + k] +     /* east */
-                                        solution[off - rowstride + k] + /* north */
-                                        solution[off + rowstride + k] - 4.0 *
-                                        matrix[off+k]));                /* south */
-
-                  diff = solution[off + k] - tmp;
-                  err += diff*diff;
-                }
-            }
-        }
-    }
-
-  return err;
-}
-
-/* Solve the laplace equation for matrix and store the result in solution.
- */
-static void
-gimp_heal_laplace_loop (gdouble     *matrix,
-                        gint         height,
-                        gint         depth,
-                        gint         width,
-                        gdouble     *solution,
-                        PixelRegion *maskPR)
-{
-#define EPSILON   0.001
-#define MAX_ITER  500
-  gint i;
-
-  /* repeat until convergence or max iterations */
-  for (i = 0; i < MAX_ITER; i++)
-    {
-      gdouble sqr_err;
-
-      /* do one iteration and store the amount of error */
-      sqr_err = gimp_heal_laplace_iteration (matrix, height, depth, width,
-                                             solution, maskPR->data, maskPR->rowstride,
-                                             maskPR->x, maskPR->y);
-
-      /* copy solution to matrix */
-      memcpy (matrix, solution, width * height * depth * sizeof (double));
-
-      if (sqr_err < EPSILON)
-        break;
-    }
-}
-
-/* Original Algorithm Design:
- *
- * T. Georgiev, "Photoshop Healing Brush: a Tool for Seamless Cloning
- * http://www.tgeorgiev.net/Photoshop_Healing.pdf
- */
-static PixelRegion *
-gimp_heal_region (PixelRegion   *tempPR,
-                  PixelRegion   *srcPR,
-                  PixelRegion   *maskPR)
-{
-  gdouble *i_1  = g_new (gdouble, tempPR->h * tempPR->bytes * tempPR->w);
-  gdouble *i_2  = g_new (gdouble, tempPR->h * tempPR->bytes * tempPR->w);
-
-  /* substract pattern to image and store the result as a double in i_1 */
-  gimp_heal_sub (tempPR, srcPR, i_1);
-
-  /* FIXME: is a faster implementation needed? */
-  gimp_heal_laplace_loop (i_1, tempPR->h, tempPR->bytes, tempPR->w, i_2, maskPR);
-
-  /* add solution to original image and store in tempPR */
-  gimp_heal_add (i_2, srcPR, tempPR);
-
-  /* clean up */
-  g_free (i_1);
-  g_free (i_2);
-
-  return tempPR;
-}
-
 static void
 gimp_heal_motion (GimpSourceCore   *source_core,
                   GimpDrawable     *drawable,
@@ -589,7 +295,7 @@ gimp_heal_motion (GimpSourceCore   *source_core,
   }
 
   /* heal tempPR using srcPR */
-  gimp_heal_region (&tempPR, srcPR, &maskPR);
+  heal_region (&tempPR, srcPR, &maskPR);
 
   temp_buf_free (src);
 
@@ -43,6 +43,7 @@
 #include "gimpplugin.h"
 #include "gimpplugin-cleanup.h"
 #include "gimpplugin-message.h"
+#include "gimpplugin-tilemap.h"
 #include "gimppluginmanager.h"
 #include "gimpplugindef.h"
 #include "gimppluginshm.h"
@@ -61,6 +62,18 @@ static void gimp_plug_in_handle_tile_put         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
 static void gimp_plug_in_handle_tile_get         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
+static void gimp_plug_in_handle_tile_map         (GimpPlugIn      *plug_in,
+                                                  GPTileMap       *request);
+static void gimp_plug_in_handle_tile_unmap       (GimpPlugIn      *plug_in,
+                                                  GPTileUnmap     *request);
+static void gimp_plug_in_handle_tiles_request    (GimpPlugIn      *plug_in,
+                                                  GPTilesReq      *request);
+static void gimp_plug_in_handle_tiles_data       (GimpPlugIn      *plug_in,
+                                                  GPTilesData     *tiles_data);
+static TileManager * gimp_plug_in_get_tiles      (GimpPlugIn      *plug_in,
+                                                  gint32           drawable_ID,
+                                                  gboolean         shadow,
+                                                  gboolean         writing);
 static void gimp_plug_in_handle_proc_run         (GimpPlugIn      *plug_in,
                                                   GPProcRun       *proc_run);
 static void gimp_plug_in_handle_proc_return      (GimpPlugIn      *plug_in,
@@ -73,6 +86,7 @@ static void gimp_plug_in_handle_proc_uninstall   (GimpPlugIn      *plug_in,
                                                   GPProcUninstall *proc_uninstall);
 static void gimp_plug_in_handle_extension_ack    (GimpPlugIn      *plug_in);
 static void gimp_plug_in_handle_has_init         (GimpPlugIn      *plug_in);
+static void gimp_plug_in_handle_resident         (GimpPlugIn      *plug_in);
 
 
 /*  public functions  */
@@ -158,6 +172,26 @@ gimp_plug_in_handle_message (GimpPlugIn      *plug_in,
     case GP_HAS_INIT:
       gimp_plug_in_handle_has_init (plug_in);
       break;
+
+    case GP_TILE_MAP:
+      gimp_plug_in_handle_tile_map (plug_in, msg->data);
+      break;
+
+    case GP_TILE_UNMAP:
+      gimp_plug_in_handle_tile_unmap (plug_in, msg->data);
+      break;
+
+    case GP_TILES_REQ:
+      gimp_plug_in_handle_tiles_request (plug_in, msg->data);
+      break;
+
+    case GP_TILES_DATA:
+      gimp_plug_in_handle_tiles_data (plug_in, msg->data);
+      break;
+
+    case GP_RESIDENT:
+      gimp_plug_in_handle_resident (plug_in);
+      break;
     }
 }
 
@@ -433,6 +467,403 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
   gimp_wire_destroy (&msg);
 }
 
+static void
+gimp_plug_in_handle_tile_map (GimpPlugIn *plug_in,
+                              GPTileMap  *request)
+{
+  GPTileMap      tile_map;
+  GimpDrawable  *drawable;
+  GimpPlugInShm *shm;
+
+  drawable = (GimpDrawable *) gimp_item_get_by_ID (plug_in->manager->gimp,
+                                                   request->drawable_ID);
+
+  if (! GIMP_IS_DRAWABLE (drawable))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried mapping invalid drawable %d (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    request->drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+  else if (gimp_item_is_removed (GIMP_ITEM (drawable)))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried mapping drawable %d which was removed "
+                    "from the image (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    request->drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  /*  a plug-in that can't get a mapping falls back on requesting
+   *  tiles one by one, so a failure here is not an error
+   */
+  shm = gimp_plug_in_tile_map_add (plug_in, drawable, request->shadow,
+                                   request->x,     request->y,
+                                   request->width, request->height);
+
+  tile_map.drawable_ID = request->drawable_ID;
+  tile_map.shadow      = request->shadow;
+  tile_map.x           = request->x;
+  tile_map.y           = request->y;
+  tile_map.width       = request->width;
+  tile_map.height      = request->height;
+  tile_map.map_ID      = shm ? gimp_plug_in_shm_get_map_ID (shm) : 0;
+  tile_map.shm_ID      = shm ? gimp_plug_in_shm_get_ID (shm) : -1;
+
+  if (! gp_tile_map_write (plug_in->my_write, &tile_map, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+}
+
+static void
+gimp_plug_in_handle_tile_unmap (GimpPlugIn  *plug_in,
+                                GPTileUnmap *request)
+{
+  GimpDrawable *drawable;
+  gboolean      shadow;
+
+  drawable = gimp_plug_in_tile_map_get_drawable (plug_in, request->map_ID,
+                                                 &shadow);
+
+  if (! drawable)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried unmapping invalid tile map %d (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    request->map_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (request->n_dirty > 0)
+    {
+      if (gimp_item_is_removed (GIMP_ITEM (drawable)))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "tried writing to drawable %d which was removed "
+                        "from the image (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_filename_to_utf8 (plug_in->prog),
+                        gimp_item_get_ID (GIMP_ITEM (drawable)));
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      /*  see gimp_plug_in_handle_tile_put() for why the shadow tiles
+       *  are not checked
+       */
+      if (! shadow &&
+          gimp_item_is_content_locked (GIMP_ITEM (drawable)))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "tried writing to a locked drawable %d (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_filename_to_utf8 (plug_in->prog),
+                        gimp_item_get_ID (GIMP_ITEM (drawable)));
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+      else if (! shadow &&
+               gimp_viewable_get_children (GIMP_VIEWABLE (drawable)))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "tried writing to a group layer %d (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_filename_to_utf8 (plug_in->prog),
+                        gimp_item_get_ID (GIMP_ITEM (drawable)));
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      if (! gimp_plug_in_tile_map_write_back (plug_in, request->map_ID,
+                                              request->dirty_tiles,
+                                              request->n_dirty))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "tried writing invalid tiles to drawable %d, "
+                        "or one which changed its size since it was "
+                        "mapped (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_filename_to_utf8 (plug_in->prog),
+                        gimp_item_get_ID (GIMP_ITEM (drawable)));
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+    }
+
+  if (request->detach)
+    gimp_plug_in_tile_map_remove (plug_in, request->map_ID);
+
+  if (! gp_tile_ack_write (plug_in->my_write, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+}
+
+/*  Unlike a single GP_TILE_REQ, a batch of tiles is sent right away,
+ *  without waiting for the plug-in to acknowledge it: the plug-in
+ *  doesn't send anything else until it copied the tiles.
+ */
+static void
+gimp_plug_in_handle_tiles_request (GimpPlugIn *plug_in,
+                                   GPTilesReq *request)
+{
+  GPTilesData   tiles_data;
+  TileManager  *tm;
+  guchar       *dest;
+  gint          i;
+
+  if (! request)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "requested more than %d tiles at once (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    GP_TILES_MAX);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  tm = gimp_plug_in_get_tiles (plug_in, request->drawable_ID,
+                               request->shadow, FALSE);
+
+  if (! tm)
+    return;
+
+  tiles_data.drawable_ID = request->drawable_ID;
+  tiles_data.shadow      = request->shadow;
+  tiles_data.bpp         = tile_manager_bpp (tm);
+  tiles_data.n_tiles     = request->n_tiles;
+  tiles_data.tile_nums   = request->tile_nums;
+  tiles_data.use_shm     = (plug_in->manager->shm != NULL);
+  tiles_data.length      = 0;
+  tiles_data.data        = NULL;
+
+  if (tiles_data.use_shm)
+    {
+      dest = gimp_plug_in_shm_get_addr (plug_in->manager->shm);
+    }
+  else
+    {
+      tiles_data.data = g_malloc (request->n_tiles *
+                                  TILE_WIDTH * TILE_HEIGHT * tiles_data.bpp);
+      dest = tiles_data.data;
+    }
+
+  for (i = 0; i < request->n_tiles; i++)
+    {
+      Tile *tile = tile_manager_get (tm, request->tile_nums[i], TRUE, FALSE);
+
+      if (! tile)
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "requested invalid tile (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_filename_to_utf8 (plug_in->prog));
+          g_free (tiles_data.data);
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      memcpy (dest + tiles_data.length,
+              tile_data_pointer (tile, 0, 0),
+              tile_size (tile));
+
+      tiles_data.length += tile_size (tile);
+
+      tile_release (tile, FALSE);
+    }
+
+  if (! gp_tiles_data_write (plug_in->my_write, &tiles_data, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      g_free (tiles_data.data);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  g_free (tiles_data.data);
+}
+
+static void
+gimp_plug_in_handle_tiles_data (GimpPlugIn  *plug_in,
+                                GPTilesData *tiles_data)
+{
+  TileManager  *tm;
+  const guchar *src;
+  guint32       offset = 0;
+  gint          i;
+
+  if (! tiles_data)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent more than %d tiles at once (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    GP_TILES_MAX);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  tm = gimp_plug_in_get_tiles (plug_in, tiles_data->drawable_ID,
+                               tiles_data->shadow, TRUE);
+
+  if (! tm)
+    return;
+
+  if (tiles_data->use_shm)
+    src = (plug_in->manager->shm ?
+           gimp_plug_in_shm_get_addr (plug_in->manager->shm) : NULL);
+  else
+    src = tiles_data->data;
+
+  if (! src || tiles_data->bpp != tile_manager_bpp (tm))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent invalid tile data (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  for (i = 0; i < tiles_data->n_tiles; i++)
+    {
+      Tile *tile = tile_manager_get (tm, tiles_data->tile_nums[i], TRUE, TRUE);
+
+      if (! tile || offset + tile_size (tile) > tiles_data->length)
+        {
+          if (tile)
+            tile_release (tile, FALSE);
+
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "sent invalid tile data (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_filename_to_utf8 (plug_in->prog));
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      memcpy (tile_data_pointer (tile, 0, 0),
+              src + offset,
+              tile_size (tile));
+
+      offset += tile_size (tile);
+
+      tile_release (tile, TRUE);
+    }
+
+  if (! gp_tile_ack_write (plug_in->my_write, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+}
+
+/*  Looks up the tiles a plug-in wants to read or write, and closes the
+ *  plug-in if it may not.
+ */
+static TileManager *
+gimp_plug_in_get_tiles (GimpPlugIn *plug_in,
+                        gint32      drawable_ID,
+                        gboolean    shadow,
+                        gboolean    writing)
+{
+  GimpDrawable *drawable;
+  const gchar  *access = writing ? "writing to" : "reading from";
+
+  drawable = (GimpDrawable *) gimp_item_get_by_ID (plug_in->manager->gimp,
+                                                   drawable_ID);
+
+  if (! GIMP_IS_DRAWABLE (drawable))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried %s invalid drawable %d (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    access, drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return NULL;
+    }
+  else if (gimp_item_is_removed (GIMP_ITEM (drawable)))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried %s drawable %d which was removed "
+                    "from the image (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    access, drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return NULL;
+    }
+
+  if (shadow)
+    {
+      /*  see gimp_plug_in_handle_tile_put() for why the shadow tiles
+       *  are not checked
+       */
+      gimp_plug_in_cleanup_add_shadow (plug_in, drawable);
+
+      return gimp_drawable_get_shadow_tiles (drawable);
+    }
+
+  if (writing && gimp_item_is_content_locked (GIMP_ITEM (drawable)))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried writing to a locked drawable %d (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return NULL;
+    }
+  else if (writing && gimp_viewable_get_children (GIMP_VIEWABLE (drawable)))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried writing to a group layer %d (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return NULL;
+    }
+
+  return gimp_drawable_get_tiles (drawable);
+}
+
 static void
 gimp_plug_in_handle_proc_error (GimpPlugIn          *plug_in,
                                 GimpPlugInProcFrame *proc_frame,
@@ -630,7 +1061,13 @@ gimp_plug_in_handle_proc_return (GimpPlugIn   *plug_in,
                                                    proc_frame->return_vals);
     }
 
-  gimp_plug_in_close (plug_in, FALSE);
+  /*  a resident plug-in is handed to the plug-in manager once the
+   *  return values are consumed, which is here if nobody waits for them
+   */
+  if (! plug_in->resident)
+    gimp_plug_in_close (plug_in, FALSE);
+  else if (! proc_frame->main_loop)
+    gimp_plug_in_manager_add_resident_plug_in (plug_in->manager, plug_in);
 }
 
 static void
@@ -926,3 +1363,22 @@ gimp_plug_in_handle_has_init (GimpPlugIn *plug_in)
       gimp_plug_in_close (plug_in, TRUE);
     }
 }
+
+static void
+gimp_plug_in_handle_resident (GimpPlugIn *plug_in)
+{
+  if (plug_in->call_mode == GIMP_PLUG_IN_CALL_RUN)
+    {
+      plug_in->resident = TRUE;
+    }
+  else
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent a RESIDENT message while not in run().  "
+                    "This should not happen.",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_plug_in_close (plug_in, TRUE);
+    }
+}
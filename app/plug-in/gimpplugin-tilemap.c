@@ -0,0 +1,368 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpplugin-tilemap.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A plug-in can map the tiles of a drawable, or of its shadow, that
+ * cover a rectangle into a shared memory segment of its own and work
+ * on the pixels in place, instead of requesting and sending back every
+ * tile on its own.  The tiles are stored one after the other, in the
+ * order of their tile numbers, each with a rowstride of its effective
+ * width, which is the layout of the GimpTile data on the plug-in side.
+ * The segment is filled when it is mapped, so only the tiles the
+ * plug-in is going to work on are copied, and the tiles the plug-in
+ * changed are copied back to the drawable when it says so.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "plug-in-types.h"
+
+#include "base/tile.h"
+#include "base/tile-manager.h"
+
+#include "core/gimpdrawable.h"
+#include "core/gimpdrawable-shadow.h"
+
+#include "gimpplugin.h"
+#include "gimpplugin-cleanup.h"
+#include "gimpplugin-tilemap.h"
+#include "gimppluginshm.h"
+
+#include "gimp-log.h"
+
+
+typedef struct _GimpPlugInTileMap GimpPlugInTileMap;
+
+struct _GimpPlugInTileMap
+{
+  GimpDrawable  *drawable;
+  gboolean       shadow;
+
+  gint           width;
+  gint           height;
+  gint           bpp;
+
+  /*  the mapped range of tiles  */
+  gint           col;
+  gint           row;
+  gint           n_cols;
+  gint           n_rows;
+
+  GimpPlugInShm *shm;
+};
+
+
+/*  local function prototypes  */
+
+static GimpPlugInTileMap * gimp_plug_in_tile_map_find  (GimpPlugIn        *plug_in,
+                                                        gint               map_ID);
+static TileManager       * gimp_plug_in_tile_map_tiles (GimpPlugInTileMap *map);
+static gboolean            gimp_plug_in_tile_map_contains
+                                                       (GimpPlugInTileMap *map,
+                                                        guint32            tile_num);
+static guchar            * gimp_plug_in_tile_map_addr  (GimpPlugInTileMap *map,
+                                                        gint               tile_num);
+static void                gimp_plug_in_tile_map_fill  (GimpPlugInTileMap *map,
+                                                        TileManager       *tm);
+static void                gimp_plug_in_tile_map_free  (GimpPlugInTileMap *map);
+
+
+/*  public functions  */
+
+/*  Maps the tiles that cover the rectangle, fails if it doesn't
+ *  intersect the drawable.
+ */
+GimpPlugInShm *
+gimp_plug_in_tile_map_add (GimpPlugIn   *plug_in,
+                           GimpDrawable *drawable,
+                           gboolean      shadow,
+                           gint          x,
+                           gint          y,
+                           gint          width,
+                           gint          height)
+{
+  GimpPlugInTileMap *map;
+  TileManager       *tm;
+  gint               x2, y2;
+
+  g_return_val_if_fail (GIMP_IS_PLUG_IN (plug_in), NULL);
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+
+  if (! gimp_rectangle_intersect (x, y, width, height,
+                                  0, 0,
+                                  gimp_item_get_width  (GIMP_ITEM (drawable)),
+                                  gimp_item_get_height (GIMP_ITEM (drawable)),
+                                  &x, &y, &width, &height))
+    return NULL;
+
+  map = g_slice_new0 (GimpPlugInTileMap);
+
+  map->drawable = g_object_ref (drawable);
+  map->shadow   = shadow ? TRUE : FALSE;
+
+  tm = gimp_plug_in_tile_map_tiles (map);
+
+  if (shadow)
+    gimp_plug_in_cleanup_add_shadow (plug_in, drawable);
+
+  map->width  = tile_manager_width  (tm);
+  map->height = tile_manager_height (tm);
+  map->bpp    = tile_manager_bpp    (tm);
+
+  map->col    = x / TILE_WIDTH;
+  map->row    = y / TILE_HEIGHT;
+  map->n_cols = (x + width  - 1) / TILE_WIDTH  - map->col + 1;
+  map->n_rows = (y + height - 1) / TILE_HEIGHT - map->row + 1;
+
+  /*  the pixels of the mapped tiles  */
+  x  = map->col * TILE_WIDTH;
+  y  = map->row * TILE_HEIGHT;
+  x2 = MIN ((map->col + map->n_cols) * TILE_WIDTH,  map->width);
+  y2 = MIN ((map->row + map->n_rows) * TILE_HEIGHT, map->height);
+
+  map->shm = gimp_plug_in_shm_new_map ((gsize) (x2 - x) *
+                                       (gsize) (y2 - y) *
+                                       (gsize) map->bpp);
+
+  if (! map->shm)
+    {
+      gimp_plug_in_tile_map_free (map);
+      return NULL;
+    }
+
+  gimp_plug_in_tile_map_fill (map, tm);
+
+  plug_in->tile_maps = g_slist_prepend (plug_in->tile_maps, map);
+
+  GIMP_LOG (SHM, "mapped %d x %d %s of drawable %d as map ID = %d",
+            map->n_cols, map->n_rows,
+            shadow ? "shadow tiles" : "tiles",
+            gimp_item_get_ID (GIMP_ITEM (drawable)),
+            gimp_plug_in_shm_get_map_ID (map->shm));
+
+  return map->shm;
+}
+
+GimpDrawable *
+gimp_plug_in_tile_map_get_drawable (GimpPlugIn *plug_in,
+                                    gint        map_ID,
+                                    gboolean   *shadow)
+{
+  GimpPlugInTileMap *map;
+
+  g_return_val_if_fail (GIMP_IS_PLUG_IN (plug_in), NULL);
+
+  map = gimp_plug_in_tile_map_find (plug_in, map_ID);
+
+  if (! map)
+    return NULL;
+
+  if (shadow)
+    *shadow = map->shadow;
+
+  return map->drawable;
+}
+
+GimpPlugInShm *
+gimp_plug_in_tile_map_get_shm (GimpPlugIn *plug_in,
+                               gint        map_ID)
+{
+  GimpPlugInTileMap *map;
+
+  g_return_val_if_fail (GIMP_IS_PLUG_IN (plug_in), NULL);
+
+  map = gimp_plug_in_tile_map_find (plug_in, map_ID);
+
+  return map ? map->shm : NULL;
+}
+
+/*  Copies the mapped pixels of the @n_tiles tiles in @tile_nums back
+ *  to the drawable, leaving all other tiles alone.  Fails if the
+ *  drawable has changed its size or type since it was mapped, or if a
+ *  tile is not mapped.
+ */
+gboolean
+gimp_plug_in_tile_map_write_back (GimpPlugIn    *plug_in,
+                                  gint           map_ID,
+                                  const guint32 *tile_nums,
+                                  gint           n_tiles)
+{
+  GimpPlugInTileMap *map;
+  TileManager       *tm;
+  gint               i;
+
+  g_return_val_if_fail (GIMP_IS_PLUG_IN (plug_in), FALSE);
+  g_return_val_if_fail (tile_nums != NULL || n_tiles == 0, FALSE);
+
+  map = gimp_plug_in_tile_map_find (plug_in, map_ID);
+
+  g_return_val_if_fail (map != NULL, FALSE);
+
+  tm = gimp_plug_in_tile_map_tiles (map);
+
+  if (tile_manager_width  (tm) != map->width  ||
+      tile_manager_height (tm) != map->height ||
+      tile_manager_bpp    (tm) != map->bpp)
+    return FALSE;
+
+  for (i = 0; i < n_tiles; i++)
+    if (! gimp_plug_in_tile_map_contains (map, tile_nums[i]))
+      return FALSE;
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      Tile *tile = tile_manager_get (tm, tile_nums[i], TRUE, TRUE);
+
+      memcpy (tile_data_pointer (tile, 0, 0),
+              gimp_plug_in_tile_map_addr (map, tile_nums[i]),
+              tile_size (tile));
+
+      tile_release (tile, TRUE);
+    }
+
+  return TRUE;
+}
+
+void
+gimp_plug_in_tile_map_remove (GimpPlugIn *plug_in,
+                              gint        map_ID)
+{
+  GimpPlugInTileMap *map;
+
+  g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
+
+  map = gimp_plug_in_tile_map_find (plug_in, map_ID);
+
+  if (map)
+    {
+      plug_in->tile_maps = g_slist_remove (plug_in->tile_maps, map);
+
+      gimp_plug_in_tile_map_free (map);
+    }
+}
+
+/*  Drops all mappings without writing them back, like the tiles a
+ *  plug-in didn't send before it went away.
+ */
+void
+gimp_plug_in_tile_map_remove_all (GimpPlugIn *plug_in)
+{
+  g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
+
+  g_slist_free_full (plug_in->tile_maps,
+                     (GDestroyNotify) gimp_plug_in_tile_map_free);
+  plug_in->tile_maps = NULL;
+}
+
+
+/*  private functions  */
+
+static GimpPlugInTileMap *
+gimp_plug_in_tile_map_find (GimpPlugIn *plug_in,
+                            gint        map_ID)
+{
+  GSList *list;
+
+  for (list = plug_in->tile_maps; list; list = g_slist_next (list))
+    {
+      GimpPlugInTileMap *map = list->data;
+
+      if (gimp_plug_in_shm_get_map_ID (map->shm) == map_ID)
+        return map;
+    }
+
+  return NULL;
+}
+
+static TileManager *
+gimp_plug_in_tile_map_tiles (GimpPlugInTileMap *map)
+{
+  if (map->shadow)
+    return gimp_drawable_get_shadow_tiles (map->drawable);
+  else
+    return gimp_drawable_get_tiles (map->drawable);
+}
+
+static gboolean
+gimp_plug_in_tile_map_contains (GimpPlugInTileMap *map,
+                                guint32            tile_num)
+{
+  gint n_cols = (map->width + TILE_WIDTH - 1) / TILE_WIDTH;
+  gint row    = tile_num / n_cols;
+  gint col    = tile_num % n_cols;
+
+  return (row >= map->row && row < map->row + map->n_rows &&
+          col >= map->col && col < map->col + map->n_cols);
+}
+
+/*  All mapped tile rows above the tile are full height, and all mapped
+ *  tiles to its left have the height of its own row.
+ */
+static guchar *
+gimp_plug_in_tile_map_addr (GimpPlugInTileMap *map,
+                            gint               tile_num)
+{
+  gint n_cols = (map->width + TILE_WIDTH - 1) / TILE_WIDTH;
+  gint row    = tile_num / n_cols;
+  gint col    = tile_num % n_cols;
+  gint width  = (MIN ((map->col + map->n_cols) * TILE_WIDTH, map->width) -
+                 map->col * TILE_WIDTH);
+  gint height = MIN (TILE_HEIGHT, map->height - row * TILE_HEIGHT);
+
+  return (gimp_plug_in_shm_get_addr (map->shm) +
+          ((gsize) (row - map->row) * TILE_HEIGHT * width +
+           (gsize) (col - map->col) * TILE_WIDTH  * height) * map->bpp);
+}
+
+static void
+gimp_plug_in_tile_map_fill (GimpPlugInTileMap *map,
+                            TileManager       *tm)
+{
+  guchar *addr = gimp_plug_in_shm_get_addr (map->shm);
+  gint    row, col;
+
+  for (row = map->row; row < map->row + map->n_rows; row++)
+    for (col = map->col; col < map->col + map->n_cols; col++)
+      {
+        Tile *tile = tile_manager_get_at (tm, col, row, TRUE, FALSE);
+        gint  size = tile_size (tile);
+
+        memcpy (addr, tile_data_pointer (tile, 0, 0), size);
+
+        tile_release (tile, FALSE);
+
+        addr += size;
+      }
+}
+
+static void
+gimp_plug_in_tile_map_free (GimpPlugInTileMap *map)
+{
+  if (map->shm)
+    gimp_plug_in_shm_free (map->shm);
+
+  g_object_unref (map->drawable);
+
+  g_slice_free (GimpPlugInTileMap, map);
+}
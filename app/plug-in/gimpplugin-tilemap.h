@@ -0,0 +1,45 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpplugin-tilemap.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_PLUG_IN_TILE_MAP_H__
+#define __GIMP_PLUG_IN_TILE_MAP_H__
+
+
+GimpPlugInShm * gimp_plug_in_tile_map_add          (GimpPlugIn    *plug_in,
+                                                    GimpDrawable  *drawable,
+                                                    gboolean       shadow,
+                                                    gint           x,
+                                                    gint           y,
+                                                    gint           width,
+                                                    gint           height);
+GimpDrawable  * gimp_plug_in_tile_map_get_drawable (GimpPlugIn    *plug_in,
+                                                    gint           map_ID,
+                                                    gboolean      *shadow);
+GimpPlugInShm * gimp_plug_in_tile_map_get_shm      (GimpPlugIn    *plug_in,
+                                                    gint           map_ID);
+gboolean        gimp_plug_in_tile_map_write_back   (GimpPlugIn    *plug_in,
+                                                    gint           map_ID,
+                                                    const guint32 *tile_nums,
+                                                    gint           n_tiles);
+void            gimp_plug_in_tile_map_remove       (GimpPlugIn    *plug_in,
+                                                    gint           map_ID);
+void            gimp_plug_in_tile_map_remove_all   (GimpPlugIn    *plug_in);
+
+
+#endif /* __GIMP_PLUG_IN_TILE_MAP_H__ */
@@ -88,6 +88,7 @@
 #include "gimpplugin.h"
 #include "gimpplugin-message.h"
 #include "gimpplugin-progress.h"
+#include "gimpplugin-tilemap.h"
 #include "gimpplugindebug.h"
 #include "gimpplugindef.h"
 #include "gimppluginmanager.h"
@@ -148,6 +149,7 @@ gimp_plug_in_init (GimpPlugIn *plug_in)
   plug_in->call_mode          = GIMP_PLUG_IN_CALL_NONE;
   plug_in->open               = FALSE;
   plug_in->hup                = FALSE;
+  plug_in->resident           = FALSE;
   plug_in->pid                = 0;
 
   plug_in->my_read            = NULL;
@@ -156,10 +158,13 @@ gimp_plug_in_init (GimpPlugIn *plug_in)
   plug_in->his_write          = NULL;
 
   plug_in->input_id           = 0;
+  plug_in->idle_id            = 0;
   plug_in->write_buffer_index = 0;
 
   plug_in->temp_procedures    = NULL;
 
+  plug_in->tile_maps          = NULL;
+
   plug_in->ext_main_loop      = NULL;
 
   plug_in->temp_proc_frames   = NULL;
@@ -582,6 +587,12 @@ gimp_plug_in_close (GimpPlugIn *plug_in,
   while (plug_in->temp_procedures)
     gimp_plug_in_remove_temp_proc (plug_in, plug_in->temp_procedures->data);
 
+  /* Free the shared memory of any drawables it left mapped. */
+  gimp_plug_in_tile_map_remove_all (plug_in);
+
+  if (plug_in->resident)
+    gimp_plug_in_manager_remove_resident_plug_in (plug_in->manager, plug_in);
+
   gimp_plug_in_manager_remove_open_plug_in (plug_in->manager, plug_in);
 }
 
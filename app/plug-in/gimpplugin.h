@@ -47,6 +47,7 @@ struct _GimpPlugIn
   GimpPlugInCallMode   call_mode;       /*  QUERY, INIT or RUN                */
   guint                open : 1;        /*  Is the plug-in open?              */
   guint                hup : 1;         /*  Did we receive a G_IO_HUP         */
+  guint                resident : 1;    /*  Keep it running between calls?   */
   GPid                 pid;             /*  Plug-in's process id              */
 
   GIOChannel          *my_read;         /*  App's read and write channels     */
@@ -55,12 +56,15 @@ struct _GimpPlugIn
   GIOChannel          *his_write;
 
   guint                input_id;        /*  Id of input proc                  */
+  guint                idle_id;         /*  Id of the resident idle timeout   */
 
   gchar                write_buffer[WRITE_BUFFER_SIZE]; /* Buffer for writing */
   gint                 write_buffer_index;              /* Buffer index       */
 
   GSList              *temp_procedures; /*  Temporary procedures              */
 
+  GSList              *tile_maps;       /*  Drawables mapped into shm         */
+
   GMainLoop           *ext_main_loop;   /*  for waiting for extension_ack     */
 
   GimpPlugInProcFrame  main_proc_frame;
@@ -54,16 +54,19 @@
 
 /*  public functions  */
 
-void
-gimp_plug_in_manager_call_query (GimpPlugInManager *manager,
-                                 GimpContext       *context,
-                                 GimpPlugInDef     *plug_in_def)
+GimpPlugIn *
+gimp_plug_in_manager_call_start (GimpPlugInManager  *manager,
+                                 GimpContext        *context,
+                                 GimpPlugInDef      *plug_in_def,
+                                 GimpPlugInCallMode  call_mode)
 {
   GimpPlugIn *plug_in;
 
-  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
-  g_return_if_fail (GIMP_IS_PDB_CONTEXT (context));
-  g_return_if_fail (GIMP_IS_PLUG_IN_DEF (plug_in_def));
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), NULL);
+  g_return_val_if_fail (GIMP_IS_PDB_CONTEXT (context), NULL);
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_DEF (plug_in_def), NULL);
+  g_return_val_if_fail (call_mode == GIMP_PLUG_IN_CALL_QUERY ||
+                        call_mode == GIMP_PLUG_IN_CALL_INIT, NULL);
 
   plug_in = gimp_plug_in_new (manager, context, NULL,
                               NULL, plug_in_def->prog);
@@ -72,66 +75,17 @@ gimp_plug_in_manager_call_query (GimpPlugInManager *manager,
     {
       plug_in->plug_in_def = plug_in_def;
 
-      if (gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_QUERY, TRUE))
+      /*  the plug-in's messages are handled from the main loop, so
+       *  the caller can start more plug-ins while this one runs
+       */
+      if (! gimp_plug_in_open (plug_in, call_mode, FALSE))
         {
-          while (plug_in->open)
-            {
-              GimpWireMessage msg;
-
-              if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
-                {
-                  gimp_plug_in_close (plug_in, TRUE);
-                }
-              else
-                {
-                  gimp_plug_in_handle_message (plug_in, &msg);
-                  gimp_wire_destroy (&msg);
-                }
-            }
+          g_object_unref (plug_in);
+          plug_in = NULL;
         }
-
-      g_object_unref (plug_in);
     }
-}
-
-void
-gimp_plug_in_manager_call_init (GimpPlugInManager *manager,
-                                GimpContext       *context,
-                                GimpPlugInDef     *plug_in_def)
-{
-  GimpPlugIn *plug_in;
-
-  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
-  g_return_if_fail (GIMP_IS_PDB_CONTEXT (context));
-  g_return_if_fail (GIMP_IS_PLUG_IN_DEF (plug_in_def));
-
-  plug_in = gimp_plug_in_new (manager, context, NULL,
-                              NULL, plug_in_def->prog);
-
-  if (plug_in)
-    {
-      plug_in->plug_in_def = plug_in_def;
-
-      if (gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_INIT, TRUE))
-        {
-          while (plug_in->open)
-            {
-              GimpWireMessage msg;
-
-              if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
-                {
-                  gimp_plug_in_close (plug_in, TRUE);
-                }
-              else
-                {
-                  gimp_plug_in_handle_message (plug_in, &msg);
-                  gimp_wire_destroy (&msg);
-                }
-            }
-        }
 
-      g_object_unref (plug_in);
-    }
+  return plug_in;
 }
 
 GValueArray *
@@ -145,6 +99,8 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
 {
   GValueArray *return_vals = NULL;
   GimpPlugIn  *plug_in;
+  const gchar *prog;
+  gboolean     resident    = FALSE;
 
   g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), NULL);
   g_return_val_if_fail (GIMP_IS_PDB_CONTEXT (context), NULL);
@@ -153,7 +109,20 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
   g_return_val_if_fail (args != NULL, NULL);
   g_return_val_if_fail (display == NULL || GIMP_IS_OBJECT (display), NULL);
 
-  plug_in = gimp_plug_in_new (manager, context, progress, procedure, NULL);
+  /*  reuse a resident plug-in that waits for its next call  */
+  prog    = gimp_plug_in_procedure_get_progname (procedure);
+  plug_in = gimp_plug_in_manager_get_resident_plug_in (manager, prog);
+
+  if (plug_in)
+    {
+      gimp_plug_in_proc_frame_init (&plug_in->main_proc_frame,
+                                    context, progress, procedure);
+      resident = TRUE;
+    }
+  else
+    {
+      plug_in = gimp_plug_in_new (manager, context, progress, procedure, NULL);
+    }
 
   if (plug_in)
     {
@@ -165,7 +134,8 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
       gint               display_ID;
       gint               monitor;
 
-      if (! gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_RUN, FALSE))
+      if (! resident &&
+          ! gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_RUN, FALSE))
         {
           const gchar *name  = gimp_object_get_name (plug_in);
           GError      *error = g_error_new (GIMP_PLUG_IN_ERROR,
@@ -226,6 +196,10 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
           g_free (config.display_name);
           g_free (proc_run.params);
 
+          /*  the plug-in can't be talked to any longer, don't leave
+           *  it running, or waiting as a resident plug-in
+           */
+          gimp_plug_in_close (plug_in, TRUE);
           g_object_unref (plug_in);
 
           return_vals = gimp_procedure_get_return_values (GIMP_PROCEDURE (procedure),
@@ -274,6 +248,10 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
           proc_frame->main_loop = NULL;
 
           return_vals = gimp_plug_in_proc_frame_get_return_values (proc_frame);
+
+          /*  see gimp_plug_in_handle_proc_return()  */
+          if (plug_in->open && plug_in->resident)
+            gimp_plug_in_manager_add_resident_plug_in (manager, plug_in);
         }
 
       g_object_unref (plug_in);
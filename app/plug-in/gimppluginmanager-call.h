@@ -25,17 +25,13 @@
 #endif
 
 
-/*  Call the plug-in's query() function
+/*  Start the plug-in's query() or init() function, returns the
+ *  running plug-in without waiting for it to finish
  */
-void          gimp_plug_in_manager_call_query    (GimpPlugInManager      *manager,
+GimpPlugIn  * gimp_plug_in_manager_call_start    (GimpPlugInManager      *manager,
                                                   GimpContext            *context,
-                                                  GimpPlugInDef          *plug_in_def);
-
-/*  Call the plug-in's init() function
- */
-void          gimp_plug_in_manager_call_init     (GimpPlugInManager      *manager,
-                                                  GimpContext            *context,
-                                                  GimpPlugInDef          *plug_in_def);
+                                                  GimpPlugInDef          *plug_in_def,
+                                                  GimpPlugInCallMode      call_mode);
 
 /*  Run a plug-in as if it were a procedure database procedure
  */
@@ -31,11 +31,13 @@
 #include "config/gimpcoreconfig.h"
 
 #include "core/gimp.h"
+#include "core/gimp-gui.h"
 
 #include "pdb/gimppdb.h"
 #include "pdb/gimppdbcontext.h"
 
 #include "gimpinterpreterdb.h"
+#include "gimpplugin.h"
 #include "gimpplugindef.h"
 #include "gimppluginmanager.h"
 #define __YES_I_NEED_GIMP_PLUG_IN_MANAGER_CALL__
@@ -45,6 +47,7 @@
 #include "gimppluginmanager-restore.h"
 #include "gimppluginprocedure.h"
 #include "plug-in-rc.h"
+#include "plug-in-rc-cache.h"
 
 #include "gimp-intl.h"
 
@@ -52,8 +55,9 @@
 static void    gimp_plug_in_manager_search            (GimpPlugInManager      *manager,
                                                        GimpInitStatusFunc      status_callback);
 static gchar * gimp_plug_in_manager_get_pluginrc      (GimpPlugInManager      *manager);
-static void    gimp_plug_in_manager_read_pluginrc     (GimpPlugInManager      *manager,
+static gboolean gimp_plug_in_manager_read_pluginrc     (GimpPlugInManager      *manager,
                                                        const gchar            *pluginrc,
+                                                       const gchar            *cachefile,
                                                        GimpInitStatusFunc      status_callback);
 static void    gimp_plug_in_manager_query_new         (GimpPlugInManager      *manager,
                                                        GimpContext            *context,
@@ -61,6 +65,10 @@ static void    gimp_plug_in_manager_query_new         (GimpPlugInManager      *m
 static void    gimp_plug_in_manager_init_plug_ins     (GimpPlugInManager      *manager,
                                                        GimpContext            *context,
                                                        GimpInitStatusFunc      status_callback);
+static gint    gimp_plug_in_manager_get_n_parallel    (GimpPlugInManager      *manager);
+static GSList * gimp_plug_in_manager_wait_plug_ins    (GimpPlugInManager      *manager,
+                                                       GSList                 *plug_ins,
+                                                       gint                    n_running);
 static void    gimp_plug_in_manager_run_extensions    (GimpPlugInManager      *manager,
                                                        GimpContext            *context,
                                                        GimpInitStatusFunc      status_callback);
@@ -83,10 +91,12 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
                               GimpContext        *context,
                               GimpInitStatusFunc  status_callback)
 {
-  Gimp   *gimp;
-  gchar  *pluginrc;
-  GSList *list;
-  GError *error = NULL;
+  Gimp     *gimp;
+  gchar    *pluginrc;
+  gchar    *cachefile;
+  gboolean  cache_valid;
+  GSList   *list;
+  GError   *error = NULL;
 
   g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
   g_return_if_fail (GIMP_IS_CONTEXT (context));
@@ -101,9 +111,12 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
   gimp_plug_in_manager_search (manager, status_callback);
 
   /* read the pluginrc file for cached data */
-  pluginrc = gimp_plug_in_manager_get_pluginrc (manager);
+  pluginrc  = gimp_plug_in_manager_get_pluginrc (manager);
+  cachefile = g_strconcat (pluginrc, ".cache", NULL);
 
-  gimp_plug_in_manager_read_pluginrc (manager, pluginrc, status_callback);
+  cache_valid = gimp_plug_in_manager_read_pluginrc (manager,
+                                                    pluginrc, cachefile,
+                                                    status_callback);
 
   /* query any plug-ins that changed since we last wrote out pluginrc */
   gimp_plug_in_manager_query_new (manager, context, status_callback);
@@ -129,7 +142,11 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
       if (gimp->be_verbose)
         g_print ("Writing '%s'\n", gimp_filename_to_utf8 (pluginrc));
 
-      if (! plug_in_rc_write (manager->plug_in_defs, pluginrc, &error))
+      if (plug_in_rc_write (manager->plug_in_defs, pluginrc, &error))
+        {
+          cache_valid = FALSE;
+        }
+      else
         {
           gimp_message_literal (gimp,
 				NULL, GIMP_MESSAGE_ERROR, error->message);
@@ -139,6 +156,23 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
       manager->write_pluginrc = FALSE;
     }
 
+  /* write the binary copy of pluginrc if it doesn't match anymore */
+  if (! cache_valid && g_file_test (pluginrc, G_FILE_TEST_EXISTS))
+    {
+      if (gimp->be_verbose)
+        g_print ("Writing '%s'\n", gimp_filename_to_utf8 (cachefile));
+
+      if (! plug_in_rc_cache_write (manager->plug_in_defs,
+                                    cachefile, pluginrc, &error))
+        {
+          if (gimp->be_verbose)
+            g_printerr ("%s\n", error->message);
+
+          g_clear_error (&error);
+        }
+    }
+
+  g_free (cachefile);
   g_free (pluginrc);
 
   /* create locale and help domain lists */
@@ -272,22 +306,38 @@ gimp_plug_in_manager_get_pluginrc (GimpPlugInManager *manager)
   return pluginrc;
 }
 
-/* read the pluginrc file for cached data */
-static void
+/* read the pluginrc file for cached data, returns TRUE if the binary
+ * cache of pluginrc was up to date and used instead of the text file
+ */
+static gboolean
 gimp_plug_in_manager_read_pluginrc (GimpPlugInManager  *manager,
                                     const gchar        *pluginrc,
+                                    const gchar        *cachefile,
                                     GimpInitStatusFunc  status_callback)
 {
-  GSList *rc_defs;
-  GError *error = NULL;
+  GSList   *rc_defs;
+  gboolean  cache_valid = FALSE;
+  GError   *error       = NULL;
 
   status_callback (_("Resource configuration"),
                    gimp_filename_to_utf8 (pluginrc), 0.0);
 
-  if (manager->gimp->be_verbose)
-    g_print ("Parsing '%s'\n", gimp_filename_to_utf8 (pluginrc));
+  rc_defs = plug_in_rc_cache_read (manager->gimp, cachefile, pluginrc);
 
-  rc_defs = plug_in_rc_parse (manager->gimp, pluginrc, &error);
+  if (rc_defs)
+    {
+      if (manager->gimp->be_verbose)
+        g_print ("Read '%s'\n", gimp_filename_to_utf8 (cachefile));
+
+      cache_valid = TRUE;
+    }
+  else
+    {
+      if (manager->gimp->be_verbose)
+        g_print ("Parsing '%s'\n", gimp_filename_to_utf8 (pluginrc));
+
+      rc_defs = plug_in_rc_parse (manager->gimp, pluginrc, &error);
+    }
 
   if (rc_defs)
     {
@@ -306,6 +356,8 @@ gimp_plug_in_manager_read_pluginrc (GimpPlugInManager  *manager,
 
       g_clear_error (&error);
     }
+
+  return cache_valid;
 }
 
 /* query any plug-ins that changed since we last wrote out pluginrc */
@@ -329,17 +381,25 @@ gimp_plug_in_manager_query_new (GimpPlugInManager  *manager,
 
   if (n_plugins)
     {
-      gint nth;
+      GSList *running = NULL;
+      gint    n_parallel;
+      gint    nth;
 
       manager->write_pluginrc = TRUE;
 
+      n_parallel = gimp_plug_in_manager_get_n_parallel (manager);
+
       for (list = manager->plug_in_defs, nth = 0; list; list = list->next)
         {
           GimpPlugInDef *plug_in_def = list->data;
 
           if (plug_in_def->needs_query)
             {
-              gchar *basename;
+              GimpPlugIn *plug_in;
+              gchar      *basename;
+
+              running = gimp_plug_in_manager_wait_plug_ins (manager, running,
+                                                            n_parallel - 1);
 
               basename = g_filename_display_basename (plug_in_def->prog);
               status_callback (NULL, basename,
@@ -350,9 +410,15 @@ gimp_plug_in_manager_query_new (GimpPlugInManager  *manager,
                 g_print ("Querying plug-in: '%s'\n",
                          gimp_filename_to_utf8 (plug_in_def->prog));
 
-              gimp_plug_in_manager_call_query (manager, context, plug_in_def);
+              plug_in = gimp_plug_in_manager_call_start (manager, context,
+                                                         plug_in_def,
+                                                         GIMP_PLUG_IN_CALL_QUERY);
+              if (plug_in)
+                running = g_slist_prepend (running, plug_in);
             }
         }
+
+      gimp_plug_in_manager_wait_plug_ins (manager, running, 0);
     }
 
   status_callback (NULL, "", 1.0);
@@ -379,7 +445,11 @@ gimp_plug_in_manager_init_plug_ins (GimpPlugInManager  *manager,
 
   if (n_plugins)
     {
-      gint nth;
+      GSList *running = NULL;
+      gint    n_parallel;
+      gint    nth;
+
+      n_parallel = gimp_plug_in_manager_get_n_parallel (manager);
 
       for (list = manager->plug_in_defs, nth = 0; list; list = list->next)
         {
@@ -387,7 +457,11 @@ gimp_plug_in_manager_init_plug_ins (GimpPlugInManager  *manager,
 
           if (plug_in_def->has_init)
             {
-              gchar *basename;
+              GimpPlugIn *plug_in;
+              gchar      *basename;
+
+              running = gimp_plug_in_manager_wait_plug_ins (manager, running,
+                                                            n_parallel - 1);
 
               basename = g_filename_display_basename (plug_in_def->prog);
               status_callback (NULL, basename,
@@ -398,14 +472,83 @@ gimp_plug_in_manager_init_plug_ins (GimpPlugInManager  *manager,
                 g_print ("Initializing plug-in: '%s'\n",
                          gimp_filename_to_utf8 (plug_in_def->prog));
 
-              gimp_plug_in_manager_call_init (manager, context, plug_in_def);
+              plug_in = gimp_plug_in_manager_call_start (manager, context,
+                                                         plug_in_def,
+                                                         GIMP_PLUG_IN_CALL_INIT);
+              if (plug_in)
+                running = g_slist_prepend (running, plug_in);
             }
         }
+
+      gimp_plug_in_manager_wait_plug_ins (manager, running, 0);
     }
 
   status_callback (NULL, "", 1.0);
 }
 
+/*  The number of plug-ins that are queried or initialized at the same
+ *  time, starting a plug-in is mostly spent waiting for the dynamic
+ *  linker and the disk, so there is no point in running one at a time.
+ */
+static gint
+gimp_plug_in_manager_get_n_parallel (GimpPlugInManager *manager)
+{
+  /*  don't make a debugger wrapper attach to several plug-ins at once  */
+  if (manager->debug)
+    return 1;
+
+  return MAX (1, GIMP_BASE_CONFIG (manager->gimp->config)->num_processors);
+}
+
+/*  Runs the main loop until at most @n_running of @plug_ins are still
+ *  running, and returns the list of those.  The queries and inits of
+ *  several plug-ins run at the same time this way, their messages are
+ *  handled in the order they arrive.
+ */
+static GSList *
+gimp_plug_in_manager_wait_plug_ins (GimpPlugInManager *manager,
+                                    GSList            *plug_ins,
+                                    gint               n_running)
+{
+  while (TRUE)
+    {
+      GMainLoop *loop;
+      GSList    *list;
+      gulong     handler;
+
+      for (list = plug_ins; list; )
+        {
+          GimpPlugIn *plug_in = list->data;
+
+          list = g_slist_next (list);
+
+          if (! plug_in->open)
+            {
+              plug_ins = g_slist_remove (plug_ins, plug_in);
+              g_object_unref (plug_in);
+            }
+        }
+
+      if (g_slist_length (plug_ins) <= n_running)
+        break;
+
+      loop = g_main_loop_new (NULL, FALSE);
+
+      handler = g_signal_connect_swapped (manager, "plug-in-closed",
+                                          G_CALLBACK (g_main_loop_quit),
+                                          loop);
+
+      gimp_threads_leave (manager->gimp);
+      g_main_loop_run (loop);
+      gimp_threads_enter (manager->gimp);
+
+      g_signal_handler_disconnect (manager, handler);
+      g_main_loop_unref (loop);
+    }
+
+  return plug_ins;
+}
+
 /* run automatically started extensions */
 static void
 gimp_plug_in_manager_run_extensions (GimpPlugInManager  *manager,
@@ -39,6 +39,7 @@
 #include "gimpenvirontable.h"
 #include "gimpinterpreterdb.h"
 #include "gimpplugin.h"
+#include "gimpplugin-tilemap.h"
 #include "gimpplugindebug.h"
 #include "gimpplugindef.h"
 #include "gimppluginmanager.h"
@@ -53,6 +54,10 @@
 #include "gimp-intl.h"
 
 
+/*  seconds a resident plug-in may wait for its next call  */
+#define RESIDENT_IDLE_TIMEOUT  30
+
+
 enum
 {
   PLUG_IN_OPENED,
@@ -69,6 +74,8 @@ static void     gimp_plug_in_manager_finalize    (GObject    *object);
 static gint64   gimp_plug_in_manager_get_memsize (GimpObject *object,
                                                   gint64     *gui_size);
 
+static gboolean gimp_plug_in_manager_resident_timeout (GimpPlugIn *plug_in);
+
 
 G_DEFINE_TYPE (GimpPlugInManager, gimp_plug_in_manager, GIMP_TYPE_OBJECT)
 
@@ -149,6 +156,7 @@ gimp_plug_in_manager_init (GimpPlugInManager *manager)
 
   manager->current_plug_in    = NULL;
   manager->open_plug_ins      = NULL;
+  manager->resident_plug_ins  = NULL;
   manager->plug_in_stack      = NULL;
   manager->history            = NULL;
 
@@ -450,6 +458,93 @@ gimp_plug_in_manager_remove_open_plug_in (GimpPlugInManager *manager,
   g_object_unref (plug_in);
 }
 
+void
+gimp_plug_in_manager_add_resident_plug_in (GimpPlugInManager *manager,
+                                           GimpPlugIn        *plug_in)
+{
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
+  g_return_if_fail (plug_in->open && plug_in->resident);
+
+  /*  temporary procedures can't be run while the plug-in waits
+   *  for its next call, so don't keep such plug-ins around
+   */
+  if (plug_in->temp_procedures)
+    {
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  /*  end the call that just returned, only the process is kept  */
+  gimp_plug_in_proc_frame_dispose (&plug_in->main_proc_frame, plug_in);
+  gimp_plug_in_tile_map_remove_all (plug_in);
+
+  manager->resident_plug_ins = g_slist_prepend (manager->resident_plug_ins,
+                                                g_object_ref (plug_in));
+
+  plug_in->idle_id =
+    g_timeout_add_seconds (RESIDENT_IDLE_TIMEOUT,
+                           (GSourceFunc) gimp_plug_in_manager_resident_timeout,
+                           plug_in);
+}
+
+void
+gimp_plug_in_manager_remove_resident_plug_in (GimpPlugInManager *manager,
+                                              GimpPlugIn        *plug_in)
+{
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
+
+  if (! g_slist_find (manager->resident_plug_ins, plug_in))
+    return;
+
+  if (plug_in->idle_id)
+    {
+      g_source_remove (plug_in->idle_id);
+      plug_in->idle_id = 0;
+    }
+
+  manager->resident_plug_ins = g_slist_remove (manager->resident_plug_ins,
+                                               plug_in);
+
+  g_object_unref (plug_in);
+}
+
+/*  Returns a resident plug-in that waits for its next call, the caller
+ *  owns the returned reference and has to reinitialize its main proc
+ *  frame before running a procedure.
+ */
+GimpPlugIn *
+gimp_plug_in_manager_get_resident_plug_in (GimpPlugInManager *manager,
+                                           const gchar       *prog)
+{
+  GSList *list;
+
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), NULL);
+  g_return_val_if_fail (prog != NULL, NULL);
+
+  for (list = manager->resident_plug_ins; list; list = g_slist_next (list))
+    {
+      GimpPlugIn *plug_in = list->data;
+
+      if (! strcmp (prog, plug_in->prog))
+        {
+          if (plug_in->idle_id)
+            {
+              g_source_remove (plug_in->idle_id);
+              plug_in->idle_id = 0;
+            }
+
+          manager->resident_plug_ins =
+            g_slist_delete_link (manager->resident_plug_ins, list);
+
+          return plug_in;
+        }
+    }
+
+  return NULL;
+}
+
 void
 gimp_plug_in_manager_plug_in_push (GimpPlugInManager *manager,
                                    GimpPlugIn        *plug_in)
@@ -485,3 +580,17 @@ gimp_plug_in_manager_history_changed (GimpPlugInManager *manager)
 
   g_signal_emit (manager, manager_signals[HISTORY_CHANGED], 0);
 }
+
+
+/*  private functions  */
+
+static gboolean
+gimp_plug_in_manager_resident_timeout (GimpPlugIn *plug_in)
+{
+  plug_in->idle_id = 0;
+
+  /*  ask the plug-in to quit, this also removes it from the list  */
+  gimp_plug_in_close (plug_in, TRUE);
+
+  return FALSE;
+}
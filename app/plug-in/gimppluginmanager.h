@@ -54,6 +54,7 @@ struct _GimpPlugInManager
 
   GimpPlugIn        *current_plug_in;
   GSList            *open_plug_ins;
+  GSList            *resident_plug_ins;
   GSList            *plug_in_stack;
   GSList            *history;
 
@@ -106,6 +107,14 @@ void    gimp_plug_in_manager_add_open_plug_in     (GimpPlugInManager   *manager,
 void    gimp_plug_in_manager_remove_open_plug_in  (GimpPlugInManager   *manager,
                                                    GimpPlugIn          *plug_in);
 
+void    gimp_plug_in_manager_add_resident_plug_in    (GimpPlugInManager   *manager,
+                                                      GimpPlugIn          *plug_in);
+void    gimp_plug_in_manager_remove_resident_plug_in (GimpPlugInManager   *manager,
+                                                      GimpPlugIn          *plug_in);
+GimpPlugIn *
+        gimp_plug_in_manager_get_resident_plug_in    (GimpPlugInManager   *manager,
+                                                      const gchar         *prog);
+
 void    gimp_plug_in_manager_plug_in_push         (GimpPlugInManager   *manager,
                                                    GimpPlugIn          *plug_in);
 void    gimp_plug_in_manager_plug_in_pop          (GimpPlugInManager   *manager);
@@ -61,6 +61,9 @@
 
 #endif /* G_OS_WIN32 || G_WITH_CYGWIN */
 
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+
 #include "plug-in-types.h"
 
 #include "base/base-utils.h"
@@ -71,14 +74,18 @@
 #include "gimp-log.h"
 
 
-#define TILE_MAP_SIZE (TILE_WIDTH * TILE_HEIGHT * 4)
+/*  room for a GP_TILES_DATA message worth of tiles  */
+#define TILE_MAP_SIZE (TILE_WIDTH * TILE_HEIGHT * 4 * GP_TILES_MAX)
 
 #define ERRMSG_SHM_DISABLE "Disabling shared memory tile transport"
+#define ERRMSG_MAP_DISABLE "Not mapping the drawable into shared memory"
 
 
 struct _GimpPlugInShm
 {
   gint    shm_ID;
+  gint    map_ID;
+  gsize   size;
   guchar *shm_addr;
 
 #if defined(USE_WIN32_SHM)
@@ -87,6 +94,16 @@ struct _GimpPlugInShm
 };
 
 
+static GimpPlugInShm * gimp_plug_in_shm_create   (gsize          size,
+                                                  gint           map_ID);
+#if defined(USE_WIN32_SHM) || defined(USE_POSIX_SHM)
+static void            gimp_plug_in_shm_get_name (GimpPlugInShm *shm,
+                                                  gint           pid,
+                                                  gchar         *name,
+                                                  gsize          len);
+#endif
+
+
 GimpPlugInShm *
 gimp_plug_in_shm_new (void)
 {
@@ -95,15 +112,122 @@ gimp_plug_in_shm_new (void)
    *  we'll fall back on sending the data over the pipe.
    */
 
-  GimpPlugInShm *shm = g_slice_new0 (GimpPlugInShm);
+  return gimp_plug_in_shm_create (TILE_MAP_SIZE, 0);
+}
+
+/* allocate a piece of shared memory of @size bytes that a plug-in maps
+ *  a drawable's tiles into, see gimp_plug_in_handle_tile_map(). unlike
+ *  the tile transport segment, there is one of these per mapping, told
+ *  apart by their map IDs.
+ */
+GimpPlugInShm *
+gimp_plug_in_shm_new_map (gsize size)
+{
+  static gint map_ID = 0;
+
+  g_return_val_if_fail (size > 0, NULL);
+
+  if (++map_ID <= 0)
+    map_ID = 1;
+
+  return gimp_plug_in_shm_create (size, map_ID);
+}
+
+void
+gimp_plug_in_shm_free (GimpPlugInShm *shm)
+{
+  g_return_if_fail (shm != NULL);
+
+  if (shm->shm_ID != -1)
+    {
+
+#if defined (USE_SYSV_SHM)
+
+      shmdt (shm->shm_addr);
+
+#ifndef IPC_RMID_DEFERRED_RELEASE
+      shmctl (shm->shm_ID, IPC_RMID, NULL);
+#endif
+
+#elif defined(USE_WIN32_SHM)
+
+      if (shm->shm_addr)
+        UnmapViewOfFile (shm->shm_addr);
+
+      if (shm->shm_handle)
+        CloseHandle (shm->shm_handle);
+
+#elif defined(USE_POSIX_SHM)
+
+      gchar shm_handle[32];
+
+      munmap (shm->shm_addr, shm->size);
+
+      gimp_plug_in_shm_get_name (shm, shm->shm_ID,
+                                 shm_handle, sizeof (shm_handle));
+
+      shm_unlink (shm_handle);
+
+#endif
+
+      GIMP_LOG (SHM, "detached shared memory segment ID = %d, map ID = %d",
+                shm->shm_ID, shm->map_ID);
+    }
+
+  g_slice_free (GimpPlugInShm, shm);
+}
+
+gint
+gimp_plug_in_shm_get_ID (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, -1);
+
+  return shm->shm_ID;
+}
+
+guchar *
+gimp_plug_in_shm_get_addr (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, NULL);
+
+  return shm->shm_addr;
+}
+
+gint
+gimp_plug_in_shm_get_map_ID (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, 0);
+
+  return shm->map_ID;
+}
+
+gsize
+gimp_plug_in_shm_get_size (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, 0);
+
+  return shm->size;
+}
+
+
+/*  private functions  */
+
+static GimpPlugInShm *
+gimp_plug_in_shm_create (gsize size,
+                         gint  map_ID)
+{
+  GimpPlugInShm *shm    = g_slice_new0 (GimpPlugInShm);
+  const gchar   *errmsg = map_ID ? ERRMSG_MAP_DISABLE : ERRMSG_SHM_DISABLE;
 
   shm->shm_ID = -1;
+  shm->map_ID = map_ID;
+  shm->size   = size;
 
 #if defined(USE_SYSV_SHM)
 
   /* Use SysV shared memory mechanisms for transferring tile data. */
   {
-    shm->shm_ID = shmget (IPC_PRIVATE, TILE_MAP_SIZE, IPC_CREAT | 0600);
+    shm->shm_ID = shmget (IPC_PRIVATE, size, IPC_CREAT | 0600);
 
     if (shm->shm_ID != -1)
       {
@@ -111,8 +235,8 @@ gimp_plug_in_shm_new (void)
 
         if (shm->shm_addr == (guchar *) -1)
           {
-            g_printerr ("shmat() failed: %s\n" ERRMSG_SHM_DISABLE,
-                        g_strerror (errno));
+            g_printerr ("shmat() failed: %s\n%s\n",
+                        g_strerror (errno), errmsg);
             shmctl (shm->shm_ID, IPC_RMID, NULL);
             shm->shm_ID = -1;
           }
@@ -124,8 +248,8 @@ gimp_plug_in_shm_new (void)
       }
     else
       {
-        g_printerr ("shmget() failed: %s\n" ERRMSG_SHM_DISABLE,
-                    g_strerror (errno));
+        g_printerr ("shmget() failed: %s\n%s\n",
+                    g_strerror (errno), errmsg);
       }
   }
 
@@ -140,12 +264,13 @@ gimp_plug_in_shm_new (void)
     pid = GetCurrentProcessId ();
 
     /* From the id, derive the file map name */
-    g_snprintf (fileMapName, sizeof (fileMapName), "GIMP%d.SHM", pid);
+    gimp_plug_in_shm_get_name (shm, pid, fileMapName, sizeof (fileMapName));
 
     /* Create the file mapping into paging space */
     shm->shm_handle = CreateFileMapping (INVALID_HANDLE_VALUE, NULL,
-                                         PAGE_READWRITE, 0,
-                                         TILE_MAP_SIZE,
+                                         PAGE_READWRITE,
+                                         (DWORD) ((guint64) size >> 32),
+                                         (DWORD) (size & 0xffffffff),
                                          fileMapName);
 
     if (shm->shm_handle)
@@ -153,7 +278,7 @@ gimp_plug_in_shm_new (void)
         /* Map the shared memory into our address space for use */
         shm->shm_addr = (guchar *) MapViewOfFile (shm->shm_handle,
                                                   FILE_MAP_ALL_ACCESS,
-                                                  0, 0, TILE_MAP_SIZE);
+                                                  0, 0, size);
 
         /* Verify that we mapped our view */
         if (shm->shm_addr)
@@ -162,14 +287,17 @@ gimp_plug_in_shm_new (void)
           }
         else
           {
-            g_printerr ("MapViewOfFile error: %d... " ERRMSG_SHM_DISABLE,
-                        GetLastError ());
+            g_printerr ("MapViewOfFile error: %d... %s\n",
+                        GetLastError (), errmsg);
+
+            CloseHandle (shm->shm_handle);
+            shm->shm_handle = NULL;
           }
       }
     else
       {
-        g_printerr ("CreateFileMapping error: %d... " ERRMSG_SHM_DISABLE,
-                    GetLastError ());
+        g_printerr ("CreateFileMapping error: %d... %s\n",
+                    GetLastError (), errmsg);
       }
   }
 
@@ -185,17 +313,17 @@ gimp_plug_in_shm_new (void)
     pid = get_pid ();
 
     /* From the id, derive the file map name */
-    g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d", pid);
+    gimp_plug_in_shm_get_name (shm, pid, shm_handle, sizeof (shm_handle));
 
     /* Create the file mapping into paging space */
     shm_fd = shm_open (shm_handle, O_RDWR | O_CREAT, 0600);
 
     if (shm_fd != -1)
       {
-        if (ftruncate (shm_fd, TILE_MAP_SIZE) != -1)
+        if (ftruncate (shm_fd, size) != -1)
           {
             /* Map the shared memory into our address space for use */
-            shm->shm_addr = (guchar *) mmap (NULL, TILE_MAP_SIZE,
+            shm->shm_addr = (guchar *) mmap (NULL, size,
                                              PROT_READ | PROT_WRITE, MAP_SHARED,
                                              shm_fd, 0);
 
@@ -206,16 +334,16 @@ gimp_plug_in_shm_new (void)
               }
             else
               {
-                g_printerr ("mmap() failed: %s\n" ERRMSG_SHM_DISABLE,
-                            g_strerror (errno));
+                g_printerr ("mmap() failed: %s\n%s\n",
+                            g_strerror (errno), errmsg);
 
                 shm_unlink (shm_handle);
               }
           }
         else
           {
-            g_printerr ("ftruncate() failed: %s\n" ERRMSG_SHM_DISABLE,
-                        g_strerror (errno));
+            g_printerr ("ftruncate() failed: %s\n%s\n",
+                        g_strerror (errno), errmsg);
 
             shm_unlink (shm_handle);
           }
@@ -224,8 +352,8 @@ gimp_plug_in_shm_new (void)
       }
     else
       {
-        g_printerr ("shm_open() failed: %s\n" ERRMSG_SHM_DISABLE,
-                    g_strerror (errno));
+        g_printerr ("shm_open() failed: %s\n%s\n",
+                    g_strerror (errno), errmsg);
       }
   }
 
@@ -238,64 +366,35 @@ gimp_plug_in_shm_new (void)
     }
   else
     {
-      GIMP_LOG (SHM, "attached shared memory segment ID = %d", shm->shm_ID);
+      GIMP_LOG (SHM, "attached shared memory segment ID = %d, map ID = %d",
+                shm->shm_ID, shm->map_ID);
     }
 
   return shm;
 }
 
-void
-gimp_plug_in_shm_free (GimpPlugInShm *shm)
-{
-  g_return_if_fail (shm != NULL);
-
-  if (shm->shm_ID != -1)
-    {
-
-#if defined (USE_SYSV_SHM)
-
-      shmdt (shm->shm_addr);
-
-#ifndef IPC_RMID_DEFERRED_RELEASE
-      shmctl (shm->shm_ID, IPC_RMID, NULL);
-#endif
-
-#elif defined(USE_WIN32_SHM)
-
-      if (shm->shm_handle)
-        CloseHandle (shm->shm_handle);
-
-#elif defined(USE_POSIX_SHM)
-
-      gchar shm_handle[32];
-
-      munmap (shm->shm_addr, TILE_MAP_SIZE);
+#if defined(USE_WIN32_SHM) || defined(USE_POSIX_SHM)
 
-      g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d",
-                  shm->shm_ID);
-
-      shm_unlink (shm_handle);
-
-#endif
-
-      GIMP_LOG (SHM, "detached shared memory segment ID = %d", shm->shm_ID);
-    }
-
-  g_slice_free (GimpPlugInShm, shm);
-}
-
-gint
-gimp_plug_in_shm_get_ID (GimpPlugInShm *shm)
+/* the segments are named after the process ID and the map ID, libgimp
+ *  derives the same names in gimp_config() and gimp_tile_map_attach().
+ */
+static void
+gimp_plug_in_shm_get_name (GimpPlugInShm *shm,
+                           gint           pid,
+                           gchar         *name,
+                           gsize          len)
 {
-  g_return_val_if_fail (shm != NULL, -1);
-
-  return shm->shm_ID;
+#if defined(USE_WIN32_SHM)
+  if (shm->map_ID)
+    g_snprintf (name, len, "GIMP%d-%d.SHM", pid, shm->map_ID);
+  else
+    g_snprintf (name, len, "GIMP%d.SHM", pid);
+#else
+  if (shm->map_ID)
+    g_snprintf (name, len, "/gimp-shm-%d-%d", pid, shm->map_ID);
+  else
+    g_snprintf (name, len, "/gimp-shm-%d", pid);
+#endif
 }
 
-guchar *
-gimp_plug_in_shm_get_addr (GimpPlugInShm *shm)
-{
-  g_return_val_if_fail (shm != NULL, NULL);
-
-  return shm->shm_addr;
-}
+#endif
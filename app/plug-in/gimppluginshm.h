@@ -21,11 +21,14 @@
 #define __GIMP_PLUG_IN_SHM_H__
 
 
-GimpPlugInShm * gimp_plug_in_shm_new      (void);
-void            gimp_plug_in_shm_free     (GimpPlugInShm *shm);
+GimpPlugInShm * gimp_plug_in_shm_new        (void);
+GimpPlugInShm * gimp_plug_in_shm_new_map    (gsize          size);
+void            gimp_plug_in_shm_free       (GimpPlugInShm *shm);
 
-gint            gimp_plug_in_shm_get_ID   (GimpPlugInShm *shm);
-guchar        * gimp_plug_in_shm_get_addr (GimpPlugInShm *shm);
+gint            gimp_plug_in_shm_get_ID     (GimpPlugInShm *shm);
+gint            gimp_plug_in_shm_get_map_ID (GimpPlugInShm *shm);
+gsize           gimp_plug_in_shm_get_size   (GimpPlugInShm *shm);
+guchar        * gimp_plug_in_shm_get_addr   (GimpPlugInShm *shm);
 
 
 #endif /* __GIMP_PLUG_IN_SHM_H__ */
@@ -0,0 +1,650 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * plug-in-rc-cache.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A binary copy of pluginrc that is written next to it.  Parsing the
+ * text file with GScanner takes a noticeable part of the startup time
+ * when many plug-ins are installed, the cache is mapped into memory
+ * and read without any tokenizing.
+ *
+ * The cache stores the modification time and size of the pluginrc it
+ * was made from and is ignored if these don't match, so pluginrc
+ * stays the authoritative file.  Numbers are stored in the byte order
+ * of the machine, a cache from another machine fails the version
+ * check.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib-object.h>
+#include <glib/gstdio.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+
+#include "plug-in-types.h"
+
+#include "core/gimp.h"
+
+#include "pdb/gimp-pdb-compat.h"
+
+#include "gimpplugindef.h"
+#include "gimppluginprocedure.h"
+#include "plug-in-rc-cache.h"
+
+#include "gimp-intl.h"
+
+
+#define PLUG_IN_RC_CACHE_MAGIC    "GIMPPRC"
+#define PLUG_IN_RC_CACHE_VERSION  1
+
+
+typedef struct
+{
+  const gchar *data;
+  gsize        length;
+  gsize        offset;
+  gboolean     error;
+} PlugInRcCacheReader;
+
+
+static gboolean              plug_in_rc_cache_read_data      (PlugInRcCacheReader *reader,
+                                                              gpointer             dest,
+                                                              gsize                size);
+static guint32               plug_in_rc_cache_read_uint32    (PlugInRcCacheReader *reader);
+static gint64                plug_in_rc_cache_read_int64     (PlugInRcCacheReader *reader);
+static gchar               * plug_in_rc_cache_read_string    (PlugInRcCacheReader *reader);
+static GimpPlugInDef       * plug_in_rc_cache_read_def       (PlugInRcCacheReader *reader,
+                                                              Gimp                *gimp);
+static GimpPlugInProcedure * plug_in_rc_cache_read_procedure (PlugInRcCacheReader *reader,
+                                                              Gimp                *gimp,
+                                                              const gchar         *prog);
+static void                  plug_in_rc_cache_read_arg       (PlugInRcCacheReader *reader,
+                                                              Gimp                *gimp,
+                                                              GimpProcedure       *procedure,
+                                                              gboolean             return_value);
+
+static void                  plug_in_rc_cache_write_uint32   (GString             *buffer,
+                                                              guint32              value);
+static void                  plug_in_rc_cache_write_int64    (GString             *buffer,
+                                                              gint64               value);
+static void                  plug_in_rc_cache_write_string   (GString             *buffer,
+                                                              const gchar         *string);
+static void                  plug_in_rc_cache_write_def      (GString             *buffer,
+                                                              GimpPlugInDef       *plug_in_def);
+static void                  plug_in_rc_cache_write_procedure (GString            *buffer,
+                                                              GimpPlugInProcedure *proc);
+static void                  plug_in_rc_cache_write_arg      (GString             *buffer,
+                                                              GParamSpec          *pspec);
+
+
+/*  public functions  */
+
+GSList *
+plug_in_rc_cache_read (Gimp        *gimp,
+                       const gchar *filename,
+                       const gchar *pluginrc)
+{
+  GMappedFile         *file;
+  PlugInRcCacheReader  reader       = { 0, };
+  GSList              *plug_in_defs = NULL;
+  struct stat          st;
+  gchar                magic[sizeof (PLUG_IN_RC_CACHE_MAGIC)];
+  guint32              n_defs;
+  guint32              i;
+
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
+  g_return_val_if_fail (filename != NULL, NULL);
+  g_return_val_if_fail (pluginrc != NULL, NULL);
+
+  if (g_stat (pluginrc, &st) != 0)
+    return NULL;
+
+  file = g_mapped_file_new (filename, FALSE, NULL);
+
+  if (! file)
+    return NULL;
+
+  reader.data   = g_mapped_file_get_contents (file);
+  reader.length = g_mapped_file_get_length (file);
+
+  if (! plug_in_rc_cache_read_data (&reader, magic, sizeof (magic))          ||
+      memcmp (magic, PLUG_IN_RC_CACHE_MAGIC, sizeof (magic)) != 0           ||
+      plug_in_rc_cache_read_uint32 (&reader) != PLUG_IN_RC_CACHE_VERSION    ||
+      plug_in_rc_cache_read_uint32 (&reader) != GIMP_PROTOCOL_VERSION       ||
+      plug_in_rc_cache_read_int64 (&reader)  != (gint64) st.st_mtime        ||
+      plug_in_rc_cache_read_int64 (&reader)  != (gint64) st.st_size)
+    {
+      g_mapped_file_unref (file);
+      return NULL;
+    }
+
+  n_defs = plug_in_rc_cache_read_uint32 (&reader);
+
+  for (i = 0; i < n_defs && ! reader.error; i++)
+    {
+      GimpPlugInDef *plug_in_def = plug_in_rc_cache_read_def (&reader, gimp);
+
+      if (plug_in_def)
+        plug_in_defs = g_slist_prepend (plug_in_defs, plug_in_def);
+    }
+
+  if (reader.error || reader.offset != reader.length)
+    {
+      g_slist_free_full (plug_in_defs, (GDestroyNotify) g_object_unref);
+      plug_in_defs = NULL;
+    }
+
+  g_mapped_file_unref (file);
+
+  return g_slist_reverse (plug_in_defs);
+}
+
+gboolean
+plug_in_rc_cache_write (GSList       *plug_in_defs,
+                        const gchar  *filename,
+                        const gchar  *pluginrc,
+                        GError      **error)
+{
+  GString     *buffer;
+  GSList      *list;
+  struct stat  st;
+  gsize        n_defs_offset;
+  guint32      n_defs = 0;
+  gboolean     success;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (pluginrc != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (g_stat (pluginrc, &st) != 0)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   _("Could not open '%s' for reading: %s"),
+                   gimp_filename_to_utf8 (pluginrc), g_strerror (errno));
+      return FALSE;
+    }
+
+  buffer = g_string_sized_new (256 * 1024);
+
+  g_string_append_len (buffer,
+                       PLUG_IN_RC_CACHE_MAGIC,
+                       sizeof (PLUG_IN_RC_CACHE_MAGIC));
+  plug_in_rc_cache_write_uint32 (buffer, PLUG_IN_RC_CACHE_VERSION);
+  plug_in_rc_cache_write_uint32 (buffer, GIMP_PROTOCOL_VERSION);
+  plug_in_rc_cache_write_int64 (buffer, st.st_mtime);
+  plug_in_rc_cache_write_int64 (buffer, st.st_size);
+
+  /*  filled in below  */
+  n_defs_offset = buffer->len;
+  plug_in_rc_cache_write_uint32 (buffer, 0);
+
+  /*  skip the same plug-ins as plug_in_rc_write()  */
+  for (list = plug_in_defs; list; list = g_slist_next (list))
+    {
+      GimpPlugInDef *plug_in_def = list->data;
+
+      if (plug_in_def->procedures)
+        {
+          plug_in_rc_cache_write_def (buffer, plug_in_def);
+          n_defs++;
+        }
+    }
+
+  memcpy (buffer->str + n_defs_offset, &n_defs, sizeof (n_defs));
+
+  success = g_file_set_contents (filename, buffer->str, buffer->len, error);
+
+  g_string_free (buffer, TRUE);
+
+  return success;
+}
+
+
+/*  private functions  */
+
+static gboolean
+plug_in_rc_cache_read_data (PlugInRcCacheReader *reader,
+                            gpointer             dest,
+                            gsize                size)
+{
+  if (reader->error || reader->length - reader->offset < size)
+    {
+      reader->error = TRUE;
+      memset (dest, 0, size);
+
+      return FALSE;
+    }
+
+  memcpy (dest, reader->data + reader->offset, size);
+  reader->offset += size;
+
+  return TRUE;
+}
+
+static guint32
+plug_in_rc_cache_read_uint32 (PlugInRcCacheReader *reader)
+{
+  guint32 value;
+
+  plug_in_rc_cache_read_data (reader, &value, sizeof (value));
+
+  return value;
+}
+
+static gint64
+plug_in_rc_cache_read_int64 (PlugInRcCacheReader *reader)
+{
+  gint64 value;
+
+  plug_in_rc_cache_read_data (reader, &value, sizeof (value));
+
+  return value;
+}
+
+/*  empty strings are read as NULL, like gimp_scanner_parse_string()
+ *  does for pluginrc
+ */
+static gchar *
+plug_in_rc_cache_read_string (PlugInRcCacheReader *reader)
+{
+  guint32  length = plug_in_rc_cache_read_uint32 (reader);
+  gchar   *string;
+
+  if (reader->error || length == 0)
+    return NULL;
+
+  if (reader->length - reader->offset < length)
+    {
+      reader->error = TRUE;
+      return NULL;
+    }
+
+  string = g_strndup (reader->data + reader->offset, length);
+  reader->offset += length;
+
+  return string;
+}
+
+static GimpPlugInDef *
+plug_in_rc_cache_read_def (PlugInRcCacheReader *reader,
+                           Gimp                *gimp)
+{
+  GimpPlugInDef *plug_in_def;
+  gchar         *prog;
+  gchar         *domain_name;
+  gchar         *domain_path;
+  guint32        n_procedures;
+  guint32        i;
+
+  prog = plug_in_rc_cache_read_string (reader);
+
+  if (! prog)
+    {
+      reader->error = TRUE;
+      return NULL;
+    }
+
+  plug_in_def = gimp_plug_in_def_new (prog);
+  g_free (prog);
+
+  plug_in_def->mtime = plug_in_rc_cache_read_int64 (reader);
+
+  domain_name = plug_in_rc_cache_read_string (reader);
+  domain_path = plug_in_rc_cache_read_string (reader);
+
+  if (domain_name)
+    gimp_plug_in_def_set_locale_domain (plug_in_def, domain_name, domain_path);
+
+  g_free (domain_name);
+  g_free (domain_path);
+
+  domain_name = plug_in_rc_cache_read_string (reader);
+  domain_path = plug_in_rc_cache_read_string (reader);
+
+  if (domain_name)
+    gimp_plug_in_def_set_help_domain (plug_in_def, domain_name, domain_path);
+
+  g_free (domain_name);
+  g_free (domain_path);
+
+  if (plug_in_rc_cache_read_uint32 (reader))
+    gimp_plug_in_def_set_has_init (plug_in_def, TRUE);
+
+  n_procedures = plug_in_rc_cache_read_uint32 (reader);
+
+  for (i = 0; i < n_procedures && ! reader->error; i++)
+    {
+      GimpPlugInProcedure *proc;
+
+      proc = plug_in_rc_cache_read_procedure (reader, gimp, plug_in_def->prog);
+
+      if (proc)
+        {
+          gimp_plug_in_def_add_procedure (plug_in_def, proc);
+          g_object_unref (proc);
+        }
+    }
+
+  if (reader->error)
+    {
+      g_object_unref (plug_in_def);
+      return NULL;
+    }
+
+  return plug_in_def;
+}
+
+static GimpPlugInProcedure *
+plug_in_rc_cache_read_procedure (PlugInRcCacheReader *reader,
+                                 Gimp                *gimp,
+                                 const gchar         *prog)
+{
+  GimpProcedure       *procedure;
+  GimpPlugInProcedure *proc;
+  gchar               *str;
+  gint                 proc_type;
+  GimpIconType         icon_type;
+  gint                 icon_data_length;
+  guint32              n_menu_paths;
+  guint32              n_args;
+  guint32              n_return_vals;
+  guint32              i;
+
+  str       = plug_in_rc_cache_read_string (reader);
+  proc_type = plug_in_rc_cache_read_uint32 (reader);
+
+  if (reader->error || ! str)
+    {
+      reader->error = TRUE;
+      g_free (str);
+      return NULL;
+    }
+
+  procedure = gimp_plug_in_procedure_new (proc_type, prog);
+  proc      = GIMP_PLUG_IN_PROCEDURE (procedure);
+
+  gimp_object_take_name (GIMP_OBJECT (procedure),
+                         gimp_canonicalize_identifier (str));
+
+  procedure->original_name = str;
+
+  procedure->blurb     = plug_in_rc_cache_read_string (reader);
+  procedure->help      = plug_in_rc_cache_read_string (reader);
+  procedure->author    = plug_in_rc_cache_read_string (reader);
+  procedure->copyright = plug_in_rc_cache_read_string (reader);
+  procedure->date      = plug_in_rc_cache_read_string (reader);
+  proc->menu_label     = plug_in_rc_cache_read_string (reader);
+
+  n_menu_paths = plug_in_rc_cache_read_uint32 (reader);
+
+  for (i = 0; i < n_menu_paths && ! reader->error; i++)
+    {
+      str = plug_in_rc_cache_read_string (reader);
+
+      if (str)
+        proc->menu_paths = g_list_append (proc->menu_paths, str);
+    }
+
+  icon_type        = plug_in_rc_cache_read_uint32 (reader);
+  icon_data_length = (gint32) plug_in_rc_cache_read_uint32 (reader);
+
+  switch (icon_type)
+    {
+    case GIMP_ICON_TYPE_STOCK_ID:
+    case GIMP_ICON_TYPE_IMAGE_FILE:
+      proc->icon_type        = icon_type;
+      proc->icon_data_length = -1;
+      proc->icon_data        = (guint8 *) plug_in_rc_cache_read_string (reader);
+      break;
+
+    case GIMP_ICON_TYPE_INLINE_PIXBUF:
+      if (icon_data_length < 0)
+        {
+          reader->error = TRUE;
+          break;
+        }
+
+      proc->icon_type        = icon_type;
+      proc->icon_data_length = icon_data_length;
+      proc->icon_data        = g_malloc (icon_data_length);
+
+      plug_in_rc_cache_read_data (reader, proc->icon_data, icon_data_length);
+      break;
+
+    default:
+      reader->error = TRUE;
+      break;
+    }
+
+  proc->file_proc = plug_in_rc_cache_read_uint32 (reader) ? TRUE : FALSE;
+
+  if (proc->file_proc)
+    {
+      proc->extensions = plug_in_rc_cache_read_string (reader);
+      proc->prefixes   = plug_in_rc_cache_read_string (reader);
+      proc->magics     = plug_in_rc_cache_read_string (reader);
+
+      str = plug_in_rc_cache_read_string (reader);
+      if (str)
+        gimp_plug_in_procedure_set_mime_type (proc, str);
+      g_free (str);
+
+      str = plug_in_rc_cache_read_string (reader);
+      if (str)
+        gimp_plug_in_procedure_set_thumb_loader (proc, str);
+      g_free (str);
+    }
+
+  str = plug_in_rc_cache_read_string (reader);
+  gimp_plug_in_procedure_set_image_types (proc, str);
+  g_free (str);
+
+  n_args        = plug_in_rc_cache_read_uint32 (reader);
+  n_return_vals = plug_in_rc_cache_read_uint32 (reader);
+
+  for (i = 0; i < n_args && ! reader->error; i++)
+    plug_in_rc_cache_read_arg (reader, gimp, procedure, FALSE);
+
+  for (i = 0; i < n_return_vals && ! reader->error; i++)
+    plug_in_rc_cache_read_arg (reader, gimp, procedure, TRUE);
+
+  if (reader->error)
+    {
+      g_object_unref (proc);
+      return NULL;
+    }
+
+  return proc;
+}
+
+static void
+plug_in_rc_cache_read_arg (PlugInRcCacheReader *reader,
+                           Gimp                *gimp,
+                           GimpProcedure       *procedure,
+                           gboolean             return_value)
+{
+  GimpPDBArgType  arg_type;
+  gchar          *name;
+  gchar          *desc;
+  GParamSpec     *pspec = NULL;
+
+  arg_type = plug_in_rc_cache_read_uint32 (reader);
+  name     = plug_in_rc_cache_read_string (reader);
+  desc     = plug_in_rc_cache_read_string (reader);
+
+  if (! reader->error && name)
+    pspec = gimp_pdb_compat_param_spec (gimp, arg_type, name, desc);
+
+  if (pspec)
+    {
+      if (return_value)
+        gimp_procedure_add_return_value (procedure, pspec);
+      else
+        gimp_procedure_add_argument (procedure, pspec);
+    }
+  else
+    {
+      reader->error = TRUE;
+    }
+
+  g_free (name);
+  g_free (desc);
+}
+
+static void
+plug_in_rc_cache_write_uint32 (GString *buffer,
+                               guint32  value)
+{
+  g_string_append_len (buffer, (const gchar *) &value, sizeof (value));
+}
+
+static void
+plug_in_rc_cache_write_int64 (GString *buffer,
+                              gint64   value)
+{
+  g_string_append_len (buffer, (const gchar *) &value, sizeof (value));
+}
+
+static void
+plug_in_rc_cache_write_string (GString     *buffer,
+                               const gchar *string)
+{
+  guint32 length = string ? strlen (string) : 0;
+
+  plug_in_rc_cache_write_uint32 (buffer, length);
+  g_string_append_len (buffer, string, length);
+}
+
+static void
+plug_in_rc_cache_write_def (GString       *buffer,
+                            GimpPlugInDef *plug_in_def)
+{
+  GSList  *list;
+  guint32  n_procedures = 0;
+  gsize    n_procedures_offset;
+
+  plug_in_rc_cache_write_string (buffer, plug_in_def->prog);
+  plug_in_rc_cache_write_int64 (buffer, plug_in_def->mtime);
+
+  plug_in_rc_cache_write_string (buffer, plug_in_def->locale_domain_name);
+  plug_in_rc_cache_write_string (buffer, plug_in_def->locale_domain_path);
+  plug_in_rc_cache_write_string (buffer, plug_in_def->help_domain_name);
+  plug_in_rc_cache_write_string (buffer, plug_in_def->help_domain_uri);
+
+  plug_in_rc_cache_write_uint32 (buffer, plug_in_def->has_init);
+
+  /*  filled in below  */
+  n_procedures_offset = buffer->len;
+  plug_in_rc_cache_write_uint32 (buffer, 0);
+
+  for (list = plug_in_def->procedures; list; list = g_slist_next (list))
+    {
+      GimpPlugInProcedure *proc = list->data;
+
+      if (proc->installed_during_init)
+        continue;
+
+      plug_in_rc_cache_write_procedure (buffer, proc);
+      n_procedures++;
+    }
+
+  memcpy (buffer->str + n_procedures_offset,
+          &n_procedures, sizeof (n_procedures));
+}
+
+static void
+plug_in_rc_cache_write_procedure (GString             *buffer,
+                                  GimpPlugInProcedure *proc)
+{
+  GimpProcedure *procedure = GIMP_PROCEDURE (proc);
+  GList         *list;
+  gint           i;
+
+  plug_in_rc_cache_write_string (buffer, procedure->original_name);
+  plug_in_rc_cache_write_uint32 (buffer, procedure->proc_type);
+
+  plug_in_rc_cache_write_string (buffer, procedure->blurb);
+  plug_in_rc_cache_write_string (buffer, procedure->help);
+  plug_in_rc_cache_write_string (buffer, procedure->author);
+  plug_in_rc_cache_write_string (buffer, procedure->copyright);
+  plug_in_rc_cache_write_string (buffer, procedure->date);
+  plug_in_rc_cache_write_string (buffer, proc->menu_label);
+
+  plug_in_rc_cache_write_uint32 (buffer, g_list_length (proc->menu_paths));
+
+  for (list = proc->menu_paths; list; list = g_list_next (list))
+    plug_in_rc_cache_write_string (buffer, list->data);
+
+  plug_in_rc_cache_write_uint32 (buffer, proc->icon_type);
+  plug_in_rc_cache_write_uint32 (buffer, proc->icon_data_length);
+
+  switch (proc->icon_type)
+    {
+    case GIMP_ICON_TYPE_STOCK_ID:
+    case GIMP_ICON_TYPE_IMAGE_FILE:
+      plug_in_rc_cache_write_string (buffer, (gchar *) proc->icon_data);
+      break;
+
+    case GIMP_ICON_TYPE_INLINE_PIXBUF:
+      g_string_append_len (buffer,
+                           (const gchar *) proc->icon_data,
+                           proc->icon_data_length);
+      break;
+    }
+
+  plug_in_rc_cache_write_uint32 (buffer, proc->file_proc);
+
+  if (proc->file_proc)
+    {
+      plug_in_rc_cache_write_string (buffer, proc->extensions);
+      plug_in_rc_cache_write_string (buffer, proc->prefixes);
+      plug_in_rc_cache_write_string (buffer, proc->magics);
+      plug_in_rc_cache_write_string (buffer, proc->mime_type);
+      plug_in_rc_cache_write_string (buffer, proc->thumb_loader);
+    }
+
+  plug_in_rc_cache_write_string (buffer, proc->image_types);
+
+  plug_in_rc_cache_write_uint32 (buffer, procedure->num_args);
+  plug_in_rc_cache_write_uint32 (buffer, procedure->num_values);
+
+  for (i = 0; i < procedure->num_args; i++)
+    plug_in_rc_cache_write_arg (buffer, procedure->args[i]);
+
+  for (i = 0; i < procedure->num_values; i++)
+    plug_in_rc_cache_write_arg (buffer, procedure->values[i]);
+}
+
+static void
+plug_in_rc_cache_write_arg (GString    *buffer,
+                            GParamSpec *pspec)
+{
+  GType type = G_PARAM_SPEC_VALUE_TYPE (pspec);
+
+  plug_in_rc_cache_write_uint32 (buffer,
+                                 gimp_pdb_compat_arg_type_from_gtype (type));
+  plug_in_rc_cache_write_string (buffer, g_param_spec_get_name (pspec));
+  plug_in_rc_cache_write_string (buffer, g_param_spec_get_blurb (pspec));
+}
@@ -0,0 +1,217 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Measures how pixel_regions_process_parallel() scales with the
+ * number of threads, using some of the paint-funcs kernels.  This is
+ * not run by "make check", build it with
+ *
+ *   make benchmark-pixel-processor
+ *
+ * and run it with the number of threads to go up to as argument.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include <gegl.h>
+
+#include "core/core-types.h"
+
+#include "base/pixel-processor.h"
+#include "base/pixel-region.h"
+#include "base/tile-manager.h"
+
+#include "paint-funcs/paint-funcs.h"
+
+#include "core/gimp.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define WIDTH   4096
+#define HEIGHT  4096
+#define ROUNDS  5
+
+
+typedef void (* BenchmarkFunc) (TileManager *src1,
+                                TileManager *src2,
+                                TileManager *mask,
+                                TileManager *dest);
+
+
+static void
+benchmark_combine_regions (TileManager *src1,
+                           TileManager *src2,
+                           TileManager *mask,
+                           TileManager *dest)
+{
+  const gboolean affect[MAX_CHANNELS] = { TRUE, TRUE, TRUE, TRUE };
+  PixelRegion    src1PR, src2PR, destPR;
+
+  pixel_region_init (&src1PR, src1, 0, 0, WIDTH, HEIGHT, FALSE);
+  pixel_region_init (&src2PR, src2, 0, 0, WIDTH, HEIGHT, FALSE);
+  pixel_region_init (&destPR, dest, 0, 0, WIDTH, HEIGHT, TRUE);
+
+  combine_regions (&src1PR, &src2PR, &destPR, NULL, NULL,
+                   OPAQUE_OPACITY, GIMP_MULTIPLY_MODE, affect,
+                   COMBINE_INTEN_A_INTEN_A);
+}
+
+static void
+benchmark_apply_mask (TileManager *src1,
+                      TileManager *src2,
+                      TileManager *mask,
+                      TileManager *dest)
+{
+  PixelRegion srcPR, maskPR;
+
+  pixel_region_init (&srcPR,  dest, 0, 0, WIDTH, HEIGHT, TRUE);
+  pixel_region_init (&maskPR, mask, 0, 0, WIDTH, HEIGHT, FALSE);
+
+  apply_mask_to_region (&srcPR, &maskPR, OPAQUE_OPACITY / 2);
+}
+
+static TileManager *
+benchmark_tiles_new (gint   bpp,
+                     guchar value)
+{
+  TileManager *tiles = tile_manager_new (WIDTH, HEIGHT, bpp);
+  PixelRegion  region;
+  guchar       color[MAX_CHANNELS];
+  gint         i;
+
+  for (i = 0; i < bpp; i++)
+    color[i] = value + i * 32;
+
+  pixel_region_init (&region, tiles, 0, 0, WIDTH, HEIGHT, TRUE);
+  color_region (&region, color);
+
+  return tiles;
+}
+
+static gdouble
+benchmark_run (Gimp          *gimp,
+               BenchmarkFunc  func,
+               gint           n_threads,
+               TileManager   *src1,
+               TileManager   *src2,
+               TileManager   *mask,
+               TileManager   *dest)
+{
+  GTimer  *timer = g_timer_new ();
+  gdouble  best  = G_MAXDOUBLE;
+  gint     i;
+
+  g_object_set (gimp->config, "num-processors", n_threads, NULL);
+
+  for (i = 0; i < ROUNDS; i++)
+    {
+      gdouble elapsed;
+
+      g_timer_start (timer);
+      func (src1, src2, mask, dest);
+      elapsed = g_timer_elapsed (timer, NULL);
+
+      best = MIN (best, elapsed);
+    }
+
+  g_timer_destroy (timer);
+
+  return best;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  static const struct
+  {
+    const gchar   *name;
+    BenchmarkFunc  func;
+  }
+  benchmarks[] =
+  {
+    { "combine_regions",      benchmark_combine_regions },
+    { "apply_mask_to_region", benchmark_apply_mask      }
+  };
+
+  Gimp        *gimp;
+  TileManager *src1;
+  TileManager *src2;
+  TileManager *mask;
+  TileManager *dest;
+  gint         max_threads;
+  gint         i;
+
+  g_thread_init (NULL);
+  g_type_init ();
+
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  gimp = gimp_init_for_testing ();
+
+  /*  defaults to the number of processors  */
+  g_object_get (gimp->config, "num-processors", &max_threads, NULL);
+
+  if (argc > 1)
+    max_threads = atoi (argv[1]);
+
+  max_threads = CLAMP (max_threads, 1, GIMP_MAX_NUM_THREADS);
+
+  src1 = benchmark_tiles_new (4, 0x40);
+  src2 = benchmark_tiles_new (4, 0x80);
+  mask = benchmark_tiles_new (1, 0xc0);
+  dest = benchmark_tiles_new (4, 0x00);
+
+  g_print ("%d x %d pixels, best of %d rounds\n\n", WIDTH, HEIGHT, ROUNDS);
+
+  for (i = 0; i < G_N_ELEMENTS (benchmarks); i++)
+    {
+      gdouble single = 0.0;
+      gint    n;
+
+      g_print ("%s\n", benchmarks[i].name);
+      g_print ("  threads    seconds    speedup\n");
+
+      for (n = 1; n <= max_threads; n++)
+        {
+          gdouble elapsed = benchmark_run (gimp, benchmarks[i].func, n,
+                                           src1, src2, mask, dest);
+
+          if (n == 1)
+            single = elapsed;
+
+          g_print ("  %7d    %7.3f    %7.2f\n",
+                   n, elapsed, single / elapsed);
+        }
+
+      g_print ("\n");
+    }
+
+  tile_manager_unref (src1);
+  tile_manager_unref (src2);
+  tile_manager_unref (mask);
+  tile_manager_unref (dest);
+
+  gimp_exit (gimp, TRUE);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,218 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Measures how gimp_transform_region() scales with the number of
+ * threads, for a rotation, a perspective transform and a flip of an
+ * 8k layer.  This is not run by "make check", build it with
+ *
+ *   make benchmark-transform-region
+ *
+ * and run it with the number of threads to go up to as argument.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include <gegl.h>
+
+#include "libgimpmath/gimpmath.h"
+
+#include "core/core-types.h"
+
+#include "base/pixel-processor.h"
+#include "base/pixel-region.h"
+#include "base/tile-manager.h"
+
+#include "paint-funcs/paint-funcs.h"
+
+#include "core/gimp.h"
+#include "core/gimp-transform-region.h"
+#include "core/gimp-transform-utils.h"
+#include "core/gimpimage.h"
+#include "core/gimplayer.h"
+#include "core/gimppickable.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define WIDTH   8192
+#define HEIGHT  8192
+#define ROUNDS  3
+
+
+typedef void (* BenchmarkMatrixFunc) (GimpMatrix3 *matrix);
+
+
+static void
+benchmark_rotate (GimpMatrix3 *matrix)
+{
+  gimp_matrix3_identity (matrix);
+  gimp_transform_matrix_rotate_center (matrix,
+                                       WIDTH / 2.0, HEIGHT / 2.0, G_PI / 6);
+}
+
+static void
+benchmark_perspective (GimpMatrix3 *matrix)
+{
+  gimp_transform_matrix_perspective (matrix, 0, 0, WIDTH, HEIGHT,
+                                     WIDTH * 0.2, HEIGHT * 0.1,
+                                     WIDTH * 0.8, HEIGHT * 0.1,
+                                     0,           HEIGHT,
+                                     WIDTH,       HEIGHT);
+}
+
+static void
+benchmark_flip (GimpMatrix3 *matrix)
+{
+  gimp_matrix3_identity (matrix);
+  gimp_transform_matrix_flip (matrix, GIMP_ORIENTATION_HORIZONTAL,
+                              WIDTH / 2.0);
+}
+
+static gdouble
+benchmark_run (Gimp                  *gimp,
+               GimpLayer             *layer,
+               TileManager           *dest,
+               const GimpMatrix3     *matrix,
+               GimpInterpolationType  interpolation,
+               gint                   n_threads)
+{
+  GimpDrawable *drawable = GIMP_DRAWABLE (layer);
+  GTimer       *timer    = g_timer_new ();
+  gdouble       best     = G_MAXDOUBLE;
+  gint          i;
+
+  g_object_set (gimp->config, "num-processors", n_threads, NULL);
+
+  for (i = 0; i < ROUNDS; i++)
+    {
+      PixelRegion destPR;
+      gdouble     elapsed;
+
+      pixel_region_init (&destPR, dest, 0, 0, WIDTH, HEIGHT, TRUE);
+
+      g_timer_start (timer);
+
+      gimp_transform_region (GIMP_PICKABLE (drawable),
+                             gimp_get_user_context (gimp),
+                             gimp_drawable_get_tiles (drawable), 0, 0,
+                             &destPR, 0, 0, WIDTH, HEIGHT,
+                             matrix, interpolation, 3, NULL);
+
+      elapsed = g_timer_elapsed (timer, NULL);
+
+      best = MIN (best, elapsed);
+    }
+
+  g_timer_destroy (timer);
+
+  return best;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  static const struct
+  {
+    const gchar           *name;
+    BenchmarkMatrixFunc    func;
+    GimpInterpolationType  interpolation;
+  }
+  benchmarks[] =
+  {
+    { "rotate, linear",      benchmark_rotate,      GIMP_INTERPOLATION_LINEAR  },
+    { "rotate, lanczos",     benchmark_rotate,      GIMP_INTERPOLATION_LANCZOS },
+    { "perspective, linear", benchmark_perspective, GIMP_INTERPOLATION_LINEAR  },
+    { "flip",                benchmark_flip,        GIMP_INTERPOLATION_NONE    }
+  };
+
+  Gimp        *gimp;
+  GimpImage   *image;
+  GimpLayer   *layer;
+  TileManager *dest;
+  PixelRegion  region;
+  guchar       color[4] = { 0x40, 0x80, 0xc0, 0xff };
+  gint         max_threads;
+  gint         i;
+
+  g_thread_init (NULL);
+  g_type_init ();
+
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  gimp = gimp_init_for_testing ();
+
+  /*  defaults to the number of processors  */
+  g_object_get (gimp->config, "num-processors", &max_threads, NULL);
+
+  if (argc > 1)
+    max_threads = atoi (argv[1]);
+
+  max_threads = CLAMP (max_threads, 1, GIMP_MAX_NUM_THREADS);
+
+  image = gimp_image_new (gimp, WIDTH, HEIGHT, GIMP_RGB);
+  layer = gimp_layer_new (image, WIDTH, HEIGHT, GIMP_RGBA_IMAGE,
+                          "benchmark", GIMP_OPACITY_OPAQUE, GIMP_NORMAL_MODE);
+
+  gimp_image_add_layer (image, layer, NULL, 0, FALSE);
+
+  pixel_region_init (&region, gimp_drawable_get_tiles (GIMP_DRAWABLE (layer)),
+                     0, 0, WIDTH, HEIGHT, TRUE);
+  color_region (&region, color);
+
+  dest = tile_manager_new (WIDTH, HEIGHT, 4);
+
+  g_print ("%d x %d pixels, best of %d rounds\n\n", WIDTH, HEIGHT, ROUNDS);
+
+  for (i = 0; i < G_N_ELEMENTS (benchmarks); i++)
+    {
+      GimpMatrix3 matrix;
+      gdouble     single = 0.0;
+      gint        n;
+
+      benchmarks[i].func (&matrix);
+
+      g_print ("%s\n", benchmarks[i].name);
+      g_print ("  threads    seconds    speedup\n");
+
+      for (n = 1; n <= max_threads; n++)
+        {
+          gdouble elapsed = benchmark_run (gimp, layer, dest, &matrix,
+                                           benchmarks[i].interpolation, n);
+
+          if (n == 1)
+            single = elapsed;
+
+          g_print ("  %7d    %7.3f    %7.2f\n",
+                   n, elapsed, single / elapsed);
+        }
+
+      g_print ("\n");
+    }
+
+  tile_manager_unref (dest);
+  g_object_unref (image);
+
+  gimp_exit (gimp, TRUE);
+
+  return EXIT_SUCCESS;
+}
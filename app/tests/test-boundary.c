@@ -0,0 +1,322 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "base/base-types.h"
+
+#include "base/boundary.h"
+#include "base/pixel-region.h"
+#include "base/tile.h"
+#include "base/tile-cache.h"
+#include "base/tile-compress.h"
+#include "base/tile-manager.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/boundary/" #function, function);
+
+/*  not a multiple of the tile size, so the last row of tiles is partial  */
+#define WIDTH    300
+#define HEIGHT   230
+
+#define N_EDITS  100
+
+
+typedef struct
+{
+  TileManager   *tiles;
+  guchar        *buffer;
+  BoundaryCache *cache;
+  GRand         *rand;
+} BoundaryTest;
+
+
+/*  Sets a rectangle of the mask to a value, and invalidates the rows
+ *  it covers, like GimpChannel does on an update.
+ */
+static void
+boundary_test_fill (BoundaryTest *test,
+                    gint          x,
+                    gint          y,
+                    gint          width,
+                    gint          height,
+                    guchar        value)
+{
+  gint row;
+
+  for (row = y; row < y + height; row++)
+    memset (test->buffer + row * WIDTH + x, value, width);
+
+  tile_manager_write_pixel_data (test->tiles, x, y,
+                                 x + width - 1, y + height - 1,
+                                 test->buffer + y * WIDTH + x, WIDTH);
+
+  boundary_cache_invalidate (test->cache, y, height);
+}
+
+/*  Fills a random rectangle with a random value, values close to the
+ *  threshold are as likely as the extremes.
+ */
+static void
+boundary_test_fill_random (BoundaryTest *test)
+{
+  static const guchar values[] = { 0, 255, 126, 127, 128 };
+
+  gint x      = g_rand_int_range (test->rand, 0, WIDTH);
+  gint y      = g_rand_int_range (test->rand, 0, HEIGHT);
+  gint width  = g_rand_int_range (test->rand, 1, WIDTH  - x + 1);
+  gint height = g_rand_int_range (test->rand, 1, MIN (HEIGHT - y, 80) + 1);
+
+  boundary_test_fill (test, x, y, MIN (width, 120), height,
+                      values[g_rand_int_range (test->rand,
+                                               0, G_N_ELEMENTS (values))]);
+}
+
+static void
+boundary_test_init (BoundaryTest *test)
+{
+  gint i;
+
+  test->tiles  = tile_manager_new (WIDTH, HEIGHT, 1);
+  test->buffer = g_new0 (guchar, WIDTH * HEIGHT);
+  test->cache  = boundary_cache_new ();
+  test->rand   = g_rand_new_with_seed (230);
+
+  for (i = 0; i < 40; i++)
+    boundary_test_fill_random (test);
+}
+
+static void
+boundary_test_free (BoundaryTest *test)
+{
+  boundary_cache_free (test->cache);
+  tile_manager_unref (test->tiles);
+  g_free (test->buffer);
+  g_rand_free (test->rand);
+}
+
+/*  Asserts that boundary_cache_find() gives the same segments, in the
+ *  same order, as boundary_find() for a region of the mask.
+ */
+static void
+boundary_test_check (BoundaryTest *test,
+                     gint          pr_x,
+                     gint          pr_y,
+                     gint          pr_width,
+                     gint          pr_height,
+                     BoundaryType  type,
+                     gint          x1,
+                     gint          y1,
+                     gint          x2,
+                     gint          y2)
+{
+  PixelRegion  maskPR;
+  BoundSeg    *segs;
+  BoundSeg    *cached_segs;
+  gint         num_segs;
+  gint         num_cached_segs;
+  gint         i;
+
+  pixel_region_init (&maskPR, test->tiles,
+                     pr_x, pr_y, pr_width, pr_height, FALSE);
+
+  segs = boundary_find (&maskPR, type, x1, y1, x2, y2,
+                        BOUNDARY_HALF_WAY, &num_segs);
+
+  pixel_region_init (&maskPR, test->tiles,
+                     pr_x, pr_y, pr_width, pr_height, FALSE);
+
+  cached_segs = boundary_cache_find (test->cache, &maskPR, type,
+                                     x1, y1, x2, y2,
+                                     BOUNDARY_HALF_WAY, &num_cached_segs);
+
+  g_assert_cmpint (num_cached_segs, ==, num_segs);
+
+  for (i = 0; i < num_segs; i++)
+    {
+      g_assert_cmpint (cached_segs[i].x1,   ==, segs[i].x1);
+      g_assert_cmpint (cached_segs[i].y1,   ==, segs[i].y1);
+      g_assert_cmpint (cached_segs[i].x2,   ==, segs[i].x2);
+      g_assert_cmpint (cached_segs[i].y2,   ==, segs[i].y2);
+      g_assert_cmpint (cached_segs[i].open, ==, segs[i].open);
+    }
+
+  g_free (segs);
+  g_free (cached_segs);
+}
+
+/*  Edits the rows at the border between the first two rows of tiles,
+ *  and the first and last row of the mask, then random rectangles.
+ *  The boundaries are compared after every edit.
+ */
+static void
+boundary_test_edits (BoundaryTest *test,
+                     gint          pr_x,
+                     gint          pr_y,
+                     gint          pr_width,
+                     gint          pr_height,
+                     BoundaryType  type,
+                     gint          x1,
+                     gint          y1,
+                     gint          x2,
+                     gint          y2)
+{
+  static const struct
+  {
+    gint   y;
+    guchar value;
+  } rows[] =
+  {
+    { TILE_HEIGHT - 1, 255 },
+    { TILE_HEIGHT,     255 },
+    { TILE_HEIGHT - 1, 0   },
+    { TILE_HEIGHT,     0   },
+    { 0,               255 },
+    { 0,               0   },
+    { HEIGHT - 1,      255 },
+    { HEIGHT - 1,      0   }
+  };
+
+  gint i;
+
+  boundary_test_check (test, pr_x, pr_y, pr_width, pr_height,
+                       type, x1, y1, x2, y2);
+
+  for (i = 0; i < G_N_ELEMENTS (rows); i++)
+    {
+      /*  a part of the row, so it has ends inside the mask  */
+      boundary_test_fill (test, 40, rows[i].y, 150, 1, rows[i].value);
+
+      boundary_test_check (test, pr_x, pr_y, pr_width, pr_height,
+                           type, x1, y1, x2, y2);
+    }
+
+  for (i = 0; i < N_EDITS; i++)
+    {
+      boundary_test_fill_random (test);
+
+      boundary_test_check (test, pr_x, pr_y, pr_width, pr_height,
+                           type, x1, y1, x2, y2);
+    }
+}
+
+/**
+ * cache_ignore_bounds:
+ *
+ * Test that the cached boundary of a whole mask, ignoring bounds, is
+ * the same as boundary_find() after each of a series of edits.
+ **/
+static void
+cache_ignore_bounds (void)
+{
+  BoundaryTest test;
+
+  boundary_test_init (&test);
+
+  boundary_test_edits (&test, 0, 0, WIDTH, HEIGHT,
+                       BOUNDARY_IGNORE_BOUNDS, 0, 0, WIDTH, HEIGHT);
+
+  boundary_test_free (&test);
+}
+
+/**
+ * cache_ignore_bounds_region:
+ *
+ * Test that the cached boundary of a part of a mask that doesn't
+ * start at a row of tiles, like the bounds of a selection, is the
+ * same as boundary_find() after each of a series of edits.
+ **/
+static void
+cache_ignore_bounds_region (void)
+{
+  BoundaryTest test;
+
+  boundary_test_init (&test);
+
+  boundary_test_edits (&test, 10, 30, 270, 180,
+                       BOUNDARY_IGNORE_BOUNDS, 0, 0, WIDTH, HEIGHT);
+
+  boundary_test_free (&test);
+}
+
+/**
+ * cache_within_bounds:
+ *
+ * Test that the cached boundary within bounds that don't start at a
+ * row of tiles is the same as boundary_find() after each of a series
+ * of edits.
+ **/
+static void
+cache_within_bounds (void)
+{
+  BoundaryTest test;
+
+  boundary_test_init (&test);
+
+  boundary_test_edits (&test, 0, 0, WIDTH, HEIGHT,
+                       BOUNDARY_WITHIN_BOUNDS, 20, 30, 250, 200);
+
+  boundary_test_free (&test);
+}
+
+/**
+ * cache_parameters_changed:
+ *
+ * Test that the cache starts over when it is asked for a different
+ * region or different bounds, without being invalidated.
+ **/
+static void
+cache_parameters_changed (void)
+{
+  BoundaryTest test;
+
+  boundary_test_init (&test);
+
+  boundary_test_check (&test, 0, 0, WIDTH, HEIGHT,
+                       BOUNDARY_WITHIN_BOUNDS, 20, 30, 250, 200);
+  boundary_test_check (&test, 0, 0, WIDTH, HEIGHT,
+                       BOUNDARY_WITHIN_BOUNDS, 0, 70, 300, 140);
+  boundary_test_check (&test, 10, 30, 270, 180,
+                       BOUNDARY_IGNORE_BOUNDS, 0, 0, WIDTH, HEIGHT);
+  boundary_test_check (&test, 0, 0, WIDTH, HEIGHT,
+                       BOUNDARY_IGNORE_BOUNDS, 0, 0, WIDTH, HEIGHT);
+
+  boundary_test_free (&test);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_thread_init (NULL);
+  g_type_init ();
+  tile_cache_init (64 * 1024 * 1024);
+  tile_compress_init (0);
+  g_test_init (&argc, &argv, NULL);
+
+  ADD_TEST (cache_ignore_bounds);
+  ADD_TEST (cache_ignore_bounds_region);
+  ADD_TEST (cache_within_bounds);
+  ADD_TEST (cache_parameters_changed);
+
+  return g_test_run ();
+}
@@ -0,0 +1,183 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include "core/core-types.h"
+
+#include "core/gimplist.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/gimplist/" #function, function);
+
+
+static GimpObject *
+gimp_test_list_add (GimpContainer *container,
+                    const gchar   *name)
+{
+  GimpObject *object = g_object_new (GIMP_TYPE_OBJECT,
+                                     "name", name,
+                                     NULL);
+
+  gimp_container_add (container, object);
+  g_object_unref (object);
+
+  return object;
+}
+
+/**
+ * get_child_by_name:
+ *
+ * Test that children are found by their name after they were added,
+ * renamed and removed.
+ **/
+static void
+get_child_by_name (void)
+{
+  GimpContainer *container = gimp_list_new (GIMP_TYPE_OBJECT, FALSE);
+  GimpObject    *foo       = gimp_test_list_add (container, "foo");
+  GimpObject    *bar       = gimp_test_list_add (container, "bar");
+
+  g_assert (gimp_container_get_child_by_name (container, "foo") == foo);
+  g_assert (gimp_container_get_child_by_name (container, "bar") == bar);
+
+  gimp_object_set_name (foo, "baz");
+
+  g_assert (gimp_container_get_child_by_name (container, "foo") == NULL);
+  g_assert (gimp_container_get_child_by_name (container, "baz") == foo);
+
+  gimp_container_remove (container, bar);
+
+  g_assert (gimp_container_get_child_by_name (container, "bar") == NULL);
+
+  g_object_unref (container);
+}
+
+/**
+ * get_child_by_name_duplicates:
+ *
+ * Test that the first child in the list is returned when several
+ * children have the same name.
+ **/
+static void
+get_child_by_name_duplicates (void)
+{
+  GimpContainer *container = gimp_list_new (GIMP_TYPE_OBJECT, FALSE);
+  GimpObject    *first     = gimp_test_list_add (container, "foo");
+  GimpObject    *second    = gimp_test_list_add (container, "foo");
+
+  /*  gimp_list_new() prepends children  */
+  g_assert (gimp_container_get_child_by_name (container, "foo") == second);
+
+  gimp_container_reorder (container, first, 0);
+  g_assert (gimp_container_get_child_by_name (container, "foo") == first);
+
+  gimp_container_remove (container, first);
+  g_assert (gimp_container_get_child_by_name (container, "foo") == second);
+
+  g_object_unref (container);
+}
+
+/**
+ * unique_names:
+ *
+ * Test that lists with unique names still rename children that are
+ * added or renamed to a name that is in use.
+ **/
+static void
+unique_names (void)
+{
+  GimpContainer *container = gimp_list_new (GIMP_TYPE_OBJECT, TRUE);
+  GimpObject    *foo       = gimp_test_list_add (container, "foo");
+  GimpObject    *foo_1     = gimp_test_list_add (container, "foo");
+  GimpObject    *bar       = gimp_test_list_add (container, "bar");
+
+  g_assert_cmpstr (gimp_object_get_name (foo_1), ==, "foo #1");
+
+  gimp_object_set_name (bar, "foo");
+
+  g_assert_cmpstr (gimp_object_get_name (bar), ==, "foo #2");
+  g_assert (gimp_container_get_child_by_name (container, "foo")    == foo);
+  g_assert (gimp_container_get_child_by_name (container, "foo #1") == foo_1);
+  g_assert (gimp_container_get_child_by_name (container, "foo #2") == bar);
+  g_assert (gimp_container_get_child_by_name (container, "bar")    == NULL);
+
+  g_object_unref (container);
+}
+
+/**
+ * get_child_by_index:
+ *
+ * Test that index lookups follow changes of the order of children,
+ * also after repeated lookups.
+ **/
+static void
+get_child_by_index (void)
+{
+  GimpContainer *container = gimp_list_new (GIMP_TYPE_OBJECT, FALSE);
+  GimpObject    *objects[3];
+  gint           i, j;
+
+  gimp_list_set_sort_func (GIMP_LIST (container),
+                           (GCompareFunc) gimp_object_name_collate);
+
+  objects[1] = gimp_test_list_add (container, "b");
+  objects[2] = gimp_test_list_add (container, "c");
+  objects[0] = gimp_test_list_add (container, "a");
+
+  for (j = 0; j < 3; j++)
+    for (i = 0; i < 3; i++)
+      {
+        g_assert (gimp_container_get_child_by_index (container, i) ==
+                  objects[i]);
+        g_assert_cmpint (gimp_container_get_child_index (container,
+                                                         objects[i]), ==, i);
+      }
+
+  gimp_object_set_name (objects[0], "d");
+
+  g_assert (gimp_container_get_child_by_index (container, 2) == objects[0]);
+  g_assert (gimp_container_get_child_by_index (container, 2) == objects[0]);
+  g_assert_cmpint (gimp_container_get_child_index (container, objects[1]),
+                   ==, 0);
+
+  gimp_container_remove (container, objects[1]);
+
+  g_assert_cmpint (gimp_container_get_child_index (container, objects[1]),
+                   ==, -1);
+  g_assert (gimp_container_get_child_by_index (container, 0) == objects[2]);
+
+  g_object_unref (container);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_type_init ();
+  g_test_init (&argc, &argv, NULL);
+
+  ADD_TEST (get_child_by_name);
+  ADD_TEST (get_child_by_name_duplicates);
+  ADD_TEST (unique_names);
+  ADD_TEST (get_child_by_index);
+
+  return g_test_run ();
+}
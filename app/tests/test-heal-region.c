@@ -0,0 +1,292 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "libgimpmath/gimpmath.h"
+
+#include "paint-funcs/paint-funcs-types.h"
+
+#include "base/pixel-region.h"
+
+#include "paint-funcs/heal-region.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add ("/heal-region/" #function, \
+              GimpTestFixture, \
+              NULL, \
+              NULL, \
+              function, \
+              gimp_test_heal_region_teardown);
+
+#define BYTES        4
+#define MASK_BORDER  3
+
+
+typedef struct
+{
+  gint    width;
+  gint    height;
+  guchar *temp;
+  guchar *src;
+  guchar *mask;
+  guchar *expected;
+} GimpTestFixture;
+
+
+/*  The red/black Gauss-Seidel solver with an over-relaxation factor of
+ *  1.8 that the heal tool used before the multigrid solver, it is
+ *  iterated until it converges and serves as the reference.
+ */
+static gdouble
+reference_iteration (const gdouble *matrix,
+                     gdouble       *solution,
+                     const guchar  *mask,
+                     gint           width,
+                     gint           height)
+{
+  const gint    rowstride   = width * BYTES;
+  const gint    mask_stride = width + 2 * MASK_BORDER;
+  const gdouble w           = 1.80 * 0.25; /* Over-relaxation = 1.8 */
+  gdouble       err         = 0.0;
+  gint          color, i, j, k;
+
+  for (color = 0; color < 2; color++)
+    {
+      /*  the blacks use the reds that have just been computed  */
+      const gdouble *neighbors = color ? solution : matrix;
+
+      for (i = 0; i < height; i++)
+        for (j = (i + color) % 2; j < width; j += 2)
+          {
+            gint off  = i * rowstride + j * BYTES;
+            gint offm = (i + MASK_BORDER) * mask_stride + j + MASK_BORDER;
+
+            for (k = 0; k < BYTES; k++)
+              {
+                if (mask[offm] == 0 ||
+                    i == 0 || i == height - 1 ||
+                    j == 0 || j == width - 1)
+                  {
+                    solution[off + k] = matrix[off + k];
+                  }
+                else
+                  {
+                    gdouble tmp = solution[off + k];
+                    gdouble diff;
+
+                    solution[off + k] = (matrix[off + k] +
+                                         w *
+                                         (neighbors[off - BYTES + k] +
+                                          neighbors[off + BYTES + k] +
+                                          neighbors[off - rowstride + k] +
+                                          neighbors[off + rowstride + k] -
+                                          4.0 * matrix[off + k]));
+
+                    diff = solution[off + k] - tmp;
+                    err += diff * diff;
+                  }
+              }
+          }
+    }
+
+  return err;
+}
+
+static void
+reference_heal (GimpTestFixture *f)
+{
+  gint     size     = f->width * f->height * BYTES;
+  gdouble *matrix   = g_new (gdouble, size);
+  gdouble *solution = g_new (gdouble, size);
+  gint     i;
+
+  for (i = 0; i < size; i++)
+    matrix[i] = (gdouble) f->temp[i] - (gdouble) f->src[i];
+
+  for (i = 0; i < 100000; i++)
+    {
+      gdouble sqr_err = reference_iteration (matrix, solution, f->mask,
+                                             f->width, f->height);
+
+      memcpy (matrix, solution, size * sizeof (gdouble));
+
+      if (sqr_err < 0.00001)
+        break;
+    }
+
+  f->expected = g_new (guchar, size);
+
+  for (i = 0; i < size; i++)
+    f->expected[i] = CLAMP0255 (ROUND (solution[i] + f->src[i]));
+
+  g_free (matrix);
+  g_free (solution);
+}
+
+/*  Fills the fixture with an image and a pattern that differ by a
+ *  smooth ramp plus some noise, and a round mask that has a border
+ *  like a brush mask does.
+ */
+static void
+gimp_test_heal_region_setup (GimpTestFixture *f,
+                             gint             width,
+                             gint             height)
+{
+  GRand *rand        = g_rand_new_with_seed (width * height);
+  gint   mask_stride = width + 2 * MASK_BORDER;
+  gint   x, y, k;
+
+  f->width  = width;
+  f->height = height;
+  f->temp   = g_new (guchar, width * height * BYTES);
+  f->src    = g_new (guchar, width * height * BYTES);
+  f->mask   = g_new0 (guchar, mask_stride * (height + 2 * MASK_BORDER));
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        gdouble dx = (x - width  / 2.0) / (width  / 2.0 - 2);
+        gdouble dy = (y - height / 2.0) / (height / 2.0 - 2);
+
+        for (k = 0; k < BYTES; k++)
+          {
+            gint i = (y * width + x) * BYTES + k;
+
+            f->src[i]  = 40 + g_rand_int_range (rand, 0, 32) + 20 * k;
+            f->temp[i] = CLAMP0255 (f->src[i] + 60 * sin (x * 0.07 + k) +
+                                    30 * cos (y * 0.05) +
+                                    g_rand_int_range (rand, 0, 8));
+          }
+
+        if (dx * dx + dy * dy < 1.0)
+          f->mask[(y + MASK_BORDER) * mask_stride + x + MASK_BORDER] = 255;
+      }
+
+  g_rand_free (rand);
+
+  reference_heal (f);
+}
+
+static void
+gimp_test_heal_region_teardown (GimpTestFixture *f,
+                                gconstpointer    data)
+{
+  g_free (f->temp);
+  g_free (f->src);
+  g_free (f->mask);
+  g_free (f->expected);
+}
+
+static void
+gimp_test_heal_region_check (GimpTestFixture *f)
+{
+  PixelRegion tempPR;
+  PixelRegion srcPR;
+  PixelRegion maskPR;
+  gint        i;
+
+  pixel_region_init_data (&tempPR, f->temp, BYTES, f->width * BYTES,
+                          0, 0, f->width, f->height);
+  pixel_region_init_data (&srcPR, f->src, BYTES, f->width * BYTES,
+                          0, 0, f->width, f->height);
+  pixel_region_init_data (&maskPR, f->mask, 1, f->width + 2 * MASK_BORDER,
+                          MASK_BORDER, MASK_BORDER, f->width, f->height);
+
+  heal_region (&tempPR, &srcPR, &maskPR);
+
+  /*  allow for rounding differences  */
+  for (i = 0; i < f->width * f->height * BYTES; i++)
+    g_assert_cmpint (ABS (f->temp[i] - f->expected[i]), <=, 1);
+}
+
+/**
+ * small_dab:
+ *
+ * Test that a small dab heals like the Gauss-Seidel solver.
+ **/
+static void
+small_dab (GimpTestFixture *f,
+           gconstpointer    data)
+{
+  gimp_test_heal_region_setup (f, 37, 29);
+  gimp_test_heal_region_check (f);
+}
+
+/**
+ * large_dab:
+ *
+ * Test that a dab that spans several grid levels heals like the
+ * Gauss-Seidel solver does once it has converged.
+ **/
+static void
+large_dab (GimpTestFixture *f,
+           gconstpointer    data)
+{
+  gimp_test_heal_region_setup (f, 150, 113);
+  gimp_test_heal_region_check (f);
+}
+
+/**
+ * outside_mask:
+ *
+ * Test that pixels outside of the mask are left alone.
+ **/
+static void
+outside_mask (GimpTestFixture *f,
+              gconstpointer    data)
+{
+  guchar *orig;
+  gint    mask_stride;
+  gint    x, y, k;
+
+  gimp_test_heal_region_setup (f, 64, 64);
+
+  orig        = g_memdup (f->temp, f->width * f->height * BYTES);
+  mask_stride = f->width + 2 * MASK_BORDER;
+
+  gimp_test_heal_region_check (f);
+
+  for (y = 0; y < f->height; y++)
+    for (x = 0; x < f->width; x++)
+      if (! f->mask[(y + MASK_BORDER) * mask_stride + x + MASK_BORDER])
+        for (k = 0; k < BYTES; k++)
+          {
+            gint i = (y * f->width + x) * BYTES + k;
+
+            g_assert_cmpint (f->temp[i], ==, orig[i]);
+          }
+
+  g_free (orig);
+}
+
+int main(int argc, char **argv)
+{
+  g_type_init ();
+  g_test_init (&argc, &argv, NULL);
+
+  ADD_TEST (small_dab);
+  ADD_TEST (large_dab);
+  ADD_TEST (outside_mask);
+
+  return g_test_run ();
+}
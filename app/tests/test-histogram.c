@@ -0,0 +1,163 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include "base/base-types.h"
+
+#include "base/gimphistogram.h"
+#include "base/pixel-region.h"
+#include "base/tile-cache.h"
+#include "base/tile-manager.h"
+
+#include "paint-funcs/paint-funcs.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/histogram/" #function, function);
+
+#define WIDTH   300
+#define HEIGHT  500
+
+
+static TileManager *
+histogram_test_tiles_new (void)
+{
+  TileManager *tiles = tile_manager_new (WIDTH, HEIGHT, 4);
+  PixelRegion  region;
+  gpointer     pr;
+
+  pixel_region_init (&region, tiles, 0, 0, WIDTH, HEIGHT, TRUE);
+
+  for (pr = pixel_regions_register (1, &region);
+       pr != NULL;
+       pr = pixel_regions_process (pr))
+    {
+      guchar *data = region.data;
+      gint    x, y;
+
+      for (y = 0; y < region.h; y++)
+        for (x = 0; x < region.w; x++)
+          {
+            guchar *p = data + y * region.rowstride + x * 4;
+
+            p[0] = region.x + x;
+            p[1] = region.y + y;
+            p[2] = (region.x + x) ^ (region.y + y);
+            p[3] = 255;
+          }
+    }
+
+  return tiles;
+}
+
+static void
+histogram_test_compare (GimpHistogram *histogram,
+                        TileManager   *tiles)
+{
+  GimpHistogram *expected = gimp_histogram_new ();
+  PixelRegion    region;
+  gint           channel, bin;
+
+  pixel_region_init (&region, tiles, 10, 20, WIDTH - 10, HEIGHT - 30, FALSE);
+  gimp_histogram_calculate (expected, &region, NULL);
+
+  for (channel = GIMP_HISTOGRAM_VALUE;
+       channel <= GIMP_HISTOGRAM_ALPHA;
+       channel++)
+    for (bin = 0; bin < 256; bin++)
+      g_assert_cmpfloat (gimp_histogram_get_value (histogram, channel, bin),
+                         ==,
+                         gimp_histogram_get_value (expected, channel, bin));
+
+  gimp_histogram_unref (expected);
+}
+
+/**
+ * invalidate:
+ *
+ * Test that a cached histogram catches up with painting in the
+ * invalidated area, and keeps the values of the other rows of tiles.
+ **/
+static void
+invalidate (void)
+{
+  GimpHistogram *histogram = gimp_histogram_new ();
+  TileManager   *tiles     = histogram_test_tiles_new ();
+  PixelRegion    region;
+  guchar         color[4]  = { 0x10, 0x20, 0x30, 0xff };
+
+  pixel_region_init (&region, tiles, 10, 20, WIDTH - 10, HEIGHT - 30, FALSE);
+  gimp_histogram_calculate_cached (histogram, &region, NULL);
+  histogram_test_compare (histogram, tiles);
+
+  pixel_region_init (&region, tiles, 50, 100, 40, 90, TRUE);
+  color_region (&region, color);
+  gimp_histogram_invalidate (histogram, 50, 100, 40, 90);
+
+  pixel_region_init (&region, tiles, 10, 20, WIDTH - 10, HEIGHT - 30, FALSE);
+  gimp_histogram_calculate_cached (histogram, &region, NULL);
+  histogram_test_compare (histogram, tiles);
+
+  tile_manager_unref (tiles);
+  gimp_histogram_unref (histogram);
+}
+
+/**
+ * invalidate_all:
+ *
+ * Test that gimp_histogram_invalidate_all() makes the next calculation
+ * see all changes.
+ **/
+static void
+invalidate_all (void)
+{
+  GimpHistogram *histogram = gimp_histogram_new ();
+  TileManager   *tiles     = histogram_test_tiles_new ();
+  PixelRegion    region;
+  guchar         color[4]  = { 0x80, 0x80, 0x80, 0x80 };
+
+  pixel_region_init (&region, tiles, 10, 20, WIDTH - 10, HEIGHT - 30, FALSE);
+  gimp_histogram_calculate_cached (histogram, &region, NULL);
+
+  pixel_region_init (&region, tiles, 0, 0, WIDTH, HEIGHT, TRUE);
+  color_region (&region, color);
+  gimp_histogram_invalidate_all (histogram);
+
+  pixel_region_init (&region, tiles, 10, 20, WIDTH - 10, HEIGHT - 30, FALSE);
+  gimp_histogram_calculate_cached (histogram, &region, NULL);
+  histogram_test_compare (histogram, tiles);
+
+  tile_manager_unref (tiles);
+  gimp_histogram_unref (histogram);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_type_init ();
+  tile_cache_init (G_MAXUINT32);
+  g_test_init (&argc, &argv, NULL);
+
+  ADD_TEST (invalidate);
+  ADD_TEST (invalidate_all);
+
+  return g_test_run ();
+}
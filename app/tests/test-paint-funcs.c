@@ -0,0 +1,366 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include <glib-object.h>
+
+#include "libgimpmath/gimpmath.h"
+
+#include "paint-funcs/paint-funcs-types.h"
+
+#include "base/pixel-processor.h"
+#include "base/pixel-region.h"
+#include "base/tile-cache.h"
+#include "base/tile-compress.h"
+#include "base/tile-manager.h"
+
+#include "paint-funcs/paint-funcs.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/paint-funcs/" #function, function);
+
+#define WIDTH   250
+#define HEIGHT  190
+
+/*  the part of the mask the operations work on, not aligned to tiles  */
+#define X       5
+#define Y       3
+#define W       (WIDTH - 2 * X)
+#define H       (HEIGHT - 2 * Y)
+
+
+typedef enum
+{
+  TEST_SHAPE_RECT,
+  TEST_SHAPE_DISC
+} TestShape;
+
+
+static TileManager *
+paint_funcs_test_mask (TestShape shape)
+{
+  TileManager *tiles = tile_manager_new (WIDTH, HEIGHT, 1);
+  guchar      *row   = g_new (guchar, WIDTH);
+  PixelRegion  region;
+  gint         x, y;
+
+  pixel_region_init (&region, tiles, 0, 0, WIDTH, HEIGHT, TRUE);
+
+  for (y = 0; y < HEIGHT; y++)
+    {
+      for (x = 0; x < WIDTH; x++)
+        {
+          gboolean inside;
+
+          if (shape == TEST_SHAPE_RECT)
+            inside = (x >= 95 && x < 155 && y >= 70 && y < 120);
+          else
+            inside = SQR (x - WIDTH / 2) + SQR (y - HEIGHT / 2) < SQR (30);
+
+          row[x] = inside ? 255 : 0;
+        }
+
+      pixel_region_set_row (&region, 0, y, WIDTH, row);
+    }
+
+  g_free (row);
+
+  return tiles;
+}
+
+/*  Returns the largest difference between a and b, and their mean
+ *  difference in mean_diff.
+ */
+static gint
+paint_funcs_test_compare (TileManager *a,
+                          TileManager *b,
+                          gdouble     *mean_diff)
+{
+  guchar      *row_a = g_new (guchar, WIDTH);
+  guchar      *row_b = g_new (guchar, WIDTH);
+  PixelRegion  region_a;
+  PixelRegion  region_b;
+  gint         max_diff = 0;
+  gdouble      sum      = 0.0;
+  gint         x, y;
+
+  pixel_region_init (&region_a, a, 0, 0, WIDTH, HEIGHT, FALSE);
+  pixel_region_init (&region_b, b, 0, 0, WIDTH, HEIGHT, FALSE);
+
+  for (y = 0; y < HEIGHT; y++)
+    {
+      pixel_region_get_row (&region_a, 0, y, WIDTH, row_a, 1);
+      pixel_region_get_row (&region_b, 0, y, WIDTH, row_b, 1);
+
+      for (x = 0; x < WIDTH; x++)
+        {
+          gint diff = abs (row_a[x] - row_b[x]);
+
+          max_diff  = MAX (max_diff, diff);
+          sum      += diff;
+        }
+    }
+
+  g_free (row_a);
+  g_free (row_b);
+
+  if (mean_diff)
+    *mean_diff = sum / (WIDTH * HEIGHT);
+
+  return max_diff;
+}
+
+static void
+paint_funcs_test_gaussian_blur (TestShape shape,
+                                gdouble   radius)
+{
+  TileManager *iir       = paint_funcs_test_mask (shape);
+  TileManager *reference = paint_funcs_test_mask (shape);
+  PixelRegion  region;
+  gdouble      mean_diff;
+
+  pixel_region_init (&region, iir, X, Y, W, H, TRUE);
+  gaussian_blur_region (&region, radius, radius);
+
+  pixel_region_init (&region, reference, X, Y, W, H, TRUE);
+  gaussian_blur_region_reference (&region, radius, radius);
+
+  /*  the recursive filter only approximates the gaussian curve  */
+  g_assert_cmpint (paint_funcs_test_compare (iir, reference, &mean_diff),
+                   <=, 8);
+  g_assert_cmpfloat (mean_diff, <=, 0.5);
+
+  tile_manager_unref (iir);
+  tile_manager_unref (reference);
+}
+
+/**
+ * gaussian_blur_iir:
+ *
+ * Test that the recursive filter gaussian_blur_region() uses for large
+ * radii stays close to the direct convolution.
+ **/
+static void
+gaussian_blur_iir (void)
+{
+  paint_funcs_test_gaussian_blur (TEST_SHAPE_RECT, 10.0);
+  paint_funcs_test_gaussian_blur (TEST_SHAPE_DISC, 10.0);
+  paint_funcs_test_gaussian_blur (TEST_SHAPE_RECT, 25.0);
+  paint_funcs_test_gaussian_blur (TEST_SHAPE_DISC, 25.0);
+}
+
+/**
+ * gaussian_blur_small_radius:
+ *
+ * Test that small radii still use the direct convolution.
+ **/
+static void
+gaussian_blur_small_radius (void)
+{
+  TileManager *blurred   = paint_funcs_test_mask (TEST_SHAPE_DISC);
+  TileManager *reference = paint_funcs_test_mask (TEST_SHAPE_DISC);
+  PixelRegion  region;
+
+  pixel_region_init (&region, blurred, X, Y, W, H, TRUE);
+  gaussian_blur_region (&region, 3.0, 3.0);
+
+  pixel_region_init (&region, reference, X, Y, W, H, TRUE);
+  gaussian_blur_region_reference (&region, 3.0, 3.0);
+
+  g_assert_cmpint (paint_funcs_test_compare (blurred, reference, NULL),
+                   ==, 0);
+
+  tile_manager_unref (blurred);
+  tile_manager_unref (reference);
+}
+
+static void
+paint_funcs_test_grow (TileManager *mask,
+                       gint16       xradius,
+                       gint16       yradius)
+{
+  gint i;
+
+  /*  fatten, thin, thin with edge lock  */
+  for (i = 0; i < 3; i++)
+    {
+      TileManager *grown  = tile_manager_duplicate (mask);
+      TileManager *expect = tile_manager_duplicate (mask);
+      PixelRegion  region;
+
+      pixel_region_init (&region, grown, X, Y, W, H, TRUE);
+
+      if (i == 0)
+        fatten_region (&region, xradius, yradius);
+      else
+        thin_region (&region, xradius, yradius, i == 2);
+
+      pixel_region_init (&region, expect, X, Y, W, H, TRUE);
+
+      if (i == 0)
+        fatten_region_reference (&region, xradius, yradius);
+      else
+        thin_region_reference (&region, xradius, yradius, i == 2);
+
+      g_assert_cmpint (paint_funcs_test_compare (grown, expect, NULL), ==, 0);
+
+      tile_manager_unref (grown);
+      tile_manager_unref (expect);
+    }
+}
+
+/**
+ * grow_binary:
+ *
+ * Test that growing and shrinking masks with only two values, which
+ * uses the distance transform, gives the result of the max and min
+ * filters.
+ **/
+static void
+grow_binary (void)
+{
+  TileManager *rect = paint_funcs_test_mask (TEST_SHAPE_RECT);
+  TileManager *disc = paint_funcs_test_mask (TEST_SHAPE_DISC);
+
+  paint_funcs_test_grow (rect, 5, 9);
+  paint_funcs_test_grow (rect, 40, 3);
+  paint_funcs_test_grow (disc, 7, 7);
+  paint_funcs_test_grow (disc, 2, 60);
+
+  tile_manager_unref (rect);
+  tile_manager_unref (disc);
+}
+
+/**
+ * grow_feathered:
+ *
+ * Test that growing and shrinking feathered masks gives the result of
+ * the max and min filters.
+ **/
+static void
+grow_feathered (void)
+{
+  TileManager *disc = paint_funcs_test_mask (TEST_SHAPE_DISC);
+  PixelRegion  region;
+
+  pixel_region_init (&region, disc, 0, 0, WIDTH, HEIGHT, TRUE);
+  gaussian_blur_region_reference (&region, 10.0, 10.0);
+
+  paint_funcs_test_grow (disc, 5, 9);
+  paint_funcs_test_grow (disc, 12, 4);
+
+  tile_manager_unref (disc);
+}
+
+/**
+ * shapeburst:
+ *
+ * Test that the distances of shapeburst_region() are exact, also
+ * across the bands of rows it works on.
+ **/
+static void
+shapeburst (void)
+{
+  const gint   width   = 40;
+  const gint   height  = 700;
+  const gint   holes[] = { 10, 20,  30, 290,  5, 300,  25, 650 };
+  TileManager *mask    = tile_manager_new (width, height, 1);
+  TileManager *dist    = tile_manager_new (width, height, sizeof (gfloat));
+  guchar      *row     = g_new (guchar, width);
+  gfloat      *values  = g_new (gfloat, width);
+  PixelRegion  maskPR;
+  PixelRegion  distPR;
+  gfloat       max;
+  gint         x, y, i;
+
+  pixel_region_init (&maskPR, mask, 0, 0, width, height, TRUE);
+
+  for (y = 0; y < height; y++)
+    {
+      for (x = 0; x < width; x++)
+        {
+          row[x] = 255;
+
+          for (i = 0; i < G_N_ELEMENTS (holes); i += 2)
+            if (x == holes[i] && y == holes[i + 1])
+              row[x] = 0;
+        }
+
+      pixel_region_set_row (&maskPR, 0, y, width, row);
+    }
+
+  pixel_region_init (&maskPR, mask, 0, 0, width, height, FALSE);
+  pixel_region_init (&distPR, dist, 0, 0, width, height, TRUE);
+
+  max = shapeburst_region (&maskPR, &distPR, NULL, NULL);
+
+  /*  half the width, away from the holes  */
+  g_assert_cmpfloat (fabs (max - 20.0), <, 1e-4);
+
+  pixel_region_init (&distPR, dist, 0, 0, width, height, FALSE);
+
+  for (y = 0; y < height; y++)
+    {
+      pixel_region_get_row (&distPR, 0, y, width, (guchar *) values, 1);
+
+      for (x = 0; x < width; x++)
+        {
+          gdouble expected = MIN (MIN (x + 1, width - x),
+                                  MIN (y + 1, height - y));
+
+          expected = SQR (expected);
+
+          for (i = 0; i < G_N_ELEMENTS (holes); i += 2)
+            expected = MIN (expected,
+                            SQR (x - holes[i]) + SQR (y - holes[i + 1]));
+
+          expected = expected > 0 ? sqrt (expected) : 0.0;
+
+          g_assert_cmpfloat (fabs (values[x] - expected), <, 1e-4);
+        }
+    }
+
+  g_free (row);
+  g_free (values);
+
+  tile_manager_unref (mask);
+  tile_manager_unref (dist);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_thread_init (NULL);
+  g_type_init ();
+  tile_cache_init (64 * 1024 * 1024);
+  tile_compress_init (0);
+  pixel_processor_init (4);
+  g_test_init (&argc, &argv, NULL);
+
+  ADD_TEST (gaussian_blur_iir);
+  ADD_TEST (gaussian_blur_small_radius);
+  ADD_TEST (grow_binary);
+  ADD_TEST (grow_feathered);
+  ADD_TEST (shapeburst);
+
+  return g_test_run ();
+}
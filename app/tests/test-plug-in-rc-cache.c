@@ -0,0 +1,574 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "plug-in/plug-in-types.h"
+
+#include "core/gimp.h"
+
+#include "pdb/gimp-pdb-compat.h"
+
+#include "plug-in/gimpplugindef.h"
+#include "plug-in/gimppluginprocedure.h"
+#include "plug-in/plug-in-rc.h"
+#include "plug-in/plug-in-rc-cache.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-plug-in-rc-cache/" #function, gimp, function);
+
+#define GIMP_TEST_PLUG_IN_DIR  "/usr/lib/gimp/2.0/plug-ins"
+
+
+/*  an inline pixbuf icon is stored as raw bytes, so it contains
+ *  bytes that need quoting in pluginrc and a NUL
+ */
+static const guint8 gimp_test_icon_data[] =
+{
+  'G', 'd', 'k', 'P', 0x00, 0x00, 0x00, 0x18, '"', '\\', '\n', 0xff,
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b
+};
+
+
+static GimpPlugInProcedure *
+gimp_test_procedure_new (const gchar *prog,
+                         const gchar *name,
+                         const gchar *image_types)
+{
+  GimpProcedure       *procedure;
+  GimpPlugInProcedure *proc;
+
+  procedure = gimp_plug_in_procedure_new (GIMP_PLUGIN, prog);
+  proc      = GIMP_PLUG_IN_PROCEDURE (procedure);
+
+  gimp_object_set_name (GIMP_OBJECT (procedure), name);
+  gimp_procedure_set_strings (procedure,
+                              name,
+                              "A procedure for testing",
+                              "Does nothing, it only exists to be "
+                              "written to pluginrc and read back",
+                              "Test Author",
+                              "Test Author",
+                              "2012",
+                              NULL);
+
+  gimp_plug_in_procedure_set_image_types (proc, image_types);
+
+  return proc;
+}
+
+static void
+gimp_test_procedure_add_arg (Gimp           *gimp,
+                             GimpProcedure  *procedure,
+                             GimpPDBArgType  arg_type,
+                             const gchar    *name,
+                             const gchar    *desc,
+                             gboolean        return_value)
+{
+  GParamSpec *pspec = gimp_pdb_compat_param_spec (gimp, arg_type, name, desc);
+
+  if (return_value)
+    gimp_procedure_add_return_value (procedure, pspec);
+  else
+    gimp_procedure_add_argument (procedure, pspec);
+}
+
+/**
+ * gimp_test_create_plug_in_defs:
+ * @gimp:
+ *
+ * Creates a filter plug-in with a menu entry, a stock icon and an
+ * inline pixbuf icon, a file plug-in with a load and a save
+ * procedure, and a plug-in without procedures that isn't written.
+ *
+ * Returns: the #GimpPlugInDefs.
+ **/
+static GSList *
+gimp_test_create_plug_in_defs (Gimp *gimp)
+{
+  GimpPlugInDef       *plug_in_def;
+  GimpPlugInProcedure *proc;
+  GimpProcedure       *procedure;
+  GSList              *plug_in_defs = NULL;
+
+  /*  a filter  */
+  plug_in_def = gimp_plug_in_def_new (GIMP_TEST_PLUG_IN_DIR "/test-filter");
+  plug_in_def->mtime = 1234567890;
+
+  gimp_plug_in_def_set_locale_domain (plug_in_def,
+                                      "gimp20-test", "/usr/share/locale");
+  gimp_plug_in_def_set_help_domain (plug_in_def,
+                                    "org.gimp.test", "http://example.org/");
+  gimp_plug_in_def_set_has_init (plug_in_def, TRUE);
+
+  proc      = gimp_test_procedure_new (plug_in_def->prog,
+                                       "plug-in-test-filter", "RGB*, GRAY*");
+  procedure = GIMP_PROCEDURE (proc);
+
+  proc->menu_label = g_strdup ("_Test Filter...");
+  proc->menu_paths = g_list_append (proc->menu_paths,
+                                    g_strdup ("<Image>/Filters/Test"));
+  proc->menu_paths = g_list_append (proc->menu_paths,
+                                    g_strdup ("<Layers>/Test"));
+
+  gimp_plug_in_procedure_set_icon (proc, GIMP_ICON_TYPE_STOCK_ID,
+                                   (const guint8 *) "gtk-execute", 1);
+
+  gimp_test_procedure_add_arg (gimp, procedure, GIMP_PDB_INT32,
+                               "run-mode", "The run mode", FALSE);
+  gimp_test_procedure_add_arg (gimp, procedure, GIMP_PDB_IMAGE,
+                               "image", "Input image", FALSE);
+  gimp_test_procedure_add_arg (gimp, procedure, GIMP_PDB_DRAWABLE,
+                               "drawable", "Input drawable", FALSE);
+  gimp_test_procedure_add_arg (gimp, procedure, GIMP_PDB_FLOAT,
+                               "amount", "The \"amount\"", FALSE);
+  gimp_test_procedure_add_arg (gimp, procedure, GIMP_PDB_COLOR,
+                               "color", NULL, FALSE);
+  gimp_test_procedure_add_arg (gimp, procedure, GIMP_PDB_INT32,
+                               "result", "The result", TRUE);
+
+  gimp_plug_in_def_add_procedure (plug_in_def, proc);
+  g_object_unref (proc);
+
+  proc = gimp_test_procedure_new (plug_in_def->prog,
+                                  "plug-in-test-filter-pixbuf", "RGBA");
+
+  gimp_plug_in_procedure_set_icon (proc, GIMP_ICON_TYPE_INLINE_PIXBUF,
+                                   gimp_test_icon_data,
+                                   sizeof (gimp_test_icon_data));
+
+  gimp_test_procedure_add_arg (gimp, GIMP_PROCEDURE (proc), GIMP_PDB_INT32,
+                               "run-mode", "The run mode", FALSE);
+
+  gimp_plug_in_def_add_procedure (plug_in_def, proc);
+  g_object_unref (proc);
+
+  plug_in_defs = g_slist_append (plug_in_defs, plug_in_def);
+
+  /*  a file plug-in  */
+  plug_in_def = gimp_plug_in_def_new (GIMP_TEST_PLUG_IN_DIR "/test-file");
+  plug_in_def->mtime = 1234567891;
+
+  proc      = gimp_test_procedure_new (plug_in_def->prog,
+                                       "file-test-load", NULL);
+  procedure = GIMP_PROCEDURE (proc);
+
+  gimp_plug_in_procedure_set_file_proc (proc, "tst,test", "test:",
+                                        "0,string,TEST");
+  gimp_plug_in_procedure_set_mime_type (proc, "image/x-test");
+  gimp_plug_in_procedure_set_thumb_loader (proc, "file-test-load-thumb");
+
+  gimp_test_procedure_add_arg (gimp, procedure, GIMP_PDB_INT32,
+                               "run-mode", "The run mode", FALSE);
+  gimp_test_procedure_add_arg (gimp, procedure, GIMP_PDB_STRING,
+                               "filename", "The name of the file", FALSE);
+  gimp_test_procedure_add_arg (gimp, procedure, GIMP_PDB_STRING,
+                               "raw-filename", "The name entered", FALSE);
+  gimp_test_procedure_add_arg (gimp, procedure, GIMP_PDB_IMAGE,
+                               "image", "Output image", TRUE);
+
+  gimp_plug_in_def_add_procedure (plug_in_def, proc);
+  g_object_unref (proc);
+
+  /*  pluginrc has no magics and thumbnail loaders for save procedures  */
+  proc      = gimp_test_procedure_new (plug_in_def->prog,
+                                       "file-test-save", "RGB*");
+  procedure = GIMP_PROCEDURE (proc);
+
+  gimp_plug_in_procedure_set_file_proc (proc, "tst", NULL, NULL);
+  gimp_plug_in_procedure_set_mime_type (proc, "image/x-test");
+
+  gimp_test_procedure_add_arg (gimp, procedure, GIMP_PDB_INT32,
+                               "run-mode", "The run mode", FALSE);
+  gimp_test_procedure_add_arg (gimp, procedure, GIMP_PDB_IMAGE,
+                               "image", "Input image", FALSE);
+  gimp_test_procedure_add_arg (gimp, procedure, GIMP_PDB_DRAWABLE,
+                               "drawable", "Drawable to save", FALSE);
+  gimp_test_procedure_add_arg (gimp, procedure, GIMP_PDB_STRING,
+                               "filename", "The name of the file", FALSE);
+  gimp_test_procedure_add_arg (gimp, procedure, GIMP_PDB_STRING,
+                               "raw-filename", "The name entered", FALSE);
+
+  gimp_plug_in_def_add_procedure (plug_in_def, proc);
+  g_object_unref (proc);
+
+  plug_in_defs = g_slist_append (plug_in_defs, plug_in_def);
+
+  /*  a plug-in that installs nothing  */
+  plug_in_def = gimp_plug_in_def_new (GIMP_TEST_PLUG_IN_DIR "/test-empty");
+
+  plug_in_defs = g_slist_append (plug_in_defs, plug_in_def);
+
+  return plug_in_defs;
+}
+
+/**
+ * gimp_test_write_pluginrc:
+ * @gimp:
+ * @pluginrc:
+ * @cachefile:
+ *
+ * Writes pluginrc and its binary cache for the test plug-ins.
+ **/
+static void
+gimp_test_write_pluginrc (Gimp        *gimp,
+                          const gchar *pluginrc,
+                          const gchar *cachefile)
+{
+  GSList *plug_in_defs = gimp_test_create_plug_in_defs (gimp);
+  GError *error        = NULL;
+
+  g_assert (plug_in_rc_write (plug_in_defs, pluginrc, &error));
+  g_assert_no_error (error);
+
+  g_assert (plug_in_rc_cache_write (plug_in_defs, cachefile, pluginrc,
+                                    &error));
+  g_assert_no_error (error);
+
+  g_slist_free_full (plug_in_defs, (GDestroyNotify) g_object_unref);
+}
+
+static void
+gimp_assert_pspecs_equal (GParamSpec *pspec,
+                          GParamSpec *expected)
+{
+  g_assert (G_PARAM_SPEC_VALUE_TYPE (pspec) ==
+            G_PARAM_SPEC_VALUE_TYPE (expected));
+  g_assert (G_PARAM_SPEC_TYPE (pspec) == G_PARAM_SPEC_TYPE (expected));
+  g_assert_cmpstr (g_param_spec_get_name (pspec),
+                   ==,
+                   g_param_spec_get_name (expected));
+  g_assert_cmpstr (g_param_spec_get_blurb (pspec),
+                   ==,
+                   g_param_spec_get_blurb (expected));
+}
+
+static void
+gimp_assert_procedures_equal (GimpPlugInProcedure *proc,
+                              GimpPlugInProcedure *expected)
+{
+  GimpProcedure *procedure          = GIMP_PROCEDURE (proc);
+  GimpProcedure *expected_procedure = GIMP_PROCEDURE (expected);
+  GList         *list;
+  GList         *expected_list;
+  gint           i;
+
+  g_assert_cmpstr (gimp_object_get_name (proc),
+                   ==,
+                   gimp_object_get_name (expected));
+  g_assert_cmpstr (procedure->original_name,
+                   ==,
+                   expected_procedure->original_name);
+  g_assert_cmpint (procedure->proc_type, ==, expected_procedure->proc_type);
+
+  g_assert_cmpstr (procedure->blurb,     ==, expected_procedure->blurb);
+  g_assert_cmpstr (procedure->help,      ==, expected_procedure->help);
+  g_assert_cmpstr (procedure->author,    ==, expected_procedure->author);
+  g_assert_cmpstr (procedure->copyright, ==, expected_procedure->copyright);
+  g_assert_cmpstr (procedure->date,      ==, expected_procedure->date);
+
+  g_assert_cmpstr (proc->prog,       ==, expected->prog);
+  g_assert_cmpstr (proc->menu_label, ==, expected->menu_label);
+  g_assert_cmpuint (proc->locale_domain, ==, expected->locale_domain);
+  g_assert_cmpuint (proc->help_domain,   ==, expected->help_domain);
+  g_assert_cmpint (proc->mtime, ==, expected->mtime);
+
+  g_assert_cmpuint (g_list_length (proc->menu_paths),
+                    ==,
+                    g_list_length (expected->menu_paths));
+
+  for (list = proc->menu_paths, expected_list = expected->menu_paths;
+       list;
+       list = g_list_next (list), expected_list = g_list_next (expected_list))
+    {
+      g_assert_cmpstr (list->data, ==, expected_list->data);
+    }
+
+  g_assert_cmpint (proc->icon_type,        ==, expected->icon_type);
+  g_assert_cmpint (proc->icon_data_length, ==, expected->icon_data_length);
+
+  switch (proc->icon_type)
+    {
+    case GIMP_ICON_TYPE_STOCK_ID:
+    case GIMP_ICON_TYPE_IMAGE_FILE:
+      g_assert_cmpstr ((gchar *) proc->icon_data,
+                       ==,
+                       (gchar *) expected->icon_data);
+      break;
+
+    case GIMP_ICON_TYPE_INLINE_PIXBUF:
+      g_assert (memcmp (proc->icon_data, expected->icon_data,
+                        proc->icon_data_length) == 0);
+      break;
+    }
+
+  g_assert_cmpint (proc->file_proc, ==, expected->file_proc);
+  g_assert_cmpstr (proc->extensions,   ==, expected->extensions);
+  g_assert_cmpstr (proc->prefixes,     ==, expected->prefixes);
+  g_assert_cmpstr (proc->magics,       ==, expected->magics);
+  g_assert_cmpstr (proc->mime_type,    ==, expected->mime_type);
+  g_assert_cmpstr (proc->thumb_loader, ==, expected->thumb_loader);
+
+  g_assert_cmpstr (proc->image_types, ==, expected->image_types);
+  g_assert_cmpint (proc->image_types_val, ==, expected->image_types_val);
+
+  g_assert_cmpint (procedure->num_args, ==, expected_procedure->num_args);
+  g_assert_cmpint (procedure->num_values, ==, expected_procedure->num_values);
+
+  for (i = 0; i < procedure->num_args; i++)
+    gimp_assert_pspecs_equal (procedure->args[i],
+                              expected_procedure->args[i]);
+
+  for (i = 0; i < procedure->num_values; i++)
+    gimp_assert_pspecs_equal (procedure->values[i],
+                              expected_procedure->values[i]);
+}
+
+/**
+ * gimp_assert_plug_in_defs_equal:
+ * @plug_in_defs:
+ * @expected:
+ *
+ * Asserts that two lists of #GimpPlugInDefs describe the same
+ * plug-ins and procedures, in the same order.
+ **/
+static void
+gimp_assert_plug_in_defs_equal (GSList *plug_in_defs,
+                                GSList *expected)
+{
+  g_assert_cmpuint (g_slist_length (plug_in_defs),
+                    ==,
+                    g_slist_length (expected));
+
+  for (; plug_in_defs;
+       plug_in_defs = g_slist_next (plug_in_defs),
+       expected     = g_slist_next (expected))
+    {
+      GimpPlugInDef *plug_in_def          = plug_in_defs->data;
+      GimpPlugInDef *expected_plug_in_def = expected->data;
+      GSList        *list;
+      GSList        *expected_list;
+
+      g_assert_cmpstr (plug_in_def->prog, ==, expected_plug_in_def->prog);
+      g_assert_cmpint (plug_in_def->mtime, ==, expected_plug_in_def->mtime);
+      g_assert_cmpstr (plug_in_def->locale_domain_name,
+                       ==,
+                       expected_plug_in_def->locale_domain_name);
+      g_assert_cmpstr (plug_in_def->locale_domain_path,
+                       ==,
+                       expected_plug_in_def->locale_domain_path);
+      g_assert_cmpstr (plug_in_def->help_domain_name,
+                       ==,
+                       expected_plug_in_def->help_domain_name);
+      g_assert_cmpstr (plug_in_def->help_domain_uri,
+                       ==,
+                       expected_plug_in_def->help_domain_uri);
+      g_assert_cmpint (plug_in_def->has_init,
+                       ==,
+                       expected_plug_in_def->has_init);
+
+      g_assert_cmpuint (g_slist_length (plug_in_def->procedures),
+                        ==,
+                        g_slist_length (expected_plug_in_def->procedures));
+
+      for (list = plug_in_def->procedures,
+           expected_list = expected_plug_in_def->procedures;
+           list;
+           list = g_slist_next (list),
+           expected_list = g_slist_next (expected_list))
+        {
+          gimp_assert_procedures_equal (list->data, expected_list->data);
+        }
+    }
+}
+
+/**
+ * read_matches_parse:
+ * @data:
+ *
+ * Test that reading the cache gives the same plug-ins as parsing the
+ * pluginrc it was written for.
+ **/
+static void
+read_matches_parse (gconstpointer data)
+{
+  Gimp   *gimp = GIMP (data);
+  gchar  *pluginrc;
+  gchar  *cachefile;
+  GSList *parsed;
+  GSList *cached;
+  GError *error = NULL;
+
+  pluginrc  = g_build_filename (g_get_tmp_dir (),
+                                "gimp-test-pluginrc", NULL);
+  cachefile = g_build_filename (g_get_tmp_dir (),
+                                "gimp-test-pluginrc.cache", NULL);
+
+  gimp_test_write_pluginrc (gimp, pluginrc, cachefile);
+
+  parsed = plug_in_rc_parse (gimp, pluginrc, &error);
+  g_assert_no_error (error);
+
+  /*  the plug-in without procedures is written to neither file  */
+  g_assert_cmpuint (g_slist_length (parsed), ==, 2);
+
+  cached = plug_in_rc_cache_read (gimp, cachefile, pluginrc);
+
+  gimp_assert_plug_in_defs_equal (cached, parsed);
+
+  g_slist_free_full (parsed, (GDestroyNotify) g_object_unref);
+  g_slist_free_full (cached, (GDestroyNotify) g_object_unref);
+
+  g_unlink (pluginrc);
+  g_unlink (cachefile);
+  g_free (pluginrc);
+  g_free (cachefile);
+}
+
+/**
+ * read_truncated:
+ * @data:
+ *
+ * Test that a cache that ends at any byte before its end, so within
+ * or right after any of its fields, is not used.
+ **/
+static void
+read_truncated (gconstpointer data)
+{
+  Gimp   *gimp = GIMP (data);
+  gchar  *pluginrc;
+  gchar  *cachefile;
+  gchar  *contents;
+  gsize   length;
+  GSList *cached;
+
+  pluginrc  = g_build_filename (g_get_tmp_dir (),
+                                "gimp-test-pluginrc", NULL);
+  cachefile = g_build_filename (g_get_tmp_dir (),
+                                "gimp-test-pluginrc.cache", NULL);
+
+  gimp_test_write_pluginrc (gimp, pluginrc, cachefile);
+
+  g_assert (g_file_get_contents (cachefile, &contents, &length, NULL));
+  g_free (contents);
+
+  cached = plug_in_rc_cache_read (gimp, cachefile, pluginrc);
+  g_assert_cmpuint (g_slist_length (cached), ==, 2);
+  g_slist_free_full (cached, (GDestroyNotify) g_object_unref);
+
+  while (length-- > 0)
+    {
+      g_assert (truncate (cachefile, length) == 0);
+
+      cached = plug_in_rc_cache_read (gimp, cachefile, pluginrc);
+      g_assert (cached == NULL);
+    }
+
+  g_unlink (pluginrc);
+  g_unlink (cachefile);
+  g_free (pluginrc);
+  g_free (cachefile);
+}
+
+/**
+ * read_stale:
+ * @data:
+ *
+ * Test that a cache is not used once pluginrc was changed after it
+ * was written.
+ **/
+static void
+read_stale (gconstpointer data)
+{
+  Gimp   *gimp = GIMP (data);
+  gchar  *pluginrc;
+  gchar  *cachefile;
+  GSList *plug_in_defs;
+  GError *error = NULL;
+
+  pluginrc  = g_build_filename (g_get_tmp_dir (),
+                                "gimp-test-pluginrc", NULL);
+  cachefile = g_build_filename (g_get_tmp_dir (),
+                                "gimp-test-pluginrc.cache", NULL);
+
+  gimp_test_write_pluginrc (gimp, pluginrc, cachefile);
+
+  /*  write pluginrc without the file plug-in  */
+  plug_in_defs = gimp_test_create_plug_in_defs (gimp);
+  g_object_unref (plug_in_defs->next->data);
+  plug_in_defs = g_slist_delete_link (plug_in_defs, plug_in_defs->next);
+
+  g_assert (plug_in_rc_write (plug_in_defs, pluginrc, &error));
+  g_assert_no_error (error);
+
+  g_slist_free_full (plug_in_defs, (GDestroyNotify) g_object_unref);
+
+  g_assert (plug_in_rc_cache_read (gimp, cachefile, pluginrc) == NULL);
+
+  g_unlink (pluginrc);
+  g_unlink (cachefile);
+  g_free (pluginrc);
+  g_free (cachefile);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_thread_init (NULL);
+  g_type_init ();
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  ADD_TEST (read_matches_parse);
+  ADD_TEST (read_truncated);
+  ADD_TEST (read_stale);
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
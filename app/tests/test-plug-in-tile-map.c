@@ -0,0 +1,487 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+#include "libgimpbase/gimpwire.h"
+
+#include "plug-in/plug-in-types.h"
+
+#include "base/tile.h"
+#include "base/tile-manager.h"
+
+#include "core/gimp.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+#include "core/gimplayer.h"
+
+#include "pdb/gimppdbcontext.h"
+
+#include "plug-in/gimpplugin.h"
+#include "plug-in/gimpplugin-message.h"
+#include "plug-in/gimpplugin-tilemap.h"
+#include "plug-in/gimppluginmanager.h"
+#include "plug-in/gimppluginshm.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+/*  three columns and three rows of tiles, the last ones partial  */
+#define WIDTH   150
+#define HEIGHT  140
+#define BPP     4
+
+#define STRIDE  (WIDTH * BPP)
+
+/*  covers the tiles in columns 1 and 2 of rows 0 and 1  */
+#define MAP_X       70
+#define MAP_Y       10
+#define MAP_WIDTH   60
+#define MAP_HEIGHT  60
+
+#define N_COLS  ((WIDTH + TILE_WIDTH - 1) / TILE_WIDTH)
+
+#define ADD_TEST(function) \
+  g_test_add ("/gimp-plug-in-tile-map/" #function, \
+              GimpTestFixture, \
+              gimp, \
+              gimp_test_tile_map_setup, \
+              function, \
+              gimp_test_tile_map_teardown);
+
+
+typedef struct
+{
+  GimpImage    *image;
+  GimpDrawable *drawable;
+  GimpPlugIn   *plug_in;
+  guchar       *expected;
+} GimpTestFixture;
+
+
+static void
+gimp_test_open_channels (GimpPlugIn *plug_in)
+{
+  gint my_read[2];
+  gint my_write[2];
+
+  g_assert (pipe (my_read) == 0);
+  g_assert (pipe (my_write) == 0);
+
+  plug_in->my_read   = g_io_channel_unix_new (my_read[0]);
+  plug_in->my_write  = g_io_channel_unix_new (my_write[1]);
+  plug_in->his_read  = g_io_channel_unix_new (my_write[0]);
+  plug_in->his_write = g_io_channel_unix_new (my_read[1]);
+
+  g_io_channel_set_encoding (plug_in->my_read, NULL, NULL);
+  g_io_channel_set_encoding (plug_in->my_write, NULL, NULL);
+  g_io_channel_set_encoding (plug_in->his_read, NULL, NULL);
+  g_io_channel_set_encoding (plug_in->his_write, NULL, NULL);
+
+  g_io_channel_set_buffered (plug_in->my_read, FALSE);
+  g_io_channel_set_buffered (plug_in->my_write, FALSE);
+  g_io_channel_set_buffered (plug_in->his_read, FALSE);
+  g_io_channel_set_buffered (plug_in->his_write, FALSE);
+
+  g_io_channel_set_close_on_unref (plug_in->my_read, TRUE);
+  g_io_channel_set_close_on_unref (plug_in->my_write, TRUE);
+  g_io_channel_set_close_on_unref (plug_in->his_read, TRUE);
+  g_io_channel_set_close_on_unref (plug_in->his_write, TRUE);
+}
+
+static void
+gimp_test_close_channels (GimpPlugIn *plug_in)
+{
+  g_io_channel_unref (plug_in->my_read);
+  g_io_channel_unref (plug_in->my_write);
+  g_io_channel_unref (plug_in->his_read);
+  g_io_channel_unref (plug_in->his_write);
+
+  plug_in->my_read   = NULL;
+  plug_in->my_write  = NULL;
+  plug_in->his_read  = NULL;
+  plug_in->his_write = NULL;
+}
+
+/**
+ * gimp_test_tile_map_setup:
+ * @fixture:
+ * @data:
+ *
+ * Creates a layer with a pattern and a plug-in that is connected to
+ * the test through pipes instead of running.
+ **/
+static void
+gimp_test_tile_map_setup (GimpTestFixture *fixture,
+                          gconstpointer    data)
+{
+  Gimp        *gimp = GIMP (data);
+  GimpLayer   *layer;
+  GimpContext *context;
+  gint         i;
+
+  fixture->image = gimp_image_new (gimp, WIDTH, HEIGHT, GIMP_RGB);
+
+  layer = gimp_layer_new (fixture->image, WIDTH, HEIGHT, GIMP_RGBA_IMAGE,
+                          "layer", GIMP_OPACITY_OPAQUE, GIMP_NORMAL_MODE);
+  gimp_image_add_layer (fixture->image, layer, NULL, 0, FALSE /*push_undo*/);
+
+  fixture->drawable = GIMP_DRAWABLE (layer);
+  fixture->expected = g_new (guchar, STRIDE * HEIGHT);
+
+  for (i = 0; i < STRIDE * HEIGHT; i++)
+    fixture->expected[i] = i * 7 + i / STRIDE;
+
+  tile_manager_write_pixel_data (gimp_drawable_get_tiles (fixture->drawable),
+                                 0, 0, WIDTH - 1, HEIGHT - 1,
+                                 fixture->expected, STRIDE);
+
+  context = gimp_pdb_context_new (gimp, gimp_get_user_context (gimp), FALSE);
+
+  fixture->plug_in = gimp_plug_in_new (gimp->plug_in_manager,
+                                       context, NULL, NULL,
+                                       "/test-plug-in-tile-map");
+  g_object_unref (context);
+
+  gimp_test_open_channels (fixture->plug_in);
+  fixture->plug_in->open = TRUE;
+}
+
+static void
+gimp_test_tile_map_teardown (GimpTestFixture *fixture,
+                             gconstpointer    data)
+{
+  fixture->plug_in->open = FALSE;
+
+  gimp_plug_in_tile_map_remove_all (fixture->plug_in);
+  gimp_test_close_channels (fixture->plug_in);
+
+  g_object_unref (fixture->plug_in);
+  g_object_unref (fixture->image);
+  g_free (fixture->expected);
+}
+
+/*  Has the core read and handle the message the plug-in sent.  */
+static void
+gimp_test_dispatch (GimpPlugIn *plug_in)
+{
+  GimpWireMessage msg;
+
+  g_assert (gimp_wire_read_msg (plug_in->my_read, &msg, plug_in));
+
+  gimp_plug_in_handle_message (plug_in, &msg);
+
+  gimp_wire_destroy (&msg);
+}
+
+/*  Sends GP_TILE_MAP, and returns the map ID of the reply, or 0.  */
+static gint
+gimp_test_map (GimpTestFixture *fixture,
+               gint             x,
+               gint             y,
+               gint             width,
+               gint             height)
+{
+  GimpPlugIn      *plug_in = fixture->plug_in;
+  GPTileMap        tile_map;
+  GPTileMap       *reply;
+  GimpWireMessage  msg;
+  gint             map_ID;
+
+  tile_map.drawable_ID = gimp_item_get_ID (GIMP_ITEM (fixture->drawable));
+  tile_map.shadow      = FALSE;
+  tile_map.x           = x;
+  tile_map.y           = y;
+  tile_map.width       = width;
+  tile_map.height      = height;
+  tile_map.map_ID      = 0;
+  tile_map.shm_ID      = -1;
+
+  g_assert (gp_tile_map_write (plug_in->his_write, &tile_map, plug_in));
+  gimp_test_dispatch (plug_in);
+
+  g_assert (gimp_wire_read_msg (plug_in->his_read, &msg, plug_in));
+  g_assert_cmpint (msg.type, ==, GP_TILE_MAP);
+
+  reply = msg.data;
+  g_assert_cmpint (reply->drawable_ID, ==, tile_map.drawable_ID);
+  g_assert_cmpint (reply->shadow, ==, FALSE);
+
+  map_ID = reply->shm_ID != -1 ? reply->map_ID : 0;
+
+  gimp_wire_destroy (&msg);
+
+  return map_ID;
+}
+
+/*  Sends GP_TILE_UNMAP with one dirty tile and waits for the ack.  */
+static void
+gimp_test_unmap (GimpPlugIn *plug_in,
+                 gint        map_ID,
+                 guint32     dirty_tile,
+                 gboolean    detach)
+{
+  GPTileUnmap     tile_unmap;
+  GimpWireMessage msg;
+
+  tile_unmap.map_ID      = map_ID;
+  tile_unmap.detach      = detach;
+  tile_unmap.n_dirty     = 1;
+  tile_unmap.dirty_tiles = &dirty_tile;
+
+  g_assert (gp_tile_unmap_write (plug_in->his_write, &tile_unmap, plug_in));
+  gimp_test_dispatch (plug_in);
+
+  g_assert (gimp_wire_read_msg (plug_in->his_read, &msg, plug_in));
+  g_assert_cmpint (msg.type, ==, GP_TILE_ACK);
+  gimp_wire_destroy (&msg);
+}
+
+/*  The layout of the mapped tiles as documented in
+ *  gimpplugin-tilemap.c, for the map of the MAP_* rectangle.
+ */
+static guchar *
+gimp_test_tile_addr (GimpPlugInShm *shm,
+                     gint           col,
+                     gint           row)
+{
+  const gint col0   = MAP_X / TILE_WIDTH;
+  const gint row0   = MAP_Y / TILE_HEIGHT;
+  const gint width  = WIDTH - col0 * TILE_WIDTH;
+  const gint height = MIN (TILE_HEIGHT, HEIGHT - row * TILE_HEIGHT);
+
+  return (gimp_plug_in_shm_get_addr (shm) +
+          ((row - row0) * TILE_HEIGHT * width +
+           (col - col0) * TILE_WIDTH  * height) * BPP);
+}
+
+/*  Compares the tile's pixels in the segment, or inverts them.  */
+static void
+gimp_test_tile_pixels (GimpPlugInShm *shm,
+                       const guchar  *expected,
+                       gint           col,
+                       gint           row,
+                       gboolean       invert)
+{
+  guchar *addr   = gimp_test_tile_addr (shm, col, row);
+  gint    width  = MIN (TILE_WIDTH,  WIDTH  - col * TILE_WIDTH);
+  gint    height = MIN (TILE_HEIGHT, HEIGHT - row * TILE_HEIGHT);
+  gint    y;
+
+  for (y = 0; y < height; y++)
+    {
+      const guchar *src = (expected +
+                           (row * TILE_HEIGHT + y) * STRIDE +
+                           col * TILE_WIDTH * BPP);
+      gint          x;
+
+      if (invert)
+        {
+          for (x = 0; x < width * BPP; x++)
+            addr[x] ^= 0xff;
+        }
+      else
+        {
+          g_assert (memcmp (addr, src, width * BPP) == 0);
+        }
+
+      addr += width * BPP;
+    }
+}
+
+static void
+gimp_test_invert_expected (guchar *expected,
+                           gint    col,
+                           gint    row)
+{
+  gint width  = MIN (TILE_WIDTH,  WIDTH  - col * TILE_WIDTH);
+  gint height = MIN (TILE_HEIGHT, HEIGHT - row * TILE_HEIGHT);
+  gint y;
+
+  for (y = 0; y < height; y++)
+    {
+      guchar *dest = (expected +
+                      (row * TILE_HEIGHT + y) * STRIDE +
+                      col * TILE_WIDTH * BPP);
+      gint    x;
+
+      for (x = 0; x < width * BPP; x++)
+        dest[x] ^= 0xff;
+    }
+}
+
+static void
+gimp_test_check_drawable (GimpTestFixture *fixture)
+{
+  guchar *buffer = g_new (guchar, STRIDE * HEIGHT);
+
+  tile_manager_read_pixel_data (gimp_drawable_get_tiles (fixture->drawable),
+                                0, 0, WIDTH - 1, HEIGHT - 1,
+                                buffer, STRIDE);
+
+  g_assert (memcmp (buffer, fixture->expected, STRIDE * HEIGHT) == 0);
+
+  g_free (buffer);
+}
+
+/**
+ * map_write_unmap:
+ * @fixture:
+ * @data:
+ *
+ * Test that only the tiles covering the requested rectangle are mapped
+ * and filled, and that syncing and unmapping the map copy back exactly
+ * the tiles the plug-in says it changed.
+ **/
+static void
+map_write_unmap (GimpTestFixture *fixture,
+                 gconstpointer    data)
+{
+  GimpPlugIn    *plug_in = fixture->plug_in;
+  GimpPlugInShm *shm;
+  gint           map_ID;
+  gint           col, row;
+
+  map_ID = gimp_test_map (fixture, MAP_X, MAP_Y, MAP_WIDTH, MAP_HEIGHT);
+  g_assert_cmpint (map_ID, !=, 0);
+
+  shm = gimp_plug_in_tile_map_get_shm (plug_in, map_ID);
+  g_assert (shm != NULL);
+
+  /*  columns 1 and 2, rows 0 and 1 only  */
+  g_assert_cmpuint (gimp_plug_in_shm_get_size (shm), >=,
+                    (WIDTH - TILE_WIDTH) * 2 * TILE_HEIGHT * BPP);
+  g_assert_cmpuint (gimp_plug_in_shm_get_size (shm), <,
+                    WIDTH * HEIGHT * BPP);
+
+  for (row = 0; row < 2; row++)
+    for (col = 1; col < 3; col++)
+      gimp_test_tile_pixels (shm, fixture->expected, col, row, FALSE);
+
+  /*  the plug-in changes two tiles, but has only one copied back  */
+  gimp_test_tile_pixels (shm, fixture->expected, 2, 0, TRUE);
+  gimp_test_tile_pixels (shm, fixture->expected, 1, 1, TRUE);
+
+  gimp_test_unmap (plug_in, map_ID, 0 * N_COLS + 2, FALSE);
+
+  gimp_test_invert_expected (fixture->expected, 2, 0);
+  gimp_test_check_drawable (fixture);
+
+  g_assert (gimp_plug_in_tile_map_get_drawable (plug_in, map_ID, NULL) ==
+            fixture->drawable);
+
+  /*  then the other one, and frees the map  */
+  gimp_test_unmap (plug_in, map_ID, 1 * N_COLS + 1, TRUE);
+
+  gimp_test_invert_expected (fixture->expected, 1, 1);
+  gimp_test_check_drawable (fixture);
+
+  g_assert (gimp_plug_in_tile_map_get_drawable (plug_in, map_ID, NULL) ==
+            NULL);
+}
+
+/**
+ * map_outside:
+ * @fixture:
+ * @data:
+ *
+ * Test that a rectangle outside of the drawable isn't mapped.
+ **/
+static void
+map_outside (GimpTestFixture *fixture,
+             gconstpointer    data)
+{
+  g_assert_cmpint (gimp_test_map (fixture, WIDTH, 0, 10, 10), ==, 0);
+  g_assert_cmpint (gimp_test_map (fixture, 0, 0, 0, HEIGHT), ==, 0);
+
+  g_assert (fixture->plug_in->tile_maps == NULL);
+}
+
+/**
+ * write_back_unmapped:
+ * @fixture:
+ * @data:
+ *
+ * Test that tiles outside of the mapped rectangle are not written
+ * back.
+ **/
+static void
+write_back_unmapped (GimpTestFixture *fixture,
+                     gconstpointer    data)
+{
+  GimpPlugIn *plug_in = fixture->plug_in;
+  guint32     tile_nums[2];
+  gint        map_ID;
+
+  map_ID = gimp_test_map (fixture, MAP_X, MAP_Y, MAP_WIDTH, MAP_HEIGHT);
+  g_assert_cmpint (map_ID, !=, 0);
+
+  tile_nums[0] = 0 * N_COLS + 1;
+  tile_nums[1] = 2 * N_COLS + 1;
+
+  g_assert (! gimp_plug_in_tile_map_write_back (plug_in, map_ID,
+                                                tile_nums, 2));
+  g_assert (! gimp_plug_in_tile_map_write_back (plug_in, map_ID,
+                                                tile_nums + 1, 1));
+  g_assert (gimp_plug_in_tile_map_write_back (plug_in, map_ID,
+                                              tile_nums, 1));
+
+  gimp_test_check_drawable (fixture);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_thread_init (NULL);
+  g_type_init ();
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  ADD_TEST (map_write_unmap);
+  ADD_TEST (map_outside);
+  ADD_TEST (write_back_unmapped);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
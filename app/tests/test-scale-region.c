@@ -0,0 +1,465 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "base/base-types.h"
+
+#include "base/pixel-region.h"
+#include "base/tile.h"
+
+#include "paint-funcs/scale-region.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/scale-region/" #function, function);
+
+/*  not a multiple of the tile size, so there are partial regions  */
+#define WIDTH   150
+#define HEIGHT  100
+
+
+static const GimpInterpolationType interpolations[] =
+{
+  GIMP_INTERPOLATION_NONE,
+  GIMP_INTERPOLATION_LINEAR,
+  GIMP_INTERPOLATION_CUBIC,
+  GIMP_INTERPOLATION_LANCZOS
+};
+
+/*  the sizes the constant images are scaled to, up and down  */
+static const gint sizes[][2] =
+{
+  { WIDTH,         HEIGHT         },
+  { WIDTH * 2 + 1, HEIGHT * 3     },
+  { WIDTH / 2,     HEIGHT / 2 + 3 },
+  { WIDTH - 7,     HEIGHT + 13    }
+};
+
+
+static guchar *
+scale_test_random_image (gint     width,
+                         gint     height,
+                         gint     bytes,
+                         gboolean opaque)
+{
+  GRand  *rand = g_rand_new_with_seed (width * height * bytes);
+  guchar *data = g_new (guchar, width * height * bytes);
+  gint    i;
+
+  for (i = 0; i < width * height * bytes; i++)
+    data[i] = g_rand_int_range (rand, 0, 256);
+
+  /*  a transparent pixel would lose its color when premultiplied  */
+  if (opaque && (bytes == 2 || bytes == 4))
+    for (i = bytes - 1; i < width * height * bytes; i += bytes)
+      data[i] = MAX (data[i], 1);
+
+  g_rand_free (rand);
+
+  return data;
+}
+
+static guchar *
+scale_test_constant_image (gint          width,
+                           gint          height,
+                           gint          bytes,
+                           const guchar *pixel)
+{
+  guchar *data = g_new (guchar, width * height * bytes);
+  gint    i;
+
+  for (i = 0; i < width * height; i++)
+    memcpy (data + i * bytes, pixel, bytes);
+
+  return data;
+}
+
+/*  Runs a pass from src to a new dest image, a tile sized region at a
+ *  time like the pixel processor does.
+ */
+static guchar *
+scale_test_run (ScalePass    *pass,
+                const guchar *src,
+                gint          src_width,
+                gint          dest_width,
+                gint          dest_height,
+                gint          bytes)
+{
+  guchar *dest = g_new (guchar, dest_width * dest_height * bytes);
+  gint    x, y;
+
+  pass->bytes     = bytes;
+  pass->src       = src;
+  pass->src_width = src_width;
+  pass->src_y     = 0;
+
+  for (y = 0; y < dest_height; y += TILE_HEIGHT)
+    for (x = 0; x < dest_width; x += TILE_WIDTH)
+      {
+        PixelRegion destPR;
+
+        pixel_region_init_data (&destPR,
+                                dest + (y * dest_width + x) * bytes,
+                                bytes, dest_width * bytes,
+                                x, y,
+                                MIN (TILE_WIDTH,  dest_width  - x),
+                                MIN (TILE_HEIGHT, dest_height - y));
+
+        scale_pass_region (pass, &destPR);
+      }
+
+  return dest;
+}
+
+/*  Scales an image with the filters that scale() builds.  */
+static guchar *
+scale_test_scale (const guchar          *src,
+                  gint                   src_width,
+                  gint                   src_height,
+                  gint                   dest_width,
+                  gint                   dest_height,
+                  gint                   bytes,
+                  GimpInterpolationType  interpolation)
+{
+  ScalePass  pass;
+  gfloat    *kernel_lookup = NULL;
+  guchar    *dest;
+
+  if (interpolation == GIMP_INTERPOLATION_LANCZOS)
+    kernel_lookup = create_lanczos_lookup ();
+
+  scale_filter_init (&pass.x, src_width, dest_width,
+                     interpolation, kernel_lookup);
+  scale_filter_init (&pass.y, src_height, dest_height,
+                     interpolation, kernel_lookup);
+
+  pass.premultiply = (interpolation != GIMP_INTERPOLATION_NONE &&
+                      (bytes == 2 || bytes == 4));
+
+  dest = scale_test_run (&pass, src, src_width, dest_width, dest_height,
+                         bytes);
+
+  scale_filter_free (&pass.x);
+  scale_filter_free (&pass.y);
+
+  g_free (kernel_lookup);
+
+  return dest;
+}
+
+/*  Averages the pixels at the indices like pixel_average2() and
+ *  pixel_average4() did before decimation used the filters.
+ */
+static void
+scale_test_average (const guchar *src,
+                    const gint   *index,
+                    gint          n,
+                    gint          bytes,
+                    guchar       *dest)
+{
+  const gint alpha = (bytes == 2 || bytes == 4) ? bytes - 1 : -1;
+  guint      a     = 0;
+  gint       i, b;
+
+  if (alpha < 0)
+    {
+      for (b = 0; b < bytes; b++)
+        {
+          guint sum = 0;
+
+          for (i = 0; i < n; i++)
+            sum += src[index[i] * bytes + b];
+
+          dest[b] = (sum + n / 2) / n;
+        }
+
+      return;
+    }
+
+  for (i = 0; i < n; i++)
+    a += src[index[i] * bytes + alpha];
+
+  if (a == 0)
+    {
+      memset (dest, 0, bytes);
+      return;
+    }
+
+  for (b = 0; b < alpha; b++)
+    {
+      guint sum = 0;
+
+      for (i = 0; i < n; i++)
+        sum += src[index[i] * bytes + b] * src[index[i] * bytes + alpha];
+
+      dest[b] = (sum + (a >> 1)) / a;
+    }
+
+  dest[alpha] = (a + n / 2) / n;
+}
+
+static void
+scale_test_decimate (gint src_width,
+                     gint src_height,
+                     gint dest_width,
+                     gint dest_height,
+                     gint bytes)
+{
+  ScalePass  pass;
+  guchar    *src;
+  guchar    *dest;
+  gint       x, y, b;
+
+  src = scale_test_random_image (src_width, src_height, bytes, FALSE);
+
+  /*  some transparent and some opaque areas, like most layers have  */
+  if (bytes == 2 || bytes == 4)
+    for (y = 0; y < src_height; y++)
+      for (x = 0; x < src_width / 3; x++)
+        {
+          src[(y * src_width + x) * bytes + bytes - 1]                 = 0;
+          src[(y * src_width + x + src_width / 3) * bytes + bytes - 1] = 255;
+        }
+
+  scale_filter_init_decimate (&pass.x, src_width,  dest_width);
+  scale_filter_init_decimate (&pass.y, src_height, dest_height);
+
+  pass.premultiply = (bytes == 2 || bytes == 4);
+
+  dest = scale_test_run (&pass, src, src_width, dest_width, dest_height,
+                         bytes);
+
+  for (y = 0; y < dest_height; y++)
+    for (x = 0; x < dest_width; x++)
+      {
+        gint    sx = (dest_width  == src_width)  ? x : 2 * x;
+        gint    sy = (dest_height == src_height) ? y : 2 * y;
+        gint    dx = (dest_width  == src_width)  ? 0 : 1;
+        gint    dy = (dest_height == src_height) ? 0 : 1;
+        gint    index[4];
+        gint    n = 0;
+        guchar  expected[4];
+        guchar *d = dest + (y * dest_width + x) * bytes;
+
+        index[n++] = sy * src_width + sx;
+
+        if (dx)
+          index[n++] = sy * src_width + sx + dx;
+
+        if (dy)
+          {
+            index[n++] = (sy + dy) * src_width + sx;
+
+            if (dx)
+              index[n++] = (sy + dy) * src_width + sx + dx;
+          }
+
+        scale_test_average (src, index, n, bytes, expected);
+
+        for (b = 0; b < bytes; b++)
+          g_assert_cmpint (abs (d[b] - expected[b]), <=, 1);
+      }
+
+  scale_filter_free (&pass.x);
+  scale_filter_free (&pass.y);
+
+  g_free (src);
+  g_free (dest);
+}
+
+/**
+ * identity:
+ *
+ * Test that scaling to the same size copies the pixels exactly, with
+ * every interpolation type and number of bytes per pixel.
+ **/
+static void
+identity (void)
+{
+  gint bytes;
+  gint i;
+
+  for (bytes = 1; bytes <= 4; bytes++)
+    {
+      guchar *src = scale_test_random_image (WIDTH, HEIGHT, bytes, TRUE);
+
+      for (i = 0; i < G_N_ELEMENTS (interpolations); i++)
+        {
+          guchar *dest = scale_test_scale (src, WIDTH, HEIGHT,
+                                           WIDTH, HEIGHT, bytes,
+                                           interpolations[i]);
+
+          g_assert (memcmp (dest, src, WIDTH * HEIGHT * bytes) == 0);
+
+          g_free (dest);
+        }
+
+      g_free (src);
+    }
+}
+
+/**
+ * decimate_xy:
+ *
+ * Test that halving both sides averages each 2x2 block of pixels
+ * like the integer code it replaced, within one.
+ **/
+static void
+decimate_xy (void)
+{
+  gint bytes;
+
+  for (bytes = 1; bytes <= 4; bytes++)
+    scale_test_decimate (WIDTH, HEIGHT, WIDTH / 2, HEIGHT / 2, bytes);
+}
+
+/**
+ * decimate_x_and_y:
+ *
+ * Test that halving one side averages each pair of pixels like the
+ * integer code it replaced, within one.
+ **/
+static void
+decimate_x_and_y (void)
+{
+  gint bytes;
+
+  for (bytes = 1; bytes <= 4; bytes++)
+    {
+      scale_test_decimate (WIDTH, HEIGHT, WIDTH / 2, HEIGHT,     bytes);
+      scale_test_decimate (WIDTH, HEIGHT, WIDTH,     HEIGHT / 2, bytes);
+    }
+}
+
+/**
+ * constant_color:
+ *
+ * Test that scaling an image of one color up and down gives exactly
+ * that color, with every interpolation type.
+ **/
+static void
+constant_color (void)
+{
+  static const guchar pixel[] = { 37, 150, 220, 201 };
+  gint                bytes;
+  gint                i, s, p;
+
+  for (bytes = 1; bytes <= 4; bytes++)
+    {
+      guchar  color[4];
+      guchar *src;
+
+      /*  the alpha is the last byte  */
+      memcpy (color, pixel, bytes);
+      if (bytes == 2)
+        color[1] = pixel[3];
+
+      src = scale_test_constant_image (WIDTH, HEIGHT, bytes, color);
+
+      for (i = 0; i < G_N_ELEMENTS (interpolations); i++)
+        for (s = 0; s < G_N_ELEMENTS (sizes); s++)
+          {
+            gint    width  = sizes[s][0];
+            gint    height = sizes[s][1];
+            guchar *dest   = scale_test_scale (src, WIDTH, HEIGHT,
+                                               width, height, bytes,
+                                               interpolations[i]);
+
+            for (p = 0; p < width * height; p++)
+              g_assert (memcmp (dest + p * bytes, src, bytes) == 0);
+
+            g_free (dest);
+          }
+
+      g_free (src);
+    }
+}
+
+/**
+ * transparent:
+ *
+ * Test that scaling a fully transparent image up and down keeps it
+ * fully transparent, with every interpolation type.
+ **/
+static void
+transparent (void)
+{
+  static const guchar pixel[] = { 37, 150, 220, 0 };
+  static const guchar clear[] = { 0, 0, 0, 0 };
+  gint                bytes;
+  gint                i, s, p;
+
+  for (bytes = 2; bytes <= 4; bytes += 2)
+    {
+      guchar  color[4];
+      guchar *src;
+
+      memcpy (color, pixel, bytes);
+      if (bytes == 2)
+        color[1] = pixel[3];
+
+      src = scale_test_constant_image (WIDTH, HEIGHT, bytes, color);
+
+      for (i = 0; i < G_N_ELEMENTS (interpolations); i++)
+        for (s = 0; s < G_N_ELEMENTS (sizes); s++)
+          {
+            gint          width  = sizes[s][0];
+            gint          height = sizes[s][1];
+            guchar       *dest   = scale_test_scale (src, WIDTH, HEIGHT,
+                                                     width, height, bytes,
+                                                     interpolations[i]);
+            const guchar *expected;
+
+            /*  nearest neighbor copies the pixels, the other types
+             *  drop the color of transparent pixels
+             */
+            if (interpolations[i] == GIMP_INTERPOLATION_NONE)
+              expected = src;
+            else
+              expected = clear;
+
+            for (p = 0; p < width * height; p++)
+              g_assert (memcmp (dest + p * bytes, expected, bytes) == 0);
+
+            g_free (dest);
+          }
+
+      g_free (src);
+    }
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_type_init ();
+  g_test_init (&argc, &argv, NULL);
+
+  ADD_TEST (identity);
+  ADD_TEST (decimate_xy);
+  ADD_TEST (decimate_x_and_y);
+  ADD_TEST (constant_color);
+  ADD_TEST (transparent);
+
+  return g_test_run ();
+}
@@ -0,0 +1,239 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "base/base-types.h"
+
+#include "base/tile-compress.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/tile-compress/" #function, function);
+
+/*  the longest run/literal a single header byte can describe  */
+#define MAX_LITERAL  128
+#define MAX_REPEAT   129
+
+#define N_PIXELS     1024
+
+
+/*  Fills @n pixels with pixels that differ from both neighbours.  */
+static void
+tile_compress_test_literal (guchar *pixels,
+                            gint    n,
+                            gint    bpp)
+{
+  gint i, j;
+
+  for (i = 0; i < n; i++)
+    for (j = 0; j < bpp; j++)
+      pixels[i * bpp + j] = (i * 7 + j) % 251;
+}
+
+static void
+tile_compress_test_repeat (guchar *pixels,
+                           gint    n,
+                           gint    bpp,
+                           guchar  value)
+{
+  memset (pixels, value, n * bpp);
+}
+
+/*  Compresses and decompresses @n pixels, and returns the compressed
+ *  size.
+ */
+static gint
+tile_compress_test_round_trip (const guchar *pixels,
+                               gint          n,
+                               gint          bpp)
+{
+  gint    max_size = n * bpp + (n + MAX_LITERAL - 1) / MAX_LITERAL;
+  guchar *packed   = g_new (guchar, max_size);
+  guchar *unpacked = g_new (guchar, n * bpp);
+  gint    size;
+
+  size = tile_compress_rle (pixels, n, bpp, packed, max_size);
+  g_assert_cmpint (size, >, 0);
+
+  g_assert (tile_decompress_rle (packed, size, bpp, unpacked, n * bpp));
+  g_assert (memcmp (pixels, unpacked, n * bpp) == 0);
+
+  g_free (packed);
+  g_free (unpacked);
+
+  return size;
+}
+
+/**
+ * max_repeat:
+ *
+ * Test that the longest run fits into a single header byte, and that
+ * longer runs are split.
+ **/
+static void
+max_repeat (void)
+{
+  guchar pixels[N_PIXELS * 4];
+  gint   bpp;
+
+  for (bpp = 1; bpp <= 4; bpp++)
+    {
+      tile_compress_test_repeat (pixels, MAX_REPEAT, bpp, 17);
+      g_assert_cmpint (tile_compress_test_round_trip (pixels, MAX_REPEAT, bpp),
+                       ==, 1 + bpp);
+
+      tile_compress_test_repeat (pixels, MAX_REPEAT + 1, bpp, 17);
+      g_assert_cmpint (tile_compress_test_round_trip (pixels, MAX_REPEAT + 1,
+                                                      bpp),
+                       ==, 2 * (1 + bpp));
+
+      tile_compress_test_repeat (pixels, N_PIXELS, bpp, 0);
+      tile_compress_test_round_trip (pixels, N_PIXELS, bpp);
+    }
+}
+
+/**
+ * max_literal:
+ *
+ * Test that the longest literal fits into a single header byte, and
+ * that longer literals are split.
+ **/
+static void
+max_literal (void)
+{
+  guchar pixels[N_PIXELS * 4];
+  gint   bpp;
+
+  for (bpp = 1; bpp <= 4; bpp++)
+    {
+      tile_compress_test_literal (pixels, MAX_LITERAL, bpp);
+      g_assert_cmpint (tile_compress_test_round_trip (pixels, MAX_LITERAL,
+                                                      bpp),
+                       ==, 1 + MAX_LITERAL * bpp);
+
+      tile_compress_test_literal (pixels, MAX_LITERAL + 1, bpp);
+      g_assert_cmpint (tile_compress_test_round_trip (pixels, MAX_LITERAL + 1,
+                                                      bpp),
+                       ==, 2 + (MAX_LITERAL + 1) * bpp);
+
+      tile_compress_test_literal (pixels, N_PIXELS, bpp);
+      tile_compress_test_round_trip (pixels, N_PIXELS, bpp);
+    }
+}
+
+/**
+ * mixed:
+ *
+ * Test runs and literals of all lengths next to each other, where
+ * only a single channel of a pixel differs.
+ **/
+static void
+mixed (void)
+{
+  guchar pixels[N_PIXELS * 4];
+  gint   bpp;
+
+  for (bpp = 1; bpp <= 4; bpp++)
+    {
+      gint n = 0;
+      gint len;
+
+      for (len = 1; n + 2 * len <= N_PIXELS; len++)
+        {
+          tile_compress_test_literal (pixels + n * bpp, len, bpp);
+          n += len;
+
+          tile_compress_test_repeat (pixels + n * bpp, len, bpp, len);
+          n += len;
+
+          /*  differs from the run in the last channel only  */
+          if (n < N_PIXELS)
+            {
+              tile_compress_test_repeat (pixels + n * bpp, 1, bpp, len);
+              pixels[n * bpp + bpp - 1] ^= 0x80;
+              n++;
+            }
+        }
+
+      tile_compress_test_round_trip (pixels, n, bpp);
+    }
+}
+
+/**
+ * too_large:
+ *
+ * Test that the compression gives up when the result doesn't fit.
+ **/
+static void
+too_large (void)
+{
+  guchar pixels[N_PIXELS * 4];
+  guchar packed[N_PIXELS * 4];
+
+  tile_compress_test_literal (pixels, N_PIXELS, 4);
+
+  g_assert_cmpint (tile_compress_rle (pixels, N_PIXELS, 4,
+                                      packed, N_PIXELS * 4),
+                   ==, 0);
+}
+
+/**
+ * corrupt:
+ *
+ * Test that truncated data and data of the wrong size are rejected.
+ **/
+static void
+corrupt (void)
+{
+  guchar pixels[N_PIXELS * 4];
+  guchar packed[N_PIXELS * 4 + N_PIXELS];
+  guchar unpacked[N_PIXELS * 4];
+  gint   size;
+
+  tile_compress_test_literal (pixels, N_PIXELS / 2, 3);
+  tile_compress_test_repeat (pixels + N_PIXELS / 2 * 3, N_PIXELS / 2, 3, 9);
+
+  size = tile_compress_rle (pixels, N_PIXELS, 3, packed, sizeof (packed));
+  g_assert_cmpint (size, >, 0);
+
+  g_assert (! tile_decompress_rle (packed, size - 1, 3,
+                                   unpacked, N_PIXELS * 3));
+  g_assert (! tile_decompress_rle (packed, size, 3,
+                                   unpacked, N_PIXELS * 3 - 3));
+  g_assert (! tile_decompress_rle (packed, size, 3,
+                                   unpacked, N_PIXELS * 3 + 3));
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  ADD_TEST (max_repeat);
+  ADD_TEST (max_literal);
+  ADD_TEST (mixed);
+  ADD_TEST (too_large);
+  ADD_TEST (corrupt);
+
+  return g_test_run ();
+}
@@ -0,0 +1,242 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "base/base-types.h"
+
+#include "base/tile.h"
+#include "base/tile-cache.h"
+#include "base/tile-compress.h"
+#include "base/tile-manager.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/tile-manager/" #function, function);
+
+/*  not a multiple of the tile size, so there are partial tiles  */
+#define WIDTH   200
+#define HEIGHT  150
+#define BPP     3
+
+#define STRIDE  (WIDTH * BPP)
+
+
+typedef struct
+{
+  TileManager *tiles;
+  guchar      *expected;
+} TileManagerTest;
+
+
+/*  Creates a tile manager with a pattern, and a duplicate of it.  */
+static void
+tile_manager_test_init (TileManagerTest *original,
+                        TileManagerTest *copy)
+{
+  gint i;
+
+  original->tiles    = tile_manager_new (WIDTH, HEIGHT, BPP);
+  original->expected = g_new (guchar, STRIDE * HEIGHT);
+
+  for (i = 0; i < STRIDE * HEIGHT; i++)
+    original->expected[i] = i * 7 + i / STRIDE;
+
+  tile_manager_write_pixel_data (original->tiles,
+                                 0, 0, WIDTH - 1, HEIGHT - 1,
+                                 original->expected, STRIDE);
+
+  copy->tiles    = tile_manager_duplicate (original->tiles);
+  copy->expected = g_memdup (original->expected, STRIDE * HEIGHT);
+}
+
+static void
+tile_manager_test_check (TileManagerTest *test)
+{
+  guchar *buffer = g_new (guchar, STRIDE * HEIGHT);
+  gint    y;
+
+  tile_manager_read_pixel_data (test->tiles,
+                                0, 0, WIDTH - 1, HEIGHT - 1,
+                                buffer, STRIDE);
+
+  for (y = 0; y < HEIGHT; y++)
+    g_assert (memcmp (buffer         + y * STRIDE,
+                      test->expected + y * STRIDE, STRIDE) == 0);
+
+  g_free (buffer);
+}
+
+static void
+tile_manager_test_free (TileManagerTest *test)
+{
+  tile_manager_unref (test->tiles);
+  g_free (test->expected);
+}
+
+/*  Changes the first pixel of every other tile through
+ *  tile_manager_get().
+ */
+static void
+tile_manager_test_get_write (TileManagerTest *test)
+{
+  gint n_cols = (WIDTH  + TILE_WIDTH  - 1) / TILE_WIDTH;
+  gint n_rows = (HEIGHT + TILE_HEIGHT - 1) / TILE_HEIGHT;
+  gint i;
+
+  for (i = 0; i < n_cols * n_rows; i += 2)
+    {
+      Tile   *tile = tile_manager_get (test->tiles, i, TRUE, TRUE);
+      guchar *data = tile_data_pointer (tile, 0, 0);
+      gint    x    = (i % n_cols) * TILE_WIDTH;
+      gint    y    = (i / n_cols) * TILE_HEIGHT;
+
+      data[0] ^= 0xff;
+      test->expected[y * STRIDE + x * BPP] ^= 0xff;
+
+      tile_release (tile, TRUE);
+    }
+}
+
+/*  Overwrites a rectangle that spans several tiles, and a single
+ *  pixel, through tile_manager_write_pixel_data().
+ */
+static void
+tile_manager_test_write_pixel_data (TileManagerTest *test)
+{
+  const gint x1 = 50;
+  const gint y1 = 40;
+  const gint x2 = 130;
+  const gint y2 = 100;
+  guchar     pixel[BPP] = { 1, 2, 3 };
+  gint       x, y;
+
+  for (y = y1; y <= y2; y++)
+    for (x = x1 * BPP; x < (x2 + 1) * BPP; x++)
+      test->expected[y * STRIDE + x] ^= 0x55;
+
+  tile_manager_write_pixel_data (test->tiles, x1, y1, x2, y2,
+                                 test->expected + y1 * STRIDE + x1 * BPP,
+                                 STRIDE);
+
+  memcpy (test->expected + (HEIGHT - 1) * STRIDE + (WIDTH - 1) * BPP,
+          pixel, BPP);
+
+  tile_manager_write_pixel_data_1 (test->tiles, WIDTH - 1, HEIGHT - 1,
+                                   pixel);
+}
+
+/**
+ * duplicate_write_copy:
+ *
+ * Test that writing to the tiles of a duplicate doesn't change the
+ * tile manager it was duplicated from.
+ **/
+static void
+duplicate_write_copy (void)
+{
+  TileManagerTest original;
+  TileManagerTest copy;
+
+  tile_manager_test_init (&original, &copy);
+
+  tile_manager_test_get_write (&copy);
+  tile_manager_test_check (&copy);
+  tile_manager_test_check (&original);
+
+  tile_manager_test_write_pixel_data (&copy);
+  tile_manager_test_check (&copy);
+  tile_manager_test_check (&original);
+
+  tile_manager_test_free (&copy);
+  tile_manager_test_check (&original);
+  tile_manager_test_free (&original);
+}
+
+/**
+ * duplicate_write_original:
+ *
+ * Test that writing to the tiles of a tile manager doesn't change a
+ * duplicate of it.
+ **/
+static void
+duplicate_write_original (void)
+{
+  TileManagerTest original;
+  TileManagerTest copy;
+
+  tile_manager_test_init (&original, &copy);
+
+  tile_manager_test_get_write (&original);
+  tile_manager_test_check (&original);
+  tile_manager_test_check (&copy);
+
+  tile_manager_test_write_pixel_data (&original);
+  tile_manager_test_check (&original);
+  tile_manager_test_check (&copy);
+
+  tile_manager_test_free (&original);
+  tile_manager_test_check (&copy);
+  tile_manager_test_free (&copy);
+}
+
+/**
+ * duplicate_serial:
+ *
+ * Test that a duplicate has the serial of its original until either
+ * of them is written to.
+ **/
+static void
+duplicate_serial (void)
+{
+  TileManagerTest original;
+  TileManagerTest copy;
+  guint           serial;
+
+  tile_manager_test_init (&original, &copy);
+
+  serial = tile_manager_get_serial (original.tiles);
+  g_assert_cmpuint (tile_manager_get_serial (copy.tiles), ==, serial);
+
+  tile_manager_test_get_write (&copy);
+  g_assert_cmpuint (tile_manager_get_serial (original.tiles), ==, serial);
+  g_assert_cmpuint (tile_manager_get_serial (copy.tiles), !=, serial);
+
+  tile_manager_test_free (&original);
+  tile_manager_test_free (&copy);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_thread_init (NULL);
+  g_type_init ();
+  tile_cache_init (64 * 1024 * 1024);
+  tile_compress_init (0);
+  g_test_init (&argc, &argv, NULL);
+
+  ADD_TEST (duplicate_write_copy);
+  ADD_TEST (duplicate_write_original);
+  ADD_TEST (duplicate_serial);
+
+  return g_test_run ();
+}
@@ -0,0 +1,223 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_UNIX
+#include <signal.h>
+#include <sys/resource.h>
+#endif
+
+#include "base/base-types.h"
+
+#include "base/pixel-region.h"
+#include "base/tile.h"
+#include "base/tile-cache.h"
+#include "base/tile-compress.h"
+#include "base/tile-manager.h"
+#include "base/tile-swap.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/tile-swap/" #function, function);
+
+#define WIDTH   1000
+#define HEIGHT  1000
+
+
+static void
+tile_swap_test_write (TileManager *tiles,
+                      gint         seed)
+{
+  PixelRegion region;
+  gpointer    pr;
+
+  /*  the tile cache holds only a few tiles, most are swapped out  */
+  pixel_region_init (&region, tiles, 0, 0, WIDTH, HEIGHT, TRUE);
+
+  for (pr = pixel_regions_register (1, &region);
+       pr != NULL;
+       pr = pixel_regions_process (pr))
+    {
+      gint x, y;
+
+      for (y = 0; y < region.h; y++)
+        for (x = 0; x < region.w; x++)
+          {
+            guchar *p = region.data + y * region.rowstride + x * 4;
+
+            p[0] = region.x + x + seed;
+            p[1] = region.y + y;
+            p[2] = (region.x + x) ^ (region.y + y);
+            p[3] = (region.x + x) >> 8;
+          }
+    }
+}
+
+static void
+tile_swap_test_check (TileManager *tiles,
+                      gint         seed)
+{
+  PixelRegion region;
+  gpointer    pr;
+
+  pixel_region_init (&region, tiles, 0, 0, WIDTH, HEIGHT, FALSE);
+
+  for (pr = pixel_regions_register (1, &region);
+       pr != NULL;
+       pr = pixel_regions_process (pr))
+    {
+      gint x, y;
+
+      for (y = 0; y < region.h; y++)
+        for (x = 0; x < region.w; x++)
+          {
+            const guchar *p = region.data + y * region.rowstride + x * 4;
+
+            g_assert_cmpint (p[0], ==, (guchar) (region.x + x + seed));
+            g_assert_cmpint (p[1], ==, (guchar) (region.y + y));
+            g_assert_cmpint (p[2], ==, (guchar) ((region.x + x) ^
+                                                 (region.y + y)));
+            g_assert_cmpint (p[3], ==, (guchar) ((region.x + x) >> 8));
+          }
+    }
+}
+
+static void
+tile_swap_test_pattern (gboolean mapped)
+{
+  gchar       *dirname;
+  TileManager *tiles;
+
+  dirname = g_dir_make_tmp ("gimp-test-tile-swap-XXXXXX", NULL);
+  g_assert (dirname != NULL);
+
+  tile_swap_init (dirname, mapped);
+
+  tiles = tile_manager_new (WIDTH, HEIGHT, 4);
+
+  tile_swap_test_write (tiles, 0);
+  tile_swap_test_check (tiles, 0);
+
+  tile_manager_unref (tiles);
+
+  tile_swap_exit ();
+
+  g_rmdir (dirname);
+  g_free (dirname);
+}
+
+/**
+ * swap_file:
+ *
+ * Test that tiles come back unchanged from the swap file, written by
+ * the writer thread where there is one.
+ **/
+static void
+swap_file (void)
+{
+  tile_swap_test_pattern (FALSE);
+}
+
+/**
+ * swap_mmap:
+ *
+ * Test that tiles come back unchanged from the swap file when it is
+ * mapped into memory, which falls back to file I/O where mapping isn't
+ * available.
+ **/
+static void
+swap_mmap (void)
+{
+  tile_swap_test_pattern (TRUE);
+}
+
+#ifdef G_OS_UNIX
+/**
+ * swap_failed_write:
+ *
+ * Test that tiles keep their data when writing them to the swap file
+ * fails, also when they are swapped back in and evicted again.
+ **/
+static void
+swap_failed_write (void)
+{
+  gchar         *dirname;
+  TileManager   *tiles;
+  struct rlimit  limit;
+  struct rlimit  no_writes;
+
+  dirname = g_dir_make_tmp ("gimp-test-tile-swap-XXXXXX", NULL);
+  g_assert (dirname != NULL);
+
+  tile_swap_init (dirname, FALSE);
+
+  tiles = tile_manager_new (WIDTH, HEIGHT, 4);
+
+  tile_swap_test_write (tiles, 0);
+
+  /*  every write to the swap file fails with EFBIG from now on  */
+  g_assert (getrlimit (RLIMIT_FSIZE, &limit) == 0);
+
+  no_writes.rlim_cur = 0;
+  no_writes.rlim_max = limit.rlim_max;
+
+  signal (SIGXFSZ, SIG_IGN);
+  g_assert (setrlimit (RLIMIT_FSIZE, &no_writes) == 0);
+
+  /*  the failed writes are reclaimed, and evicted again  */
+  tile_swap_test_write (tiles, 1);
+  tile_swap_test_check (tiles, 1);
+  tile_swap_test_check (tiles, 1);
+
+  g_assert (setrlimit (RLIMIT_FSIZE, &limit) == 0);
+
+  /*  the reclaimed tiles are dirtied and written successfully  */
+  tile_swap_test_check (tiles, 1);
+  tile_swap_test_write (tiles, 2);
+  tile_swap_test_check (tiles, 2);
+
+  tile_manager_unref (tiles);
+
+  tile_swap_exit ();
+
+  g_rmdir (dirname);
+  g_free (dirname);
+}
+#endif
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_thread_init (NULL);
+  g_type_init ();
+  tile_cache_init (16 * TILE_WIDTH * TILE_HEIGHT * 4);
+  tile_compress_init (0);
+  g_test_init (&argc, &argv, NULL);
+
+  ADD_TEST (swap_file);
+  ADD_TEST (swap_mmap);
+#ifdef G_OS_UNIX
+  ADD_TEST (swap_failed_write);
+#endif
+
+  return g_test_run ();
+}
@@ -0,0 +1,1687 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 2009 Martin Nordholts
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include <gegl.h>
+
+#include <gtk/gtk.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "widgets/widgets-types.h"
+
+#include "widgets/gimpuimanager.h"
+
+#include "base/pixel-region.h"
+#include "base/tile-manager.h"
+
+#include "core/gimp.h"
+#include "core/gimpchannel.h"
+#include "core/gimpchannel-select.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpgrid.h"
+#include "core/gimpgrouplayer.h"
+#include "core/gimpguide.h"
+#include "core/gimpimage.h"
+#include "core/gimpimage-grid.h"
+#include "core/gimpimage-guides.h"
+#include "core/gimpimage-sample-points.h"
+#include "core/gimplayer.h"
+#include "core/gimpsamplepoint.h"
+#include "core/gimpselection.h"
+
+#include "vectors/gimpanchor.h"
+#include "vectors/gimpbezierstroke.h"
+#include "vectors/gimpvectors.h"
+
+#include "file/file-open.h"
+#include "file/file-procedure.h"
+#include "file/file-save.h"
+
+#include "plug-in/gimppluginmanager.h"
+
+#include "xcf/xcf-private.h"
+#include "xcf/xcf-save.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define GIMP_MAINIMAGE_WIDTH            100
+#define GIMP_MAINIMAGE_HEIGHT           90
+#define GIMP_MAINIMAGE_TYPE             GIMP_RGB
+
+#define GIMP_MAINIMAGE_LAYER1_NAME      "layer1"
+#define GIMP_MAINIMAGE_LAYER1_WIDTH     50
+#define GIMP_MAINIMAGE_LAYER1_HEIGHT    51
+#define GIMP_MAINIMAGE_LAYER1_TYPE      GIMP_RGBA_IMAGE
+#define GIMP_MAINIMAGE_LAYER1_OPACITY   1.0
+#define GIMP_MAINIMAGE_LAYER1_MODE      GIMP_NORMAL_MODE
+
+#define GIMP_MAINIMAGE_LAYER2_NAME      "layer2"
+#define GIMP_MAINIMAGE_LAYER2_WIDTH     25
+#define GIMP_MAINIMAGE_LAYER2_HEIGHT    251
+#define GIMP_MAINIMAGE_LAYER2_TYPE      GIMP_RGB_IMAGE
+#define GIMP_MAINIMAGE_LAYER2_OPACITY   0.0
+#define GIMP_MAINIMAGE_LAYER2_MODE      GIMP_MULTIPLY_MODE
+
+#define GIMP_MAINIMAGE_GROUP1_NAME      "group1"
+
+#define GIMP_MAINIMAGE_LAYER3_NAME      "layer3"
+
+#define GIMP_MAINIMAGE_LAYER4_NAME      "layer4"
+
+#define GIMP_MAINIMAGE_GROUP2_NAME      "group2"
+
+#define GIMP_MAINIMAGE_LAYER5_NAME      "layer5"
+
+#define GIMP_MAINIMAGE_VGUIDE1_POS      42
+#define GIMP_MAINIMAGE_VGUIDE2_POS      82
+#define GIMP_MAINIMAGE_HGUIDE1_POS      3
+#define GIMP_MAINIMAGE_HGUIDE2_POS      4
+
+#define GIMP_MAINIMAGE_SAMPLEPOINT1_X   10
+#define GIMP_MAINIMAGE_SAMPLEPOINT1_Y   12
+#define GIMP_MAINIMAGE_SAMPLEPOINT2_X   41
+#define GIMP_MAINIMAGE_SAMPLEPOINT2_Y   49
+
+#define GIMP_MAINIMAGE_RESOLUTIONX      400
+#define GIMP_MAINIMAGE_RESOLUTIONY      410
+
+#define GIMP_MAINIMAGE_PARASITE_NAME    "test-parasite"
+#define GIMP_MAINIMAGE_PARASITE_DATA    "foo"
+#define GIMP_MAINIMAGE_PARASITE_SIZE    4                /* 'f' 'o' 'o' '\0' */
+
+#define GIMP_MAINIMAGE_COMMENT          "Created with code from "\
+                                        "app/tests/test-xcf.c in the GIMP "\
+                                        "source tree, i.e. it was not created "\
+                                        "manually and may thus look weird if "\
+                                        "opened and inspected in GIMP."
+
+#define GIMP_MAINIMAGE_UNIT             GIMP_UNIT_PICA
+
+#define GIMP_MAINIMAGE_GRIDXSPACING     25.0
+#define GIMP_MAINIMAGE_GRIDYSPACING     27.0
+
+#define GIMP_MAINIMAGE_CHANNEL1_NAME    "channel1"
+#define GIMP_MAINIMAGE_CHANNEL1_WIDTH   GIMP_MAINIMAGE_WIDTH
+#define GIMP_MAINIMAGE_CHANNEL1_HEIGHT  GIMP_MAINIMAGE_HEIGHT
+#define GIMP_MAINIMAGE_CHANNEL1_COLOR   { 1.0, 0.0, 1.0, 1.0 }
+
+#define GIMP_MAINIMAGE_SELECTION_X      5
+#define GIMP_MAINIMAGE_SELECTION_Y      6
+#define GIMP_MAINIMAGE_SELECTION_W      7
+#define GIMP_MAINIMAGE_SELECTION_H      8
+
+#define GIMP_MAINIMAGE_VECTORS1_NAME    "vectors1"
+#define GIMP_MAINIMAGE_VECTORS1_COORDS  { { 11.0, 12.0, /* pad zeroes */ },\
+                                          { 21.0, 22.0, /* pad zeroes */ },\
+                                          { 31.0, 32.0, /* pad zeroes */ }, }
+
+#define GIMP_MAINIMAGE_VECTORS2_NAME    "vectors2"
+#define GIMP_MAINIMAGE_VECTORS2_COORDS  { { 911.0, 912.0, /* pad zeroes */ },\
+                                          { 921.0, 922.0, /* pad zeroes */ },\
+                                          { 931.0, 932.0, /* pad zeroes */ }, }
+
+#define GIMP_INCREMENTAL_MAX_SAVES      8
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-xcf/" #function, gimp, function);
+
+
+GimpImage        * gimp_test_load_image                        (Gimp            *gimp,
+                                                                const gchar     *uri);
+static void        gimp_write_and_read_file                    (Gimp            *gimp,
+                                                                gboolean         with_unusual_stuff,
+                                                                gboolean         compat_paths,
+                                                                gboolean         use_gimp_2_8_features);
+static GimpImage * gimp_create_mainimage                       (Gimp            *gimp,
+                                                                gboolean         with_unusual_stuff,
+                                                                gboolean         compat_paths,
+                                                                gboolean         use_gimp_2_8_features);
+static void        gimp_assert_mainimage                       (GimpImage       *image,
+                                                                gboolean         with_unusual_stuff,
+                                                                gboolean         compat_paths,
+                                                                gboolean         use_gimp_2_8_features);
+static void        gimp_test_save_image                        (GimpImage       *image,
+                                                                const gchar     *uri);
+static gint64      gimp_test_file_size                         (const gchar     *uri);
+static void        gimp_test_fill_drawable                     (GimpDrawable    *drawable,
+                                                                gint             seed);
+static void        gimp_test_fill_image                        (GimpImage       *image,
+                                                                gint             seed);
+static void        gimp_assert_drawables_equal                 (GimpDrawable    *drawable,
+                                                                GimpDrawable    *loaded);
+static void        gimp_assert_image_pixels                    (GimpImage       *image,
+                                                                const gchar     *uri);
+static void        gimp_assert_files_equal                     (const gchar     *uri1,
+                                                                const gchar     *uri2);
+static void        gimp_write_and_read_compressed              (Gimp            *gimp,
+                                                                XcfCompressionType compression,
+                                                                gint             file_version);
+static GHashTable * gimp_test_save_image_compressed            (GimpImage       *image,
+                                                                const gchar     *uri,
+                                                                XcfCompressionType compression);
+static void        gimp_assert_file_version                    (const gchar     *uri,
+                                                                gint             file_version);
+
+
+/**
+ * write_and_read_gimp_2_6_format:
+ * @data:
+ *
+ * Do a write and read test on a file that could as well be
+ * constructed with GIMP 2.6.
+ **/
+static void
+write_and_read_gimp_2_6_format (gconstpointer data)
+{
+  Gimp *gimp = GIMP (data);
+
+  gimp_write_and_read_file (gimp,
+                            FALSE /*with_unusual_stuff*/,
+                            FALSE /*compat_paths*/,
+                            FALSE /*use_gimp_2_8_features*/);
+}
+
+/**
+ * write_and_read_gimp_2_6_format_unusual:
+ * @data:
+ *
+ * Do a write and read test on a file that could as well be
+ * constructed with GIMP 2.6, and make it unusual, like compatible
+ * vectors and with a floating selection.
+ **/
+static void
+write_and_read_gimp_2_6_format_unusual (gconstpointer data)
+{
+  Gimp *gimp = GIMP (data);
+
+  gimp_write_and_read_file (gimp,
+                            TRUE /*with_unusual_stuff*/,
+                            TRUE /*compat_paths*/,
+                            FALSE /*use_gimp_2_8_features*/);
+}
+
+/**
+ * load_gimp_2_6_file:
+ * @data:
+ *
+ * Loads a file created with GIMP 2.6 and makes sure it loaded as
+ * expected.
+ **/
+static void
+load_gimp_2_6_file (gconstpointer data)
+{
+  Gimp      *gimp  = GIMP (data);
+  GimpImage *image = NULL;
+  gchar     *uri   = NULL;
+
+  uri = g_build_filename (g_getenv ("GIMP_TESTING_ABS_TOP_SRCDIR"),
+                          "app/tests/files/gimp-2-6-file.xcf",
+                          NULL);
+
+  image = gimp_test_load_image (gimp, uri);
+
+  /* The image file was constructed by running
+   * gimp_write_and_read_file (FALSE, FALSE) in GIMP 2.6 by
+   * copy-pasting the code to GIMP 2.6 and adapting it to changes in
+   * the core API, so we can use gimp_assert_mainimage() to make sure
+   * the file was loaded successfully.
+   */
+  gimp_assert_mainimage (image,
+                         FALSE /*with_unusual_stuff*/,
+                         FALSE /*compat_paths*/,
+                         FALSE /*use_gimp_2_8_features*/);
+}
+
+/**
+ * write_and_read_gimp_2_8_format:
+ * @data:
+ *
+ * Writes an XCF file that uses GIMP 2.8 features such as layer
+ * groups, then reads the file and make sure no relevant information
+ * was lost.
+ **/
+static void
+write_and_read_gimp_2_8_format (gconstpointer data)
+{
+  Gimp *gimp = GIMP (data);
+
+  gimp_write_and_read_file (gimp,
+                            FALSE /*with_unusual_stuff*/,
+                            FALSE /*compat_paths*/,
+                            TRUE /*use_gimp_2_8_features*/);
+}
+
+/**
+ * save_incremental:
+ * @data:
+ *
+ * Saves an image, changes the pixels of one layer and saves it back
+ * to the same file, which only appends the changed layer, then makes
+ * sure that loading the file gives the pixels of every drawable.
+ **/
+static void
+save_incremental (gconstpointer data)
+{
+  Gimp      *gimp = GIMP (data);
+  GimpImage *image;
+  GimpLayer *layer;
+  gchar     *uri;
+  gchar     *reference_uri;
+  gint64     size;
+
+  uri           = g_build_filename (g_get_tmp_dir (),
+                                    "gimp-test-incremental.xcf", NULL);
+  reference_uri = g_build_filename (g_get_tmp_dir (),
+                                    "gimp-test-reference.xcf", NULL);
+
+  image = gimp_create_mainimage (gimp,
+                                 FALSE /*with_unusual_stuff*/,
+                                 FALSE /*compat_paths*/,
+                                 TRUE /*use_gimp_2_8_features*/);
+  gimp_test_fill_image (image, 0);
+  gimp_test_save_image (image, uri);
+
+  size = gimp_test_file_size (uri);
+
+  layer = gimp_image_get_layer_by_name (image, GIMP_MAINIMAGE_LAYER1_NAME);
+  gimp_test_fill_drawable (GIMP_DRAWABLE (layer), 1);
+  gimp_test_save_image (image, uri);
+
+  g_assert_cmpint (gimp_test_file_size (uri), >, size);
+  gimp_assert_image_pixels (image, uri);
+
+  /* A complete rewrite doesn't contain the old layer1 and header */
+  gimp_test_save_image (image, reference_uri);
+
+  g_assert_cmpint (gimp_test_file_size (uri), >,
+                   gimp_test_file_size (reference_uri));
+
+  g_unlink (uri);
+  g_unlink (reference_uri);
+  g_free (uri);
+  g_free (reference_uri);
+}
+
+/**
+ * save_incremental_header_too_large:
+ * @data:
+ *
+ * Adds a layer to a saved image, so the new header doesn't fit into
+ * the room of the old one, and makes sure that saving it back to the
+ * same file rewrites the file completely.
+ **/
+static void
+save_incremental_header_too_large (gconstpointer data)
+{
+  Gimp      *gimp = GIMP (data);
+  GimpImage *image;
+  GimpLayer *layer;
+  gchar     *uri;
+  gchar     *reference_uri;
+
+  uri           = g_build_filename (g_get_tmp_dir (),
+                                    "gimp-test-incremental.xcf", NULL);
+  reference_uri = g_build_filename (g_get_tmp_dir (),
+                                    "gimp-test-reference.xcf", NULL);
+
+  image = gimp_create_mainimage (gimp,
+                                 FALSE /*with_unusual_stuff*/,
+                                 FALSE /*compat_paths*/,
+                                 TRUE /*use_gimp_2_8_features*/);
+  gimp_test_fill_image (image, 0);
+  gimp_test_save_image (image, uri);
+
+  layer = gimp_layer_new (image,
+                          GIMP_MAINIMAGE_LAYER1_WIDTH,
+                          GIMP_MAINIMAGE_LAYER1_HEIGHT,
+                          GIMP_MAINIMAGE_LAYER1_TYPE,
+                          "added-layer",
+                          GIMP_MAINIMAGE_LAYER1_OPACITY,
+                          GIMP_MAINIMAGE_LAYER1_MODE);
+  gimp_image_add_layer (image,
+                        layer,
+                        NULL,
+                        0,
+                        FALSE /*push_undo*/);
+  gimp_test_fill_drawable (GIMP_DRAWABLE (layer), 1);
+  gimp_test_save_image (image, uri);
+
+  gimp_assert_image_pixels (image, uri);
+
+  gimp_test_save_image (image, reference_uri);
+  gimp_assert_files_equal (uri, reference_uri);
+
+  g_unlink (uri);
+  g_unlink (reference_uri);
+  g_free (uri);
+  g_free (reference_uri);
+}
+
+/**
+ * save_incremental_rewrite_unused:
+ * @data:
+ *
+ * Changes all drawables of an image between saves, and makes sure
+ * that the file is rewritten completely once more than half of it is
+ * unused.
+ **/
+static void
+save_incremental_rewrite_unused (gconstpointer data)
+{
+  Gimp      *gimp      = GIMP (data);
+  GimpImage *image;
+  gchar     *uri;
+  gchar     *reference_uri;
+  gint64     size;
+  gboolean   rewritten = FALSE;
+  gint       i;
+
+  uri           = g_build_filename (g_get_tmp_dir (),
+                                    "gimp-test-incremental.xcf", NULL);
+  reference_uri = g_build_filename (g_get_tmp_dir (),
+                                    "gimp-test-reference.xcf", NULL);
+
+  image = gimp_create_mainimage (gimp,
+                                 FALSE /*with_unusual_stuff*/,
+                                 FALSE /*compat_paths*/,
+                                 TRUE /*use_gimp_2_8_features*/);
+  gimp_test_fill_image (image, 0);
+  gimp_test_save_image (image, uri);
+
+  size = gimp_test_file_size (uri);
+
+  for (i = 1; i <= GIMP_INCREMENTAL_MAX_SAVES && ! rewritten; i++)
+    {
+      gint64 new_size;
+
+      gimp_test_fill_image (image, i);
+      gimp_test_save_image (image, uri);
+
+      gimp_assert_image_pixels (image, uri);
+
+      new_size  = gimp_test_file_size (uri);
+      rewritten = new_size < size;
+      size      = new_size;
+    }
+
+  g_assert (rewritten);
+
+  gimp_test_save_image (image, reference_uri);
+  gimp_assert_files_equal (uri, reference_uri);
+
+  g_unlink (uri);
+  g_unlink (reference_uri);
+  g_free (uri);
+  g_free (reference_uri);
+}
+
+/**
+ * write_and_read_compression_none:
+ * @data:
+ *
+ * Writes an image with uncompressed tiles, then reads the file and
+ * makes sure the pixels of all drawables survived.
+ **/
+static void
+write_and_read_compression_none (gconstpointer data)
+{
+  Gimp *gimp = GIMP (data);
+
+  gimp_write_and_read_compressed (gimp, COMPRESS_NONE, 3);
+}
+
+/**
+ * write_and_read_compression_rle:
+ * @data:
+ *
+ * Writes an image with RLE compressed tiles, then reads the file and
+ * makes sure the pixels of all drawables survived.
+ **/
+static void
+write_and_read_compression_rle (gconstpointer data)
+{
+  Gimp *gimp = GIMP (data);
+
+  gimp_write_and_read_compressed (gimp, COMPRESS_RLE, 3);
+}
+
+#ifdef HAVE_ZLIB
+
+/**
+ * write_and_read_compression_zlib:
+ * @data:
+ *
+ * Writes an image with zlib compressed tiles, which needs file
+ * version 4, then reads the file and makes sure the pixels of all
+ * drawables survived.  Also makes sure that the xcf-zlib-compression
+ * option makes a normal save write such a file.
+ **/
+static void
+write_and_read_compression_zlib (gconstpointer data)
+{
+  Gimp      *gimp = GIMP (data);
+  GimpImage *image;
+  gchar     *uri;
+
+  gimp_write_and_read_compressed (gimp, COMPRESS_ZLIB, 4);
+
+  uri = g_build_filename (g_get_tmp_dir (), "gimp-test-zlib.xcf", NULL);
+
+  image = gimp_create_mainimage (gimp,
+                                 FALSE /*with_unusual_stuff*/,
+                                 FALSE /*compat_paths*/,
+                                 TRUE /*use_gimp_2_8_features*/);
+  gimp_test_fill_image (image, 0);
+
+  g_object_set (gimp->config, "xcf-zlib-compression", TRUE, NULL);
+  gimp_test_save_image (image, uri);
+  g_object_set (gimp->config, "xcf-zlib-compression", FALSE, NULL);
+
+  gimp_assert_file_version (uri, 4);
+  gimp_assert_image_pixels (image, uri);
+
+  g_unlink (uri);
+  g_free (uri);
+}
+
+/**
+ * load_corrupt_zlib_tile:
+ * @data:
+ *
+ * Breaks the zlib stream of the first tile of the only layer of a
+ * saved image, and makes sure that loading the file fails with an
+ * error instead of giving garbage pixels.
+ **/
+static void
+load_corrupt_zlib_tile (gconstpointer data)
+{
+  Gimp                *gimp  = GIMP (data);
+  GimpImage           *image;
+  GimpLayer           *layer;
+  TileManager         *tiles;
+  GimpPlugInProcedure *proc;
+  GimpPDBStatusType    status;
+  GHashTable          *hierarchies;
+  gchar               *uri;
+  gchar               *contents;
+  gsize                length;
+  guint32              hierarchy;
+  guint32              level;
+  guint32              tile;
+  GError              *error = NULL;
+
+  uri = g_build_filename (g_get_tmp_dir (), "gimp-test-corrupt.xcf", NULL);
+
+  image = gimp_image_new (gimp,
+                          GIMP_MAINIMAGE_WIDTH,
+                          GIMP_MAINIMAGE_HEIGHT,
+                          GIMP_MAINIMAGE_TYPE);
+  layer = gimp_layer_new (image,
+                          GIMP_MAINIMAGE_WIDTH,
+                          GIMP_MAINIMAGE_HEIGHT,
+                          GIMP_MAINIMAGE_LAYER1_TYPE,
+                          GIMP_MAINIMAGE_LAYER1_NAME,
+                          GIMP_MAINIMAGE_LAYER1_OPACITY,
+                          GIMP_MAINIMAGE_LAYER1_MODE);
+  gimp_image_add_layer (image,
+                        layer,
+                        NULL,
+                        0,
+                        FALSE /*push_undo*/);
+  gimp_test_fill_drawable (GIMP_DRAWABLE (layer), 0);
+
+  hierarchies = gimp_test_save_image_compressed (image, uri, COMPRESS_ZLIB);
+
+  tiles     = gimp_drawable_get_tiles (GIMP_DRAWABLE (layer));
+  hierarchy = GPOINTER_TO_UINT (g_hash_table_lookup (hierarchies,
+                                                     GUINT_TO_POINTER (tile_manager_get_serial (tiles))));
+  g_assert_cmpuint (hierarchy, >, 0);
+
+  g_hash_table_unref (hierarchies);
+
+  g_assert (g_file_get_contents (uri, &contents, &length, NULL));
+
+  /* The hierarchy starts with width, height and bpp, followed by the
+   * offset of the first level, which starts with width and height,
+   * followed by the offset of the first tile.
+   */
+  g_assert_cmpuint (hierarchy + 16, <=, length);
+  memcpy (&level, contents + hierarchy + 12, 4);
+  level = GUINT32_FROM_BE (level);
+
+  g_assert_cmpuint (level + 12, <=, length);
+  memcpy (&tile, contents + level + 8, 4);
+  tile = GUINT32_FROM_BE (tile);
+
+  /* Break the zlib header of the tile */
+  g_assert_cmpuint (tile + 2, <=, length);
+  contents[tile]     ^= 0xff;
+  contents[tile + 1] ^= 0xff;
+
+  g_assert (g_file_set_contents (uri, contents, length, NULL));
+  g_free (contents);
+
+  proc = file_procedure_find (gimp->plug_in_manager->load_procs,
+                              uri,
+                              NULL /*error*/);
+  image = file_open_image (gimp,
+                           gimp_get_user_context (gimp),
+                           NULL /*progress*/,
+                           uri,
+                           "irrelevant" /*entered_filename*/,
+                           FALSE /*as_new*/,
+                           proc,
+                           GIMP_RUN_NONINTERACTIVE,
+                           &status,
+                           NULL /*mime_type*/,
+                           &error);
+
+  g_assert (image == NULL);
+  g_assert (error != NULL);
+
+  g_clear_error (&error);
+  g_unlink (uri);
+  g_free (uri);
+}
+
+#endif /* HAVE_ZLIB */
+
+GimpImage *
+gimp_test_load_image (Gimp        *gimp,
+                      const gchar *uri)
+{
+  GimpPlugInProcedure *proc     = NULL;
+  GimpImage           *image    = NULL;
+  GimpPDBStatusType    not_used = 0;
+
+  proc = file_procedure_find (gimp->plug_in_manager->load_procs,
+                              uri,
+                              NULL /*error*/);
+  image = file_open_image (gimp,
+                           gimp_get_user_context (gimp),
+                           NULL /*progress*/,
+                           uri,
+                           "irrelevant" /*entered_filename*/,
+                           FALSE /*as_new*/,
+                           proc,
+                           GIMP_RUN_NONINTERACTIVE,
+                           &not_used /*status*/,
+                           NULL /*mime_type*/,
+                           NULL /*error*/);
+
+  return image;
+}
+
+/**
+ * gimp_write_and_read_file:
+ *
+ * Constructs the main test image and asserts its state, writes it to
+ * a file, reads the image from the file, and asserts the state of the
+ * loaded file. The function takes various parameters so the same
+ * function can be used for different formats.
+ **/
+static void
+gimp_write_and_read_file (Gimp     *gimp,
+                          gboolean  with_unusual_stuff,
+                          gboolean  compat_paths,
+                          gboolean  use_gimp_2_8_features)
+{
+  GimpImage           *image        = NULL;
+  GimpImage           *loaded_image = NULL;
+  GimpPlugInProcedure *proc         = NULL;
+  gchar               *uri          = NULL;
+
+  /* Create the image */
+  image = gimp_create_mainimage (gimp,
+                                 with_unusual_stuff,
+                                 compat_paths,
+                                 use_gimp_2_8_features);
+
+  /* Assert valid state */
+  gimp_assert_mainimage (image,
+                         with_unusual_stuff,
+                         compat_paths,
+                         use_gimp_2_8_features);
+
+  /* Write to file */
+  uri  = g_build_filename (g_get_tmp_dir (), "gimp-test.xcf", NULL);
+  proc = file_procedure_find (image->gimp->plug_in_manager->save_procs,
+                              uri,
+                              NULL /*error*/);
+  file_save (gimp,
+             image,
+             NULL /*progress*/,
+             uri,
+             proc,
+             GIMP_RUN_NONINTERACTIVE,
+             FALSE /*change_saved_state*/,
+             FALSE /*export_backward*/,
+             FALSE /*export_forward*/,
+             NULL /*error*/);
+
+  /* Load from file */
+  loaded_image = gimp_test_load_image (image->gimp, uri);
+
+  /* Assert on the loaded file. If success, it means that there is no
+   * significant information loss when we wrote the image to a file
+   * and loaded it again
+   */
+  gimp_assert_mainimage (loaded_image,
+                         with_unusual_stuff,
+                         compat_paths,
+                         use_gimp_2_8_features);
+
+  g_unlink (uri);
+  g_free (uri);
+}
+
+static void
+gimp_test_save_image (GimpImage   *image,
+                      const gchar *uri)
+{
+  GimpPlugInProcedure *proc = NULL;
+
+  proc = file_procedure_find (image->gimp->plug_in_manager->save_procs,
+                              uri,
+                              NULL /*error*/);
+  g_assert (file_save (image->gimp,
+                       image,
+                       NULL /*progress*/,
+                       uri,
+                       proc,
+                       GIMP_RUN_NONINTERACTIVE,
+                       FALSE /*change_saved_state*/,
+                       FALSE /*export_backward*/,
+                       FALSE /*export_forward*/,
+                       NULL /*error*/) == GIMP_PDB_SUCCESS);
+}
+
+static gint64
+gimp_test_file_size (const gchar *uri)
+{
+  struct stat st;
+
+  g_assert (g_stat (uri, &st) == 0);
+
+  return st.st_size;
+}
+
+/**
+ * gimp_test_fill_drawable:
+ *
+ * Fills the drawable with a pattern that doesn't compress, and that
+ * differs for each @seed.
+ **/
+static void
+gimp_test_fill_drawable (GimpDrawable *drawable,
+                         gint          seed)
+{
+  PixelRegion  region;
+  gpointer     pr;
+
+  pixel_region_init (&region, gimp_drawable_get_tiles (drawable),
+                     0, 0,
+                     gimp_item_get_width  (GIMP_ITEM (drawable)),
+                     gimp_item_get_height (GIMP_ITEM (drawable)),
+                     TRUE);
+
+  for (pr = pixel_regions_register (1, &region);
+       pr != NULL;
+       pr = pixel_regions_process (pr))
+    {
+      guchar *row = region.data;
+      gint    y;
+
+      for (y = 0; y < region.h; y++)
+        {
+          gint x;
+
+          for (x = 0; x < region.w * region.bytes; x++)
+            row[x] = ((region.x * region.bytes + x) * 7 +
+                      (region.y + y) * 13 + seed * 31);
+
+          row += region.rowstride;
+        }
+    }
+}
+
+/**
+ * gimp_test_fill_image:
+ *
+ * Fills all layers, layer masks and channels of the image, except for
+ * layer groups and the selection.
+ **/
+static void
+gimp_test_fill_image (GimpImage *image,
+                      gint       seed)
+{
+  GList *drawables;
+  GList *list;
+
+  drawables = g_list_concat (gimp_image_get_layer_list (image),
+                             gimp_image_get_channel_list (image));
+
+  for (list = drawables; list; list = g_list_next (list))
+    {
+      GimpDrawable *drawable = list->data;
+
+      if (GIMP_IS_GROUP_LAYER (drawable))
+        continue;
+
+      gimp_test_fill_drawable (drawable, seed);
+
+      if (GIMP_IS_LAYER (drawable) &&
+          gimp_layer_get_mask (GIMP_LAYER (drawable)))
+        gimp_test_fill_drawable (GIMP_DRAWABLE (gimp_layer_get_mask (GIMP_LAYER (drawable))),
+                                 seed);
+    }
+
+  g_list_free (drawables);
+}
+
+static void
+gimp_assert_drawables_equal (GimpDrawable *drawable,
+                             GimpDrawable *loaded)
+{
+  PixelRegion  src;
+  PixelRegion  dest;
+  gint         width  = gimp_item_get_width  (GIMP_ITEM (drawable));
+  gint         height = gimp_item_get_height (GIMP_ITEM (drawable));
+  gpointer     pr;
+
+  g_assert_cmpint (gimp_item_get_width  (GIMP_ITEM (loaded)), ==, width);
+  g_assert_cmpint (gimp_item_get_height (GIMP_ITEM (loaded)), ==, height);
+  g_assert_cmpint (gimp_drawable_bytes (loaded), ==,
+                   gimp_drawable_bytes (drawable));
+
+  pixel_region_init (&src, gimp_drawable_get_tiles (drawable),
+                     0, 0, width, height, FALSE);
+  pixel_region_init (&dest, gimp_drawable_get_tiles (loaded),
+                     0, 0, width, height, FALSE);
+
+  for (pr = pixel_regions_register (2, &src, &dest);
+       pr != NULL;
+       pr = pixel_regions_process (pr))
+    {
+      const guchar *s = src.data;
+      const guchar *d = dest.data;
+      gint          y;
+
+      for (y = 0; y < src.h; y++)
+        {
+          g_assert (memcmp (s, d, src.w * src.bytes) == 0);
+
+          s += src.rowstride;
+          d += dest.rowstride;
+        }
+    }
+}
+
+/**
+ * gimp_assert_image_pixels:
+ *
+ * Loads the image from @uri and asserts that the pixels of all its
+ * drawables, except for the projections of layer groups, are the ones
+ * of @image.
+ **/
+static void
+gimp_assert_image_pixels (GimpImage   *image,
+                          const gchar *uri)
+{
+  GimpImage *loaded_image;
+  GList     *drawables;
+  GList     *loaded_drawables;
+  GList     *list;
+  GList     *loaded_list;
+
+  loaded_image = gimp_test_load_image (image->gimp, uri);
+  g_assert (loaded_image != NULL);
+
+  drawables        = g_list_concat (gimp_image_get_layer_list (image),
+                                    gimp_image_get_channel_list (image));
+  loaded_drawables = g_list_concat (gimp_image_get_layer_list (loaded_image),
+                                    gimp_image_get_channel_list (loaded_image));
+
+  g_assert_cmpint (g_list_length (loaded_drawables), ==,
+                   g_list_length (drawables));
+
+  for (list = drawables, loaded_list = loaded_drawables;
+       list;
+       list = g_list_next (list), loaded_list = g_list_next (loaded_list))
+    {
+      GimpDrawable *drawable = list->data;
+      GimpDrawable *loaded   = loaded_list->data;
+
+      if (GIMP_IS_GROUP_LAYER (drawable))
+        continue;
+
+      gimp_assert_drawables_equal (drawable, loaded);
+
+      if (GIMP_IS_LAYER (drawable) &&
+          gimp_layer_get_mask (GIMP_LAYER (drawable)))
+        {
+          GimpLayerMask *loaded_mask = gimp_layer_get_mask (GIMP_LAYER (loaded));
+
+          g_assert (loaded_mask != NULL);
+
+          gimp_assert_drawables_equal (GIMP_DRAWABLE (gimp_layer_get_mask (GIMP_LAYER (drawable))),
+                                       GIMP_DRAWABLE (loaded_mask));
+        }
+    }
+
+  gimp_assert_drawables_equal (GIMP_DRAWABLE (gimp_image_get_mask (image)),
+                               GIMP_DRAWABLE (gimp_image_get_mask (loaded_image)));
+
+  g_list_free (drawables);
+  g_list_free (loaded_drawables);
+}
+
+static void
+gimp_assert_files_equal (const gchar *uri1,
+                         const gchar *uri2)
+{
+  gchar *contents1;
+  gchar *contents2;
+  gsize  length1;
+  gsize  length2;
+
+  g_assert (g_file_get_contents (uri1, &contents1, &length1, NULL));
+  g_assert (g_file_get_contents (uri2, &contents2, &length2, NULL));
+
+  g_assert_cmpuint (length1, ==, length2);
+  g_assert (memcmp (contents1, contents2, length1) == 0);
+
+  g_free (contents1);
+  g_free (contents2);
+}
+
+/**
+ * gimp_write_and_read_compressed:
+ *
+ * Writes the main test image with tiles of the given @compression,
+ * makes sure the file got @file_version, and that loading it gives
+ * the pixels of every drawable.
+ **/
+static void
+gimp_write_and_read_compressed (Gimp               *gimp,
+                                XcfCompressionType  compression,
+                                gint                file_version)
+{
+  GimpImage *image;
+  gchar     *uri;
+
+  uri = g_build_filename (g_get_tmp_dir (), "gimp-test-compressed.xcf", NULL);
+
+  image = gimp_create_mainimage (gimp,
+                                 FALSE /*with_unusual_stuff*/,
+                                 FALSE /*compat_paths*/,
+                                 TRUE /*use_gimp_2_8_features*/);
+  gimp_test_fill_image (image, 0);
+
+  g_hash_table_unref (gimp_test_save_image_compressed (image, uri,
+                                                       compression));
+
+  gimp_assert_file_version (uri, file_version);
+  gimp_assert_image_pixels (image, uri);
+
+  g_unlink (uri);
+  g_free (uri);
+}
+
+/**
+ * gimp_test_save_image_compressed:
+ *
+ * Writes @image to @uri the way the XCF save procedure does, but with
+ * tiles of the given @compression, which the procedure only chooses
+ * from the configuration.
+ *
+ * Returns: the offsets of the hierarchies in the file, by tile
+ *          manager serial.
+ **/
+static GHashTable *
+gimp_test_save_image_compressed (GimpImage          *image,
+                                 const gchar        *uri,
+                                 XcfCompressionType  compression)
+{
+  XcfInfo info = { 0, };
+
+  info.gimp        = image->gimp;
+  info.filename    = uri;
+  info.compression = compression;
+  info.hierarchies = g_hash_table_new (NULL, NULL);
+  info.fp          = g_fopen (uri, "wb");
+
+  g_assert (info.fp != NULL);
+
+  xcf_save_choose_format (&info, image);
+
+  g_assert (xcf_save_image (&info, image, NULL));
+  g_assert (fclose (info.fp) == 0);
+
+  return info.hierarchies;
+}
+
+static void
+gimp_assert_file_version (const gchar *uri,
+                          gint         file_version)
+{
+  gchar *contents;
+  gchar  version_tag[16];
+  gsize  length;
+
+  g_snprintf (version_tag, sizeof (version_tag),
+              "gimp xcf v%03d", file_version);
+
+  g_assert (g_file_get_contents (uri, &contents, &length, NULL));
+
+  g_assert_cmpuint (length, >=, 14);
+  g_assert (memcmp (contents, version_tag, 14) == 0);
+
+  g_free (contents);
+}
+
+/**
+ * gimp_create_mainimage:
+ *
+ * Creates the main test image, i.e. the image that we use for most of
+ * our XCF testing purposes.
+ *
+ * Returns: The #GimpImage
+ **/
+static GimpImage *
+gimp_create_mainimage (Gimp     *gimp,
+                       gboolean  with_unusual_stuff,
+                       gboolean  compat_paths,
+                       gboolean  use_gimp_2_8_features)
+{
+  GimpImage     *image             = NULL;
+  GimpLayer     *layer             = NULL;
+  GimpParasite  *parasite          = NULL;
+  GimpGrid      *grid              = NULL;
+  GimpChannel   *channel           = NULL;
+  GimpRGB        channel_color     = GIMP_MAINIMAGE_CHANNEL1_COLOR;
+  GimpChannel   *selection         = NULL;
+  GimpVectors   *vectors           = NULL;
+  GimpCoords     vectors1_coords[] = GIMP_MAINIMAGE_VECTORS1_COORDS;
+  GimpCoords     vectors2_coords[] = GIMP_MAINIMAGE_VECTORS2_COORDS;
+  GimpStroke    *stroke            = NULL;
+  GimpLayerMask *layer_mask        = NULL;
+
+  /* Image size and type */
+  image = gimp_image_new (gimp,
+                          GIMP_MAINIMAGE_WIDTH,
+                          GIMP_MAINIMAGE_HEIGHT,
+                          GIMP_MAINIMAGE_TYPE);
+
+  /* Layers */
+  layer = gimp_layer_new (image,
+                          GIMP_MAINIMAGE_LAYER1_WIDTH,
+                          GIMP_MAINIMAGE_LAYER1_HEIGHT,
+                          GIMP_MAINIMAGE_LAYER1_TYPE,
+                          GIMP_MAINIMAGE_LAYER1_NAME,
+                          GIMP_MAINIMAGE_LAYER1_OPACITY,
+                          GIMP_MAINIMAGE_LAYER1_MODE);
+  gimp_image_add_layer (image,
+                        layer,
+                        NULL,
+                        0,
+                        FALSE/*push_undo*/);
+  layer = gimp_layer_new (image,
+                          GIMP_MAINIMAGE_LAYER2_WIDTH,
+                          GIMP_MAINIMAGE_LAYER2_HEIGHT,
+                          GIMP_MAINIMAGE_LAYER2_TYPE,
+                          GIMP_MAINIMAGE_LAYER2_NAME,
+                          GIMP_MAINIMAGE_LAYER2_OPACITY,
+                          GIMP_MAINIMAGE_LAYER2_MODE);
+  gimp_image_add_layer (image,
+                        layer,
+                        NULL,
+                        0,
+                        FALSE /*push_undo*/);
+
+  /* Layer mask */
+  layer_mask = gimp_layer_create_mask (layer,
+                                       GIMP_ADD_BLACK_MASK,
+                                       NULL /*channel*/);
+  gimp_layer_add_mask (layer,
+                       layer_mask,
+                       FALSE /*push_undo*/,
+                       NULL /*error*/);
+
+  /* Image compression type
+   *
+   * We don't do any explicit test, only implicit when we read tile
+   * data in other tests
+   */
+
+  /* Guides, note we add them in reversed order */
+  gimp_image_add_hguide (image,
+                         GIMP_MAINIMAGE_HGUIDE2_POS,
+                         FALSE /*push_undo*/);
+  gimp_image_add_hguide (image,
+                         GIMP_MAINIMAGE_HGUIDE1_POS,
+                         FALSE /*push_undo*/);
+  gimp_image_add_vguide (image,
+                         GIMP_MAINIMAGE_VGUIDE2_POS,
+                         FALSE /*push_undo*/);
+  gimp_image_add_vguide (image,
+                         GIMP_MAINIMAGE_VGUIDE1_POS,
+                         FALSE /*push_undo*/);
+
+
+  /* Sample points */
+  gimp_image_add_sample_point_at_pos (image,
+                                      GIMP_MAINIMAGE_SAMPLEPOINT1_X,
+                                      GIMP_MAINIMAGE_SAMPLEPOINT1_Y,
+                                      FALSE /*push_undo*/);
+  gimp_image_add_sample_point_at_pos (image,
+                                      GIMP_MAINIMAGE_SAMPLEPOINT2_X,
+                                      GIMP_MAINIMAGE_SAMPLEPOINT2_Y,
+                                      FALSE /*push_undo*/);
+
+  /* Tatto
+   * We don't bother testing this, not yet at least
+   */
+
+  /* Resolution */
+  gimp_image_set_resolution (image,
+                             GIMP_MAINIMAGE_RESOLUTIONX,
+                             GIMP_MAINIMAGE_RESOLUTIONY);
+
+
+  /* Parasites */
+  parasite = gimp_parasite_new (GIMP_MAINIMAGE_PARASITE_NAME,
+                                GIMP_PARASITE_PERSISTENT,
+                                GIMP_MAINIMAGE_PARASITE_SIZE,
+                                GIMP_MAINIMAGE_PARASITE_DATA);
+  gimp_image_parasite_attach (image,
+                              parasite);
+  gimp_parasite_free (parasite);
+  parasite = gimp_parasite_new ("gimp-comment",
+                                GIMP_PARASITE_PERSISTENT,
+                                strlen (GIMP_MAINIMAGE_COMMENT) + 1,
+                                GIMP_MAINIMAGE_COMMENT);
+  gimp_image_parasite_attach (image, parasite);
+  gimp_parasite_free (parasite);
+
+
+  /* Unit */
+  gimp_image_set_unit (image,
+                       GIMP_MAINIMAGE_UNIT);
+
+  /* Grid */
+  grid = g_object_new (GIMP_TYPE_GRID,
+                       "xspacing", GIMP_MAINIMAGE_GRIDXSPACING,
+                       "yspacing", GIMP_MAINIMAGE_GRIDYSPACING,
+                       NULL);
+  gimp_image_set_grid (image,
+                       grid,
+                       FALSE /*push_undo*/);
+  g_object_unref (grid);
+
+  /* Channel */
+  channel = gimp_channel_new (image,
+                              GIMP_MAINIMAGE_CHANNEL1_WIDTH,
+                              GIMP_MAINIMAGE_CHANNEL1_HEIGHT,
+                              GIMP_MAINIMAGE_CHANNEL1_NAME,
+                              &channel_color);
+  gimp_image_add_channel (image,
+                          channel,
+                          NULL,
+                          -1,
+                          FALSE /*push_undo*/);
+
+  /* Selection */
+  selection = gimp_image_get_mask (image);
+  gimp_channel_select_rectangle (selection,
+                                 GIMP_MAINIMAGE_SELECTION_X,
+                                 GIMP_MAINIMAGE_SELECTION_Y,
+                                 GIMP_MAINIMAGE_SELECTION_W,
+                                 GIMP_MAINIMAGE_SELECTION_H,
+                                 GIMP_CHANNEL_OP_REPLACE,
+                                 FALSE /*feather*/,
+                                 0.0 /*feather_radius_x*/,
+                                 0.0 /*feather_radius_y*/,
+                                 FALSE /*push_undo*/);
+
+  /* Vectors 1 */
+  vectors = gimp_vectors_new (image,
+                              GIMP_MAINIMAGE_VECTORS1_NAME);
+  /* The XCF file can save vectors in two kind of ways, one old way
+   * and a new way. Parameterize the way so we can test both variants,
+   * i.e. gimp_vectors_compat_is_compatible() must return both TRUE
+   * and FALSE.
+   */
+  if (! compat_paths)
+    {
+      gimp_item_set_visible (GIMP_ITEM (vectors),
+                             TRUE,
+                             FALSE /*push_undo*/);
+    }
+  /* TODO: Add test for non-closed stroke. The order of the anchor
+   * points changes for open strokes, so it's boring to test
+   */
+  stroke = gimp_bezier_stroke_new_from_coords (vectors1_coords,
+                                               G_N_ELEMENTS (vectors1_coords),
+                                               TRUE /*closed*/);
+  gimp_vectors_stroke_add (vectors, stroke);
+  gimp_image_add_vectors (image,
+                          vectors,
+                          NULL /*parent*/,
+                          -1 /*position*/,
+                          FALSE /*push_undo*/);
+
+  /* Vectors 2 */
+  vectors = gimp_vectors_new (image,
+                              GIMP_MAINIMAGE_VECTORS2_NAME);
+
+  stroke = gimp_bezier_stroke_new_from_coords (vectors2_coords,
+                                               G_N_ELEMENTS (vectors2_coords),
+                                               TRUE /*closed*/);
+  gimp_vectors_stroke_add (vectors, stroke);
+  gimp_image_add_vectors (image,
+                          vectors,
+                          NULL /*parent*/,
+                          -1 /*position*/,
+                          FALSE /*push_undo*/);
+
+  /* Some of these things are pretty unusual, parameterize the
+   * inclusion of this in the written file so we can do our test both
+   * with and without
+   */
+  if (with_unusual_stuff)
+    {
+      /* Floating selection */
+      gimp_selection_float (GIMP_SELECTION (gimp_image_get_mask (image)),
+                            gimp_image_get_active_drawable (image),
+                            gimp_get_user_context (gimp),
+                            TRUE /*cut_image*/,
+                            0 /*off_x*/,
+                            0 /*off_y*/,
+                            NULL /*error*/);
+    }
+
+  /* Adds stuff like layer groups */
+  if (use_gimp_2_8_features)
+    {
+      GimpLayer *parent;
+
+      /* Add a layer group and some layers:
+       *
+       *  group1
+       *    layer3
+       *    layer4
+       *    group2
+       *      layer5
+       */
+
+      /* group1 */
+      layer = gimp_group_layer_new (image);
+      gimp_object_set_name (GIMP_OBJECT (layer), GIMP_MAINIMAGE_GROUP1_NAME);
+      gimp_image_add_layer (image,
+                            layer,
+                            NULL /*parent*/,
+                            -1 /*position*/,
+                            FALSE /*push_undo*/);
+      parent = layer;
+
+      /* layer3 */
+      layer = gimp_layer_new (image,
+                              GIMP_MAINIMAGE_LAYER1_WIDTH,
+                              GIMP_MAINIMAGE_LAYER1_HEIGHT,
+                              GIMP_MAINIMAGE_LAYER1_TYPE,
+                              GIMP_MAINIMAGE_LAYER3_NAME,
+                              GIMP_MAINIMAGE_LAYER1_OPACITY,
+                              GIMP_MAINIMAGE_LAYER1_MODE);
+      gimp_image_add_layer (image,
+                            layer,
+                            parent,
+                            -1 /*position*/,
+                            FALSE /*push_undo*/);
+
+      /* layer4 */
+      layer = gimp_layer_new (image,
+                              GIMP_MAINIMAGE_LAYER1_WIDTH,
+                              GIMP_MAINIMAGE_LAYER1_HEIGHT,
+                              GIMP_MAINIMAGE_LAYER1_TYPE,
+                              GIMP_MAINIMAGE_LAYER4_NAME,
+                              GIMP_MAINIMAGE_LAYER1_OPACITY,
+                              GIMP_MAINIMAGE_LAYER1_MODE);
+      gimp_image_add_layer (image,
+                            layer,
+                            parent,
+                            -1 /*position*/,
+                            FALSE /*push_undo*/);
+
+      /* group2 */
+      layer = gimp_group_layer_new (image);
+      gimp_object_set_name (GIMP_OBJECT (layer), GIMP_MAINIMAGE_GROUP2_NAME);
+      gimp_image_add_layer (image,
+                            layer,
+                            parent,
+                            -1 /*position*/,
+                            FALSE /*push_undo*/);
+      parent = layer;
+
+      /* layer5 */
+      layer = gimp_layer_new (image,
+                              GIMP_MAINIMAGE_LAYER1_WIDTH,
+                              GIMP_MAINIMAGE_LAYER1_HEIGHT,
+                              GIMP_MAINIMAGE_LAYER1_TYPE,
+                              GIMP_MAINIMAGE_LAYER5_NAME,
+                              GIMP_MAINIMAGE_LAYER1_OPACITY,
+                              GIMP_MAINIMAGE_LAYER1_MODE);
+      gimp_image_add_layer (image,
+                            layer,
+                            parent,
+                            -1 /*position*/,
+                            FALSE /*push_undo*/);
+    }
+
+  /* Todo, should be tested somehow:
+   *
+   * - Color maps
+   * - Custom user units
+   * - Text layers
+   * - Layer parasites
+   * - Channel parasites
+   * - Different tile compression methods
+   */
+
+  return image;
+}
+
+static void
+gimp_assert_vectors (GimpImage   *image,
+                     const gchar *name,
+                     GimpCoords   coords[],
+                     gsize        coords_size,
+                     gboolean     visible)
+{
+  GimpVectors *vectors        = NULL;
+  GimpStroke  *stroke         = NULL;
+  GArray      *control_points = NULL;
+  gboolean     closed         = FALSE;
+  gint         i              = 0;
+
+  vectors = gimp_image_get_vectors_by_name (image, name);
+  stroke = gimp_vectors_stroke_get_next (vectors, NULL);
+  g_assert (stroke != NULL);
+  control_points = gimp_stroke_control_points_get (stroke,
+                                                   &closed);
+  g_assert (closed);
+  g_assert_cmpint (control_points->len,
+                   ==,
+                   coords_size);
+  for (i = 0; i < control_points->len; i++)
+    {
+      g_assert_cmpint (coords[i].x,
+                       ==,
+                       g_array_index (control_points,
+                                      GimpAnchor,
+                                      i).position.x);
+      g_assert_cmpint (coords[i].y,
+                       ==,
+                       g_array_index (control_points,
+                                      GimpAnchor,
+                                      i).position.y);
+    }
+
+  g_assert (gimp_item_get_visible (GIMP_ITEM (vectors)) ? TRUE : FALSE ==
+            visible ? TRUE : FALSE);
+}
+
+/**
+ * gimp_assert_mainimage:
+ * @image:
+ *
+ * Verifies that the passed #GimpImage contains all the information
+ * that was put in it by gimp_create_mainimage().
+ **/
+static void
+gimp_assert_mainimage (GimpImage *image,
+                       gboolean   with_unusual_stuff,
+                       gboolean   compat_paths,
+                       gboolean   use_gimp_2_8_features)
+{
+  const GimpParasite *parasite               = NULL;
+  GimpLayer          *layer                  = NULL;
+  GList              *iter                   = NULL;
+  GimpGuide          *guide                  = NULL;
+  GimpSamplePoint    *sample_point           = NULL;
+  gdouble             xres                   = 0.0;
+  gdouble             yres                   = 0.0;
+  GimpGrid           *grid                   = NULL;
+  gdouble             xspacing               = 0.0;
+  gdouble             yspacing               = 0.0;
+  GimpChannel        *channel                = NULL;
+  GimpRGB             expected_channel_color = GIMP_MAINIMAGE_CHANNEL1_COLOR;
+  GimpRGB             actual_channel_color   = { 0, };
+  GimpChannel        *selection              = NULL;
+  gint                x1                     = -1;
+  gint                y1                     = -1;
+  gint                x2                     = -1;
+  gint                y2                     = -1;
+  gint                w                      = -1;
+  gint                h                      = -1;
+  GimpCoords          vectors1_coords[]      = GIMP_MAINIMAGE_VECTORS1_COORDS;
+  GimpCoords          vectors2_coords[]      = GIMP_MAINIMAGE_VECTORS2_COORDS;
+
+  /* Image size and type */
+  g_assert_cmpint (gimp_image_get_width (image),
+                   ==,
+                   GIMP_MAINIMAGE_WIDTH);
+  g_assert_cmpint (gimp_image_get_height (image),
+                   ==,
+                   GIMP_MAINIMAGE_HEIGHT);
+  g_assert_cmpint (gimp_image_base_type (image),
+                   ==,
+                   GIMP_MAINIMAGE_TYPE);
+
+  /* Layers */
+  layer = gimp_image_get_layer_by_name (image,
+                                        GIMP_MAINIMAGE_LAYER1_NAME);
+  g_assert_cmpint (gimp_item_get_width (GIMP_ITEM (layer)),
+                   ==,
+                   GIMP_MAINIMAGE_LAYER1_WIDTH);
+  g_assert_cmpint (gimp_item_get_height (GIMP_ITEM (layer)),
+                   ==,
+                   GIMP_MAINIMAGE_LAYER1_HEIGHT);
+  g_assert_cmpint (gimp_drawable_type (GIMP_DRAWABLE (layer)),
+                   ==,
+                   GIMP_MAINIMAGE_LAYER1_TYPE);
+  g_assert_cmpstr (gimp_object_get_name (GIMP_DRAWABLE (layer)),
+                   ==,
+                   GIMP_MAINIMAGE_LAYER1_NAME);
+  g_assert_cmpfloat (gimp_layer_get_opacity (layer),
+                     ==,
+                     GIMP_MAINIMAGE_LAYER1_OPACITY);
+  g_assert_cmpint (gimp_layer_get_mode (layer),
+                   ==,
+                   GIMP_MAINIMAGE_LAYER1_MODE);
+  layer = gimp_image_get_layer_by_name (image,
+                                        GIMP_MAINIMAGE_LAYER2_NAME);
+  g_assert_cmpint (gimp_item_get_width (GIMP_ITEM (layer)),
+                   ==,
+                   GIMP_MAINIMAGE_LAYER2_WIDTH);
+  g_assert_cmpint (gimp_item_get_height (GIMP_ITEM (layer)),
+                   ==,
+                   GIMP_MAINIMAGE_LAYER2_HEIGHT);
+  g_assert_cmpint (gimp_drawable_type (GIMP_DRAWABLE (layer)),
+                   ==,
+                   GIMP_MAINIMAGE_LAYER2_TYPE);
+  g_assert_cmpstr (gimp_object_get_name (GIMP_DRAWABLE (layer)),
+                   ==,
+                   GIMP_MAINIMAGE_LAYER2_NAME);
+  g_assert_cmpfloat (gimp_layer_get_opacity (layer),
+                     ==,
+                     GIMP_MAINIMAGE_LAYER2_OPACITY);
+  g_assert_cmpint (gimp_layer_get_mode (layer),
+                   ==,
+                   GIMP_MAINIMAGE_LAYER2_MODE);
+
+  /* Guides, note that we rely on internal ordering */
+  iter = gimp_image_get_guides (image);
+  g_assert (iter != NULL);
+  guide = GIMP_GUIDE (iter->data);
+  g_assert_cmpint (gimp_guide_get_position (guide),
+                   ==,
+                   GIMP_MAINIMAGE_VGUIDE1_POS);
+  iter = g_list_next (iter);
+  g_assert (iter != NULL);
+  guide = GIMP_GUIDE (iter->data);
+  g_assert_cmpint (gimp_guide_get_position (guide),
+                   ==,
+                   GIMP_MAINIMAGE_VGUIDE2_POS);
+  iter = g_list_next (iter);
+  g_assert (iter != NULL);
+  guide = GIMP_GUIDE (iter->data);
+  g_assert_cmpint (gimp_guide_get_position (guide),
+                   ==,
+                   GIMP_MAINIMAGE_HGUIDE1_POS);
+  iter = g_list_next (iter);
+  g_assert (iter != NULL);
+  guide = GIMP_GUIDE (iter->data);
+  g_assert_cmpint (gimp_guide_get_position (guide),
+                   ==,
+                   GIMP_MAINIMAGE_HGUIDE2_POS);
+  iter = g_list_next (iter);
+  g_assert (iter == NULL);
+
+  /* Sample points, we rely on the same ordering as when we added
+   * them, although this ordering is not a necessaity
+   */
+  iter = gimp_image_get_sample_points (image);
+  g_assert (iter != NULL);
+  sample_point = (GimpSamplePoint *) iter->data;
+  g_assert_cmpint (sample_point->x,
+                   ==,
+                   GIMP_MAINIMAGE_SAMPLEPOINT1_X);
+  g_assert_cmpint (sample_point->y,
+                   ==,
+                   GIMP_MAINIMAGE_SAMPLEPOINT1_Y);
+  iter = g_list_next (iter);
+  g_assert (iter != NULL);
+  sample_point = (GimpSamplePoint *) iter->data;
+  g_assert_cmpint (sample_point->x,
+                   ==,
+                   GIMP_MAINIMAGE_SAMPLEPOINT2_X);
+  g_assert_cmpint (sample_point->y,
+                   ==,
+                   GIMP_MAINIMAGE_SAMPLEPOINT2_Y);
+  iter = g_list_next (iter);
+  g_assert (iter == NULL);
+
+  /* Resolution */
+  gimp_image_get_resolution (image, &xres, &yres);
+  g_assert_cmpint (xres,
+                   ==,
+                   GIMP_MAINIMAGE_RESOLUTIONX);
+  g_assert_cmpint (yres,
+                   ==,
+                   GIMP_MAINIMAGE_RESOLUTIONY);
+
+  /* Parasites */
+  parasite = gimp_image_parasite_find (image,
+                                       GIMP_MAINIMAGE_PARASITE_NAME);
+  g_assert_cmpint (gimp_parasite_data_size (parasite),
+                   ==,
+                   GIMP_MAINIMAGE_PARASITE_SIZE);
+  g_assert_cmpstr (gimp_parasite_data (parasite),
+                   ==,
+                   GIMP_MAINIMAGE_PARASITE_DATA);
+  parasite = gimp_image_parasite_find (image,
+                                       "gimp-comment");
+  g_assert_cmpint (gimp_parasite_data_size (parasite),
+                   ==,
+                   strlen (GIMP_MAINIMAGE_COMMENT) + 1);
+  g_assert_cmpstr (gimp_parasite_data (parasite),
+                   ==,
+                   GIMP_MAINIMAGE_COMMENT);
+
+  /* Unit */
+  g_assert_cmpint (gimp_image_get_unit (image),
+                   ==,
+                   GIMP_MAINIMAGE_UNIT);
+
+  /* Grid */
+  grid = gimp_image_get_grid (image);
+  g_object_get (grid,
+                "xspacing", &xspacing,
+                "yspacing", &yspacing,
+                NULL);
+  g_assert_cmpint (xspacing,
+                   ==,
+                   GIMP_MAINIMAGE_GRIDXSPACING);
+  g_assert_cmpint (yspacing,
+                   ==,
+                   GIMP_MAINIMAGE_GRIDYSPACING);
+
+
+  /* Channel */
+  channel = gimp_image_get_channel_by_name (image,
+                                            GIMP_MAINIMAGE_CHANNEL1_NAME);
+  gimp_channel_get_color (channel, &actual_channel_color);
+  g_assert_cmpint (gimp_item_get_width (GIMP_ITEM (channel)),
+                   ==,
+                   GIMP_MAINIMAGE_CHANNEL1_WIDTH);
+  g_assert_cmpint (gimp_item_get_height (GIMP_ITEM (channel)),
+                   ==,
+                   GIMP_MAINIMAGE_CHANNEL1_HEIGHT);
+  g_assert (memcmp (&expected_channel_color,
+                    &actual_channel_color,
+                    sizeof (GimpRGB)) == 0);
+
+  /* Selection, if the image contains unusual stuff it contains a
+   * floating select, and when floating a selection, the selection
+   * mask is cleared, so don't test for the presence of the selection
+   * mask in that case
+   */
+  if (! with_unusual_stuff)
+    {
+      selection = gimp_image_get_mask (image);
+      gimp_channel_bounds (selection, &x1, &y1, &x2, &y2);
+      w = x2 - x1;
+      h = y2 - y1;
+      g_assert_cmpint (x1,
+                       ==,
+                       GIMP_MAINIMAGE_SELECTION_X);
+      g_assert_cmpint (y1,
+                       ==,
+                       GIMP_MAINIMAGE_SELECTION_Y);
+      g_assert_cmpint (w,
+                       ==,
+                       GIMP_MAINIMAGE_SELECTION_W);
+      g_assert_cmpint (h,
+                       ==,
+                       GIMP_MAINIMAGE_SELECTION_H);
+    }
+
+  /* Vectors 1 */
+  gimp_assert_vectors (image,
+                       GIMP_MAINIMAGE_VECTORS1_NAME,
+                       vectors1_coords,
+                       G_N_ELEMENTS (vectors1_coords),
+                       ! compat_paths /*visible*/);
+
+  /* Vectors 2 (always visible FALSE) */
+  gimp_assert_vectors (image,
+                       GIMP_MAINIMAGE_VECTORS2_NAME,
+                       vectors2_coords,
+                       G_N_ELEMENTS (vectors2_coords),
+                       FALSE /*visible*/);
+
+  if (with_unusual_stuff)
+    g_assert (gimp_image_get_floating_selection (image) != NULL);
+  else /* if (! with_unusual_stuff) */
+    g_assert (gimp_image_get_floating_selection (image) == NULL);
+
+  if (use_gimp_2_8_features)
+    {
+      /* Only verify the parent relationships, the layer attributes
+       * are tested above
+       */
+      GimpItem *group1 = GIMP_ITEM (gimp_image_get_layer_by_name (image, GIMP_MAINIMAGE_GROUP1_NAME));
+      GimpItem *layer3 = GIMP_ITEM (gimp_image_get_layer_by_name (image, GIMP_MAINIMAGE_LAYER3_NAME));
+      GimpItem *layer4 = GIMP_ITEM (gimp_image_get_layer_by_name (image, GIMP_MAINIMAGE_LAYER4_NAME));
+      GimpItem *group2 = GIMP_ITEM (gimp_image_get_layer_by_name (image, GIMP_MAINIMAGE_GROUP2_NAME));
+      GimpItem *layer5 = GIMP_ITEM (gimp_image_get_layer_by_name (image, GIMP_MAINIMAGE_LAYER5_NAME));
+
+      g_assert (gimp_item_get_parent (group1) == NULL);
+      g_assert (gimp_item_get_parent (layer3) == group1);
+      g_assert (gimp_item_get_parent (layer4) == group1);
+      g_assert (gimp_item_get_parent (group2) == group1);
+      g_assert (gimp_item_get_parent (layer5) == group2);
+    }
+}
+
+
+/**
+ * main:
+ * @argc:
+ * @argv:
+ *
+ * These tests intend to
+ *
+ *  - Make sure that we are backwards compatible with files created by
+ *    older version of GIMP, i.e. that we can load files from earlier
+ *    version of GIMP
+ *
+ *  - Make sure that the information put into a #GimpImage is not lost
+ *    when the #GimpImage is written to a file and then read again
+ *
+ *  - Make sure that saving an image back to its file, which only
+ *    appends what changed, gives the same pixels when read again
+ *
+ *  - Make sure that tiles survive a write and read with every tile
+ *    compression, and that a broken compressed tile fails the load
+ **/
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_thread_init (NULL);
+  g_type_init ();
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests. We need
+   * the GUI variant for the file procs
+   */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_TEST (write_and_read_gimp_2_6_format);
+  ADD_TEST (write_and_read_gimp_2_6_format_unusual);
+  ADD_TEST (load_gimp_2_6_file);
+  ADD_TEST (write_and_read_gimp_2_8_format);
+  ADD_TEST (save_incremental);
+  ADD_TEST (save_incremental_header_too_large);
+  ADD_TEST (save_incremental_rewrite_unused);
+  ADD_TEST (write_and_read_compression_none);
+  ADD_TEST (write_and_read_compression_rle);
+#ifdef HAVE_ZLIB
+  ADD_TEST (write_and_read_compression_zlib);
+  ADD_TEST (load_corrupt_zlib_tile);
+#endif
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -52,6 +52,13 @@ static void     gimp_histogram_editor_set_image     (GimpImageEditor     *editor
                                                      GimpImage           *image);
 static void     gimp_histogram_editor_layer_changed (GimpImage           *image,
                                                      GimpHistogramEditor *editor);
+static void     gimp_histogram_editor_mask_changed  (GimpHistogramEditor *editor);
+static void     gimp_histogram_editor_drawable_update
+                                                    (GimpHistogramEditor *editor,
+                                                     gint                 x,
+                                                     gint                 y,
+                                                     gint                 width,
+                                                     gint                 height);
 static void     gimp_histogram_editor_frozen_update (GimpHistogramEditor *editor,
                                                      const GParamSpec    *pspec);
 static void     gimp_histogram_editor_update        (GimpHistogramEditor *editor);
@@ -251,7 +258,7 @@ gimp_histogram_editor_set_image (GimpImageEditor *image_editor,
         }
 
       g_signal_handlers_disconnect_by_func (image_editor->image,
-                                            gimp_histogram_editor_update,
+                                            gimp_histogram_editor_mask_changed,
                                             editor);
       g_signal_handlers_disconnect_by_func (image_editor->image,
                                             gimp_histogram_editor_layer_changed,
@@ -292,7 +299,7 @@ gimp_histogram_editor_set_image (GimpImageEditor *image_editor,
                                G_CALLBACK (gimp_histogram_editor_layer_changed),
                                editor, 0);
       g_signal_connect_object (image, "mask-changed",
-                               G_CALLBACK (gimp_histogram_editor_update),
+                               G_CALLBACK (gimp_histogram_editor_mask_changed),
                                editor, G_CONNECT_SWAPPED);
     }
 
@@ -328,7 +335,7 @@ gimp_histogram_editor_layer_changed (GimpImage           *image,
                                             gimp_histogram_editor_menu_update,
                                             editor);
       g_signal_handlers_disconnect_by_func (editor->drawable,
-                                            gimp_histogram_editor_update,
+                                            gimp_histogram_editor_drawable_update,
                                             editor);
       g_signal_handlers_disconnect_by_func (editor->drawable,
                                             gimp_histogram_editor_frozen_update,
@@ -336,6 +343,9 @@ gimp_histogram_editor_layer_changed (GimpImage           *image,
       editor->drawable = NULL;
     }
 
+  if (editor->histogram)
+    gimp_histogram_invalidate_all (editor->histogram);
+
   if (image)
     editor->drawable = (GimpDrawable *) gimp_image_get_active_layer (image);
 
@@ -347,7 +357,7 @@ gimp_histogram_editor_layer_changed (GimpImage           *image,
                                G_CALLBACK (gimp_histogram_editor_frozen_update),
                                editor, G_CONNECT_SWAPPED);
       g_signal_connect_object (editor->drawable, "update",
-                               G_CALLBACK (gimp_histogram_editor_update),
+                               G_CALLBACK (gimp_histogram_editor_drawable_update),
                                editor, G_CONNECT_SWAPPED);
       g_signal_connect_object (editor->drawable, "alpha-changed",
                                G_CALLBACK (gimp_histogram_editor_menu_update),
@@ -374,7 +384,8 @@ gimp_histogram_editor_validate (GimpHistogramEditor *editor)
   if (! editor->valid && editor->histogram)
     {
       if (editor->drawable)
-        gimp_drawable_calculate_histogram (editor->drawable, editor->histogram);
+        gimp_drawable_calculate_histogram_cached (editor->drawable,
+                                                  editor->histogram);
       else
         gimp_histogram_calculate (editor->histogram, NULL, NULL);
 
@@ -386,6 +397,31 @@ gimp_histogram_editor_validate (GimpHistogramEditor *editor)
   return editor->valid;
 }
 
+static void
+gimp_histogram_editor_mask_changed (GimpHistogramEditor *editor)
+{
+  if (editor->histogram)
+    gimp_histogram_invalidate_all (editor->histogram);
+
+  gimp_histogram_editor_update (editor);
+}
+
+/*  Only the rows of tiles that have been painted on are binned again
+ *  when the histogram is validated.
+ */
+static void
+gimp_histogram_editor_drawable_update (GimpHistogramEditor *editor,
+                                       gint                 x,
+                                       gint                 y,
+                                       gint                 width,
+                                       gint                 height)
+{
+  if (editor->histogram)
+    gimp_histogram_invalidate (editor->histogram, x, y, width, height);
+
+  gimp_histogram_editor_update (editor);
+}
+
 static void
 gimp_histogram_editor_frozen_update (GimpHistogramEditor *editor,
                                      const GParamSpec    *pspec)
@@ -20,6 +20,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include <cairo.h>
 #include <gegl.h>
 
@@ -28,6 +32,7 @@
 
 #include "core/core-types.h"
 
+#include "base/pixel-processor.h"
 #include "base/tile.h"
 #include "base/tile-manager.h"
 #include "base/tile-manager-private.h"
@@ -73,9 +78,25 @@
 
 #define MAX_XCF_PARASITE_DATA_LEN (256L * 1024 * 1024)
 
+/* the number of tiles that are read and then decoded at once */
+#define XCF_LOAD_BATCH_TILES      128
+
 /* #define GIMP_XCF_PATH_DEBUG */
 
 
+/*  a tile whose data is read on the main thread and decoded in a
+ *  worker thread
+ */
+typedef struct
+{
+  Tile               *tile;
+  XcfCompressionType  compression;
+  guchar             *data;
+  gint                length;
+  gboolean            success;
+} XcfTileJob;
+
+
 static void            xcf_load_add_masks     (GimpImage    *image);
 static gboolean        xcf_load_image_props   (XcfInfo      *info,
                                                GimpImage    *image);
@@ -107,9 +128,14 @@ static gboolean        xcf_load_level         (XcfInfo      *info,
                                                TileManager  *tiles);
 static gboolean        xcf_load_tile          (XcfInfo      *info,
                                                Tile         *tile);
-static gboolean        xcf_load_tile_rle      (XcfInfo      *info,
-                                               Tile         *tile,
+static void            xcf_read_tile_data     (XcfInfo      *info,
+                                               XcfTileJob   *job,
                                                gint          data_length);
+static void            xcf_decode_tile_jobs   (XcfTileJob   *jobs,
+                                               gint          first,
+                                               gint          last);
+static void            xcf_decode_tile_job    (XcfTileJob   *job);
+static gboolean        xcf_decode_tile_rle    (XcfTileJob   *job);
 static GimpParasite  * xcf_load_parasite      (XcfInfo      *info);
 static gboolean        xcf_load_old_paths     (XcfInfo      *info,
                                                GimpImage    *image);
@@ -277,7 +303,10 @@ xcf_load_image (Gimp     *gimp,
        *  of the channel list.
        */
       if (offset == 0)
-        break;
+        {
+          info->header_size = info->cp;
+          break;
+        }
 
       /* save the current position as it is where the
        *  next channel offset is stored.
@@ -466,6 +495,17 @@ xcf_load_image_props (XcfInfo   *info,
                 return FALSE;
               }
 
+#ifndef HAVE_ZLIB
+            if (compression == COMPRESS_ZLIB)
+              {
+                gimp_message_literal (info->gimp, G_OBJECT (info->progress),
+                                      GIMP_MESSAGE_ERROR,
+                                      "This GIMP was built without zlib "
+                                      "and can't load zlib compressed tiles");
+                return FALSE;
+              }
+#endif
+
             info->compression = compression;
           }
           break;
@@ -1310,6 +1350,7 @@ static gboolean
 xcf_load_hierarchy (XcfInfo     *info,
                     TileManager *tiles)
 {
+  guint32 hierarchy_offset = info->cp;
   guint32 saved_pos;
   guint32 offset;
   guint32 junk;
@@ -1357,6 +1398,13 @@ xcf_load_hierarchy (XcfInfo     *info,
   if (!xcf_load_level (info, tiles))
     return FALSE;
 
+  /* remember where the tiles came from, so they don't have to be
+   *  written out again when the image is saved back to this file.
+   */
+  g_hash_table_insert (info->hierarchies,
+                       GUINT_TO_POINTER (tile_manager_get_serial (tiles)),
+                       GUINT_TO_POINTER (hierarchy_offset));
+
   /* restore the saved position so we'll be ready to
    *  read the next offset.
    */
@@ -1371,15 +1419,14 @@ static gboolean
 xcf_load_level (XcfInfo     *info,
                 TileManager *tiles)
 {
-  guint32 saved_pos;
-  guint32 offset, offset2;
-  guint ntiles;
-  gint  width;
-  gint  height;
-  gint  i;
-  gint  fail;
-  Tile *previous;
-  Tile *tile;
+  XcfTileJob *jobs;
+  guint32    *offsets;
+  guint       ntiles;
+  gint        width;
+  gint        height;
+  gint        i, j, n;
+  gboolean    success = TRUE;
+  Tile       *previous;
 
   info->cp += xcf_read_int32 (info->fp, (guint32 *) &width, 1);
   info->cp += xcf_read_int32 (info->fp, (guint32 *) &height, 1);
@@ -1388,119 +1435,149 @@ xcf_load_level (XcfInfo     *info,
       height != tile_manager_height (tiles))
     return FALSE;
 
-  /* read in the first tile offset.
-   *  if it is '0', then this tile level is empty
-   *  and we can simply return.
-   */
-  info->cp += xcf_read_int32 (info->fp, &offset, 1);
-  if (offset == 0)
-    return TRUE;
+  ntiles = tiles->ntile_rows * tiles->ntile_cols;
 
-  /* Initialise the reference for the in-memory tile-compression
+  /* read in the whole table of tile offsets, it is terminated by
+   *  a '0'.  if the first offset is '0', then this tile level is
+   *  empty and we can simply return.
    */
-  previous = NULL;
+  offsets = g_new0 (guint32, ntiles + 1);
 
-  ntiles = tiles->ntile_rows * tiles->ntile_cols;
-  for (i = 0; i < ntiles; i++)
+  info->cp += xcf_read_int32 (info->fp, offsets, 1);
+  if (offsets[0] == 0)
     {
-      fail = FALSE;
+      g_free (offsets);
+      return TRUE;
+    }
 
-      if (offset == 0)
+  info->cp += xcf_read_int32 (info->fp, offsets + 1, ntiles);
+
+  for (i = 0; i < ntiles; i++)
+    {
+      if (offsets[i] == 0)
         {
           gimp_message_literal (info->gimp, G_OBJECT (info->progress),
 				GIMP_MESSAGE_ERROR,
 				"not enough tiles found in level");
+          g_free (offsets);
           return FALSE;
         }
+    }
 
-      /* save the current position as it is where the
-       *  next tile offset is stored.
-       */
-      saved_pos = info->cp;
-
-      /* read in the offset of the next tile so we can calculate the amount
-         of data needed for this tile*/
-      info->cp += xcf_read_int32 (info->fp, &offset2, 1);
+  if (offsets[ntiles] != 0)
+    {
+      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
+                    "encountered garbage after reading level: %d",
+                    offsets[ntiles]);
+      g_free (offsets);
+      return FALSE;
+    }
 
-      /* if the offset is 0 then we need to read in the maximum possible
-         allowing for negative compression */
-      if (offset2 == 0)
-        offset2 = offset + TILE_WIDTH * TILE_WIDTH * 4 * 1.5;
-                                        /* 1.5 is probably more
-                                           than we need to allow */
+  /* Initialise the reference for the in-memory tile-compression
+   */
+  previous = NULL;
 
-      /* seek to the tile offset */
-      if (! xcf_seek_pos (info, offset, NULL))
-        return FALSE;
+  jobs = g_new0 (XcfTileJob, MIN (ntiles, XCF_LOAD_BATCH_TILES));
 
-      /* get the tile from the tile manager */
-      tile = tile_manager_get (tiles, i, TRUE, TRUE);
+  /* The tiles are read from the file in batches.  Reading stays
+   *  sequential, but decoding the tiles of a batch is spread across
+   *  threads.
+   */
+  for (i = 0; i < ntiles && success; i += n)
+    {
+      n = MIN (ntiles - i, XCF_LOAD_BATCH_TILES);
 
-      /* read in the tile */
-      switch (info->compression)
+      for (j = 0; j < n; j++)
         {
-        case COMPRESS_NONE:
-          if (!xcf_load_tile (info, tile))
-            fail = TRUE;
-          break;
-        case COMPRESS_RLE:
-          if (!xcf_load_tile_rle (info, tile, offset2 - offset))
-            fail = TRUE;
-          break;
-        case COMPRESS_ZLIB:
-          g_error ("xcf: zlib compression unimplemented");
-          fail = TRUE;
-          break;
-        case COMPRESS_FRACTAL:
-          g_error ("xcf: fractal compression unimplemented");
-          fail = TRUE;
-          break;
-        }
+          XcfTileJob *job     = &jobs[j];
+          guint32     offset  = offsets[i + j];
+          guint32     offset2 = offsets[i + j + 1];
+
+          /* if the offset is 0 then we need to read in the maximum possible
+             allowing for negative compression */
+          if (offset2 == 0)
+            offset2 = offset + TILE_WIDTH * TILE_WIDTH * 4 * 1.5;
+                                            /* 1.5 is probably more
+                                               than we need to allow */
+
+          /* get the tile from the tile manager */
+          job->tile        = tile_manager_get (tiles, i + j, TRUE, TRUE);
+          job->compression = info->compression;
+          job->data        = NULL;
+          job->length      = 0;
+          job->success     = TRUE;
+
+          /* seek to the tile offset */
+          if (! xcf_seek_pos (info, offset, NULL))
+            {
+              job->success = FALSE;
+              continue;
+            }
 
-      if (fail)
-        {
-          tile_release (tile, TRUE);
-          return FALSE;
+          /* read in the tile */
+          switch (info->compression)
+            {
+            case COMPRESS_NONE:
+              job->success = xcf_load_tile (info, job->tile);
+              break;
+            case COMPRESS_RLE:
+            case COMPRESS_ZLIB:
+              xcf_read_tile_data (info, job, offset2 - offset);
+              break;
+            case COMPRESS_FRACTAL:
+              g_error ("xcf: fractal compression unimplemented");
+              job->success = FALSE;
+              break;
+            }
         }
 
-      /* To potentially save memory, we compare the
-       *  newly-fetched tile against the last one, and
-       *  if they're the same we copy-on-write mirror one against
-       *  the other.
-       */
-      if (previous != NULL)
+      /* decode the batch on the threads of the pixel processor */
+      if (info->compression != COMPRESS_NONE)
+        pixel_processor_run_ranges ((PixelProcessorRangeFunc)
+                                    xcf_decode_tile_jobs,
+                                    jobs, n, 4);
+
+      for (j = 0; j < n; j++)
         {
-          tile_lock (previous);
-          if (tile_ewidth (tile) == tile_ewidth (previous) &&
-              tile_eheight (tile) == tile_eheight (previous) &&
-              tile_bpp (tile) == tile_bpp (previous) &&
-              memcmp (tile_data_pointer (tile, 0, 0),
-                      tile_data_pointer (previous, 0, 0),
-                      tile_size (tile)) == 0)
-            tile_manager_map (tiles, i, previous);
-          tile_release (previous, FALSE);
-        }
-      tile_release (tile, TRUE);
-      previous = tile_manager_get (tiles, i, FALSE, FALSE);
+          XcfTileJob *job  = &jobs[j];
+          Tile       *tile = job->tile;
 
-      /* restore the saved position so we'll be ready to
-       *  read the next offset.
-       */
-      if (!xcf_seek_pos (info, saved_pos, NULL))
-        return FALSE;
+          g_free (job->data);
+          job->data = NULL;
 
-      /* read in the offset of the next tile */
-      info->cp += xcf_read_int32 (info->fp, &offset, 1);
-    }
+          if (! success || ! job->success)
+            {
+              tile_release (tile, TRUE);
+              success = FALSE;
+              continue;
+            }
 
-  if (offset != 0)
-    {
-      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
-                    "encountered garbage after reading level: %d", offset);
-      return FALSE;
+          /* To potentially save memory, we compare the
+           *  newly-fetched tile against the last one, and
+           *  if they're the same we copy-on-write mirror one against
+           *  the other.
+           */
+          if (previous != NULL)
+            {
+              tile_lock (previous);
+              if (tile_ewidth (tile) == tile_ewidth (previous) &&
+                  tile_eheight (tile) == tile_eheight (previous) &&
+                  tile_bpp (tile) == tile_bpp (previous) &&
+                  memcmp (tile_data_pointer (tile, 0, 0),
+                          tile_data_pointer (previous, 0, 0),
+                          tile_size (tile)) == 0)
+                tile_manager_map (tiles, i + j, previous);
+              tile_release (previous, FALSE);
+            }
+          tile_release (tile, TRUE);
+          previous = tile_manager_get (tiles, i + j, FALSE, FALSE);
+        }
     }
 
-  return TRUE;
+  g_free (jobs);
+  g_free (offsets);
+
+  return success;
 }
 
 static gboolean
@@ -1513,41 +1590,93 @@ xcf_load_tile (XcfInfo *info,
   return TRUE;
 }
 
-static gboolean
-xcf_load_tile_rle (XcfInfo *info,
-                   Tile    *tile,
-                   int     data_length)
+static void
+xcf_read_tile_data (XcfInfo    *info,
+                    XcfTileJob *job,
+                    gint        data_length)
 {
-  guchar *data;
-  guchar val;
-  gint size;
-  gint count;
-  gint length;
-  gint bpp;
-  gint i, j;
-  gint nmemb_read_successfully;
-  guchar *xcfdata, *xcfodata, *xcfdatalimit;
-
   /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
-   * this tile (return TRUE without storing data) as if it did not
-   * contain any data.  It is better than returning FALSE, which would
-   * skip the whole hierarchy while there may still be some valid
-   * tiles in the file.
+   * this tile (leave it alone without storing data) as if it did not
+   * contain any data.  It is better than failing, which would skip
+   * the whole hierarchy while there may still be some valid tiles in
+   * the file.
    */
   if (data_length <= 0)
-    return TRUE;
-
-  bpp = tile_bpp (tile);
+    return;
 
-  xcfdata = xcfodata = g_malloc (data_length);
+  job->data = g_malloc (data_length);
 
   /* we have to use fread instead of xcf_read_* because we may be
      reading past the end of the file here */
-  nmemb_read_successfully = fread ((gchar *) xcfdata, sizeof (gchar),
-                                   data_length, info->fp);
-  info->cp += nmemb_read_successfully;
+  job->length = fread ((gchar *) job->data, sizeof (gchar),
+                       data_length, info->fp);
+  info->cp += job->length;
+}
+
+static void
+xcf_decode_tile_jobs (XcfTileJob *jobs,
+                      gint        first,
+                      gint        last)
+{
+  gint i;
 
-  xcfdatalimit = &xcfodata[nmemb_read_successfully - 1];
+  for (i = first; i < last; i++)
+    xcf_decode_tile_job (&jobs[i]);
+}
+
+/*  Decodes the data of a tile that was read by xcf_read_tile_data().
+ *  This only touches the job, so it can run in any thread.
+ */
+static void
+xcf_decode_tile_job (XcfTileJob *job)
+{
+  if (! job->data || ! job->success)
+    return;
+
+  switch (job->compression)
+    {
+    case COMPRESS_RLE:
+      job->success = xcf_decode_tile_rle (job);
+      break;
+
+    case COMPRESS_ZLIB:
+#ifdef HAVE_ZLIB
+      {
+        uLongf length = tile_size (job->tile);
+
+        job->success = (uncompress (tile_data_pointer (job->tile, 0, 0),
+                                    &length,
+                                    job->data, job->length) == Z_OK &&
+                        length == tile_size (job->tile));
+      }
+#else
+      job->success = FALSE;
+#endif
+      break;
+
+    default:
+      job->success = FALSE;
+      break;
+    }
+}
+
+static gboolean
+xcf_decode_tile_rle (XcfTileJob *job)
+{
+  Tile   *tile = job->tile;
+  guchar *data;
+  guchar  val;
+  gint    size;
+  gint    count;
+  gint    length;
+  gint    bpp;
+  gint    i, j;
+  guchar *xcfdata, *xcfdatalimit;
+
+  bpp = tile_bpp (tile);
+
+  xcfdata      = job->data;
+  xcfdatalimit = &job->data[job->length - 1];
 
   for (i = 0; i < bpp; i++)
     {
@@ -1635,12 +1764,10 @@ xcf_load_tile_rle (XcfInfo *info,
             }
         }
     }
-  g_free (xcfodata);
+
   return TRUE;
 
  bogus_rle:
-  if (xcfodata)
-    g_free (xcfodata);
   return FALSE;
 }
 
@@ -59,7 +59,7 @@ typedef enum
 {
   COMPRESS_NONE              =  0,
   COMPRESS_RLE               =  1,
-  COMPRESS_ZLIB              =  2,  /* unused */
+  COMPRESS_ZLIB              =  2,  /* since version 4 */
   COMPRESS_FRACTAL           =  3   /* unused */
 } XcfCompressionType;
 
@@ -99,6 +99,9 @@ struct _XcfInfo
   gint               *ref_count;
   XcfCompressionType  compression;
   gint                file_version;
+  guint32             header_size;     /* up to the end of the channel list */
+  GHashTable         *hierarchies;     /* tile serial -> hierarchy offset   */
+  GHashTable         *old_hierarchies; /* the same, for the file appended to */
 };
 
 
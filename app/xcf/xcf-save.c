@@ -20,6 +20,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include <cairo.h>
 #include <gegl.h>
 
@@ -28,10 +32,13 @@
 
 #include "core/core-types.h"
 
+#include "base/pixel-processor.h"
 #include "base/tile.h"
 #include "base/tile-manager.h"
 #include "base/tile-manager-private.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "core/gimp.h"
 #include "core/gimpcontainer.h"
 #include "core/gimpchannel.h"
@@ -68,6 +75,23 @@
 #include "gimp-intl.h"
 
 
+/* the number of tiles that are encoded at once */
+#define XCF_SAVE_BATCH_TILES  128
+
+
+/*  a locked tile that is encoded in a worker thread and then written
+ *  out on the main thread
+ */
+typedef struct
+{
+  Tile               *tile;
+  XcfCompressionType  compression;
+  guchar             *data;
+  gint                length;
+  gboolean            bogus;
+} XcfTileJob;
+
+
 static gboolean xcf_save_image_props   (XcfInfo           *info,
                                         GimpImage         *image,
                                         GError           **error);
@@ -94,17 +118,18 @@ static gboolean xcf_save_channel       (XcfInfo           *info,
                                         GError           **error);
 static gboolean xcf_save_hierarchy     (XcfInfo           *info,
                                         TileManager       *tiles,
+                                        guint32           *offset,
                                         GError           **error);
 static gboolean xcf_save_level         (XcfInfo           *info,
                                         TileManager       *tiles,
                                         GError           **error);
-static gboolean xcf_save_tile          (XcfInfo           *info,
-                                        Tile              *tile,
-                                        GError           **error);
-static gboolean xcf_save_tile_rle      (XcfInfo           *info,
-                                        Tile              *tile,
+static void     xcf_encode_tile_jobs   (XcfTileJob        *jobs,
+                                        gint               first,
+                                        gint               last);
+static void     xcf_encode_tile_job    (XcfTileJob        *job);
+static gint     xcf_encode_tile_rle    (Tile              *tile,
                                         guchar            *rlebuf,
-                                        GError           **error);
+                                        gboolean          *bogus);
 static gboolean xcf_save_parasite      (XcfInfo           *info,
                                         GimpParasite      *parasite,
                                         GError           **error);
@@ -211,6 +236,10 @@ xcf_save_choose_format (XcfInfo   *info,
         save_version = MAX (3, save_version);
     }
 
+  /* need version 4 for zlib compressed tiles */
+  if (info->compression == COMPRESS_ZLIB)
+    save_version = MAX (4, save_version);
+
   info->file_version = save_version;
 }
 
@@ -222,6 +251,8 @@ xcf_save_image (XcfInfo    *info,
   GList   *all_layers;
   GList   *all_channels;
   GList   *list;
+  guint32  header_start = info->cp;
+  guint32  header_size;
   guint32  saved_pos;
   guint32  offset;
   guint32  value;
@@ -278,6 +309,22 @@ xcf_save_image (XcfInfo    *info,
 
   xcf_progress_update (info);
 
+  header_size = info->cp - header_start + (n_layers + n_channels + 2) * 4;
+
+  /* when appending to an existing file, the header is moved to the
+   *  start of the file afterwards and has to fit into the room of the
+   *  old one.
+   */
+  if (header_start > 0 && header_size > info->header_size)
+    {
+      g_list_free (all_layers);
+      g_list_free (all_channels);
+
+      return FALSE;
+    }
+
+  info->header_size = header_size;
+
   /* save the current file position as it is the start of where
    *  we place the layer offset information.
    */
@@ -373,6 +420,61 @@ xcf_save_image (XcfInfo    *info,
   return !ferror (info->fp);
 }
 
+gboolean
+xcf_save_image_incremental (XcfInfo    *info,
+                            GimpImage  *image,
+                            GError    **error)
+{
+  guint32  header_start;
+  guint8  *header;
+  GError  *tmp_error = NULL;
+
+  /* The image is appended to the file, reusing the hierarchies of
+   *  all drawables whose tiles didn't change since they were last
+   *  written to it, and then the new header is copied over the old
+   *  one.  Until then the file still holds the previous version of
+   *  the image.
+   */
+  xcf_check_error (xcf_seek_end (info, error));
+
+  header_start = info->cp;
+
+  if (! xcf_save_image (info, image, error))
+    return FALSE;
+
+  header = g_malloc (info->header_size);
+
+  if (! xcf_seek_pos (info, header_start, error))
+    {
+      g_free (header);
+      return FALSE;
+    }
+
+  info->cp += xcf_read_int8 (info->fp, header, info->header_size);
+
+  if (info->cp != header_start + info->header_size)
+    {
+      g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_IO,
+                           _("Could not read back the XCF header"));
+      g_free (header);
+      return FALSE;
+    }
+
+  if (xcf_seek_pos (info, 0, error))
+    info->cp += xcf_write_int8 (info->fp, header, info->header_size,
+                                &tmp_error);
+
+  g_free (header);
+
+  if (tmp_error)
+    {
+      g_propagate_error (error, tmp_error);
+      return FALSE;
+    }
+
+  return ! ferror (info->fp);
+}
+
 static gboolean
 xcf_save_image_props (XcfInfo    *info,
                       GimpImage  *image,
@@ -1190,13 +1292,18 @@ xcf_save_layer (XcfInfo    *info,
    */
   saved_pos = info->cp;
 
-  /*  write out the layer tile hierarchy  */
-  xcf_check_error (xcf_seek_pos (info, info->cp + 8, error));
-  offset = info->cp;
+  /*  reserve room for the hierarchy and layer mask offsets, they are
+   *  written out below.  Don't just seek past them, the hierarchy
+   *  might not be written again.
+   */
+  offset = 0;
+  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_write_int32_check_error (info, &offset, 1);
 
+  /*  write out the layer tile hierarchy  */
   xcf_check_error (xcf_save_hierarchy (info,
                                        gimp_drawable_get_tiles (GIMP_DRAWABLE (layer)),
-                                       error));
+                                       &offset, error));
 
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
   xcf_write_int32_check_error (info, &offset, 1);
@@ -1268,13 +1375,14 @@ xcf_save_channel (XcfInfo      *info,
    */
   saved_pos = info->cp;
 
-  /* write out the channel tile hierarchy */
-  xcf_check_error (xcf_seek_pos (info, info->cp + 4, error));
-  offset = info->cp;
+  /* reserve room for the hierarchy offset */
+  offset = 0;
+  xcf_write_int32_check_error (info, &offset, 1);
 
+  /* write out the channel tile hierarchy */
   xcf_check_error (xcf_save_hierarchy (info,
                                        gimp_drawable_get_tiles (GIMP_DRAWABLE (channel)),
-                                       error));
+                                       &offset, error));
 
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
   xcf_write_int32_check_error (info, &offset, 1);
@@ -1303,19 +1411,45 @@ xcf_calc_levels (gint size,
 static gboolean
 xcf_save_hierarchy (XcfInfo      *info,
                     TileManager  *tiles,
+                    guint32      *hierarchy_offset,
                     GError      **error)
 {
-  guint32 saved_pos;
-  guint32 offset;
-  guint32 width;
-  guint32 height;
-  guint32 bpp;
-  gint    i;
-  gint    nlevels;
-  gint    tmp1, tmp2;
+  gpointer serial;
+  gpointer old_offset;
+  guint32  saved_pos;
+  guint32  offset;
+  guint32  width;
+  guint32  height;
+  guint32  bpp;
+  gint     i;
+  gint     nlevels;
+  gint     tmp1, tmp2;
 
   GError *tmp_error = NULL;
 
+  serial = GUINT_TO_POINTER (tile_manager_get_serial (tiles));
+
+  /* if the same tiles are already in the file, point to them instead
+   *  of writing them out again.
+   */
+  if (g_hash_table_lookup_extended (info->hierarchies, serial,
+                                    NULL, &old_offset) ||
+      (info->old_hierarchies &&
+       g_hash_table_lookup_extended (info->old_hierarchies, serial,
+                                     NULL, &old_offset)))
+    {
+      *hierarchy_offset = GPOINTER_TO_UINT (old_offset);
+
+      g_hash_table_insert (info->hierarchies, serial, old_offset);
+
+      return TRUE;
+    }
+
+  *hierarchy_offset = info->cp;
+
+  g_hash_table_insert (info->hierarchies,
+                       serial, GUINT_TO_POINTER (*hierarchy_offset));
+
   width  = tile_manager_width (tiles);
   height = tile_manager_height (tiles);
   bpp    = tile_manager_bpp (tiles);
@@ -1384,13 +1518,13 @@ xcf_save_level (XcfInfo      *info,
                 TileManager  *level,
                 GError      **error)
 {
-  guint32  saved_pos;
-  guint32  offset;
-  guint32  width;
-  guint32  height;
-  guint    ntiles;
-  gint     i;
-  guchar  *rlebuf;
+  guint32   table_pos;
+  guint32  *offsets;
+  guint32   width;
+  guint32   height;
+  guint     ntiles  = 0;
+  gint      i, j, n;
+  gboolean  success = TRUE;
 
   GError *tmp_error = NULL;
 
@@ -1400,101 +1534,188 @@ xcf_save_level (XcfInfo      *info,
   xcf_write_int32_check_error (info, (guint32 *) &width, 1);
   xcf_write_int32_check_error (info, (guint32 *) &height, 1);
 
-  saved_pos = info->cp;
-
-  /* allocate a temporary buffer to store the rle data before it is
-     written to disk */
-  rlebuf =
-    g_malloc (TILE_WIDTH * TILE_HEIGHT * tile_manager_bpp (level) * 1.5);
+  table_pos = info->cp;
 
   if (level->tiles)
+    ntiles = level->ntile_rows * level->ntile_cols;
+
+  /* the table of tile offsets is terminated by a '0' */
+  offsets = g_new0 (guint32, ntiles + 1);
+
+  if (ntiles > 0)
     {
-      ntiles = level->ntile_rows * level->ntile_cols;
-      xcf_check_error (xcf_seek_pos (info, info->cp + (ntiles + 1) * 4, error));
+      XcfTileJob *jobs;
 
-      for (i = 0; i < ntiles; i++)
+      if (! xcf_seek_pos (info, info->cp + (ntiles + 1) * 4, error))
         {
-          /* save the start offset of where we are writing
-           *  out the next tile.
-           */
-          offset = info->cp;
+          g_free (offsets);
+          return FALSE;
+        }
+
+      jobs = g_new0 (XcfTileJob, MIN (ntiles, XCF_SAVE_BATCH_TILES));
 
-          /* write out the tile. */
-          switch (info->compression)
+      /* The tiles are encoded in batches, spread across threads, and
+       *  then written out one after the other.  The offsets are only
+       *  written at the end, so we don't have to seek back and forth
+       *  for every tile.
+       */
+      for (i = 0; i < ntiles && success; i += n)
+        {
+          n = MIN (ntiles - i, XCF_SAVE_BATCH_TILES);
+
+          for (j = 0; j < n; j++)
             {
-            case COMPRESS_NONE:
-              xcf_check_error (xcf_save_tile (info, level->tiles[i], error));
-              break;
-            case COMPRESS_RLE:
-              xcf_check_error (xcf_save_tile_rle (info, level->tiles[i],
-                               rlebuf, error));
-              break;
-            case COMPRESS_ZLIB:
-              g_error ("xcf: zlib compression unimplemented");
-              break;
-            case COMPRESS_FRACTAL:
-              g_error ("xcf: fractal compression unimplemented");
-              break;
+              XcfTileJob *job = &jobs[j];
+
+              job->tile        = level->tiles[i + j];
+              job->compression = info->compression;
+              job->data        = NULL;
+              job->length      = 0;
+              job->bogus       = FALSE;
+
+              tile_lock (job->tile);
             }
 
-          /* seek back to where we are to write out the next
-           *  tile offset and write it out.
-           */
-          xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-          xcf_write_int32_check_error (info, &offset, 1);
+          /* encode the batch on the threads of the pixel processor */
+          if (info->compression != COMPRESS_NONE)
+            pixel_processor_run_ranges ((PixelProcessorRangeFunc)
+                                        xcf_encode_tile_jobs,
+                                        jobs, n, 4);
 
-          /* increment the location we are to write out the
-           *  next offset.
-           */
-          saved_pos = info->cp;
+          for (j = 0; j < n; j++)
+            {
+              XcfTileJob *job = &jobs[j];
 
-          /* seek to the end of the file which is where
-           *  we will write out the next tile.
-           */
-          xcf_check_error (xcf_seek_end (info, error));
+              if (success)
+                {
+                  offsets[i + j] = info->cp;
+
+                  if (job->bogus)
+                    g_message ("xcf: uh oh! xcf rle tile saving error");
+
+                  if (info->compression == COMPRESS_NONE)
+                    {
+                      info->cp += xcf_write_int8 (info->fp,
+                                                  tile_data_pointer (job->tile,
+                                                                     0, 0),
+                                                  tile_size (job->tile),
+                                                  &tmp_error);
+                    }
+                  else if (job->length < 0)
+                    {
+                      g_set_error_literal (&tmp_error,
+                                           G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                           _("Could not compress tile data"));
+                    }
+                  else
+                    {
+                      info->cp += xcf_write_int8 (info->fp,
+                                                  job->data, job->length,
+                                                  &tmp_error);
+                    }
+
+                  if (tmp_error)
+                    {
+                      g_propagate_error (error, tmp_error);
+                      tmp_error = NULL;
+                      success = FALSE;
+                    }
+                }
+
+              g_free (job->data);
+              job->data = NULL;
+
+              tile_release (job->tile, FALSE);
+            }
         }
-    }
 
-  g_free (rlebuf);
+      g_free (jobs);
+    }
 
-  /* write out a '0' offset position to indicate the end
-   *  of the level offsets.
+  /* write out the tile offsets, ending with the '0' offset that
+   *  indicates the end of the level offsets.
    */
-  offset = 0;
-  xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  if (success)
+    success = xcf_seek_pos (info, table_pos, error);
 
-  return TRUE;
+  if (success)
+    {
+      info->cp += xcf_write_int32 (info->fp, offsets, ntiles + 1, &tmp_error);
+
+      if (tmp_error)
+        {
+          g_propagate_error (error, tmp_error);
+          success = FALSE;
+        }
+    }
+
+  g_free (offsets);
 
+  return success;
 }
 
-static gboolean
-xcf_save_tile (XcfInfo  *info,
-               Tile     *tile,
-               GError  **error)
+static void
+xcf_encode_tile_jobs (XcfTileJob *jobs,
+                      gint        first,
+                      gint        last)
 {
-  GError *tmp_error = NULL;
+  gint i;
 
-  tile_lock (tile);
-  xcf_write_int8_check_error (info, tile_data_pointer (tile, 0, 0),
-                              tile_size (tile));
-  tile_release (tile, FALSE);
-
-  return TRUE;
+  for (i = first; i < last; i++)
+    xcf_encode_tile_job (&jobs[i]);
 }
 
-static gboolean
-xcf_save_tile_rle (XcfInfo  *info,
-                   Tile     *tile,
-                   guchar   *rlebuf,
-                   GError  **error)
+/*  Encodes a locked tile into job->data.  This only touches the job
+ *  and the tile's pixels, so it can run in any thread.
+ */
+static void
+xcf_encode_tile_job (XcfTileJob *job)
 {
-  GError *tmp_error = NULL;
-  gint    len       = 0;
-  gint    bpp;
-  gint    i, j;
+  Tile *tile = job->tile;
 
-  tile_lock (tile);
+  switch (job->compression)
+    {
+    case COMPRESS_NONE:
+      break;
+
+    case COMPRESS_RLE:
+      job->data   = g_malloc (TILE_WIDTH * TILE_HEIGHT * tile_bpp (tile) * 1.5);
+      job->length = xcf_encode_tile_rle (tile, job->data, &job->bogus);
+      break;
+
+    case COMPRESS_ZLIB:
+#ifdef HAVE_ZLIB
+      {
+        uLongf length = compressBound (tile_size (tile));
+
+        job->data = g_malloc (length);
+
+        if (compress2 (job->data, &length,
+                       tile_data_pointer (tile, 0, 0), tile_size (tile),
+                       Z_DEFAULT_COMPRESSION) == Z_OK)
+          job->length = length;
+        else
+          job->length = -1;
+      }
+#else
+      job->length = -1;
+#endif
+      break;
+
+    case COMPRESS_FRACTAL:
+      job->length = -1;
+      break;
+    }
+}
+
+static gint
+xcf_encode_tile_rle (Tile     *tile,
+                     guchar   *rlebuf,
+                     gboolean *bogus)
+{
+  gint len = 0;
+  gint bpp;
+  gint i, j;
 
   bpp = tile_bpp (tile);
 
@@ -1592,13 +1813,10 @@ xcf_save_tile_rle (XcfInfo  *info,
         }
 
       if (count != (tile_ewidth (tile) * tile_eheight (tile)))
-        g_message ("xcf: uh oh! xcf rle tile saving error: %d", count);
+        *bogus = TRUE;
     }
 
-  xcf_write_int8_check_error (info, rlebuf, len);
-  tile_release (tile, FALSE);
-
-  return TRUE;
+  return len;
 }
 
 static gboolean
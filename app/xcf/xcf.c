@@ -20,6 +20,7 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
 
 #include <gegl.h>
 #include <glib/gstdio.h>
@@ -28,6 +29,8 @@
 
 #include "core/core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "core/gimp.h"
 #include "core/gimpimage.h"
 #include "core/gimpparamspecs.h"
@@ -49,6 +52,25 @@ typedef GimpImage * GimpXcfLoaderFunc (Gimp     *gimp,
                                        XcfInfo  *info,
                                        GError  **error);
 
+/*  what we know about the XCF file an image was last loaded from or
+ *  saved to, so it can be saved back by only appending what changed
+ */
+typedef struct
+{
+  gchar              *filename;
+  gint64              device;
+  gint64              inode;
+  gint64              size;
+  gint64              mtime;
+  gchar              *header_checksum;  /* of the room for the header */
+  gint64              full_size;   /* the size when it was last rewritten */
+  guint32             header_size;
+  XcfCompressionType  compression;
+  GHashTable         *hierarchies;
+} XcfFileState;
+
+#define XCF_FILE_STATE_KEY "gimp-xcf-file-state"
+
 
 static GValueArray * xcf_load_invoker (GimpProcedure      *procedure,
                                        Gimp               *gimp,
@@ -63,13 +85,25 @@ static GValueArray * xcf_save_invoker (GimpProcedure      *procedure,
                                        const GValueArray  *args,
                                        GError            **error);
 
+static XcfFileState * xcf_file_state_lookup (GimpImage          *image,
+                                             const gchar        *filename,
+                                             XcfCompressionType  compression);
+static void           xcf_file_state_update (GimpImage          *image,
+                                             XcfInfo            *info,
+                                             XcfFileState       *old_state);
+static void           xcf_file_state_free   (XcfFileState       *state);
+static gchar        * xcf_file_state_header_checksum
+                                            (const gchar        *filename,
+                                             guint32             header_size);
+
 
 static GimpXcfLoaderFunc * const xcf_loaders[] =
 {
   xcf_load_image,   /* version 0 */
   xcf_load_image,   /* version 1 */
   xcf_load_image,   /* version 2 */
-  xcf_load_image    /* version 3 */
+  xcf_load_image,   /* version 3 */
+  xcf_load_image    /* version 4 */
 };
 
 
@@ -264,6 +298,9 @@ xcf_load_invoker (GimpProcedure      *procedure,
       info.swap_num              = 0;
       info.ref_count             = NULL;
       info.compression           = COMPRESS_NONE;
+      info.header_size           = 0;
+      info.hierarchies           = g_hash_table_new (NULL, NULL);
+      info.old_hierarchies       = NULL;
 
       if (progress)
         {
@@ -306,6 +343,8 @@ xcf_load_invoker (GimpProcedure      *procedure,
 
               if (! image)
                 success = FALSE;
+              else if (info.header_size > 0)
+                xcf_file_state_update (image, &info, NULL);
             }
           else
             {
@@ -318,6 +357,9 @@ xcf_load_invoker (GimpProcedure      *procedure,
 
       fclose (info.fp);
 
+      if (info.hierarchies)
+        g_hash_table_unref (info.hierarchies);
+
       if (progress)
         gimp_progress_end (progress);
     }
@@ -349,34 +391,63 @@ xcf_save_invoker (GimpProcedure      *procedure,
                   const GValueArray  *args,
                   GError            **error)
 {
-  XcfInfo      info;
-  GValueArray *return_vals;
-  GimpImage   *image;
-  const gchar *filename;
-  gboolean     success = FALSE;
+  XcfInfo       info;
+  GValueArray  *return_vals;
+  GimpImage    *image;
+  const gchar  *filename;
+  XcfFileState *state;
+  gboolean      success = FALSE;
 
   gimp_set_busy (gimp);
 
   image    = gimp_value_get_image (&args->values[1], gimp);
   filename = g_value_get_string (&args->values[3]);
 
-  info.fp = g_fopen (filename, "wb");
+  info.gimp                  = gimp;
+  info.progress              = progress;
+  info.cp                    = 0;
+  info.filename              = filename;
+  info.active_layer          = NULL;
+  info.active_channel        = NULL;
+  info.floating_sel_drawable = NULL;
+  info.floating_sel          = NULL;
+  info.floating_sel_offset   = 0;
+  info.swap_num              = 0;
+  info.ref_count             = NULL;
+  info.compression           = COMPRESS_RLE;
+  info.header_size           = 0;
+  info.hierarchies           = g_hash_table_new (NULL, NULL);
+  info.old_hierarchies       = NULL;
+
+#ifdef HAVE_ZLIB
+  if (gimp->config->xcf_zlib_compression)
+    info.compression = COMPRESS_ZLIB;
+#endif
+
+  /*  if the image is saved back to the file it came from, try to only
+   *  append the drawables that changed
+   */
+  state = xcf_file_state_lookup (image, filename, info.compression);
+
+  info.fp = NULL;
+
+  if (state)
+    info.fp = g_fopen (filename, "r+b");
 
   if (info.fp)
     {
-      info.gimp                  = gimp;
-      info.progress              = progress;
-      info.cp                    = 0;
-      info.filename              = filename;
-      info.active_layer          = NULL;
-      info.active_channel        = NULL;
-      info.floating_sel_drawable = NULL;
-      info.floating_sel          = NULL;
-      info.floating_sel_offset   = 0;
-      info.swap_num              = 0;
-      info.ref_count             = NULL;
-      info.compression           = COMPRESS_RLE;
+      info.header_size     = state->header_size;
+      info.old_hierarchies = state->hierarchies;
+    }
+  else
+    {
+      state = NULL;
+
+      info.fp = g_fopen (filename, "wb");
+    }
 
+  if (info.fp)
+    {
       if (progress)
         {
           gchar *name = g_filename_display_name (filename);
@@ -390,7 +461,43 @@ xcf_save_invoker (GimpProcedure      *procedure,
 
       xcf_save_choose_format (&info, image);
 
-      success = xcf_save_image (&info, image, error);
+      if (state)
+        {
+          GError *my_error = NULL;
+
+          success = xcf_save_image_incremental (&info, image, &my_error);
+
+          if (my_error)
+            {
+              g_propagate_error (error, my_error);
+            }
+          else if (! success)
+            {
+              /*  the new header doesn't fit, rewrite the whole file  */
+              state = NULL;
+
+              g_hash_table_remove_all (info.hierarchies);
+
+              info.cp              = 0;
+              info.header_size     = 0;
+              info.old_hierarchies = NULL;
+              info.fp              = g_freopen (filename, "wb", info.fp);
+
+              if (! info.fp)
+                {
+                  int save_errno = errno;
+
+                  g_set_error (error, G_FILE_ERROR,
+                               g_file_error_from_errno (save_errno),
+                               _("Could not open '%s' for writing: %s"),
+                               gimp_filename_to_utf8 (filename),
+                               g_strerror (save_errno));
+                }
+            }
+        }
+
+      if (info.fp && ! state)
+        success = xcf_save_image (&info, image, error);
 
       if (success)
         {
@@ -406,11 +513,16 @@ xcf_save_invoker (GimpProcedure      *procedure,
               success = FALSE;
             }
         }
-      else
+      else if (info.fp)
         {
           fclose (info.fp);
         }
 
+      if (success)
+        xcf_file_state_update (image, &info, state);
+      else
+        g_object_set_data (G_OBJECT (image), XCF_FILE_STATE_KEY, NULL);
+
       if (progress)
         gimp_progress_end (progress);
     }
@@ -423,6 +535,9 @@ xcf_save_invoker (GimpProcedure      *procedure,
                    gimp_filename_to_utf8 (filename), g_strerror (save_errno));
     }
 
+  if (info.hierarchies)
+    g_hash_table_unref (info.hierarchies);
+
   return_vals = gimp_procedure_get_return_values (procedure, success,
                                                   error ? *error : NULL);
 
@@ -430,3 +545,121 @@ xcf_save_invoker (GimpProcedure      *procedure,
 
   return return_vals;
 }
+
+static XcfFileState *
+xcf_file_state_lookup (GimpImage          *image,
+                       const gchar        *filename,
+                       XcfCompressionType  compression)
+{
+  XcfFileState *state;
+  struct stat   st;
+  gchar        *checksum;
+  gboolean      unchanged;
+
+  state = g_object_get_data (G_OBJECT (image), XCF_FILE_STATE_KEY);
+
+  if (! state                                ||
+      state->compression != compression      ||
+      strcmp (state->filename, filename)     ||
+      g_stat (filename, &st) != 0            ||
+      (gint64) st.st_dev   != state->device  ||
+      (gint64) st.st_ino   != state->inode   ||
+      (gint64) st.st_size  != state->size    ||
+      (gint64) st.st_mtime != state->mtime)
+    return NULL;
+
+  /*  rewrite the file once more than half of it is unused  */
+  if (state->size > 2 * state->full_size)
+    return NULL;
+
+  /*  the modification time has a resolution of a second only, so also
+   *  make sure that the header we are going to overwrite is still ours
+   */
+  checksum  = xcf_file_state_header_checksum (filename, state->header_size);
+  unchanged = checksum && ! strcmp (checksum, state->header_checksum);
+
+  g_free (checksum);
+
+  return unchanged ? state : NULL;
+}
+
+/*  old_state is the state the file was appended to, or NULL if the
+ *  file was loaded or completely rewritten
+ */
+static void
+xcf_file_state_update (GimpImage    *image,
+                       XcfInfo      *info,
+                       XcfFileState *old_state)
+{
+  XcfFileState *state;
+  struct stat   st;
+  guint32       header_size;
+  gchar        *checksum;
+
+  /*  the header was copied into the room of the old one  */
+  header_size = old_state ? old_state->header_size : info->header_size;
+  checksum    = xcf_file_state_header_checksum (info->filename, header_size);
+
+  if (! checksum || g_stat (info->filename, &st) != 0)
+    {
+      g_free (checksum);
+      g_object_set_data (G_OBJECT (image), XCF_FILE_STATE_KEY, NULL);
+      return;
+    }
+
+  state = g_slice_new (XcfFileState);
+
+  state->filename        = g_strdup (info->filename);
+  state->device          = st.st_dev;
+  state->inode           = st.st_ino;
+  state->size            = st.st_size;
+  state->mtime           = st.st_mtime;
+  state->header_checksum = checksum;
+  state->full_size       = old_state ? old_state->full_size : st.st_size;
+  state->header_size     = header_size;
+  state->compression     = info->compression;
+  state->hierarchies     = info->hierarchies;
+
+  info->hierarchies = NULL;
+
+  g_object_set_data_full (G_OBJECT (image), XCF_FILE_STATE_KEY, state,
+                          (GDestroyNotify) xcf_file_state_free);
+}
+
+static void
+xcf_file_state_free (XcfFileState *state)
+{
+  g_free (state->filename);
+  g_free (state->header_checksum);
+  g_hash_table_unref (state->hierarchies);
+
+  g_slice_free (XcfFileState, state);
+}
+
+/*  Returns a checksum of the first @header_size bytes of the file, or
+ *  NULL if they can't be read.
+ */
+static gchar *
+xcf_file_state_header_checksum (const gchar *filename,
+                                guint32      header_size)
+{
+  FILE   *fp;
+  guchar *header;
+  gchar  *checksum = NULL;
+
+  fp = g_fopen (filename, "rb");
+
+  if (! fp)
+    return NULL;
+
+  header = g_malloc (header_size);
+
+  if (fread (header, 1, header_size, fp) == header_size)
+    checksum = g_compute_checksum_for_data (G_CHECKSUM_MD5,
+                                            header, header_size);
+
+  g_free (header);
+  fclose (fp);
+
+  return checksum;
+}
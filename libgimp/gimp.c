@@ -119,7 +119,8 @@
  **/
 
 
-#define TILE_MAP_SIZE (_tile_width * _tile_height * 4)
+/*  room for a GP_TILES_DATA message worth of tiles  */
+#define TILE_MAP_SIZE (_tile_width * _tile_height * 4 * GP_TILES_MAX)
 
 #define ERRMSG_SHM_FAILED "Could not attach to gimp shared memory segment"
 
@@ -206,6 +207,8 @@ static GimpStackTraceMode stack_trace_mode = GIMP_STACK_TRACE_NEVER;
 
 static GHashTable    *temp_proc_ht       = NULL;
 
+static gboolean       resident           = FALSE;
+
 static guint          gimp_debug_flags   = 0;
 
 static const GDebugKey gimp_debug_keys[] =
@@ -1521,6 +1524,36 @@ gimp_extension_process (guint timeout)
 #endif
 }
 
+/**
+ * gimp_resident_enable:
+ *
+ * Asks GIMP to keep the plug-in running after its procedure returned.
+ *
+ * Normally, a new plug-in process is started for every call to one
+ * of its procedures, and it exits when the procedure returns. A
+ * plug-in that is called very often, like from a script that
+ * processes a lot of images, spends much of its time starting up.
+ *
+ * After calling this function from the run procedure, GIMP keeps the
+ * plug-in around and passes it further calls to its procedures,
+ * until it has not been called for a while. The plug-in must not
+ * rely on its global variables being reset between calls, and it
+ * must detach all drawables before returning.
+ *
+ * Since: GIMP 2.8.6
+ **/
+void
+gimp_resident_enable (void)
+{
+  if (! resident)
+    {
+      if (! gp_resident_write (_writechannel, NULL))
+        gimp_quit ();
+
+      resident = TRUE;
+    }
+}
+
 /**
  * gimp_parasite_find:
  * @name: The name of the parasite to find.
@@ -1839,12 +1872,24 @@ gimp_loop (void)
         case GP_TILE_REQ:
         case GP_TILE_ACK:
         case GP_TILE_DATA:
+        case GP_TILE_MAP:
+        case GP_TILE_UNMAP:
+        case GP_TILES_REQ:
+        case GP_TILES_DATA:
           g_warning ("unexpected tile message received (should not happen)");
           break;
 
         case GP_PROC_RUN:
           gimp_proc_run (msg.data);
           gimp_wire_destroy (&msg);
+
+          /*  a resident plug-in waits for the next call  */
+          if (resident)
+            {
+              _gimp_tile_unmap_all ();
+              continue;
+            }
+
           gimp_close ();
           return;
 
@@ -1867,6 +1912,10 @@ gimp_loop (void)
         case GP_HAS_INIT:
           g_warning ("unexpected has init message received (should not happen)");
           break;
+
+        case GP_RESIDENT:
+          g_warning ("unexpected resident message received (should not happen)");
+          break;
         }
 
       gimp_wire_destroy (&msg);
@@ -1905,6 +1954,11 @@ gimp_config (GPConfig *config)
   _show_help_button = config->show_help_button ? TRUE : FALSE;
   _min_colors       = config->min_colors;
   _gdisp_ID         = config->gdisp_ID;
+
+  /*  a resident plug-in gets a new config for each call  */
+  g_free (_wm_class);
+  g_free (_display_name);
+
   _wm_class         = g_strdup (config->wm_class);
   _display_name     = g_strdup (config->display_name);
   _monitor_number   = config->monitor_number;
@@ -1915,7 +1969,7 @@ gimp_config (GPConfig *config)
 
   gimp_cpu_accel_set_use (config->use_cpu_accel);
 
-  if (_shm_ID != -1)
+  if (_shm_ID != -1 && ! _shm_addr)
     {
 #if defined(USE_SYSV_SHM)
 
@@ -2070,6 +2124,10 @@ gimp_process_message (GimpWireMessage *msg)
     case GP_TILE_REQ:
     case GP_TILE_ACK:
     case GP_TILE_DATA:
+    case GP_TILE_MAP:
+    case GP_TILE_UNMAP:
+    case GP_TILES_REQ:
+    case GP_TILES_DATA:
       g_warning ("unexpected tile message received (should not happen)");
       break;
     case GP_PROC_RUN:
@@ -2090,6 +2148,9 @@ gimp_process_message (GimpWireMessage *msg)
     case GP_HAS_INIT:
       g_warning ("unexpected has init message received (should not happen)");
       break;
+    case GP_RESIDENT:
+      g_warning ("unexpected resident message received (should not happen)");
+      break;
     }
 }
 
@@ -91,6 +91,9 @@ gimp_drawable_detach (GimpDrawable *drawable)
 
   gimp_drawable_flush (drawable);
 
+  _gimp_tile_unmap_drawable (drawable, FALSE);
+  _gimp_tile_unmap_drawable (drawable, TRUE);
+
   if (drawable->tiles)
     g_free (drawable->tiles);
 
@@ -114,34 +117,85 @@ gimp_drawable_detach (GimpDrawable *drawable)
 void
 gimp_drawable_flush (GimpDrawable *drawable)
 {
-  GimpTile *tiles;
-  gint      n_tiles;
-  gint      i;
+  gint n_tiles;
 
   g_return_if_fail (drawable != NULL);
 
-  if (drawable->tiles)
-    {
-      tiles   = drawable->tiles;
-      n_tiles = drawable->ntile_rows * drawable->ntile_cols;
+  n_tiles = drawable->ntile_rows * drawable->ntile_cols;
 
-      for (i = 0; i < n_tiles; i++)
-        if ((tiles[i].ref_count > 0) && tiles[i].dirty)
-          gimp_tile_flush (&tiles[i]);
-    }
+  /*  send the dirty tiles in batches  */
+  if (drawable->tiles)
+    _gimp_tiles_flush (drawable->tiles, n_tiles);
 
   if (drawable->shadow_tiles)
-    {
-      tiles   = drawable->shadow_tiles;
-      n_tiles = drawable->ntile_rows * drawable->ntile_cols;
-
-      for (i = 0; i < n_tiles; i++)
-        if ((tiles[i].ref_count > 0) && tiles[i].dirty)
-          gimp_tile_flush (&tiles[i]);
-    }
+    _gimp_tiles_flush (drawable->shadow_tiles, n_tiles);
 
   /*  nuke all references to this drawable from the cache  */
   _gimp_tile_cache_flush_drawable (drawable);
+
+  /*  copy the pixels of mapped tiles back to the core  */
+  _gimp_tile_map_flush_drawable (drawable);
+}
+
+/**
+ * gimp_drawable_map_tiles:
+ * @drawable: The #GimpDrawable whose tiles are to be mapped
+ * @shadow:   Whether to map the shadow tiles
+ * @x:        x coordinate of the area to map
+ * @y:        y coordinate of the area to map
+ * @width:    width of the area to map
+ * @height:   height of the area to map
+ *
+ * This function maps the tiles of @drawable, or of its shadow, that
+ * cover the given area, usually the one returned by
+ * gimp_drawable_mask_intersect(), into a piece of memory that is
+ * shared with the core.  From then on these tiles are not transferred
+ * one by one anymore: gimp_tile_ref() points the tile data right at
+ * the shared memory, and the changes are copied to the drawable in
+ * one go by gimp_drawable_flush(), gimp_drawable_unmap_tiles() and
+ * gimp_drawable_detach().  All other tiles are transferred as before.
+ *
+ * The shared memory takes as much space as the pixels of the mapped
+ * tiles.  If it can't be had, the tiles are transferred as before.
+ * Mapping tiles of a drawable that are already mapped replaces the
+ * mapping if it doesn't cover the area.
+ *
+ * Return value: %TRUE if the tiles were mapped.
+ *
+ * Since: GIMP 2.8.6
+ **/
+gboolean
+gimp_drawable_map_tiles (GimpDrawable *drawable,
+                         gboolean      shadow,
+                         gint          x,
+                         gint          y,
+                         gint          width,
+                         gint          height)
+{
+  g_return_val_if_fail (drawable != NULL, FALSE);
+
+  return _gimp_tile_map_drawable (drawable, shadow, x, y, width, height);
+}
+
+/**
+ * gimp_drawable_unmap_tiles:
+ * @drawable: The #GimpDrawable whose tiles are to be unmapped
+ * @shadow:   Whether to unmap the shadow tiles
+ *
+ * This function copies the changes to tiles mapped with
+ * gimp_drawable_map_tiles() back to the core and frees the shared
+ * memory.  Tiles that are still referenced keep their data and are
+ * transferred one by one from then on.
+ *
+ * Since: GIMP 2.8.6
+ **/
+void
+gimp_drawable_unmap_tiles (GimpDrawable *drawable,
+                           gboolean      shadow)
+{
+  g_return_if_fail (drawable != NULL);
+
+  _gimp_tile_unmap_drawable (drawable, shadow);
 }
 
 GimpTile *
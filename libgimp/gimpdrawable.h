@@ -46,6 +46,14 @@ struct _GimpDrawable
 GimpDrawable * gimp_drawable_get                    (gint32         drawable_ID);
 void           gimp_drawable_detach                 (GimpDrawable  *drawable);
 void           gimp_drawable_flush                  (GimpDrawable  *drawable);
+gboolean       gimp_drawable_map_tiles              (GimpDrawable  *drawable,
+                                                     gboolean       shadow,
+                                                     gint           x,
+                                                     gint           y,
+                                                     gint           width,
+                                                     gint           height);
+void           gimp_drawable_unmap_tiles            (GimpDrawable  *drawable,
+                                                     gboolean       shadow);
 GimpTile     * gimp_drawable_get_tile               (GimpDrawable  *drawable,
                                                      gboolean       shadow,
                                                      gint           row,
@@ -374,6 +374,8 @@ gimp_pixel_rgn_get_rect (GimpPixelRgn *pr,
   yend = y + height;
   ystep = 0;
 
+  _gimp_tile_prefetch (pr->drawable, pr->shadow, x, y, width, height);
+
   while (y < yend)
     {
       x = xstart;
@@ -608,6 +610,8 @@ gimp_pixel_rgn_set_rect (GimpPixelRgn *pr,
   yend = y + height;
   ystep = 0;
 
+  _gimp_tile_prefetch (pr->drawable, pr->shadow, x, y, width, height);
+
   while (y < yend)
     {
       x = xstart;
@@ -938,6 +942,12 @@ gimp_pixel_rgn_configure (GimpPixelRgnHolder   *prh,
       gint      offx;
       gint      offy;
 
+      /*  fetch the tiles of the row of portions that starts here  */
+      if (prh->pr->x == prh->startx)
+        _gimp_tile_prefetch (prh->pr->drawable, prh->pr->shadow,
+                             prh->startx, prh->pr->y,
+                             pri->region_width, pri->portion_height);
+
       tile = gimp_drawable_get_tile2 (prh->pr->drawable,
                                       prh->pr->shadow,
                                       prh->pr->x,
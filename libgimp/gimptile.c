@@ -20,10 +20,40 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <string.h>
+#include <sys/types.h>
+
+#if defined(USE_SYSV_SHM)
+
+#ifdef HAVE_IPC_H
+#include <sys/ipc.h>
+#endif
+
+#ifdef HAVE_SHM_H
+#include <sys/shm.h>
+#endif
+
+#elif defined(USE_POSIX_SHM)
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#endif /* USE_POSIX_SHM */
 
 #include <glib-object.h>
 
+#if defined(G_OS_WIN32) || defined(G_WITH_CYGWIN)
+#  define STRICT
+#  include <windows.h>
+#  undef RGB
+#  define USE_WIN32_SHM 1
+#endif
+
 #include "libgimpbase/gimpbase.h"
 #include "libgimpbase/gimpprotocol.h"
 #include "libgimpbase/gimpwire.h"
@@ -46,14 +76,66 @@
  */
 #define FREE_QUANTUM 0.1
 
+#define ERRMSG_MAP_FAILED "Could not map the drawable into shared memory"
 
-void         gimp_read_expect_msg   (GimpWireMessage *msg,
-                                     gint             type);
 
-static void  gimp_tile_get          (GimpTile        *tile);
-static void  gimp_tile_put          (GimpTile        *tile);
-static void  gimp_tile_cache_insert (GimpTile        *tile);
-static void  gimp_tile_cache_flush  (GimpTile        *tile);
+/*  The tiles of a drawable that are mapped into shared memory, see
+ *  gimp_drawable_map_tiles().  They are stored one after the other,
+ *  each with a rowstride of its effective width, so a tile's data can
+ *  point right into the segment.
+ */
+typedef struct _GimpTileMap GimpTileMap;
+
+struct _GimpTileMap
+{
+  GimpDrawable *drawable;
+  gboolean      shadow;
+  gint          map_ID;
+  gint          col;      /*  the mapped range of tiles                 */
+  gint          row;
+  gint          n_cols;
+  gint          n_rows;
+  gsize         size;
+  guchar       *addr;
+  guchar       *dirty;    /*  per tile, written to since the last sync  */
+  gint          n_dirty;
+
+#if defined(USE_WIN32_SHM)
+  HANDLE        handle;
+#endif
+};
+
+
+void                 gimp_read_expect_msg   (GimpWireMessage *msg,
+                                             gint             type);
+
+static void          gimp_tile_get          (GimpTile        *tile);
+static void          gimp_tile_put          (GimpTile        *tile);
+static void          gimp_tiles_get         (GimpTile       **tiles,
+                                             gint             n_tiles);
+static void          gimp_tiles_put         (GimpTile       **tiles,
+                                             gint             n_tiles);
+static void          gimp_tile_cache_insert (GimpTile        *tile);
+static void          gimp_tile_cache_flush  (GimpTile        *tile);
+static void          gimp_tile_cache_put_evicted
+                                            (void);
+
+static GimpTileMap * gimp_tile_map_find     (GimpDrawable    *drawable,
+                                             gboolean         shadow);
+static GimpTileMap * gimp_tile_map_find_tile
+                                            (GimpTile        *tile);
+static guchar      * gimp_tile_map_data     (GimpTileMap     *map,
+                                             GimpTile        *tile);
+static gboolean      gimp_tile_map_attach   (GimpTileMap     *map,
+                                             gint             shm_ID);
+static void          gimp_tile_map_detach   (GimpTileMap     *map);
+static void          gimp_tile_map_set_dirty
+                                            (GimpTileMap     *map,
+                                             GimpTile        *tile);
+static void          gimp_tile_map_sync     (GimpTileMap     *map,
+                                             gboolean         detach);
+static void          gimp_tile_map_remove   (GimpTileMap     *map,
+                                             gboolean         sync);
 
 
 /*  private variables  */
@@ -65,36 +147,68 @@ static gulong       max_tile_size   = 0;
 static gulong       cur_cache_size  = 0;
 static gulong       max_cache_size  = 0;
 
+static GSList     * tile_maps       = NULL;
+
 
 /*  public functions  */
 
 void
 gimp_tile_ref (GimpTile *tile)
 {
+  GimpTileMap *map;
+
   g_return_if_fail (tile != NULL);
 
+  map = gimp_tile_map_find_tile (tile);
+
   tile->ref_count++;
 
   if (tile->ref_count == 1)
     {
-      gimp_tile_get (tile);
+      if (map)
+        tile->data = gimp_tile_map_data (map, tile);
+      else
+        gimp_tile_get (tile);
+
       tile->dirty = FALSE;
     }
 
-  gimp_tile_cache_insert (tile);
+  /*  mapped tiles are never transferred, there is no point in caching  */
+  if (! map || tile->data != gimp_tile_map_data (map, tile))
+    gimp_tile_cache_insert (tile);
 }
 
 void
 gimp_tile_ref_zero (GimpTile *tile)
 {
+  GimpTileMap *map;
+
   g_return_if_fail (tile != NULL);
 
+  map = gimp_tile_map_find_tile (tile);
+
   tile->ref_count++;
 
   if (tile->ref_count == 1)
-    tile->data = g_new0 (guchar, tile->ewidth * tile->eheight * tile->bpp);
+    {
+      if (map)
+        {
+          /*  clearing the tile changes the drawable's pixels as soon
+           *  as the map is synced, so treat it as a write
+           */
+          tile->data  = gimp_tile_map_data (map, tile);
+          tile->dirty = TRUE;
+
+          memset (tile->data, 0, tile->ewidth * tile->eheight * tile->bpp);
+        }
+      else
+        {
+          tile->data = g_new0 (guchar, tile->ewidth * tile->eheight * tile->bpp);
+        }
+    }
 
-  gimp_tile_cache_insert (tile);
+  if (! map || tile->data != gimp_tile_map_data (map, tile))
+    gimp_tile_cache_insert (tile);
 }
 
 void
@@ -109,8 +223,13 @@ gimp_tile_unref (GimpTile *tile,
 
   if (tile->ref_count == 0)
     {
+      GimpTileMap *map = gimp_tile_map_find_tile (tile);
+
       gimp_tile_flush (tile);
-      g_free (tile->data);
+
+      if (! map || tile->data != gimp_tile_map_data (map, tile))
+        g_free (tile->data);
+
       tile->data = NULL;
     }
 }
@@ -122,7 +241,24 @@ gimp_tile_flush (GimpTile *tile)
 
   if (tile->data && tile->dirty)
     {
-      gimp_tile_put (tile);
+      GimpTileMap *map = gimp_tile_map_find_tile (tile);
+
+      if (map)
+        {
+          guchar *data = gimp_tile_map_data (map, tile);
+
+          /*  the tile was referenced before its drawable got mapped  */
+          if (tile->data != data)
+            memcpy (data, tile->data,
+                    tile->ewidth * tile->eheight * tile->bpp);
+
+          gimp_tile_map_set_dirty (map, tile);
+        }
+      else
+        {
+          gimp_tile_put (tile);
+        }
+
       tile->dirty = FALSE;
     }
 }
@@ -154,6 +290,9 @@ gimp_tile_cache_size (gulong kilobytes)
  * row-by-row, it should set the tile cache large enough to hold the
  * number of tiles per row. Double this size if your plug-in uses
  * shadow tiles.
+ *
+ * Pixel regions use up to half of the cache to fetch the tiles of a
+ * row in batches, instead of one by one.
  **/
 void
 gimp_tile_cache_ntiles (gulong ntiles)
@@ -182,6 +321,252 @@ _gimp_tile_cache_flush_drawable (GimpDrawable *drawable)
     }
 }
 
+/*  Fetches the tiles of @drawable that cover the rectangle into the
+ *  cache, GP_TILES_MAX at a time.  Only as many as fit into half of
+ *  the cache are fetched, so they don't push each other out again.
+ */
+void
+_gimp_tile_prefetch (GimpDrawable *drawable,
+                     gboolean      shadow,
+                     gint          x,
+                     gint          y,
+                     gint          width,
+                     gint          height)
+{
+  GimpTile *tiles[GP_TILES_MAX];
+  gint      n_tiles = 0;
+  gint      max_tiles;
+  gint      row, col;
+
+  g_return_if_fail (drawable != NULL);
+
+  if (width <= 0 || height <= 0)
+    return;
+
+  max_tiles = max_cache_size / (gimp_tile_width () * gimp_tile_height () * 4) / 2;
+
+  for (row = y / gimp_tile_height ();
+       row <= (y + height - 1) / gimp_tile_height () && max_tiles > 0;
+       row++)
+    {
+      for (col = x / gimp_tile_width ();
+           col <= (x + width - 1) / gimp_tile_width () && max_tiles > 0;
+           col++)
+        {
+          GimpTile *tile = gimp_drawable_get_tile (drawable, shadow, row, col);
+
+          /*  already cached or in use, mapped tiles aren't transferred
+           *  at all
+           */
+          if (tile->ref_count > 0 || gimp_tile_map_find_tile (tile))
+            continue;
+
+          tiles[n_tiles++] = tile;
+          max_tiles--;
+
+          if (n_tiles == GP_TILES_MAX)
+            {
+              gimp_tiles_get (tiles, n_tiles);
+              n_tiles = 0;
+            }
+        }
+    }
+
+  if (n_tiles > 0)
+    gimp_tiles_get (tiles, n_tiles);
+}
+
+/*  Like gimp_tile_flush() on all referenced tiles of @tiles, which
+ *  all belong to the same drawable, but sends them in batches.
+ */
+void
+_gimp_tiles_flush (GimpTile *tiles,
+                   gint      n_tiles)
+{
+  GimpTile *batch[GP_TILES_MAX];
+  gint      n_batch = 0;
+  gint      i;
+
+  g_return_if_fail (tiles != NULL || n_tiles == 0);
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      if (tiles[i].ref_count > 0 && tiles[i].data && tiles[i].dirty)
+        {
+          /*  mapped tiles only mark themselves dirty in the map  */
+          if (gimp_tile_map_find_tile (&tiles[i]))
+            {
+              gimp_tile_flush (&tiles[i]);
+              continue;
+            }
+
+          batch[n_batch++] = &tiles[i];
+
+          if (n_batch == GP_TILES_MAX)
+            {
+              gimp_tiles_put (batch, n_batch);
+              n_batch = 0;
+            }
+        }
+    }
+
+  if (n_batch > 0)
+    gimp_tiles_put (batch, n_batch);
+}
+
+gboolean
+_gimp_tile_map_drawable (GimpDrawable *drawable,
+                         gboolean      shadow,
+                         gint          x,
+                         gint          y,
+                         gint          width,
+                         gint          height)
+{
+  extern GIOChannel *_writechannel;
+
+  GimpTileMap     *map;
+  GPTileMap        tile_map;
+  GPTileMap       *reply;
+  GimpWireMessage  msg;
+  gint             col, row;
+  gint             n_cols, n_rows;
+  gint             shm_ID;
+
+  g_return_val_if_fail (drawable != NULL, FALSE);
+
+  shadow = shadow ? TRUE : FALSE;
+
+  if (! gimp_rectangle_intersect (x, y, width, height,
+                                  0, 0, drawable->width, drawable->height,
+                                  &x, &y, &width, &height))
+    return FALSE;
+
+  col    = x / gimp_tile_width ();
+  row    = y / gimp_tile_height ();
+  n_cols = (x + width  - 1) / gimp_tile_width ()  - col + 1;
+  n_rows = (y + height - 1) / gimp_tile_height () - row + 1;
+
+  map = gimp_tile_map_find (drawable, shadow);
+
+  if (map)
+    {
+      if (col >= map->col && col + n_cols <= map->col + map->n_cols &&
+          row >= map->row && row + n_rows <= map->row + map->n_rows)
+        return TRUE;
+
+      gimp_tile_map_remove (map, TRUE);
+    }
+
+  /*  the core copies the pixels into the segment, so it has to see
+   *  what we changed so far
+   */
+  gimp_drawable_flush (drawable);
+
+  tile_map.drawable_ID = drawable->drawable_id;
+  tile_map.shadow      = shadow;
+  tile_map.x           = x;
+  tile_map.y           = y;
+  tile_map.width       = width;
+  tile_map.height      = height;
+  tile_map.map_ID      = 0;
+  tile_map.shm_ID      = -1;
+
+  if (! gp_tile_map_write (_writechannel, &tile_map, NULL))
+    gimp_quit ();
+
+  gimp_read_expect_msg (&msg, GP_TILE_MAP);
+
+  reply = msg.data;
+  if (reply->drawable_ID != drawable->drawable_id ||
+      reply->shadow      != shadow)
+    {
+      g_message ("received tile map did not match the requested one");
+      gimp_quit ();
+    }
+
+  map = g_slice_new0 (GimpTileMap);
+
+  map->drawable = drawable;
+  map->shadow   = shadow;
+  map->map_ID   = reply->map_ID;
+  map->col      = col;
+  map->row      = row;
+  map->n_cols   = n_cols;
+  map->n_rows   = n_rows;
+  map->size     = ((gsize) (MIN ((col + n_cols) * gimp_tile_width (),
+                                 drawable->width) -
+                            col * gimp_tile_width ()) *
+                   (gsize) (MIN ((row + n_rows) * gimp_tile_height (),
+                                 drawable->height) -
+                            row * gimp_tile_height ()) *
+                   (gsize) drawable->bpp);
+  map->dirty    = g_new0 (guchar, drawable->ntile_rows * drawable->ntile_cols);
+
+  shm_ID = reply->shm_ID;
+
+  gimp_wire_destroy (&msg);
+
+  if (shm_ID == -1)
+    {
+      g_free (map->dirty);
+      g_slice_free (GimpTileMap, map);
+      return FALSE;
+    }
+
+  if (! gimp_tile_map_attach (map, shm_ID))
+    {
+      /*  let the core free the segment again  */
+      gimp_tile_map_sync (map, TRUE);
+      g_free (map->dirty);
+      g_slice_free (GimpTileMap, map);
+      return FALSE;
+    }
+
+  tile_maps = g_slist_prepend (tile_maps, map);
+
+  return TRUE;
+}
+
+void
+_gimp_tile_unmap_drawable (GimpDrawable *drawable,
+                           gboolean      shadow)
+{
+  GimpTileMap *map;
+
+  g_return_if_fail (drawable != NULL);
+
+  map = gimp_tile_map_find (drawable, shadow);
+
+  if (map)
+    gimp_tile_map_remove (map, TRUE);
+}
+
+/*  The core frees the segments of a resident plug-in when a call
+ *  returns, so drop the mappings it left without syncing them.
+ */
+void
+_gimp_tile_unmap_all (void)
+{
+  while (tile_maps)
+    gimp_tile_map_remove (tile_maps->data, FALSE);
+}
+
+void
+_gimp_tile_map_flush_drawable (GimpDrawable *drawable)
+{
+  GSList *list;
+
+  g_return_if_fail (drawable != NULL);
+
+  for (list = tile_maps; list; list = g_slist_next (list))
+    {
+      GimpTileMap *map = list->data;
+
+      if (map->drawable == drawable && map->n_dirty > 0)
+        gimp_tile_map_sync (map, FALSE);
+    }
+}
+
 
 /*  private functions  */
 
@@ -281,6 +666,138 @@ gimp_tile_put (GimpTile *tile)
   gimp_wire_destroy (&msg);
 }
 
+/*  Fetches @tiles, which all have no references, into the cache with
+ *  one GP_TILES_REQ.
+ */
+static void
+gimp_tiles_get (GimpTile **tiles,
+                gint       n_tiles)
+{
+  extern GIOChannel *_writechannel;
+
+  GimpDrawable    *drawable = tiles[0]->drawable;
+  GPTilesReq       tiles_req;
+  GPTilesData     *tiles_data;
+  GimpWireMessage  msg;
+  guint32          tile_nums[GP_TILES_MAX];
+  const guchar    *src;
+  guint32          offset   = 0;
+  gint             i;
+
+  for (i = 0; i < n_tiles; i++)
+    tile_nums[i] = tiles[i]->tile_num;
+
+  tiles_req.drawable_ID = drawable->drawable_id;
+  tiles_req.shadow      = tiles[0]->shadow;
+  tiles_req.n_tiles     = n_tiles;
+  tiles_req.tile_nums   = tile_nums;
+
+  if (! gp_tiles_req_write (_writechannel, &tiles_req, NULL))
+    gimp_quit ();
+
+  gimp_read_expect_msg (&msg, GP_TILES_DATA);
+
+  tiles_data = msg.data;
+  if (! tiles_data                                     ||
+      tiles_data->drawable_ID != drawable->drawable_id ||
+      tiles_data->shadow      != tiles[0]->shadow      ||
+      tiles_data->bpp         != drawable->bpp         ||
+      tiles_data->n_tiles     != n_tiles)
+    {
+      g_message ("received tile info did not match computed tile info");
+      gimp_quit ();
+    }
+
+  src = tiles_data->use_shm ? gimp_shm_addr () : tiles_data->data;
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      GimpTile *tile = tiles[i];
+      guint32   size = tile->ewidth * tile->eheight * tile->bpp;
+
+      if (tiles_data->tile_nums[i] != tile->tile_num ||
+          offset + size > tiles_data->length)
+        {
+          g_message ("received tile info did not match computed tile info");
+          gimp_quit ();
+        }
+
+      tile->data  = g_memdup (src + offset, size);
+      tile->dirty = FALSE;
+
+      offset += size;
+    }
+
+  gimp_wire_destroy (&msg);
+
+  /*  leave the tiles to the cache, only now that we are done with the
+   *  shared memory, making room in the cache may send evicted tiles
+   */
+  for (i = 0; i < n_tiles; i++)
+    {
+      tiles[i]->ref_count++;
+      gimp_tile_cache_insert (tiles[i]);
+      gimp_tile_unref (tiles[i], FALSE);
+    }
+}
+
+/*  Sends the dirty @tiles, which all belong to the same drawable and
+ *  are either all shadow tiles or none, with one GP_TILES_DATA.
+ */
+static void
+gimp_tiles_put (GimpTile **tiles,
+                gint       n_tiles)
+{
+  extern GIOChannel *_writechannel;
+
+  GimpDrawable    *drawable = tiles[0]->drawable;
+  GPTilesData      tiles_data;
+  GimpWireMessage  msg;
+  guint32          tile_nums[GP_TILES_MAX];
+  guchar          *dest;
+  gint             i;
+
+  tiles_data.drawable_ID = drawable->drawable_id;
+  tiles_data.shadow      = tiles[0]->shadow;
+  tiles_data.bpp         = drawable->bpp;
+  tiles_data.n_tiles     = n_tiles;
+  tiles_data.tile_nums   = tile_nums;
+  tiles_data.use_shm     = (gimp_shm_addr () != NULL);
+  tiles_data.length      = 0;
+  tiles_data.data        = NULL;
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      tile_nums[i] = tiles[i]->tile_num;
+
+      tiles_data.length += tiles[i]->ewidth * tiles[i]->eheight * tiles[i]->bpp;
+    }
+
+  if (tiles_data.use_shm)
+    dest = gimp_shm_addr ();
+  else
+    dest = tiles_data.data = g_malloc (tiles_data.length);
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      GimpTile *tile = tiles[i];
+      guint32   size = tile->ewidth * tile->eheight * tile->bpp;
+
+      memcpy (dest, tile->data, size);
+      dest += size;
+
+      tile->dirty = FALSE;
+    }
+
+  if (! gp_tiles_data_write (_writechannel, &tiles_data, NULL))
+    gimp_quit ();
+
+  g_free (tiles_data.data);
+
+  gimp_read_expect_msg (&msg, GP_TILE_ACK);
+  gimp_wire_destroy (&msg);
+}
+
 /* This function is nearly identical to the function 'tile_cache_insert'
  *  in the file 'tile_cache.c' which is part of the main gimp application.
  */
@@ -330,6 +847,8 @@ gimp_tile_cache_insert (GimpTile *tile)
 
       if ((cur_cache_size + max_tile_size) > max_cache_size)
         {
+          gimp_tile_cache_put_evicted ();
+
           while (tile_list_head &&
                  (cur_cache_size +
                   max_cache_size * FREE_QUANTUM) > max_cache_size)
@@ -366,6 +885,51 @@ gimp_tile_cache_insert (GimpTile *tile)
     }
 }
 
+/*  Sends the dirty tiles that the eviction in gimp_tile_cache_insert()
+ *  is about to drop in batches, rather than one by one when their last
+ *  reference goes away.
+ */
+static void
+gimp_tile_cache_put_evicted (void)
+{
+  GimpTile *batch[GP_TILES_MAX];
+  gint      n_batch = 0;
+  gulong    size    = cur_cache_size;
+  GList    *list;
+
+  for (list = tile_list_head;
+       list && (size + max_cache_size * FREE_QUANTUM) > max_cache_size;
+       list = g_list_next (list))
+    {
+      GimpTile *tile = list->data;
+
+      size -= max_tile_size;
+
+      if (tile->ref_count != 1 || ! tile->dirty ||
+          gimp_tile_map_find_tile (tile))
+        continue;
+
+      if (n_batch > 0 &&
+          (batch[0]->drawable != tile->drawable ||
+           batch[0]->shadow   != tile->shadow))
+        {
+          gimp_tiles_put (batch, n_batch);
+          n_batch = 0;
+        }
+
+      batch[n_batch++] = tile;
+
+      if (n_batch == GP_TILES_MAX)
+        {
+          gimp_tiles_put (batch, n_batch);
+          n_batch = 0;
+        }
+    }
+
+  if (n_batch > 0)
+    gimp_tiles_put (batch, n_batch);
+}
+
 static void
 gimp_tile_cache_flush (GimpTile *tile)
 {
@@ -406,3 +970,267 @@ gimp_tile_cache_flush (GimpTile *tile)
       gimp_tile_unref (tile, FALSE);
     }
 }
+
+static GimpTileMap *
+gimp_tile_map_find (GimpDrawable *drawable,
+                    gboolean      shadow)
+{
+  GSList *list;
+
+  for (list = tile_maps; list; list = g_slist_next (list))
+    {
+      GimpTileMap *map = list->data;
+
+      if (map->drawable == drawable && map->shadow == (shadow ? TRUE : FALSE))
+        return map;
+    }
+
+  return NULL;
+}
+
+/*  Returns the map of the tile's drawable if it contains the tile.  */
+static GimpTileMap *
+gimp_tile_map_find_tile (GimpTile *tile)
+{
+  GimpTileMap *map = gimp_tile_map_find (tile->drawable, tile->shadow);
+
+  if (map && gimp_tile_map_data (map, tile))
+    return map;
+
+  return NULL;
+}
+
+/*  All mapped tile rows above the tile are full height, and all mapped
+ *  tiles to its left have the height of its own row.  Returns %NULL
+ *  for tiles that are not mapped.
+ */
+static guchar *
+gimp_tile_map_data (GimpTileMap *map,
+                    GimpTile    *tile)
+{
+  GimpDrawable *drawable = map->drawable;
+  gint          row      = tile->tile_num / drawable->ntile_cols;
+  gint          col      = tile->tile_num % drawable->ntile_cols;
+  gint          width;
+
+  if (row <  map->row || row >= map->row + map->n_rows ||
+      col <  map->col || col >= map->col + map->n_cols)
+    return NULL;
+
+  width = (MIN ((map->col + map->n_cols) * gimp_tile_width (),
+                drawable->width) -
+           map->col * gimp_tile_width ());
+
+  return map->addr + (((gsize) (row - map->row) * gimp_tile_height () * width +
+                       (gsize) (col - map->col) * gimp_tile_width () * tile->eheight) *
+                      drawable->bpp);
+}
+
+static gboolean
+gimp_tile_map_attach (GimpTileMap *map,
+                      gint         shm_ID)
+{
+#if defined(USE_SYSV_SHM)
+
+  map->addr = (guchar *) shmat (shm_ID, NULL, 0);
+
+  if (map->addr == (guchar *) -1)
+    {
+      g_printerr ("shmat() failed: %s\n" ERRMSG_MAP_FAILED "\n",
+                  g_strerror (errno));
+      map->addr = NULL;
+    }
+
+#elif defined(USE_WIN32_SHM)
+
+  gchar fileMapName[128];
+
+  /* From the ids, derive the file map name */
+  g_snprintf (fileMapName, sizeof (fileMapName), "GIMP%d-%d.SHM",
+              shm_ID, map->map_ID);
+
+  /* Open the file mapping */
+  map->handle = OpenFileMapping (FILE_MAP_ALL_ACCESS, 0, fileMapName);
+
+  if (map->handle)
+    {
+      /* Map the shared memory into our address space for use */
+      map->addr = (guchar *) MapViewOfFile (map->handle,
+                                            FILE_MAP_ALL_ACCESS,
+                                            0, 0, map->size);
+
+      if (! map->addr)
+        {
+          g_printerr ("MapViewOfFile error: %d... " ERRMSG_MAP_FAILED "\n",
+                      GetLastError ());
+          CloseHandle (map->handle);
+          map->handle = NULL;
+        }
+    }
+  else
+    {
+      g_printerr ("OpenFileMapping error: %d... " ERRMSG_MAP_FAILED "\n",
+                  GetLastError ());
+    }
+
+#elif defined(USE_POSIX_SHM)
+
+  gchar map_file[32];
+  gint  shm_fd;
+
+  /* From the ids, derive the file map name */
+  g_snprintf (map_file, sizeof (map_file), "/gimp-shm-%d-%d",
+              shm_ID, map->map_ID);
+
+  /* Open the file mapping */
+  shm_fd = shm_open (map_file, O_RDWR, 0600);
+
+  if (shm_fd != -1)
+    {
+      /* Map the shared memory into our address space for use */
+      map->addr = (guchar *) mmap (NULL, map->size,
+                                   PROT_READ | PROT_WRITE, MAP_SHARED,
+                                   shm_fd, 0);
+
+      if (map->addr == MAP_FAILED)
+        {
+          g_printerr ("mmap() failed: %s\n" ERRMSG_MAP_FAILED "\n",
+                      g_strerror (errno));
+          map->addr = NULL;
+        }
+
+      close (shm_fd);
+    }
+  else
+    {
+      g_printerr ("shm_open() failed: %s\n" ERRMSG_MAP_FAILED "\n",
+                  g_strerror (errno));
+    }
+
+#endif
+
+  return (map->addr != NULL);
+}
+
+static void
+gimp_tile_map_detach (GimpTileMap *map)
+{
+#if defined(USE_SYSV_SHM)
+
+  shmdt ((char *) map->addr);
+
+#elif defined(USE_WIN32_SHM)
+
+  UnmapViewOfFile (map->addr);
+  CloseHandle (map->handle);
+
+#elif defined(USE_POSIX_SHM)
+
+  munmap (map->addr, map->size);
+
+#endif
+
+  map->addr = NULL;
+}
+
+static void
+gimp_tile_map_set_dirty (GimpTileMap *map,
+                         GimpTile    *tile)
+{
+  if (! map->dirty[tile->tile_num])
+    {
+      map->dirty[tile->tile_num] = TRUE;
+      map->n_dirty++;
+    }
+}
+
+/*  Has the core copy the mapped pixels of the tiles that changed back
+ *  to the drawable, and free the segment if @detach is %TRUE.
+ */
+static void
+gimp_tile_map_sync (GimpTileMap *map,
+                    gboolean     detach)
+{
+  extern GIOChannel *_writechannel;
+
+  GPTileUnmap      tile_unmap;
+  GimpWireMessage  msg;
+  guint32         *dirty_tiles = NULL;
+  gint             n_tiles;
+  gint             i;
+
+  if (map->n_dirty > 0)
+    {
+      n_tiles     = map->drawable->ntile_rows * map->drawable->ntile_cols;
+      dirty_tiles = g_new (guint32, map->n_dirty);
+
+      for (i = 0, map->n_dirty = 0; i < n_tiles; i++)
+        if (map->dirty[i])
+          {
+            dirty_tiles[map->n_dirty++] = i;
+            map->dirty[i] = FALSE;
+          }
+    }
+
+  tile_unmap.map_ID      = map->map_ID;
+  tile_unmap.detach      = detach;
+  tile_unmap.n_dirty     = map->n_dirty;
+  tile_unmap.dirty_tiles = dirty_tiles;
+
+  if (! gp_tile_unmap_write (_writechannel, &tile_unmap, NULL))
+    gimp_quit ();
+
+  g_free (dirty_tiles);
+
+  gimp_read_expect_msg (&msg, GP_TILE_ACK);
+  gimp_wire_destroy (&msg);
+
+  map->n_dirty = 0;
+}
+
+/*  Gives the tiles that are still referenced a copy of their data,
+ *  they are transferred the usual way from now on, and frees @map.
+ *  If @sync is %TRUE, the core copies back what changed first.
+ */
+static void
+gimp_tile_map_remove (GimpTileMap *map,
+                      gboolean     sync)
+{
+  GimpDrawable *drawable = map->drawable;
+  GimpTile     *tiles;
+
+  tiles = map->shadow ? drawable->shadow_tiles : drawable->tiles;
+
+  if (tiles)
+    {
+      gint n_tiles = drawable->ntile_rows * drawable->ntile_cols;
+      gint i;
+
+      for (i = 0; i < n_tiles; i++)
+        {
+          GimpTile *tile = tiles + i;
+
+          if (tile->data && tile->data == gimp_tile_map_data (map, tile))
+            {
+              if (sync && tile->dirty)
+                {
+                  gimp_tile_map_set_dirty (map, tile);
+                  tile->dirty = FALSE;
+                }
+
+              tile->data = g_memdup (tile->data,
+                                     tile->ewidth * tile->eheight * tile->bpp);
+            }
+        }
+    }
+
+  if (sync)
+    gimp_tile_map_sync (map, TRUE);
+
+  gimp_tile_map_detach (map);
+
+  tile_maps = g_slist_remove (tile_maps, map);
+
+  g_free (map->dirty);
+  g_slice_free (GimpTileMap, map);
+}
@@ -56,7 +56,27 @@ void    gimp_tile_cache_ntiles (gulong     ntiles);
 
 /*  private function  */
 
-G_GNUC_INTERNAL void _gimp_tile_cache_flush_drawable (GimpDrawable *drawable);
+G_GNUC_INTERNAL void     _gimp_tile_cache_flush_drawable (GimpDrawable *drawable);
+
+G_GNUC_INTERNAL void     _gimp_tile_prefetch             (GimpDrawable *drawable,
+                                                          gboolean      shadow,
+                                                          gint          x,
+                                                          gint          y,
+                                                          gint          width,
+                                                          gint          height);
+G_GNUC_INTERNAL void     _gimp_tiles_flush               (GimpTile     *tiles,
+                                                          gint          n_tiles);
+
+G_GNUC_INTERNAL gboolean _gimp_tile_map_drawable         (GimpDrawable *drawable,
+                                                          gboolean      shadow,
+                                                          gint          x,
+                                                          gint          y,
+                                                          gint          width,
+                                                          gint          height);
+G_GNUC_INTERNAL void     _gimp_tile_unmap_drawable       (GimpDrawable *drawable,
+                                                          gboolean      shadow);
+G_GNUC_INTERNAL void     _gimp_tile_unmap_all            (void);
+G_GNUC_INTERNAL void     _gimp_tile_map_flush_drawable   (GimpDrawable *drawable);
 
 
 G_END_DECLS
@@ -140,6 +140,49 @@ static void _gp_has_init_write           (GIOChannel       *channel,
                                           gpointer          user_data);
 static void _gp_has_init_destroy         (GimpWireMessage  *msg);
 
+static void _gp_tile_map_read            (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_map_write           (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_map_destroy         (GimpWireMessage  *msg);
+
+static void _gp_tile_unmap_read          (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_unmap_write         (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_unmap_destroy       (GimpWireMessage  *msg);
+
+static gboolean _gp_tiles_skip           (GIOChannel       *channel,
+                                          guint64           n_bytes,
+                                          gpointer          user_data);
+static void _gp_tiles_req_read           (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tiles_req_write          (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tiles_req_destroy        (GimpWireMessage  *msg);
+
+static void _gp_tiles_data_read          (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tiles_data_write         (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tiles_data_destroy       (GimpWireMessage  *msg);
+
+static void _gp_resident_read            (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_resident_write           (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_resident_destroy         (GimpWireMessage  *msg);
+
 
 
 void
@@ -197,6 +240,26 @@ gp_init (void)
                       _gp_has_init_read,
                       _gp_has_init_write,
                       _gp_has_init_destroy);
+  gimp_wire_register (GP_TILE_MAP,
+                      _gp_tile_map_read,
+                      _gp_tile_map_write,
+                      _gp_tile_map_destroy);
+  gimp_wire_register (GP_TILE_UNMAP,
+                      _gp_tile_unmap_read,
+                      _gp_tile_unmap_write,
+                      _gp_tile_unmap_destroy);
+  gimp_wire_register (GP_TILES_REQ,
+                      _gp_tiles_req_read,
+                      _gp_tiles_req_write,
+                      _gp_tiles_req_destroy);
+  gimp_wire_register (GP_TILES_DATA,
+                      _gp_tiles_data_read,
+                      _gp_tiles_data_write,
+                      _gp_tiles_data_destroy);
+  gimp_wire_register (GP_RESIDENT,
+                      _gp_resident_read,
+                      _gp_resident_write,
+                      _gp_resident_destroy);
 }
 
 gboolean
@@ -442,6 +505,100 @@ gp_has_init_write (GIOChannel *channel,
   return TRUE;
 }
 
+gboolean
+gp_tile_map_write (GIOChannel *channel,
+                   GPTileMap  *tile_map,
+                   gpointer    user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_TILE_MAP;
+  msg.data = tile_map;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_tile_unmap_write (GIOChannel  *channel,
+                     GPTileUnmap *tile_unmap,
+                     gpointer     user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_TILE_UNMAP;
+  msg.data = tile_unmap;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_tiles_req_write (GIOChannel *channel,
+                    GPTilesReq *tiles_req,
+                    gpointer    user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_TILES_REQ;
+  msg.data = tiles_req;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_tiles_data_write (GIOChannel  *channel,
+                     GPTilesData *tiles_data,
+                     gpointer     user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_TILES_DATA;
+  msg.data = tiles_data;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_resident_write (GIOChannel *channel,
+                   gpointer    user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_RESIDENT;
+  msg.data = NULL;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
 /*  quit  */
 
 static void
@@ -1868,3 +2025,428 @@ static void
 _gp_has_init_destroy (GimpWireMessage *msg)
 {
 }
+
+/*  tile_map  */
+
+static void
+_gp_tile_map_read (GIOChannel      *channel,
+                   GimpWireMessage *msg,
+                   gpointer         user_data)
+{
+  GPTileMap *tile_map = g_slice_new0 (GPTileMap);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_map->drawable_ID, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_map->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_map->x, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_map->y, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_map->width, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_map->height, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_map->map_ID, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_map->shm_ID, 1,
+                               user_data))
+    goto cleanup;
+
+  msg->data = tile_map;
+  return;
+
+ cleanup:
+  g_slice_free (GPTileMap, tile_map);
+  msg->data = NULL;
+}
+
+static void
+_gp_tile_map_write (GIOChannel      *channel,
+                    GimpWireMessage *msg,
+                    gpointer         user_data)
+{
+  GPTileMap *tile_map = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_map->drawable_ID, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_map->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_map->x, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_map->y, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_map->width, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_map->height, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_map->map_ID, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_map->shm_ID, 1,
+                                user_data))
+    return;
+}
+
+static void
+_gp_tile_map_destroy (GimpWireMessage *msg)
+{
+  GPTileMap *tile_map = msg->data;
+
+  if (tile_map)
+    g_slice_free (GPTileMap, tile_map);
+}
+
+/*  tile_unmap  */
+
+static void
+_gp_tile_unmap_read (GIOChannel      *channel,
+                     GimpWireMessage *msg,
+                     gpointer         user_data)
+{
+  GPTileUnmap *tile_unmap = g_slice_new0 (GPTileUnmap);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_unmap->map_ID, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_unmap->detach, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_unmap->n_dirty, 1, user_data))
+    goto cleanup;
+
+  if (tile_unmap->n_dirty > 0)
+    {
+      tile_unmap->dirty_tiles = g_new (guint32, tile_unmap->n_dirty);
+
+      if (! _gimp_wire_read_int32 (channel,
+                                   tile_unmap->dirty_tiles,
+                                   tile_unmap->n_dirty,
+                                   user_data))
+        goto cleanup;
+    }
+
+  msg->data = tile_unmap;
+  return;
+
+ cleanup:
+  g_free (tile_unmap->dirty_tiles);
+  g_slice_free (GPTileUnmap, tile_unmap);
+  msg->data = NULL;
+}
+
+static void
+_gp_tile_unmap_write (GIOChannel      *channel,
+                      GimpWireMessage *msg,
+                      gpointer         user_data)
+{
+  GPTileUnmap *tile_unmap = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_unmap->map_ID, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_unmap->detach, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_unmap->n_dirty, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                tile_unmap->dirty_tiles,
+                                tile_unmap->n_dirty,
+                                user_data))
+    return;
+}
+
+static void
+_gp_tile_unmap_destroy (GimpWireMessage *msg)
+{
+  GPTileUnmap *tile_unmap = msg->data;
+
+  if (tile_unmap)
+    {
+      g_free (tile_unmap->dirty_tiles);
+      g_slice_free (GPTileUnmap, tile_unmap);
+    }
+}
+
+/*  tiles_req  */
+
+/*  Reads and drops @n_bytes, the remainder of a message with more than
+ *  GP_TILES_MAX tiles.
+ */
+static gboolean
+_gp_tiles_skip (GIOChannel *channel,
+                guint64     n_bytes,
+                gpointer    user_data)
+{
+  guint8 buf[1024];
+
+  while (n_bytes > 0)
+    {
+      gint count = MIN (n_bytes, sizeof (buf));
+
+      if (! _gimp_wire_read_int8 (channel, buf, count, user_data))
+        return FALSE;
+
+      n_bytes -= count;
+    }
+
+  return TRUE;
+}
+
+static void
+_gp_tiles_req_read (GIOChannel      *channel,
+                    GimpWireMessage *msg,
+                    gpointer         user_data)
+{
+  GPTilesReq *tiles_req = g_slice_new0 (GPTilesReq);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tiles_req->drawable_ID, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tiles_req->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tiles_req->n_tiles, 1, user_data))
+    goto cleanup;
+
+  /*  consume the tile numbers of a request that is too large, so the
+   *  next message is read from the right place
+   */
+  if (tiles_req->n_tiles > GP_TILES_MAX)
+    {
+      _gp_tiles_skip (channel,
+                      (guint64) tiles_req->n_tiles * sizeof (guint32),
+                      user_data);
+      goto cleanup;
+    }
+
+  tiles_req->tile_nums = g_new (guint32, tiles_req->n_tiles);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               tiles_req->tile_nums, tiles_req->n_tiles,
+                               user_data))
+    goto cleanup;
+
+  msg->data = tiles_req;
+  return;
+
+ cleanup:
+  g_free (tiles_req->tile_nums);
+  g_slice_free (GPTilesReq, tiles_req);
+  msg->data = NULL;
+}
+
+static void
+_gp_tiles_req_write (GIOChannel      *channel,
+                     GimpWireMessage *msg,
+                     gpointer         user_data)
+{
+  GPTilesReq *tiles_req = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tiles_req->drawable_ID, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tiles_req->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tiles_req->n_tiles, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                tiles_req->tile_nums, tiles_req->n_tiles,
+                                user_data))
+    return;
+}
+
+static void
+_gp_tiles_req_destroy (GimpWireMessage *msg)
+{
+  GPTilesReq *tiles_req = msg->data;
+
+  if (tiles_req)
+    {
+      g_free (tiles_req->tile_nums);
+      g_slice_free (GPTilesReq, tiles_req);
+    }
+}
+
+/*  tiles_data  */
+
+static void
+_gp_tiles_data_read (GIOChannel      *channel,
+                     GimpWireMessage *msg,
+                     gpointer         user_data)
+{
+  GPTilesData *tiles_data = g_slice_new0 (GPTilesData);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tiles_data->drawable_ID, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tiles_data->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tiles_data->bpp, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tiles_data->n_tiles, 1, user_data))
+    goto cleanup;
+
+  /*  consume the tile numbers and the data of a message that is too
+   *  large, so the next message is read from the right place
+   */
+  if (tiles_data->n_tiles > GP_TILES_MAX)
+    {
+      if (! _gp_tiles_skip (channel,
+                            (guint64) tiles_data->n_tiles * sizeof (guint32),
+                            user_data))
+        goto cleanup;
+      if (! _gimp_wire_read_int32 (channel,
+                                   &tiles_data->use_shm, 1, user_data))
+        goto cleanup;
+      if (! _gimp_wire_read_int32 (channel,
+                                   &tiles_data->length, 1, user_data))
+        goto cleanup;
+
+      if (! tiles_data->use_shm)
+        _gp_tiles_skip (channel, tiles_data->length, user_data);
+
+      goto cleanup;
+    }
+
+  tiles_data->tile_nums = g_new (guint32, tiles_data->n_tiles);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               tiles_data->tile_nums, tiles_data->n_tiles,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tiles_data->use_shm, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tiles_data->length, 1, user_data))
+    goto cleanup;
+
+  if (! tiles_data->use_shm)
+    {
+      tiles_data->data = g_new (guchar, tiles_data->length);
+
+      if (! _gimp_wire_read_int8 (channel,
+                                  (guint8 *) tiles_data->data,
+                                  tiles_data->length,
+                                  user_data))
+        goto cleanup;
+    }
+
+  msg->data = tiles_data;
+  return;
+
+ cleanup:
+  g_free (tiles_data->tile_nums);
+  g_free (tiles_data->data);
+  g_slice_free (GPTilesData, tiles_data);
+  msg->data = NULL;
+}
+
+static void
+_gp_tiles_data_write (GIOChannel      *channel,
+                      GimpWireMessage *msg,
+                      gpointer         user_data)
+{
+  GPTilesData *tiles_data = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tiles_data->drawable_ID, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tiles_data->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tiles_data->bpp, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tiles_data->n_tiles, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                tiles_data->tile_nums, tiles_data->n_tiles,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tiles_data->use_shm, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tiles_data->length, 1, user_data))
+    return;
+
+  if (! tiles_data->use_shm)
+    {
+      if (! _gimp_wire_write_int8 (channel,
+                                   (const guint8 *) tiles_data->data,
+                                   tiles_data->length,
+                                   user_data))
+        return;
+    }
+}
+
+static void
+_gp_tiles_data_destroy (GimpWireMessage *msg)
+{
+  GPTilesData *tiles_data = msg->data;
+
+  if (tiles_data)
+    {
+      g_free (tiles_data->tile_nums);
+      g_free (tiles_data->data);
+      g_slice_free (GPTilesData, tiles_data);
+    }
+}
+
+/*  resident  */
+
+static void
+_gp_resident_read (GIOChannel      *channel,
+                   GimpWireMessage *msg,
+                   gpointer         user_data)
+{
+}
+
+static void
+_gp_resident_write (GIOChannel      *channel,
+                    GimpWireMessage *msg,
+                    gpointer         user_data)
+{
+}
+
+static void
+_gp_resident_destroy (GimpWireMessage *msg)
+{
+}
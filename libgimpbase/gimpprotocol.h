@@ -26,7 +26,14 @@ G_BEGIN_DECLS
 
 /* Increment every time the protocol changes
  */
-#define GIMP_PROTOCOL_VERSION  0x0014
+#define GIMP_PROTOCOL_VERSION  0x0015
+
+
+/* The maximum number of tiles in one GP_TILES_REQ or GP_TILES_DATA
+ * message, the shared memory segment for tile transport holds as many.
+ * Larger messages are read past and arrive with NULL data.
+ */
+#define GP_TILES_MAX  64
 
 
 enum
@@ -43,7 +50,12 @@ enum
   GP_PROC_INSTALL,
   GP_PROC_UNINSTALL,
   GP_EXTENSION_ACK,
-  GP_HAS_INIT
+  GP_HAS_INIT,
+  GP_TILE_MAP,
+  GP_TILE_UNMAP,
+  GP_TILES_REQ,
+  GP_TILES_DATA,
+  GP_RESIDENT
 };
 
 
@@ -51,6 +63,10 @@ typedef struct _GPConfig        GPConfig;
 typedef struct _GPTileReq       GPTileReq;
 typedef struct _GPTileAck       GPTileAck;
 typedef struct _GPTileData      GPTileData;
+typedef struct _GPTileMap       GPTileMap;
+typedef struct _GPTileUnmap     GPTileUnmap;
+typedef struct _GPTilesReq      GPTilesReq;
+typedef struct _GPTilesData     GPTilesData;
 typedef struct _GPParam         GPParam;
 typedef struct _GPParamDef      GPParamDef;
 typedef struct _GPProcRun       GPProcRun;
@@ -103,6 +119,46 @@ struct _GPTileData
   guchar  *data;
 };
 
+struct _GPTileMap
+{
+  gint32   drawable_ID;
+  guint32  shadow;
+  gint32   x;        /*  the tiles that cover this rectangle         */
+  gint32   y;
+  gint32   width;
+  gint32   height;
+  guint32  map_ID;   /*  assigned by the core in its reply           */
+  gint32   shm_ID;   /*  -1 if the core could not map the tiles      */
+};
+
+struct _GPTileUnmap
+{
+  guint32  map_ID;
+  guint32  detach;       /*  free the segment, otherwise it stays mapped */
+  guint32  n_dirty;      /*  the tiles to copy back to the drawable      */
+  guint32 *dirty_tiles;
+};
+
+struct _GPTilesReq
+{
+  gint32   drawable_ID;
+  guint32  shadow;
+  guint32  n_tiles;
+  guint32 *tile_nums;
+};
+
+struct _GPTilesData
+{
+  gint32   drawable_ID;
+  guint32  shadow;
+  guint32  bpp;
+  guint32  n_tiles;
+  guint32 *tile_nums;
+  guint32  use_shm;
+  guint32  length;   /*  of all tiles, which follow each other in data  */
+  guchar  *data;     /*  NULL if the tiles are in shared memory         */
+};
+
 struct _GPParam
 {
   guint32 type;
@@ -224,6 +280,20 @@ gboolean  gp_extension_ack_write    (GIOChannel      *channel,
                                      gpointer         user_data);
 gboolean  gp_has_init_write         (GIOChannel      *channel,
                                      gpointer         user_data);
+gboolean  gp_tile_map_write         (GIOChannel      *channel,
+                                     GPTileMap       *tile_map,
+                                     gpointer         user_data);
+gboolean  gp_tile_unmap_write       (GIOChannel      *channel,
+                                     GPTileUnmap     *tile_unmap,
+                                     gpointer         user_data);
+gboolean  gp_tiles_req_write        (GIOChannel      *channel,
+                                     GPTilesReq      *tiles_req,
+                                     gpointer         user_data);
+gboolean  gp_tiles_data_write       (GIOChannel      *channel,
+                                     GPTilesData     *tiles_data,
+                                     gpointer         user_data);
+gboolean  gp_resident_write         (GIOChannel      *channel,
+                                     gpointer         user_data);
 
 void      gp_params_destroy         (GPParam         *params,
                                      gint             nparams);
@@ -0,0 +1,384 @@
+/* A test program for the tile messages of the plug-in protocol */
+
+#include "config.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <glib-object.h>
+
+#include "gimpbasetypes.h"
+
+#include "gimpparasite.h"
+#include "gimpprotocol.h"
+#include "gimpwire.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/gimp-protocol/" #function, function);
+
+
+/*  both ends of a pipe, every message written to the one is read back
+ *  from the other
+ */
+static GIOChannel *write_channel = NULL;
+static GIOChannel *read_channel  = NULL;
+
+
+static gboolean
+protocol_test_flush (GIOChannel *channel,
+                     gpointer    user_data)
+{
+  return TRUE;
+}
+
+static GIOChannel *
+protocol_test_channel_new (gint fd)
+{
+  GIOChannel *channel = g_io_channel_unix_new (fd);
+
+  g_io_channel_set_encoding (channel, NULL, NULL);
+  g_io_channel_set_buffered (channel, FALSE);
+
+  return channel;
+}
+
+/*  Reads the next message and checks its type.  */
+static void
+protocol_test_read (GimpWireMessage *msg,
+                    guint32          type)
+{
+  /*  messages without data, like GP_RESIDENT, leave it untouched  */
+  msg->data = NULL;
+
+  g_assert (gimp_wire_read_msg (read_channel, msg, NULL));
+  g_assert_cmpuint (msg->type, ==, type);
+}
+
+/*  Writes a GP_TILES_REQ with GP_TILES_MAX + 1 tiles, followed by a
+ *  GP_RESIDENT.
+ */
+static void
+protocol_test_write_oversized_req (void)
+{
+  GPTilesReq tiles_req;
+  guint32    tile_nums[GP_TILES_MAX + 1];
+  gint       i;
+
+  for (i = 0; i < G_N_ELEMENTS (tile_nums); i++)
+    tile_nums[i] = i;
+
+  tiles_req.drawable_ID = 7;
+  tiles_req.shadow      = FALSE;
+  tiles_req.n_tiles     = G_N_ELEMENTS (tile_nums);
+  tiles_req.tile_nums   = tile_nums;
+
+  g_assert (gp_tiles_req_write (write_channel, &tiles_req, NULL));
+  g_assert (gp_resident_write (write_channel, NULL));
+}
+
+/**
+ * tile_map:
+ *
+ * Test that a GP_TILE_MAP arrives with the rectangle and the map and
+ * shared memory IDs it was written with.
+ **/
+static void
+tile_map (void)
+{
+  GPTileMap        tile_map = { 5, TRUE, 10, 20, 300, 400, 3, -1 };
+  GimpWireMessage  msg;
+  GPTileMap       *read;
+
+  g_assert (gp_tile_map_write (write_channel, &tile_map, NULL));
+
+  protocol_test_read (&msg, GP_TILE_MAP);
+
+  read = msg.data;
+  g_assert (read != NULL);
+  g_assert_cmpint  (read->drawable_ID, ==, 5);
+  g_assert_cmpuint (read->shadow,      ==, TRUE);
+  g_assert_cmpint  (read->x,           ==, 10);
+  g_assert_cmpint  (read->y,           ==, 20);
+  g_assert_cmpint  (read->width,       ==, 300);
+  g_assert_cmpint  (read->height,      ==, 400);
+  g_assert_cmpuint (read->map_ID,      ==, 3);
+  g_assert_cmpint  (read->shm_ID,      ==, -1);
+
+  gimp_wire_destroy (&msg);
+}
+
+/**
+ * tile_unmap:
+ *
+ * Test that a GP_TILE_UNMAP arrives with its list of dirty tiles, and
+ * without one if no tiles are dirty.
+ **/
+static void
+tile_unmap (void)
+{
+  guint32          dirty_tiles[] = { 0, 4, 9 };
+  GPTileUnmap      tile_unmap    = { 3, FALSE, 3, dirty_tiles };
+  GimpWireMessage  msg;
+  GPTileUnmap     *read;
+
+  g_assert (gp_tile_unmap_write (write_channel, &tile_unmap, NULL));
+
+  protocol_test_read (&msg, GP_TILE_UNMAP);
+
+  read = msg.data;
+  g_assert (read != NULL);
+  g_assert_cmpuint (read->map_ID,  ==, 3);
+  g_assert_cmpuint (read->detach,  ==, FALSE);
+  g_assert_cmpuint (read->n_dirty, ==, 3);
+  g_assert (memcmp (read->dirty_tiles, dirty_tiles,
+                    sizeof (dirty_tiles)) == 0);
+
+  gimp_wire_destroy (&msg);
+
+  tile_unmap.detach      = TRUE;
+  tile_unmap.n_dirty     = 0;
+  tile_unmap.dirty_tiles = NULL;
+
+  g_assert (gp_tile_unmap_write (write_channel, &tile_unmap, NULL));
+
+  protocol_test_read (&msg, GP_TILE_UNMAP);
+
+  read = msg.data;
+  g_assert (read != NULL);
+  g_assert_cmpuint (read->detach,  ==, TRUE);
+  g_assert_cmpuint (read->n_dirty, ==, 0);
+  g_assert (read->dirty_tiles == NULL);
+
+  gimp_wire_destroy (&msg);
+}
+
+/**
+ * tiles_req:
+ *
+ * Test that a GP_TILES_REQ of GP_TILES_MAX tiles arrives with all its
+ * tile numbers.
+ **/
+static void
+tiles_req (void)
+{
+  GPTilesReq       tiles_req;
+  guint32          tile_nums[GP_TILES_MAX];
+  GimpWireMessage  msg;
+  GPTilesReq      *read;
+  gint             i;
+
+  for (i = 0; i < G_N_ELEMENTS (tile_nums); i++)
+    tile_nums[i] = i * 3;
+
+  tiles_req.drawable_ID = 7;
+  tiles_req.shadow      = TRUE;
+  tiles_req.n_tiles     = G_N_ELEMENTS (tile_nums);
+  tiles_req.tile_nums   = tile_nums;
+
+  g_assert (gp_tiles_req_write (write_channel, &tiles_req, NULL));
+
+  protocol_test_read (&msg, GP_TILES_REQ);
+
+  read = msg.data;
+  g_assert (read != NULL);
+  g_assert_cmpint  (read->drawable_ID, ==, 7);
+  g_assert_cmpuint (read->shadow,      ==, TRUE);
+  g_assert_cmpuint (read->n_tiles,     ==, GP_TILES_MAX);
+  g_assert (memcmp (read->tile_nums, tile_nums, sizeof (tile_nums)) == 0);
+
+  gimp_wire_destroy (&msg);
+}
+
+/**
+ * tiles_req_oversized:
+ *
+ * Test that a GP_TILES_REQ of more than GP_TILES_MAX tiles arrives
+ * with NULL data, and that the message after it is read intact.
+ **/
+static void
+tiles_req_oversized (void)
+{
+  GimpWireMessage msg;
+
+  protocol_test_write_oversized_req ();
+
+  protocol_test_read (&msg, GP_TILES_REQ);
+  g_assert (msg.data == NULL);
+  gimp_wire_destroy (&msg);
+
+  protocol_test_read (&msg, GP_RESIDENT);
+  gimp_wire_destroy (&msg);
+}
+
+/**
+ * tiles_data:
+ *
+ * Test that a GP_TILES_DATA arrives with its tile numbers and the
+ * pixels that were sent inline.
+ **/
+static void
+tiles_data (void)
+{
+  GPTilesData      tiles_data;
+  guint32          tile_nums[] = { 1, 2 };
+  guchar           data[2 * 16];
+  GimpWireMessage  msg;
+  GPTilesData     *read;
+  gint             i;
+
+  for (i = 0; i < G_N_ELEMENTS (data); i++)
+    data[i] = i * 5;
+
+  tiles_data.drawable_ID = 9;
+  tiles_data.shadow      = FALSE;
+  tiles_data.bpp         = 4;
+  tiles_data.n_tiles     = G_N_ELEMENTS (tile_nums);
+  tiles_data.tile_nums   = tile_nums;
+  tiles_data.use_shm     = FALSE;
+  tiles_data.length      = sizeof (data);
+  tiles_data.data        = data;
+
+  g_assert (gp_tiles_data_write (write_channel, &tiles_data, NULL));
+
+  protocol_test_read (&msg, GP_TILES_DATA);
+
+  read = msg.data;
+  g_assert (read != NULL);
+  g_assert_cmpint  (read->drawable_ID, ==, 9);
+  g_assert_cmpuint (read->shadow,      ==, FALSE);
+  g_assert_cmpuint (read->bpp,         ==, 4);
+  g_assert_cmpuint (read->n_tiles,     ==, 2);
+  g_assert (memcmp (read->tile_nums, tile_nums, sizeof (tile_nums)) == 0);
+  g_assert_cmpuint (read->use_shm,     ==, FALSE);
+  g_assert_cmpuint (read->length,      ==, sizeof (data));
+  g_assert (memcmp (read->data, data, sizeof (data)) == 0);
+
+  gimp_wire_destroy (&msg);
+
+  /*  shared memory transport, no pixels on the wire  */
+  tiles_data.use_shm = TRUE;
+
+  g_assert (gp_tiles_data_write (write_channel, &tiles_data, NULL));
+
+  protocol_test_read (&msg, GP_TILES_DATA);
+
+  read = msg.data;
+  g_assert (read != NULL);
+  g_assert_cmpuint (read->use_shm, ==, TRUE);
+  g_assert (read->data == NULL);
+
+  gimp_wire_destroy (&msg);
+}
+
+/**
+ * tiles_data_oversized:
+ *
+ * Test that a GP_TILES_DATA of more than GP_TILES_MAX tiles arrives
+ * with NULL data, both with inline pixels and with shared memory, and
+ * that the message after it is read intact.
+ **/
+static void
+tiles_data_oversized (void)
+{
+  GPTilesData      tiles_data;
+  guint32          tile_nums[GP_TILES_MAX + 1];
+  guchar           data[2 * 1024];
+  GimpWireMessage  msg;
+  gint             i;
+
+  for (i = 0; i < G_N_ELEMENTS (tile_nums); i++)
+    tile_nums[i] = i;
+
+  memset (data, 0x5a, sizeof (data));
+
+  tiles_data.drawable_ID = 9;
+  tiles_data.shadow      = FALSE;
+  tiles_data.bpp         = 1;
+  tiles_data.n_tiles     = G_N_ELEMENTS (tile_nums);
+  tiles_data.tile_nums   = tile_nums;
+  tiles_data.use_shm     = FALSE;
+  tiles_data.length      = sizeof (data);
+  tiles_data.data        = data;
+
+  g_assert (gp_tiles_data_write (write_channel, &tiles_data, NULL));
+  g_assert (gp_resident_write (write_channel, NULL));
+
+  protocol_test_read (&msg, GP_TILES_DATA);
+  g_assert (msg.data == NULL);
+  gimp_wire_destroy (&msg);
+
+  protocol_test_read (&msg, GP_RESIDENT);
+  gimp_wire_destroy (&msg);
+
+  tiles_data.use_shm = TRUE;
+
+  g_assert (gp_tiles_data_write (write_channel, &tiles_data, NULL));
+  g_assert (gp_resident_write (write_channel, NULL));
+
+  protocol_test_read (&msg, GP_TILES_DATA);
+  g_assert (msg.data == NULL);
+  gimp_wire_destroy (&msg);
+
+  protocol_test_read (&msg, GP_RESIDENT);
+  gimp_wire_destroy (&msg);
+}
+
+/**
+ * resident:
+ *
+ * Test that a GP_RESIDENT arrives, and that the message after it is
+ * read intact.
+ **/
+static void
+resident (void)
+{
+  GimpWireMessage msg;
+
+  g_assert (gp_resident_write (write_channel, NULL));
+  protocol_test_write_oversized_req ();
+
+  protocol_test_read (&msg, GP_RESIDENT);
+  g_assert (msg.data == NULL);
+  gimp_wire_destroy (&msg);
+
+  protocol_test_read (&msg, GP_TILES_REQ);
+  gimp_wire_destroy (&msg);
+
+  protocol_test_read (&msg, GP_RESIDENT);
+  gimp_wire_destroy (&msg);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  gint fds[2];
+  gint result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  if (pipe (fds) != 0)
+    g_error ("could not create a pipe");
+
+  read_channel  = protocol_test_channel_new (fds[0]);
+  write_channel = protocol_test_channel_new (fds[1]);
+
+  gp_init ();
+  gimp_wire_set_flusher (protocol_test_flush);
+
+  ADD_TEST (tile_map);
+  ADD_TEST (tile_unmap);
+  ADD_TEST (tiles_req);
+  ADD_TEST (tiles_req_oversized);
+  ADD_TEST (tiles_data);
+  ADD_TEST (tiles_data_oversized);
+  ADD_TEST (resident);
+
+  result = g_test_run ();
+
+  g_io_channel_unref (write_channel);
+  g_io_channel_unref (read_channel);
+
+  return result;
+}